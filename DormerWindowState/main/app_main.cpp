@@ -1,13 +1,24 @@
 // Dormer Window State
 //
-// Matter Contact Sensor (device type 0x0015) for ESP32-C6. A single digital
-// GPIO reads a reed switch on the window; the debounced state is exposed to
-// any Matter controller (Apple Home, Google Home, SmartThings, etc.) via the
-// Boolean State cluster's StateValue attribute.
+// Matter Contact Sensor (device type 0x0015) for ESP32-C6. Each configured
+// digital GPIO reads a reed switch on one window; its debounced state is
+// exposed to any Matter controller (Apple Home, Google Home, SmartThings,
+// etc.) via the Boolean State cluster's StateValue attribute on its own
+// Contact Sensor endpoint.
+//
+// With WINDOW_SENSOR_LOW_POWER the chip light-sleeps between contact changes
+// (the reed GPIO is a wake source); pair it with sdkconfig.defaults.sed to
+// run as a Thread sleepy end device.
 
 #include <esp_log.h>
 #include <esp_matter.h>
 #include <nvs_flash.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_WINDOW_SENSOR_LOW_POWER
+#include <esp_pm.h>
+#endif
 
 #if CONFIG_ENABLE_CHIP_SHELL
 #include <esp_matter_console.h>
@@ -22,7 +33,7 @@ using namespace esp_matter::endpoint;
 
 static const char *TAG = "app_main";
 
-static uint16_t window_endpoint_id = 0;
+static uint16_t window_endpoint_ids[WINDOW_SENSOR_MAX_INPUTS];
 
 // Local stand-in for the ABORT_APP_ON_FAILURE helper used by the upstream
 // esp-matter examples (defined in examples/common/utils, which this
@@ -40,6 +51,15 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
     switch (event->Type) {
     case chip::DeviceLayer::DeviceEventType::kInterfaceIpAddressChanged:
         ESP_LOGI(TAG, "Interface IP address changed");
+        app_driver_set_link_up(true);
+        break;
+    case chip::DeviceLayer::DeviceEventType::kThreadConnectivityChange:
+        ESP_LOGI(TAG, "Thread connectivity changed");
+        app_driver_set_link_up(event->ThreadConnectivityChange.Result == chip::DeviceLayer::kConnectivity_Established);
+        break;
+    case chip::DeviceLayer::DeviceEventType::kWiFiConnectivityChange:
+        ESP_LOGI(TAG, "WiFi connectivity changed");
+        app_driver_set_link_up(event->WiFiConnectivityChange.Result == chip::DeviceLayer::kConnectivity_Established);
         break;
     case chip::DeviceLayer::DeviceEventType::kCommissioningComplete:
         ESP_LOGI(TAG, "Commissioning complete");
@@ -68,6 +88,49 @@ static esp_err_t app_attribute_update_cb(attribute::callback_type_t type, uint16
     return ESP_OK;
 }
 
+#if CONFIG_ENABLE_CHIP_SHELL
+// "matter esp window pins <gpio>...": store the contact GPIO list in NVS
+static esp_err_t window_pins_handler(int argc, char **argv)
+{
+    uint8_t gpios[WINDOW_SENSOR_MAX_INPUTS];
+    uint8_t count = 0;
+    for (int i = 0; i < argc && count < WINDOW_SENSOR_MAX_INPUTS; i++) {
+        gpios[count++] = static_cast<uint8_t>(atoi(argv[i]));
+    }
+    esp_err_t err = app_driver_store_gpios(gpios, count);
+    if (err == ESP_OK && count > 0) {
+        printf("Stored %u GPIOs, reboot to apply\n", count);
+    } else if (err == ESP_OK) {
+        printf("Cleared, the Kconfig GPIOs apply after a reboot\n");
+    }
+    return err;
+}
+
+// "matter esp window": per-input state and the driver's counters
+static esp_err_t window_stats_handler(int argc, char **argv)
+{
+    if (argc > 0 && strcmp(argv[0], "pins") == 0) {
+        return window_pins_handler(argc - 1, argv + 1);
+    }
+
+    for (uint8_t i = 0; i < app_driver_input_count(); i++) {
+        printf("window %u: GPIO%d endpoint %u %s%s\n", i, app_driver_input_gpio(i), window_endpoint_ids[i],
+               app_driver_window_is_open(i) ? "open" : "closed", app_driver_input_faulted(i) ? " FAULT" : "");
+    }
+
+    window_sensor_stats_t stats;
+    app_driver_get_stats(&stats);
+    printf("wakes: %lu\n", (unsigned long)stats.wakes);
+    printf("reports: %lu\n", (unsigned long)stats.reports);
+    printf("bounce rejections: %lu\n", (unsigned long)stats.bounce_rejections);
+    printf("queued: %lu (dropped %lu)\n", (unsigned long)stats.queued, (unsigned long)stats.queue_dropped);
+    printf("edge to report: last %lu ms, mean %lu ms, max %lu ms\n", (unsigned long)stats.last_latency_ms,
+           (unsigned long)stats.mean_latency_ms, (unsigned long)stats.max_latency_ms);
+    printf("tamper faults: %lu\n", (unsigned long)stats.tamper_faults);
+    return ESP_OK;
+}
+#endif
+
 extern "C" void app_main()
 {
     esp_err_t err = nvs_flash_init();
@@ -77,8 +140,18 @@ extern "C" void app_main()
     }
     ESP_ERROR_CHECK(err);
 
-    // Configure the GPIO and take an initial reading before the endpoint is
-    // created, so the Matter attribute starts out correct rather than at a
+#if CONFIG_WINDOW_SENSOR_LOW_POWER
+    // Let the idle task light-sleep; the contact GPIO and the radio's own
+    // timers are what wake it
+    esp_pm_config_t pm_config = {};
+    pm_config.max_freq_mhz = 160;
+    pm_config.min_freq_mhz = 40;
+    pm_config.light_sleep_enable = true;
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
+
+    // Configure the GPIOs and take initial readings before the endpoints are
+    // created, so the Matter attributes start out correct rather than at a
     // default value.
     app_driver_gpio_init();
 
@@ -86,25 +159,46 @@ extern "C" void app_main()
     node_t *node = node::create(&node_config, app_attribute_update_cb, app_identification_cb);
     ABORT_APP_ON_FAILURE(node != nullptr, ESP_LOGE(TAG, "Failed to create Matter node"));
 
-    contact_sensor::config_t contact_sensor_config;
-    contact_sensor_config.boolean_state.state_value = app_driver_window_is_open();
-
-    endpoint_t *endpoint = contact_sensor::create(node, &contact_sensor_config, ENDPOINT_FLAG_NONE, nullptr);
-    ABORT_APP_ON_FAILURE(endpoint != nullptr, ESP_LOGE(TAG, "Failed to create contact sensor endpoint"));
+    uint8_t input_count = app_driver_input_count();
+    for (uint8_t i = 0; i < input_count; i++) {
+        contact_sensor::config_t contact_sensor_config;
+        contact_sensor_config.boolean_state.state_value = app_driver_window_is_open(i);
+
+        endpoint_t *endpoint = contact_sensor::create(node, &contact_sensor_config, ENDPOINT_FLAG_NONE, nullptr);
+        ABORT_APP_ON_FAILURE(endpoint != nullptr, ESP_LOGE(TAG, "Failed to create contact sensor endpoint"));
+
+#if CONFIG_WINDOW_SENSOR_TAMPER
+        // SensorFault carries the open-circuit state
+        cluster::boolean_state_configuration::config_t fault_config;
+        cluster_t *fault_cluster =
+            cluster::boolean_state_configuration::create(endpoint, &fault_config, CLUSTER_FLAG_SERVER, 0);
+        ABORT_APP_ON_FAILURE(fault_cluster != nullptr, ESP_LOGE(TAG, "Failed to create Boolean State Configuration"));
+        cluster::boolean_state_configuration::attribute::create_sensor_fault(fault_cluster, 0);
+#endif
 
-    window_endpoint_id = endpoint::get_id(endpoint);
-    ESP_LOGI(TAG, "Window contact sensor created on endpoint %u", window_endpoint_id);
+        window_endpoint_ids[i] = endpoint::get_id(endpoint);
+        ESP_LOGI(TAG, "Window %u (GPIO%d) contact sensor created on endpoint %u", i, app_driver_input_gpio(i),
+                 window_endpoint_ids[i]);
+    }
 
-    // Now that the endpoint exists, start the interrupt-driven driver that
-    // keeps it in sync with the GPIO going forward.
-    app_driver_init(window_endpoint_id);
+    // Now that the endpoints exist, start the interrupt-driven driver that
+    // keeps them in sync with the GPIOs going forward.
+    app_driver_init(window_endpoint_ids, input_count);
 
     err = esp_matter::start(app_event_cb);
     ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "Failed to start Matter, err:%d", err));
 
 #if CONFIG_ENABLE_CHIP_SHELL
     esp_matter::console::diagnostics_register_commands();
+#if CONFIG_ENABLE_WIFI_STATION
     esp_matter::console::wifi_register_commands();
+#endif
+    static const esp_matter::console::command_t window_command = {
+        .name = "window",
+        .description = "Window inputs and counters. Usage: matter esp window [pins <gpio>...]",
+        .handler = window_stats_handler,
+    };
+    esp_matter::console::add_commands(&window_command, 1);
     esp_matter::console::init();
 #endif
 }
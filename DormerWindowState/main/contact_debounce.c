@@ -0,0 +1,55 @@
+// Debounce state machine for the window contact; see contact_debounce.h.
+
+#include "contact_debounce.h"
+
+#include <string.h>
+
+void contact_debounce_init(contact_debounce_t *d, uint32_t debounce_ms, bool initial_open)
+{
+    memset(d, 0, sizeof(*d));
+    d->debounce_ms = debounce_ms;
+    d->stable_open = initial_open;
+}
+
+void contact_debounce_edge(contact_debounce_t *d, uint32_t now_ms)
+{
+    if (!d->pending) {
+        d->pending = true;
+        d->first_edge_ms = now_ms;
+        d->run_edges = 0;
+    }
+    d->last_edge_ms = now_ms;
+    d->run_edges++;
+    d->edges++;
+}
+
+uint32_t contact_debounce_next_ms(const contact_debounce_t *d, uint32_t now_ms)
+{
+    if (!d->pending) {
+        return CONTACT_DEBOUNCE_IDLE;
+    }
+    // Unsigned arithmetic keeps this right across a clock wrap
+    uint32_t elapsed = now_ms - d->last_edge_ms;
+    return elapsed >= d->debounce_ms ? 0 : d->debounce_ms - elapsed;
+}
+
+bool contact_debounce_settle(contact_debounce_t *d, uint32_t now_ms, bool raw_open, uint32_t *edge_to_confirm_ms)
+{
+    if (!d->pending || contact_debounce_next_ms(d, now_ms) != 0) {
+        return false;
+    }
+    d->pending = false;
+
+    if (raw_open == d->stable_open) {
+        // Bounced and came back (or a glitch): nothing to report
+        d->bounce_rejections++;
+        return false;
+    }
+
+    d->stable_open = raw_open;
+    d->changes++;
+    if (edge_to_confirm_ms) {
+        *edge_to_confirm_ms = now_ms - d->first_edge_ms;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Debounce state machine for the window contact.
+//
+// Plain C with no ESP-IDF dependencies, so the same code runs on the device
+// (fed from the GPIO wake interrupt) and on a host (fed from recorded edge
+// timelines, see test/). Time is in milliseconds from any monotonic clock.
+//
+// Every edge restarts the debounce window. When the window expires without
+// another edge, the pin level is sampled once: if it differs from the last
+// confirmed state the change is confirmed, otherwise the whole run of edges
+// is counted as a rejected bounce. Nothing polls in between; the caller
+// just sleeps until contact_debounce_next_ms() or the next edge.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONTACT_DEBOUNCE_IDLE UINT32_MAX
+
+typedef struct {
+    uint32_t debounce_ms;
+    bool stable_open;        // last confirmed state
+    bool pending;            // edges seen, window not yet expired
+    uint32_t first_edge_ms;  // first edge of the current run (latency start)
+    uint32_t last_edge_ms;   // latest edge (window start)
+    uint32_t run_edges;      // edges in the current run
+
+    uint32_t edges;          // all edges fed in
+    uint32_t changes;        // confirmed state changes
+    uint32_t bounce_rejections;
+} contact_debounce_t;
+
+void contact_debounce_init(contact_debounce_t *d, uint32_t debounce_ms, bool initial_open);
+
+// An edge (wake) at now_ms. The level at the edge isn't needed: only the
+// level once things have settled counts.
+void contact_debounce_edge(contact_debounce_t *d, uint32_t now_ms);
+
+// Milliseconds until the window expires (0 = due now), or
+// CONTACT_DEBOUNCE_IDLE when there is nothing to wait for.
+uint32_t contact_debounce_next_ms(const contact_debounce_t *d, uint32_t now_ms);
+
+// Call once the window has expired, with the pin level sampled now. Returns
+// true if that confirms a state change; *edge_to_confirm_ms (optional) is
+// then the time since the first edge of the run.
+bool contact_debounce_settle(contact_debounce_t *d, uint32_t now_ms, bool raw_open, uint32_t *edge_to_confirm_ms);
+
+#ifdef __cplusplus
+}
+#endif
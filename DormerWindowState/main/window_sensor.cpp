@@ -1,17 +1,32 @@
 // Digital-pin window contact driver.
 //
-// Reads a reed switch / magnetic contact sensor on a single GPIO, debounces
-// it in software, and pushes confirmed state changes into the Matter
-// Boolean State cluster (StateValue attribute) on the device's
+// Reads reed switches / magnetic contact sensors on one or more GPIOs,
+// debounces each in software, and pushes confirmed state changes into the
+// Matter Boolean State cluster (StateValue attribute) on that input's
 // Contact Sensor endpoint.
+//
+// Each pin is armed as a level-triggered wake source for the opposite of its
+// current level, so with light sleep enabled the chip sleeps until a contact
+// actually changes. One ISR serves every input: it disables the pin's
+// interrupt and sets the input's bit in the debounce task's notification
+// value. The task re-arms the pin no sooner than REARM_HOLDOFF_MS later, so
+// a chattering contact costs at most one interrupt per holdoff however fast
+// it bounces, and the task's work per wake is O(inputs). Bounces inside the
+// debounce window just restart it (see contact_debounce.h).
 
 #include "window_sensor.h"
+#include "contact_debounce.h"
 
 #include <driver/gpio.h>
 #include <esp_log.h>
 #include <esp_matter.h>
+#include <esp_rom_sys.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <nvs.h>
+#include <stdlib.h>
 
 #include "sdkconfig.h"
 
@@ -20,82 +35,476 @@ using namespace esp_matter;
 
 static const char *TAG = "window_sensor";
 
-static const gpio_num_t WINDOW_GPIO = static_cast<gpio_num_t>(CONFIG_WINDOW_SENSOR_GPIO);
 static const bool ACTIVE_LOW = CONFIG_WINDOW_SENSOR_ACTIVE_LOW;
 static const uint32_t DEBOUNCE_MS = CONFIG_WINDOW_SENSOR_DEBOUNCE_MS;
 
-static uint16_t s_endpoint_id = 0;
+// Minimum time between an input's interrupt and re-arming it
+static const uint32_t REARM_HOLDOFF_MS = 5;
+
+#if CONFIG_WINDOW_SENSOR_TAMPER
+static const uint32_t TAMPER_CHECK_MS = CONFIG_WINDOW_SENSOR_TAMPER_CHECK_S * 1000;
+// Time for the pin to follow a pull change through the cable capacitance
+static const uint32_t TAMPER_SETTLE_US = 100;
+// SensorFault bitmap bit for a general fault
+static const uint16_t SENSOR_FAULT_GENERAL = 1 << 0;
+#endif
+
+static const char *NVS_NAMESPACE = "window";
+static const char *NVS_KEY_GPIOS = "gpios";
+
+// Task notification bits: bit n is input n, the link gets the top bit
+static const uint32_t NOTIFY_LINK = 1u << 31;
+
+// Changes kept while the link is down; a full queue drops the oldest
+#define PENDING_DEPTH 32
+
+typedef enum {
+    CHANGE_STATE,
+    CHANGE_FAULT,
+} change_kind_t;
+
+typedef struct {
+    uint8_t input;
+    uint8_t kind;
+    bool value;
+    uint32_t first_edge_ms;
+} pending_change_t;
+
+typedef struct {
+    gpio_num_t gpio;
+    uint16_t endpoint_id;
+    volatile int64_t edge_us;    // set by the ISR
+    int seen_level;              // level the pin was last known to be at
+    bool armed;
+    uint32_t rearm_at_ms;
+    bool faulted;
+    contact_debounce_t debounce;
+} window_input_t;
+
+static window_input_t s_inputs[WINDOW_SENSOR_MAX_INPUTS];
+static uint8_t s_input_count = 0;
 static TaskHandle_t s_debounce_task = nullptr;
-static volatile bool s_last_reported_open = false;
+static volatile bool s_link_up = false;
+
+// Debounce task only
+static pending_change_t s_pending[PENDING_DEPTH];
+static uint32_t s_pending_head = 0;
+static uint32_t s_pending_count = 0;
+#if CONFIG_WINDOW_SENSOR_TAMPER
+static uint32_t s_next_tamper_check_ms = 0;
+#endif
+
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static window_sensor_stats_t s_stats = {};
+static uint64_t s_latency_sum_ms = 0;
+
+static inline uint32_t now_ms(void)
+{
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000);
+}
+
+// Milliseconds until `deadline`, 0 if it has passed (wrap-safe)
+static inline uint32_t ms_until(uint32_t deadline, uint32_t now)
+{
+    return static_cast<int32_t>(deadline - now) <= 0 ? 0 : deadline - now;
+}
 
-// Translate the raw pin level into a logical "window is open" boolean,
+// Translate a raw pin level into a logical "window is open" boolean,
 // accounting for the configured wiring polarity.
-static inline bool raw_pin_is_open(void)
+static inline bool level_is_open(int level)
 {
-    int level = gpio_get_level(WINDOW_GPIO);
     return ACTIVE_LOW ? (level == 1) : (level == 0);
 }
 
+// Wake (and interrupt) on the level the pin is not at now. A change while
+// the interrupt was off counts as an edge, so none is ever lost.
+static void rearm(window_input_t &in, uint32_t now)
+{
+    int level = gpio_get_level(in.gpio);
+    if (level != in.seen_level) {
+        contact_debounce_edge(&in.debounce, now);
+        in.seen_level = level;
+    }
+    gpio_wakeup_enable(in.gpio, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    gpio_intr_enable(in.gpio);
+    in.armed = true;
+}
+
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
+    uint32_t input = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg));
+
+    // Level interrupt: silence it until the task has re-armed the other level
+    gpio_intr_disable(s_inputs[input].gpio);
+    s_inputs[input].edge_us = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&s_stats_lock);
+    s_stats.wakes++;
+    portEXIT_CRITICAL_ISR(&s_stats_lock);
+
     BaseType_t woken = pdFALSE;
-    vTaskNotifyGiveFromISR(s_debounce_task, &woken);
+    xTaskNotifyFromISR(s_debounce_task, 1u << input, eSetBits, &woken);
     if (woken) {
         portYIELD_FROM_ISR();
     }
 }
 
-// Woken on every edge; waits out the debounce window, re-checks the pin,
-// and only then reports a change to Matter. This intentionally runs in a
-// normal task (not the ISR) so it is safe to call Matter APIs.
+static void queue_change(uint8_t input, change_kind_t kind, bool value, uint32_t first_edge_ms)
+{
+    if (s_pending_count == PENDING_DEPTH) {
+        s_pending_head = (s_pending_head + 1) % PENDING_DEPTH;
+        s_pending_count--;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.queue_dropped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+    pending_change_t &slot = s_pending[(s_pending_head + s_pending_count) % PENDING_DEPTH];
+    slot.input = input;
+    slot.kind = kind;
+    slot.value = value;
+    slot.first_edge_ms = first_edge_ms;
+    s_pending_count++;
+}
+
+// Apply queued changes in order once there is somewhere to report them
+static void flush_changes(void)
+{
+    while (s_pending_count > 0 && s_link_up) {
+        pending_change_t change = s_pending[s_pending_head];
+        s_pending_head = (s_pending_head + 1) % PENDING_DEPTH;
+        s_pending_count--;
+
+        uint16_t endpoint_id = s_inputs[change.input].endpoint_id;
+        if (endpoint_id == 0) {
+            continue;
+        }
+
+#if CONFIG_WINDOW_SENSOR_TAMPER
+        if (change.kind == CHANGE_FAULT) {
+            esp_matter_attr_val_t val = esp_matter_bitmap16(change.value ? SENSOR_FAULT_GENERAL : 0);
+            attribute::update(endpoint_id, BooleanStateConfiguration::Id,
+                              BooleanStateConfiguration::Attributes::SensorFault::Id, &val);
+            continue;
+        }
+#endif
+
+        esp_matter_attr_val_t val = esp_matter_bool(change.value);
+        attribute::update(endpoint_id, BooleanState::Id, BooleanState::Attributes::StateValue::Id, &val);
+
+        uint32_t latency = now_ms() - change.first_edge_ms;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.reports++;
+        s_stats.last_latency_ms = latency;
+        if (latency > s_stats.max_latency_ms) {
+            s_stats.max_latency_ms = latency;
+        }
+        s_latency_sum_ms += latency;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        ESP_LOGI(TAG, "Reported window %u %s, %lu ms after the first edge", change.input,
+                 change.value ? "OPEN" : "CLOSED", (unsigned long)latency);
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.queued = s_pending_count;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+#if CONFIG_WINDOW_SENSOR_TAMPER
+// With the window-end resistor fitted (see config/CONFIG.md) a healthy loop
+// holds the pin at a definite level against either internal pull; a cut
+// loop just follows whichever pull is on.
+static bool loop_is_open_circuit(window_input_t &in)
+{
+    gpio_intr_disable(in.gpio);
+    gpio_set_pull_mode(in.gpio, ACTIVE_LOW ? GPIO_PULLDOWN_ONLY : GPIO_PULLUP_ONLY);
+    esp_rom_delay_us(TAMPER_SETTLE_US);
+    int flipped = gpio_get_level(in.gpio);
+    gpio_set_pull_mode(in.gpio, ACTIVE_LOW ? GPIO_PULLUP_ONLY : GPIO_PULLDOWN_ONLY);
+    esp_rom_delay_us(TAMPER_SETTLE_US);
+    int normal = gpio_get_level(in.gpio);
+    if (in.armed) {
+        rearm(in, now_ms());
+    }
+    return flipped != normal;
+}
+
+static void check_tamper(uint8_t input)
+{
+    window_input_t &in = s_inputs[input];
+    bool faulted = loop_is_open_circuit(in);
+    if (faulted == in.faulted) {
+        return;
+    }
+    in.faulted = faulted;
+    if (faulted) {
+        ESP_LOGW(TAG, "Window %u (GPIO%d): loop is open-circuit", input, in.gpio);
+    } else {
+        ESP_LOGI(TAG, "Window %u (GPIO%d): loop restored", input, in.gpio);
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    if (faulted) {
+        s_stats.tamper_faults++;
+        s_stats.faulted |= 1u << input;
+    } else {
+        s_stats.faulted &= ~(1u << input);
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    queue_change(input, CHANGE_FAULT, faulted, now_ms());
+}
+#endif
+
+// Re-arm once the holdoff has passed, and settle an expired debounce window
+static void service_input(uint8_t input, uint32_t now)
+{
+    window_input_t &in = s_inputs[input];
+    if (!in.armed && ms_until(in.rearm_at_ms, now) == 0) {
+        rearm(in, now);
+    }
+
+    if (contact_debounce_next_ms(&in.debounce, now) != 0) {
+        return;
+    }
+    uint32_t first_edge_ms = in.debounce.first_edge_ms;
+    bool is_open = level_is_open(gpio_get_level(in.gpio));
+    if (contact_debounce_settle(&in.debounce, now, is_open, nullptr)) {
+        ESP_LOGI(TAG, "Window %u %s", input, is_open ? "OPEN" : "CLOSED");
+        queue_change(input, CHANGE_STATE, is_open, first_edge_ms);
+    }
+#if CONFIG_WINDOW_SENSOR_TAMPER
+    check_tamper(input);
+#endif
+}
+
+// Soonest of any input's debounce expiry or re-arm, or the tamper check
+static uint32_t next_wake_ms(uint32_t now)
+{
+    uint32_t wait = CONTACT_DEBOUNCE_IDLE;
+    for (uint8_t i = 0; i < s_input_count; i++) {
+        const window_input_t &in = s_inputs[i];
+        uint32_t until = contact_debounce_next_ms(&in.debounce, now);
+        if (!in.armed && ms_until(in.rearm_at_ms, now) < until) {
+            until = ms_until(in.rearm_at_ms, now);
+        }
+        if (until < wait) {
+            wait = until;
+        }
+    }
+#if CONFIG_WINDOW_SENSOR_TAMPER
+    if (ms_until(s_next_tamper_check_ms, now) < wait) {
+        wait = ms_until(s_next_tamper_check_ms, now);
+    }
+#endif
+    return wait;
+}
+
+// Sleeps until a wake edge, the next deadline, or a link change. This
+// intentionally runs in a normal task (not the ISR) so it is safe to call
+// Matter APIs.
 static void debounce_task(void *arg)
 {
     while (true) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_MS));
+        uint32_t wait_ms = next_wake_ms(now_ms());
+        TickType_t ticks = wait_ms == CONTACT_DEBOUNCE_IDLE
+                               ? portMAX_DELAY
+                               : (wait_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
 
-        bool is_open = raw_pin_is_open();
-        if (is_open == s_last_reported_open) {
-            continue;
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, ticks);
+
+        for (uint8_t i = 0; i < s_input_count; i++) {
+            if (bits & (1u << i)) {
+                window_input_t &in = s_inputs[i];
+                uint32_t edge_ms = static_cast<uint32_t>(in.edge_us / 1000);
+                in.seen_level = !in.seen_level;
+                in.armed = false;
+                in.rearm_at_ms = edge_ms + REARM_HOLDOFF_MS;
+                contact_debounce_edge(&in.debounce, edge_ms);
+            }
         }
-        s_last_reported_open = is_open;
 
-        ESP_LOGI(TAG, "Window %s", is_open ? "OPEN" : "CLOSED");
+        uint32_t now = now_ms();
+        uint32_t rejections = 0;
+        for (uint8_t i = 0; i < s_input_count; i++) {
+            service_input(i, now);
+            rejections += s_inputs[i].debounce.bounce_rejections;
+        }
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.bounce_rejections = rejections;
+        portEXIT_CRITICAL(&s_stats_lock);
 
-        if (s_endpoint_id == 0) {
-            continue;
+#if CONFIG_WINDOW_SENSOR_TAMPER
+        if (ms_until(s_next_tamper_check_ms, now) == 0) {
+            for (uint8_t i = 0; i < s_input_count; i++) {
+                // A pin mid-bounce is checked when its window settles instead
+                if (!s_inputs[i].debounce.pending) {
+                    check_tamper(i);
+                }
+            }
+            s_next_tamper_check_ms = now + TAMPER_CHECK_MS;
+        }
+#endif
+
+        flush_changes();
+    }
+}
+
+static bool add_gpio(gpio_num_t *pins, uint8_t *count, long pin)
+{
+    if (*count == WINDOW_SENSOR_MAX_INPUTS || pin < 0 || !GPIO_IS_VALID_GPIO(static_cast<gpio_num_t>(pin))) {
+        ESP_LOGW(TAG, "Ignoring contact GPIO %ld", pin);
+        return false;
+    }
+    for (uint8_t i = 0; i < *count; i++) {
+        if (pins[i] == pin) {
+            ESP_LOGW(TAG, "GPIO%ld listed twice", pin);
+            return false;
         }
+    }
+    pins[(*count)++] = static_cast<gpio_num_t>(pin);
+    return true;
+}
+
+// The NVS list wins over Kconfig, so one image can serve boards wired
+// differently
+static uint8_t load_gpios(gpio_num_t *pins)
+{
+    uint8_t count = 0;
 
-        esp_matter_attr_val_t val = esp_matter_bool(is_open);
-        attribute::update(s_endpoint_id, BooleanState::Id, BooleanState::Attributes::StateValue::Id, &val);
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t stored[WINDOW_SENSOR_MAX_INPUTS];
+        size_t len = sizeof(stored);
+        if (nvs_get_blob(nvs, NVS_KEY_GPIOS, stored, &len) == ESP_OK) {
+            for (size_t i = 0; i < len; i++) {
+                add_gpio(pins, &count, stored[i]);
+            }
+        }
+        nvs_close(nvs);
+        if (count > 0) {
+            ESP_LOGI(TAG, "Using %u contact GPIOs from NVS", count);
+            return count;
+        }
     }
+
+    add_gpio(pins, &count, CONFIG_WINDOW_SENSOR_GPIO);
+    const char *extra = CONFIG_WINDOW_SENSOR_EXTRA_GPIOS;
+    while (*extra) {
+        char *end;
+        long pin = strtol(extra, &end, 10);
+        if (end == extra) {
+            extra++;  // separator
+            continue;
+        }
+        add_gpio(pins, &count, pin);
+        extra = end;
+    }
+    return count;
 }
 
 void app_driver_gpio_init(void)
 {
+    gpio_num_t pins[WINDOW_SENSOR_MAX_INPUTS];
+    s_input_count = load_gpios(pins);
+
     gpio_config_t io_conf = {};
-    io_conf.pin_bit_mask = (1ULL << WINDOW_GPIO);
+    for (uint8_t i = 0; i < s_input_count; i++) {
+        io_conf.pin_bit_mask |= 1ULL << pins[i];
+    }
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_up_en = ACTIVE_LOW ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE;
     io_conf.pull_down_en = ACTIVE_LOW ? GPIO_PULLDOWN_DISABLE : GPIO_PULLDOWN_ENABLE;
-    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    io_conf.intr_type = GPIO_INTR_DISABLE;  // armed per level in app_driver_init()
     ESP_ERROR_CHECK(gpio_config(&io_conf));
 
-    s_last_reported_open = raw_pin_is_open();
-    ESP_LOGI(TAG, "GPIO%d configured, initial state: %s", WINDOW_GPIO, s_last_reported_open ? "OPEN" : "CLOSED");
+    for (uint8_t i = 0; i < s_input_count; i++) {
+        window_input_t &in = s_inputs[i];
+        in.gpio = pins[i];
+
+        // Keep the pull resistor and input as configured while in light sleep
+        gpio_sleep_sel_dis(in.gpio);
+
+        in.seen_level = gpio_get_level(in.gpio);
+        bool is_open = level_is_open(in.seen_level);
+        contact_debounce_init(&in.debounce, DEBOUNCE_MS, is_open);
+        ESP_LOGI(TAG, "Window %u on GPIO%d, initial state: %s", i, in.gpio, is_open ? "OPEN" : "CLOSED");
+    }
 }
 
-bool app_driver_window_is_open(void)
+uint8_t app_driver_input_count(void)
 {
-    return raw_pin_is_open();
+    return s_input_count;
 }
 
-void app_driver_init(uint16_t endpoint_id)
+int app_driver_input_gpio(uint8_t input)
 {
-    s_endpoint_id = endpoint_id;
+    return input < s_input_count ? s_inputs[input].gpio : -1;
+}
 
-    xTaskCreate(debounce_task, "window_debounce", 3072, nullptr, 5, &s_debounce_task);
+bool app_driver_window_is_open(uint8_t input)
+{
+    return input < s_input_count && level_is_open(gpio_get_level(s_inputs[input].gpio));
+}
+
+bool app_driver_input_faulted(uint8_t input)
+{
+    return input < s_input_count && s_inputs[input].faulted;
+}
+
+void app_driver_init(const uint16_t *endpoint_ids, uint8_t count)
+{
+    for (uint8_t i = 0; i < s_input_count && i < count; i++) {
+        s_inputs[i].endpoint_id = endpoint_ids[i];
+    }
 
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
-    ESP_ERROR_CHECK(gpio_isr_handler_add(WINDOW_GPIO, gpio_isr_handler, nullptr));
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+    for (uint8_t i = 0; i < s_input_count; i++) {
+        ESP_ERROR_CHECK(gpio_isr_handler_add(s_inputs[i].gpio, gpio_isr_handler,
+                                             reinterpret_cast<void *>(static_cast<uintptr_t>(i))));
+    }
+
+    // Every input starts unarmed with its holdoff already over, so the
+    // task arms them all on its first pass
+    xTaskCreate(debounce_task, "window_debounce", 3072, nullptr, 5, &s_debounce_task);
+}
+
+void app_driver_set_link_up(bool up)
+{
+    s_link_up = up;
+    if (up && s_debounce_task) {
+        xTaskNotify(s_debounce_task, NOTIFY_LINK, eSetBits);
+    }
+}
+
+esp_err_t app_driver_store_gpios(const uint8_t *gpios, uint8_t count)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (count == 0) {
+        err = nvs_erase_key(nvs, NVS_KEY_GPIOS);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else if (count > WINDOW_SENSOR_MAX_INPUTS) {
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        err = nvs_set_blob(nvs, NVS_KEY_GPIOS, gpios, count);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+void app_driver_get_stats(window_sensor_stats_t *out)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    out->mean_latency_ms = s_stats.reports ? static_cast<uint32_t>(s_latency_sum_ms / s_stats.reports) : 0;
+    portEXIT_CRITICAL(&s_stats_lock);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <esp_err.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -7,25 +8,73 @@
 extern "C" {
 #endif
 
+// Most contact inputs one board drives (also the width of the task
+// notification bits the shared ISR uses)
+#define WINDOW_SENSOR_MAX_INPUTS 16
+
 /**
- * Configure the window contact GPIO as an input (with pull resistor matching
- * CONFIG_WINDOW_SENSOR_ACTIVE_LOW). Call this before reading the initial
- * state or creating the Matter endpoint.
+ * Work out the contact GPIOs (NVS "window"/"gpios" if set, otherwise
+ * CONFIG_WINDOW_SENSOR_GPIO plus CONFIG_WINDOW_SENSOR_EXTRA_GPIOS) and
+ * configure each as an input with a pull resistor matching
+ * CONFIG_WINDOW_SENSOR_ACTIVE_LOW. Call this after nvs_flash_init() and
+ * before reading initial states or creating the Matter endpoints.
  */
 void app_driver_gpio_init(void);
 
+/** Number of contact inputs configured by app_driver_gpio_init(). */
+uint8_t app_driver_input_count(void);
+
+/** GPIO number of contact input `input`. */
+int app_driver_input_gpio(uint8_t input);
+
 /**
- * Read the current, debounced window state.
+ * Read the current window state of contact input `input`.
  * Returns true if the window is open, false if closed.
  */
-bool app_driver_window_is_open(void);
+bool app_driver_window_is_open(uint8_t input);
+
+/**
+ * True while tamper supervision (CONFIG_WINDOW_SENSOR_TAMPER) sees input
+ * `input` as open-circuit.
+ */
+bool app_driver_input_faulted(uint8_t input);
+
+/**
+ * Start the shared wake interrupt + debounce task that keeps the Matter
+ * Boolean State attribute (cluster 0x0045, attribute StateValue) on
+ * endpoint_ids[i] in sync with contact input i. Call after the
+ * contact_sensor endpoints have been created. The contact GPIOs are armed
+ * as light-sleep wake sources.
+ */
+void app_driver_init(const uint16_t *endpoint_ids, uint8_t count);
 
 /**
- * Start the interrupt + debounce task that keeps the Matter Boolean State
- * attribute (cluster 0x0045, attribute StateValue) on `endpoint_id` in sync
- * with the GPIO. Call after the contact_sensor endpoint has been created.
+ * Tell the driver whether the Matter network link (Thread or WiFi) is up.
+ * Confirmed changes are queued while it is down and applied, in order, once
+ * it comes back.
  */
-void app_driver_init(uint16_t endpoint_id);
+void app_driver_set_link_up(bool up);
+
+/**
+ * Store the contact GPIO list in NVS; it replaces the Kconfig list from the
+ * next boot. count == 0 erases it, going back to Kconfig.
+ */
+esp_err_t app_driver_store_gpios(const uint8_t *gpios, uint8_t count);
+
+typedef struct {
+    uint32_t wakes;              // GPIO wake interrupts
+    uint32_t reports;            // changes written to the Matter attribute
+    uint32_t bounce_rejections;  // edge runs that settled back to the old state
+    uint32_t queued;             // changes waiting for the link
+    uint32_t queue_dropped;      // oldest changes dropped on a full queue
+    uint32_t last_latency_ms;    // first edge -> attribute update
+    uint32_t max_latency_ms;
+    uint32_t mean_latency_ms;
+    uint32_t tamper_faults;      // inputs going open-circuit
+    uint32_t faulted;            // bit per input currently open-circuit
+} window_sensor_stats_t;
+
+void app_driver_get_stats(window_sensor_stats_t *out);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,175 @@
+// Host test for the contact debounce state machine (main/contact_debounce.c).
+//
+// Replays recorded edge timelines the way the driver sees them: each line
+// is a time the pin changed level, which is when the level-triggered wake
+// interrupt fires. Between edges the "task" sleeps until
+// contact_debounce_next_ms() and then settles with the level the pin has
+// at that moment.
+//
+// Build and run (from DormerWindowState/):
+//   gcc -std=c99 -Wall -Imain -o test_contact_debounce test/test_contact_debounce.c main/contact_debounce.c
+//   ./test_contact_debounce test/timelines/*.txt
+//
+// Timeline format, one item per line ('#' starts a comment):
+//   debounce <ms>
+//   init open|closed
+//   <ms> open|closed                         pin changes level at <ms>
+//   expect changes=<n> rejections=<n>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "contact_debounce.h"
+
+#define MAX_EDGES 256
+
+typedef struct {
+    uint32_t ms;
+    bool open;
+} edge_t;
+
+typedef struct {
+    uint32_t debounce_ms;
+    bool init_open;
+    edge_t edges[MAX_EDGES];
+    int edge_count;
+    int expect_changes;
+    int expect_rejections;
+} timeline_t;
+
+static bool parse_level(const char *word, bool *open)
+{
+    if (strcmp(word, "open") == 0) {
+        *open = true;
+    } else if (strcmp(word, "closed") == 0) {
+        *open = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool load_timeline(const char *path, timeline_t *t)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    memset(t, 0, sizeof(*t));
+    t->debounce_ms = 50;
+    t->expect_changes = -1;
+    t->expect_rejections = -1;
+
+    char line[256];
+    int line_no = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+
+        char word[32];
+        unsigned long ms;
+        unsigned n;
+        int changes, rejections;
+        if (sscanf(line, " %31s", word) != 1) {
+            continue;
+        } else if (sscanf(line, " debounce %u", &n) == 1) {
+            t->debounce_ms = n;
+        } else if (sscanf(line, " init %31s", word) == 1) {
+            ok = parse_level(word, &t->init_open);
+        } else if (sscanf(line, " expect changes=%d rejections=%d", &changes, &rejections) == 2) {
+            t->expect_changes = changes;
+            t->expect_rejections = rejections;
+        } else if (sscanf(line, " %lu %31s", &ms, word) == 2 && t->edge_count < MAX_EDGES) {
+            edge_t *e = &t->edges[t->edge_count++];
+            e->ms = (uint32_t)ms;
+            ok = parse_level(word, &e->open);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: can't parse '%s'\n", path, line_no, line);
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Settle if the window has expired by `until` (wrap-safe); returns true if it did
+static bool settle_before(contact_debounce_t *d, uint32_t until, bool pin_open)
+{
+    uint32_t expiry = d->last_edge_ms + d->debounce_ms;
+    if (!d->pending || (int32_t)(until - expiry) < 0) {
+        return false;
+    }
+
+    uint32_t latency = 0;
+    if (contact_debounce_settle(d, expiry, pin_open, &latency)) {
+        printf("  %10lu  %-6s  confirmed, %lu ms after the first edge\n", (unsigned long)expiry,
+               pin_open ? "open" : "closed", (unsigned long)latency);
+    } else {
+        printf("  %10lu  %-6s  rejected bounce\n", (unsigned long)expiry, pin_open ? "open" : "closed");
+    }
+    return true;
+}
+
+static bool run_timeline(const char *path)
+{
+    timeline_t t;
+    if (!load_timeline(path, &t)) {
+        return false;
+    }
+
+    printf("%s (debounce %lu ms)\n", path, (unsigned long)t.debounce_ms);
+
+    contact_debounce_t d;
+    contact_debounce_init(&d, t.debounce_ms, t.init_open);
+    bool pin_open = t.init_open;
+
+    for (int i = 0; i < t.edge_count; i++) {
+        settle_before(&d, t.edges[i].ms, pin_open);
+        pin_open = t.edges[i].open;
+        contact_debounce_edge(&d, t.edges[i].ms);
+    }
+    settle_before(&d, d.last_edge_ms + t.debounce_ms, pin_open);
+
+    bool ok = d.stable_open == pin_open;
+    if (!ok) {
+        printf("  FAIL: ended %s but the pin is %s\n", d.stable_open ? "open" : "closed",
+               pin_open ? "open" : "closed");
+    }
+    if (t.expect_changes >= 0 && (int)d.changes != t.expect_changes) {
+        printf("  FAIL: %lu changes, expected %d\n", (unsigned long)d.changes, t.expect_changes);
+        ok = false;
+    }
+    if (t.expect_rejections >= 0 && (int)d.bounce_rejections != t.expect_rejections) {
+        printf("  FAIL: %lu rejections, expected %d\n", (unsigned long)d.bounce_rejections, t.expect_rejections);
+        ok = false;
+    }
+    printf("  %lu edges, %lu changes, %lu rejections: %s\n\n", (unsigned long)d.edges, (unsigned long)d.changes,
+           (unsigned long)d.bounce_rejections, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s timeline.txt...\n", argv[0]);
+        return 2;
+    }
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!run_timeline(argv[i])) {
+            failed++;
+        }
+    }
+    printf("%d of %d timelines passed\n", argc - 1 - failed, argc - 1);
+    return failed ? 1 : 0;
+}
@@ -11,6 +11,26 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Kind of write the controller made to one of our endpoints
+ */
+typedef enum {
+    MATTER_COMMAND_ONOFF = 0,
+    MATTER_COMMAND_HEATING_SETPOINT,
+    MATTER_COMMAND_COOLING_SETPOINT,
+    MATTER_COMMAND_SYSTEM_MODE,
+    MATTER_COMMAND_TYPE_COUNT
+} matter_command_type_t;
+
+/**
+ * @brief A controller write, queued by the attribute callback for command_task
+ */
+typedef struct {
+    matter_command_type_t type;
+    int16_t value;              // 0/1 for OnOff, Celsius x100 for setpoints, SystemModeEnum for mode
+    TickType_t received_tick;   // when the write arrived, for end-to-end latency tracking
+} matter_command_t;
+
 /**
  * @brief Initialize Matter device endpoint
  *
@@ -151,60 +171,21 @@ void matter_update_compressor_running(bool running);
 void matter_update_outdoor_temperature(int16_t temp_c);
 
 /**
- * @brief Check if the controller sent an OnOff command
- * @return true if command is pending, false otherwise
- */
-bool matter_get_onoff_command(void);
-
-/**
- * @brief Get current desired OnOff state from Matter endpoint
- * @return true when ON is desired, false when OFF is desired
- */
-bool matter_get_onoff_state(void);
-
-/**
- * @brief Get pending heating setpoint command from the controller
- * @return Setpoint in Celsius (×100), or -1 if no pending command
- */
-int16_t matter_get_heating_setpoint_command(void);
-
-/**
- * @brief Get pending cooling setpoint command from the controller
- * @return Setpoint in Celsius (×100), or -1 if no pending command
- */
-int16_t matter_get_cooling_setpoint_command(void);
-
-/**
- * @brief Get pending system mode command from the controller
- * @return Mode (0=off, 1=heat, 2=cool, 3=auto), or 0xFF if no pending command
- */
-uint8_t matter_get_system_mode_command(void);
-
-/**
- * @brief Clear the pending OnOff command flag
- * Call after processing the command to avoid re-processing
- */
-void matter_clear_onoff_command(void);
-
-/**
- * @brief Clear the pending setpoint command flag
- */
-void matter_clear_setpoint_command(void);
-
-/**
- * @brief Clear only the pending heating setpoint command flag
- */
-void matter_clear_heating_setpoint_command(void);
-
-/**
- * @brief Clear only the pending cooling setpoint command flag
+ * @brief Wait for the next command written by the controller
+ *
+ * Commands are queued by the attribute callback the moment a write arrives,
+ * so command_task can block here instead of polling for pending flags.
+ *
+ * @param cmd Filled in with the command
+ * @param timeout Ticks to wait (portMAX_DELAY to wait forever)
+ * @return true if a command was received, false on timeout
  */
-void matter_clear_cooling_setpoint_command(void);
+bool matter_wait_for_command(matter_command_t *cmd, TickType_t timeout);
 
 /**
- * @brief Clear the pending mode command flag
+ * @brief Number of controller writes dropped because the command queue was full
  */
-void matter_clear_mode_command(void);
+uint32_t matter_get_dropped_command_count(void);
 
 /**
  * @brief Cleanup/deinit Matter device
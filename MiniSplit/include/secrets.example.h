@@ -10,4 +10,12 @@
 #define TUYA_CLIENT_ID "your_tuya_client_id"
 #define TUYA_CLIENT_SECRET "your_tuya_client_secret"
 
+// Optional: local LAN session to the indoor unit (see tuya_local.h). Leave
+// TUYA_LOCAL_KEY undefined to stay cloud-only. The host must be reachable
+// from Thread, i.e. a hostname (DNS64) or a NAT64 IPv6 literal -- a bare
+// IPv4 literal won't route. Version is 33 or 34 (protocol 3.3 / 3.4).
+// #define TUYA_LOCAL_KEY "0123456789abcdef"
+// #define TUYA_LOCAL_HOST "64:ff9b::c0a8:0132"
+// #define TUYA_LOCAL_VERSION 33
+
 #endif // APP_SECRETS_H
@@ -115,6 +115,37 @@ esp_err_t tuya_set_mode(uint8_t mode);
  */
 esp_err_t tuya_set_fresh_air(bool on);
 
+/**
+ * @brief Called when a DP change pushed over the local session has updated
+ *        the status tuya_get_device_status() will return. Runs on the local
+ *        session task, so it should only wake something (e.g. notify
+ *        sync_task), not do work itself.
+ */
+typedef void (*tuya_status_listener_t)(void);
+
+/**
+ * @brief Start the local LAN session (see tuya_local.h). Once it's up,
+ *        tuya_get_device_status() is served from pushed DP updates and the
+ *        tuya_set_*() calls go over the LAN, each falling back to the cloud
+ *        whenever the session is down or a local command isn't acked.
+ *        Call after tuya_client_init().
+ * @param host      Hostname or NAT64 IPv6 literal of the indoor unit
+ * @param local_key 16-character device local key
+ * @param version   Protocol revision: 33 (3.3) or 34 (3.4)
+ * @return ESP_OK if the session task was started
+ */
+esp_err_t tuya_client_start_local(const char *host, const char *local_key, uint8_t version);
+
+/**
+ * @brief Register the local push listener (NULL to clear)
+ */
+void tuya_client_set_status_listener(tuya_status_listener_t listener);
+
+/**
+ * @brief True while status and commands are going over the local session
+ */
+bool tuya_client_local_active(void);
+
 /**
  * @brief Refresh access token (if expired)
  * @return ESP_OK on success
@@ -0,0 +1,101 @@
+/**
+ * @file tuya_local.h
+ * @brief Local LAN session to the Tuya indoor unit (protocol 3.3 / 3.4)
+ *
+ * Talks directly to the mini-split's Wi-Fi module on TCP 6668 using the
+ * device's local key, instead of going through the Tuya Cloud API. The
+ * device pushes a STATUS frame for every DP change, and a CONTROL frame is
+ * acknowledged in well under a second, so this path is both faster and
+ * free of Cloud API quota. tuya_client.c owns the only user of this module
+ * and falls back to the cloud whenever the session is down.
+ *
+ * Frames carry DPs by numeric id ("1", "2", ...), not by code ("switch",
+ * "temp_set", ...). Translating between the two is tuya_client.c's job --
+ * it learns the mapping from the cloud shadow's dp_id field.
+ *
+ * Over Thread the unit is only reachable through the OTBR's NAT64, so the
+ * host must be a hostname (resolved via DNS64) or a NAT64-synthesized IPv6
+ * literal such as "64:ff9b::c0a8:0132" (192.168.1.50) -- a bare IPv4
+ * literal will not route.
+ */
+
+#ifndef TUYA_LOCAL_H
+#define TUYA_LOCAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TUYA_LOCAL_PORT 6668
+
+/** @brief Tuya LAN protocol revision the device speaks. */
+typedef enum {
+    TUYA_LOCAL_VERSION_3_3 = 33,   // AES-128-ECB with local key, CRC32 trailer
+    TUYA_LOCAL_VERSION_3_4 = 34,   // Negotiated session key, HMAC-SHA256 trailer
+} tuya_local_version_t;
+
+/**
+ * @brief Called from the session task for every DP report the device sends.
+ * @param dps          The "dps" object, keyed by DP id string
+ * @param full_snapshot True for a DP query response (every DP), false for a
+ *                      change push (only the DPs that changed)
+ * @param ctx          Context pointer passed to tuya_local_start()
+ */
+typedef void (*tuya_local_dps_cb_t)(const cJSON *dps, bool full_snapshot, void *ctx);
+
+/** @brief Session counters, logged by health_task. */
+typedef struct {
+    uint32_t connects;              // Successful handshakes
+    uint32_t disconnects;           // Sessions dropped (error, timeout, or device close)
+    uint32_t pushes;                // STATUS frames received
+    uint32_t commands;              // CONTROL frames acknowledged
+    uint32_t command_failures;      // CONTROL frames not acknowledged in time
+    uint32_t last_command_ms;       // Send -> ack round trip of the last command
+    uint32_t max_command_ms;
+} tuya_local_stats_t;
+
+/**
+ * @brief Start the background session task. Connects, negotiates (3.4),
+ *        requests a full DP snapshot and then keeps the session alive with
+ *        heartbeats, re-requesting the snapshot periodically and after a
+ *        missed heartbeat reply, reconnecting with backoff whenever it drops.
+ * @param host      Hostname or IPv6/NAT64 literal of the indoor unit
+ * @param device_id Tuya device id (same one the cloud API uses)
+ * @param local_key 16-character local key
+ * @param version   Protocol revision the device speaks
+ * @param dps_cb    DP report callback (runs on the session task)
+ * @param ctx       Passed through to dps_cb
+ * @return ESP_OK if the task was started
+ */
+esp_err_t tuya_local_start(const char *host, const char *device_id, const char *local_key,
+                           tuya_local_version_t version, tuya_local_dps_cb_t dps_cb, void *ctx);
+
+/**
+ * @brief True once the session is connected (and, for 3.4, negotiated).
+ */
+bool tuya_local_is_connected(void);
+
+/**
+ * @brief Send a CONTROL frame and wait for the device's acknowledgement.
+ * @param dps        DPs to set, keyed by DP id string, e.g. {"1":true,"4":"1"}
+ * @param timeout_ms How long to wait for the ack before giving up
+ * @return ESP_OK if acknowledged, ESP_ERR_INVALID_STATE if not connected,
+ *         ESP_ERR_TIMEOUT if the device never answered
+ */
+esp_err_t tuya_local_set_dps(const cJSON *dps, uint32_t timeout_ms);
+
+/**
+ * @brief Copy the session counters.
+ */
+void tuya_local_get_stats(tuya_local_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TUYA_LOCAL_H
@@ -0,0 +1,130 @@
+/**
+ * @file tuya_shadow_parser.h
+ * @brief Streaming extractor for the Tuya shadow/properties response
+ *
+ * The shadow endpoint returns every DP the device has ever reported (~75
+ * properties, 10-16KB of JSON) to get the ~11 this bridge uses. Rather than
+ * buffer the whole body and build a cJSON tree of it, the body is fed to
+ * this parser chunk by chunk straight from HTTP_EVENT_ON_DATA. It tracks
+ * only the path root.result.properties[].{code,dp_id,value} (plus the root
+ * success/code fields), recognises known DP codes through a perfect hash,
+ * and writes values directly into a tuya_device_status_t. Memory use is the
+ * fixed-size parser struct; nothing is allocated.
+ *
+ * Has no ESP-IDF dependencies beyond the tuya_client.h types, so it also
+ * builds on a host (see tools/shadow_bench/).
+ */
+
+#ifndef TUYA_SHADOW_PARSER_H
+#define TUYA_SHADOW_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tuya_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief DPs the bridge understands, by Tuya code. */
+typedef enum {
+    TUYA_DP_SWITCH,
+    TUYA_DP_TEMP_SET,
+    TUYA_DP_TEMP_CURRENT,
+    TUYA_DP_TEMP_SET_F,
+    TUYA_DP_MODE,
+    TUYA_DP_HEAT,
+    TUYA_DP_HEALTH,
+    TUYA_DP_CLEANING,
+    TUYA_DP_FRESH_AIR_VALVE,
+    TUYA_DP_COMPRESSOR_FREQUENCY,
+    TUYA_DP_URE,
+    TUYA_DP_COUNT,              // Also "not a DP we track"
+} tuya_dp_t;
+
+/**
+ * @brief Look up a DP by its Tuya code (perfect hash + one compare)
+ * @return The DP, or TUYA_DP_COUNT if the code isn't one we track
+ */
+tuya_dp_t tuya_dp_from_code(const char *code, size_t len);
+
+/**
+ * @brief Tuya code string for a DP
+ */
+const char *tuya_dp_code(tuya_dp_t dp);
+
+/**
+ * @brief Store one DP value into a status structure
+ * @param number Value for bool (0/1) and integer DPs
+ * @param text   Value for enum DPs, which Tuya sends as JSON strings
+ *               (e.g. mode "1"); NULL for non-string values
+ */
+void tuya_dp_apply(tuya_device_status_t *status, tuya_dp_t dp, int32_t number, const char *text);
+
+typedef enum {
+    TUYA_SHADOW_OK = 0,
+    TUYA_SHADOW_API_ERROR,      // success was not true; see error_code
+    TUYA_SHADOW_MALFORMED,      // Truncated or not JSON
+    TUYA_SHADOW_NO_PROPERTIES,  // Valid, successful, but no result.properties array
+} tuya_shadow_result_t;
+
+#define TUYA_SHADOW_MAX_DEPTH 16
+#define TUYA_SHADOW_TOKEN_MAX 32    // Longer strings are truncated (and can't match a code)
+
+/** @brief Parser state. Treat as opaque apart from the documented outputs. */
+typedef struct {
+    // Outputs
+    tuya_device_status_t *status;   // Written as properties are seen
+    uint8_t *dp_ids;                // [TUYA_DP_COUNT] learned dp_id per DP, or NULL
+    bool success;
+    int32_t error_code;             // Root "code", set on API errors (1010 = token invalid)
+    uint16_t properties;            // Elements seen in result.properties
+    uint16_t matched;               // ...of which were DPs we track
+
+    // Tokenizer
+    uint8_t lex;
+    uint8_t depth;
+    uint8_t tracked_depth;          // Deepest open container on the root.result.properties[] path
+    uint16_t array_mask;            // Bit d set = container at depth d is an array
+    bool expect_key;
+    bool escape;
+    bool malformed;
+    bool properties_found;
+    uint8_t key;                    // Most recent recognised key in the current object
+    char token[TUYA_SHADOW_TOKEN_MAX];
+    uint8_t token_len;
+    bool token_truncated;
+
+    // Current properties[] element (fields can arrive in any order)
+    uint8_t elem_dp;
+    int16_t elem_dp_id;
+    bool elem_has_value;
+    bool elem_value_is_text;
+    int32_t elem_number;
+    char elem_text[8];              // Enum DP values are short ("0".."4")
+} tuya_shadow_parser_t;
+
+/**
+ * @brief Reset the parser for a new response
+ * @param status Destination; zeroed here, then filled as DPs are parsed
+ * @param dp_ids Optional [TUYA_DP_COUNT] table that receives each tracked
+ *               DP's numeric dp_id (used by the local session), or NULL
+ */
+void tuya_shadow_parser_init(tuya_shadow_parser_t *parser, tuya_device_status_t *status, uint8_t *dp_ids);
+
+/**
+ * @brief Feed the next chunk of the response body (any split is fine)
+ */
+void tuya_shadow_parser_feed(tuya_shadow_parser_t *parser, const char *data, size_t len);
+
+/**
+ * @brief Finish after the last chunk and report the outcome
+ */
+tuya_shadow_result_t tuya_shadow_parser_finish(tuya_shadow_parser_t *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TUYA_SHADOW_PARSER_H
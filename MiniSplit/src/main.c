@@ -9,8 +9,10 @@
 #include "esp_sntp.h"
 #include <time.h>
 #include <math.h>
+#include <inttypes.h>
 
 #include "tuya_client.h"
+#include "tuya_local.h"
 #include "matter_device.h"
 #include "bme280.h"
 #include "secrets.h"
@@ -72,7 +74,8 @@ static uint32_t g_power_expectation_tick = 0;
 // current_status_poll_interval_ms() below.
 #define STATUS_POLL_INTERVAL_ACTIVE_MS 30000    // While a command confirmation is pending
 #define STATUS_POLL_INTERVAL_IDLE_MS 300000     // Otherwise: every 5 minutes
-#define COMMAND_POLL_INTERVAL_MS 5000    // Check Matter commands every 5 seconds
+#define STATUS_POLL_INTERVAL_LOCAL_MS 15000     // Local session up: reads are served from pushed DPs, no quota cost
+#define COMMAND_COALESCE_MS 750          // After a Matter write, wait this long for more (e.g. a setpoint drag) before calling Tuya
 #define ENV_POLL_INTERVAL_MS 30000       // Read BME280 every 30 seconds
 #define RETRY_DELAY_MS 2000               // Base delay before retry on error (doubles per attempt)
 #define MAX_RETRIES 3                     // Retry up to 3 times before giving up
@@ -80,9 +83,14 @@ static uint32_t g_power_expectation_tick = 0;
 
 // Fast-poll only while a local command is still waiting on Tuya's shadow to
 // confirm it (see the expectation-tracking block above); otherwise fall back
-// to the slow idle interval to conserve Tuya Cloud API quota.
+// to the slow idle interval to conserve Tuya Cloud API quota. Neither limit
+// applies while the LAN session is up -- tuya_get_device_status() is then a
+// copy of pushed state, and pushes wake sync_task directly anyway.
 static uint32_t current_status_poll_interval_ms(void)
 {
+    if (tuya_client_local_active()) {
+        return STATUS_POLL_INTERVAL_LOCAL_MS;
+    }
     bool expectation_pending = (g_expected_setpoint_f >= 0) ||
                                 (g_expected_mode >= 0) ||
                                 (g_expected_power >= 0);
@@ -97,8 +105,34 @@ typedef struct {
     uint8_t network_disconnects;        // Count of connectivity drops
 } sync_state_t;
 
+// Matter write -> Tuya send latency, measured from when the attribute
+// callback queued the (first, if coalesced) write to when the Tuya call
+// returned. Only calls that succeeded count towards it. Logged by
+// health_task.
+typedef struct {
+    uint32_t commands_sent;             // Tuya calls that succeeded for Matter writes
+    uint32_t commands_failed;           // Tuya calls that failed (unit reverted to last status)
+    uint32_t writes_coalesced;          // Matter writes folded into a later one of the same type
+    uint32_t last_latency_ms;
+    uint32_t max_latency_ms;
+    uint64_t total_latency_ms;
+} command_stats_t;
+
+static command_stats_t g_command_stats = {0};
+
 static sync_state_t g_sync_state = {0};
 
+static TaskHandle_t g_sync_task_handle = NULL;
+
+// Local session push listener: cut sync_task's current wait short so the
+// pushed change reaches Matter immediately instead of at the next poll.
+static void on_local_status_push(void)
+{
+    if (g_sync_task_handle) {
+        xTaskNotifyGive(g_sync_task_handle);
+    }
+}
+
 static int16_t normalize_tuya_setpoint(int16_t temp_c)
 {
     // Delegates to the shared helper so this matches exactly what
@@ -311,9 +345,13 @@ static void sync_task(void *param)
             // the 30s active interval) had no effect until that already-
             // committed 5-minute sleep finished -- leaving a stale/incorrect
             // value sitting in the UI the whole time.
+            //
+            // A local session push (on_local_status_push) ends the wait early.
             uint32_t waited_ms = 0;
             while (waited_ms < current_status_poll_interval_ms()) {
-                vTaskDelay(pdMS_TO_TICKS(POLL_WAIT_GRANULARITY_MS));
+                if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POLL_WAIT_GRANULARITY_MS)) > 0) {
+                    break;
+                }
                 waited_ms += POLL_WAIT_GRANULARITY_MS;
             }
         }
@@ -424,164 +462,195 @@ static void sync_task(void *param)
     }
 }
 
+static void record_command_result(TickType_t received_tick, esp_err_t result)
+{
+    if (result == ESP_ERR_NOT_SUPPORTED) {
+        return;     // nothing was sent
+    }
+    if (result != ESP_OK) {
+        g_command_stats.commands_failed++;
+        return;
+    }
+
+    uint32_t latency_ms = pdTICKS_TO_MS(xTaskGetTickCount() - received_tick);
+    g_command_stats.commands_sent++;
+    g_command_stats.last_latency_ms = latency_ms;
+    g_command_stats.total_latency_ms += latency_ms;
+    if (latency_ms > g_command_stats.max_latency_ms) {
+        g_command_stats.max_latency_ms = latency_ms;
+    }
+}
+
+static esp_err_t handle_onoff_command(bool desired_onoff)
+{
+    ESP_LOGI(TAG, "Processing OnOff command from controller: %s",
+             desired_onoff ? "ON" : "OFF");
+
+    esp_err_t result = tuya_set_power(desired_onoff);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send power command to Tuya");
+        revert_from_last_status_if_available();
+    } else {
+        g_expected_power = desired_onoff ? 1 : 0;
+        g_power_expectation_tick = xTaskGetTickCount();
+        ESP_LOGI(TAG, "Power command sent successfully");
+    }
+    return result;
+}
+
+static esp_err_t handle_setpoint_command(int16_t setpoint_cmd, const char *which)
+{
+    ESP_LOGI(TAG, "Processing %s setpoint command: %.1f°C", which, setpoint_cmd / 100.0f);
+
+    // Send to Tuya. Confirmation against Tuya's shadow happens in
+    // sync_task's next poll(s) via g_expected_setpoint -- see its
+    // definition above for why an immediate verify-poll here isn't
+    // used (it's redundant with that reconciliation, and each one
+    // is an extra blocking Tuya round-trip we don't need).
+    int16_t expected_setpoint = normalize_tuya_setpoint(setpoint_cmd);
+    esp_err_t result = tuya_set_temperature(expected_setpoint);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send %s temperature command to Tuya", which);
+        revert_from_last_status_if_available();
+    } else {
+        g_expected_setpoint = expected_setpoint;
+        g_expected_setpoint_f = tuya_setpoint_c_to_f(expected_setpoint);
+        g_setpoint_expectation_tick = xTaskGetTickCount();
+        ESP_LOGI(TAG, "Temperature command sent (expecting setpoint=%d, %dF)",
+                 expected_setpoint, g_expected_setpoint_f);
+    }
+    return result;
+}
+
+static esp_err_t handle_mode_command(uint8_t mode_cmd)
+{
+    ESP_LOGI(TAG, "Processing mode command from controller: %u", mode_cmd);
+
+    esp_err_t result;
+    uint8_t expected_tuya_mode;
+    if (mode_cmd == 0) {
+        // kOff from HA/Matter: rather than powering the unit fully
+        // down (tuya_set_power(false)), which would also stop the
+        // fresh-air intake fan, switch to Tuya's "fan" mode instead.
+        // This keeps the indoor blower running and the fresh-air
+        // valve usable, just without active cooling -- matches how
+        // the BME280 thermostat cycles "off" during normal setpoint
+        // control, where a full power-down each cycle isn't wanted.
+        expected_tuya_mode = 3;
+        result = tuya_set_mode(expected_tuya_mode);
+        if (result == ESP_OK) {
+            tuya_set_fresh_air(true);
+        }
+    } else {
+        int8_t tuya_mode = map_matter_mode_to_tuya(mode_cmd);
+        if (tuya_mode < 0) {
+            ESP_LOGW(TAG, "Matter mode %u has no Tuya equivalent, ignoring", mode_cmd);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        expected_tuya_mode = (uint8_t)tuya_mode;
+
+        // Selecting a real operating mode implies the unit should be
+        // running -- without this, map_tuya_mode_to_matter always
+        // reports Off while switch_state is false regardless of
+        // ac_mode, so a mode command sent while the unit is off has
+        // no visible effect in the driver. Only fires when we last
+        // saw it off, to avoid a redundant Tuya call otherwise.
+        if (g_last_device_status_valid && !g_last_device_status.switch_state) {
+            esp_err_t power_result = tuya_set_power(true);
+            if (power_result == ESP_OK) {
+                g_expected_power = 1;
+                g_power_expectation_tick = xTaskGetTickCount();
+                ESP_LOGI(TAG, "Powering on unit to apply mode command");
+            } else {
+                ESP_LOGW(TAG, "Failed to power on unit before mode command");
+            }
+        }
+
+        result = tuya_set_mode(expected_tuya_mode);
+    }
+
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send mode command to Tuya");
+        revert_from_last_status_if_available();
+    } else {
+        // Confirmation happens in sync_task's next poll(s) via
+        // g_expected_mode -- see the immediate-verify note in the
+        // setpoint handlers above for why no verify-poll is done here.
+        g_expected_mode = (int8_t)expected_tuya_mode;
+        g_mode_expectation_tick = xTaskGetTickCount();
+        // Any explicit mode command -- including a genuine Fan Only
+        // selection -- reflects the user's real intent from here on,
+        // so it always overrides the fan-idle-proxy latch.
+        g_mode_off_via_fan_proxy = (mode_cmd == 0);
+        ESP_LOGI(TAG, "Mode command sent (expecting mode=%u)%s", expected_tuya_mode,
+                 g_mode_off_via_fan_proxy ? " [Off via fan-idle proxy]" : "");
+    }
+    return result;
+}
+
 /**
- * @brief Command routing task: checks for Matter commands and sends to Tuya
+ * @brief Command routing task: waits for Matter commands and sends them to Tuya
  * 
  * Flow:
- * 1. Check if the controller sent any commands
- * 2. Route to appropriate Tuya API call
- * 3. Clear command flag after processing
- * 4. Handle errors gracefully
+ * 1. Block on the Matter command queue until the controller writes something
+ * 2. Keep collecting for COMMAND_COALESCE_MS so a burst of writes (e.g. a
+ *    setpoint slider drag) becomes one Tuya call per command type, latest
+ *    value wins
+ * 3. Route each to the appropriate Tuya API call, in the same order the old
+ *    poll loop used (power, setpoints, then mode)
+ * 4. Handle errors gracefully and record latency (successes) and failures
+ *    for health_task
  */
 static void command_task(void *param)
 {
-    ESP_LOGI(TAG, "Command routing task started (interval: %ums)", 
-             COMMAND_POLL_INTERVAL_MS);
-    
-    // Initial delay
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG, "Command routing task started (coalesce window: %ums)", 
+             COMMAND_COALESCE_MS);
     
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(COMMAND_POLL_INTERVAL_MS));
-        
-        g_sync_state.last_command_check = xTaskGetTickCount();
-        
-        // ===== Check for OnOff command from Matter =====
-        bool onoff_pending = matter_get_onoff_command();
-        if (onoff_pending) {
-            bool desired_onoff = matter_get_onoff_state();
-            ESP_LOGI(TAG, "Processing OnOff command from controller: %s",
-                     desired_onoff ? "ON" : "OFF");
-
-            esp_err_t result = tuya_set_power(desired_onoff);
-            if (result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send power command to Tuya");
-                revert_from_last_status_if_available();
-            } else {
-                g_expected_power = desired_onoff ? 1 : 0;
-                g_power_expectation_tick = xTaskGetTickCount();
-                ESP_LOGI(TAG, "Power command sent successfully");
-            }
-
-            matter_clear_onoff_command();
-        }
-        
-        // ===== Check for Heating Setpoint command =====
-        int16_t heat_setpoint_cmd = matter_get_heating_setpoint_command();
-        if (heat_setpoint_cmd >= 0) {
-            ESP_LOGI(TAG, "Processing heating setpoint command: %.1f°C", 
-                     heat_setpoint_cmd / 100.0f);
-            
-            // Send to Tuya. Confirmation against Tuya's shadow happens in
-            // sync_task's next poll(s) via g_expected_setpoint -- see its
-            // definition above for why an immediate verify-poll here isn't
-            // used (it's redundant with that reconciliation, and each one
-            // is an extra blocking Tuya round-trip we don't need).
-            int16_t expected_setpoint = normalize_tuya_setpoint(heat_setpoint_cmd);
-            esp_err_t result = tuya_set_temperature(expected_setpoint);
-            if (result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send temperature command to Tuya");
-                revert_from_last_status_if_available();
-            } else {
-                g_expected_setpoint = expected_setpoint;
-                g_expected_setpoint_f = tuya_setpoint_c_to_f(expected_setpoint);
-                g_setpoint_expectation_tick = xTaskGetTickCount();
-                ESP_LOGI(TAG, "Temperature command sent (expecting setpoint=%d, %dF)",
-                         expected_setpoint, g_expected_setpoint_f);
-            }
-
-            matter_clear_heating_setpoint_command();
+        matter_command_t cmd;
+        if (!matter_wait_for_command(&cmd, portMAX_DELAY)) {
+            continue;
         }
 
-        // ===== Check for Cooling Setpoint command =====
-        int16_t cool_setpoint_cmd = matter_get_cooling_setpoint_command();
-        if (cool_setpoint_cmd >= 0) {
-            ESP_LOGI(TAG, "Processing cooling setpoint command: %.1f°C",
-                     cool_setpoint_cmd / 100.0f);
-
-            int16_t expected_setpoint = normalize_tuya_setpoint(cool_setpoint_cmd);
-            esp_err_t result = tuya_set_temperature(expected_setpoint);
-            if (result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send cooling temperature command to Tuya");
-                revert_from_last_status_if_available();
-            } else {
-                g_expected_setpoint = expected_setpoint;
-                g_expected_setpoint_f = tuya_setpoint_c_to_f(expected_setpoint);
-                g_setpoint_expectation_tick = xTaskGetTickCount();
-                ESP_LOGI(TAG, "Cooling command sent (expecting setpoint=%d, %dF)",
-                         expected_setpoint, g_expected_setpoint_f);
-            }
-
-            matter_clear_cooling_setpoint_command();
-        }
-        
-        // ===== Check for System Mode command =====
-        uint8_t mode_cmd = matter_get_system_mode_command();
-        if (mode_cmd != 0xFF) {  // 0xFF = no command
-            ESP_LOGI(TAG, "Processing mode command from controller: %u", mode_cmd);
-
-            esp_err_t result;
-            uint8_t expected_tuya_mode;
-            if (mode_cmd == 0) {
-                // kOff from HA/Matter: rather than powering the unit fully
-                // down (tuya_set_power(false)), which would also stop the
-                // fresh-air intake fan, switch to Tuya's "fan" mode instead.
-                // This keeps the indoor blower running and the fresh-air
-                // valve usable, just without active cooling -- matches how
-                // the BME280 thermostat cycles "off" during normal setpoint
-                // control, where a full power-down each cycle isn't wanted.
-                expected_tuya_mode = 3;
-                result = tuya_set_mode(expected_tuya_mode);
-                if (result == ESP_OK) {
-                    tuya_set_fresh_air(true);
-                }
-            } else {
-                int8_t tuya_mode = map_matter_mode_to_tuya(mode_cmd);
-                if (tuya_mode < 0) {
-                    ESP_LOGW(TAG, "Matter mode %u has no Tuya equivalent, ignoring", mode_cmd);
-                    matter_clear_mode_command();
-                    continue;
-                }
-                expected_tuya_mode = (uint8_t)tuya_mode;
-
-                // Selecting a real operating mode implies the unit should be
-                // running -- without this, map_tuya_mode_to_matter always
-                // reports Off while switch_state is false regardless of
-                // ac_mode, so a mode command sent while the unit is off has
-                // no visible effect in the driver. Only fires when we last
-                // saw it off, to avoid a redundant Tuya call otherwise.
-                if (g_last_device_status_valid && !g_last_device_status.switch_state) {
-                    esp_err_t power_result = tuya_set_power(true);
-                    if (power_result == ESP_OK) {
-                        g_expected_power = 1;
-                        g_power_expectation_tick = xTaskGetTickCount();
-                        ESP_LOGI(TAG, "Powering on unit to apply mode command");
-                    } else {
-                        ESP_LOGW(TAG, "Failed to power on unit before mode command");
-                    }
+        // Latest value per type wins, but latency is measured from the
+        // first write so a long drag counts against us.
+        matter_command_t pending[MATTER_COMMAND_TYPE_COUNT];
+        bool has_pending[MATTER_COMMAND_TYPE_COUNT] = {false};
+        TickType_t window_start = xTaskGetTickCount();
+        TickType_t window_ticks = pdMS_TO_TICKS(COMMAND_COALESCE_MS);
+        while (1) {
+            if (cmd.type < MATTER_COMMAND_TYPE_COUNT) {
+                if (has_pending[cmd.type]) {
+                    g_command_stats.writes_coalesced++;
+                    cmd.received_tick = pending[cmd.type].received_tick;
                 }
-
-                result = tuya_set_mode(expected_tuya_mode);
+                pending[cmd.type] = cmd;
+                has_pending[cmd.type] = true;
             }
 
-            if (result != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to send mode command to Tuya");
-                revert_from_last_status_if_available();
-            } else {
-                // Confirmation happens in sync_task's next poll(s) via
-                // g_expected_mode -- see the immediate-verify note in the
-                // setpoint handlers above for why no verify-poll is done here.
-                g_expected_mode = (int8_t)expected_tuya_mode;
-                g_mode_expectation_tick = xTaskGetTickCount();
-                // Any explicit mode command -- including a genuine Fan Only
-                // selection -- reflects the user's real intent from here on,
-                // so it always overrides the fan-idle-proxy latch.
-                g_mode_off_via_fan_proxy = (mode_cmd == 0);
-                ESP_LOGI(TAG, "Mode command sent (expecting mode=%u)%s", expected_tuya_mode,
-                         g_mode_off_via_fan_proxy ? " [Off via fan-idle proxy]" : "");
+            TickType_t elapsed = xTaskGetTickCount() - window_start;
+            if (elapsed >= window_ticks || !matter_wait_for_command(&cmd, window_ticks - elapsed)) {
+                break;
             }
+        }
 
-            matter_clear_mode_command();
+        g_sync_state.last_command_check = xTaskGetTickCount();
+        
+        if (has_pending[MATTER_COMMAND_ONOFF]) {
+            esp_err_t result = handle_onoff_command(pending[MATTER_COMMAND_ONOFF].value != 0);
+            record_command_result(pending[MATTER_COMMAND_ONOFF].received_tick, result);
+        }
+        if (has_pending[MATTER_COMMAND_HEATING_SETPOINT]) {
+            esp_err_t result = handle_setpoint_command(pending[MATTER_COMMAND_HEATING_SETPOINT].value, "heating");
+            record_command_result(pending[MATTER_COMMAND_HEATING_SETPOINT].received_tick, result);
+        }
+        if (has_pending[MATTER_COMMAND_COOLING_SETPOINT]) {
+            esp_err_t result = handle_setpoint_command(pending[MATTER_COMMAND_COOLING_SETPOINT].value, "cooling");
+            record_command_result(pending[MATTER_COMMAND_COOLING_SETPOINT].received_tick, result);
+        }
+        if (has_pending[MATTER_COMMAND_SYSTEM_MODE]) {
+            esp_err_t result = handle_mode_command((uint8_t)pending[MATTER_COMMAND_SYSTEM_MODE].value);
+            record_command_result(pending[MATTER_COMMAND_SYSTEM_MODE].received_tick, result);
         }
     }
 }
@@ -672,6 +741,29 @@ static void health_task(void *param)
         ESP_LOGI(TAG, "Last Status Update: %ums ago",
                  (xTaskGetTickCount() - g_sync_state.last_status_update));
         
+        // Matter -> Tuya command latency
+        ESP_LOGI(TAG, "Commands Sent: %" PRIu32 ", failed: %" PRIu32 " (coalesced writes: %" PRIu32 ", dropped: %" PRIu32 ")",
+                 g_command_stats.commands_sent, g_command_stats.commands_failed,
+                 g_command_stats.writes_coalesced, matter_get_dropped_command_count());
+        if (g_command_stats.commands_sent > 0) {
+            ESP_LOGI(TAG, "Command Latency: last %" PRIu32 "ms, avg %" PRIu32 "ms, max %" PRIu32 "ms",
+                     g_command_stats.last_latency_ms,
+                     (uint32_t)(g_command_stats.total_latency_ms / g_command_stats.commands_sent),
+                     g_command_stats.max_latency_ms);
+        }
+
+        // Tuya LAN session
+        tuya_local_stats_t local_stats;
+        tuya_local_get_stats(&local_stats);
+        ESP_LOGI(TAG, "Local Session: %s (connects: %" PRIu32 ", drops: %" PRIu32 ", pushes: %" PRIu32 ")",
+                 tuya_client_local_active() ? "UP" : "DOWN (cloud fallback)",
+                 local_stats.connects, local_stats.disconnects, local_stats.pushes);
+        if (local_stats.commands > 0 || local_stats.command_failures > 0) {
+            ESP_LOGI(TAG, "Local Commands: %" PRIu32 " acked, %" PRIu32 " failed, last %" PRIu32 "ms, max %" PRIu32 "ms",
+                     local_stats.commands, local_stats.command_failures,
+                     local_stats.last_command_ms, local_stats.max_command_ms);
+        }
+
         // Get free memory
         ESP_LOGI(TAG, "Free Heap: %u bytes", esp_get_free_heap_size());
         
@@ -746,6 +838,15 @@ void app_main(void)
         TUYA_CLIENT_SECRET
     ));
 
+#ifdef TUYA_LOCAL_KEY
+    // Optional LAN session to the indoor unit; the cloud stays the fallback.
+    // Listener registered first so the first push can't be missed.
+    tuya_client_set_status_listener(on_local_status_push);
+    if (tuya_client_start_local(TUYA_LOCAL_HOST, TUYA_LOCAL_KEY, TUYA_LOCAL_VERSION) != ESP_OK) {
+        ESP_LOGW(TAG, "Tuya local session not started; using cloud only");
+    }
+#endif
+
     // Initialize optional BME280 environment sensor (temperature + humidity).
     // If absent, the aux temperature endpoint falls back to the Tuya indoor temp.
     if (bme280_init() == ESP_OK) {
@@ -767,7 +868,7 @@ void app_main(void)
                 16384,              // Stack size
                 NULL,               // Parameters
                 4,                  // Priority
-                NULL);              // Task handle
+                &g_sync_task_handle); // Task handle (local session pushes notify it)
     
     // Command routing task (Matter → Tuya)
     xTaskCreate(command_task,
@@ -780,7 +881,7 @@ void app_main(void)
     // Health monitoring task
     xTaskCreate(health_task,
                 "health_monitor",
-                2048,
+                3072,               // Room for the 64-bit latency math in its logging
                 NULL,
                 2,
                 NULL);
@@ -788,6 +889,6 @@ void app_main(void)
     ESP_LOGI(TAG, "\n=== MiniSplit Matter Bridge Ready ===");
     ESP_LOGI(TAG, "Status Sync Interval: idle %ums / active %ums",
              STATUS_POLL_INTERVAL_IDLE_MS, STATUS_POLL_INTERVAL_ACTIVE_MS);
-    ESP_LOGI(TAG, "Command Poll Interval: %ums", COMMAND_POLL_INTERVAL_MS);
+    ESP_LOGI(TAG, "Command Coalesce Window: %ums", COMMAND_COALESCE_MS);
     ESP_LOGI(TAG, "Status: Waiting for Matter commissioning...\n");
 }
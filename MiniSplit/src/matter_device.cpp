@@ -4,6 +4,7 @@
  */
 
 #include "matter_device.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 #include "esp_matter.h"
@@ -93,10 +94,6 @@ typedef struct {
     uint8_t system_mode;
     uint8_t compressor_demand;
     int16_t outdoor_temp;
-    bool onoff_command_pending;
-    int16_t heating_setpoint_command_pending;
-    int16_t cooling_setpoint_command_pending;
-    uint8_t mode_command_pending;
 } matter_device_state_t;
 
 static matter_device_state_t g_matter_state = {
@@ -109,12 +106,15 @@ static matter_device_state_t g_matter_state = {
     .system_mode = 3,
     .compressor_demand = 0,
     .outdoor_temp = 0,
-    .onoff_command_pending = false,
-    .heating_setpoint_command_pending = INT16_MIN,
-    .cooling_setpoint_command_pending = INT16_MIN,
-    .mode_command_pending = 0xFF,
 };
 
+// Controller writes, handed from the attribute callback to command_task.
+// Sized well past a fast setpoint-slider drag; command_task coalesces
+// whatever piles up, so overflow only drops intermediate values.
+#define COMMAND_QUEUE_LENGTH 16
+static QueueHandle_t g_command_queue = nullptr;
+static uint32_t g_dropped_commands = 0;
+
 static node_t *g_node = nullptr;
 static endpoint_t *g_endpoint = nullptr;
 static endpoint_t *g_temp_sensor_endpoint = nullptr;
@@ -170,6 +170,20 @@ static esp_err_t update_attr(uint32_t cluster_id, uint32_t attribute_id, esp_mat
     return update_attr_on_endpoint(g_endpoint, g_endpoint_id, cluster_id, attribute_id, val);
 }
 
+static void queue_command(matter_command_type_t type, int16_t value)
+{
+    matter_command_t cmd = {
+        .type = type,
+        .value = value,
+        .received_tick = xTaskGetTickCount(),
+    };
+    if (!g_command_queue || xQueueSend(g_command_queue, &cmd, 0) != pdTRUE) {
+        g_dropped_commands++;
+        ESP_LOGW(TAG, "Command queue full, dropped command type %d (dropped so far: %" PRIu32 ")",
+                 type, g_dropped_commands);
+    }
+}
+
 static esp_err_t matter_attribute_callback(attribute::callback_type_t type,
                                            uint16_t endpoint_id,
                                            uint32_t cluster_id,
@@ -195,7 +209,7 @@ static esp_err_t matter_attribute_callback(attribute::callback_type_t type,
 
     if (cluster_id == OnOff::Id && attribute_id == OnOff::Attributes::OnOff::Id) {
         g_matter_state.onoff = val->val.b;
-        g_matter_state.onoff_command_pending = true;
+        queue_command(MATTER_COMMAND_ONOFF, g_matter_state.onoff ? 1 : 0);
         ESP_LOGI(TAG, "OnOff command from Matter (endpoint %u, %s): %s", endpoint_id,
                  endpoint_id == g_power_endpoint_id ? "true power" : "thermostat",
                  g_matter_state.onoff ? "ON" : "OFF");
@@ -205,15 +219,15 @@ static esp_err_t matter_attribute_callback(attribute::callback_type_t type,
     if (cluster_id == Thermostat::Id) {
         if (attribute_id == Thermostat::Attributes::OccupiedHeatingSetpoint::Id) {
             g_matter_state.heating_setpoint = val->val.i16;
-            g_matter_state.heating_setpoint_command_pending = g_matter_state.heating_setpoint;
+            queue_command(MATTER_COMMAND_HEATING_SETPOINT, g_matter_state.heating_setpoint);
             ESP_LOGI(TAG, "Heating setpoint command: %d", g_matter_state.heating_setpoint);
         } else if (attribute_id == Thermostat::Attributes::OccupiedCoolingSetpoint::Id) {
             g_matter_state.cooling_setpoint = val->val.i16;
-            g_matter_state.cooling_setpoint_command_pending = g_matter_state.cooling_setpoint;
+            queue_command(MATTER_COMMAND_COOLING_SETPOINT, g_matter_state.cooling_setpoint);
             ESP_LOGI(TAG, "Cooling setpoint command: %d", g_matter_state.cooling_setpoint);
         } else if (attribute_id == Thermostat::Attributes::SystemMode::Id) {
             g_matter_state.system_mode = val->val.u8;
-            g_matter_state.mode_command_pending = g_matter_state.system_mode;
+            queue_command(MATTER_COMMAND_SYSTEM_MODE, g_matter_state.system_mode);
             ESP_LOGI(TAG, "System mode command: %u", g_matter_state.system_mode);
         }
     }
@@ -225,6 +239,12 @@ extern "C" esp_err_t matter_device_init(void)
 {
     ESP_LOGI(TAG, "Initializing Matter device...");
 
+    g_command_queue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(matter_command_t));
+    if (!g_command_queue) {
+        ESP_LOGE(TAG, "Failed to create command queue");
+        return ESP_ERR_NO_MEM;
+    }
+
     // Without this, Basic Information's NodeLabel stays empty and Home
     // Assistant falls back to a generic "Node <id>" device name.
     node::config_t node_cfg;
@@ -582,61 +602,17 @@ extern "C" void matter_update_aux_humidity(uint16_t humidity_centi_pct)
                             esp_matter_nullable_uint16(nullable<uint16_t>(humidity_centi_pct)));
 }
 
-extern "C" bool matter_get_onoff_command(void)
-{
-    return g_matter_state.onoff_command_pending;
-}
-
-extern "C" bool matter_get_onoff_state(void)
-{
-    return g_matter_state.onoff;
-}
-
-extern "C" int16_t matter_get_heating_setpoint_command(void)
-{
-    if (g_matter_state.heating_setpoint_command_pending == INT16_MIN) {
-        return -1;
-    }
-    return g_matter_state.heating_setpoint_command_pending;
-}
-
-extern "C" int16_t matter_get_cooling_setpoint_command(void)
+extern "C" bool matter_wait_for_command(matter_command_t *cmd, TickType_t timeout)
 {
-    if (g_matter_state.cooling_setpoint_command_pending == INT16_MIN) {
-        return -1;
+    if (!g_command_queue || !cmd) {
+        return false;
     }
-    return g_matter_state.cooling_setpoint_command_pending;
-}
-
-extern "C" uint8_t matter_get_system_mode_command(void)
-{
-    return g_matter_state.mode_command_pending;
-}
-
-extern "C" void matter_clear_onoff_command(void)
-{
-    g_matter_state.onoff_command_pending = false;
-}
-
-extern "C" void matter_clear_setpoint_command(void)
-{
-    g_matter_state.heating_setpoint_command_pending = INT16_MIN;
-    g_matter_state.cooling_setpoint_command_pending = INT16_MIN;
-}
-
-extern "C" void matter_clear_heating_setpoint_command(void)
-{
-    g_matter_state.heating_setpoint_command_pending = INT16_MIN;
-}
-
-extern "C" void matter_clear_cooling_setpoint_command(void)
-{
-    g_matter_state.cooling_setpoint_command_pending = INT16_MIN;
+    return xQueueReceive(g_command_queue, cmd, timeout) == pdTRUE;
 }
 
-extern "C" void matter_clear_mode_command(void)
+extern "C" uint32_t matter_get_dropped_command_count(void)
 {
-    g_matter_state.mode_command_pending = 0xFF;
+    return g_dropped_commands;
 }
 
 extern "C" void matter_device_deinit(void)
@@ -1,7 +1,11 @@
 // Tuya Client Implementation - Phase 1: API Communication
-// Implements HMAC-SHA256 signed requests to Tuya Cloud API
+// Implements HMAC-SHA256 signed requests to Tuya Cloud API, with an optional
+// local LAN session (tuya_local.c) tried first when it's up.
 
 #include "tuya_client.h"
+#include "tuya_local.h"
+#include "tuya_shadow_parser.h"
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
@@ -31,6 +35,15 @@ static const char *TAG = "TUYA_CLIENT";
 // transient allocation, freed immediately after each request/response cycle.
 #define HTTP_BUFFER_SIZE 16384
 
+// The shadow response is streamed through tuya_shadow_parser.c instead of
+// being accumulated, so esp_http_client's own receive buffer only needs to
+// hold one chunk (and the response headers) -- not the whole body.
+#define SHADOW_HTTP_BUFFER_SIZE 2048
+
+// A local CONTROL frame is normally acked in ~100ms; past this the session is
+// presumed wedged and the command goes to the cloud instead.
+#define LOCAL_COMMAND_TIMEOUT_MS 1500
+
 typedef struct {
     char device_id[64];
     char client_id[64];
@@ -39,15 +52,31 @@ typedef struct {
     uint64_t token_expiry_ms;
 } tuya_client_context_t;
 
+// Either accumulates the body into buffer, or (parser set) streams each
+// chunk straight into the shadow parser without keeping it.
 typedef struct {
     char *buffer;
     size_t capacity;
     size_t length;
     bool overflow;
+    tuya_shadow_parser_t *parser;
 } http_response_accumulator_t;
 
 static tuya_client_context_t g_tuya_ctx = {0};
 
+// Local session state. The local protocol addresses DPs by number rather
+// than code; g_dp_ids[] isn't hardcoded for this model but learned from the
+// dp_id field of every cloud shadow read (0 until then), so the local path
+// only starts translating once one cloud read has succeeded.
+// g_local_status is the device's state as last reported over the LAN
+// (seeded by cloud reads), and becomes authoritative for
+// tuya_get_device_status() once valid and the session is up.
+static uint8_t g_dp_ids[TUYA_DP_COUNT] = {0};
+static tuya_device_status_t g_local_status = {0};
+static bool g_local_status_valid = false;
+static portMUX_TYPE g_local_status_lock = portMUX_INITIALIZER_UNLOCKED;
+static tuya_status_listener_t g_status_listener = NULL;
+
 /**
  * @brief Calculate current time in milliseconds since epoch
  */
@@ -186,6 +215,11 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
             if (evt->user_data && evt->data && evt->data_len > 0) {
                 http_response_accumulator_t *acc = (http_response_accumulator_t *)evt->user_data;
+                if (acc->parser) {
+                    tuya_shadow_parser_feed(acc->parser, (const char *)evt->data, evt->data_len);
+                    acc->length += evt->data_len;
+                    break;
+                }
                 size_t remaining = (acc->capacity > acc->length) ? (acc->capacity - acc->length - 1) : 0;
                 size_t to_copy = (evt->data_len < remaining) ? evt->data_len : remaining;
                 if (to_copy > 0) {
@@ -211,16 +245,17 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 }
 
 /**
- * @brief Make signed HTTP request to Tuya API
+ * @brief Make signed HTTP request to Tuya API, delivering the body to acc
+ * @param buffer_size esp_http_client receive buffer size
  */
-static esp_err_t tuya_api_request(
+static esp_err_t tuya_api_perform(
     const char *method,
     const char *endpoint,
     const char *request_body,
-    char *response_buffer,
-    size_t response_buffer_len)
+    http_response_accumulator_t *response_acc,
+    int buffer_size)
 {
-    if (!method || !endpoint || !response_buffer) {
+    if (!method || !endpoint || !response_acc) {
         return ESP_ERR_INVALID_ARG;
     }
 
@@ -252,21 +287,13 @@ static esp_err_t tuya_api_request(
     char full_url[512];
     snprintf(full_url, sizeof(full_url), "%s%s", TUYA_API_HOST, endpoint);
 
-    response_buffer[0] = '\0';
-    http_response_accumulator_t response_acc = {
-        .buffer = response_buffer,
-        .capacity = response_buffer_len,
-        .length = 0,
-        .overflow = false,
-    };
-
     // Create HTTP client
     esp_http_client_config_t config = {
         .url = full_url,
         .method = HTTP_METHOD_GET,
         .event_handler = http_event_handler,
-        .user_data = &response_acc,
-        .buffer_size = HTTP_BUFFER_SIZE,
+        .user_data = response_acc,
+        .buffer_size = buffer_size,
         .crt_bundle_attach = esp_crt_bundle_attach,
     };
 
@@ -321,18 +348,136 @@ static esp_err_t tuya_api_request(
         return ESP_FAIL;
     }
 
+    esp_http_client_cleanup(client);
+    return ESP_OK;
+}
+
+/**
+ * @brief Make signed HTTP request to Tuya API, accumulating the whole body
+ */
+static esp_err_t tuya_api_request(
+    const char *method,
+    const char *endpoint,
+    const char *request_body,
+    char *response_buffer,
+    size_t response_buffer_len)
+{
+    if (!response_buffer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    response_buffer[0] = '\0';
+    http_response_accumulator_t response_acc = {
+        .buffer = response_buffer,
+        .capacity = response_buffer_len,
+        .length = 0,
+        .overflow = false,
+        .parser = NULL,
+    };
+
+    esp_err_t err = tuya_api_perform(method, endpoint, request_body, &response_acc, HTTP_BUFFER_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+
     if (response_acc.overflow) {
         ESP_LOGE(TAG, "HTTP response truncated (capacity=%u)", (unsigned)response_buffer_len);
-        esp_http_client_cleanup(client);
         return ESP_FAIL;
     }
 
     ESP_LOGI(TAG, "Response: %s", response_buffer);
-
-    esp_http_client_cleanup(client);
     return ESP_OK;
 }
 
+// ============================================================================
+// DP Mapping and Local Session
+// ============================================================================
+
+static tuya_dp_t dp_from_id(int id)
+{
+    for (int dp = 0; dp < TUYA_DP_COUNT; dp++) {
+        if (g_dp_ids[dp] != 0 && g_dp_ids[dp] == id) {
+            return (tuya_dp_t)dp;
+        }
+    }
+    return TUYA_DP_COUNT;
+}
+
+/**
+ * @brief DP report from the local session (runs on its task)
+ */
+static void on_local_dps(const cJSON *dps, bool full_snapshot, void *ctx)
+{
+    tuya_device_status_t status;
+    taskENTER_CRITICAL(&g_local_status_lock);
+    status = g_local_status;
+    taskEXIT_CRITICAL(&g_local_status_lock);
+
+    int applied = 0;
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, dps) {
+        tuya_dp_t dp = dp_from_id(atoi(item->string));
+        if (dp != TUYA_DP_COUNT) {
+            tuya_dp_apply(&status, dp, cJSON_IsTrue(item) ? 1 : item->valueint,
+                          cJSON_IsString(item) ? item->valuestring : NULL);
+            applied++;
+        }
+    }
+
+    if (applied == 0) {
+        // Either nothing we track changed, or no cloud read has taught us
+        // the DP ids yet.
+        return;
+    }
+
+    taskENTER_CRITICAL(&g_local_status_lock);
+    g_local_status = status;
+    if (full_snapshot) {
+        g_local_status_valid = true;
+    }
+    taskEXIT_CRITICAL(&g_local_status_lock);
+
+    ESP_LOGI(TAG, "Local %s: %d DP(s) updated", full_snapshot ? "snapshot" : "push", applied);
+
+    if (g_status_listener) {
+        g_status_listener();
+    }
+}
+
+/**
+ * @brief Send a {"commands":[{code,value},...]} body over the local session
+ * @return ESP_OK if the device acknowledged it; anything else means the
+ *         caller should fall back to the cloud
+ */
+static esp_err_t tuya_send_local_command(const cJSON *body)
+{
+    if (!tuya_local_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    cJSON *dps = cJSON_CreateObject();
+    const cJSON *cmd = NULL;
+    cJSON_ArrayForEach(cmd, cJSON_GetObjectItem(body, "commands")) {
+        const char *code = cJSON_GetStringValue(cJSON_GetObjectItem(cmd, "code"));
+        tuya_dp_t dp = code ? tuya_dp_from_code(code, strlen(code)) : TUYA_DP_COUNT;
+        if (dp == TUYA_DP_COUNT || g_dp_ids[dp] == 0) {
+            ESP_LOGW(TAG, "No local DP id known for '%s', using cloud", code ? code : "?");
+            cJSON_Delete(dps);
+            return ESP_ERR_NOT_FOUND;
+        }
+        char id[4];
+        snprintf(id, sizeof(id), "%u", g_dp_ids[dp]);
+        cJSON_AddItemToObject(dps, id, cJSON_Duplicate(cJSON_GetObjectItem(cmd, "value"), true));
+    }
+
+    esp_err_t result = tuya_local_set_dps(dps, LOCAL_COMMAND_TIMEOUT_MS);
+    cJSON_Delete(dps);
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "Local command failed (%s), falling back to cloud", esp_err_to_name(result));
+    }
+    return result;
+}
+
 // ============================================================================
 // Public API Implementation
 // ============================================================================
@@ -385,14 +530,19 @@ static esp_err_t tuya_validate_success_response(const char *response_json, bool
 }
 
 /**
- * @brief Send command payload to a specific Tuya device and validate response
+ * @brief Send command payload to a specific Tuya device and validate response.
+ *        Goes over the local session when it's up, the cloud otherwise.
  */
-static esp_err_t tuya_send_device_command(const char *body_str)
+static esp_err_t tuya_send_device_command(const cJSON *body, const char *body_str)
 {
-    if (!body_str) {
+    if (!body || !body_str) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (tuya_send_local_command(body) == ESP_OK) {
+        return ESP_OK;
+    }
+
     bool token_retry_attempted = false;
 
     char endpoint[256];
@@ -452,6 +602,22 @@ esp_err_t tuya_get_device_status(tuya_device_status_t *status)
         return ESP_ERR_INVALID_ARG;
     }
 
+    // While the local session is up, every DP change has already been pushed
+    // into g_local_status -- no need to spend a cloud call (or its latency).
+    if (tuya_local_is_connected()) {
+        bool served = false;
+        taskENTER_CRITICAL(&g_local_status_lock);
+        if (g_local_status_valid) {
+            *status = g_local_status;
+            served = true;
+        }
+        taskEXIT_CRITICAL(&g_local_status_lock);
+        if (served) {
+            ESP_LOGD(TAG, "Device status served from local session");
+            return ESP_OK;
+        }
+    }
+
     bool token_retry_attempted = false;
 
     // Build endpoint for the device's shadow/properties (full DP snapshot)
@@ -459,103 +625,60 @@ esp_err_t tuya_get_device_status(tuya_device_status_t *status)
     snprintf(endpoint, sizeof(endpoint),
              TUYA_SHADOW_PROPERTIES_ENDPOINT_FMT, g_tuya_ctx.device_id);
 
-retry_status_request:
+retry_status_request:;
 
-    char *response_buffer = malloc(HTTP_BUFFER_SIZE);
-    if (!response_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate response buffer");
-        return ESP_ERR_NO_MEM;
-    }
+    // Streamed: each HTTP_EVENT_ON_DATA chunk goes straight into the parser,
+    // which fills a scratch status (and learns each known DP's numeric id
+    // for the local session) -- no response buffer, no cJSON tree.
+    tuya_device_status_t parsed;
+    tuya_shadow_parser_t parser;
+    tuya_shadow_parser_init(&parser, &parsed, g_dp_ids);
+    http_response_accumulator_t response_acc = {
+        .parser = &parser,
+    };
 
-    // Make API request
-    if (tuya_api_request("GET", endpoint, NULL, response_buffer, HTTP_BUFFER_SIZE) != ESP_OK) {
+    if (tuya_api_perform("GET", endpoint, NULL, &response_acc, SHADOW_HTTP_BUFFER_SIZE) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get device status");
-        free(response_buffer);
-        return ESP_FAIL;
-    }
-
-    // Parse JSON response
-    cJSON *root = cJSON_Parse(response_buffer);
-    free(response_buffer);
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to parse response JSON");
         return ESP_FAIL;
     }
 
-    // Check for success
-    cJSON *success = cJSON_GetObjectItem(root, "success");
-    if (!success || !success->valueint) {
-        cJSON *code = cJSON_GetObjectItem(root, "code");
-        if (code && cJSON_IsNumber(code) && code->valueint == 1010) {
-            ESP_LOGW(TAG, "Tuya token invalid, refreshing and retrying status request");
-            cJSON_Delete(root);
-            if (!token_retry_attempted && tuya_refresh_token() == ESP_OK) {
-                token_retry_attempted = true;
-                goto retry_status_request;
+    switch (tuya_shadow_parser_finish(&parser)) {
+        case TUYA_SHADOW_OK:
+            break;
+        case TUYA_SHADOW_API_ERROR:
+            if (parser.error_code == 1010) {
+                ESP_LOGW(TAG, "Tuya token invalid, refreshing and retrying status request");
+                if (!token_retry_attempted && tuya_refresh_token() == ESP_OK) {
+                    token_retry_attempted = true;
+                    goto retry_status_request;
+                }
+                ESP_LOGE(TAG, "Token refresh failed after token invalid response");
+                return ESP_FAIL;
             }
-            ESP_LOGE(TAG, "Token refresh failed after token invalid response");
+            ESP_LOGE(TAG, "API returned success=false (code=%d)", (int)parser.error_code);
+            return ESP_FAIL;
+        case TUYA_SHADOW_NO_PROPERTIES:
+            ESP_LOGE(TAG, "No properties array in response");
+            return ESP_FAIL;
+        default:
+            ESP_LOGE(TAG, "Failed to parse response JSON (%u bytes)", (unsigned)response_acc.length);
             return ESP_FAIL;
-        }
-        ESP_LOGE(TAG, "API returned success=false");
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-
-    // Extract properties array: {"result": {"properties": [{code, value, ...}, ...]}}
-    cJSON *result_obj = cJSON_GetObjectItem(root, "result");
-    cJSON *status_arr = result_obj ? cJSON_GetObjectItem(result_obj, "properties") : NULL;
-
-    if (!status_arr || !cJSON_IsArray(status_arr)) {
-        ESP_LOGE(TAG, "No properties array in response");
-        cJSON_Delete(root);
-        return ESP_FAIL;
-    }
-
-    // Initialize status structure
-    memset(status, 0, sizeof(tuya_device_status_t));
-
-    // Parse status codes
-    cJSON *status_item = NULL;
-    cJSON_ArrayForEach(status_item, status_arr) {
-        const char *code = cJSON_GetStringValue(cJSON_GetObjectItem(status_item, "code"));
-        cJSON *value_obj = cJSON_GetObjectItem(status_item, "value");
-
-        if (!code || !value_obj) continue;
-
-        if (strcmp(code, "switch") == 0) {
-            status->switch_state = value_obj->valueint;
-        } else if (strcmp(code, "temp_set") == 0) {
-            status->temp_set = value_obj->valueint;
-        } else if (strcmp(code, "temp_current") == 0) {
-            status->temp_current = value_obj->valueint;
-        } else if (strcmp(code, "temp_set_f") == 0) {
-            status->temp_set_f = value_obj->valueint;
-        } else if (strcmp(code, "mode") == 0) {
-            // Enum DPs come back as JSON strings (e.g. "value":"1") from the
-            // shadow/properties endpoint, not numbers.
-            if (cJSON_IsString(value_obj) && value_obj->valuestring) {
-                status->ac_mode = (uint8_t)atoi(value_obj->valuestring);
-            }
-        } else if (strcmp(code, "heat") == 0) {
-            status->heat = value_obj->valueint;
-        } else if (strcmp(code, "health") == 0) {
-            status->health = value_obj->valueint;
-        } else if (strcmp(code, "cleaning") == 0) {
-            status->cleaning = value_obj->valueint;
-        } else if (strcmp(code, "fresh_air_valve") == 0) {
-            status->fresh_air_valve = value_obj->valueint;
-        } else if (strcmp(code, "compressor_frequency") == 0) {
-            status->compressor_frequency = value_obj->valueint;
-        } else if (strcmp(code, "ure") == 0) {
-            status->outdoor_temp = value_obj->valueint;
-        }
     }
 
-    cJSON_Delete(root);
+    ESP_LOGD(TAG, "Shadow: %u bytes, %u properties, %u tracked",
+             (unsigned)response_acc.length, parser.properties, parser.matched);
+    *status = parsed;
 
     ESP_LOGI(TAG, "Device status retrieved: switch=%d, temp_current=%d, temp_set=%d",
              status->switch_state, status->temp_current, status->temp_set);
 
+    // Seed the local cache so a session that comes up later starts from a
+    // complete picture rather than only the DPs it has seen pushed.
+    taskENTER_CRITICAL(&g_local_status_lock);
+    g_local_status = *status;
+    g_local_status_valid = true;
+    taskEXIT_CRITICAL(&g_local_status_lock);
+
     return ESP_OK;
 }
 
@@ -577,7 +700,7 @@ esp_err_t tuya_set_power(bool on)
     ESP_LOGD(TAG, "Command body: %s", body_str);
 
     // Make API request
-    esp_err_t result = tuya_send_device_command(body_str);
+    esp_err_t result = tuya_send_device_command(body, body_str);
 
     free(body_str);
     cJSON_Delete(body);
@@ -619,7 +742,7 @@ esp_err_t tuya_set_temperature(int16_t temp_c)
     ESP_LOGD(TAG, "Command body: %s", body_str);
 
     // Make API request
-    esp_err_t result = tuya_send_device_command(body_str);
+    esp_err_t result = tuya_send_device_command(body, body_str);
 
     free(body_str);
     cJSON_Delete(body);
@@ -653,7 +776,7 @@ esp_err_t tuya_set_mode(uint8_t mode)
     ESP_LOGD(TAG, "Command body: %s", body_str);
 
     // Make API request
-    esp_err_t result = tuya_send_device_command(body_str);
+    esp_err_t result = tuya_send_device_command(body, body_str);
 
     free(body_str);
     cJSON_Delete(body);
@@ -677,7 +800,7 @@ esp_err_t tuya_set_fresh_air(bool on)
     ESP_LOGI(TAG, "Setting fresh air valve to: %s", on ? "OPEN" : "CLOSED");
     ESP_LOGD(TAG, "Command body: %s", body_str);
 
-    esp_err_t result = tuya_send_device_command(body_str);
+    esp_err_t result = tuya_send_device_command(body, body_str);
 
     free(body_str);
     cJSON_Delete(body);
@@ -685,6 +808,25 @@ esp_err_t tuya_set_fresh_air(bool on)
     return result;
 }
 
+esp_err_t tuya_client_start_local(const char *host, const char *local_key, uint8_t version)
+{
+    if (g_tuya_ctx.device_id[0] == '\0') {
+        return ESP_ERR_INVALID_STATE;   // tuya_client_init() first
+    }
+    return tuya_local_start(host, g_tuya_ctx.device_id, local_key,
+                            (tuya_local_version_t)version, on_local_dps, NULL);
+}
+
+void tuya_client_set_status_listener(tuya_status_listener_t listener)
+{
+    g_status_listener = listener;
+}
+
+bool tuya_client_local_active(void)
+{
+    return tuya_local_is_connected();
+}
+
 esp_err_t tuya_refresh_token(void)
 {
     char *response_buffer = calloc(1, HTTP_BUFFER_SIZE);
@@ -0,0 +1,751 @@
+// Tuya Local Session - LAN protocol 3.3 / 3.4 over TCP 6668
+// Frame layout and the 3.4 session key negotiation follow the community
+// reverse-engineered protocol (tinytuya, tuya-convert); see tuya_local.h.
+//
+// Frame (both directions):
+//   00 00 55 AA | seq (BE32) | cmd (BE32) | len (BE32) |
+//   [retcode (BE32), device -> us only] | payload | trailer | 00 00 AA 99
+// len counts everything after itself. The trailer is a CRC32 of the frame
+// so far for 3.3, or an HMAC-SHA256 keyed with the session key for 3.4.
+
+#include "tuya_local.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/md.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+
+static const char *TAG = "TUYA_LOCAL";
+
+#define FRAME_PREFIX 0x000055AAu
+#define FRAME_SUFFIX 0x0000AA99u
+#define FRAME_HEADER_SIZE 16            // prefix, seq, cmd, len
+#define FRAME_SUFFIX_SIZE 4
+#define FRAME_CRC_SIZE 4                // 3.3 trailer
+#define FRAME_HMAC_SIZE 32              // 3.4 trailer
+#define VERSION_HEADER_SIZE 15          // "3.x" + 12 zero bytes in front of CONTROL payloads
+#define AES_BLOCK 16
+
+// A full DP query response for this unit (every DP it has) is ~2KB once
+// encrypted; anything larger than this is treated as a corrupt length.
+#define FRAME_RX_BUFFER_SIZE 4096
+
+#define CMD_SESS_KEY_NEG_START 0x03
+#define CMD_SESS_KEY_NEG_RESP 0x04
+#define CMD_SESS_KEY_NEG_FINISH 0x05
+#define CMD_CONTROL 0x07
+#define CMD_STATUS 0x08
+#define CMD_HEART_BEAT 0x09
+#define CMD_DP_QUERY 0x0a
+#define CMD_CONTROL_NEW 0x0d
+#define CMD_DP_QUERY_NEW 0x10
+
+#define HEARTBEAT_INTERVAL_MS 10000
+#define HEARTBEAT_GAP_MS 15000          // No frame for this long = a heartbeat went unanswered; pushes may have been lost too
+#define DP_QUERY_INTERVAL_MS 300000     // Full DP snapshot this often, so a lost push can't leave status stale for long
+#define SESSION_IDLE_TIMEOUT_MS 30000   // No frame at all (not even a heartbeat reply) for this long = dead session
+#define FRAME_BODY_TIMEOUT_MS 5000      // Once a header arrives, the rest of the frame must follow within this
+#define RX_POLL_MS 1000                 // How often run_session() wakes to check heartbeat/idle deadlines
+#define RECONNECT_DELAY_MIN_MS 5000
+#define RECONNECT_DELAY_MAX_MS 60000
+#define SESSION_TASK_STACK 6144
+
+typedef struct {
+    char host[64];
+    char device_id[32];
+    uint8_t local_key[16];
+    uint8_t session_key[16];            // Same as local_key for 3.3; negotiated per connection for 3.4
+    tuya_local_version_t version;
+    tuya_local_dps_cb_t dps_cb;
+    void *cb_ctx;
+    int sock;
+    uint32_t seq;
+    volatile bool connected;
+    SemaphoreHandle_t tx_lock;          // Serializes frame writes (session task heartbeats vs command_task)
+    SemaphoreHandle_t ack_sem;          // Given by the session task when a CONTROL ack arrives
+    tuya_local_stats_t stats;
+} tuya_local_context_t;
+
+static tuya_local_context_t g_local = { .sock = -1 };
+
+// Only the session task receives, so a single static buffer is enough and
+// keeps the 4KB off its stack.
+static uint8_t g_rx_buffer[FRAME_RX_BUFFER_SIZE];
+
+static void put_u32_be(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32_be(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * @brief Standard (zlib) CRC32, the 3.3 frame trailer
+ */
+static uint32_t crc32_ieee(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static void hmac_sha256(const uint8_t key[16], const uint8_t *data, size_t len, uint8_t out[32])
+{
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, 16, data, len, out);
+}
+
+/**
+ * @brief AES-128-ECB encrypt with PKCS#7 padding
+ * @param out Must hold len rounded up to the next whole block (there is
+ *            always at least one padding byte)
+ * @return Padded (encrypted) length
+ */
+static size_t aes_encrypt(const uint8_t key[16], const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t padded = (len / AES_BLOCK + 1) * AES_BLOCK;
+    uint8_t pad = (uint8_t)(padded - len);
+    memmove(out, in, len);
+    memset(out + len, pad, pad);
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+    for (size_t i = 0; i < padded; i += AES_BLOCK) {
+        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, out + i, out + i);
+    }
+    mbedtls_aes_free(&aes);
+    return padded;
+}
+
+/**
+ * @brief AES-128-ECB decrypt in place and strip PKCS#7 padding
+ * @return Plaintext length, or -1 if the input isn't whole blocks or the
+ *         padding is invalid (almost always a wrong local key)
+ */
+static int aes_decrypt(const uint8_t key[16], uint8_t *buf, size_t len)
+{
+    if (len == 0 || (len % AES_BLOCK) != 0) {
+        return -1;
+    }
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_dec(&aes, key, 128);
+    for (size_t i = 0; i < len; i += AES_BLOCK) {
+        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_DECRYPT, buf + i, buf + i);
+    }
+    mbedtls_aes_free(&aes);
+
+    uint8_t pad = buf[len - 1];
+    if (pad == 0 || pad > AES_BLOCK) {
+        return -1;
+    }
+    return (int)(len - pad);
+}
+
+static bool is_negotiation_cmd(uint32_t cmd)
+{
+    return cmd == CMD_SESS_KEY_NEG_START || cmd == CMD_SESS_KEY_NEG_RESP || cmd == CMD_SESS_KEY_NEG_FINISH;
+}
+
+static size_t trailer_size(void)
+{
+    return (g_local.version == TUYA_LOCAL_VERSION_3_4) ? FRAME_HMAC_SIZE : FRAME_CRC_SIZE;
+}
+
+static bool send_all(int sock, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        int sent = send(sock, data, len, 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return true;
+}
+
+/**
+ * @brief Encrypt, frame and send one command. Safe to call from any task.
+ */
+static esp_err_t send_frame(uint32_t cmd, const uint8_t *data, size_t len)
+{
+    bool is_3_4 = (g_local.version == TUYA_LOCAL_VERSION_3_4);
+    bool version_header = (cmd == CMD_CONTROL || cmd == CMD_CONTROL_NEW);
+    const uint8_t *key = is_negotiation_cmd(cmd) ? g_local.local_key : g_local.session_key;
+
+    size_t max_payload = VERSION_HEADER_SIZE + len + AES_BLOCK;
+    size_t frame_cap = FRAME_HEADER_SIZE + max_payload + FRAME_HMAC_SIZE + FRAME_SUFFIX_SIZE;
+    uint8_t *frame = malloc(frame_cap);
+    if (!frame) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 3.3 puts the version header in the clear in front of the ciphertext;
+    // 3.4 encrypts it along with the JSON.
+    uint8_t *payload = frame + FRAME_HEADER_SIZE;
+    size_t payload_len;
+    if (is_3_4) {
+        size_t plain_len = 0;
+        if (version_header) {
+            memset(payload, 0, VERSION_HEADER_SIZE);
+            memcpy(payload, "3.4", 3);
+            plain_len = VERSION_HEADER_SIZE;
+        }
+        memcpy(payload + plain_len, data, len);
+        payload_len = aes_encrypt(key, payload, plain_len + len, payload);
+    } else if (version_header) {
+        memset(payload, 0, VERSION_HEADER_SIZE);
+        memcpy(payload, "3.3", 3);
+        payload_len = VERSION_HEADER_SIZE +
+                      aes_encrypt(key, data, len, payload + VERSION_HEADER_SIZE);
+    } else {
+        payload_len = aes_encrypt(key, data, len, payload);
+    }
+
+    esp_err_t result = ESP_FAIL;
+    xSemaphoreTake(g_local.tx_lock, portMAX_DELAY);
+    if (g_local.sock >= 0) {
+        put_u32_be(frame, FRAME_PREFIX);
+        put_u32_be(frame + 4, ++g_local.seq);
+        put_u32_be(frame + 8, cmd);
+        put_u32_be(frame + 12, (uint32_t)(payload_len + trailer_size() + FRAME_SUFFIX_SIZE));
+
+        uint8_t *trailer = payload + payload_len;
+        size_t signed_len = FRAME_HEADER_SIZE + payload_len;
+        if (is_3_4) {
+            hmac_sha256(key, frame, signed_len, trailer);
+        } else {
+            put_u32_be(trailer, crc32_ieee(frame, signed_len));
+        }
+        put_u32_be(trailer + trailer_size(), FRAME_SUFFIX);
+
+        if (send_all(g_local.sock, frame, signed_len + trailer_size() + FRAME_SUFFIX_SIZE)) {
+            result = ESP_OK;
+        }
+    }
+    xSemaphoreGive(g_local.tx_lock);
+
+    free(frame);
+    return result;
+}
+
+static esp_err_t send_json(uint32_t cmd, cJSON *json)
+{
+    char *text = cJSON_PrintUnformatted(json);
+    if (!text) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGD(TAG, "TX cmd=0x%02" PRIx32 " %s", cmd, text);
+    esp_err_t result = send_frame(cmd, (const uint8_t *)text, strlen(text));
+    free(text);
+    return result;
+}
+
+static bool recv_all(int sock, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int got = recv(sock, buf, len, 0);
+        if (got <= 0) {
+            return false;   // Closed, error, or SO_RCVTIMEO (FRAME_BODY_TIMEOUT_MS) expired mid-frame
+        }
+        buf += got;
+        len -= (size_t)got;
+    }
+    return true;
+}
+
+/**
+ * @brief Wait up to wait_ms for a frame, then verify and decrypt it in place
+ *        in g_rx_buffer. Session task only.
+ * @param payload Set to the NUL-terminated plaintext (may be empty)
+ * @return ESP_OK, ESP_ERR_TIMEOUT if nothing arrived, ESP_FAIL if the
+ *         session is unusable and must be dropped
+ */
+static esp_err_t recv_frame(uint32_t wait_ms, uint32_t *cmd, char **payload, size_t *payload_len)
+{
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(g_local.sock, &readable);
+    struct timeval tv = { .tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000 };
+    int ready = select(g_local.sock + 1, &readable, NULL, NULL, &tv);
+    if (ready == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (ready < 0 || !recv_all(g_local.sock, g_rx_buffer, FRAME_HEADER_SIZE)) {
+        return ESP_FAIL;
+    }
+
+    if (get_u32_be(g_rx_buffer) != FRAME_PREFIX) {
+        ESP_LOGW(TAG, "Bad frame prefix, dropping session");
+        return ESP_FAIL;
+    }
+    *cmd = get_u32_be(g_rx_buffer + 8);
+    size_t len = get_u32_be(g_rx_buffer + 12);
+    size_t trailer = trailer_size();
+    if (len < trailer + FRAME_SUFFIX_SIZE || len > sizeof(g_rx_buffer) - FRAME_HEADER_SIZE - 1) {
+        ESP_LOGW(TAG, "Bad frame length %u, dropping session", (unsigned)len);
+        return ESP_FAIL;
+    }
+    if (!recv_all(g_local.sock, g_rx_buffer + FRAME_HEADER_SIZE, len)) {
+        return ESP_FAIL;
+    }
+
+    uint8_t *body = g_rx_buffer + FRAME_HEADER_SIZE;
+    size_t body_len = len - trailer - FRAME_SUFFIX_SIZE;
+    if (get_u32_be(body + body_len + trailer) != FRAME_SUFFIX) {
+        ESP_LOGW(TAG, "Bad frame suffix, dropping session");
+        return ESP_FAIL;
+    }
+
+    const uint8_t *key = is_negotiation_cmd(*cmd) ? g_local.local_key : g_local.session_key;
+    if (g_local.version == TUYA_LOCAL_VERSION_3_4) {
+        uint8_t mac[FRAME_HMAC_SIZE];
+        hmac_sha256(key, g_rx_buffer, FRAME_HEADER_SIZE + body_len, mac);
+        if (memcmp(mac, body + body_len, FRAME_HMAC_SIZE) != 0) {
+            ESP_LOGW(TAG, "Frame HMAC mismatch (wrong local key?), dropping session");
+            return ESP_FAIL;
+        }
+    } else if (crc32_ieee(g_rx_buffer, FRAME_HEADER_SIZE + body_len) != get_u32_be(body + body_len)) {
+        ESP_LOGW(TAG, "Frame CRC mismatch, dropping session");
+        return ESP_FAIL;
+    }
+
+    // Device -> us frames normally lead with a return code. It's a small
+    // integer, which ciphertext and version headers essentially never
+    // start with, so that's how its presence is detected.
+    if (body_len >= 4 && (get_u32_be(body) & 0xFFFFFF00u) == 0) {
+        if (get_u32_be(body) != 0) {
+            ESP_LOGW(TAG, "Device returned error code %" PRIu32 " for cmd 0x%02" PRIx32,
+                     get_u32_be(body), *cmd);
+        }
+        body += 4;
+        body_len -= 4;
+    }
+
+    if (g_local.version == TUYA_LOCAL_VERSION_3_3 && body_len >= VERSION_HEADER_SIZE &&
+        memcmp(body, "3.3", 3) == 0) {
+        body += VERSION_HEADER_SIZE;
+        body_len -= VERSION_HEADER_SIZE;
+    }
+
+    if (body_len > 0) {
+        int plain_len = aes_decrypt(key, body, body_len);
+        if (plain_len < 0) {
+            // Some 3.3 firmwares answer DP_QUERY with a plaintext
+            // "data format error" style string instead of ciphertext.
+            ESP_LOGW(TAG, "Undecryptable payload for cmd 0x%02" PRIx32 ", ignoring", *cmd);
+            body_len = 0;
+        } else {
+            body_len = (size_t)plain_len;
+        }
+    }
+
+    if (g_local.version == TUYA_LOCAL_VERSION_3_4 && body_len >= VERSION_HEADER_SIZE &&
+        memcmp(body, "3.4", 3) == 0) {
+        body += VERSION_HEADER_SIZE;
+        body_len -= VERSION_HEADER_SIZE;
+    }
+
+    body[body_len] = '\0';
+    *payload = (char *)body;
+    *payload_len = body_len;
+    return ESP_OK;
+}
+
+/**
+ * @brief 3.4 only: agree on a per-connection session key
+ *
+ * We send a random nonce; the device answers with its own nonce plus an
+ * HMAC of ours (proving it has the local key); we answer with an HMAC of
+ * its nonce. The session key is AES(local_key, local_nonce XOR remote_nonce).
+ */
+static esp_err_t negotiate_session_key(void)
+{
+    uint8_t local_nonce[16];
+    esp_fill_random(local_nonce, sizeof(local_nonce));
+    if (send_frame(CMD_SESS_KEY_NEG_START, local_nonce, sizeof(local_nonce)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    uint32_t cmd = 0;
+    char *payload = NULL;
+    size_t payload_len = 0;
+    if (recv_frame(FRAME_BODY_TIMEOUT_MS, &cmd, &payload, &payload_len) != ESP_OK ||
+        cmd != CMD_SESS_KEY_NEG_RESP || payload_len < 16 + FRAME_HMAC_SIZE) {
+        ESP_LOGE(TAG, "No valid session key response from device");
+        return ESP_FAIL;
+    }
+
+    uint8_t remote_nonce[16];
+    uint8_t expected[FRAME_HMAC_SIZE];
+    memcpy(remote_nonce, payload, sizeof(remote_nonce));
+    hmac_sha256(g_local.local_key, local_nonce, sizeof(local_nonce), expected);
+    if (memcmp(expected, payload + 16, FRAME_HMAC_SIZE) != 0) {
+        ESP_LOGE(TAG, "Session key response failed verification (wrong local key?)");
+        return ESP_FAIL;
+    }
+
+    uint8_t finish[FRAME_HMAC_SIZE];
+    hmac_sha256(g_local.local_key, remote_nonce, sizeof(remote_nonce), finish);
+    if (send_frame(CMD_SESS_KEY_NEG_FINISH, finish, sizeof(finish)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    uint8_t mixed[16];
+    for (int i = 0; i < 16; i++) {
+        mixed[i] = local_nonce[i] ^ remote_nonce[i];
+    }
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, g_local.local_key, 128);
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, mixed, g_local.session_key);
+    mbedtls_aes_free(&aes);
+    return ESP_OK;
+}
+
+static esp_err_t send_dp_query(void)
+{
+    cJSON *json = cJSON_CreateObject();
+    uint32_t cmd = CMD_DP_QUERY_NEW;
+    if (g_local.version == TUYA_LOCAL_VERSION_3_3) {
+        char t[16];
+        snprintf(t, sizeof(t), "%lld", (long long)time(NULL));
+        cJSON_AddStringToObject(json, "gwId", g_local.device_id);
+        cJSON_AddStringToObject(json, "devId", g_local.device_id);
+        cJSON_AddStringToObject(json, "uid", g_local.device_id);
+        cJSON_AddStringToObject(json, "t", t);
+        cmd = CMD_DP_QUERY;
+    }
+    esp_err_t result = send_json(cmd, json);
+    cJSON_Delete(json);
+    return result;
+}
+
+static esp_err_t send_heartbeat(void)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (g_local.version == TUYA_LOCAL_VERSION_3_3) {
+        cJSON_AddStringToObject(json, "gwId", g_local.device_id);
+        cJSON_AddStringToObject(json, "devId", g_local.device_id);
+    }
+    esp_err_t result = send_json(CMD_HEART_BEAT, json);
+    cJSON_Delete(json);
+    return result;
+}
+
+/**
+ * @brief DP reports come as {"dps":{...}} (3.3) or {"data":{"dps":{...}}} (3.4)
+ */
+static void dispatch_dps(const char *payload, bool full_snapshot)
+{
+    cJSON *root = cJSON_Parse(payload);
+    if (!root) {
+        ESP_LOGD(TAG, "Non-JSON DP payload: %s", payload);
+        return;
+    }
+
+    cJSON *dps = cJSON_GetObjectItem(root, "dps");
+    if (!dps) {
+        dps = cJSON_GetObjectItem(cJSON_GetObjectItem(root, "data"), "dps");
+    }
+    if (cJSON_IsObject(dps) && g_local.dps_cb) {
+        g_local.dps_cb(dps, full_snapshot, g_local.cb_ctx);
+    }
+    cJSON_Delete(root);
+}
+
+static void handle_frame(uint32_t cmd, const char *payload, size_t payload_len)
+{
+    ESP_LOGD(TAG, "RX cmd=0x%02" PRIx32 " %s", cmd, payload);
+
+    switch (cmd) {
+        case CMD_CONTROL:
+        case CMD_CONTROL_NEW:
+            xSemaphoreGive(g_local.ack_sem);
+            break;
+        case CMD_STATUS:
+            g_local.stats.pushes++;
+            dispatch_dps(payload, false);
+            break;
+        case CMD_DP_QUERY:
+        case CMD_DP_QUERY_NEW:
+            if (payload_len > 0) {
+                dispatch_dps(payload, true);
+            }
+            break;
+        default:
+            break;   // Heartbeat replies etc. only matter for the idle timer
+    }
+}
+
+static void close_session(void)
+{
+    bool was_connected = g_local.connected;
+    g_local.connected = false;
+
+    xSemaphoreTake(g_local.tx_lock, portMAX_DELAY);
+    if (g_local.sock >= 0) {
+        close(g_local.sock);
+        g_local.sock = -1;
+    }
+    xSemaphoreGive(g_local.tx_lock);
+
+    if (was_connected) {
+        g_local.stats.disconnects++;
+    }
+}
+
+static esp_err_t open_session(void)
+{
+    char port[8];
+    snprintf(port, sizeof(port), "%d", TUYA_LOCAL_PORT);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addr = NULL;
+    if (getaddrinfo(g_local.host, port, &hints, &addr) != 0 || !addr) {
+        ESP_LOGW(TAG, "Could not resolve %s", g_local.host);
+        return ESP_FAIL;
+    }
+
+    int sock = socket(addr->ai_family, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        freeaddrinfo(addr);
+        return ESP_FAIL;
+    }
+    if (connect(sock, addr->ai_addr, addr->ai_addrlen) != 0) {
+        ESP_LOGW(TAG, "Connect to %s:%d failed (errno %d)", g_local.host, TUYA_LOCAL_PORT, errno);
+        close(sock);
+        freeaddrinfo(addr);
+        return ESP_FAIL;
+    }
+    freeaddrinfo(addr);
+
+    struct timeval tv = { .tv_sec = FRAME_BODY_TIMEOUT_MS / 1000, .tv_usec = 0 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    xSemaphoreTake(g_local.tx_lock, portMAX_DELAY);
+    g_local.sock = sock;
+    g_local.seq = 0;
+    memcpy(g_local.session_key, g_local.local_key, sizeof(g_local.session_key));
+    xSemaphoreGive(g_local.tx_lock);
+
+    if (g_local.version == TUYA_LOCAL_VERSION_3_4 && negotiate_session_key() != ESP_OK) {
+        close_session();
+        return ESP_FAIL;
+    }
+
+    g_local.connected = true;
+    g_local.stats.connects++;
+    ESP_LOGI(TAG, "Local session up to %s (protocol %d.%d)",
+             g_local.host, g_local.version / 10, g_local.version % 10);
+
+    if (send_dp_query() != ESP_OK) {
+        close_session();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Receive and dispatch frames until the session dies
+ */
+static void run_session(void)
+{
+    TickType_t last_rx = xTaskGetTickCount();
+    TickType_t last_heartbeat = last_rx;
+    TickType_t last_query = last_rx;    // open_session() sent the first one
+    bool gap_queried = false;
+
+    while (1) {
+        uint32_t cmd = 0;
+        char *payload = NULL;
+        size_t payload_len = 0;
+        esp_err_t err = recv_frame(RX_POLL_MS, &cmd, &payload, &payload_len);
+        TickType_t now = xTaskGetTickCount();
+
+        if (err == ESP_OK) {
+            last_rx = now;
+            gap_queried = false;
+            handle_frame(cmd, payload, payload_len);
+        } else if (err != ESP_ERR_TIMEOUT) {
+            ESP_LOGW(TAG, "Local session read failed");
+            return;
+        }
+
+        if ((now - last_rx) > pdMS_TO_TICKS(SESSION_IDLE_TIMEOUT_MS)) {
+            ESP_LOGW(TAG, "No frames from device for %ums, reconnecting", SESSION_IDLE_TIMEOUT_MS);
+            return;
+        }
+        if ((now - last_heartbeat) >= pdMS_TO_TICKS(HEARTBEAT_INTERVAL_MS)) {
+            last_heartbeat = now;
+            if (send_heartbeat() != ESP_OK) {
+                ESP_LOGW(TAG, "Heartbeat send failed");
+                return;
+            }
+        }
+
+        // Re-sync the whole DP set once per heartbeat gap and every
+        // DP_QUERY_INTERVAL_MS: a push lost in either case would otherwise
+        // leave the status stale until that DP changes again.
+        bool gap = !gap_queried && (now - last_rx) > pdMS_TO_TICKS(HEARTBEAT_GAP_MS);
+        if (gap || (now - last_query) >= pdMS_TO_TICKS(DP_QUERY_INTERVAL_MS)) {
+            if (gap) {
+                ESP_LOGW(TAG, "No frames from device for %" PRIu32 "ms, re-querying DPs",
+                         (uint32_t)pdTICKS_TO_MS(now - last_rx));
+                gap_queried = true;
+            }
+            last_query = now;
+            if (send_dp_query() != ESP_OK) {
+                ESP_LOGW(TAG, "DP query send failed");
+                return;
+            }
+        }
+    }
+}
+
+static void session_task(void *param)
+{
+    uint32_t reconnect_delay_ms = RECONNECT_DELAY_MIN_MS;
+
+    while (1) {
+        if (open_session() == ESP_OK) {
+            reconnect_delay_ms = RECONNECT_DELAY_MIN_MS;
+            run_session();
+            close_session();
+        }
+
+        ESP_LOGW(TAG, "Local session down, retrying in %" PRIu32 "ms (cloud fallback in use)",
+                 reconnect_delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(reconnect_delay_ms));
+        reconnect_delay_ms *= 2;
+        if (reconnect_delay_ms > RECONNECT_DELAY_MAX_MS) {
+            reconnect_delay_ms = RECONNECT_DELAY_MAX_MS;
+        }
+    }
+}
+
+esp_err_t tuya_local_start(const char *host, const char *device_id, const char *local_key,
+                           tuya_local_version_t version, tuya_local_dps_cb_t dps_cb, void *ctx)
+{
+    if (!host || !device_id || !local_key || strlen(local_key) != sizeof(g_local.local_key)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (version != TUYA_LOCAL_VERSION_3_3 && version != TUYA_LOCAL_VERSION_3_4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_local.tx_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    strncpy(g_local.host, host, sizeof(g_local.host) - 1);
+    strncpy(g_local.device_id, device_id, sizeof(g_local.device_id) - 1);
+    memcpy(g_local.local_key, local_key, sizeof(g_local.local_key));
+    g_local.version = version;
+    g_local.dps_cb = dps_cb;
+    g_local.cb_ctx = ctx;
+
+    g_local.tx_lock = xSemaphoreCreateMutex();
+    g_local.ack_sem = xSemaphoreCreateBinary();
+    if (!g_local.tx_lock || !g_local.ack_sem) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(session_task, "tuya_local", SESSION_TASK_STACK, NULL, 4, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Local session task started for %s (protocol %d.%d)",
+             host, version / 10, version % 10);
+    return ESP_OK;
+}
+
+bool tuya_local_is_connected(void)
+{
+    return g_local.connected;
+}
+
+esp_err_t tuya_local_set_dps(const cJSON *dps, uint32_t timeout_ms)
+{
+    if (!dps) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_local.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char t[16];
+    snprintf(t, sizeof(t), "%lld", (long long)time(NULL));
+
+    cJSON *json = cJSON_CreateObject();
+    uint32_t cmd;
+    if (g_local.version == TUYA_LOCAL_VERSION_3_4) {
+        cJSON *data = cJSON_CreateObject();
+        cJSON_AddItemToObject(data, "dps", cJSON_Duplicate(dps, true));
+        cJSON_AddNumberToObject(json, "protocol", 5);
+        cJSON_AddNumberToObject(json, "t", (double)time(NULL));
+        cJSON_AddItemToObject(json, "data", data);
+        cmd = CMD_CONTROL_NEW;
+    } else {
+        cJSON_AddStringToObject(json, "devId", g_local.device_id);
+        cJSON_AddStringToObject(json, "uid", g_local.device_id);
+        cJSON_AddStringToObject(json, "t", t);
+        cJSON_AddItemToObject(json, "dps", cJSON_Duplicate(dps, true));
+        cmd = CMD_CONTROL;
+    }
+
+    // Drop any stale ack left over from a previous command that timed out.
+    xSemaphoreTake(g_local.ack_sem, 0);
+
+    TickType_t start = xTaskGetTickCount();
+    esp_err_t result = send_json(cmd, json);
+    cJSON_Delete(json);
+    if (result != ESP_OK) {
+        g_local.stats.command_failures++;
+        return result;
+    }
+
+    if (xSemaphoreTake(g_local.ack_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        ESP_LOGW(TAG, "No ack for local command within %" PRIu32 "ms", timeout_ms);
+        g_local.stats.command_failures++;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+    g_local.stats.commands++;
+    g_local.stats.last_command_ms = elapsed_ms;
+    if (elapsed_ms > g_local.stats.max_command_ms) {
+        g_local.stats.max_command_ms = elapsed_ms;
+    }
+    return ESP_OK;
+}
+
+void tuya_local_get_stats(tuya_local_stats_t *stats)
+{
+    if (stats) {
+        *stats = g_local.stats;
+    }
+}
@@ -0,0 +1,409 @@
+// Tuya Shadow Parser - streaming extraction of known DPs from the
+// /v2.0/cloud/thing/{id}/shadow/properties response. See tuya_shadow_parser.h.
+
+#include "tuya_shadow_parser.h"
+#include <string.h>
+#include <stdlib.h>
+
+// ============================================================================
+// DP Table
+// ============================================================================
+
+static const char *const k_dp_codes[TUYA_DP_COUNT] = {
+    [TUYA_DP_SWITCH] = "switch",
+    [TUYA_DP_TEMP_SET] = "temp_set",
+    [TUYA_DP_TEMP_CURRENT] = "temp_current",
+    [TUYA_DP_TEMP_SET_F] = "temp_set_f",
+    [TUYA_DP_MODE] = "mode",
+    [TUYA_DP_HEAT] = "heat",
+    [TUYA_DP_HEALTH] = "health",
+    [TUYA_DP_CLEANING] = "cleaning",
+    [TUYA_DP_FRESH_AIR_VALVE] = "fresh_air_valve",
+    [TUYA_DP_COMPRESSOR_FREQUENCY] = "compressor_frequency",
+    [TUYA_DP_URE] = "ure",
+};
+
+// Perfect hash over the codes above: (first char + 3 * length) & 15 gives
+// every tracked code its own slot, so a lookup is one hash and at most one
+// memcmp -- the other ~64 codes in the shadow land on some slot and fail
+// that compare. Found with tools/gen_dp_hash.py; rerun it after changing
+// k_dp_codes (it prints the new multipliers and table).
+#define DP_HASH(c0, len) ((((uint32_t)(uint8_t)(c0)) + 3u * (uint32_t)(len)) & 15u)
+
+static const uint8_t k_dp_hash_slots[16] = {
+    TUYA_DP_COUNT,                  // 0
+    TUYA_DP_COUNT,                  // 1
+    TUYA_DP_TEMP_SET_F,             // 2
+    TUYA_DP_FRESH_AIR_VALVE,        // 3
+    TUYA_DP_HEAT,                   // 4
+    TUYA_DP_SWITCH,                 // 5
+    TUYA_DP_COUNT,                  // 6
+    TUYA_DP_COUNT,                  // 7
+    TUYA_DP_TEMP_CURRENT,           // 8
+    TUYA_DP_MODE,                   // 9
+    TUYA_DP_HEALTH,                 // 10
+    TUYA_DP_CLEANING,               // 11
+    TUYA_DP_TEMP_SET,               // 12
+    TUYA_DP_COUNT,                  // 13
+    TUYA_DP_URE,                    // 14
+    TUYA_DP_COMPRESSOR_FREQUENCY,   // 15
+};
+
+tuya_dp_t tuya_dp_from_code(const char *code, size_t len)
+{
+    if (len == 0) {
+        return TUYA_DP_COUNT;
+    }
+    uint8_t dp = k_dp_hash_slots[DP_HASH(code[0], len)];
+    if (dp == TUYA_DP_COUNT) {
+        return TUYA_DP_COUNT;
+    }
+    const char *candidate = k_dp_codes[dp];
+    if (strlen(candidate) != len || memcmp(candidate, code, len) != 0) {
+        return TUYA_DP_COUNT;
+    }
+    return (tuya_dp_t)dp;
+}
+
+const char *tuya_dp_code(tuya_dp_t dp)
+{
+    return (dp < TUYA_DP_COUNT) ? k_dp_codes[dp] : "?";
+}
+
+void tuya_dp_apply(tuya_device_status_t *status, tuya_dp_t dp, int32_t number, const char *text)
+{
+    switch (dp) {
+        case TUYA_DP_SWITCH:
+            status->switch_state = number != 0;
+            break;
+        case TUYA_DP_TEMP_SET:
+            status->temp_set = (int16_t)number;
+            break;
+        case TUYA_DP_TEMP_CURRENT:
+            status->temp_current = (int16_t)number;
+            break;
+        case TUYA_DP_TEMP_SET_F:
+            status->temp_set_f = (int16_t)number;
+            break;
+        case TUYA_DP_MODE:
+            // Enum DPs come back as JSON strings (e.g. "value":"1") from both
+            // the shadow/properties endpoint and the local protocol.
+            if (text) {
+                status->ac_mode = (uint8_t)atoi(text);
+            }
+            break;
+        case TUYA_DP_HEAT:
+            status->heat = number != 0;
+            break;
+        case TUYA_DP_HEALTH:
+            status->health = number != 0;
+            break;
+        case TUYA_DP_CLEANING:
+            status->cleaning = number != 0;
+            break;
+        case TUYA_DP_FRESH_AIR_VALVE:
+            status->fresh_air_valve = number != 0;
+            break;
+        case TUYA_DP_COMPRESSOR_FREQUENCY:
+            status->compressor_frequency = (int16_t)number;
+            break;
+        case TUYA_DP_URE:
+            status->outdoor_temp = (int16_t)number;
+            break;
+        default:
+            break;
+    }
+}
+
+// ============================================================================
+// Tokenizer
+// ============================================================================
+
+enum {
+    LEX_IDLE,       // Between tokens
+    LEX_STRING,     // Inside "..."
+    LEX_BARE,       // Inside a number / true / false / null
+};
+
+// Only keys that matter somewhere on the tracked path are told apart.
+enum {
+    KEY_OTHER,
+    KEY_SUCCESS,
+    KEY_CODE,
+    KEY_RESULT,
+    KEY_PROPERTIES,
+    KEY_DP_ID,
+    KEY_VALUE,
+};
+
+// Depths on the tracked path: root object, result object, properties
+// array, one property object.
+#define DEPTH_ROOT 1
+#define DEPTH_RESULT 2
+#define DEPTH_PROPERTIES 3
+#define DEPTH_ELEMENT 4
+
+static uint8_t classify_key(const char *key, uint8_t len)
+{
+    switch (len) {
+        case 4:
+            return memcmp(key, "code", 4) == 0 ? KEY_CODE : KEY_OTHER;
+        case 5:
+            return memcmp(key, "dp_id", 5) == 0 ? KEY_DP_ID :
+                   memcmp(key, "value", 5) == 0 ? KEY_VALUE : KEY_OTHER;
+        case 6:
+            return memcmp(key, "result", 6) == 0 ? KEY_RESULT : KEY_OTHER;
+        case 7:
+            return memcmp(key, "success", 7) == 0 ? KEY_SUCCESS : KEY_OTHER;
+        case 10:
+            return memcmp(key, "properties", 10) == 0 ? KEY_PROPERTIES : KEY_OTHER;
+        default:
+            return KEY_OTHER;
+    }
+}
+
+static bool in_array(const tuya_shadow_parser_t *p)
+{
+    return (p->array_mask >> p->depth) & 1u;
+}
+
+static void token_append(tuya_shadow_parser_t *p, char c)
+{
+    if (p->token_len < TUYA_SHADOW_TOKEN_MAX - 1) {
+        p->token[p->token_len++] = c;
+    } else {
+        p->token_truncated = true;
+    }
+}
+
+static int32_t token_number(const tuya_shadow_parser_t *p)
+{
+    if (p->token_len == 4 && memcmp(p->token, "true", 4) == 0) {
+        return 1;
+    }
+    return (int32_t)strtol(p->token, NULL, 10);   // false/null -> 0
+}
+
+/**
+ * @brief A complete scalar value (string or bare) at the current depth
+ */
+static void on_scalar(tuya_shadow_parser_t *p, bool is_string)
+{
+    p->token[p->token_len] = '\0';
+
+    if (p->tracked_depth != p->depth) {
+        return;
+    }
+
+    if (p->depth == DEPTH_ROOT) {
+        if (p->key == KEY_SUCCESS) {
+            p->success = !is_string && p->token_len == 4 && memcmp(p->token, "true", 4) == 0;
+        } else if (p->key == KEY_CODE) {
+            p->error_code = (int32_t)strtol(p->token, NULL, 10);
+        }
+    } else if (p->depth == DEPTH_ELEMENT) {
+        if (p->key == KEY_CODE && is_string) {
+            p->elem_dp = p->token_truncated ? TUYA_DP_COUNT
+                                            : tuya_dp_from_code(p->token, p->token_len);
+        } else if (p->key == KEY_DP_ID) {
+            p->elem_dp_id = (int16_t)token_number(p);
+        } else if (p->key == KEY_VALUE) {
+            p->elem_has_value = true;
+            p->elem_value_is_text = is_string;
+            p->elem_number = token_number(p);
+            if (is_string) {
+                strncpy(p->elem_text, p->token, sizeof(p->elem_text) - 1);
+                p->elem_text[sizeof(p->elem_text) - 1] = '\0';
+            }
+        }
+    }
+}
+
+static void on_string_done(tuya_shadow_parser_t *p)
+{
+    if (p->expect_key && !in_array(p)) {
+        p->token[p->token_len] = '\0';
+        p->key = p->token_truncated ? KEY_OTHER : classify_key(p->token, p->token_len);
+        p->expect_key = false;
+        return;
+    }
+    on_scalar(p, true);
+}
+
+static void open_container(tuya_shadow_parser_t *p, bool is_array)
+{
+    if (p->depth + 1 >= TUYA_SHADOW_MAX_DEPTH) {
+        p->malformed = true;
+        return;
+    }
+
+    // Is the new container the next step along root.result.properties[]?
+    bool on_path = false;
+    if (p->tracked_depth == p->depth) {
+        switch (p->depth) {
+            case 0:
+                on_path = !is_array;
+                break;
+            case DEPTH_ROOT:
+                on_path = !is_array && p->key == KEY_RESULT;
+                break;
+            case DEPTH_RESULT:
+                on_path = is_array && p->key == KEY_PROPERTIES;
+                if (on_path) {
+                    p->properties_found = true;
+                }
+                break;
+            case DEPTH_PROPERTIES:
+                on_path = !is_array;
+                if (on_path) {
+                    p->elem_dp = TUYA_DP_COUNT;
+                    p->elem_dp_id = 0;
+                    p->elem_has_value = false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    p->depth++;
+    if (is_array) {
+        p->array_mask |= (uint16_t)(1u << p->depth);
+    } else {
+        p->array_mask &= (uint16_t)~(1u << p->depth);
+    }
+    if (on_path) {
+        p->tracked_depth = p->depth;
+    }
+    p->expect_key = !is_array;
+    p->key = KEY_OTHER;
+}
+
+static void close_container(tuya_shadow_parser_t *p, bool is_array)
+{
+    if (p->depth == 0 || in_array(p) != is_array) {
+        p->malformed = true;
+        return;
+    }
+
+    if (p->tracked_depth == p->depth) {
+        if (p->depth == DEPTH_ELEMENT) {
+            p->properties++;
+            if (p->elem_dp != TUYA_DP_COUNT && p->elem_has_value) {
+                tuya_dp_apply(p->status, (tuya_dp_t)p->elem_dp, p->elem_number,
+                              p->elem_value_is_text ? p->elem_text : NULL);
+                if (p->dp_ids && p->elem_dp_id > 0 && p->elem_dp_id < 256) {
+                    p->dp_ids[p->elem_dp] = (uint8_t)p->elem_dp_id;
+                }
+                p->matched++;
+            }
+        }
+        p->tracked_depth--;
+    }
+
+    p->depth--;
+    // The key that opened this container no longer applies to what follows.
+    p->key = KEY_OTHER;
+}
+
+static bool is_bare_char(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' ||
+           c == 'E';
+}
+
+void tuya_shadow_parser_init(tuya_shadow_parser_t *parser, tuya_device_status_t *status, uint8_t *dp_ids)
+{
+    memset(parser, 0, sizeof(*parser));
+    memset(status, 0, sizeof(*status));
+    parser->status = status;
+    parser->dp_ids = dp_ids;
+    parser->lex = LEX_IDLE;
+    parser->elem_dp = TUYA_DP_COUNT;
+}
+
+void tuya_shadow_parser_feed(tuya_shadow_parser_t *p, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !p->malformed; i++) {
+        char c = data[i];
+
+        if (p->lex == LEX_STRING) {
+            if (p->escape) {
+                p->escape = false;
+                token_append(p, c);     // \uXXXX etc. kept raw; only ASCII codes are ever matched
+            } else if (c == '\\') {
+                p->escape = true;
+            } else if (c == '"') {
+                p->lex = LEX_IDLE;
+                on_string_done(p);
+            } else {
+                token_append(p, c);
+            }
+            continue;
+        }
+
+        if (p->lex == LEX_BARE) {
+            if (is_bare_char(c)) {
+                token_append(p, c);
+                continue;
+            }
+            p->lex = LEX_IDLE;
+            on_scalar(p, false);
+            // c is a delimiter; handle it below
+        }
+
+        switch (c) {
+            case '{':
+                open_container(p, false);
+                break;
+            case '[':
+                open_container(p, true);
+                break;
+            case '}':
+                close_container(p, false);
+                break;
+            case ']':
+                close_container(p, true);
+                break;
+            case ',':
+                p->expect_key = !in_array(p);
+                break;
+            case '"':
+                p->lex = LEX_STRING;
+                p->token_len = 0;
+                p->token_truncated = false;
+                break;
+            case ':':
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                break;
+            default:
+                if (is_bare_char(c)) {
+                    p->lex = LEX_BARE;
+                    p->token_len = 0;
+                    p->token_truncated = false;
+                    token_append(p, c);
+                } else {
+                    p->malformed = true;
+                }
+                break;
+        }
+    }
+}
+
+tuya_shadow_result_t tuya_shadow_parser_finish(tuya_shadow_parser_t *parser)
+{
+    if (parser->malformed || parser->lex != LEX_IDLE || parser->depth != 0 ||
+        parser->tracked_depth != 0) {
+        return TUYA_SHADOW_MALFORMED;
+    }
+    if (!parser->success) {
+        return TUYA_SHADOW_API_ERROR;
+    }
+    if (!parser->properties_found) {
+        return TUYA_SHADOW_NO_PROPERTIES;
+    }
+    return TUYA_SHADOW_OK;
+}
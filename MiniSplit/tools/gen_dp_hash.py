@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Search for the perfect hash used by src/tuya_shadow_parser.c's DP lookup.
+
+Tries hashes of the form (a*first_char + b*last_char + c*len) & (size-1),
+smallest table and multipliers first, and prints the first one that gives
+every code its own slot along with the k_dp_hash_slots[] initializer.
+Keep CODES in the same order as the tuya_dp_t enum.
+"""
+
+CODES = [
+    ("TUYA_DP_SWITCH", "switch"),
+    ("TUYA_DP_TEMP_SET", "temp_set"),
+    ("TUYA_DP_TEMP_CURRENT", "temp_current"),
+    ("TUYA_DP_TEMP_SET_F", "temp_set_f"),
+    ("TUYA_DP_MODE", "mode"),
+    ("TUYA_DP_HEAT", "heat"),
+    ("TUYA_DP_HEALTH", "health"),
+    ("TUYA_DP_CLEANING", "cleaning"),
+    ("TUYA_DP_FRESH_AIR_VALVE", "fresh_air_valve"),
+    ("TUYA_DP_COMPRESSOR_FREQUENCY", "compressor_frequency"),
+    ("TUYA_DP_URE", "ure"),
+]
+
+
+def search():
+    for size in (16, 32, 64):
+        for a in range(1, 32):
+            for b in range(0, 32):
+                for c in range(0, 32):
+                    slots = [(a * ord(code[0]) + b * ord(code[-1]) + c * len(code)) & (size - 1)
+                             for _, code in CODES]
+                    if len(set(slots)) == len(CODES):
+                        return size, a, b, c, slots
+    return None
+
+
+def main():
+    found = search()
+    if not found:
+        raise SystemExit("no perfect hash found; widen the search")
+    size, a, b, c, slots = found
+    print(f"hash = ({a}*first + {b}*last + {c}*len) & {size - 1}")
+    table = ["TUYA_DP_COUNT"] * size
+    for (name, _), slot in zip(CODES, slots):
+        table[slot] = name
+    print(f"static const uint8_t k_dp_hash_slots[{size}] = {{")
+    for slot, name in enumerate(table):
+        print(f"    {name + ',':<32}// {slot}")
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
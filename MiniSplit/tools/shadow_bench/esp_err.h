@@ -0,0 +1,11 @@
+// Host stand-in for ESP-IDF's esp_err.h, just enough for tuya_client.h's
+// declarations so tuya_shadow_parser.c builds off-target (see shadow_bench.c).
+#ifndef ESP_ERR_H_HOST_STUB
+#define ESP_ERR_H_HOST_STUB
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#endif
@@ -0,0 +1,253 @@
+// Host benchmark for src/tuya_shadow_parser.c
+//
+// Replays recorded shadow/properties responses through the streaming parser
+// the way HTTP_EVENT_ON_DATA would deliver them, checks the result doesn't
+// depend on where chunks split, and times it. Built with -DWITH_CJSON it
+// also runs the previous path (whole body in a 16KB buffer -> cJSON_Parse ->
+// strcmp chain) on the same input, checks both decode the same status, and
+// reports that path's time and peak heap.
+//
+// From MiniSplit/:
+//   cc -O2 -Itools/shadow_bench -Iinclude -o shadow_bench
+//      tools/shadow_bench/shadow_bench.c src/tuya_shadow_parser.c
+//   ./shadow_bench tools/shadow_bench/*.json
+//
+// To include the cJSON comparison, add the cJSON that the IDF component
+// manager fetched:
+//   cc -O2 -DWITH_CJSON -Itools/shadow_bench -Iinclude -o shadow_bench
+//      -Imanaged_components/espressif__cjson/cJSON managed_components/espressif__cjson/cJSON/cJSON.c
+//      tools/shadow_bench/shadow_bench.c src/tuya_shadow_parser.c
+//
+// shadow_properties.json is rebuilt from the 2026-07-05 live snapshot in
+// TUYA_DP_REFERENCE.md (same codes, types and field layout, with
+// placeholder times/dp_ids). Drop real captures next to it to bench those.
+
+#include "tuya_shadow_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef WITH_CJSON
+#include "cJSON.h"
+#endif
+
+#define ITERATIONS 2000
+#define ON_DATA_CHUNK 512       // Typical HTTP_EVENT_ON_DATA size with a 2KB client buffer
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static tuya_shadow_result_t parse_streaming(const char *body, size_t len, size_t chunk,
+                                            tuya_device_status_t *status, uint8_t *dp_ids)
+{
+    tuya_shadow_parser_t parser;
+    tuya_shadow_parser_init(&parser, status, dp_ids);
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = (len - off < chunk) ? len - off : chunk;
+        tuya_shadow_parser_feed(&parser, body + off, n);
+    }
+    return tuya_shadow_parser_finish(&parser);
+}
+
+static int32_t parser_error_code(const char *body, size_t len)
+{
+    tuya_device_status_t status;
+    tuya_shadow_parser_t parser;
+    tuya_shadow_parser_init(&parser, &status, NULL);
+    tuya_shadow_parser_feed(&parser, body, len);
+    return parser.error_code;
+}
+
+#ifdef WITH_CJSON
+static size_t g_heap_now;
+static size_t g_heap_peak;
+
+typedef struct {
+    size_t size;
+    max_align_t align;
+} alloc_header_t;
+
+static void *counting_malloc(size_t size)
+{
+    alloc_header_t *h = malloc(sizeof(alloc_header_t) + size);
+    h->size = size;
+    g_heap_now += size;
+    if (g_heap_now > g_heap_peak) {
+        g_heap_peak = g_heap_now;
+    }
+    return h + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (ptr) {
+        alloc_header_t *h = (alloc_header_t *)ptr - 1;
+        g_heap_now -= h->size;
+        free(h);
+    }
+}
+
+// The pre-streaming tuya_get_device_status() body, minus the HTTP.
+static int parse_cjson(const char *body, size_t len, tuya_device_status_t *status)
+{
+    char *buffer = counting_malloc(16384);
+    memcpy(buffer, body, len);
+    buffer[len] = '\0';
+
+    cJSON *root = cJSON_Parse(buffer);
+    counting_free(buffer);
+    if (!root) {
+        return -1;
+    }
+    cJSON *success = cJSON_GetObjectItem(root, "success");
+    cJSON *result_obj = cJSON_GetObjectItem(root, "result");
+    cJSON *status_arr = result_obj ? cJSON_GetObjectItem(result_obj, "properties") : NULL;
+    if (!success || !success->valueint || !status_arr) {
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    memset(status, 0, sizeof(*status));
+    cJSON *item = NULL;
+    cJSON_ArrayForEach(item, status_arr) {
+        const char *code = cJSON_GetStringValue(cJSON_GetObjectItem(item, "code"));
+        cJSON *v = cJSON_GetObjectItem(item, "value");
+        if (!code || !v) continue;
+        if (strcmp(code, "switch") == 0) status->switch_state = v->valueint;
+        else if (strcmp(code, "temp_set") == 0) status->temp_set = v->valueint;
+        else if (strcmp(code, "temp_current") == 0) status->temp_current = v->valueint;
+        else if (strcmp(code, "temp_set_f") == 0) status->temp_set_f = v->valueint;
+        else if (strcmp(code, "mode") == 0) {
+            if (cJSON_IsString(v)) status->ac_mode = (uint8_t)atoi(v->valuestring);
+        }
+        else if (strcmp(code, "heat") == 0) status->heat = v->valueint;
+        else if (strcmp(code, "health") == 0) status->health = v->valueint;
+        else if (strcmp(code, "cleaning") == 0) status->cleaning = v->valueint;
+        else if (strcmp(code, "fresh_air_valve") == 0) status->fresh_air_valve = v->valueint;
+        else if (strcmp(code, "compressor_frequency") == 0) status->compressor_frequency = v->valueint;
+        else if (strcmp(code, "ure") == 0) status->outdoor_temp = v->valueint;
+    }
+    cJSON_Delete(root);
+    return 0;
+}
+#endif
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*len + 1);
+    if (fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static void print_status(const tuya_device_status_t *s)
+{
+    printf("  switch=%d mode=%u temp_set=%d temp_set_f=%d temp_current=%d ure=%d comp=%dHz "
+           "heat=%d health=%d cleaning=%d fresh_air=%d\n",
+           s->switch_state, s->ac_mode, s->temp_set, s->temp_set_f, s->temp_current,
+           s->outdoor_temp, s->compressor_frequency, s->heat, s->health, s->cleaning,
+           s->fresh_air_valve);
+}
+
+static int bench_file(const char *path)
+{
+    size_t len = 0;
+    char *body = read_file(path, &len);
+    if (!body) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        return 1;
+    }
+
+    tuya_device_status_t reference;
+    uint8_t dp_ids[TUYA_DP_COUNT] = {0};
+    tuya_shadow_result_t result = parse_streaming(body, len, len, &reference, dp_ids);
+    printf("%s: %zu bytes, result %d\n", path, len, (int)result);
+
+    // Same answer no matter how the body is split across ON_DATA events.
+    for (size_t chunk = 1; chunk <= 64; chunk++) {
+        tuya_device_status_t split;
+        if (parse_streaming(body, len, chunk, &split, NULL) != result ||
+            memcmp(&split, &reference, sizeof(split)) != 0) {
+            fprintf(stderr, "%s: result differs with %zu-byte chunks\n", path, chunk);
+            free(body);
+            return 1;
+        }
+    }
+
+    if (result != TUYA_SHADOW_OK) {
+        printf("  not a successful shadow response (code %d)\n", (int)parser_error_code(body, len));
+        free(body);
+        return 0;
+    }
+
+    print_status(&reference);
+    printf("  dp_ids:");
+    for (int dp = 0; dp < TUYA_DP_COUNT; dp++) {
+        printf(" %s=%u", tuya_dp_code((tuya_dp_t)dp), dp_ids[dp]);
+    }
+    printf("\n");
+
+    double start = now_us();
+    for (int i = 0; i < ITERATIONS; i++) {
+        tuya_device_status_t status;
+        parse_streaming(body, len, ON_DATA_CHUNK, &status, NULL);
+    }
+    double streaming_us = (now_us() - start) / ITERATIONS;
+    printf("  streaming: %8.1f us/parse, heap 0 B, parser state %zu B (stack)\n",
+           streaming_us, sizeof(tuya_shadow_parser_t));
+
+#ifdef WITH_CJSON
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = counting_free };
+    cJSON_InitHooks(&hooks);
+
+    tuya_device_status_t legacy;
+    g_heap_now = g_heap_peak = 0;
+    if (parse_cjson(body, len, &legacy) != 0 || memcmp(&legacy, &reference, sizeof(legacy)) != 0) {
+        fprintf(stderr, "%s: cJSON path disagrees with streaming parser\n", path);
+        print_status(&legacy);
+        free(body);
+        return 1;
+    }
+    size_t legacy_peak = g_heap_peak;
+
+    start = now_us();
+    for (int i = 0; i < ITERATIONS; i++) {
+        parse_cjson(body, len, &legacy);
+    }
+    double legacy_us = (now_us() - start) / ITERATIONS;
+    printf("  cJSON:     %8.1f us/parse, heap peak %zu B (16KB body buffer + tree)\n",
+           legacy_us, legacy_peak);
+    printf("  speedup %.1fx\n", legacy_us / streaming_us);
+#endif
+
+    free(body);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s response.json [...]\n", argv[0]);
+        return 2;
+    }
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        failures += bench_file(argv[i]);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+"""Host-side stand-in for the mini-split's Tuya Wi-Fi module (LAN protocol 3.3 / 3.4).
+
+Lets the firmware's local session (src/tuya_local.c) be developed and timed
+without the real indoor unit:
+
+    # Pretend to be the unit (point TUYA_LOCAL_HOST at this machine)
+    python3 tools/tuya_mock_device.py serve --key 0123456789abcdef --version 3.4
+
+    # Time CONTROL -> ack round trips against the mock (or the real unit)
+    python3 tools/tuya_mock_device.py bench --host 127.0.0.1 --key 0123456789abcdef --version 3.4
+
+The mock keeps a DP table keyed by numeric id, answers DP queries, applies
+CONTROL frames, pushes a STATUS frame for every change (like the real unit
+does) and drifts temp_current now and then so unsolicited pushes get
+exercised too. DP ids must match what the real unit's cloud shadow reports
+(the firmware learns them from its dp_id field); override the defaults below
+with --dps if yours differ.
+
+Requires the 'cryptography' package (pip install cryptography).
+"""
+
+import argparse
+import asyncio
+import hashlib
+import hmac
+import json
+import os
+import random
+import struct
+import time
+import zlib
+
+from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+
+PREFIX = 0x000055AA
+SUFFIX = 0x0000AA99
+
+SESS_KEY_NEG_START = 0x03
+SESS_KEY_NEG_RESP = 0x04
+SESS_KEY_NEG_FINISH = 0x05
+CONTROL = 0x07
+STATUS = 0x08
+HEART_BEAT = 0x09
+DP_QUERY = 0x0A
+CONTROL_NEW = 0x0D
+DP_QUERY_NEW = 0x10
+
+NEGOTIATION_CMDS = (SESS_KEY_NEG_START, SESS_KEY_NEG_RESP, SESS_KEY_NEG_FINISH)
+
+# Default DP table: id -> value, matching TUYA_DP_REFERENCE.md's live snapshot.
+DEFAULT_DPS = {
+    "1": True,      # switch
+    "2": 2100,      # temp_set
+    "3": 2030,      # temp_current
+    "4": "1",       # mode (cool)
+    "5": False,     # heat
+    "6": False,     # health
+    "7": False,     # cleaning
+    "8": False,     # fresh_air_valve
+    "9": 14,        # compressor_frequency
+    "10": 2600,     # ure (outdoor temp)
+    "11": 70,       # temp_set_f
+}
+
+
+def aes_encrypt(key, data, pad=True):
+    if pad:
+        n = 16 - len(data) % 16
+        data = data + bytes([n]) * n
+    enc = Cipher(algorithms.AES(key), modes.ECB()).encryptor()
+    return enc.update(data) + enc.finalize()
+
+
+def aes_decrypt(key, data):
+    dec = Cipher(algorithms.AES(key), modes.ECB()).decryptor()
+    plain = dec.update(data) + dec.finalize()
+    n = plain[-1]
+    if n == 0 or n > 16:
+        raise ValueError("bad padding (wrong key?)")
+    return plain[:-n]
+
+
+class Session:
+    """Framing/crypto for one connection, shared by the mock and the bench client."""
+
+    def __init__(self, reader, writer, local_key, version, is_device):
+        self.reader = reader
+        self.writer = writer
+        self.local_key = local_key
+        self.key = local_key
+        self.version = version
+        self.is_device = is_device
+        self.seq = 0
+
+    def _trailer(self, key, data):
+        if self.version == "3.4":
+            return hmac.new(key, data, hashlib.sha256).digest()
+        return struct.pack(">I", zlib.crc32(data) & 0xFFFFFFFF)
+
+    def _trailer_size(self):
+        return 32 if self.version == "3.4" else 4
+
+    async def send(self, cmd, data, seq=None):
+        key = self.local_key if cmd in NEGOTIATION_CMDS else self.key
+        # The client puts the version header on CONTROL, the device on STATUS.
+        header_needed = (cmd == STATUS) if self.is_device else (cmd in (CONTROL, CONTROL_NEW))
+        version_header = self.version.encode() + b"\0" * 12
+        if not data and self.is_device:
+            payload = b""   # Bare acks carry only the return code
+        elif self.version == "3.4":
+            payload = aes_encrypt(key, (version_header if header_needed else b"") + data)
+        elif header_needed:
+            payload = version_header + aes_encrypt(key, data)
+        else:
+            payload = aes_encrypt(key, data)
+        if self.is_device:
+            payload = struct.pack(">I", 0) + payload
+        if seq is None:
+            self.seq += 1
+            seq = self.seq
+        length = len(payload) + self._trailer_size() + 4
+        frame = struct.pack(">IIII", PREFIX, seq, cmd, length) + payload
+        frame += self._trailer(key, frame) + struct.pack(">I", SUFFIX)
+        self.writer.write(frame)
+        await self.writer.drain()
+
+    async def recv(self):
+        header = await self.reader.readexactly(16)
+        prefix, seq, cmd, length = struct.unpack(">IIII", header)
+        if prefix != PREFIX:
+            raise ValueError("bad prefix")
+        rest = await self.reader.readexactly(length)
+        ts = self._trailer_size()
+        body, trailer, suffix = rest[:-ts - 4], rest[-ts - 4:-4], rest[-4:]
+        if struct.unpack(">I", suffix)[0] != SUFFIX:
+            raise ValueError("bad suffix")
+        key = self.local_key if cmd in NEGOTIATION_CMDS else self.key
+        if self._trailer(key, header + body) != trailer:
+            raise ValueError("bad CRC/HMAC")
+        if not self.is_device and len(body) >= 4 and struct.unpack(">I", body[:4])[0] & 0xFFFFFF00 == 0:
+            body = body[4:]
+        if self.version == "3.3" and body[:3] == b"3.3":
+            body = body[15:]
+        plain = aes_decrypt(key, body) if body else b""
+        if self.version == "3.4" and plain[:3] == b"3.4":
+            plain = plain[15:]
+        return seq, cmd, plain
+
+
+class MockDevice:
+    def __init__(self, args):
+        self.key = args.key.encode()
+        self.version = args.version
+        self.device_id = args.device_id
+        self.dps = dict(DEFAULT_DPS)
+        if args.dps:
+            with open(args.dps) as f:
+                self.dps = {str(k): v for k, v in json.load(f).items()}
+        self.drift_s = args.drift
+        self.sessions = set()
+
+    def status_payload(self, dps):
+        t = int(time.time())
+        if self.version == "3.4":
+            return json.dumps({"protocol": 4, "t": t, "data": {"dps": dps}}).encode()
+        return json.dumps({"devId": self.device_id, "dps": dps, "t": t}).encode()
+
+    async def push(self, changed):
+        for session in list(self.sessions):
+            try:
+                await session.send(STATUS, self.status_payload(changed))
+            except (ConnectionError, OSError):
+                self.sessions.discard(session)
+
+    async def negotiate(self, session):
+        _, cmd, local_nonce = await session.recv()
+        if cmd != SESS_KEY_NEG_START or len(local_nonce) != 16:
+            raise ValueError("expected session key negotiation")
+        remote_nonce = os.urandom(16)
+        proof = hmac.new(self.key, local_nonce, hashlib.sha256).digest()
+        await session.send(SESS_KEY_NEG_RESP, remote_nonce + proof)
+        _, cmd, finish = await session.recv()
+        expected = hmac.new(self.key, remote_nonce, hashlib.sha256).digest()
+        if cmd != SESS_KEY_NEG_FINISH or finish != expected:
+            raise ValueError("client failed key negotiation")
+        mixed = bytes(a ^ b for a, b in zip(local_nonce, remote_nonce))
+        session.key = aes_encrypt(self.key, mixed, pad=False)
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info("peername")
+        session = Session(reader, writer, self.key, self.version, is_device=True)
+        print(f"[mock] connect from {peer}")
+        try:
+            if self.version == "3.4":
+                await self.negotiate(session)
+            self.sessions.add(session)
+            while True:
+                seq, cmd, plain = await session.recv()
+                started = time.perf_counter()
+                if cmd == HEART_BEAT:
+                    await session.send(HEART_BEAT, b"{}", seq)
+                elif cmd in (DP_QUERY, DP_QUERY_NEW):
+                    await session.send(cmd, self.status_payload(self.dps), seq)
+                elif cmd in (CONTROL, CONTROL_NEW):
+                    request = json.loads(plain)
+                    dps = request.get("dps") or request.get("data", {}).get("dps", {})
+                    changed = {k: v for k, v in dps.items() if self.dps.get(k) != v}
+                    self.dps.update(dps)
+                    await session.send(cmd, b"", seq)
+                    if changed:
+                        await self.push(changed)
+                    print(f"[mock] control {dps} handled in "
+                          f"{(time.perf_counter() - started) * 1000:.2f}ms")
+                else:
+                    print(f"[mock] ignoring cmd 0x{cmd:02x}")
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        except ValueError as e:
+            print(f"[mock] dropping {peer}: {e}")
+        finally:
+            self.sessions.discard(session)
+            writer.close()
+            print(f"[mock] disconnect {peer}")
+
+    async def drift(self):
+        while True:
+            await asyncio.sleep(self.drift_s)
+            if self.sessions:
+                self.dps["3"] = int(self.dps.get("3", 2000)) + random.choice((-10, 10))
+                await self.push({"3": self.dps["3"]})
+
+
+async def serve(args):
+    mock = MockDevice(args)
+    server = await asyncio.start_server(mock.handle, args.bind, args.port)
+    print(f"[mock] Tuya {args.version} device '{args.device_id}' listening on {args.bind}:{args.port}")
+    tasks = [server.serve_forever()]
+    if args.drift > 0:
+        tasks.append(mock.drift())
+    await asyncio.gather(*tasks)
+
+
+async def bench(args):
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    session = Session(reader, writer, args.key.encode(), args.version, is_device=False)
+    if args.version == "3.4":
+        local_nonce = os.urandom(16)
+        await session.send(SESS_KEY_NEG_START, local_nonce)
+        _, _, resp = await session.recv()
+        remote_nonce = resp[:16]
+        await session.send(SESS_KEY_NEG_FINISH,
+                           hmac.new(session.local_key, remote_nonce, hashlib.sha256).digest())
+        mixed = bytes(a ^ b for a, b in zip(local_nonce, remote_nonce))
+        session.key = aes_encrypt(session.local_key, mixed, pad=False)
+
+    query = DP_QUERY_NEW if args.version == "3.4" else DP_QUERY
+    await session.send(query, json.dumps({"gwId": args.device_id, "devId": args.device_id,
+                                          "uid": args.device_id, "t": str(int(time.time()))}).encode()
+                       if args.version == "3.3" else b"{}")
+    _, _, snapshot = await session.recv()
+    print(f"[bench] snapshot: {snapshot.decode()}")
+
+    control = CONTROL_NEW if args.version == "3.4" else CONTROL
+    samples = []
+    for i in range(args.count):
+        dps = {args.dp: 2100 + (i % 2) * 50}
+        if args.version == "3.4":
+            body = {"protocol": 5, "t": int(time.time()), "data": {"dps": dps}}
+        else:
+            body = {"devId": args.device_id, "uid": args.device_id, "t": str(int(time.time())), "dps": dps}
+        started = time.perf_counter()
+        await session.send(control, json.dumps(body).encode())
+        while True:
+            _, cmd, _ = await session.recv()
+            if cmd == control:
+                break
+        samples.append((time.perf_counter() - started) * 1000)
+
+    writer.close()
+    samples.sort()
+    print(f"[bench] {len(samples)} commands: min {samples[0]:.2f}ms  "
+          f"median {samples[len(samples) // 2]:.2f}ms  max {samples[-1]:.2f}ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    sub = parser.add_subparsers(dest="mode", required=True)
+    for name in ("serve", "bench"):
+        p = sub.add_parser(name)
+        p.add_argument("--key", required=True, help="16-character local key")
+        p.add_argument("--version", choices=("3.3", "3.4"), default="3.3")
+        p.add_argument("--port", type=int, default=6668)
+        p.add_argument("--device-id", default="mockdevice0000000000")
+    sub.choices["serve"].add_argument("--bind", default="::")
+    sub.choices["serve"].add_argument("--dps", help="JSON file of {dp_id: value} to start from")
+    sub.choices["serve"].add_argument("--drift", type=float, default=20.0,
+                                      help="seconds between unsolicited temp_current pushes (0 = off)")
+    sub.choices["bench"].add_argument("--host", default="127.0.0.1")
+    sub.choices["bench"].add_argument("--count", type=int, default=100)
+    sub.choices["bench"].add_argument("--dp", default="2", help="DP id to toggle (default temp_set)")
+    args = parser.parse_args()
+    if len(args.key) != 16:
+        parser.error("--key must be exactly 16 characters")
+
+    try:
+        asyncio.run(serve(args) if args.mode == "serve" else bench(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -7,8 +7,8 @@
 //
 #define MAX_ADC_READING 4095
 #define ADC_REF_VOLTAGE 3.3  
-#define SAMPLES   10          //number of samples to take
-#define WAITTIME  20          //time to wait between samples in ms
+#define SAMPLES   16          //number of samples to take (oversampled in one burst and averaged)
+#define WAITTIME  50          //time to wait between samples in microseconds
 #define TOLERANCE 5           //% of max adc reading to e used to determine if we need to resample
 #define MAXTRIES  3           //# of times we'll try and get a clean read that is within tolerance  
 
@@ -17,6 +17,25 @@
 #define MUX_SEL_0  2
 #define MUX_SEL_1  5
 
+//MUX inputs, in the order they're read
+#define MUX_LDR     0
+#define MUX_UV1     1
+#define MUX_UV2     2
+#define MUX_UV3     3
+#define MUX_INPUTS  4
+
+//how long each MUX input needs to settle once selected, in ms.  The sensors behind the MUX are powered by its enable,
+//  which readSensors() gives SENSOR_SETTLE_MS before the first read, so these only cover switching between inputs
+//  (see "ADC settle times" in the readme for how to measure them)
+#define MUX_SETTLE_LDR_MS  20       //LDR divider is high impedance in the dark, so it's slowest (not swept yet)
+#define MUX_SETTLE_UV_MS   5        //UV breakouts have a buffered output (not swept yet)
+
+//settle sweep - posts how long each MUX input really takes to /admin (adc_settle).  Keeps the ESP awake ~8s a cycle
+//#define ADC_SETTLE_SWEEP
+#define SWEEP_STEPS        10       //reads per input, at 0,1,2,5,10,20,40,80,160,320ms
+#define SWEEP_OFF_MS       1000     //MUX (and the sensors) off before powering up on an input
+#define SWEEP_TOLERANCE    0.5      //% of max adc reading an input has to stay within of its last read to be settled
+
 //adc pins
 // Note that 15 doesn't work when wifi is enabled
 #define CAP_VOLTAGE_PIN     39    
@@ -41,7 +60,8 @@ class ADCHandler
 
   public:
     void init();
-    void storeSamples();
+    void startSamples();
+    bool serviceSamples();
     double getCapVoltage();
     double getVCCVoltage();
     long getIllumination();
@@ -50,9 +70,14 @@ class ADCHandler
     double getUV1();
     double getUV2();
     double getUV3();
+#ifdef ADC_SETTLE_SWEEP
+    void settleSweep();
+    const char *getSettleSweep();
+#endif
     
   private: 
     int readADC(int);
+    void selectMuxInput(int);
     int readDigital(int);
     long getIllum(int);
     double getVolts(int);
@@ -61,13 +86,21 @@ class ADCHandler
 
     int _capVoltage;
     int _vccVoltage;
-    int _ldr;
     int _moisture;
-    int _uv1;    
-    int _uv2;    
-    int _uv3;    
+    int _mux[MUX_INPUTS];
+
+    //MUX state machine
+    int muxInput;
+    unsigned long muxSelectedTime;
+    unsigned long muxSettleTime;
 
     long sampleValues[SAMPLES];
+
+#ifdef ADC_SETTLE_SWEEP
+    unsigned long sweepSettle();
+    int readBurst(int);
+    char sweepResult[160];
+#endif
 };
 
 
@@ -16,66 +16,69 @@ void ADCHandler::init()
   digitalWrite(MUX_EN, HIGH);  //disable MUX
 }
 
-void ADCHandler::storeSamples()
+//MUX select lines and settle time for each input
+struct MuxSelect
 {
-  //raw
-  _capVoltage = readADC(CAP_VOLTAGE_PIN);
-  _vccVoltage = readADC(VCC_VOLTAGE_PIN);
-  _moisture = readDigital(MOISTURE_PIN);
+  const char *name;
+  int sel0;
+  int sel1;
+  unsigned long settleMS;
+};
+
+static const MuxSelect muxSelects[MUX_INPUTS] = {
+  {"LDR", HIGH, HIGH, MUX_SETTLE_LDR_MS},
+  {"UV1", LOW,  LOW,  MUX_SETTLE_UV_MS},
+  {"UV2", LOW,  HIGH, MUX_SETTLE_UV_MS},
+  {"UV3", HIGH, LOW,  MUX_SETTLE_UV_MS}
+};
+
+//Powers up the MUX (and the sensors behind it) and selects the first input.  Call serviceSamples() until it returns true.
+void ADCHandler::startSamples()
+{
+  digitalWrite(MUX_EN, LOW);
+  selectMuxInput(0);
+}
 
+//Reads the selected MUX input once it has settled and moves to the next one, then the direct pins.  Returns true once all are read.
+bool ADCHandler::serviceSamples()
+{
+  if(muxInput>=MUX_INPUTS)
+    return true;
 
-  //Read inputs from MUX
-  //
-  //enable MUX
-  digitalWrite(MUX_EN, LOW);
+  //still settling
+  if(millis()-muxSelectedTime < muxSettleTime)
+    return false;
 
-//for(int i=0;i<20;i++)
-//{
-  //select LDR
-  digitalWrite(MUX_SEL_0, HIGH);
-  digitalWrite(MUX_SEL_1, HIGH);
-  delay(100);
+  _mux[muxInput] = readADC(MUX_PIN);
+
+  //next input, or we're done
+  if(muxInput+1<MUX_INPUTS)
+  {
+    selectMuxInput(muxInput+1);
+    return false;
+  }
 
-  
-//Serial.print("high/high: ");
-//delay(10000);
-  _ldr = readADC(MUX_PIN);
-//Serial.println(_ldr);
-
-  //select UV1
-  digitalWrite(MUX_SEL_0, LOW);
-  digitalWrite(MUX_SEL_1, LOW);
-  delay(100);  
-
-//Serial.print("low/low: ");
-//delay(10000);  
-  _uv1 = readADC(MUX_PIN);
-//Serial.println(_uv1);
-
-  //select UV2
-  digitalWrite(MUX_SEL_0, LOW);
-  digitalWrite(MUX_SEL_1, HIGH);
-  delay(100);
-
-//Serial.print("low/high: ");
-//delay(10000);  
-  _uv2 = readADC(MUX_PIN);
-//Serial.println(_uv2);
-
-    //select UV3
-  digitalWrite(MUX_SEL_0, HIGH);
-  digitalWrite(MUX_SEL_1, LOW);
-  delay(100);
-
-//Serial.print("high/low: ");
-//delay(10000);  
-  _uv3 = readADC(MUX_PIN);
-//Serial.println(_uv3);
-//}
   // disable MUX
   digitalWrite(MUX_EN, HIGH);
+  muxInput=MUX_INPUTS;
+
+  //raw (with the sensors behind the MUX off, as they've always been read)
+  _capVoltage = readADC(CAP_VOLTAGE_PIN);
+  _vccVoltage = readADC(VCC_VOLTAGE_PIN);
+  _moisture = readDigital(MOISTURE_PIN);
 
-  logger.log(VERBOSE,"RAW ADC VALUES: cap voltage: %d, vcc voltage: %d, LDR: %d, Moisture: %d, UV1-3: %d,%d,%d",_capVoltage,_vccVoltage,_ldr,_moisture,_uv1,_uv2,_uv3);  
+  logger.log(VERBOSE,"RAW ADC VALUES: cap voltage: %d, vcc voltage: %d, LDR: %d, Moisture: %d, UV1-3: %d,%d,%d",_capVoltage,_vccVoltage,_mux[MUX_LDR],_moisture,_mux[MUX_UV1],_mux[MUX_UV2],_mux[MUX_UV3]);  
+  return true;
+}
+
+void ADCHandler::selectMuxInput(int input)
+{
+  digitalWrite(MUX_SEL_0, muxSelects[input].sel0);
+  digitalWrite(MUX_SEL_1, muxSelects[input].sel1);
+
+  muxInput=input;
+  muxSelectedTime=millis();
+  muxSettleTime=muxSelects[input].settleMS;
 }
 
 double ADCHandler::getCapVoltage()
@@ -96,7 +99,7 @@ double ADCHandler::getVCCVoltage()
 
 long ADCHandler::getIllumination()
 {
-  long ldr=getIllum(_ldr);   //1-100000 brightness;
+  long ldr=getIllum(_mux[MUX_LDR]);   //1-100000 brightness;
   
   return ldr;
 }
@@ -110,11 +113,11 @@ String ADCHandler::getMoisture()
 
 double ADCHandler::getUV()
 {
-  int _uv=_uv1;  //default to uv1
-  if(_uv2>_uv)
-    _uv=_uv2;  //use uv2 if it's higher  
-  if(_uv3>_uv)
-    _uv=_uv3;  //use uv3 if it's higher  
+  int _uv=_mux[MUX_UV1];  //default to uv1
+  if(_mux[MUX_UV2]>_uv)
+    _uv=_mux[MUX_UV2];  //use uv2 if it's higher  
+  if(_mux[MUX_UV3]>_uv)
+    _uv=_mux[MUX_UV3];  //use uv3 if it's higher  
   double uv=getUVIndex(_uv);
     
   return round2(uv);
@@ -122,18 +125,85 @@ double ADCHandler::getUV()
 
 double ADCHandler::getUV1()
 {
-  return getUVIndex(_uv1);
+  return getUVIndex(_mux[MUX_UV1]);
 }
 
 double ADCHandler::getUV2()
 {
-  return getUVIndex(_uv2);
+  return getUVIndex(_mux[MUX_UV2]);
 }
 
 double ADCHandler::getUV3()
 {
-  return getUVIndex(_uv3);
+  return getUVIndex(_mux[MUX_UV3]);
+}
+
+#ifdef ADC_SETTLE_SWEEP
+static const unsigned long sweepTimes[SWEEP_STEPS] = {0,1,2,5,10,20,40,80,160,320};
+
+//For each MUX input: power the MUX up cold on it, then switch to it from another input warm, reading it at each of
+//  sweepTimes.  The settle time is the first of those from which every read stays within SWEEP_TOLERANCE of the last
+//  one (320 means it never settled).  "cold" is what SENSOR_SETTLE_MS has to cover, "warm" the MUX_SETTLE_*_MS for it.
+void ADCHandler::settleSweep()
+{
+  int len=0;
+  sweepResult[0]=0;
+  for(int input=0;input<MUX_INPUTS;input++)
+  {
+    digitalWrite(MUX_EN, HIGH);
+    delay(SWEEP_OFF_MS);
+    selectMuxInput(input);
+    digitalWrite(MUX_EN, LOW);
+    unsigned long cold=sweepSettle();
+
+    selectMuxInput((input+1)%MUX_INPUTS);
+    delay(sweepTimes[SWEEP_STEPS-1]);
+    selectMuxInput(input);
+    unsigned long warm=sweepSettle();
+
+    len+=snprintf(sweepResult+len,sizeof(sweepResult)-len,"%s%s cold %lu warm %lu",len ? ", " : "",muxSelects[input].name,cold,warm);
+  }
+
+  digitalWrite(MUX_EN, HIGH);
+  muxInput=MUX_INPUTS;
+  logger.log(INFO,"ADC settle times (ms): %s",sweepResult);
+}
+
+const char *ADCHandler::getSettleSweep()
+{
+  return sweepResult;
+}
+
+unsigned long ADCHandler::sweepSettle()
+{
+  int readings[SWEEP_STEPS];
+  for(int i=0;i<SWEEP_STEPS;i++)
+  {
+    while(millis()-muxSelectedTime < sweepTimes[i])
+      ;
+    readings[i]=readBurst(MUX_PIN);
+  }
+
+  int tolerance=MAX_ADC_READING*(SWEEP_TOLERANCE/100.0);
+  int settled=SWEEP_STEPS-1;
+  while(settled>0 && abs(readings[settled-1]-readings[SWEEP_STEPS-1])<=tolerance)
+    settled--;
+
+  return sweepTimes[settled];
+}
+
+//One burst without readADC()'s retries, for when the timing matters more than the noise
+int ADCHandler::readBurst(int pin)
+{
+  long sampleSum=0;
+  for(int i = 0; i < SAMPLES; i++) {
+    sampleSum += analogRead(pin);
+    delayMicroseconds(WAITTIME);
+  }
+
+  return sampleSum/SAMPLES;
 }
+#endif
 
 int ADCHandler::readDigital(int pin)
 {
@@ -161,11 +231,11 @@ int ADCHandler::readADC(int pin)
     stdDev = 0.0;
     tolerance = 0.0;    
 
-    //Read samples and sum them
+    //Read a burst of samples and sum them
     for(int i = 0; i < SAMPLES; i++) {
       sampleValues[i] = analogRead(pin);
       sampleSum += sampleValues[i];
-      delay(WAITTIME); // set this to whatever you want
+      delayMicroseconds(WAITTIME);
     }
 
     //calc mean
@@ -0,0 +1,121 @@
+#include <math.h>
+#include "NowCast.h"
+
+//Breakpoint data for calculations
+const struct breakPoint pm25BreakPoints[6] = {
+                        {"Good", 0, 12.1, 0, 50},
+                        {"Moderate", 12.1, 35.5, 51, 100},
+                        {"Sensitive", 35.5, 55.5, 101, 150},
+                        {"Unhealthy", 55.5, 150.5, 151, 200},
+                        {"Very Unhealthy", 150.5, 250.5, 201, 300},
+                        {"Hazardous", 250.5, 500.6, 301, 500}
+                    };
+
+const struct breakPoint pm100BreakPoints[6] = {
+                        {"Good", 0, 55, 0, 50},
+                        {"Moderate", 55, 155, 51, 100},
+                        {"Sensitive", 155, 255, 101, 150},
+                        {"Unhealthy", 255, 355, 151, 200},
+                        {"Very Unhealthy", 355, 425, 201, 300},
+                        {"Hazardous", 425, 605, 301, 500}
+                    };
+
+//Both NowCasts in two passes over the history, once for min/max, once for the weighted sums.
+//  The weight comes from the min/max of the whole window, so the sums can't be kept running
+//  from one reading to the next; each reading is 2x12 entries and no pow().
+void calcNowCasts(const struct concenReading *history,int currentIdx,double &pm25NowCast,double &pm100NowCast)
+{
+  double pm25max=0;
+  double pm25min=999;
+  double pm100max=0;
+  double pm100min=999;
+
+  //loop through the table and find min and max
+  for(int i=0;i<CONCEN_HIST_SIZE;i++)
+  {
+    //only deal with entries that have a timestamp
+    if(history[i].epoch>0)
+    {
+      if(history[i].pm25 > pm25max) {
+        pm25max=history[i].pm25; }
+      if(history[i].pm25 < pm25min) {
+        pm25min=history[i].pm25; }
+
+      if(history[i].pm100 > pm100max) {
+        pm100max=history[i].pm100; }
+      if(history[i].pm100 < pm100min) {
+        pm100min=history[i].pm100; }
+    }
+  }
+
+  double pm25Weight=calcPMSWeight(pm25min,pm25max);
+  double pm100Weight=calcPMSWeight(pm100min,pm100max);
+
+  //Weight the history, sum(c*weight^location) with location 0 the newest and 11 the oldest.
+  //  Walks from oldest to newest multiplying the running sums by the weight each step (Horner's rule)
+  //  instead of calling pow() for every entry
+  double v1P25Sum=0;
+  double v2P25Sum=0;
+  double v1P100Sum=0;
+  double v2P100Sum=0;
+
+  //oldest entry is the current open slot, newest is the one just before it
+  for(int n=0;n<CONCEN_HIST_SIZE;n++)
+  {
+    int i=(currentIdx+n)%CONCEN_HIST_SIZE;
+
+    v1P25Sum = v1P25Sum*pm25Weight;
+    v2P25Sum = v2P25Sum*pm25Weight;
+    v1P100Sum = v1P100Sum*pm100Weight;
+    v2P100Sum = v2P100Sum*pm100Weight;
+
+    if(history[i].epoch>0)
+    {
+      v1P25Sum = v1P25Sum + history[i].pm25;
+      v2P25Sum = v2P25Sum + 1;
+      v1P100Sum = v1P100Sum + history[i].pm100;
+      v2P100Sum = v2P100Sum + 1;
+    }
+  }
+
+  pm25NowCast = v1P25Sum/v2P25Sum;
+  pm100NowCast = v1P100Sum/v2P100Sum;
+}
+
+//Calc weight factor
+double calcPMSWeight(double min,double max)
+{
+    double weight = 1.0;
+    if(max>0){
+      weight = 1-((max-min)/max); }
+    if(weight < .5) {
+      weight=.5; }
+    if(weight>1) {
+      weight=1; }
+
+    return weight;
+}
+
+//Finally, let's find the AQI value
+const char* calcAQI(double nowCast,const struct breakPoint *breakPoints,int &AQI)
+{
+  AQI=0;
+  const char* label="n/a";
+
+  for(int i=0;i<6;i++)  //size of the breakpoint list
+  {
+    if(nowCast>=breakPoints[i].conc_lo && nowCast<breakPoints[i].conc_hi)
+    {
+      double numerator=breakPoints[i].AQI_hi-breakPoints[i].AQI_lo;
+      double denom=breakPoints[i].conc_hi-breakPoints[i].conc_lo;
+      double first=numerator/denom;
+      double neg=nowCast-breakPoints[i].conc_lo;
+      double aqidouble=(first*neg)+breakPoints[i].AQI_lo;
+      AQI = round(aqidouble);
+      label=breakPoints[i].label;
+      break;
+    }
+  }
+
+  return label;
+}
@@ -0,0 +1,33 @@
+#ifndef nowcast_h
+#define nowcast_h
+
+//NowCast and AQI from the last 12 PMS readings
+// https://forum.airnowtech.org/t/the-nowcast-for-pm2-5-and-pm10/172
+
+#define CONCEN_HIST_SIZE    12
+
+struct breakPoint
+{
+  const char* label;
+  double conc_lo;
+  double conc_hi;
+  double AQI_lo;
+  double AQI_hi;
+};
+
+struct concenReading
+{
+  unsigned long epoch;
+  int pm25;
+  int pm100;
+};
+
+extern const struct breakPoint pm25BreakPoints[6];
+extern const struct breakPoint pm100BreakPoints[6];
+
+//history is circular, currentIdx is the open slot (the oldest entry once it's full); entries with epoch 0 are empty
+void calcNowCasts(const struct concenReading *history,int currentIdx,double &pm25NowCast,double &pm100NowCast);
+double calcPMSWeight(double min,double max);
+const char* calcAQI(double nowCast,const struct breakPoint *breakPoints,int &AQI);
+
+#endif
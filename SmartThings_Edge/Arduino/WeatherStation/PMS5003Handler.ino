@@ -22,7 +22,10 @@ bool PMS5003Handler::storeSamples()
   }
 
   //Add to our last 12 list
-  concenHistory[currentIdx]={currentTime(), getPM25Standard(), getPM100Standard()};
+  if(concenHistory[currentIdx].epoch==0)
+    historyCount++;
+  lastReadTime=currentTime();
+  concenHistory[currentIdx]={lastReadTime, getPM25Standard(), getPM100Standard()};
 
   //dump history to the logger
   logger.log(VERBOSE,"Concentration History: ");    
@@ -50,12 +53,18 @@ bool PMS5003Handler::storeSamples()
   return success;
 }
 
-//calc AQI for pm25
-// https://forum.airnowtech.org/t/the-nowcast-for-pm2-5-and-pm10/172
+//calc AQI for pm25 and pm100 together (NowCast.cpp)
 void PMS5003Handler::calcBothAQI()
 {
-  calcPM25AQI();
-  calcPM100AQI();
+  double pm25NowCast,pm100NowCast;
+
+  calcNowCasts(concenHistory,currentIdx,pm25NowCast,pm100NowCast);
+
+  pm25Label=calcAQI(pm25NowCast,pm25BreakPoints,pm25AQI);
+  pm100Label=calcAQI(pm100NowCast,pm100BreakPoints,pm100AQI);
+ 
+  logger.log(VERBOSE,"PM25: Count: %d Nowcast: %f AQI: %d Label: %s",historyCount,pm25NowCast,pm25AQI,pm25Label);
+  logger.log(VERBOSE,"PM100: Count: %d Nowcast: %f AQI: %d Label: %s",historyCount,pm100NowCast,pm100AQI,pm100Label);
 }
 
 int PMS5003Handler::getPM25AQI()
@@ -78,152 +87,12 @@ const char *PMS5003Handler::getPM100Label()
   return pm100Label;
 }
 
-void PMS5003Handler::calcPM25AQI()
-{
-  int count;
-  double pm25min,pm25max,pm100min,pm100max;
-  double v1P25Sum,v2P25Sum,v1P100Sum,v2P100Sum;
-
-  calcPMSMinMax(pm25min,pm25max,pm100min,pm100max,count);
-  double weight = calcPMSWeight(pm25min,pm25max);
-  sumWeights(count,weight,v1P25Sum,v2P25Sum,v1P100Sum,v2P100Sum);
-  double nowCast = v1P25Sum/v2P25Sum;
-  pm25Label=calcAQI(nowCast,pm25BreakPoints,pm25AQI);
- 
-  logger.log(VERBOSE,"PM25: Count: %d Nowcast: %f AQI: %d Label: %s",count,nowCast,pm25AQI,pm25Label);
-}
-
-void PMS5003Handler::calcPM100AQI()
-{
-  int count;
-  double pm25min,pm25max,pm100min,pm100max;
-  double v1P25Sum,v2P25Sum,v1P100Sum,v2P100Sum;
-
-  calcPMSMinMax(pm25min,pm25max,pm100min,pm100max,count);
-  double weight = calcPMSWeight(pm100min,pm100max);
-  sumWeights(count,weight,v1P25Sum,v2P25Sum,v1P100Sum,v2P100Sum);
-  double nowCast = v1P100Sum/v2P100Sum;
-  pm100Label=calcAQI(nowCast,pm100BreakPoints,pm100AQI);
-  
-  logger.log(VERBOSE,"PM100: Count: %d Nowcast: %f AQI: %d Label: %s",count,nowCast,pm100AQI,pm100Label);
-}
-
+//most recent read time is kept as samples are stored
 int PMS5003Handler::getLastReadTime()
 {
-  int lastReadTime=0;
-
-  //loop through the table and find the most recent read time
-  for(int i=0;i<CONCEN_HIST_SIZE;i++)
-  {
-    //only deal with entries that have a timestamp
-    if(concenHistory[i].epoch>0)
-    {
-      if(concenHistory[i].epoch > lastReadTime) 
-      {
-        lastReadTime=concenHistory[i].epoch; 
-      }
-    }
-  }
-
   return lastReadTime;  
 }
 
-//Get minmax for pms calculations
-void PMS5003Handler::calcPMSMinMax(double &pm25min,double &pm25max,double &pm100min,double &pm100max,int &count)
-{
-  //init values
-  count=0;
-  pm25max=0;
-  pm25min=999;
-  pm100max=0;
-  pm100min=999;
-
-  //loop through the table and find min and max
-  for(int i=0;i<CONCEN_HIST_SIZE;i++)
-  {
-    //only deal with entries that have a timestamp
-    if(concenHistory[i].epoch>0)
-    {
-      count++;
-      if(concenHistory[i].pm25 > pm25max) {
-        pm25max=concenHistory[i].pm25; }
-      if(concenHistory[i].pm25 < pm25min) {
-        pm25min=concenHistory[i].pm25; }        
-
-      if(concenHistory[i].pm100 > pm100max) {
-        pm100max=concenHistory[i].pm100; }
-      if(concenHistory[i].pm100 < pm100min) {
-        pm100min=concenHistory[i].pm100; }  
-    }
-  }
-}
-
-//Calc weight factor
-double PMS5003Handler::calcPMSWeight(double min,double max)
-{
-    double weight = 1.0;
-    if(max>0){
-      weight = 1-((max-min)/max); }
-    if(weight < .5) {
-      weight=.5; }
-    if(weight>1) {
-      weight=1; }
-
-    return weight;
-}
-
-//Weight the history.  We'll make the assumption that the last few rows are all current. 
-void PMS5003Handler::sumWeights(int count,double weight,double &v1P25Sum,double &v2P25Sum,double &v1P100Sum,double &v2P100Sum)
-{
-  v1P25Sum=0;
-  v2P25Sum=0;
-  v1P100Sum=0;
-  v2P100Sum=0;
-
-  //Loop through the history, summing as we go
-  for(int i=0;i<CONCEN_HIST_SIZE;i++)
-  {
-    if(concenHistory[i].epoch>0)
-    {
-      //Calculate "location" in list, with 0 being the newest and 11 being the oldest
-      int location=i-(currentIdx-1);  // -1 is because index points to the current open slot (not the last one filled in)
-      if(location<0) {
-        location=location+CONCEN_HIST_SIZE;
-      }
-
-      v1P25Sum = v1P25Sum + concenHistory[i].pm25*pow(weight,location);
-      v2P25Sum = v2P25Sum + pow(weight,location);
-
-      v1P100Sum = v1P100Sum + concenHistory[i].pm100*pow(weight,location);
-      v2P100Sum = v2P100Sum + pow(weight,location);
-    }
-  }
-}
-
-//Finally, let's find the AQI value
-const char* PMS5003Handler::calcAQI(double nowCast,struct breakPoint* breakPoints,int &AQI)
-{
-  AQI=0;
-  const char* label="n/a";
-
-  for(int i=0;i<6;i++)  //size of the breakpoint list
-  {
-    if(nowCast>=breakPoints[i].conc_lo && nowCast<breakPoints[i].conc_hi)
-    {     
-      double numerator=breakPoints[i].AQI_hi-breakPoints[i].AQI_lo;
-      double denom=breakPoints[i].conc_hi-breakPoints[i].conc_lo;
-      double first=numerator/denom;
-      double neg=nowCast-breakPoints[i].conc_lo;
-      double aqidouble=(first*neg)+breakPoints[i].AQI_lo;
-      AQI = round(aqidouble);   
-      label=breakPoints[i].label;       
-      break;
-    }
-  }
-
-  return label;
-}
-
 int PMS5003Handler::getPM0_3um()
 {
   return pmsSensor.getParticles03um();
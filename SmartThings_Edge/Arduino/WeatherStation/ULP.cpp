@@ -1,4 +1,7 @@
 #include "ULP.h"
+#include "logger.h"
+
+extern Logger logger;
 
 extern const uint8_t ulp_main_bin_start[] asm("_binary_ulp_main_bin_start");
 extern const uint8_t ulp_main_bin_end[]   asm("_binary_ulp_main_bin_end");
@@ -14,6 +17,7 @@ void ULP::setupULP()
 
   ulp_debounce_max_cnt = 5;
   ulp_wind_low_tick_cnt = 0;
+  ulp_wind_gust_bucket = windGustBucketTicks(tickTime);
 
   // suppress boot messages
   esp_deep_sleep_disable_rom_logging(); 
@@ -25,6 +29,37 @@ void ULP::setupULP()
   /* Start the program */
   esp_err_t err_run = ulp_run(&ulp_entry - RTC_SLOW_MEM);
   ESP_ERROR_CHECK(err_run);  
+
+  //Gust buckets in ticks of the real ULP period
+  measureTickTime();
+  ulp_wind_gust_bucket = windGustBucketTicks(tickTime);
+}
+
+//The ULP period is ULPSLEEP plus however long the program takes to run, on an RTC clock that's only good to a few %.
+//  So count the ULP's wind ticks against micros() rather than assume it (wind is read every other wakeup, so a tick is two periods)
+void ULP::measureTickTime()
+{
+  uint32_t startTicks = ulp_wind_ticks_total & UINT16_MAX;
+  unsigned long startMicros = micros();
+  delay(TICKMEASUREMS);
+  uint32_t ticks = ((ulp_wind_ticks_total & UINT16_MAX) - startTicks) & UINT16_MAX;
+  unsigned long elapsedMicros = micros() - startMicros;
+
+  double measured = ticks>0 ? (double)elapsedMicros/(double)ticks : 0;
+  if(measured<ULPTICKNOMINAL/2 || measured>ULPTICKNOMINAL*2)
+  {
+    logger.log(ERROR,"ULP wind tick measured at %f us (%d ticks in %d us), using %f",measured,(int)ticks,(int)elapsedMicros,(double)ULPTICKNOMINAL);
+    tickTime = ULPTICKNOMINAL;
+    return;
+  }
+
+  tickTime = measured;
+  logger.log(INFO,"ULP wind tick measured at %f us (%d ticks in %d us)",tickTime,(int)ticks,(int)elapsedMicros);
+}
+
+double ULP::getTickTime()
+{
+  return tickTime;
 }
 
 void ULP::setupWindPin()
@@ -124,10 +159,37 @@ uint32_t ULP::getULPWindPulseCount()
 uint32_t ULP::getULPShortestWindPulseTime() 
 {
   /* ULP program saves shortes pulse */
-  uint32_t pulse_time_min = ((ulp_wind_low_tick_cnt & UINT16_MAX) * ULPSLEEP) * GUSTFACTOR;
+  uint32_t pulse_time_min = (ulp_wind_low_tick_cnt & UINT16_MAX) * tickTime;
   
   /* Reset shortest edge */
   ulp_wind_low_tick_cnt = 0;
   
   return pulse_time_min;
 }
+
+uint32_t ULP::getULPMaxGustPulses() 
+{
+  /* ULP program saves the most pulses seen in a single gust window */
+  uint32_t gust_pulses = ulp_wind_gust_max & UINT16_MAX;
+
+  /* Reset so the next cycle starts fresh */
+  ulp_wind_gust_max = 0;
+
+  return gust_pulses;
+}
+
+void ULP::getULPWindHistogram(uint32_t *bins) 
+{
+  /* Copy out each bin and reset it */
+  for(int i=0;i<WIND_HIST_BINS;i++)
+  {
+    bins[i] = (&ulp_wind_hist)[i] & UINT16_MAX;
+    (&ulp_wind_hist)[i] = 0;
+  }
+}
+
+void ULP::setULPWindHistogramEdges(const uint32_t *edgeTicks) 
+{
+  for(int i=0;i<WIND_HIST_BINS-1;i++)
+    (&ulp_wind_hist_edges)[i] = edgeTicks[i];
+}
@@ -8,6 +8,7 @@
 #include "esp32/ulp.h"
 
 #include "ulp_main.h"
+#include "WindHistogram.h"
 
 #define PIN_WIND          GPIO_NUM_14
 #define PIN_RAIN          GPIO_NUM_26
@@ -15,15 +16,20 @@
 #define PIN_BOOST         GPIO_NUM_12       // Pwr booster (-->5v) from caps to air sensor and ESP
 
 #define ULPSLEEP          40 //400          // amount in microseconds the ULP co-processor sleeps
-#define GUSTFACTOR        2.3               // factor found by experimentation to extrpolate gust speed based on the duration of one pulse
+#define ULPTICKNOMINAL    (ULPSLEEP*2.3)    // microseconds per wind tick before it's measured (2.3 was found by experimentation), and if measuring fails
+#define TICKMEASUREMS     1000              // how long setupULP() times the wind tick against micros() - must stay under 65535 ticks
 
 class ULP {
 
   public:
     void setupULP();
+    double getTickTime();                                //measured microseconds per wind tick
     uint32_t getULPRainPulseCount();
     uint32_t getULPWindPulseCount();
     uint32_t getULPShortestWindPulseTime();
+    uint32_t getULPMaxGustPulses();
+    void getULPWindHistogram(uint32_t *bins);            //WIND_HIST_BINS counts, cleared after reading
+    void setULPWindHistogramEdges(const uint32_t *edgeTicks);  //WIND_HIST_BINS-1 ascending tick thresholds
 
     void setupWindPin();
     void setupRainPin();
@@ -33,7 +39,10 @@ class ULP {
     void setBoostPinHigh(bool);
    
   private: 
+    void measureTickTime();
     void setupPin(gpio_num_t, bool, bool);  //GPIO Pin #, input true/false, pull up (if false, it's output, likewise it's pulldown)  
+
+    double tickTime=ULPTICKNOMINAL;
 };
 
 #endif
@@ -12,6 +12,7 @@
 #define SWITCHTOTOCAP         5.2                   // Capacitor voltage that ESP will switch to capacitor power (turn on boost)
 #define PMSMINVOLTAGE         2.1                   // Won't try and get a reading if capacitors (pre boost circuit) are below this voltage
 #define POWERSAVERVOLTAGE     3.55                  // VCC voltage that ESP will go into power saving mode on  (long deep sleeps)
+#define SENSOR_SETTLE_MS      200                   // ms from BME init and MUX power up to the first read (ADC_SETTLE_SWEEP's "cold" times have to fit in this)
 
 //globals in ULP which survive deep sleep
 extern RTC_DATA_ATTR ULP ulp;  //low power processor
@@ -19,6 +19,7 @@ Preferences preferences;
 WeatherWifi weatherWifi;
 unsigned long millisAtEpoch = 0;
 bool wifiOnly = false;        //true so esp never sleeps.  Mostly used for OTA   
+unsigned long sensorReadTime = 0;   //ms it took to read the BME and ADC sensors this cycle
 
 //globals in ULP which survive deep sleep
 RTC_DATA_ATTR bool firstBoot = true;
@@ -97,6 +98,10 @@ void postAdmin()
   doc["firmware_version"] = SKETCH_VERSION;
   doc["heap_frag"] = round2((1.0-((double)ESP.getMinFreeHeap()/(double)ESP.getFreeHeap()))*100);
   doc["pms_read_time"] = pmsHandler.getLastReadTime();
+  doc["sensor_read_time"] = sensorReadTime;
+#ifdef ADC_SETTLE_SWEEP
+  doc["adc_settle"] = adcHandler.getSettleSweep();
+#endif
   doc["power_saver_mode"] = powerSaverMode;   
   doc["wifi_only"] = wifiOnly;
   doc["boost_mode"] = boostMode;
@@ -123,6 +128,7 @@ void postWind()
   doc["wind_direction"] = windRainHandler.getDirectionInDeg();
   doc["wind_direction_label"] = windRainHandler.getDirectionLabel();
   doc["wind_gust"] = windRainHandler.getWindGustSpeed();
+  doc["wind_variance"] = windRainHandler.getWindSpeedVariance();
   doc["current_time"] = currentTime(); //send back the last epoch sent in + elapsed time since
 
   //send wind data back
@@ -302,6 +308,7 @@ void initialSetup()
      
     logger.log(WARNING,"First Boot.  Now setting up ULP so we can count pulses and hold pins while in deep sleep...");
     ulp.setupULP();
+    windRainHandler.setupHistogram();
     ulp.setupWindPin();
     ulp.setupRainPin();
     ulp.setupAirPin();
@@ -431,12 +438,25 @@ void postSensorData()
 void readSensors()
 { 
   logger.log(VERBOSE,"Reading BME and ADC sensors");  
-  bmeHandler.init();
+  unsigned long startTime=millis();
+
+  //power everything up, and give it the same 200ms it's always had before the first read (the BME's first conversion,
+  //  the sensors behind the MUX).  Then the MUX inputs are read as they settle
   adcHandler.init();
-  delay(200);
-  
+  adcHandler.startSamples();
+  bmeHandler.init();
+  while(millis()-startTime < SENSOR_SETTLE_MS)
+    delay(1);
   bmeHandler.storeSamples();
-  adcHandler.storeSamples();
+  while(!adcHandler.serviceSamples())
+    delay(1);
+
+  sensorReadTime=millis()-startTime;
+  logger.log(VERBOSE,"Sensors read in %d ms",(int)sensorReadTime);
+
+#ifdef ADC_SETTLE_SWEEP
+  adcHandler.settleSweep();
+#endif
 }
 
 void readAirSensor()
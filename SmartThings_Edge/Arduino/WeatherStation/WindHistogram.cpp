@@ -0,0 +1,62 @@
+#include "WindHistogram.h"
+
+//Upper speed (mph) of each wind histogram bin, fastest first.  The last bin is everything under the last entry
+static const double windHistSpeeds[WIND_HIST_BINS-1] = {60,45,35,28,22,18,15,12,10,8,6,5,4,3,2};
+
+//Turn the bin speeds into pulse lengths in ULP ticks so the ULP can bin without doing any math
+void windHistEdgeTicks(double tickTime,uint32_t *edgeTicks)
+{
+  for(int i=0;i<WIND_HIST_BINS-1;i++)
+  {
+    double pulsesPerSec = (windHistSpeeds[i] / WINDFACTOR) * WIND_PULSES_REV;
+    edgeTicks[i] = (uint32_t)((TIMEFACTOR / pulsesPerSec) / tickTime);
+  }
+}
+
+uint32_t windGustBucketTicks(double tickTime)
+{
+  return (uint32_t)((GUSTWINDOW*(double)TIMEFACTOR)/(WIND_GUST_BUCKETS*tickTime));
+}
+
+double windBinSpeed(int bin)
+{
+  if(bin==0)
+    return windHistSpeeds[0];
+  if(bin>=WIND_HIST_BINS-1)
+    return windHistSpeeds[WIND_HIST_BINS-2]/2.0;
+
+  return (windHistSpeeds[bin-1]+windHistSpeeds[bin])/2.0;
+}
+
+//Each pulse covers the same distance, so weight every bin by the time it took (count/speed) to get a time averaged variance
+bool windHistVariance(const uint32_t *bins,double &variance)
+{
+  double totalPulses=0;
+  double totalTime=0;
+  double totalSpeed=0;
+  for(int i=0;i<WIND_HIST_BINS;i++)
+  {
+    double speed=windBinSpeed(i);
+    totalPulses=totalPulses+bins[i];
+    totalTime=totalTime+(bins[i]/speed);
+    totalSpeed=totalSpeed+(bins[i]*speed);
+  }
+
+  if(totalPulses==0)
+  {
+    variance=0;
+    return false;
+  }
+
+  double mean=totalPulses/totalTime;
+  variance=(totalSpeed/totalTime)-(mean*mean);
+  if(variance<0)
+    variance=0;
+
+  return true;
+}
+
+double windGustSpeed(uint32_t gustPulses)
+{
+  return (((double)gustPulses / (double)GUSTWINDOW) / WIND_PULSES_REV) * WINDFACTOR;
+}
@@ -0,0 +1,31 @@
+#ifndef windhistogram_h
+#define windhistogram_h
+
+#include <stdint.h>
+
+//Wind pulse math shared by the ESP side of the ULP wind histogram and gust window
+//Plain C++ so test/UlpWindModel.cpp can run it against its model of ulp_pulses.s
+
+#define TIMEFACTOR        1000000UL   // factor between seconds and microseconds
+#define WINDFACTOR        3.914639    // 1.75 m/s per revolution, 3.9mph, or 20 pulses
+#define WIND_PULSES_REV   20          // pulses per revolution
+#define GUSTWINDOW        3           // seconds the ULP counts wind pulses over for a gust (WMO uses a 3 second average)
+#define WIND_HIST_BINS    16          // number of wind pulse interval bins - must match ulp_pulses.s
+#define WIND_GUST_BUCKETS 12          // buckets the ULP splits a gust window into, so the window slides a quarter second at a time - must match ulp_pulses.s
+
+//Pulse lengths in ULP ticks (tickTime us each) between the bins, ascending, WIND_HIST_BINS-1 of them
+void windHistEdgeTicks(double tickTime,uint32_t *edgeTicks);
+
+//Length of a gust bucket in ULP ticks
+uint32_t windGustBucketTicks(double tickTime);
+
+//Speed (mph) in the middle of a histogram bin
+double windBinSpeed(int bin);
+
+//Time weighted variance of the histogram, false if it's empty
+bool windHistVariance(const uint32_t *bins,double &variance);
+
+//Speed (mph) from the pulses in one gust window
+double windGustSpeed(uint32_t gustPulses);
+
+#endif
@@ -11,21 +11,41 @@ double WindRain::getWindSpeed(long timeSinceLastReading)
   return wind;
 }
 
+//Gust is the busiest GUSTWINDOW seconds the ULP saw since the last reading, wherever they started (WMO style)
 double WindRain::getWindGustSpeed()
 {
+  uint32_t gustPulses = ulp.getULPMaxGustPulses();
   uint32_t shortestWindPulseTime = ulp.getULPShortestWindPulseTime();
-  if(shortestWindPulseTime==0)
-    return 0;
 
   //figure gust
-  double revPerSec = ((TIMEFACTOR/shortestWindPulseTime)/20.0) * GUSTFACTOR;  
-  double windGust = revPerSec * WINDFACTOR; 
+  double windGust = windGustSpeed(gustPulses);
 
-  logger.log(VERBOSE,"Shortest wind pulse Time (ms): %d, calc'd speed: %f",(int)shortestWindPulseTime,windGust);
+  logger.log(VERBOSE,"Gust window pulses: %d, shortest wind pulse time (us): %d, calc'd speed: %f",(int)gustPulses,(int)shortestWindPulseTime,windGust);
 
   return windGust;
 }
 
+//Bin edges in ticks of the ULP period measured in setupULP() (WindHistogram.cpp)
+void WindRain::setupHistogram()
+{
+  uint32_t edgeTicks[WIND_HIST_BINS-1];
+  windHistEdgeTicks(ulp.getTickTime(),edgeTicks);
+
+  ulp.setULPWindHistogramEdges(edgeTicks);
+  logger.log(VERBOSE,"Wind histogram edges (ticks) from %d to %d",(int)edgeTicks[0],(int)edgeTicks[WIND_HIST_BINS-2]);
+}
+
+void WindRain::getWindHistogram(uint32_t *bins)
+{
+  ulp.getULPWindHistogram(bins);
+}
+
+void WindRain::getWindVariance(const uint32_t *bins, double &variance)
+{
+  if(windHistVariance(bins,variance))
+    logger.log(VERBOSE,"Wind histogram variance: %f",variance);
+}
+
 //We usually doing last 12, last hour, etc on the hub.  But we're doing it at the ESP because pulses from the tipping bucket are few, so aggregating over time is more accurate.
 void WindRain::getRainRate(double &current, double &lastHour, double &last12)
 {
@@ -2,6 +2,8 @@
 #include "logger.h"
 #include "debug.h"
 #include "WeatherStation.h"
+#include "ULP.h"
+#include "WindHistogram.h"
 
 extern Logger logger;
 extern unsigned long currentTime();
@@ -10,9 +12,6 @@ extern String getTimeString();
 #ifndef WINDRAIN_H
 #define WINDRAIN_H
 
-#define TIMEFACTOR        1000000UL   // factor between seconds and microseconds
-#define WINDFACTOR        3.914639    // 1.75 m/s per revolution, 3.9mph, or 20 pulses
-#define GUSTFACTOR        .225        // We're measuring a single pulse, so this is the "fudge factor" to get to revolutions per second
 #define RAINFACTOR        0.0102      // 0.0204      // bucket size
 
 class WindRain 
@@ -21,6 +20,9 @@ class WindRain
   public:
     double getWindSpeed(long);
     double getWindGustSpeed();
+    void setupHistogram();
+    void getWindHistogram(uint32_t *bins);
+    void getWindVariance(const uint32_t *bins, double &variance);
     void getRainRate(double &current, double &lastHour, double &last12);
     
   private: 
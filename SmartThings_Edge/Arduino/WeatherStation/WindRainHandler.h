@@ -19,9 +19,11 @@ class WindRainHandler
 {
 
   public:
+    void setupHistogram();
     void storeSamples();
     double getWindSpeed();
     double getWindGustSpeed();
+    double getWindSpeedVariance();
     double getCurrentRainRate();
     double getLastHourRainRate();
     double getLast12RainRate();
@@ -47,6 +49,9 @@ class WindRainHandler
     //used to calc avg speed
     double totalSpeed;
     int speedSamples;
+
+    //pulse interval histogram from the ULP, summed across wakeups until it's read
+    uint32_t windHist[WIND_HIST_BINS];
 };
 
 #endif
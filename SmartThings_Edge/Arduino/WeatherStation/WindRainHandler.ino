@@ -2,6 +2,12 @@
 
 #include "WindRainHandler.h"
 
+//Called once the ULP is loaded so it knows how to bin wind pulses
+void WindRainHandler::setupHistogram()
+{
+  windRain.setupHistogram();
+}
+
 void WindRainHandler::storeSamples()
 {
   //Find out how long it's been since the last reading so we can calc speed correctly 
@@ -13,6 +19,12 @@ void WindRainHandler::storeSamples()
   rawDirectioninDegrees=calcWindDirection();
   windGustSpeed=windRain.getWindGustSpeed();
 
+  //Add the ULP's histogram to what we've got so far
+  uint32_t bins[WIND_HIST_BINS];
+  windRain.getWindHistogram(bins);
+  for(int i=0;i<WIND_HIST_BINS;i++)
+    windHist[i]=windHist[i]+bins[i];
+
   //Store rain values
   windRain.getRainRate(currentRainRate,lastHourRainRate,last12RainRate);
 
@@ -22,7 +34,8 @@ void WindRainHandler::storeSamples()
 
   logger.log(VERBOSE,"Samples - Wind Speed: (raw/avg) %f/%f, Gust Speed: (current/old max) %f/%f, Direction: %d",windSpeed,totalSpeed/(double)speedSamples,windGustSpeed,maxGust,rawDirectioninDegrees);
 
-  //max gust (but makes sure it's within bounds and we can trust the reading)
+  //max gust (but makes sure it's within bounds and we can trust the reading).  A gust window of pulses rides out a single
+  //  glitchy pulse, but not a bouncing reed switch or noise on the line for a few seconds
   if(windSpeed<LOWWIND && windGustSpeed>(windSpeed*GUSTLIMIT))
   {
     logger.log(INFO,"Gust is unreliable because there's no wind: %f/%f",windGustSpeed,windSpeed*GUSTLIMIT);
@@ -77,7 +90,7 @@ double WindRainHandler::getWindSpeed()
 {
   double avgWindSpeed=totalSpeed;
   if(speedSamples > 1) 
-    totalSpeed/(double)speedSamples;
+    avgWindSpeed=totalSpeed/(double)speedSamples;
 
   totalSpeed=0;
   speedSamples=0;
@@ -93,6 +106,19 @@ double WindRainHandler::getWindGustSpeed()
   return round2(windGustSpeed);
 }
 
+//Time weighted variance from the pulse histogram since the last read
+double WindRainHandler::getWindSpeedVariance()
+{
+  double variance;
+  windRain.getWindVariance(windHist,variance);
+
+  //reset since we're reading
+  for(int i=0;i<WIND_HIST_BINS;i++)
+    windHist[i]=0;
+
+  return round2(variance);
+}
+
 double WindRainHandler::getCurrentRainRate()
 {
   return round2(currentRainRate);
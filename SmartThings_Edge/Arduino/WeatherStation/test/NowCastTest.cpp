@@ -0,0 +1,236 @@
+//
+// Host check of the PMS NowCast/AQI in NowCast.cpp against the code it
+// replaced.
+//
+// Readings are stored into the 12 entry history the way
+// PMS5003Handler::storeSamples() does, and after each one the NowCast and
+// AQI are worked out three ways:
+//  - new:   calcNowCasts() (two passes, Horner's rule)
+//  - fixed: the old calcPM25AQI()/calcPM100AQI() with pow(), location being
+//           the entry's age (0 the newest, 11 the oldest) as its comment says
+//  - old:   the old code as it was
+// new must match fixed to rounding on every reading, AQI and label exactly.
+//
+// new and old don't match.  The old location, i-(currentIdx-1) wrapped,
+// gives the newest entry 0 but the one before it 11 and the oldest 1, so
+// it weighted the history oldest first.  They agree when the window is one
+// reading or flat and differ by no more than the window's range otherwise
+// (both are weighted means of it).  How far apart they get on each history
+// is printed.
+//
+// There are no recorded PMS histories in the repo, so the histories are
+// made up: clean air, a daily cycle, smoke coming and going, single spikes,
+// a sensor reading 0, and a fresh boot filling the history.
+//
+// Build and run (from WeatherStation/):
+//   g++ -std=c++11 -O2 -Wall -o NowCastTest test/NowCastTest.cpp NowCast.cpp
+//   ./NowCastTest
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../NowCast.h"
+
+struct History
+{
+  struct concenReading entries[CONCEN_HIST_SIZE];
+  int currentIdx;
+
+  void clear()
+  {
+    memset(entries,0,sizeof(entries));
+    currentIdx=0;
+  }
+
+  //storeSamples()
+  void store(unsigned long epoch,int pm25,int pm100)
+  {
+    entries[currentIdx]={epoch,pm25,pm100};
+    currentIdx++;
+    if(currentIdx>=CONCEN_HIST_SIZE)
+      currentIdx=0;
+  }
+};
+
+//The old calcPMSMinMax()/sumWeights(); fixLocation uses the entry's age
+static void oldNowCasts(const History &h,bool fixLocation,double &pm25NowCast,double &pm100NowCast)
+{
+  double pm25max=0,pm25min=999,pm100max=0,pm100min=999;
+  for(int i=0;i<CONCEN_HIST_SIZE;i++)
+  {
+    if(h.entries[i].epoch>0)
+    {
+      if(h.entries[i].pm25 > pm25max) pm25max=h.entries[i].pm25;
+      if(h.entries[i].pm25 < pm25min) pm25min=h.entries[i].pm25;
+      if(h.entries[i].pm100 > pm100max) pm100max=h.entries[i].pm100;
+      if(h.entries[i].pm100 < pm100min) pm100min=h.entries[i].pm100;
+    }
+  }
+
+  double weights[2]={calcPMSWeight(pm25min,pm25max),calcPMSWeight(pm100min,pm100max)};
+  double nowCasts[2];
+  for(int w=0;w<2;w++)
+  {
+    double v1=0,v2=0;
+    for(int i=0;i<CONCEN_HIST_SIZE;i++)
+    {
+      if(h.entries[i].epoch>0)
+      {
+        int location;
+        if(fixLocation)
+          location=(h.currentIdx-1-i+CONCEN_HIST_SIZE)%CONCEN_HIST_SIZE;
+        else
+        {
+          location=i-(h.currentIdx-1);
+          if(location<0)
+            location=location+CONCEN_HIST_SIZE;
+        }
+        double c=w==0 ? h.entries[i].pm25 : h.entries[i].pm100;
+        v1=v1+c*pow(weights[w],location);
+        v2=v2+pow(weights[w],location);
+      }
+    }
+    nowCasts[w]=v1/v2;
+  }
+  pm25NowCast=nowCasts[0];
+  pm100NowCast=nowCasts[1];
+}
+
+static void windowRange(const History &h,int which,double &lo,double &hi,int &count)
+{
+  lo=1e9;
+  hi=-1e9;
+  count=0;
+  for(int i=0;i<CONCEN_HIST_SIZE;i++)
+  {
+    if(h.entries[i].epoch==0)
+      continue;
+    double c=which==0 ? h.entries[i].pm25 : h.entries[i].pm100;
+    if(c<lo) lo=c;
+    if(c>hi) hi=c;
+    count++;
+  }
+}
+
+//1 if it failed, so main() can add them up
+static int check(bool ok,const char *what)
+{
+  printf("%s %s\n",ok ? "ok  " : "FAIL",what);
+  return ok ? 0 : 1;
+}
+
+//
+// Made up hourly readings (pm25, pm100 follows at about 1.6x)
+//
+static double base(int kind,int hour)
+{
+  switch(kind)
+  {
+    case 0: return 4;                                               //clean, flat
+    case 1: return 9+6*sin(2*M_PI*hour/24.0);                       //daily cycle
+    case 2: return hour<20 ? 8 : hour<32 ? 8+(hour-20)*22 : 8+12*22-(hour-32)*18;   //smoke in, then out
+    case 3: return (hour%17==9) ? 140 : 6;                          //single spikes (a neighbour's fire pit)
+    case 4: return (hour%13==5) ? 0 : 11;                           //sensor reading 0 now and then
+    default: return 18+(hour*7919%23);                              //noisy
+  }
+}
+
+static const char *kinds[]={"clean","daily cycle","smoke event","spikes","sensor zeros","noisy"};
+
+int main()
+{
+  int failures=0;
+  char what[160];
+  History h;
+  const int hours=72;
+
+  for(int kind=0;kind<6;kind++)
+  {
+    h.clear();
+    bool matchesFixed=true;
+    bool agreesFlat=true;
+    bool withinRange=true;
+    double worstNowCast=0;
+    int worstAQI=0;
+    int differingAQI=0;
+    int readings=0;
+
+    for(int hour=0;hour<hours;hour++)
+    {
+      int pm25=(int)lround(base(kind,hour));
+      if(pm25<0) pm25=0;
+      h.store(1700000000UL+hour*3600UL,pm25,(int)lround(pm25*1.6));
+      readings++;
+
+      double nc[2],fixedNc[2],oldNc[2];
+      calcNowCasts(h.entries,h.currentIdx,nc[0],nc[1]);
+      oldNowCasts(h,true,fixedNc[0],fixedNc[1]);
+      oldNowCasts(h,false,oldNc[0],oldNc[1]);
+
+      bool aqiDiffers=false;
+      for(int w=0;w<2;w++)
+      {
+        const struct breakPoint *bp=w==0 ? pm25BreakPoints : pm100BreakPoints;
+        int aqi,fixedAqi,oldAqi;
+        const char *label=calcAQI(nc[w],bp,aqi);
+        const char *fixedLabel=calcAQI(fixedNc[w],bp,fixedAqi);
+        calcAQI(oldNc[w],bp,oldAqi);
+
+        if(fabs(nc[w]-fixedNc[w])>1e-9*(1+fabs(fixedNc[w])) || aqi!=fixedAqi || strcmp(label,fixedLabel)!=0)
+          matchesFixed=false;
+
+        double lo,hi;
+        int count;
+        windowRange(h,w,lo,hi,count);
+        double diff=nc[w]-oldNc[w];
+        if((count==1 || lo==hi) && fabs(diff)>1e-9*(1+hi))
+          agreesFlat=false;
+        if(fabs(diff)>hi-lo+1e-9)
+          withinRange=false;
+
+        if(fabs(diff)>worstNowCast) worstNowCast=fabs(diff);
+        if(abs(aqi-oldAqi)>worstAQI) worstAQI=abs(aqi-oldAqi);
+        if(aqi!=oldAqi) aqiDiffers=true;
+      }
+      if(aqiDiffers)
+        differingAQI++;
+    }
+
+    printf("%s: %d readings, against old: NowCast up to %.2f ug/m3 apart, AQI up to %d apart, on %d readings\n",
+           kinds[kind],readings,worstNowCast,worstAQI,differingAQI);
+    snprintf(what,sizeof(what),"%s: matches the old code with the location fixed",kinds[kind]);
+    failures+=check(matchesFixed,what);
+    snprintf(what,sizeof(what),"%s: matches the old code on one reading or a flat window",kinds[kind]);
+    failures+=check(agreesFlat,what);
+    snprintf(what,sizeof(what),"%s: no further from the old code than the window's range",kinds[kind]);
+    failures+=check(withinRange,what);
+  }
+
+  //Every position of the open slot, with a history that isn't full yet
+  {
+    bool ok=true;
+    for(int filled=1;filled<=CONCEN_HIST_SIZE;filled++)
+    {
+      for(int start=0;start<CONCEN_HIST_SIZE;start++)
+      {
+        h.clear();
+        h.currentIdx=start;
+        for(int n=0;n<filled;n++)
+          h.store(1700000000UL+n*3600UL,5+n*3,9+n*5);
+        double nc[2],fixedNc[2];
+        calcNowCasts(h.entries,h.currentIdx,nc[0],nc[1]);
+        oldNowCasts(h,true,fixedNc[0],fixedNc[1]);
+        for(int w=0;w<2;w++)
+          if(fabs(nc[w]-fixedNc[w])>1e-9*(1+fabs(fixedNc[w])))
+            ok=false;
+      }
+    }
+    failures+=check(ok,"partly filled history, open slot anywhere: matches the old code with the location fixed");
+  }
+
+  printf("%s\n",failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,342 @@
+//
+// Host model of the wind half of ulp_pulses.s, run against made up
+// anemometer pulse trains.
+//
+// UlpWind::wake() is one ULP wakeup, block for block with the assembly and
+// its 16 bit registers: the io toggle (wind is read every other wakeup), the
+// tick counters, the gust bucket ring, debounce, and on the pin going back
+// high the gust pulse count, the histogram bin and the shortest interval.
+// The ESP side is WindHistogram.cpp as the sketch uses it: bin edges and
+// the gust bucket length from the tick time, measured the way
+// ULP::measureTickTime() does it.
+//
+// The anemometer is 20 reed closures a revolution, WINDFACTOR mph a
+// revolution a second, closed for half of each pulse.  Checked:
+//  - the measured tick time is two ULP periods
+//  - steady wind: one histogram bin takes the pulses and its speed is the
+//    wind's, the gust is the wind speed to within 2 pulses
+//  - a 6 second gust is seen in full, and so is a gust just over 3 seconds
+//    that a fixed 3 second window would have split in two; a 2 second one
+//    reads as its 3 second average
+//  - calm: the interval count stops at 65535 rather than wrapping and the
+//    first pulse after lands in the slowest bin
+//  - contact bounce shorter than the debounce isn't counted
+//  - a ULP running 20% slower than ULPTICKNOMINAL: the gust is right with
+//    the measured tick time and wrong by about that much without it
+//
+// Build and run (from WeatherStation/):
+//   g++ -std=c++11 -O2 -Wall -o UlpWindModel test/UlpWindModel.cpp WindHistogram.cpp
+//   ./UlpWindModel
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../WindHistogram.h"
+
+#define ULPSLEEP        40              // ULP.h
+#define ULPTICKNOMINAL  (ULPSLEEP*2.3)  // ULP.h
+#define DEBOUNCE        5               // ulp_debounce_max_cnt, ULP::setupULP()
+#define TICKMEASUREMS   1000            // ULP.h
+
+struct UlpWind
+{
+  //.bss, 16 bits of each word are used
+  uint16_t io_toggle;
+  uint16_t wind_next_edge;
+  uint16_t wind_debounce_cntr;
+  uint16_t wind_edge_cnt;
+  uint16_t wind_tick_cnt;
+  uint16_t wind_ticks_total;
+  uint16_t wind_low_tick_cnt;
+  uint16_t wind_gust_ticks;
+  uint16_t wind_gust_pulses;
+  uint16_t wind_gust_ring[WIND_GUST_BUCKETS];
+  uint16_t wind_gust_idx;
+  uint16_t wind_gust_sum;
+  uint16_t wind_gust_max;
+  uint16_t wind_gust_bucket;
+  uint16_t wind_hist[WIND_HIST_BINS];
+  uint16_t wind_hist_edges[WIND_HIST_BINS-1];
+  uint16_t debounce_max_cnt;
+
+  void reset()
+  {
+    memset(this,0,sizeof(*this));
+    debounce_max_cnt=DEBOUNCE;
+  }
+
+  void wake(int pin)
+  {
+    //entry: check whatever pin we didn't last time
+    io_toggle=(io_toggle+1)&1;
+    if(io_toggle!=0)
+      return;                                         //read_rain_now
+
+    //read_wind_now
+    wind_ticks_total++;
+    if(wind_tick_cnt!=0xFFFF)                         //jump wind_tick_full, ov
+      wind_tick_cnt++;
+
+    wind_gust_ticks++;
+    if(!(wind_gust_ticks<wind_gust_bucket))           //sub r1, r2, r1 / jump read_wind_pin, ov
+    {
+      wind_gust_ticks=0;
+      wind_gust_sum=wind_gust_sum-wind_gust_ring[wind_gust_idx]+wind_gust_pulses;
+      wind_gust_ring[wind_gust_idx]=wind_gust_pulses;
+      wind_gust_pulses=0;
+      wind_gust_idx++;
+      if(!(wind_gust_idx<WIND_GUST_BUCKETS))          //gust_idx_done
+        wind_gust_idx=0;
+      if(wind_gust_max<wind_gust_sum)                 //gust_window_max
+        wind_gust_max=wind_gust_sum;
+    }
+
+    //read_wind_done
+    if(((pin+wind_next_edge)&1)!=0)
+    {
+      wind_debounce_cntr=debounce_max_cnt;            //not changed
+      return;
+    }
+
+    //wind_changed
+    if(wind_debounce_cntr!=0)
+    {
+      wind_debounce_cntr--;
+      return;
+    }
+
+    //wind_edge_detected
+    wind_debounce_cntr=debounce_max_cnt;
+    wind_next_edge=(wind_next_edge+1)&1;
+    wind_edge_cnt++;
+    if(pin!=1)
+      return;
+
+    //leading_detected
+    wind_gust_pulses++;
+    int bin=0;
+    while(bin<WIND_HIST_BINS-1 && !(wind_tick_cnt<wind_hist_edges[bin]))    //hist_find_bin
+      bin++;
+    if(wind_hist[bin]!=0xFFFF)                        //hist_bin_full
+      wind_hist[bin]++;
+
+    if(wind_tick_cnt<wind_low_tick_cnt || wind_low_tick_cnt==0)            //pulse_lower
+      wind_low_tick_cnt=wind_tick_cnt;
+    wind_tick_cnt=0;                                  //pulse_reset
+  }
+};
+
+//
+// Anemometer and time
+//
+struct Sim
+{
+  UlpWind ulp;
+  double periodUs;          // real ULP wakeup period, ULPSLEEP plus run time
+  double t;                 // us
+  double phase;             // pulses
+  int bounces;              // times the switch opens again for 300us right after it closes
+
+  void reset(double period)
+  {
+    ulp.reset();
+    periodUs=period;
+    t=0;
+    phase=0;
+    bounces=0;
+  }
+
+  //mph(t) for seconds, one wakeup at a time
+  template<typename Wind> void run(double seconds,Wind wind)
+  {
+    double end=t+seconds*TIMEFACTOR;
+    while(t<end)
+    {
+      double pulsesPerSec=(wind(t/TIMEFACTOR)/WINDFACTOR)*WIND_PULSES_REV;
+      phase=phase+pulsesPerSec*periodUs/TIMEFACTOR;
+      double frac=phase-floor(phase);
+      int pin=frac<0.5 ? 0 : 1;                       //pulled up, closed pulls it low
+
+      if(bounces>0 && pin==0 && pulsesPerSec>0)
+      {
+        double closedUs=frac*TIMEFACTOR/pulsesPerSec;
+        for(int b=0;b<bounces;b++)
+          if(closedUs>600.0*b+100 && closedUs<600.0*b+400)
+            pin=1;
+      }
+
+      ulp.wake(pin);
+      t=t+periodUs;
+    }
+  }
+
+  //ULP::measureTickTime()
+  double measureTickTime()
+  {
+    uint16_t start=ulp.wind_ticks_total;
+    run(TICKMEASUREMS/1000.0,[](double){ return 0.0; });
+    uint16_t ticks=(uint16_t)(ulp.wind_ticks_total-start);
+    return (TICKMEASUREMS*1000.0)/ticks;
+  }
+
+  //ULP::setupULP() and WindRain::setupHistogram()
+  void setup(double tickTime)
+  {
+    ulp.wind_gust_bucket=windGustBucketTicks(tickTime);
+    uint32_t edges[WIND_HIST_BINS-1];
+    windHistEdgeTicks(tickTime,edges);
+    for(int i=0;i<WIND_HIST_BINS-1;i++)
+      ulp.wind_hist_edges[i]=edges[i];
+  }
+
+  //WindRain::getWindGustSpeed(), read and clear
+  double gust()
+  {
+    double mph=windGustSpeed(ulp.wind_gust_max);
+    ulp.wind_gust_max=0;
+    return mph;
+  }
+
+  uint32_t pulses()
+  {
+    uint32_t count=0;
+    for(int i=0;i<WIND_HIST_BINS;i++)
+    {
+      count=count+ulp.wind_hist[i];
+      ulp.wind_hist[i]=0;
+    }
+    return count;
+  }
+};
+
+//1 if it failed, so main() can add them up
+static int check(bool ok,const char *what)
+{
+  printf("%s %s\n",ok ? "ok  " : "FAIL",what);
+  return ok ? 0 : 1;
+}
+
+static const double nominalPeriod=ULPTICKNOMINAL/2;       //what ULPTICKNOMINAL assumes
+
+int main()
+{
+  int failures=0;
+  char what[160];
+  Sim sim;
+  double onePulse=windGustSpeed(1);
+
+  //Tick time
+  sim.reset(nominalPeriod);
+  double tickTime=sim.measureTickTime();
+  snprintf(what,sizeof(what),"tick time measured at %.2fus for a %.1fus ULP period",tickTime,nominalPeriod);
+  failures+=check(fabs(tickTime-2*nominalPeriod)<0.01*nominalPeriod,what);
+
+  //Steady wind
+  const double speeds[]={2.5,7,13,20,31,50};
+  for(double speed : speeds)
+  {
+    sim.reset(nominalPeriod);
+    sim.setup(sim.measureTickTime());
+    sim.run(2,[speed](double){ return speed; });          //settle, then start clean
+    sim.gust();
+    sim.pulses();
+    sim.run(30,[speed](double){ return speed; });
+
+    uint32_t bins[WIND_HIST_BINS];
+    uint32_t total=0;
+    int top=0;
+    for(int i=0;i<WIND_HIST_BINS;i++)
+    {
+      bins[i]=sim.ulp.wind_hist[i];
+      total=total+bins[i];
+      if(bins[i]>bins[top])
+        top=i;
+    }
+    double variance;
+    windHistVariance(bins,variance);
+    sim.pulses();
+    double gust=sim.gust();
+
+    snprintf(what,sizeof(what),"%.1f mph steady: %u of %u pulses in bin %d (%.1f mph), variance %.2f",
+             speed,bins[top],total,top,windBinSpeed(top),variance);
+    failures+=check(bins[top]>=total*0.99 && fabs(windBinSpeed(top)-speed)<=0.1*speed,what);
+    snprintf(what,sizeof(what),"%.1f mph steady: gust %.2f mph",speed,gust);
+    failures+=check(fabs(gust-speed)<=2*onePulse,what);
+  }
+
+  //Gusts over 10 mph
+  {
+    sim.reset(nominalPeriod);
+    sim.setup(sim.measureTickTime());
+    sim.run(20,[](double t){ return t>10 && t<16 ? 30.0 : 10.0; });
+    double gust=sim.gust();
+    snprintf(what,sizeof(what),"6s gust to 30 mph: gust %.2f mph",gust);
+    failures+=check(fabs(gust-30)<=2*onePulse,what);
+
+    //Fixed 3s windows from the start would have ended at 33s, half way through it
+    sim.run(20,[](double t){ return t>31.5 && t<34.75 ? 30.0 : 10.0; });
+    gust=sim.gust();
+    snprintf(what,sizeof(what),"3.25s gust to 30 mph across a 3s window edge: gust %.2f mph",gust);
+    failures+=check(fabs(gust-30)<=2*onePulse,what);
+
+    sim.run(20,[](double t){ return t>50 && t<52 ? 30.0 : 10.0; });
+    gust=sim.gust();
+    double average=(30.0*2+10.0*1)/GUSTWINDOW;
+    snprintf(what,sizeof(what),"2s gust to 30 mph: gust %.2f mph, its 3s average %.2f",gust,average);
+    failures+=check(fabs(gust-average)<=2*onePulse,what);
+  }
+
+  //Calm, then a breeze
+  {
+    sim.reset(nominalPeriod);
+    sim.setup(sim.measureTickTime());
+    sim.run(20,[](double){ return 0.0; });
+    failures+=check(sim.ulp.wind_tick_cnt==0xFFFF,"calm: interval count stops at 65535");
+    failures+=check(sim.gust()==0 && sim.pulses()==0,"calm: no gust, no pulses");
+
+    sim.run(0.5,[](double){ return 20.0; });
+    uint32_t slowest=sim.ulp.wind_hist[WIND_HIST_BINS-1];
+    uint32_t total=sim.pulses();
+    snprintf(what,sizeof(what),"first pulse after a calm: slowest bin, the other %u where 20 mph goes",total-slowest);
+    failures+=check(slowest==1 && total>40,what);
+  }
+
+  //Contact bounce
+  {
+    sim.reset(nominalPeriod);
+    sim.setup(sim.measureTickTime());
+    sim.run(10,[](double){ return 15.0; });
+    uint32_t clean=sim.pulses();
+    double cleanGust=sim.gust();
+
+    sim.reset(nominalPeriod);
+    sim.setup(sim.measureTickTime());
+    sim.bounces=3;
+    sim.run(10,[](double){ return 15.0; });
+    uint32_t bounced=sim.pulses();
+    double bouncedGust=sim.gust();
+    snprintf(what,sizeof(what),"bounce: %u pulses against %u clean, gust %.2f against %.2f",bounced,clean,bouncedGust,cleanGust);
+    failures+=check(bounced>=clean-1 && bounced<=clean+1 && fabs(bouncedGust-cleanGust)<=onePulse,what);
+  }
+
+  //A ULP slower than nominal
+  {
+    double slowPeriod=nominalPeriod*1.2;
+    double gusts[2];
+    for(int measured=0;measured<2;measured++)
+    {
+      sim.reset(slowPeriod);
+      double tick=sim.measureTickTime();
+      sim.setup(measured ? tick : ULPTICKNOMINAL);
+      sim.run(20,[](double){ return 20.0; });
+      gusts[measured]=sim.gust();
+    }
+    snprintf(what,sizeof(what),"ULP 20%% slow: gust %.2f mph with the measured tick, %.2f with ULPTICKNOMINAL, for 20 mph",gusts[1],gusts[0]);
+    failures+=check(fabs(gusts[1]-20)<=2*onePulse && fabs(gusts[0]-20)>10*onePulse,what);
+  }
+
+  printf("%s\n",failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
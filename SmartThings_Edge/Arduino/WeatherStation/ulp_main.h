@@ -20,4 +20,14 @@ extern uint32_t ulp_wind_next_edge;
 extern uint32_t ulp_wind_debounce_cntr;
 extern uint32_t ulp_wind_edge_cnt;
 extern uint32_t ulp_wind_tick_cnt;
+extern uint32_t ulp_wind_ticks_total;
 extern uint32_t ulp_wind_low_tick_cnt;
+extern uint32_t ulp_wind_gust_ticks;
+extern uint32_t ulp_wind_gust_pulses;
+extern uint32_t ulp_wind_gust_ring;     //array of WIND_GUST_BUCKETS
+extern uint32_t ulp_wind_gust_idx;
+extern uint32_t ulp_wind_gust_sum;
+extern uint32_t ulp_wind_gust_max;
+extern uint32_t ulp_wind_gust_bucket;
+extern uint32_t ulp_wind_hist;          //array of WIND_HIST_BINS
+extern uint32_t ulp_wind_hist_edges;    //array of WIND_HIST_BINS-1
@@ -17,6 +17,14 @@
    waiting for input signal polarity to change again.
    When the edge counter reaches certain value (set by the main program),
    this program running triggers a wake up from deep sleep.
+
+   For wind, each pulse interval (in ticks) is also binned into a small histogram,
+   and pulses are counted in short gust buckets kept in a ring that spans the gust
+   window (3 seconds).  Every time a bucket fills, the ring's total is the last 3 seconds,
+   so the busiest 3 seconds are kept wherever they start (to a bucket).
+   The main program reads and clears both when it wakes so it can work out a proper
+   gust, mean and variance without having to wake up more often.
+   test/UlpWindModel.cpp is a host model of the wind half of this program, change it along with it.
 */
 
 /* ULP assembly files are passed through C preprocessor first, so include directives
@@ -26,6 +34,12 @@
 #include "soc/rtc_io_reg.h"
 #include "soc/soc_ulp.h"
 
+/* Number of wind pulse interval histogram bins.  Must match WIND_HIST_BINS in WindHistogram.h */
+#define WIND_HIST_BINS 16
+
+/* Number of gust buckets in the gust window.  Must match WIND_GUST_BUCKETS in WindHistogram.h */
+#define WIND_GUST_BUCKETS 12
+
   /* Define variables, which go into .bss section (zero-initialized data) */
   .bss
 
@@ -70,11 +84,64 @@ wind_edge_cnt:
 wind_tick_cnt:
   .long 0  
 
+  /* Free running tick count (wraps) so the main program can time a tick */
+  .global wind_ticks_total
+wind_ticks_total:
+  .long 0
+
   /* Tick count between edges */
   .global wind_low_tick_cnt
 wind_low_tick_cnt:
   .long 0  
 
+  /* Ticks counted so far in the current gust bucket */
+  .global wind_gust_ticks
+wind_gust_ticks:
+  .long 0
+
+  /* Wind pulses counted so far in the current gust bucket */
+  .global wind_gust_pulses
+wind_gust_pulses:
+  .long 0
+
+  /* Pulses in each of the last WIND_GUST_BUCKETS buckets, oldest at wind_gust_idx */
+  .global wind_gust_ring
+wind_gust_ring:
+  .skip WIND_GUST_BUCKETS*4
+
+  /* Slot in the ring the next full bucket goes in */
+  .global wind_gust_idx
+wind_gust_idx:
+  .long 0
+
+  /* Total of the ring, the pulses in the last gust window */
+  .global wind_gust_sum
+wind_gust_sum:
+  .long 0
+
+  /* Most pulses seen in any one gust window since the main program last read it */
+  .global wind_gust_max
+wind_gust_max:
+  .long 0
+
+  /* Length of a gust bucket in ticks (the gust window over WIND_GUST_BUCKETS).
+     Set by main program. */
+  .global wind_gust_bucket
+wind_gust_bucket:
+  .long 0
+
+  /* Pulse interval histogram.  A pulse lands in the first bin whose edge it is shorter than,
+     or in the last bin if it's slower than all of them */
+  .global wind_hist
+wind_hist:
+  .skip WIND_HIST_BINS*4
+
+  /* Ascending tick thresholds between the histogram bins (one less than the number of bins).
+     Set by main program. */
+  .global wind_hist_edges
+wind_hist_edges:
+  .skip (WIND_HIST_BINS-1)*4
+
   ///
   //
   //
@@ -125,12 +192,68 @@ entry:
   jump read_rain_now
   
 read_wind_now:
-  /* Increment tick count so we can measure gust by short pulses*/
+  /* Free running tick count, read by the main program to measure the tick time */
+  move r3, wind_ticks_total
+  ld r2, r3, 0
+  add r2, r2, 1
+  st r2, r3, 0
+
+  /* Increment tick count so we can measure gust by short pulses (stops at the top so slow pulses don't wrap) */
   move r3, wind_tick_cnt
   ld r2, r3, 0
   add r2, r2, 1
+  jump wind_tick_full, ov
   st r2, r3, 0
- 
+wind_tick_full:
+
+  /* Count ticks in the gust bucket.  Once it's full, swap it into the ring for the oldest one,
+     keep the ring's total if it's the busiest gust window so far and start a new bucket */
+  move r3, wind_gust_ticks
+  ld r2, r3, 0
+  add r2, r2, 1
+  st r2, r3, 0
+  move r1, wind_gust_bucket
+  ld r1, r1, 0
+  sub r1, r2, r1
+  jump read_wind_pin, ov
+  move r2, 0
+  st r2, r3, 0
+  // r1 points at the oldest bucket, r2 is the total without it
+  move r3, wind_gust_idx
+  ld r0, r3, 0
+  move r1, wind_gust_ring
+  add r1, r1, r0
+  move r3, wind_gust_sum
+  ld r2, r3, 0
+  ld r3, r1, 0
+  sub r2, r2, r3
+  // the new bucket goes in its place and on the total
+  move r3, wind_gust_pulses
+  ld r3, r3, 0
+  st r3, r1, 0
+  add r2, r2, r3
+  move r3, wind_gust_sum
+  st r2, r3, 0
+  move r3, wind_gust_pulses
+  move r1, 0
+  st r1, r3, 0
+  // next slot, wrapping round the ring
+  add r0, r0, 1
+  jumpr gust_idx_done, WIND_GUST_BUCKETS, lt
+  move r0, 0
+gust_idx_done:
+  move r3, wind_gust_idx
+  st r0, r3, 0
+  move r1, wind_gust_max
+  ld r0, r1, 0
+  sub r0, r0, r2
+  jump gust_window_max, ov
+  jump read_wind_pin
+gust_window_max:
+  // more pulses than the old max, so keep this window
+  st r2, r1, 0
+
+read_wind_pin:
   /* Set pin */
   move r3, 16
 
@@ -278,6 +401,35 @@ wake_up:
   halt  
 
 leading_detected:
+  // Count the pulse towards the current gust bucket
+  move r3, wind_gust_pulses
+  ld r2, r3, 0
+  add r2, r2, 1
+  st r2, r3, 0
+
+  // Bin the pulse interval - walk the edges until we find one the interval is shorter than
+  move r3, wind_tick_cnt
+  ld r2, r3, 0
+  move r1, wind_hist_edges
+  move r0, 0
+hist_find_bin:
+  jumpr hist_bin_found, WIND_HIST_BINS-1, ge   //out of edges, so it's the slowest bin
+  ld r3, r1, 0
+  sub r3, r2, r3
+  jump hist_bin_found, ov
+  add r1, r1, 1
+  add r0, r0, 1
+  jump hist_find_bin
+
+hist_bin_found:
+  move r1, wind_hist
+  add r1, r1, r0
+  ld r2, r1, 0
+  add r2, r2, 1
+  jump hist_bin_full, ov    //don't wrap a busy bin
+  st r2, r1, 0
+hist_bin_full:
+
   // Jump to pulse_lower if we find lowest value
   move r3, wind_low_tick_cnt
   move r2, wind_tick_cnt
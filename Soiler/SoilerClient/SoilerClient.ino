@@ -4,6 +4,7 @@
 #include <avr/eeprom.h>
 #include "LowPower.h"
 #include "debug.h"
+#include "SoilerFrame.h"
 
 #define BASE_ID 15
 #define BIT0 6
@@ -14,6 +15,12 @@
 
 #define SLEEP_CYCLES 450   //This is 1 hour, because we can sleep for up to 8 seconds at a time.
 #define REBOOT_CYCLES 12   //How many sleep cycle before reboot  (if sleeps for 1 hour, then 12 will reboot every 12 hours)
+#define READING_MINUTES 60 //Minutes between readings (SLEEP_CYCLES * 8 seconds)
+#define READINGS_PER_PACKET 1   //Readings to collect before transmitting.  More means fewer transmissions (longer battery) but later updates
+
+#if READINGS_PER_PACKET > SOILER_MAX_READINGS
+#error "READINGS_PER_PACKET won't fit in a frame"
+#endif
 
 //Default values
 #define DRY 790
@@ -27,6 +34,9 @@ struct ConfigStruct
 
 int boardId;
 int rebootNum = 0;
+uint16_t sequence = 0;    //gateway uses this to spot lost packets (starts over when we reboot)
+uint8_t readings[READINGS_PER_PACKET];
+int readingCount = 0;
 
 // create a standard reset function
 void(* resetFunc) (void) = 0; 
@@ -135,15 +145,13 @@ void loop()
 
 
   #if !defined(DEBUG)
-  // send packet
-  LoRa.beginPacket();
-  LoRa.write(1);    //SOH
-  LoRa.write(boardId); //unique id based on which pins are brought low
-  LoRa.write(perc); //percentage moisture as a whole number
-  LoRa.write(voltage);   //voltage * 10 to imply decimal point
-  LoRa.write(boardId|perc|voltage);   //poor man's crc
-  LoRa.write(4);    //EOT
-  LoRa.endPacket();
+  //hold on to readings until we've got enough to send
+  readings[readingCount++]=constrain(perc,0,100);
+  if(readingCount>=READINGS_PER_PACKET)
+  {
+    sendReadings(voltage);
+    readingCount=0;
+  }
 
   //delay(60L*1000L);
 
@@ -162,6 +170,36 @@ void loop()
   #endif
 }
 
+//Build and send a frame (see SoilerFrame.h) with everything we've collected
+void sendReadings(int voltage)
+{
+  uint8_t frame[SOILER_MAX_FRAME];
+  int len=0;
+
+  frame[len++]=SOILER_SOH;
+  frame[len++]=SOILER_FRAME_VERSION;
+  frame[len++]=boardId;                   //unique id based on which pins are brought low
+  frame[len++]=sequence & 0xFF;
+  frame[len++]=sequence >> 8;
+  frame[len++]=constrain(voltage,0,255);  //voltage * 10 to imply decimal point
+  frame[len++]=READING_MINUTES;
+  frame[len++]=readingCount;
+  for(int i=0;i<readingCount;i++)
+    frame[len++]=readings[i];             //percentage moisture as a whole number
+
+  uint16_t crc=soilerCRC16(frame,len);
+  frame[len++]=crc & 0xFF;
+  frame[len++]=crc >> 8;
+
+  // send packet
+  LoRa.beginPacket();
+  LoRa.write(frame,len);
+  LoRa.endPacket();
+  LoRa.sleep();
+
+  sequence++;
+}
+
 int getBoardID()
 {
   int id=0;
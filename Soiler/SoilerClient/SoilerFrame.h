@@ -0,0 +1,68 @@
+#ifndef soilerframe_h
+#define soilerframe_h
+
+//
+// Soil sensor LoRa frame - shared by SoilerClient and SoilerGateway, so keep both copies the same
+//
+//  0     SOH
+//  1     frame version
+//  2     sensor id
+//  3-4   sequence number (little endian), one per transmission
+//  5     battery voltage * 10
+//  6     minutes between readings
+//  7     number of readings (1 to SOILER_MAX_READINGS)
+//  8..   moisture percentage for each reading, oldest first
+//  last  CRC-16/CCITT of everything before it (little endian)
+//
+#define SOILER_SOH              1
+#define SOILER_FRAME_VERSION    2     // the original SOH,id,perc,voltage,crc,EOT frame is version 1
+#define SOILER_HEADER_SIZE      8
+#define SOILER_MAX_READINGS     12
+#define SOILER_MAX_FRAME        (SOILER_HEADER_SIZE+SOILER_MAX_READINGS+2)
+
+//Sequence numbers count up from 0 when a sensor boots and wrap at 65535
+#define SOILER_SEQ_MAX_GAP      1000  // more packets than this lost in a row isn't believable
+#define SOILER_SEQ_RESTARTED    16    // a sequence this low after an unbelievable gap means the sensor rebooted
+
+//What a sequence number says about the packets since the last one from the same sensor
+#define SOILER_SEQ_NEXT         0     // in order, with *lost packets missed in between
+#define SOILER_SEQ_DUPLICATE    1
+#define SOILER_SEQ_RESTART      2     // the sensor rebooted
+#define SOILER_SEQ_RESYNC       3     // too far off to count anything lost; start again from this one
+
+//CRC-16/CCITT (poly 0x1021, init 0xFFFF)
+static inline uint16_t soilerCRC16(const uint8_t *data, int length)
+{
+  uint16_t crc = 0xFFFF;
+  for(int i=0;i<length;i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for(int bit=0;bit<8;bit++)
+    {
+      if(crc & 0x8000)
+        crc = (crc << 1) ^ 0x1021;
+      else
+        crc = crc << 1;
+    }
+  }
+  return crc;
+}
+
+//SOILER_SEQ_* for sequence against the last one received from the same sensor
+static inline int soilerSequenceCheck(uint16_t lastSequence, uint16_t sequence, uint16_t *lost)
+{
+  *lost = 0;
+  uint16_t gap = (uint16_t)(sequence - lastSequence);   //across the wrap too
+  if(gap == 0)
+    return SOILER_SEQ_DUPLICATE;
+  if(gap <= SOILER_SEQ_MAX_GAP)
+  {
+    *lost = gap - 1;
+    return SOILER_SEQ_NEXT;
+  }
+  if(sequence < SOILER_SEQ_RESTARTED)
+    return SOILER_SEQ_RESTART;
+  return SOILER_SEQ_RESYNC;
+}
+
+#endif
@@ -13,11 +13,50 @@
 #include "version.h"
 #include "properties.h"
 #include "MyWifi.h"
+#include "SoilerFrame.h"
 
 #define HTTPSERVERTIME        0                    // time blocking in server listen for handshaking while in loop  (zero is immediate)
 
 #define BAND    915E6  //you can set band here directly,e.g. 868E6,915E6
 
+#define LORA_MAX_PACKET       SOILER_MAX_FRAME     // anything bigger than this isn't one of ours
+#define PACKET_QUEUE_SIZE     16                   // packets waiting for the main loop to handle them
+#define MAX_SENSORS           16                   // sensors we keep a latest reading for
+#define RETRY_INTERVAL        30000                // ms to wait before retrying a failed hub/rachio update
+#define MAX_TRIES             5                    // give up on a reading after this many failed updates
+
+//Raw packet as read by the receive task
+struct LoRaPacket
+{
+  uint8_t data[LORA_MAX_PACKET];
+  int length;
+  int rssi;
+  float snr;
+};
+
+//Latest reading from each sensor, waiting to go upstream.  A newer reading replaces an older one that hasn't been sent yet.
+//  Also keeps link stats for the sensor so we can tell how well it's getting through.
+struct SensorReading
+{
+  int id;
+  int perc;
+  int voltage;
+  int rssi;
+  float snr;
+  bool hubPending;
+  bool rachioPending;
+  int tries;
+  unsigned long nextTryMillis;
+
+  //link stats (only for sensors sending sequence numbers)
+  bool hasSequence;
+  uint16_t lastSequence;
+  unsigned long packetsReceived;
+  unsigned long packetsLost;
+  long rssiSum;
+  float snrSum;
+};
+
 //Globals
 Preferences preferences;
 MyWifi wifi;
@@ -31,6 +70,16 @@ Dictionary moistureSensorPorts;
 const char* api=RACHIO_API_KEY;
 Dictionary sensorZones;
 
+//LoRa receive (DIO0 interrupt --> receive task --> packet queue --> loop)
+QueueHandle_t packetQueue;
+TaskHandle_t receiveTaskHandle;
+volatile unsigned long droppedPackets=0;
+unsigned long loggedDroppedPackets=0;
+SensorReading sensorReadings[MAX_SENSORS];
+bool displayDirty=false;
+int lastDisplayedPerc=0;
+int lastDisplayedRssi=0;
+
 //Display
 SSD1306 display(0x3c, 4, 15);
 //static SSD1306Wire  display(0x3c, 500000, SDA_OLED, SCL_OLED, GEOMETRY_128_64, RST_OLED); 
@@ -67,7 +116,7 @@ void syncEpoch()
 }
 
 //Update soil moisture % with rachio
-void putSoilMoisture(const char*id,const char*token,double percentage) 
+bool putSoilMoisture(const char*id,const char*token,double percentage) 
 {
   //Manually create payload so that racio likes it
   //{"id":"eb2067a4-503d-4c96-b3c5-7f1d36836fef","percent":1.0}
@@ -85,8 +134,11 @@ void putSoilMoisture(const char*id,const char*token,double percentage)
   sprintf(buf,"{\"id\":\"%s\",\"percent\":%s}",id,percStr);
 
   //send admin data back
-  if(wifi.sendPutMessage("https://api.rach.io/1/public/zone/setMoisturePercent",token,buf))
-    myLogger.log(VERBOSE,"Updated Rachio with soil moisture data...");
+  if(!wifi.sendPutMessage("https://api.rach.io/1/public/zone/setMoisturePercent",token,buf))
+    return false;
+
+  myLogger.log(VERBOSE,"Updated Rachio with soil moisture data...");
+  return true;
 }
 
 //refresh soil gateway data
@@ -111,11 +163,13 @@ void postSoilGW()
 }
 
 //refresh soil sensor data
-void postSoil(int id,int moistureReading,int voltage,int rssi) 
+bool postSoil(SensorReading &reading) 
 {
+  int id=reading.id;
+
   //Make sure gateway is online
   if(!hubSoilSWPort)
-    return;
+    return false;
 
   //Get port for the specific sensor
   int sensorPort=moistureSensorPorts.search(String(id)).toInt();
@@ -123,16 +177,24 @@ void postSoil(int id,int moistureReading,int voltage,int rssi)
   {
     bool retval=registerSensor(id);
     if(!retval)
-      return;
+      return false;
     sensorPort=moistureSensorPorts.search(String(id)).toInt();
   }
 
   //soil moisture sensor
   DynamicJsonDocument doc(512);
   doc["network_id"] = id;
-  doc["soil_moisture"] = moistureReading;
-  doc["vcc_voltage"] = (float)voltage/10.0;
-  doc["wifi_strength"] = rssi;
+  doc["soil_moisture"] = reading.perc;
+  doc["vcc_voltage"] = (float)reading.voltage/10.0;
+  doc["wifi_strength"] = reading.rssi;
+  doc["snr"] = round2(reading.snr);
+  if(reading.packetsReceived>0)
+  {
+    doc["avg_rssi"] = round2((double)reading.rssiSum/reading.packetsReceived);
+    doc["avg_snr"] = round2(reading.snrSum/reading.packetsReceived);
+  }
+  if(reading.hasSequence)
+    doc["packet_loss"] = round2(100.0*reading.packetsLost/(double)(reading.packetsLost+reading.packetsReceived));
   doc["firmware_version"] = SKETCH_VERSION;
   doc["heap_frag"] = round2((1.0-((double)ESP.getMinFreeHeap()/(double)ESP.getFreeHeap()))*100);
   doc["current_time"] = currentTime(); //send back the last epoch sent in + elapsed time since
@@ -144,10 +206,11 @@ void postSoil(int id,int moistureReading,int voltage,int rssi)
     myLogger.log(WARNING,"Error posting to ensor id %d, so removing it from our list",id);
     sensorPort=0;
     moistureSensorPorts.remove(String(id));
-    return;
+    return false;
   }
 
   myLogger.log(VERBOSE,"Posted soil sensor data...");
+  return true;
 }
 
 bool registerSensor(int id)
@@ -270,6 +333,12 @@ void setup()
     display.drawString(5,25,"LoRa Initializing OK!");
     display.display();    
 
+    //Packets are read by their own task as soon as DIO0 says one is in, so they're not lost while we're busy with http
+    packetQueue=xQueueCreate(PACKET_QUEUE_SIZE,sizeof(LoRaPacket));
+    xTaskCreatePinnedToCore(loraReceiveTask,"loraReceive",4096,NULL,configMAX_PRIORITIES-2,&receiveTaskHandle,1);
+    attachInterrupt(digitalPinToInterrupt(DI0),onDio0Rise,RISING);
+    LoRa.receive();   //continuous receive - DIO0 rises on rx done
+
     //Initial sync
     syncEpoch();
     postSoilGW();
@@ -293,10 +362,23 @@ void initialSetup()
 
 void loop()
 {
-  //Lora packet?
-  int packetSize = LoRa.parsePacket();
-  if (packetSize) 
-      readPacket(packetSize);
+  //Pick up any packets the receive task queued up
+  LoRaPacket packet;
+  while(xQueueReceive(packetQueue,&packet,0)==pdTRUE)
+    readPacket(packet);
+
+  if(droppedPackets!=loggedDroppedPackets)
+  {
+    loggedDroppedPackets=droppedPackets;
+    myLogger.log(WARNING,"Packet queue was full - %lu packets dropped so far",loggedDroppedPackets);
+  }
+
+  //Show the latest reading
+  if(displayDirty)
+    updateDisplay();
+
+  //Send anything pending to the hub and rachio
+  sendReadings();
 
   //Check in if the hub is trying to get me
   wifi.listen(HTTPSERVERTIME);
@@ -310,37 +392,123 @@ void loop()
   }
 }
 
-void readPacket(int packetSize) 
+//DIO0 rises when the radio has a packet - wake the receive task
+void IRAM_ATTR onDio0Rise()
+{
+  BaseType_t higherPriorityTaskWoken=pdFALSE;
+  vTaskNotifyGiveFromISR(receiveTaskHandle,&higherPriorityTaskWoken);
+  if(higherPriorityTaskWoken)
+    portYIELD_FROM_ISR();
+}
+
+//Only task that touches the radio once we're set up.  Reads the packet off the radio, queues it, and goes straight back to receiving.
+void loraReceiveTask(void *param)
+{
+  for(;;)
+  {
+    //timeout is just a safety net in case we miss an edge
+    ulTaskNotifyTake(pdTRUE,pdMS_TO_TICKS(1000));
+
+    int packetSize=LoRa.parsePacket();
+    if(packetSize)
+    {
+      LoRaPacket packet;
+      packet.length=0;
+      while(LoRa.available())
+      {
+        int b=LoRa.read();
+        if(packet.length<LORA_MAX_PACKET)
+          packet.data[packet.length++]=b;
+      }
+      packet.rssi=LoRa.packetRssi();
+      packet.snr=LoRa.packetSnr();
+
+      if(xQueueSend(packetQueue,&packet,0)!=pdTRUE)
+        droppedPackets++;
+    }
+
+    //parsePacket leaves the radio idle, so back to continuous receive
+    LoRa.receive();
+  }
+}
+
+void readPacket(LoRaPacket &packet) 
 {
   // received a packets
   Serial.println("Received packet");
-  display.clear();
-  display.setFont(ArialMT_Plain_16);
-  display.drawString(3, 0, "Received packet ");
-  display.display();
+  lastDisplayedRssi=packet.rssi;
+  displayDirty=true;
+
+  if(packet.length>=2 && packet.data[0]==SOILER_SOH && packet.data[1]==SOILER_FRAME_VERSION)
+    readFrame(packet);
+  else
+    readLegacyFrame(packet);
+}
+
+//Versioned frame w/ CRC-16 and sequence number (see SoilerFrame.h)
+void readFrame(LoRaPacket &packet)
+{
+  const uint8_t *data=packet.data;
+  if(packet.length<SOILER_HEADER_SIZE+3)
+  {
+    myLogger.log(INFO,"Frame too short  (length: %d)",packet.length); 
+    return;
+  }
+
+  int count=data[7];
+  int frameLength=SOILER_HEADER_SIZE+count+2;
+  if(count<1 || count>SOILER_MAX_READINGS || frameLength>packet.length)
+  {
+    myLogger.log(INFO,"Bad reading count in frame  (count: %d, length: %d)",count,packet.length); 
+    return;
+  }
+
+  uint16_t crc=data[frameLength-2] | (data[frameLength-1]<<8);
+  if(crc!=soilerCRC16(data,frameLength-2))
+  {
+    myLogger.log(INFO,"CRC's don't match  (id: %d)",data[2]); 
+    return;
+  }
+
+  int id=data[2];
+  uint16_t sequence=data[3] | (data[4]<<8);
+  int voltage=data[5];
+  int minutes=data[6];
+  int perc=data[SOILER_HEADER_SIZE+count-1];    //newest reading is last
+
+  for(int i=0;i<count-1;i++)
+    myLogger.log(VERBOSE,"Sensor %d older reading: %d%% (%d minutes before latest)",id,data[SOILER_HEADER_SIZE+i],(count-1-i)*minutes);
 
+  if(id<10 || id>128 || perc>100 || voltage>100)
+  {
+    myLogger.log(INFO,"Did not recognize frame  (id: %d, perc: %d, volt: %d)",id,perc,voltage); 
+    return;
+  }
+
+  lastDisplayedPerc=perc;
+  storeReading(id,perc,voltage,packet.rssi,packet.snr,true,sequence);
+}
+
+//Original SOH,id,perc,voltage,crc,EOT frame from sensors that haven't been updated yet
+void readLegacyFrame(LoRaPacket &packet)
+{
   //make sure we're at the start of the transmission
-  while(LoRa.available() && LoRa.read() != 01) {}
-  int id=LoRa.read();
-  int perc=LoRa.read();
-  int voltage=LoRa.read();
-  int crc=LoRa.read();
-  while(LoRa.available() && LoRa.read() != 04) {}   //make sure we go to the EOT byte
-
-  //Now let's clean up in case it's another message
-  while(LoRa.available()) {LoRa.read();} 
-
-  // print RSSI of packet
-  display.drawString(20,22, (String)perc);
-  display.drawString(20, 45, "RSSI:  ");
-  display.drawString(70, 45, (String)LoRa.packetRssi());
-  display.display();
+  int idx=0;
+  while(idx<packet.length && packet.data[idx] != SOILER_SOH) {idx++;}
+  if(packet.length-idx<6)
+  {
+    myLogger.log(INFO,"Packet too short  (length: %d)",packet.length); 
+    return;
+  }
+  int id=packet.data[idx+1];
+  int perc=packet.data[idx+2];
+  int voltage=packet.data[idx+3];
+  int crc=packet.data[idx+4];
 
   //poor man's crc
   if(crc!=(id|perc|voltage))
   {
     myLogger.log(INFO,"CRC's don't match  (id: %d perc: %d)",id,perc); 
-    myLogger.sendLogs(wifi.isConnected());
     return;
   }
 
@@ -348,20 +516,129 @@ void readPacket(int packetSize)
   if(id<10 || id>128 || perc<0 || perc>100 || voltage<0 || voltage>100)
   {
     myLogger.log(INFO,"Did not recognize packet  (id: %d, perc: %d, volt: %d, crc: %d)",id,perc,voltage,crc); 
-    myLogger.sendLogs(wifi.isConnected());
     return;
   }
 
-  //post soil info we just got to hub
-  postSoil(id,perc,voltage,LoRa.packetRssi());
-  myLogger.sendLogs(wifi.isConnected());
+  lastDisplayedPerc=perc;
+  storeReading(id,perc,voltage,packet.rssi,packet.snr,false,0);
+}
 
-  //post soil percentage we just got to Rachio
-  updateSoilMoisture(id,perc);
-  myLogger.sendLogs(wifi.isConnected());
+//Keep only the latest reading per sensor - if the last one hasn't gone out yet, this one replaces it
+void storeReading(int id,int perc,int voltage,int rssi,float snr,bool hasSequence,uint16_t sequence)
+{
+  SensorReading *reading=NULL;
+  for(int i=0;i<MAX_SENSORS && reading==NULL;i++)
+  {
+    if(sensorReadings[i].id==id)
+      reading=&sensorReadings[i];
+  }
+  for(int i=0;i<MAX_SENSORS && reading==NULL;i++)
+  {
+    if(sensorReadings[i].id==0)
+      reading=&sensorReadings[i];
+  }
+  if(reading==NULL)
+  {
+    myLogger.log(WARNING,"No room to track sensor %d",id);
+    return;
+  }
+
+  //Sequence numbers tell us about duplicates and lost packets (see soilerSequenceCheck())
+  if(reading->id==id && reading->hasSequence && hasSequence)
+  {
+    uint16_t lost;
+    int seq=soilerSequenceCheck(reading->lastSequence,sequence,&lost);
+    if(seq==SOILER_SEQ_DUPLICATE)
+    {
+      myLogger.log(VERBOSE,"Duplicate packet from sensor %d (sequence %u)",id,sequence);
+      return;
+    }
+    if(seq==SOILER_SEQ_NEXT)
+      reading->packetsLost+=lost;
+    else if(seq==SOILER_SEQ_RESTART)
+      myLogger.log(INFO,"Sensor %d sequence restarted (%u --> %u)",id,reading->lastSequence,sequence);
+    else
+      myLogger.log(WARNING,"Sensor %d sequence jumped (%u --> %u), not counting it as lost",id,reading->lastSequence,sequence);
+  }
+
+  if(reading->id==id && (reading->hubPending || reading->rachioPending))
+    myLogger.log(VERBOSE,"Sensor %d already had a reading waiting - replacing it",id);
+
+  reading->id=id;
+  reading->perc=perc;
+  reading->voltage=voltage;
+  reading->rssi=rssi;
+  reading->snr=snr;
+  reading->hubPending=true;
+  reading->rachioPending=true;
+  reading->tries=0;
+  reading->nextTryMillis=millis();
+
+  reading->hasSequence=hasSequence;
+  reading->lastSequence=sequence;
+  reading->packetsReceived++;
+  reading->rssiSum+=rssi;
+  reading->snrSum+=snr;
+
+  myLogger.log(VERBOSE,"Sensor %d link - RSSI: %d, SNR: %f, received: %lu, lost: %lu",id,rssi,snr,reading->packetsReceived,reading->packetsLost);
 }
 
-void updateSoilMoisture(int sensorId,int perc)
+//Send pending readings upstream, retrying failures after RETRY_INTERVAL
+void sendReadings()
+{
+  bool sentSomething=false;
+  for(int i=0;i<MAX_SENSORS;i++)
+  {
+    SensorReading &reading=sensorReadings[i];
+    if(!reading.hubPending && !reading.rachioPending)
+      continue;
+    if((long)(millis()-reading.nextTryMillis)<0)
+      continue;
+
+    //post soil info we just got to hub
+    if(reading.hubPending)
+      reading.hubPending=!postSoil(reading);
+
+    //post soil percentage we just got to Rachio
+    if(reading.rachioPending)
+      reading.rachioPending=!updateSoilMoisture(reading.id,reading.perc);
+
+    sentSomething=true;
+    reading.tries++;
+    if(reading.hubPending || reading.rachioPending)
+    {
+      if(reading.tries>=MAX_TRIES)
+      {
+        myLogger.log(WARNING,"Giving up on reading from sensor %d after %d tries  (hub: %d, rachio: %d)",reading.id,reading.tries,reading.hubPending,reading.rachioPending);
+        reading.hubPending=false;
+        reading.rachioPending=false;
+      }
+      else
+      {
+        reading.nextTryMillis=millis()+RETRY_INTERVAL;
+      }
+    }
+  }
+
+  if(sentSomething)
+    myLogger.sendLogs(wifi.isConnected());
+}
+
+void updateDisplay()
+{
+  displayDirty=false;
+
+  display.clear();
+  display.setFont(ArialMT_Plain_16);
+  display.drawString(3, 0, "Received packet ");
+  display.drawString(20,22, (String)lastDisplayedPerc);
+  display.drawString(20, 45, "RSSI:  ");
+  display.drawString(70, 45, (String)lastDisplayedRssi);
+  display.display();
+}
+
+//Returns false if any zone couldn't be updated
+bool updateSoilMoisture(int sensorId,int perc)
 {
   //First, convert perc to soil moisture  (TODO: add structure w/ min/max so this is setup-able)
   //For now, we'll use 20/60 as min max
@@ -371,22 +648,25 @@ void updateSoilMoisture(int sensorId,int perc)
   if(soilPerc>1) 
     soilPerc=1.0;
 
+  bool success=true;
   String zoneId=sensorZones.search(String(sensorId));
   myLogger.log(INFO,"Updating Zone %s for Sensor %d with %f",zoneId.c_str(),sensorId,soilPerc); 
   if(zoneId.length()>0)
   {
     //update zone just returned
-    putSoilMoisture(zoneId.c_str(),api,soilPerc);
+    success=putSoilMoisture(zoneId.c_str(),api,soilPerc) && success;
 
     //Any linked zones?
     zoneId=sensorZones.search(zoneId);
     while(zoneId.length()>0)
     {
       myLogger.log(INFO,"Linked Zone %s found",zoneId.c_str());
-      putSoilMoisture(zoneId.c_str(),api,soilPerc);
+      success=putSoilMoisture(zoneId.c_str(),api,soilPerc) && success;
       zoneId=sensorZones.search(zoneId);
     }
   }
+
+  return success;
 }
 
 //put bool named pair into flash
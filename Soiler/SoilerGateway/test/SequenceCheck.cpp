@@ -0,0 +1,54 @@
+//
+// Host check of soilerSequenceCheck() in SoilerFrame.h, the way
+// storeReading() sorts a sensor's sequence number against its last one:
+// in order (counting what was lost), a duplicate, a sensor that rebooted
+// and started over at 0, or a jump too big to believe.  Includes sequences
+// crossing the 65535 --> 0 wrap, which must count as in order, not as a
+// reboot.
+//
+// Build and run (from SoilerGateway/):
+//   g++ -std=c++11 -O2 -Wall -o SequenceCheck test/SequenceCheck.cpp
+//   ./SequenceCheck
+//
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../SoilerFrame.h"
+
+//1 if it failed, so main() can add them up
+static int check(uint16_t last, uint16_t sequence, int expected, uint16_t expectedLost, const char *what)
+{
+  uint16_t lost;
+  int seq=soilerSequenceCheck(last,sequence,&lost);
+  bool ok=seq==expected && lost==expectedLost;
+  printf("%s %s (%u --> %u: %d, %u lost)\n",ok ? "ok  " : "FAIL",what,last,sequence,seq,lost);
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  int failures=0;
+
+  failures+=check(41,42,SOILER_SEQ_NEXT,0,"next one");
+  failures+=check(41,45,SOILER_SEQ_NEXT,3,"three lost");
+  failures+=check(41,41,SOILER_SEQ_DUPLICATE,0,"duplicate");
+
+  //Wrap
+  failures+=check(65535,0,SOILER_SEQ_NEXT,0,"wrap, next one");
+  failures+=check(65534,2,SOILER_SEQ_NEXT,3,"wrap, three lost");
+  failures+=check(65000,400,SOILER_SEQ_NEXT,935,"wrap, a long run lost");
+  failures+=check(0,0,SOILER_SEQ_DUPLICATE,0,"duplicate just after the wrap");
+
+  //Reboot: starts over at 0
+  failures+=check(5000,0,SOILER_SEQ_RESTART,0,"rebooted");
+  failures+=check(5000,3,SOILER_SEQ_RESTART,0,"rebooted, first packets lost");
+  failures+=check(12,0,SOILER_SEQ_RESTART,0,"rebooted soon after a reboot");
+
+  //Too far off either way to count
+  failures+=check(5000,30000,SOILER_SEQ_RESYNC,0,"jumped forward");
+  failures+=check(30000,29990,SOILER_SEQ_RESYNC,0,"went backwards");
+
+  printf("%s\n",failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
@@ -47,7 +47,7 @@
 // TIMING CONSTANTS - Adjust these to change system behavior
 // ============================================================================
 #define POLL_TIME_MS	500             // BLE command polling interval (how often we send commands to devices)
-#define TANK_CHECK_TIME 60000  		// Check gas and water tank every 15 minutes (WiFi must be off during ADC read)
+#define TANK_CHECK_TIME 60000  		// Check water tank every minute (gas is polled, see GasTank)
 #define WIFI_CHECK_TIME 60000        // Check/reconnect WiFi every 1 minute
 #define STATUS_LOG_TIME 600000        // Log status (batteries + tanks) every 10 minutes (for remote debugging)
 #define REFRESH_RTC (60L*60L*1000L)  // Sync RTC with internet time every hour
@@ -176,12 +176,12 @@ void setup()
 	// ========================================================================
 	// TANK SENSOR INITIALIZATION
 	// Read initial values before BLE starts (ADC can conflict with BLE)
+	// Gas loads its calibration and usage profile; it reads from loop()
 	// ========================================================================
 	waterTank.readWaterLevel();
 	waterTank.updateDaysRemaining();
 
-	gasTank.readGasLevel();
-	gasTank.updateDaysRemaining();	
+	gasTank.begin();
 
 	// ========================================================================
 	// START BLE SCANNING
@@ -353,11 +353,12 @@ void loop()
 	// Includes: SOC, amps, isCurrent (stale check), isConnected, tank levels
 	// ========================================================================
 	if(millis() - lastStatusLogTime > STATUS_LOG_TIME) {
-		logger.log(INFO, "Status: SOK1=%d/%fA (curr=%d, conn=%d), SOK2=%d/%fA (curr=%d, conn=%d), BT2=%fV/%fA/%fA (curr=%d, conn=%d), Water=%d%%/%fV, Gas=%d%%/%fV", 
+		logger.log(INFO, "Status: SOK1=%d/%fA (curr=%d, conn=%d), SOK2=%d/%fA (curr=%d, conn=%d), BT2=%fV/%fA/%fA (curr=%d, conn=%d), Water=%d%%/%fV, Gas=%d%%/%fV/%.0fg (%.1f days, %.1f-%.1f, duty %.0f%%)", 
 			sokReader1.getSoc(), sokReader1.getAmps(), sokReader1.isCurrent(), sokReader1.isConnected(),
 			sokReader2.getSoc(), sokReader2.getAmps(), sokReader2.isCurrent(), sokReader2.isConnected(),
 			bt2Reader.getBatteryVolts(), bt2Reader.getSolarAmps(), bt2Reader.getAlternaterAmps(), bt2Reader.isCurrent(), bt2Reader.isConnected(),
-			waterTank.getWaterLevel(), waterTank.getWaterVoltage(), gasTank.getGasLevel(), gasTank.getGasVoltage());
+			waterTank.getWaterLevel(), waterTank.getWaterVoltage(), gasTank.getGasLevel(), gasTank.getGasVoltage(), gasTank.getGasGrams(),
+			gasTank.getGasDaysRemaining(), gasTank.getGasDaysLow(), gasTank.getGasDaysHigh(), gasTank.getDutyCycle() * 100);
 		lastStatusLogTime = millis();
 	}
 
@@ -383,19 +384,44 @@ void loop()
 
 	// ========================================================================
 	// STEP 9: TANK SENSORS
-	// Read water and gas tank levels
+	// Water is read every TANK_CHECK_TIME (blocking ADC read)
+	// Gas takes one oversample per pass when due (non-blocking)
+	// Serial "gascal ..." commands calibrate the gas sensor (non-blocking)
 	// ========================================================================
 	if(millis() - lastTankCheckTime > TANK_CHECK_TIME) 
 	{	
-		// Read tank sensors (blocking ADC operations)
 		waterTank.readWaterLevel();
 		waterTank.updateDaysRemaining();
-
-		gasTank.readGasLevel();
-		gasTank.updateDaysRemaining();		
 		
 		lastTankCheckTime = millis();
 	}
+	gasTank.poll(&rtc);
+
+	// Serial is taken a character at a time so a half typed line doesn't
+	// stall the loop (readStringUntil waits up to a second for the '\n')
+	static char serialLine[64];     // Persists across loop iterations
+	static size_t serialLen = 0;
+	static bool serialOverflow = false;
+	while(Serial.available())
+	{
+		char c = Serial.read();
+		if(c != '\n')
+		{
+			if(serialLen < sizeof(serialLine) - 1) serialLine[serialLen++] = c;
+			else serialOverflow = true;
+			continue;
+		}
+
+		serialLine[serialLen] = '\0';
+		if(!serialOverflow)
+		{
+			String line(serialLine);
+			line.trim();
+			gasTank.handleCommand(line);
+		}
+		serialLen = 0;
+		serialOverflow = false;
+	}
 
 	// ========================================================================
 	// STEP 10: RTC TIME SYNC (every 30 minutes)
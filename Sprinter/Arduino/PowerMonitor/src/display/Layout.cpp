@@ -211,6 +211,16 @@ bool Layout::isWaterRegion(int x,int y)
 	return false;
 }
 
+bool Layout::isGasRegion(int x,int y)
+{
+	// Check if touch is within gas meter bounds
+	if(x >= gasConfig.x && x <= gasConfig.x + gasConfig.width &&
+	   y >= gasConfig.y && y <= gasConfig.y + gasConfig.height)
+		return true;
+
+	return false;
+}
+
 bool Layout::isBatteryIconRegion(int x,int y)
 {
 	// Battery icon is at lx+totalBatteryWidth+batVanOffset, lcd.height()-67
@@ -65,6 +65,7 @@ class Layout
         void setBLEIndicator(int color);
         bool isBLERegion(int x,int y);
         bool isWaterRegion(int x,int y);
+        bool isGasRegion(int x,int y);
         bool isVanRegion(int x, int y);
         bool isBatteryIconRegion(int x,int y);
         bool isCenterRegion(int x, int y);
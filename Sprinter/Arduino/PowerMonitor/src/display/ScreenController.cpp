@@ -73,10 +73,8 @@ void ScreenController::update(ESP32Time* rtc, bool wifiConnected) {
             layout->setBLEIndicator(bleManager->getCurrentIndicatorColor());
         }
         
-        // Track water usage percentage per day
+        // Track water usage percentage per day (gas tracks its own, see GasTank::poll)
         if(waterTank) waterTank->updateUsage();
-        // Track gas usage percentage per day
-        if(gasTank) gasTank->updateUsage();
         
         // Calc hertz
         if(millis() > hertzTime + 1000) {
@@ -184,6 +182,10 @@ void ScreenController::handleTouch(int x, int y) {
  * - Toggles BLE on/off
  * - Calls bleManager->turnOff() or turnOn()
  * - Useful for power saving or debugging BLE issues
+ * 
+ * GAS REGION (gas bar meter):
+ * - A full bottle was put on: shifts the gas calibration to it
+ * - Uses the reading from when the bottle went on, so any time after is fine
  */
 void ScreenController::handleLongTouch(int x, int y) {
     // Long touch in center region - reset screen (for brownout recovery)
@@ -208,6 +210,10 @@ void ScreenController::handleLongTouch(int x, int y) {
             bleManager->turnOn();
         }
     }
+    // Gas meter - a full bottle is on
+    else if(layout->isGasRegion(x, y)) {
+        if(gasTank) gasTank->calibrateFull();
+    }
 }
 
 /*
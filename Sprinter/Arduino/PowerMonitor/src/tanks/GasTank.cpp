@@ -1,128 +1,178 @@
 #include "GasTank.h"
-#include "../wifi/wifi.h"
-
-extern VanWifi wifi;
-
-// Read averaged ADC value, filtering out failed reads (0 values)
-// Note: analogRead returns 0 on timeout; multiple samples provide robustness
-int GasTank::readADC() {
-    long sum = 0;
-    int validSamples = 0;
-    for (int i = 0; i < GAS_ADC_SAMPLES; i++) {
-        int reading = analogRead(GAS_LEVEL_ANALOG_PIN);
-        if (reading > 0) {
-            sum += reading;
-            validSamples++;
-        }
-        delay(2);
+
+// ============================================================================
+// PERSISTENCE
+// ============================================================================
+
+void GasTank::begin() {
+    load();
+    lastSaveTime = millis();
+}
+
+// Blank or from an older firmware: keep the defaults
+void GasTank::load() {
+    prefs.begin(GAS_NVS_NAMESPACE, true);
+
+    GasCalibration cal;
+    if (prefs.getBytes("cal", &cal, sizeof(cal)) == sizeof(cal) && gauge.setCalibration(cal)) {
+        logger.log(INFO, "GasTank: calibration loaded, %d points, %.2f ADC/C", cal.count, gauge.getTempCoef());
+    } else {
+        logger.log(WARNING, "GasTank: no calibration, using the default curve");
     }
 
-    if(validSamples == 0) {
-        logger.log(WARNING, "GasTank::readADC - All samples invalid (0)");
+    GasProfile profile;
+    if (prefs.getBytes("profile", &profile, sizeof(profile)) == sizeof(profile) && forecast.setProfile(profile)) {
+        logger.log(INFO, "GasTank: profile loaded, %d days, %.1f g/h average", profile.days, forecast.getAverageRate());
     }
 
-    return (validSamples > 0) ? (sum / validSamples) : 0;
+    prefs.end();
+}
+
+void GasTank::saveCalibration() {
+    prefs.begin(GAS_NVS_NAMESPACE, false);
+    prefs.putBytes("cal", &gauge.getCalibration(), sizeof(GasCalibration));
+    prefs.end();
+}
+
+// The learned temperature coefficient lives in the calibration, so both go
+void GasTank::saveProfile() {
+    prefs.begin(GAS_NVS_NAMESPACE, false);
+    prefs.putBytes("cal", &gauge.getCalibration(), sizeof(GasCalibration));
+    prefs.putBytes("profile", &forecast.getProfile(), sizeof(GasProfile));
+    prefs.end();
+    profileDirty = false;
+    lastSaveTime = millis();
+}
+
+// ============================================================================
+// READINGS
+// ============================================================================
+
+void GasTank::poll(ESP32Time* rtc) {
+    unsigned long now = millis();
+    if (!gauge.wantsSample(now)) return;
+
+    gauge.setTemperature(temperatureRead());
+    if (!gauge.addSample(now, analogRead(GAS_LEVEL_ANALOG_PIN))) return;
+
+    // A reading completed
+    int hour = rtc->getHour(true);
+    handleEvents(forecast.addReading(now, gauge.getGrams(), hour));
+    updateLevel(hour);
+    gasVoltage = (gauge.getAdc() / 4095.0) * 3.3;
+
+    Serial.printf("Gas Tank Level %d (ADC %.1f, %.1fC, %.0fg)\n",
+                  gasLevel, gauge.getAdc(), gauge.getTempC(), forecast.getLevelGrams());
+
+    if (profileDirty && now - lastSaveTime >= GAS_SAVE_INTERVAL) saveProfile();
 }
 
-// Linearize FSR reading using conductance (1/R) method
-// FSR C10 has logarithmic R vs force, but linear 1/R vs force
-// y = 0.0003x + 0.1329 where y=1/R (mS), x=force (grams)
-float GasTank::linearizeADC(int adc) {
-    // Convert ADC to voltage (ESP32: 12-bit ADC, 3.3V reference)
-    float voltage = (adc / 4095.0) * 3.3;
-    
-    // For voltage divider: Vout = Vin * R_fixed / (R_fsr + R_fixed)
-    // Solving for R_fsr: R_fsr = R_fixed * (Vin - Vout) / Vout
-    // Assume 10kΩ fixed resistor (adjust if different)
-    float R_fixed = 10000.0; // ohms
-    float Vin = 3.3;
-    
-    if (voltage < 0.01) return 0; // Prevent division by zero
-    
-    float R_fsr = R_fixed * (Vin - voltage) / voltage;
-    
-    // Calculate conductance (1/R) in milli-siemens
-    float conductance = 1000.0 / R_fsr; // mS
-    
-    // Using the linear equation from datasheet: conductance = 0.0003 * force + 0.1329
-    // Solve for force: force = (conductance - 0.1329) / 0.0003
-    float force = (conductance - 0.1329) / 0.0003; // grams
-    
-    if (force < 0) force = 0;
-    
-    return force; // Returns linearized force in grams
+void GasTank::handleEvents(int events) {
+    if (events & GAS_EVENT_BOUNDARY) gauge.markBoundary();
+
+    if (events & GAS_EVENT_BOOKED) {
+        gauge.learnHour(forecast.wasLastHourIdle());
+        profileDirty = true;
+        Serial.printf("Gas hour booked %.0fg (%s), temp coef %.2f ADC/C\n", forecast.getBookedGrams(),
+                      forecast.wasLastHourIdle() ? "idle" : "burning", gauge.getTempCoef());
+    }
+
+    if (events & (GAS_EVENT_SWAP | GAS_EVENT_REMOVED)) gauge.clearBoundaries();
+
+    if (events & GAS_EVENT_SWAP) {
+        haveSwapReading = true;
+        swapAdc = gauge.getAdc();
+        swapTempC = gauge.getTempC();
+        logger.log(WARNING, "GasTank: new bottle (%.0fg, ADC %.1f) - long touch the gas meter if it's full",
+                   gauge.getGrams(), swapAdc);
+    }
+    if (events & GAS_EVENT_REMOVED) logger.log(WARNING, "GasTank: bottle removed");
+    if (events & GAS_EVENT_RESEATED) logger.log(INFO, "GasTank: bottle put back (%.0fg)", gauge.getGrams());
 }
 
-// Read gas level using direct ADC mapping
-// ADC 1400 = empty (0%), ADC 1970 = full (100%), 379 is extra plumbing on tank
-#define GAS_ADC_EMPTY (1400+379)
-#define GAS_ADC_FULL  (1970+379)
-
-void GasTank::readGasLevel()
-{
-    int adc = readADC();
-    
-    // Convert ADC to voltage and cache it
-    gasVoltage = (adc / 4095.0) * 3.3;
-    
-    // Simple linear mapping from ADC to percentage
-    float percentage = ((float)(adc - GAS_ADC_EMPTY) / (float)(GAS_ADC_FULL - GAS_ADC_EMPTY)) * 100.0;
-    
+void GasTank::updateLevel(int hour) {
+    float grams = forecast.getLevelGrams();
+    float percentage = forecast.isRemoved() ? 0 : grams / gauge.getCalibration().capacityGrams * 100.0;
+
     // Bounds checking
     if (percentage > 100) percentage = 100;
     if (percentage < 0) percentage = 0;
-    
     gasLevel = static_cast<int>(percentage);
-    
-    Serial.printf("Gas Tank Level %d (ADC %d)\n", gasLevel, adc);
+
+    gasDaysRem = forecast.daysRemaining(grams, hour, &gasDaysLow, &gasDaysHigh);
 }
 
-void GasTank::updateUsage()
-{
-    int currentLevel = gasLevel; // Use cached value
-    unsigned long currentTime = millis();
-
-    // Don't initialize until we have a valid gas reading
-    // (gasLevel is 0 until readGasLevel() is called and bottle is present)
-    if (lastLevel == -1) {
-        if (currentLevel > 0) {
-            lastLevel = currentLevel;
-            lastLevelTime = currentTime;
-            lastDayCheck = currentTime;
-            Serial.printf("Gas updateUsage: Initialized with level %d\n", currentLevel);
-        }
-        return;
+// ============================================================================
+// CALIBRATION
+// ============================================================================
+
+// Uses the reading from when the bottle went on if there is one, so the
+// burner can be running when this is done
+bool GasTank::calibrateFull() {
+    bool ok = haveSwapReading ? gauge.calibrateFull(swapAdc, swapTempC) : gauge.calibrateFull();
+    if (!ok) {
+        logger.log(WARNING, "GasTank: no reading to calibrate full with");
+        return false;
     }
+    forecast.recalibrated();
+    saveCalibration();
+    logger.log(WARNING, "GasTank: calibrated full at ADC %.1f", haveSwapReading ? swapAdc : gauge.getAdc());
+    return true;
+}
 
-    // Calculate usage every hour
-    if (currentTime - lastDayCheck >= USAGE_CHECK_INTERVAL) {
-        int levelChange = lastLevel - currentLevel;
-        
-        Serial.printf("Gas updateUsage: Hourly check - lastLevel=%d, currentLevel=%d, change=%d\n", 
-                   lastLevel, currentLevel, levelChange);
-        
-        if (levelChange > 0) {
-            // Update hourly usage as weighted average (70% old, 30% new)
-            if (dailyPercentUsed == 0) {
-                dailyPercentUsed = levelChange;
-            } else {
-                dailyPercentUsed = (dailyPercentUsed * 0.7) + (levelChange * 0.3);
-            }
-            Serial.printf("Gas updateUsage: dailyPercentUsed updated to %f\n", dailyPercentUsed);
-        }
-        
-        lastLevel = currentLevel;
-        lastDayCheck = currentTime;
+bool GasTank::addCalibrationPoint(float grams) {
+    if (!gauge.addCalibrationPoint(grams)) return false;
+    forecast.recalibrated();
+    saveCalibration();
+    logger.log(WARNING, "GasTank: calibration point %.0fg at ADC %.1f", grams, gauge.getAdc());
+    return true;
+}
+
+// Keeps what's been learned about temperature
+void GasTank::clearCalibration() {
+    GasCalibration learned = gauge.getCalibration();
+    gauge.resetCalibration();
+    GasCalibration cal = gauge.getCalibration();
+    cal.tempSumXY = learned.tempSumXY;
+    cal.tempSumXX = learned.tempSumXX;
+    gauge.setCalibration(cal);
+    haveSwapReading = false;
+    forecast.recalibrated();
+    saveCalibration();
+    logger.log(WARNING, "GasTank: calibration cleared");
+}
+
+void GasTank::printCalibration() {
+    const GasCalibration& cal = gauge.getCalibration();
+    Serial.printf("Gas calibration at %.1fC, %.2f ADC/C, full %.0fg:\n", cal.calTempC, gauge.getTempCoef(), cal.capacityGrams);
+    for (int i = 0; i < cal.count; i++) {
+        Serial.printf("  ADC %7.1f = %4.0fg\n", cal.adc[i], cal.grams[i]);
     }
+    Serial.printf("Now ADC %.1f at %.1fC = %.0fg, level %.0fg, %s, duty %.0f%%, %.1f days (%.1f-%.1f)\n",
+                  gauge.getAdc(), gauge.getTempC(), gauge.getGrams(), forecast.getLevelGrams(),
+                  forecast.isBurning() ? "burning" : "idle", forecast.getDutyCycle() * 100,
+                  gasDaysRem, gasDaysLow, gasDaysHigh);
 }
 
-void GasTank::updateDaysRemaining() {
-    int currentLevel = gasLevel; // Use cached value
-    if (currentLevel < 5) {
-        gasDaysRem = 0; // Tank is essentially empty
-    } else if (dailyPercentUsed > 0) {
-        gasDaysRem = currentLevel / (dailyPercentUsed * 24);
-    } else {
-        gasDaysRem = 0; // Not enough data - show '--'
+bool GasTank::handleCommand(const String& line) {
+    if (!line.startsWith("gascal")) return false;
+    String arg = line.substring(6);
+    arg.trim();
+
+    if (arg == "clear") {
+        clearCalibration();
+    } else if (arg == "full") {
+        calibrateFull();
+    } else if (arg.length() > 0 && arg != "show") {
+        // toFloat() makes "abc" 0g, which would calibrate the bottle empty
+        char* end;
+        float grams = strtof(arg.c_str(), &end);
+        if (end == arg.c_str() || *end != '\0' || !isfinite(grams) || grams < 0) {
+            Serial.printf("gascal: '%s' isn't clear, full, show or a weight in grams\n", arg.c_str());
+            return true;
+        }
+        if (!addCalibrationPoint(grams)) Serial.println("gascal: no reading yet");
     }
+    printCalibration();
+    return true;
 }
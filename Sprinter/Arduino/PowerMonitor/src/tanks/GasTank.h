@@ -3,27 +3,39 @@
 
 /*
  * GasTank - Propane Tank Level Monitoring via Force Sensing Resistor (FSR)
- * 
+ *
  * HARDWARE SETUP:
  * - FSR C10 sensor under the propane tank
  * - Sensor measures weight/force which correlates to tank fill level
  * - Connected to GPIO13 via voltage divider (10kΩ pull-down)
- * 
- * MEASUREMENT APPROACH:
- * - FSR has logarithmic R vs force, but linear conductance (1/R) vs force
- * - ADC reading converted to voltage, then to resistance, then to conductance
- * - Conductance converted to force using FSR datasheet linear equation
- * - Force calibrated to percentage based on full/empty tank weights
- * 
- * NOTE: WiFi must be disabled during ADC reads on GPIO13 due to hardware conflict
- * with ESP32-S3 WiFi radio. Tank reads are done in a WiFi-off window.
- * 
- * USAGE TRACKING:
- * - Hourly weighted average of consumption rate
- * - Days remaining calculated from current level and usage rate
+ * - A load cell on an analog amplifier wired to the same pin works too;
+ *   only the calibration points change
+ *
+ * MEASUREMENT APPROACH (see PropaneGauge.h):
+ * - Oversampled non-blocking reads from poll(), a reading every 10 s
+ * - Multi-point calibration curve, temperature compensated, kept in NVS
+ * - Grams of propane, percent of a full bottle for the display
+ *
+ * NOTE: GPIO13 is ADC2, which the ESP32-S3 WiFi radio shares.  A read that
+ * collides with the radio gives 0; those samples are dropped.
+ *
+ * USAGE TRACKING (see PropaneForecast.h):
+ * - Burner detection from the slope of the level
+ * - Use booked per hour of the day, only for hours a burner ran
+ * - Days remaining from that profile, with an 80% band
+ *
+ * CALIBRATION:
+ * - Long touch on the gas meter: a full bottle was put on
+ * - Serial "gascal <grams>": the bottle on the sensor weighs this much
+ *   propane (commissioning: an empty, a full and a couple in between)
+ * - Serial "gascal full" / "gascal clear" / "gascal show"
  */
 
 #include <Arduino.h>
+#include <ESP32Time.h>
+#include <Preferences.h>
+#include "PropaneGauge.h"
+#include "PropaneForecast.h"
 #include "../logging/logger.h"
 
 extern Logger logger;
@@ -31,41 +43,56 @@ extern Logger logger;
 // ============================================================================
 // HARDWARE CONFIGURATION
 // ============================================================================
-#define GAS_LEVEL_ANALOG_PIN 13      // GPIO13 - Note: WiFi must be OFF during read!
-#define GAS_ADC_SAMPLES 40           // Number of samples to average (noise reduction)
-#define USAGE_CHECK_INTERVAL 3600000UL // Check usage every hour (in milliseconds)
+#define GAS_LEVEL_ANALOG_PIN 13      // GPIO13 (ADC2 - shared with WiFi)
+#define GAS_NVS_NAMESPACE "gastank"
+#define GAS_SAVE_INTERVAL 21600000UL // Save the profile at most every 6 hours (flash wear)
 
 class GasTank {
 private:
-  //properties
-  long gasRemaining;
-  int lastLevel = -1;
-  unsigned long lastLevelTime = 0;
-  float dailyPercentUsed = 0; // Hourly percent used (weighted average)
-  unsigned long lastDayCheck = 0; // Last hourly check time
-  
-  // Baseline calibration approach
-  float baseline = 0.0;       // Force (grams) when new full bottle is installed
-  bool bottlePresent = false; // Track if bottle is currently installed
-  
+  PropaneGauge gauge;
+  PropaneForecast forecast;
+  Preferences prefs;
+
+  // Reading from when the current bottle went on, for calibrateFull()
+  bool haveSwapReading = false;
+  float swapAdc = 0;
+  float swapTempC = 0;
+  unsigned long lastSaveTime = 0;
+  bool profileDirty = false;
+
   // Cached sensor values
   int gasLevel = 0;
   float gasDaysRem = 0;
+  float gasDaysLow = 0;
+  float gasDaysHigh = 0;
   float gasVoltage = 0;  // Last ADC voltage reading
-  
-  int readADC(); // Helper to read averaged ADC value
-  float linearizeADC(int adc); // Linearize FSR using conductance method
-   
+
+  void load();
+  void saveCalibration();
+  void saveProfile();
+  void handleEvents(int events);
+  void updateLevel(int hour);
+
 public:
    //members
-  void readGasLevel(); // Reads sensor and updates cached gasLevel
-  void updateUsage(); // Updates hourly usage based on current level and time since last update
-  void updateDaysRemaining(); // Calculates time remaining based on given usage and updates cached gasDaysRem
-  
+  void begin(); // Loads calibration and profile from NVS
+  void poll(ESP32Time* rtc); // Call every loop: takes a sample when one is due
+  bool calibrateFull(); // A full bottle is on (since the last swap)
+  bool addCalibrationPoint(float grams); // The bottle on now holds this much propane
+  void clearCalibration(); // Back to the default curve
+  void printCalibration();
+  bool handleCommand(const String& line); // "gascal ..." from serial; false if not ours
+
   // Getters for cached values
   int getGasLevel() const { return gasLevel; }
   float getGasDaysRemaining() const { return gasDaysRem; }
+  float getGasDaysLow() const { return gasDaysLow; }
+  float getGasDaysHigh() const { return gasDaysHigh; }
   float getGasVoltage() const { return gasVoltage; }
+  float getGasGrams() const { return forecast.getLevelGrams(); }
+  bool isBurning() const { return forecast.isBurning(); }
+  float getBurnRate() const { return forecast.getBurnRate(); }   // g/h
+  float getDutyCycle() const { return forecast.getDutyCycle(); }
 };
 
 #endif
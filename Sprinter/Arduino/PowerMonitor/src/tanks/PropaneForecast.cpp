@@ -0,0 +1,297 @@
+#include "PropaneForecast.h"
+#include <math.h>
+#include <string.h>
+
+#define MS_PER_HOUR 3600000.0
+
+PropaneForecast::PropaneForecast() {
+    resetProfile();
+}
+
+void PropaneForecast::resetProfile() {
+    memset(&prof, 0, sizeof(prof));
+    prof.version = GAS_PROFILE_VERSION;
+}
+
+bool PropaneForecast::setProfile(const GasProfile& profile) {
+    if (profile.version != GAS_PROFILE_VERSION) return false;
+    if (profile.days < 0 || profile.bookedHours < 0 || profile.bookedGrams < 0) return false;
+    prof = profile;
+    return true;
+}
+
+float PropaneForecast::getAverageRate() const {
+    return prof.bookedHours > 0 ? prof.bookedGrams / prof.bookedHours : 0;
+}
+
+// ============================================================================
+// READINGS
+// ============================================================================
+
+// Forget the window and the hour in progress (bottle moved, device was off)
+void PropaneForecast::restart() {
+    windowCount = 0;
+    windowHead = 0;
+    burning = false;
+    hourBurnSeen = false;
+    pending = false;
+    boundaryValid = false;
+}
+
+// Readings from before don't compare with readings after
+void PropaneForecast::recalibrated() {
+    restart();
+    haveLast = false;
+    candidate = false;
+}
+
+int PropaneForecast::moved(float grams) {
+    int events;
+    if (grams < 0) {
+        events = removed ? 0 : GAS_EVENT_REMOVED;
+        if (!removed) removedFrom = levelGrams;
+        removed = true;
+    } else if (removed && fabs(grams - removedFrom) < GAS_RESEAT_FRACTION * GAS_BOTTLE_GRAMS) {
+        events = GAS_EVENT_RESEATED;
+        removed = false;
+    } else {
+        events = GAS_EVENT_SWAP;
+        removed = false;
+    }
+    restart();
+    return events;
+}
+
+// Least squares over the window, the line evaluated at atMs
+bool PropaneForecast::fit(unsigned long atMs, float* level, float* fitSlope, float* se) const {
+    if (windowCount < 3) return false;
+
+    double sumX = 0, sumY = 0;
+    for (int i = 0; i < windowCount; i++) {
+        sumX += ((long)(windowMs[i] - atMs)) / MS_PER_HOUR;
+        sumY += windowGrams[i];
+    }
+    double meanX = sumX / windowCount;
+    double meanY = sumY / windowCount;
+    double sxx = 0, sxy = 0;
+    for (int i = 0; i < windowCount; i++) {
+        double dx = ((long)(windowMs[i] - atMs)) / MS_PER_HOUR - meanX;
+        sxx += dx * dx;
+        sxy += dx * (windowGrams[i] - meanY);
+    }
+    if (sxx <= 0) return false;
+
+    double b = sxy / sxx;
+    double a = meanY - b * meanX;
+    double sse = 0;
+    for (int i = 0; i < windowCount; i++) {
+        double r = windowGrams[i] - (a + b * ((long)(windowMs[i] - atMs)) / MS_PER_HOUR);
+        sse += r * r;
+    }
+    *level = a;
+    *fitSlope = b;
+    *se = sqrt(sse / (windowCount - 2) / sxx);
+    return true;
+}
+
+int PropaneForecast::addReading(unsigned long ms, float grams, int hour) {
+    int events = 0;
+
+    if (haveLast && ms - lastMs > GAS_GAP_MS) restart();
+
+    // A big step: hold it until the next reading says whether the bottle moved
+    if (haveLast && fabs(grams - lastGrams) > GAS_SWAP_GRAMS) {
+        if (!candidate || fabs(grams - candidateGrams) > GAS_SWAP_GRAMS / 3) {
+            candidate = true;
+            candidateGrams = grams;
+            return events;
+        }
+        events |= moved(grams);
+    }
+    candidate = false;
+
+    float hours = haveLast ? (ms - lastMs) / MS_PER_HOUR : 0;
+    haveLast = true;
+    lastMs = ms;
+    lastGrams = grams;
+
+    if (removed) {
+        measuredGrams = levelGrams = grams;
+        slope = 0;
+        currentHour = hour;
+        return events;
+    }
+
+    // Window
+    windowMs[windowHead] = ms;
+    windowGrams[windowHead] = grams;
+    windowHead = (windowHead + 1) % GAS_WINDOW;
+    if (windowCount < GAS_WINDOW) windowCount++;
+
+    // Burning?
+    float se;
+    if (fit(ms, &measuredGrams, &slope, &se)) {
+        if (windowCount >= GAS_WINDOW / 2) {
+            float start = fmax(GAS_BURN_MIN_RATE, GAS_BURN_SIGMA * se);
+            float end = fmax(GAS_BURN_MIN_RATE / 2, GAS_BURN_END_SIGMA * se);
+            if (!burning && slope < -start) {
+                // The slope turned about half a window ago
+                burning = true;
+                unsigned long oldest = windowMs[windowCount < GAS_WINDOW ? 0 : windowHead];
+                burnStartMs = ms - (ms - oldest) / 2;
+            } else if (burning && slope > -end) {
+                burning = false;
+            }
+        }
+    } else {
+        measuredGrams = grams;
+        slope = 0;
+    }
+
+    if (burning) {
+        hourBurnSeen = true;
+        burnRate = burnRate > 0 ? burnRate * 0.9 - slope * 0.1 : -slope;
+    }
+    float alpha = fmin(hours / 24.0, 1.0);
+    dutyCycle += ((burning ? 1.0 : 0.0) - dutyCycle) * alpha;
+
+    // Hour boundary: book it once half a window has come in after it
+    if (currentHour >= 0 && hour != currentHour) {
+        events |= GAS_EVENT_BOUNDARY;
+        pending = true;
+        pendingHour = currentHour;
+        pendingMs = ms;
+        pendingReadings = GAS_WINDOW / 2;
+        pendingBurnSeen = hourBurnSeen;
+        hourBurnSeen = burning;
+    }
+    currentHour = hour;
+
+    if (pending) {
+        // A burn detected now that started before the boundary belongs to that hour too
+        if (burning && (long)(burnStartMs - pendingMs) <= 0) pendingBurnSeen = true;
+
+        if (--pendingReadings <= 0) {
+            float level, fitSlope, fitSe;
+            if (!fit(pendingMs, &level, &fitSlope, &fitSe)) level = measuredGrams;
+            if (boundaryValid) {
+                float drop = boundaryGrams - level;
+                book(pendingHour, pendingBurnSeen && drop > 0 ? drop : 0);
+                lastBookedIdle = !pendingBurnSeen;
+                events |= GAS_EVENT_BOOKED;
+
+                // Carry the level by what was booked, back to the reading if they've parted
+                bookedLevel -= lastBooked;
+                if (fabs(bookedLevel - level) > GAS_RESYNC_GRAMS) bookedLevel = level;
+            } else {
+                bookedLevel = level;
+            }
+            boundaryGrams = level;
+            boundaryValid = true;
+            pending = false;
+        }
+    }
+
+    // Level: booked at the last boundary, less anything burnt since
+    if (boundaryValid) {
+        bool burnt = hourBurnSeen || (pending && pendingBurnSeen);
+        levelGrams = bookedLevel - (burnt ? fmax(boundaryGrams - measuredGrams, 0) : 0);
+    } else {
+        levelGrams = measuredGrams;
+    }
+
+    return events;
+}
+
+// ============================================================================
+// PROFILE
+// ============================================================================
+
+static void ewma(float* mean, float* var, float x, bool first) {
+    if (first) {
+        *mean = x;
+        *var = 0;
+        return;
+    }
+    float diff = x - *mean;
+    float incr = GAS_PROFILE_ALPHA * diff;
+    *mean += incr;
+    *var = (1 - GAS_PROFILE_ALPHA) * (*var + diff * incr);
+}
+
+void PropaneForecast::book(int hour, float grams) {
+    lastBooked = grams;
+
+    ewma(&prof.hourMean[hour], &prof.hourVar[hour], grams, prof.hourDays[hour] == 0);
+    if (prof.hourDays[hour] < 255) prof.hourDays[hour]++;
+
+    // Two weeks of history for hours the profile hasn't seen
+    prof.bookedGrams += grams;
+    prof.bookedHours += 1;
+    if (prof.bookedHours > 24 * 14) {
+        float scale = 24 * 14 / prof.bookedHours;
+        prof.bookedGrams *= scale;
+        prof.bookedHours *= scale;
+    }
+
+    // Day totals, midnight to midnight, if most of the day was seen
+    todayGrams += grams;
+    todayHours++;
+    if (hour == 23) {
+        if (todayHours >= GAS_DAY_MIN_HOURS) {
+            float total = todayGrams * 24 / todayHours;
+            ewma(&prof.dayMean, &prof.dayVar, total, prof.days == 0);
+            prof.days++;
+        }
+        todayGrams = 0;
+        todayHours = 0;
+    }
+}
+
+// ============================================================================
+// FORECAST
+// ============================================================================
+
+// Hours of the profile (times scale) it takes to burn grams, from the middle
+// of this hour
+float PropaneForecast::walk(float grams, int hour, float scale) const {
+    float average = getAverageRate();
+    float hours = 0;
+    float fraction = 0.5;
+    for (int step = 0; step < GAS_HORIZON_DAYS * 24; step++) {
+        float rate = (prof.hourDays[hour] > 0 ? prof.hourMean[hour] : average) * scale;
+        float use = rate * fraction;
+        if (use >= grams) return hours + fraction * grams / use;
+        grams -= use;
+        hours += fraction;
+        fraction = 1;
+        hour = (hour + 1) % 24;
+    }
+    return GAS_HORIZON_DAYS * 24;
+}
+
+float PropaneForecast::daysRemaining(float grams, int hour, float* low, float* high) const {
+    if (low) *low = 0;
+    if (high) *high = 0;
+    if (removed || grams <= 0 || hour < 0 || hour > 23) return 0;
+    if (prof.bookedHours < 24 || getAverageRate() <= 0) return 0;   // not a day of history yet
+
+    float days = walk(grams, hour, 1.0) / 24;
+
+    // Relative uncertainty of what's used over that many days: the spread of
+    // daily totals (shrunk toward GAS_DAY_CV until there are days to go on),
+    // averaging out over the run, plus how well the mean is known
+    float spread = GAS_BAND_Z * GAS_DAY_CV;
+    if (prof.days > 0 && prof.dayMean > 0) {
+        float prior = GAS_DAY_CV * prof.dayMean;
+        float var = (prof.days * prof.dayVar + GAS_DAY_PRIOR_DAYS * prior * prior) / (prof.days + GAS_DAY_PRIOR_DAYS);
+        float runDays = fmax(days, 1.0);
+        spread = GAS_BAND_Z * sqrt(var / runDays + var / (prof.days + GAS_DAY_PRIOR_DAYS)) / prof.dayMean;
+    }
+
+    // Plus the level's own error, and an hour either side for the profile's resolution
+    float levelError = GAS_BAND_Z * GAS_LEVEL_SD;
+    if (low) *low = fmax(walk(grams - levelError, hour, 1 + spread) - 1, 0) / 24;
+    if (high) *high = spread < 0.9 ? fmin(walk(grams + levelError, hour, 1 - spread) + 1, GAS_HORIZON_DAYS * 24) / 24 : GAS_HORIZON_DAYS;
+    return days;
+}
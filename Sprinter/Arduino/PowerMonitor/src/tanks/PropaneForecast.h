@@ -0,0 +1,162 @@
+#ifndef PROPANEFORECAST_H
+#define PROPANEFORECAST_H
+
+/*
+ * PropaneForecast - Propane readings to consumption and days remaining
+ *
+ * BURN DETECTION:
+ * - Least-squares slope over the last GAS_WINDOW readings (5 minutes)
+ * - A burner is on when the level falls faster than GAS_BURN_MIN_RATE and
+ *   faster than the fit can explain by noise (GAS_BURN_SIGMA standard errors)
+ * - Stops with hysteresis, so a simmering stove doesn't flicker on and off
+ *
+ * HOURLY BOOKING:
+ * - At each RTC hour the level is fitted across the boundary (half a window
+ *   either side, so booked GAS_WINDOW/2 readings late)
+ * - The hour's drop is booked only if a burner was seen in it; an idle hour
+ *   books 0, so noise, temperature drift and sensor creep aren't mistaken
+ *   for use (the old EWMA took every positive wiggle as consumption)
+ * - The level shown is carried the same way: what was booked comes off it,
+ *   idle hours leave it alone.  An FSR creeps for hours under a new bottle;
+ *   this keeps that out of the level until the two part by GAS_RESYNC_GRAMS.
+ *
+ * PROFILE (persisted by GasTank):
+ * - Grams per hour for each hour of the day, EWMA across days, so the
+ *   forecast knows dinner and the evening heater are still to come
+ * - Daily totals (mean and variance) for the confidence band
+ *
+ * FORECAST:
+ * - Walks forward hour by hour through the profile until the bottle is empty
+ * - The band scales the profile by the uncertainty of the total over that
+ *   many days: day-to-day spread (averaging out over a longer run) plus how
+ *   well the mean is known from the days seen so far, and allows for the
+ *   level being off by a little and for the profile's hour resolution
+ *
+ * BOTTLE EVENTS:
+ * - A step of more than GAS_SWAP_GRAMS that the next reading agrees with
+ *   (a single one is a bump, and is dropped)
+ * - Down to below empty: bottle removed
+ * - Up: a new bottle, unless it's back within 10% of where it was
+ *   (reseated, e.g. checked and put back)
+ */
+
+#include <stdint.h>
+#include "PropaneGauge.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+#define GAS_WINDOW 30                // readings in the slope fit (5 minutes)
+#define GAS_BURN_MIN_RATE 40.0       // g/h, slowest burn that counts (pilot-less heater on low)
+#define GAS_BURN_SIGMA 4.0           // standard errors of slope to start a burn
+#define GAS_BURN_END_SIGMA 2.0       // ...and to end one
+#define GAS_SWAP_GRAMS 150.0         // step between readings that means the bottle moved
+#define GAS_RESEAT_FRACTION 0.1      // back within this much of the old level: same bottle
+#define GAS_GAP_MS 7200000UL         // readings further apart than this (device off): start over
+#define GAS_RESYNC_GRAMS 45.0        // booked level this far from the reading: take the reading
+
+#define GAS_PROFILE_VERSION 1
+#define GAS_PROFILE_ALPHA 0.15       // weight of the newest day in the profile (about a week's memory)
+#define GAS_DAY_MIN_HOURS 20         // booked hours for a day's total to count
+#define GAS_BAND_Z 1.28              // 80% band
+#define GAS_DAY_CV 0.4               // day-to-day spread assumed before there's history
+#define GAS_DAY_PRIOR_DAYS 3         // ...worth this many days of it
+#define GAS_LEVEL_SD 10.0            // g, error in the level (tare of each bottle, creep)
+#define GAS_HORIZON_DAYS 30          // forecast no further than this
+
+// addReading() events
+#define GAS_EVENT_BOUNDARY 0x01      // an hour ended
+#define GAS_EVENT_BOOKED 0x02        // an hour's use was booked (profile changed)
+#define GAS_EVENT_REMOVED 0x04
+#define GAS_EVENT_SWAP 0x08
+#define GAS_EVENT_RESEATED 0x10
+
+// What's persisted
+struct GasProfile {
+  uint32_t version;
+  float hourMean[24];                // g/h
+  float hourVar[24];
+  uint8_t hourDays[24];              // days seen, saturating
+  float dayMean;                     // g/day
+  float dayVar;
+  int32_t days;
+  float bookedGrams;                 // all booked use, decayed, for hours not seen yet
+  float bookedHours;
+};
+
+class PropaneForecast {
+public:
+  PropaneForecast();
+
+  void resetProfile();
+  bool setProfile(const GasProfile& profile);   // false if blank/corrupt
+  const GasProfile& getProfile() const { return prof; }
+
+  // A reading from PropaneGauge; hour is the local hour (0-23).  Returns GAS_EVENT_* flags
+  int addReading(unsigned long ms, float grams, int hour);
+  void recalibrated();               // the gauge's curve moved: start the level over
+
+  // State
+  float getLevelGrams() const { return levelGrams; }     // carried by what was booked
+  float getMeasuredGrams() const { return measuredGrams; }   // smoothed reading
+  bool isBurning() const { return burning; }
+  bool isRemoved() const { return removed; }
+  float getSlope() const { return slope; }               // g/h, negative while burning
+  float getBurnRate() const { return burnRate; }         // g/h while burning, smoothed
+  float getDutyCycle() const { return dutyCycle; }       // fraction of the last day burning
+  float getBookedGrams() const { return lastBooked; }    // the last hour booked
+  bool wasLastHourIdle() const { return lastBookedIdle; }
+  float getAverageRate() const;                          // g/h over everything booked
+
+  // Days until empty from grams at this hour, with the band; 0 if there's no history yet
+  float daysRemaining(float grams, int hour, float* low = 0, float* high = 0) const;
+
+private:
+  GasProfile prof;
+
+  // Window for the slope fit
+  unsigned long windowMs[GAS_WINDOW];
+  float windowGrams[GAS_WINDOW];
+  int windowCount = 0;
+  int windowHead = 0;
+  unsigned long lastMs = 0;
+  bool haveLast = false;
+  float lastGrams = 0;               // last reading accepted
+  bool candidate = false;            // a step waiting for the next reading to agree
+  float candidateGrams = 0;
+
+  // Outputs
+  float levelGrams = 0;
+  float measuredGrams = 0;
+  float slope = 0;
+  bool burning = false;
+  unsigned long burnStartMs = 0;
+  float burnRate = 0;
+  float dutyCycle = 0;
+  bool removed = false;
+  float removedFrom = 0;
+
+  // Booking
+  int currentHour = -1;
+  bool hourBurnSeen = false;
+  bool boundaryValid = false;
+  float boundaryGrams = 0;           // reading at the last boundary
+  float bookedLevel = 0;             // level at the last boundary
+  bool pending = false;
+  int pendingHour = 0;
+  int pendingReadings = 0;
+  unsigned long pendingMs = 0;       // when the hour ended
+  bool pendingBurnSeen = false;
+  float lastBooked = 0;
+  bool lastBookedIdle = false;
+  float todayGrams = 0;
+  int todayHours = 0;
+
+  void restart();
+  int moved(float grams);
+  bool fit(unsigned long atMs, float* level, float* fitSlope, float* se) const;
+  void book(int hour, float grams);
+  float walk(float grams, int hour, float scale) const;
+};
+
+#endif
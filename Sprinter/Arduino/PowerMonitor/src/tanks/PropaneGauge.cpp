@@ -0,0 +1,251 @@
+#include "PropaneGauge.h"
+#include <math.h>
+#include <string.h>
+
+// ============================================================================
+// CALIBRATION
+// ============================================================================
+
+PropaneGauge::PropaneGauge() {
+    resetCalibration();
+}
+
+// The old two-point mapping, nothing learned
+void PropaneGauge::resetCalibration() {
+    memset(&cal, 0, sizeof(cal));
+    cal.version = GAS_CAL_VERSION;
+    cal.count = 2;
+    cal.adc[0] = GAS_ADC_EMPTY;
+    cal.grams[0] = 0;
+    cal.adc[1] = GAS_ADC_FULL;
+    cal.grams[1] = GAS_BOTTLE_GRAMS;
+    cal.calTempC = GAS_CAL_TEMP;
+    cal.capacityGrams = GAS_BOTTLE_GRAMS;
+}
+
+bool PropaneGauge::setCalibration(const GasCalibration& calibration) {
+    if (calibration.version != GAS_CAL_VERSION) return false;
+    if (calibration.count < 1 || calibration.count > GAS_CAL_POINTS) return false;
+    if (!(calibration.capacityGrams > 0)) return false;
+    for (int i = 1; i < calibration.count; i++) {
+        if (calibration.adc[i] <= calibration.adc[i-1] || calibration.grams[i] <= calibration.grams[i-1]) return false;
+    }
+    cal = calibration;
+    return true;
+}
+
+// Learned from idle hours, pulled toward 0 until there's enough swing to trust
+float PropaneGauge::getTempCoef() const {
+    float coef = cal.tempSumXY / (cal.tempSumXX + GAS_TEMP_PRIOR);
+    if (coef > GAS_TEMP_COEF_MAX) coef = GAS_TEMP_COEF_MAX;
+    if (coef < -GAS_TEMP_COEF_MAX) coef = -GAS_TEMP_COEF_MAX;
+    return coef;
+}
+
+// ADC as it would read at the calibration temperature
+float PropaneGauge::compensate(float adc, float tempC) const {
+    return adc - getTempCoef() * (tempC - cal.calTempC);
+}
+
+// Piecewise linear through the points, extended past the ends so a removed
+// bottle reads well below empty
+float PropaneGauge::toGrams(float adc, float tempC) const {
+    float c = compensate(adc, tempC);
+    if (cal.count == 1) {
+        // One point: slope of the default curve through it
+        return cal.grams[0] + (c - cal.adc[0]) * GAS_BOTTLE_GRAMS / (GAS_ADC_FULL - GAS_ADC_EMPTY);
+    }
+
+    int i = 1;
+    while (i < cal.count - 1 && c > cal.adc[i]) i++;
+    float slope = (cal.grams[i] - cal.grams[i-1]) / (cal.adc[i] - cal.adc[i-1]);
+    return cal.grams[i-1] + (c - cal.adc[i-1]) * slope;
+}
+
+// The point at the last reading's weight.  Replaces a point close to it, and
+// drops any that would make the curve run backwards.
+bool PropaneGauge::addCalibrationPoint(float grams) {
+    if (!hasReading() || grams < 0) return false;
+    float c = compensate(lastAdc, lastTempC);
+
+    float closeGrams = cal.capacityGrams * 0.05;
+    int kept = 0;
+    for (int i = 0; i < cal.count; i++) {
+        bool close = fabs(cal.grams[i] - grams) < closeGrams;
+        bool backwards = (cal.grams[i] < grams) != (cal.adc[i] < c);
+        if (close || backwards) continue;
+        cal.adc[kept] = cal.adc[i];
+        cal.grams[kept] = cal.grams[i];
+        kept++;
+    }
+
+    // Full: lose the point nearest the new one
+    if (kept == GAS_CAL_POINTS) {
+        int nearest = 0;
+        for (int i = 1; i < kept; i++) {
+            if (fabs(cal.grams[i] - grams) < fabs(cal.grams[nearest] - grams)) nearest = i;
+        }
+        for (int i = nearest; i < kept - 1; i++) {
+            cal.adc[i] = cal.adc[i+1];
+            cal.grams[i] = cal.grams[i+1];
+        }
+        kept--;
+    }
+
+    // Insert in order
+    int at = kept;
+    while (at > 0 && cal.grams[at-1] > grams) {
+        cal.adc[at] = cal.adc[at-1];
+        cal.grams[at] = cal.grams[at-1];
+        at--;
+    }
+    cal.adc[at] = c;
+    cal.grams[at] = grams;
+    cal.count = kept + 1;
+    return true;
+}
+
+// Shift the curve so this reading is a full bottle.  Takes up the tare of
+// the bottle and whatever the sensor has drifted since it was calibrated.
+bool PropaneGauge::calibrateFull(float adc, float tempC) {
+    if (!(adc > 0)) return false;
+
+    // Reference the curve to then, so the learned coefficient starts from there
+    float coef = getTempCoef();
+    for (int i = 0; i < cal.count; i++) cal.adc[i] += coef * (tempC - cal.calTempC);
+    cal.calTempC = tempC;
+
+    // ADC the curve gives for a full bottle
+    float fullAdc;
+    if (cal.count == 1) {
+        fullAdc = cal.adc[0] + (cal.capacityGrams - cal.grams[0]) * (GAS_ADC_FULL - GAS_ADC_EMPTY) / GAS_BOTTLE_GRAMS;
+    } else {
+        int i = 1;
+        while (i < cal.count - 1 && cal.capacityGrams > cal.grams[i]) i++;
+        float slope = (cal.adc[i] - cal.adc[i-1]) / (cal.grams[i] - cal.grams[i-1]);
+        fullAdc = cal.adc[i-1] + (cal.capacityGrams - cal.grams[i-1]) * slope;
+    }
+
+    float shift = adc - fullAdc;
+    for (int i = 0; i < cal.count; i++) cal.adc[i] += shift;
+    if (hasReading()) lastGrams = toGrams(lastAdc, lastTempC);
+    return true;
+}
+
+bool PropaneGauge::calibrateFull() {
+    return hasReading() && calibrateFull(lastAdc, lastTempC);
+}
+
+// ============================================================================
+// ACQUISITION
+// ============================================================================
+
+bool PropaneGauge::wantsSample(unsigned long ms) {
+    if (!acquiring) {
+        if (readings + dropped > 0 && (long)(ms - nextReadingMs) < 0) return false;
+        acquiring = true;
+        attempts = 0;
+        valid = 0;
+        nextReadingMs = ms + GAS_READING_MS;
+        return true;
+    }
+    return ms - lastSampleMs >= GAS_SAMPLE_MS;
+}
+
+bool PropaneGauge::addSample(unsigned long ms, int adc) {
+    if (!acquiring) return false;
+    lastSampleMs = ms;
+
+    // analogRead() gives 0 when the read fails
+    if (adc > 0) samples[valid++] = adc;
+    if (++attempts < GAS_OVERSAMPLE) return false;
+
+    acquiring = false;
+    if (valid < GAS_MIN_VALID) {
+        dropped++;
+        return false;
+    }
+
+    // Trimmed mean (insertion sort, it's 64 ints)
+    for (int i = 1; i < valid; i++) {
+        int v = samples[i];
+        int j = i;
+        while (j > 0 && samples[j-1] > v) {
+            samples[j] = samples[j-1];
+            j--;
+        }
+        samples[j] = v;
+    }
+    int trim = GAS_TRIM * valid / GAS_OVERSAMPLE;
+    long sum = 0;
+    for (int i = trim; i < valid - trim; i++) sum += samples[i];
+    lastAdc = (float)sum / (valid - 2 * trim);
+    finishReading();
+    return true;
+}
+
+void PropaneGauge::addReading(float adc) {
+    lastAdc = adc;
+    finishReading();
+}
+
+void PropaneGauge::finishReading() {
+    if (readings == 0) laggedTempC = currentTempC;
+    else laggedTempC += (currentTempC - laggedTempC) * GAS_READING_MS / GAS_TEMP_TAU_MS;
+    lastTempC = laggedTempC;
+    lastGrams = toGrams(lastAdc, lastTempC);
+    readings++;
+
+    recentAdc[recentHead] = lastAdc;
+    recentTemp[recentHead] = lastTempC;
+    recentHead = (recentHead + 1) % GAS_SMOOTH_READINGS;
+    if (recentCount < GAS_SMOOTH_READINGS) recentCount++;
+}
+
+// ============================================================================
+// TEMPERATURE LEARNING
+// ============================================================================
+
+void PropaneGauge::markBoundary() {
+    if (recentCount < GAS_SMOOTH_READINGS / 2) {
+        clearBoundaries();
+        return;
+    }
+
+    float adc = 0, temp = 0;
+    for (int i = 0; i < recentCount; i++) {
+        adc += recentAdc[i];
+        temp += recentTemp[i];
+    }
+    olderAdc = newerAdc;
+    olderTemp = newerTemp;
+    olderValid = newerValid;
+    newerAdc = adc / recentCount;
+    newerTemp = temp / recentCount;
+    newerValid = true;
+}
+
+// With no propane burnt, what the ADC did it did because of the temperature.
+// Least squares through the origin, forgetting the oldest swings.
+void PropaneGauge::learnHour(bool idle) {
+    if (!idle || !olderValid || !newerValid) return;
+
+    float dT = newerTemp - olderTemp;
+    float dA = newerAdc - olderAdc;
+    if (fabs(dT) < 0.5) return;     // no swing, nothing to learn
+
+    cal.tempSumXY += dA * dT;
+    cal.tempSumXX += dT * dT;
+    if (cal.tempSumXX > GAS_TEMP_MEMORY) {
+        float scale = GAS_TEMP_MEMORY / cal.tempSumXX;
+        cal.tempSumXY *= scale;
+        cal.tempSumXX *= scale;
+    }
+}
+
+void PropaneGauge::clearBoundaries() {
+    olderValid = false;
+    newerValid = false;
+    recentCount = 0;
+    recentHead = 0;
+}
@@ -0,0 +1,136 @@
+#ifndef PROPANEGAUGE_H
+#define PROPANEGAUGE_H
+
+/*
+ * PropaneGauge - ADC samples to grams of propane in the bottle
+ *
+ * ACQUISITION (non-blocking):
+ * - Every GAS_READING_MS a reading starts: GAS_OVERSAMPLE samples, one
+ *   every GAS_SAMPLE_MS, taken as the main loop comes round (no delay())
+ * - Failed reads (0, e.g. ADC2 busy with the WiFi radio) are dropped
+ * - The rest are sorted and GAS_TRIM trimmed off each end (spikes), then
+ *   averaged.  64 samples give ~3 extra bits over a single read.
+ *
+ * CALIBRATION:
+ * - Up to GAS_CAL_POINTS (ADC, grams) points, linear between them, so the
+ *   FSR's curve (or a load cell's) can be followed instead of assuming a
+ *   straight line between empty and full
+ * - The default is the old two-point mapping (ADC 1779 empty, 2349 full)
+ * - "Full bottle" shifts the whole curve so a reading is a full bottle,
+ *   absorbing bottle-to-bottle tare and sensor drift.  GasTank uses the
+ *   reading from when the bottle went on, so it can be done any time after
+ * - Stored in NVS by GasTank
+ *
+ * TEMPERATURE COMPENSATION:
+ * - ADC is corrected by tempCoef counts per degree from the temperature the
+ *   points were taken at
+ * - The temperature is the ESP32's own sensor, lagged (GAS_TEMP_TAU_MS) for
+ *   the FSR sitting under a steel bottle taking a while to follow
+ * - tempCoef is learned: across an hour with no burner on the propane
+ *   didn't change, so any change in the ADC came with the temperature
+ *   (GasTank feeds those hours in from PropaneForecast)
+ */
+
+#include <stdint.h>
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+#define GAS_OVERSAMPLE 64            // samples per reading
+#define GAS_SAMPLE_MS 5              // between samples (one reading spans ~1/3 s)
+#define GAS_READING_MS 10000UL       // between readings
+#define GAS_TRIM 8                   // dropped from each end of the sorted samples
+#define GAS_MIN_VALID 32             // fewer good samples than this: no reading
+
+#define GAS_CAL_POINTS 8
+#define GAS_CAL_VERSION 1
+#define GAS_BOTTLE_GRAMS 454.0       // propane in a full 1 lb bottle
+#define GAS_ADC_EMPTY (1400+379)     // default curve; 379 is extra plumbing on tank
+#define GAS_ADC_FULL  (1970+379)
+#define GAS_CAL_TEMP 20.0            // temperature the default curve is taken at
+
+#define GAS_TEMP_TAU_MS 1800000.0    // FSR's lag behind the chip temperature (30 min)
+#define GAS_SMOOTH_READINGS 12       // readings averaged for the hourly snapshots (~2 min)
+#define GAS_TEMP_PRIOR 25.0          // degC^2 of idle swings before the learned coefficient counts fully
+#define GAS_TEMP_MEMORY 2000.0       // degC^2 of idle swings remembered (a couple of weeks)
+#define GAS_TEMP_COEF_MAX 20.0       // ADC counts per degC, sanity limit
+
+// What's persisted
+struct GasCalibration {
+  uint32_t version;
+  int32_t count;                     // points in use
+  float adc[GAS_CAL_POINTS];         // at calTempC, ascending
+  float grams[GAS_CAL_POINTS];       // propane, ascending
+  float calTempC;
+  float capacityGrams;               // a full bottle
+  float tempSumXY;                   // idle hours: sum of dADC x dT
+  float tempSumXX;                   //             sum of dT^2
+};
+
+class PropaneGauge {
+public:
+  PropaneGauge();
+
+  // Calibration
+  void resetCalibration();
+  bool setCalibration(const GasCalibration& calibration);   // false if blank/corrupt
+  const GasCalibration& getCalibration() const { return cal; }
+  bool addCalibrationPoint(float grams);    // at the last reading
+  bool calibrateFull();                     // a full bottle is on the sensor now
+  bool calibrateFull(float adc, float tempC);   // ...was, when it read this
+  float getTempCoef() const;                // ADC counts per degC
+
+  // Acquisition
+  void setTemperature(float tempC) { currentTempC = tempC; }
+  bool wantsSample(unsigned long ms);       // time to analogRead()?
+  bool addSample(unsigned long ms, int adc);   // true when a reading completed
+  void addReading(float adc);               // an already-averaged reading (replays)
+
+  // Last reading
+  bool hasReading() const { return readings > 0; }
+  float getAdc() const { return lastAdc; }          // raw, oversampled
+  float getTempC() const { return lastTempC; }     // lagged
+  float getGrams() const { return lastGrams; }
+  float toGrams(float adc, float tempC) const;
+  long getReadings() const { return readings; }
+  long getDroppedReadings() const { return dropped; }
+
+  // Temperature learning, at hour boundaries
+  void markBoundary();                      // snapshot the smoothed ADC and temperature
+  void learnHour(bool idle);                // the hour between the last two snapshots
+  void clearBoundaries();                   // after a bottle swap
+
+private:
+  GasCalibration cal;
+
+  // Acquisition
+  bool acquiring = false;
+  unsigned long nextReadingMs = 0;
+  unsigned long lastSampleMs = 0;
+  int attempts = 0;
+  int valid = 0;
+  int samples[GAS_OVERSAMPLE];
+  float currentTempC = GAS_CAL_TEMP;
+  float laggedTempC = GAS_CAL_TEMP;
+
+  // Output
+  long readings = 0;
+  long dropped = 0;
+  float lastAdc = 0;
+  float lastTempC = GAS_CAL_TEMP;
+  float lastGrams = 0;
+
+  // Recent readings for the snapshots
+  float recentAdc[GAS_SMOOTH_READINGS];
+  float recentTemp[GAS_SMOOTH_READINGS];
+  int recentCount = 0;
+  int recentHead = 0;
+  bool olderValid = false;
+  bool newerValid = false;
+  float olderAdc, olderTemp, newerAdc, newerTemp;
+
+  void finishReading();
+  float compensate(float adc, float tempC) const;
+};
+
+#endif
@@ -0,0 +1,594 @@
+//
+// Host replay for the propane gauge (PropaneGauge, PropaneForecast).
+//
+// -synth runs a van for some days: a stove for meals and a heater on cold
+// evenings burning 1 lb bottles, a bottle swapped when one runs out, and
+// an FSR under it with the real part's faults: conductance (not ADC)
+// linear in force, a temperature coefficient, creep after each swap, ADC
+// noise, failed (0) reads and spikes.  The readings go through the new
+// gauge and forecaster and through the old GasTank code (two-point linear
+// map, 40-sample average, hourly EWMA of positive drops), and both are
+// scored against the truth: level, use, burn detection and days remaining,
+// over a few seeds (-runs) so one lucky week doesn't decide it.  -w writes
+// the first run's readings as a trace.
+//
+// -t replays a recorded trace: the serial monitor output of either the old
+// ("Gas Tank Level 57 (ADC 2103)") or new firmware, optionally with the
+// IDE's "12:34:56.789 -> " timestamps, or CSV "ms,adc[,tempC]".  It prints
+// the hours booked, the bottle events and the forecast.  Hours are counted
+// from midnight at the first reading unless the lines have the time.
+//
+// Build and run (from PowerMonitor/):
+//   g++ -std=c++11 -O2 -o GasReplay test/GasReplay.cpp src/tanks/PropaneGauge.cpp src/tanks/PropaneForecast.cpp
+//   ./GasReplay -synth [-seed n] [-runs n] [-days n] [-w trace.csv]
+//   ./GasReplay -t trace.txt [-p seconds]   # -p: reading period if the lines have no times
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../src/tanks/PropaneGauge.h"
+#include "../src/tanks/PropaneForecast.h"
+
+// ============================================================================
+// RANDOM (own generator, so a seed gives the same run everywhere)
+// ============================================================================
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static double uniform() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (rngState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian() {
+    double u1 = uniform(), u2 = uniform();
+    if (u1 < 1e-12) u1 = 1e-12;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// ============================================================================
+// THE SENSOR
+// ============================================================================
+// FSR C10 to 10k: conductance linear in force, Vout = 3.3 x/(1+x), x = R/Rfsr.
+// With an empty bottle and the plumbing (~500 g) this reads the old
+// GAS_ADC_EMPTY, and a full one GAS_ADC_FULL.
+#define FSR_G0 0.0133          // mS
+#define FSR_G_PER_GRAM 1.27e-4 // mS/g
+#define FSR_TEMPCO 0.004       // conductance per degC
+#define FSR_CREEP 0.03         // conductance gained settling under a new load
+#define FSR_CREEP_HOURS 6.0
+#define NOMINAL_TARE 500.0
+#define ADC_NOISE 12.0
+#define ADC_ZERO_RATE 0.02
+#define ADC_SPIKE_RATE 0.01
+
+static double fsrAdc(double force, double sensorTempC, double creep) {
+    double g = (FSR_G0 + FSR_G_PER_GRAM * force) * (1 + FSR_TEMPCO * (sensorTempC - 20)) * (1 + creep);
+    double x = 10 * g;
+    return 4095 * x / (1 + x);
+}
+
+static int sampleAdc(double adc) {
+    if (uniform() < ADC_ZERO_RATE) return 0;
+    double v = adc + ADC_NOISE * gaussian();
+    if (uniform() < ADC_SPIKE_RATE) v += (uniform() < 0.5 ? -1 : 1) * 300;
+    if (v < 0) v = 0;
+    if (v > 4095) v = 4095;
+    return (int)v;
+}
+
+// ============================================================================
+// THE VAN
+// ============================================================================
+struct Burn {
+    double start;     // seconds
+    double end;
+    double rate;      // g/h
+    bool heater;
+};
+
+struct World {
+    double t = 0;
+    double mass = GAS_BOTTLE_GRAMS;
+    double tare = NOMINAL_TARE;
+    double loadedAt = 0;         // creep starts
+    double removedUntil = -1;    // bottle off the sensor
+    double interior = 18, sensor = 18;
+    double dayOffset = 0;
+    int bottle = 0;
+    std::vector<Burn> burns;
+    std::vector<double> emptyAt; // by bottle
+};
+
+static void planDay(World& w, int day) {
+    double base = day * 86400.0;
+    w.dayOffset = 3 * gaussian();
+    w.burns.clear();
+    w.burns.push_back({ base + 7 * 3600 + uniform() * 2400, 0, 180, false });
+    w.burns.back().end = w.burns.back().start + 480 + uniform() * 420;
+    if (uniform() < 0.3) {
+        w.burns.push_back({ base + 12.5 * 3600 + uniform() * 1800, 0, 180, false });
+        w.burns.back().end = w.burns.back().start + 600 + uniform() * 600;
+    }
+    w.burns.push_back({ base + 18 * 3600 + uniform() * 3600, 0, 180, false });
+    w.burns.back().end = w.burns.back().start + 900 + uniform() * 900;
+    if (w.dayOffset < 0 ? uniform() < 0.6 : uniform() < 0.15) {
+        w.burns.push_back({ base + 20 * 3600 + uniform() * 1800, 0, 80, true });
+        w.burns.back().end = w.burns.back().start + 2700 + uniform() * 4500;
+    }
+}
+
+// Advance dt seconds; returns the burn rate (g/h)
+static double stepWorld(World& w, double dt) {
+    w.t += dt;
+    double hour = fmod(w.t / 3600, 24);
+    double outdoor = 8 + w.dayOffset + 7 * sin(2 * M_PI * (hour - 9) / 24);
+
+    double rate = 0;
+    bool heater = false;
+    if (w.removedUntil < 0) {
+        for (const Burn& b : w.burns) {
+            if (w.t >= b.start && w.t < b.end) {
+                rate += b.rate;
+                heater |= b.heater;
+            }
+        }
+    }
+
+    double target = outdoor + 6 + (heater ? 8 : 0) + (rate > 0 && !heater ? 2 : 0);
+    w.interior += (target - w.interior) * dt / 1800;
+    w.sensor += (w.interior - w.sensor) * dt / 1800;
+
+    // Empty: off with it, a full one on a minute later
+    w.mass -= rate * dt / 3600;
+    if (w.mass <= 0 && w.removedUntil < 0) {
+        w.mass = 0;
+        w.emptyAt.push_back(w.t);
+        w.removedUntil = w.t + 60;
+    }
+    if (w.removedUntil >= 0 && w.t >= w.removedUntil) {
+        w.removedUntil = -1;
+        w.bottle++;
+        w.mass = GAS_BOTTLE_GRAMS + 5 * gaussian();
+        w.tare = NOMINAL_TARE + 10 * gaussian();
+        w.loadedAt = w.t;
+    }
+    return w.removedUntil >= 0 ? 0 : rate;
+}
+
+static double trueAdc(const World& w) {
+    if (w.removedUntil >= 0) return fsrAdc(0, w.sensor, 0);
+    double creep = FSR_CREEP * (1 - exp(-(w.t - w.loadedAt) / 3600 / FSR_CREEP_HOURS));
+    return fsrAdc(w.tare + w.mass, w.sensor, creep);
+}
+
+static float chipTemp(const World& w) {
+    return w.interior + 10 + 0.3 * gaussian();
+}
+
+// ============================================================================
+// THE OLD GASTANK (for comparison)
+// ============================================================================
+struct OldGasTank {
+    int gasLevel = 0;
+    int lastLevel = -1;
+    double lastDayCheck = 0;
+    float dailyPercentUsed = 0;
+    float gasDaysRem = 0;
+
+    void read(double adc, double t) {
+        long sum = 0;
+        int valid = 0;
+        for (int i = 0; i < 40; i++) {
+            int r = sampleAdc(adc);
+            if (r > 0) {
+                sum += r;
+                valid++;
+            }
+        }
+        int raw = valid > 0 ? sum / valid : 0;
+        float percentage = ((float)(raw - GAS_ADC_EMPTY) / (float)(GAS_ADC_FULL - GAS_ADC_EMPTY)) * 100.0;
+        if (percentage > 100) percentage = 100;
+        if (percentage < 0) percentage = 0;
+        gasLevel = (int)percentage;
+
+        // updateUsage()
+        if (lastLevel == -1) {
+            if (gasLevel > 0) {
+                lastLevel = gasLevel;
+                lastDayCheck = t;
+            }
+        } else if (t - lastDayCheck >= 3600) {
+            int change = lastLevel - gasLevel;
+            if (change > 0) dailyPercentUsed = dailyPercentUsed == 0 ? change : dailyPercentUsed * 0.7 + change * 0.3;
+            lastLevel = gasLevel;
+            lastDayCheck = t;
+        }
+
+        // updateDaysRemaining()
+        if (gasLevel < 5) gasDaysRem = 0;
+        else if (dailyPercentUsed > 0) gasDaysRem = gasLevel / (dailyPercentUsed * 24);
+        else gasDaysRem = 0;
+    }
+};
+
+// ============================================================================
+// SCORING
+// ============================================================================
+// 1 if it failed, so the score can add them up
+static int check(bool ok, const char* what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    return ok ? 0 : 1;
+}
+
+static double median(std::vector<double> v) {
+    if (v.empty()) return NAN;
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+struct Forecast {
+    double t;
+    int bottle;
+    float days, low, high, oldDays;
+};
+
+// One reading's worth of samples through the gauge, as poll() would
+static bool takeReading(PropaneGauge& gauge, unsigned long ms, double adc) {
+    for (int i = 0; i < GAS_OVERSAMPLE * 2; i++, ms += GAS_SAMPLE_MS) {
+        if (gauge.wantsSample(ms) && gauge.addSample(ms, sampleAdc(adc))) return true;
+    }
+    return false;
+}
+
+// Weigh partly used bottles on the kitchen scale and put them on the sensor
+static void commission(PropaneGauge& gauge, World& w) {
+    const double points[] = { 0, 113, 227, 340, GAS_BOTTLE_GRAMS };
+    for (double grams : points) {
+        double adc = fsrAdc(NOMINAL_TARE + grams, w.sensor, 0);
+        for (int i = 0; i < 12; i++) {
+            double sum = 0;
+            int valid = 0;
+            for (int j = 0; j < GAS_OVERSAMPLE; j++) {
+                int sample = sampleAdc(adc);
+                if (sample > 0) {
+                    sum += sample;
+                    valid++;
+                }
+            }
+            gauge.addReading(sum / valid);
+        }
+        gauge.addCalibrationPoint(grams);
+    }
+    gauge.clearBoundaries();
+}
+
+// What every run adds up to
+struct Score {
+    double levelSqNew = 0, levelSqOld = 0;
+    long levelCount = 0;
+    long idleReadings = 0, falseBurn = 0;
+    int burnsSeen = 0, burnsCaught = 0;
+    double trueUse = 0, bookedUse = 0;
+    int bottles = 0;
+    std::vector<double> errNew, errOld;
+    int covered = 0, scored = 0;
+    double worstCoefError = 0;
+};
+
+// What the FSR really does per degree at half a bottle
+static double trueTempCoef() {
+    return fsrAdc(NOMINAL_TARE + GAS_BOTTLE_GRAMS / 2, 21, 0) - fsrAdc(NOMINAL_TARE + GAS_BOTTLE_GRAMS / 2, 20, 0);
+}
+
+static bool runSynth(unsigned long seed, int days, const char* writePath, Score& score) {
+    rngState = 0x9E3779B97F4A7C15ULL ^ (seed * 0x2545F4914F6CDD1DULL);
+    for (int i = 0; i < 10; i++) uniform();
+
+    World w;
+    PropaneGauge gauge;
+    PropaneForecast forecast;
+    OldGasTank old;
+    FILE* trace = writePath ? fopen(writePath, "w") : NULL;
+    if (writePath && !trace) {
+        perror(writePath);
+        return false;
+    }
+
+    gauge.setTemperature(chipTemp(w));
+    commission(gauge, w);
+
+    double fullAt = 0;
+    int lastBottle = 0;
+    bool tared = false;
+    float swapAdc = 0, swapTempC = 0;
+    double bookedUse = 0, trueUse = 0;
+    std::vector<Forecast> forecasts;
+    std::vector<bool> caught;
+    int plannedDay = -1;
+
+    const double dt = GAS_READING_MS / 1000.0;
+    const long steps = (long)(days * 86400 / dt);
+    for (long step = 0; step < steps; step++) {
+        int day = (int)(w.t / 86400);
+        if (day != plannedDay) {
+            planDay(w, day);
+            caught.assign(w.burns.size(), false);
+            plannedDay = day;
+        }
+        double rate = stepWorld(w, dt);
+        trueUse += rate * dt / 3600;
+
+        // New: a reading every GAS_READING_MS
+        unsigned long ms = (unsigned long)(w.t * 1000);
+        int hour = (int)(w.t / 3600) % 24;
+        gauge.setTemperature(chipTemp(w));
+        if (!takeReading(gauge, ms, trueAdc(w))) continue;
+        if (trace) fprintf(trace, "%lu,%.1f,%.1f\n", ms, gauge.getAdc(), gauge.getTempC());
+
+        int events = forecast.addReading(ms, gauge.getGrams(), hour);
+        if (events & GAS_EVENT_BOUNDARY) gauge.markBoundary();
+        if (events & GAS_EVENT_BOOKED) {
+            gauge.learnHour(forecast.wasLastHourIdle());
+            bookedUse += forecast.getBookedGrams();
+        }
+        if (events & (GAS_EVENT_SWAP | GAS_EVENT_REMOVED)) gauge.clearBoundaries();
+        if (events & GAS_EVENT_SWAP) {
+            swapAdc = gauge.getAdc();
+            swapTempC = gauge.getTempC();
+        }
+
+        // The driver long-presses the gas bar a few minutes after fitting a
+        // bottle; GasTank takes that as "the bottle was full when it went on"
+        if (w.bottle != lastBottle) {
+            lastBottle = w.bottle;
+            fullAt = w.t + 180;
+            tared = false;
+        }
+        if (!tared && w.bottle > 0 && w.t >= fullAt) {
+            gauge.calibrateFull(swapAdc, swapTempC);
+            forecast.recalibrated();
+            tared = true;
+        }
+
+        // Old: every TANK_CHECK_TIME
+        if (step % 6 == 0) old.read(trueAdc(w), w.t);
+
+        // Level, settled readings only
+        bool settled = w.removedUntil < 0 && w.t - w.loadedAt > 600;
+        if (settled && step % 6 == 0) {
+            double level = std::min(std::max((double)forecast.getLevelGrams(), 0.0), (double)GAS_BOTTLE_GRAMS);
+            score.levelSqNew += (level - w.mass) * (level - w.mass);
+            double oldLevel = old.gasLevel * GAS_BOTTLE_GRAMS / 100;
+            score.levelSqOld += (oldLevel - w.mass) * (oldLevel - w.mass);
+            score.levelCount++;
+        }
+
+        // Burns: each one caught, and no burning flagged well away from one
+        bool nearBurn = false;
+        for (size_t i = 0; i < w.burns.size(); i++) {
+            const Burn& b = w.burns[i];
+            if (w.t >= b.start && w.t < b.end + 60 && forecast.isBurning()) caught[i] = true;
+            if (w.t >= b.start - 300 && w.t < b.end + 300) nearBurn = true;
+            if (w.t >= b.end && w.t < b.end + dt && w.bottle == lastBottle && b.end - b.start >= 480) {
+                score.burnsSeen++;
+                if (caught[i]) score.burnsCaught++;
+            }
+        }
+        if (settled && !nearBurn) {
+            score.idleReadings++;
+            if (forecast.isBurning()) score.falseBurn++;
+        }
+
+        // Forecast every hour after the first few days
+        if (fmod(w.t, 3600) < dt / 2 && w.t > 3 * 86400 && w.removedUntil < 0) {
+            Forecast f;
+            f.t = w.t;
+            f.bottle = w.bottle;
+            f.days = forecast.daysRemaining(forecast.getLevelGrams(), hour, &f.low, &f.high);
+            f.oldDays = old.gasDaysRem;
+            forecasts.push_back(f);
+        }
+    }
+    if (trace) fclose(trace);
+
+    // Days remaining against when each bottle really ran out
+    std::vector<double> errNew, errOld;
+    int covered = 0;
+    for (const Forecast& f : forecasts) {
+        if (f.bottle >= (int)w.emptyAt.size()) continue;   // still going at the end
+        double truth = (w.emptyAt[f.bottle] - f.t) / 86400;
+        score.scored++;
+        if (f.days > 0) {
+            errNew.push_back(fabs(f.days - truth));
+            if (truth >= f.low && truth <= f.high) covered++;
+        }
+        if (f.oldDays > 0) errOld.push_back(fabs(f.oldDays - truth));
+    }
+
+    printf("seed %lu: %d bottles, %.0fg burnt, %.0fg booked, %.0f g/day profile, %.2f ADC/C learned, days error old %.2f new %.2f, band %.0f%%\n",
+           seed, (int)w.emptyAt.size(), trueUse, bookedUse, forecast.getProfile().dayMean, gauge.getTempCoef(),
+           median(errOld), median(errNew), 100.0 * covered / std::max((size_t)1, errNew.size()));
+
+    score.trueUse += trueUse;
+    score.bookedUse += bookedUse;
+    score.bottles += w.emptyAt.size();
+    score.errNew.insert(score.errNew.end(), errNew.begin(), errNew.end());
+    score.errOld.insert(score.errOld.end(), errOld.begin(), errOld.end());
+    score.covered += covered;
+    score.worstCoefError = std::max(score.worstCoefError, fabs(gauge.getTempCoef() - trueTempCoef()));
+    return true;
+}
+
+static int scoreSynth(unsigned long seed, int runs, int days, const char* writePath) {
+    int failures = 0;
+    Score score;
+    for (int run = 0; run < runs; run++) {
+        if (!runSynth(seed + run, days, run == 0 ? writePath : NULL, score)) return 1;
+    }
+
+    double rmsNew = sqrt(score.levelSqNew / std::max(score.levelCount, 1L));
+    double rmsOld = sqrt(score.levelSqOld / std::max(score.levelCount, 1L));
+    double falseFraction = (double)score.falseBurn / std::max(score.idleReadings, 1L);
+    double coverage = (double)score.covered / std::max((size_t)1, score.errNew.size());
+    double trueCoef = trueTempCoef();
+
+    printf("%d runs of %d days, %d bottles emptied, %.0fg burnt, %.0fg booked\n", runs, days, score.bottles, score.trueUse, score.bookedUse);
+    printf("Level RMS: old %.1fg, new %.1fg\n", rmsOld, rmsNew);
+    printf("Burns caught %d/%d, false burning %.2f%% of idle time\n", score.burnsCaught, score.burnsSeen, falseFraction * 100);
+    printf("Temperature: FSR %.2f ADC/C, learned within %.2f\n", trueCoef, score.worstCoefError);
+    printf("Days remaining (%d hours scored): old median error %.2f (answered %d), new %.2f (answered %d), band coverage %.0f%%\n",
+           score.scored, median(score.errOld), (int)score.errOld.size(), median(score.errNew), (int)score.errNew.size(), coverage * 100);
+
+    failures += check(rmsNew < rmsOld / 2, "level at least twice as close as the two-point map");
+    failures += check(fabs(score.bookedUse - score.trueUse) < 0.15 * score.trueUse, "booked use within 15% of what was burnt (swaps lose a part hour)");
+    failures += check(score.burnsSeen > 0 && score.burnsCaught >= 0.9 * score.burnsSeen, "burns of 8 minutes or more caught");
+    failures += check(falseFraction < 0.01, "burning flagged under 1% of idle time");
+    failures += check(score.worstCoefError < 0.25 * trueCoef, "temperature coefficient learned within 25%");
+    failures += check(!score.errNew.empty() && median(score.errNew) < median(score.errOld), "days remaining closer than the old EWMA");
+    failures += check(coverage >= 0.75, "band holds the truth at least 75% of the time");
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
+
+// ============================================================================
+// TRACES
+// ============================================================================
+
+// The old firmware read the tank every TANK_CHECK_TIME
+#define OLD_READING_MS 60000UL
+
+// One reading from a line of serial monitor or CSV; false if it isn't one
+static bool parseLine(const char* line, unsigned long* ms, bool* haveMs, float* adc, float* tempC, bool* haveTemp) {
+    *haveMs = false;
+    *haveTemp = false;
+
+    // Serial monitor timestamp "12:34:56.789 -> "
+    int h, m, s, frac;
+    if (sscanf(line, "%d:%d:%d.%d ->", &h, &m, &s, &frac) == 4) {
+        *ms = ((h * 60UL + m) * 60UL + s) * 1000UL + frac;
+        *haveMs = true;
+    }
+
+    const char* adcText = strstr(line, "(ADC ");
+    if (adcText) {
+        if (sscanf(adcText, "(ADC %f, %fC", adc, tempC) == 2) *haveTemp = true;
+        else if (sscanf(adcText, "(ADC %f", adc) != 1) return false;
+        return true;
+    }
+
+    unsigned long csvMs;
+    float csvAdc, csvTemp;
+    int n = sscanf(line, "%lu,%f,%f", &csvMs, &csvAdc, &csvTemp);
+    if (n >= 2) {
+        *ms = csvMs;
+        *haveMs = true;
+        *adc = csvAdc;
+        if (n == 3) {
+            *tempC = csvTemp;
+            *haveTemp = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+static int runTrace(const char* path, unsigned long periodMs) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    PropaneGauge gauge;
+    PropaneForecast forecast;
+    char line[256];
+    unsigned long ms = 0, firstMs = 0, dayMs = 0, lastStamp = 0;
+    long readings = 0;
+    bool started = false;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lineMs;
+        bool haveMs, haveTemp;
+        float adc, tempC;
+        if (!parseLine(line, &lineMs, &haveMs, &adc, &tempC, &haveTemp)) continue;
+
+        // Serial monitor times wrap at midnight; without any, assume the reading
+        // period (-p, or whichever firmware wrote the line)
+        if (haveMs) {
+            if (started && lineMs + dayMs < lastStamp) dayMs += 86400000UL;
+            ms = lineMs + dayMs;
+            lastStamp = ms;
+        } else if (started) {
+            ms += periodMs ? periodMs : haveTemp ? GAS_READING_MS : OLD_READING_MS;
+        }
+        if (!started) firstMs = ms;
+        started = true;
+
+        if (haveTemp) gauge.setTemperature(tempC);
+        gauge.addReading(adc);
+        readings++;
+
+        int hour = (int)((ms / 3600000UL) % 24);
+        int events = forecast.addReading(ms, gauge.getGrams(), hour);
+        if (events & GAS_EVENT_BOUNDARY) gauge.markBoundary();
+        if (events & GAS_EVENT_BOOKED) {
+            gauge.learnHour(forecast.wasLastHourIdle());
+            printf("%6.2fh  hour %02d booked %5.1fg%s  level %5.1fg  duty %4.1f%%\n", (ms - firstMs) / 3600000.0,
+                   (hour + 23) % 24, forecast.getBookedGrams(), forecast.wasLastHourIdle() ? " (idle)" : "",
+                   forecast.getLevelGrams(), forecast.getDutyCycle() * 100);
+        }
+        if (events & (GAS_EVENT_SWAP | GAS_EVENT_REMOVED)) gauge.clearBoundaries();
+        if (events & GAS_EVENT_REMOVED) printf("%6.2fh  bottle removed\n", (ms - firstMs) / 3600000.0);
+        if (events & GAS_EVENT_RESEATED) printf("%6.2fh  bottle reseated\n", (ms - firstMs) / 3600000.0);
+        if (events & GAS_EVENT_SWAP) printf("%6.2fh  new bottle, %.0fg\n", (ms - firstMs) / 3600000.0, gauge.getGrams());
+    }
+    fclose(f);
+
+    if (readings == 0) {
+        printf("No readings in %s\n", path);
+        return 1;
+    }
+
+    float low, high;
+    int hour = (int)((ms / 3600000UL) % 24);
+    float days = forecast.daysRemaining(forecast.getLevelGrams(), hour, &low, &high);
+    printf("%ld readings over %.1f hours (%ld dropped by the gauge)\n", readings, (ms - firstMs) / 3600000.0, gauge.getDroppedReadings());
+    printf("Level %.0fg, temperature coefficient %.2f ADC/C, average %.1f g/h\n",
+           forecast.getLevelGrams(), gauge.getTempCoef(), forecast.getAverageRate());
+    if (days > 0) printf("Days remaining %.1f (%.1f-%.1f)\n", days, low, high);
+    else printf("Days remaining -- (not a day of use yet)\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    unsigned long seed = 1;
+    int runs = 5;
+    int days = 14;
+    const char* tracePath = NULL;
+    const char* writePath = NULL;
+    unsigned long periodMs = 0;
+    bool synth = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-synth") == 0) synth = true;
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-days") == 0 && i + 1 < argc) days = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) tracePath = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) writePath = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) periodMs = strtoul(argv[++i], NULL, 10) * 1000;
+        else {
+            printf("usage: GasReplay -synth [-seed n] [-runs n] [-days n] [-w trace.csv] | -t trace [-p seconds]\n");
+            return 2;
+        }
+    }
+
+    if (tracePath && !synth) return runTrace(tracePath, periodMs);
+    return scoreSynth(seed, runs, days, writePath);
+}
@@ -15,7 +15,6 @@
 
 #include "src/ui/FormHelpers.h"
 #include "src/ui/PrimaryForm.h"
-#include "src/ui/SummaryForm.h"
 #include "src/ui/Forms.h"
 
 //
@@ -61,7 +60,7 @@ unsigned long turnOffTime;
 
 //timing
 #define LCD_REFRESH_RATE 5000
-#define SUMMARY_REFRESH_RATE 1000
+#define FORM_SLICE_US 4000        //how long each loop may spend writing text form fields to the display
 #define SHUTDOWN_STARTUP_RATE 1000 //how often we check ignition
 #define CHECK_START_VALUES 60000 //how often we check if we need to update start state
 #define CAN_VERIFY_TIMEOUT 5000    //How long we'll wait for something from the CAN controller before showing error screen
@@ -98,7 +97,6 @@ bool currentIgnState=false;
 bool currentIdlingState=false;
 unsigned long idlingStartSeconds=0;   //seconds when mph went to zero
 unsigned long nextLCDRefresh=0;
-unsigned long nextSummaryRefresh=0;
 unsigned long nextIgnRefresh=0;
 unsigned long nextIdlingRefresh=0;
 unsigned long nextUpdateStartValues=0;
@@ -116,14 +114,21 @@ TripData fullTrip=TripData(&currentData,&propBag,1);
 //Forms
 FormNavigator formNavigator;
 PrimaryForm primaryForm = PrimaryForm(&genie,PRIMARY_FORM,"Main Screen",&sinceLastStop,&currentData);
-SummaryForm sinceLastStopSummaryForm = SummaryForm(&genie,SUMMARY_FORM,"Since Stopped",&sinceLastStop);
-SummaryForm currentSegmentSummaryForm = SummaryForm(&genie,SUMMARY_FORM,"Current Segment",&currentSegment);
-SummaryForm fullTripSummaryForm = SummaryForm(&genie,SUMMARY_FORM,"Full Trip",&fullTrip);
-StartingForm startForm = StartingForm(&genie,STARTING_FORM,&fullTrip,1000);
-StoppedForm stopForm = StoppedForm(&genie,STOPPED_FORM,&sinceLastStop,1000);
 StatusForm statusForm = StatusForm(&genie,STATUS_FORM,600);
 BootForm bootForm = BootForm(&genie,BOOT_FORM);
 
+//Text forms are tables of fields (src/ui/FormTables.cpp), kept up to date by one scheduler
+GenieFieldSink genieFieldSink = GenieFieldSink(&genie);
+FormScheduler formScheduler = FormScheduler(&genieFieldSink,micros);
+TripFieldSource sinceLastStopFields = TripFieldSource(&sinceLastStop);
+TripFieldSource currentSegmentFields = TripFieldSource(&currentSegment);
+TripFieldSource fullTripFields = TripFieldSource(&fullTrip);
+FieldForm sinceLastStopSummaryForm = FieldForm(SUMMARY_FORM,summaryFields,summaryFieldCount,&sinceLastStopFields,"Since Stopped");
+FieldForm currentSegmentSummaryForm = FieldForm(SUMMARY_FORM,summaryFields,summaryFieldCount,&currentSegmentFields,"Current Segment");
+FieldForm fullTripSummaryForm = FieldForm(SUMMARY_FORM,summaryFields,summaryFieldCount,&fullTripFields,"Full Trip");
+FieldForm startForm = FieldForm(STARTING_FORM,startingFields,startingFieldCount,&fullTripFields);
+FieldForm stopForm = FieldForm(STOPPED_FORM,stoppedFields,stoppedFieldCount,&sinceLastStopFields);
+
 //Serial coms
 byte serialBuffer[20];
 int currentComIdx=0;
@@ -173,7 +178,7 @@ void setup()
   wifi.startServer();  
 
   //This is how we get notified when a button is pressed
-  formNavigator.init(&genie);
+  formNavigator.init(&genie,&formScheduler);
   genie.AttachEventHandler(myGenieEventHandler); // Attach the user functiotion Event Handler for processing events  
 
   //calibrate and setup sensors
@@ -200,9 +205,10 @@ void setup()
   //Initialize elevation API for barometric altitude auto-calibration.
   elevationAPI.init();
 
-  //Load property bag from EEPROM
-  logger.log(INFO,"Loading prop data from EEPROM");
-  bootForm.updateDisplay("Loading data from EEPROM...",formNavigator.getActiveForm());
+  //Load property bag from the journal (EEPROM on the first boot with one)
+  logger.log(INFO,"Loading prop data");
+  bootForm.updateDisplay("Loading saved data...",formNavigator.getActiveForm());
+  propBag.init();
   propBag.loadPropBag();
   propBag.loadGpsPosition();
 
@@ -213,8 +219,18 @@ void setup()
     logger.log(INFO,"Seeded GPS with last known position: %f,%f",(double)propBag.lastLat,(double)propBag.lastLon);
   }
 
-  //Initialize or load data from EEPROM for each of the trip bucket objects
-  logger.log(INFO,"Loading trip data from EEPROM");
+  //Fuel flow calibration.  The first time, start from the old instant MPG factor.
+  propBag.loadFuelCalibration();
+  if(!currentData.getFuelModel().setCalibration(propBag.fuelCalibration))
+  {
+    FuelCalibration seed={};
+    seed.factor=1.0/propBag.data.instMPGFactor;
+    if(!currentData.getFuelModel().setCalibration(seed))
+      logger.log(WARNING,"Inst MPG factor %f out of range.  Fuel model starts from its default.",propBag.data.instMPGFactor);
+  }
+
+  //Initialize or load saved data for each of the trip bucket objects
+  logger.log(INFO,"Loading trip data");
   currentSegment.loadTripData(propBag.getPropDataSize());
   fullTrip.loadTripData(propBag.getPropDataSize());
 
@@ -429,6 +445,7 @@ void loop()
   {
     float lat = gpsModule.getLatitude();
     float lon = gpsModule.getLongitude();
+    currentData.updateGPS(lat, lon, gpsModule.getGPSAltitudeMeters(), gpsModule.getSpeedKnots(), gpsModule.getSatellites());
     float elev = currentData.currentElevation;
     float spd = currentData.currentSpeed;
 
@@ -483,15 +500,18 @@ void loop()
           propBag.savePropBag();
         }
       }
+    }
 
-      int rawBaro = currentData.getRawBaroElevation();
-      if(elevationAPI.update(lat, lon, rawBaro))
-      {
-        int newOffset = elevationAPI.getElevationOffset();
-        currentData.setBaroElevationOffset(newOffset);
-        propBag.data.elevationOffset = newOffset;
-        propBag.savePropBag();
-      }
+    // Calibrate from cached DEM tiles when offline; prefetch tiles ahead while online
+    int rawBaro = currentData.getRawBaroElevation();
+    float course = gpsModule.getSpeedKnots() > 3 ? gpsModule.getCourse() : -1;
+    if(elevationAPI.update(lat, lon, rawBaro, wifi.isConnected(), course))
+    {
+      int newOffset = elevationAPI.getElevationOffset();
+      currentData.setBaroElevationOffset(newOffset);
+      currentData.addReferenceElevation(elevationAPI.getLastAPIElevation());
+      propBag.data.elevationOffset = newOffset;
+      propBag.savePropBag();
     }
   }
 
@@ -506,20 +526,21 @@ void loop()
     currentSegment.updateElevation();
     fullTrip.updateElevation();    
 
+    //Update engine fuel
+    sinceLastStop.updateEngineFuel();
+    currentSegment.updateEngineFuel();
+    fullTrip.updateEngineFuel();
+
     //Update display for active forms only
     if(primaryForm.getFormId()==formNavigator.getActiveForm())
     {
       primaryForm.updateDisplay();  
     }     
-    if(startForm.getFormId()==formNavigator.getActiveForm())
-    {   
-      startForm.updateDisplay();
-    }  
   }
 
   //Take care of business
   updateContrast();
-  refreshSummaryDisplay();
+  updateTextForms();
   updateStartValues();
   handleIdlingAsStop();
   handleStatupAndShutdown();
@@ -629,7 +650,6 @@ void handleIdlingAsStop()
 
         //Activate stopping form
         formNavigator.activateForm(STOPPED_FORM);
-        stopForm.updateDisplay();
       }
       else
       {
@@ -671,19 +691,20 @@ void handleStatupAndShutdown()
         currentSegment.ignitionOff();
         fullTrip.ignitionOff();
 
-        //Save to EEPROM
-        logger.log(INFO,"Saving trip and prop bag data to EEPROM and activating STOPPING form");
+        //Save to the journal
+        logger.log(INFO,"Saving trip and prop bag data and activating STOPPING form");
         logger.sendLogs(wifi.isConnected());
         propBag.lastLat=gpsModule.getLatitude();
         propBag.lastLon=gpsModule.getLongitude();
         propBag.savePropBag();
         propBag.saveGpsPosition();
+        currentData.getFuelModel().getCalibration(propBag.fuelCalibration);
+        propBag.saveFuelCalibration();
         currentSegment.saveTripData(propBag.getPropDataSize());
         fullTrip.saveTripData(propBag.getPropDataSize());
 
         //Activate stopping form
         formNavigator.activateForm(STOPPED_FORM);
-        stopForm.updateDisplay();
       }
       return;
     }
@@ -800,26 +821,30 @@ void showPitotInfo()
     }
 }
 
-void updateCurrentSummaryForm()
+//Which text form is showing, if any
+FieldForm* getActiveTextForm()
 {
-  if(currentActiveSummaryData==0)
-    sinceLastStopSummaryForm.updateDisplay();
-  else if(currentActiveSummaryData==1)
-    currentSegmentSummaryForm.updateDisplay();
-  else
-    fullTripSummaryForm.updateDisplay();
+  switch(formNavigator.getActiveForm())
+  {
+    case STARTING_FORM:
+      return &startForm;
+    case STOPPED_FORM:
+      return &stopForm;
+    case SUMMARY_FORM:
+      if(currentActiveSummaryData==0)
+        return &sinceLastStopSummaryForm;
+      if(currentActiveSummaryData==1)
+        return &currentSegmentSummaryForm;
+      return &fullTripSummaryForm;
+  }
+  return NULL;
 }
 
-void refreshSummaryDisplay()
+//Write whatever changed on the showing text form, a slice of time per loop
+void updateTextForms()
 {
-  if(formNavigator.getActiveForm()!=SUMMARY_FORM)
-    return;
-
-  if(millis()<nextSummaryRefresh)
-    return;
-
-  nextSummaryRefresh=millis()+SUMMARY_REFRESH_RATE;
-  updateCurrentSummaryForm();
+  formScheduler.setForm(getActiveTextForm());
+  formScheduler.update(millis(),FORM_SLICE_US);
 }
 
 void myGenieEventHandler(void)
@@ -839,17 +864,12 @@ void myGenieEventHandler(void)
     case ACTION_ACTIVATE_SUMMARY_FORM:
       formNavigator.activateForm(SUMMARY_FORM);
       currentActiveSummaryData=0;
-      updateCurrentSummaryForm();
-      nextSummaryRefresh=millis()+SUMMARY_REFRESH_RATE;
       break;
     case ACTION_CYCLE_SUMMARY:
       logger.log(VERBOSE,"Cycling SUMMARY form");
        currentActiveSummaryData++;
       if(currentActiveSummaryData>=NUMBER_OF_SUMMARY_FORMS)
         currentActiveSummaryData=0;
-
-      updateCurrentSummaryForm();
-      nextSummaryRefresh=millis()+SUMMARY_REFRESH_RATE;
       break; 
     case ACTION_ACTIVATE_STARTING_FORM:
       formNavigator.activateForm(STARTING_FORM);
@@ -1161,15 +1181,23 @@ void handleElevationCalib()
   }
 
   String html = "<h2>Altitude Auto-Calibration</h2>";
-  html += "<p><b>API:</b> Open Topo Data (ned10m) — free, no key</p>";
+  html += "<p><b>API:</b> Open Topo Data (" ELEVATION_API_DATASET ") — free, no key</p>";
   html += "<table border='1' cellpadding='5'>";
   html += "<tr><td>Calibrated</td><td>" + String(elevationAPI.isCalibrated() ? "Yes" : "No") + "</td></tr>";
   html += "<tr><td>Current Offset</td><td>" + String(elevationAPI.getElevationOffset()) + " ft</td></tr>";
   html += "<tr><td>EEPROM Offset</td><td>" + String(propBag.data.elevationOffset) + " ft</td></tr>";
   html += "<tr><td>Last API Elevation</td><td>" + String(elevationAPI.getLastAPIElevation(), 0) + " ft</td></tr>";
-  html += "<tr><td>Current Baro (corrected)</td><td>" + String(currentData.currentElevation) + " ft</td></tr>";
+  html += "<tr><td>Current Baro (corrected)</td><td>" + String(currentData.getRawBaroElevation() + currentData.getBaroElevationOffset()) + " ft</td></tr>";
   html += "<tr><td>Current Baro (raw)</td><td>" + String(currentData.getRawBaroElevation()) + " ft</td></tr>";
+  html += "<tr><td>Fused Elevation</td><td>" + String(currentData.currentElevation) + " ft (confidence " + String(currentData.elevationConfidence, 2) + ")</td></tr>";
+  html += "<tr><td>Baro Drift Since Calibration</td><td>" + String(currentData.baroBias, 0) + " ft</td></tr>";
+  html += "<tr><td>Fused Climb Rate</td><td>" + String(currentData.currentClimbRate) + " ft/min</td></tr>";
   html += "<tr><td>Calibrations This Session</td><td>" + String(elevationAPI.getCalibrationCount()) + "</td></tr>";
+  html += "<tr><td>Last Calibration Source</td><td>" + String(elevationAPI.lastCalibFromTiles() ? "Tile cache" : "API") + "</td></tr>";
+  unsigned long tileLookups = elevationAPI.tiles.getHits() + elevationAPI.tiles.getMisses();
+  html += "<tr><td>DEM Tiles Cached</td><td>" + String(elevationAPI.tiles.getTileCount()) + " / " + String(elevationAPI.tiles.getSlotCount()) + " (" + String(elevationAPI.tiles.getEvictions()) + " evicted)</td></tr>";
+  html += "<tr><td>Tile Lookups</td><td>" + String(tileLookups) + " (" + String(tileLookups ? 100.0 * elevationAPI.tiles.getHits() / tileLookups : 0.0, 1) + "% hit)</td></tr>";
+  html += "<tr><td>Tile Prefetches Today</td><td>" + String(elevationAPI.getPrefetchesToday()) + " / " + String(PREFETCH_MAX_PER_DAY) + " (last " + String(elevationAPI.getLastFetchMs()) + " ms)</td></tr>";
 
   unsigned long lastCalib = elevationAPI.getLastCalibTime();
   if (lastCalib > 0)
@@ -1188,3 +1216,37 @@ void handleElevationCalib()
   html += "<br><a href='/elevation?recalibrate=1'>Force Recalibrate Now</a>";
   wifi.sendResponse(html);
 }
+
+// ---- HTTP handler for the fuel model ----
+
+void handleFuel()
+{
+  FuelModel &fuelModel = currentData.getFuelModel();
+  const char *segmentNames[FUEL_SEGMENTS] = {"Idle", "Cruise", "Climb"};
+  TripData *trips[] = {&sinceLastStop, &currentSegment, &fullTrip};
+  const char *tripNames[] = {"Since Last Stop", "Current Segment", "Full Trip"};
+
+  String html = "<h2>Fuel Flow Model</h2>";
+  html += "<table border='1' cellpadding='5'>";
+  html += "<tr><td>Fuel Flow</td><td>" + String(currentData.currentGallonsPerHour, 2) + " gal/h</td></tr>";
+  html += "<tr><td>Calibration</td><td>MAF x load x " + String(fuelModel.getFactor(), 3) + " + " + String(fuelModel.getIdleGallonsPerHour(), 2) + " gal/h (" + String(fuelModel.isCalibrated() ? "fitted to the tank gauge" : "default") + ")</td></tr>";
+  html += "<tr><td>Fill-ups Seen</td><td>" + String(fuelModel.getFillUps()) + "</td></tr>";
+  html += "<tr><td>Engine Runs This Session</td><td>" + String(fuelModel.getRuns()) + "</td></tr>";
+  html += "<tr><td>Tank</td><td>" + String(currentData.currentFuelPerc) + "%</td></tr>";
+  html += "</table>";
+
+  for (int t = 0; t < 3; t++)
+  {
+    html += "<h3>" + String(tripNames[t]) + "</h3>";
+    html += "<table border='1' cellpadding='5'><tr><th></th><th>Gallons</th><th>Miles</th><th>MPG</th></tr>";
+    for (int i = 0; i < FUEL_SEGMENTS; i++)
+    {
+      html += "<tr><td>" + String(segmentNames[i]) + "</td><td>" + String(trips[t]->getSegmentGallons(i), 2) + "</td><td>" +
+              String(trips[t]->getSegmentMiles(i), 1) + "</td><td>" + String(trips[t]->getSegmentMPG(i), 1) + "</td></tr>";
+    }
+    html += "<tr><td>Total</td><td>" + String(trips[t]->getFuelGallonsUsed(), 2) + "</td><td>" + String(trips[t]->getMilesTravelled()) +
+            "</td><td>" + String(trips[t]->getAvgMPG(), 1) + "</td></tr></table>";
+  }
+
+  wifi.sendResponse(html);
+}
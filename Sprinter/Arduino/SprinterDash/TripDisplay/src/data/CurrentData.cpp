@@ -144,9 +144,55 @@ bool CurrentData::verifyInterfaces(int service, int pid, int value)
 // Pass-through methods for barometer calibration.
 void CurrentData::setBaroElevationOffset(int offset)
 {
+    //Corrected readings jump by the change; tell fusion so it isn't taken as climb
+    fusion.shiftBaroBias(offset-barometer.getElevationOffset());
     barometer.setElevationOffset(offset);
 }
 
+void CurrentData::addReferenceElevation(float feet)
+{
+    fusion.addReferenceElevation(millis(),feet);
+    updateFromFusion();
+}
+
+void CurrentData::updateGPS(float lat, float lon, float altitudeMeters, float speedKnots, int satellites)
+{
+    currentLatitude=lat;
+    currentLongitude=lon;
+    currentSatellites=satellites;
+    gpsHasFix=true;
+
+    fusion.addGpsFix(millis(),altitudeMeters,speedKnots,satellites);
+    updateFromFusion();
+}
+
+// Copy the fused estimates out.  Elevation falls back to the filtered baro
+// reading until fusion has something.
+void CurrentData::updateFromFusion()
+{
+    if(fusion.hasElevation())
+    {
+        currentElevation=lround(fusion.getElevation());
+        currentClimbRate=lround(fusion.getClimbRate());
+        baroBias=fusion.getBaroBias();
+        fuelModel.setClimbRate(fusion.getClimbRate());
+    }
+    elevationConfidence=fusion.getElevationConfidence();
+
+    speedConfidence=fusion.getSpeedConfidence();
+
+    if(fusion.hasHeadwind())
+        currentHeadwind=lround(fusion.getHeadwind());
+    else
+        currentHeadwind=currentPitotSpeed-currentSpeed;
+    headwindConfidence=fusion.getHeadwindConfidence();
+}
+
+FuelModel &CurrentData::getFuelModel()
+{
+    return fuelModel;
+}
+
 int CurrentData::getRawBaroElevation()
 {
     return barometer.getRawElevation();
@@ -161,10 +207,25 @@ void CurrentData::updateDataFromSensors()
 {
   //Pitot is sampled on its own timer so wind speed is not gated by CAN speed PID timing.
   currentPitotSpeed=pitot.readSpeed(currentSpeed);
+  if(pitot.getReadingCount()!=lastPitotReading)
+  {
+    lastPitotReading=pitot.getReadingCount();
+    fusion.addPitotSpeed(millis(),currentPitotSpeed);
+  }
 
     //Barometer
     barometer.update();
     currentElevation=barometer.getElevation();
+    if(barometer.getReadingCount()!=lastBaroReading)
+    {
+      //Fusion does its own outlier gating, so give it every corrected reading
+      lastBaroReading=barometer.getReadingCount();
+      fusion.addBaroElevation(millis(),barometer.getRawElevation()+barometer.getElevationOffset());
+    }
+
+    //Fused elevation, climb and headwind
+    fusion.advance(millis());
+    updateFromFusion();
 
     //RTC
     currentSeconds=rtc.getSecondsSinc2000();
@@ -183,6 +244,8 @@ void CurrentData::updateDataFromPIDs(int service,int pid,int value)
     if(service==load.service && pid==load.pid)
     {
         currentLoad=value;
+        fuelModel.addLoad(millis(),value);
+        currentGallonsPerHour=fuelModel.getGallonsPerHour();
         return;
     }
     //distance travelled in km, converting to miles
@@ -218,6 +281,7 @@ void CurrentData::updateDataFromPIDs(int service,int pid,int value)
         {
           currentFuelPerc=value;
           currentFuelPercOnline=true;
+          fuelModel.addFuelLevel(millis(),value);
         }
         else
           logger.log(VERBOSE,"Fuel Outlier: %d   Avg: %d",value,fuelFilter.readAvg());
@@ -227,12 +291,16 @@ void CurrentData::updateDataFromPIDs(int service,int pid,int value)
     if(service==maf.service && pid==maf.pid)
     {
         currentMAF=value;
+        fuelModel.addMaf(millis(),value);
+        currentGallonsPerHour=fuelModel.getGallonsPerHour();
         return;
     }      
     //Current speed in km/h
     if(service==speed.service && pid==speed.pid)
     {
         currentSpeed=value*0.621371;
+        fusion.addObdSpeed(millis(),value*0.621371f);
+        fuelModel.addSpeed(millis(),value*0.621371f);
         return;
     } 
     //Coolant temp
@@ -273,7 +341,11 @@ void CurrentData::dumpData()
   logger.log(INFO,"   Current MAF: %d",currentMAF);
   logger.log(INFO,"   Current Speed: %d",currentSpeed);
   logger.log(INFO,"   Current Pitot Speed: %d",currentPitotSpeed);
+  logger.log(INFO,"   Fused Elevation: %d (conf %.2f, baro bias %.0f)  Climb: %d ft/min",currentElevation,elevationConfidence,baroBias,currentClimbRate);
+  logger.log(INFO,"   Fused Speed: %.1f (conf %.2f)  Headwind: %d (conf %.2f)  Outliers: %lu",fusion.getSpeed(),speedConfidence,currentHeadwind,headwindConfidence,fusion.getRejectedCount());
   logger.log(INFO,"   Current Load: %d",currentLoad);
+  logger.log(INFO,"   Fuel Flow: %.2f gal/h  (x%.3f + %.2f gal/h, %s)  Engine Gallons: %.2f",currentGallonsPerHour,
+    fuelModel.getFactor(),fuelModel.getIdleGallonsPerHour(),fuelModel.isCalibrated() ? "fitted" : "default",fuelModel.getTotalGallons());
   logger.log(INFO,"   Current Coolant Temp: %d",currentCoolantTemp);
   logger.log(INFO,"   Current Transmission Temp: %d",currentTransmissionTemp);
   logger.log(INFO,"   Current Light Level: %d",currentLightLevel);
@@ -3,6 +3,8 @@
 
 #include "../sensors/Sensors.h"
 #include "../sensors/Filter.h"
+#include "../sensors/SensorFusion.h"
+#include "FuelModel.h"
 
 struct PIDStruct{
     //Distance
@@ -41,6 +43,9 @@ class CurrentData
     void setBaroElevationOffset(int offset);  // set by ElevationAPI auto-calibration
     int  getRawBaroElevation();               // uncorrected reading for calibration
     int  getBaroElevationOffset();            // current offset
+    void addReferenceElevation(float feet);   // ElevationAPI (DEM) elevation at the current spot
+    void updateGPS(float lat, float lon, float altitudeMeters, float speedKnots, int satellites);
+    FuelModel &getFuelModel();                // engine fuel flow, integrated from MAF/load/speed
     void dumpData();
 
     //Data
@@ -53,7 +58,10 @@ class CurrentData
     int currentMAF=0;
     int currentSpeed=0;
     int currentPitotSpeed=0;
+    int currentHeadwind=0;         //pitot airspeed less fused ground speed
+    int currentClimbRate=0;        //ft/min
     int currentLoad=0;
+    float currentGallonsPerHour=0;   //calibrated fuel flow (FuelModel)
     int currentCoolantTemp=0;
     int currentTransmissionTemp=0;
     int currentBoost=0;
@@ -68,6 +76,12 @@ class CurrentData
     int   currentSatellites=0;
     bool  gpsHasFix=false;
 
+    //How far to trust the fused values (0..1, see SensorFusion)
+    float elevationConfidence=0;
+    float speedConfidence=0;
+    float headwindConfidence=0;
+    float baroBias=0;              //ft the corrected baro currently reads high
+
   private: 
     //Other sensors
     Pitot pitot;
@@ -76,6 +90,15 @@ class CurrentData
     RTC rtc;
     LDR ldr;
 
+    //Baro/GPS/OBD/pitot fusion, fed as each new reading arrives
+    SensorFusion fusion;
+
+    //Fuel flow, fed every MAF/load/speed/fuel PID
+    FuelModel fuelModel;
+    unsigned long lastBaroReading=0;
+    unsigned long lastPitotReading=0;
+    void updateFromFusion();
+
     void initConnections();
 
     //Filter for outlier values
@@ -0,0 +1,296 @@
+#include <math.h>
+#include <string.h>
+#include "FuelModel.h"
+
+FuelModel::FuelModel()
+{
+    memset(&calib,0,sizeof(calib));
+    calib.factor=FUEL_DEFAULT_FACTOR;
+    memset(&runSums,0,sizeof(runSums));
+    reset();
+}
+
+//Forget everything since boot (not the calibration)
+void FuelModel::reset()
+{
+    memset(gallons,0,sizeof(gallons));
+    memset(miles,0,sizeof(miles));
+    rawGallons=0;
+    gallonsPerHour=0;
+    running=false;
+    lastMs=0;
+    runs=0;
+    lastLevel=-1;
+    mafSeen=false;
+    loadSeen=false;
+}
+
+bool FuelModel::setCalibration(const FuelCalibration &calibration)
+{
+    //Blank flash reads back as NaN, old EEPROM as anything
+    if(!(calibration.factor>=FUEL_FACTOR_MIN && calibration.factor<=FUEL_FACTOR_MAX))
+        return false;
+    if(!(calibration.spanGallons>=0 && calibration.spanGallons<=FUEL_CALIB_MEMORY_GAL*2))
+        return false;
+    if(!(calibration.idleGph>=0 && calibration.idleGph<=FUEL_IDLE_GPH_MAX))
+        return false;
+    if(!(calibration.c11>=0 && calibration.c22>=0) || !isfinite(calibration.c11) || !isfinite(calibration.c22) ||
+       !isfinite(calibration.c12) || !isfinite(calibration.c1y) || !isfinite(calibration.c2y))
+        return false;
+
+    calib=calibration;
+    calibrated=calib.spanGallons>=FUEL_CALIB_MIN_GAL;
+    return true;
+}
+
+void FuelModel::getCalibration(FuelCalibration &calibration)
+{
+    //Fold in the run so far, so a reboot mid-drive keeps it
+    calibration=calib;
+    addRunSums(calibration);
+}
+
+void FuelModel::addMaf(unsigned long ms, float gramsPerSecond)
+{
+    integrate(ms);
+    maf=gramsPerSecond;
+    mafSeen=true;
+}
+
+void FuelModel::addLoad(unsigned long ms, float percent)
+{
+    integrate(ms);
+    load=percent;
+    loadSeen=true;
+}
+
+void FuelModel::addSpeed(unsigned long ms, float mph)
+{
+    integrate(ms);
+    speed=mph;
+}
+
+void FuelModel::setClimbRate(float feetPerMinute)
+{
+    climbRate=feetPerMinute;
+}
+
+//Another point for the fit: tank gallons against uncalibrated gallons this run
+void FuelModel::addFuelLevel(unsigned long ms, int percent)
+{
+    integrate(ms);
+
+    if(lastLevel>=0 && percent>=lastLevel+FUEL_FILLUP_PERC)
+    {
+        //New tank.  Usually the engine was off and this run just started;
+        //if not, start one so the fill doesn't land inside a run
+        if(runSums.n>0)
+            startRun(ms);
+        calib.fillUps++;
+    }
+    lastLevel=percent;
+
+    double x1=runRaw;
+    double x2=runHours;
+    double y=FUEL_TANK_SIZE*percent/100.0;
+    runSums.n++;
+    runSums.s1+=x1;
+    runSums.s2+=x2;
+    runSums.sy+=y;
+    runSums.s11+=x1*x1;
+    runSums.s12+=x1*x2;
+    runSums.s22+=x2*x2;
+    runSums.s1y+=x1*y;
+    runSums.s2y+=x2*y;
+
+    fitFactor();
+}
+
+//Book the flow since the last reading, at the values that held until now
+void FuelModel::integrate(unsigned long ms)
+{
+    if(!running || ms<lastMs || ms-lastMs>FUEL_RUN_GAP_MS)
+    {
+        startRun(ms);
+        return;
+    }
+
+    double seconds=(ms-lastMs)/1000.0;
+    if(seconds>FUEL_MAX_STEP_MS/1000.0)
+        seconds=FUEL_MAX_STEP_MS/1000.0;
+    lastMs=ms;
+
+    //No load is a closed throttle: the injectors are off
+    bool fuelling=mafSeen && loadSeen && load>0;
+    double rawPerHour=fuelling ? maf*load/FUEL_FLOW_DIVISOR : 0;
+    double perHour=fuelling ? rawPerHour*calib.factor+calib.idleGph : 0;
+    double raw=rawPerHour*seconds/3600.0;
+    int segment=classify();
+
+    rawGallons+=raw;
+    runRaw+=raw;
+    if(fuelling)
+        runHours+=seconds/3600.0;
+    gallons[segment]+=perHour*seconds/3600.0;
+    miles[segment]+=speed*seconds/3600.0;
+
+    double alpha=seconds/(FUEL_SMOOTH_SECONDS+seconds);
+    gallonsPerHour+=alpha*(perHour-gallonsPerHour);
+}
+
+void FuelModel::startRun(unsigned long ms)
+{
+    //A long gap means the engine was off: the tank may have dropped (heater)
+    //or read differently (parked on a slope) since, so new intercept
+    if(running)
+        closeRun();
+
+    running=true;
+    lastMs=ms;
+    runs++;
+    runRaw=0;
+    runHours=0;
+    memset(&runSums,0,sizeof(runSums));
+    gallonsPerHour=0;
+}
+
+//Add the current run's centred sums, if it has enough level readings to count
+void FuelModel::addRunSums(FuelCalibration &calibration)
+{
+    const FuelFitSums &r=runSums;
+    if(r.n<FUEL_RUN_MIN_LEVELS)
+        return;
+
+    calibration.c11+=r.s11-r.s1*r.s1/r.n;
+    calibration.c12+=r.s12-r.s1*r.s2/r.n;
+    calibration.c22+=r.s22-r.s2*r.s2/r.n;
+    calibration.c1y+=r.s1y-r.s1*r.sy/r.n;
+    calibration.c2y+=r.s2y-r.s2*r.sy/r.n;
+    calibration.spanGallons+=runRaw;
+}
+
+//Fold the run into the calibration
+void FuelModel::closeRun()
+{
+    addRunSums(calib);
+
+    //Forget the oldest driving beyond the memory
+    if(calib.spanGallons>FUEL_CALIB_MEMORY_GAL)
+    {
+        double scale=FUEL_CALIB_MEMORY_GAL/calib.spanGallons;
+        calib.c11*=scale;
+        calib.c12*=scale;
+        calib.c22*=scale;
+        calib.c1y*=scale;
+        calib.c2y*=scale;
+        calib.spanGallons=FUEL_CALIB_MEMORY_GAL;
+    }
+
+    memset(&runSums,0,sizeof(runSums));
+    runRaw=0;
+    runHours=0;
+}
+
+//Solve tank = intercept - factor x uncalibrated - idleGph x hours, pooled
+//over the closed runs and this one.  idleGph has a weak pull towards 0 so
+//it stays put while all the driving looks alike.
+void FuelModel::fitFactor()
+{
+    FuelCalibration fit=calib;
+    addRunSums(fit);
+    if(fit.spanGallons<FUEL_CALIB_MIN_GAL || fit.c11<=0)
+        return;
+
+    double c22=fit.c22+FUEL_IDLE_PRIOR;
+    double det=fit.c11*c22-fit.c12*fit.c12;
+    if(det<=0)
+        return;
+    double idle=-(fit.c11*fit.c2y-fit.c12*fit.c1y)/det;
+
+    //Out of range: hold idle at the limit and fit the factor alone
+    if(idle<0)
+        idle=0;
+    if(idle>FUEL_IDLE_GPH_MAX)
+        idle=FUEL_IDLE_GPH_MAX;
+    double factor=-(fit.c1y+fit.c12*idle)/fit.c11;
+    if(factor<FUEL_FACTOR_MIN || factor>FUEL_FACTOR_MAX)
+        return;
+
+    calib.factor=factor;
+    calib.idleGph=idle;
+    calibrated=true;
+}
+
+int FuelModel::classify()
+{
+    if(speed<FUEL_IDLE_MPH)
+        return FUEL_SEGMENT_IDLE;
+
+    //ft/min climbed over ft/min travelled (1 mph is 88 ft/min)
+    if(climbRate/(speed*88.0)>=FUEL_CLIMB_GRADE)
+        return FUEL_SEGMENT_CLIMB;
+    return FUEL_SEGMENT_CRUISE;
+}
+
+bool FuelModel::isOnline()
+{
+    return mafSeen && loadSeen;
+}
+
+double FuelModel::getGallons(int segment)
+{
+    return gallons[segment];
+}
+
+double FuelModel::getMiles(int segment)
+{
+    return miles[segment];
+}
+
+double FuelModel::getTotalGallons()
+{
+    double total=0;
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+        total+=gallons[i];
+    return total;
+}
+
+double FuelModel::getRawGallons()
+{
+    return rawGallons;
+}
+
+float FuelModel::getGallonsPerHour()
+{
+    return gallonsPerHour;
+}
+
+int FuelModel::getSegment()
+{
+    return classify();
+}
+
+float FuelModel::getFactor()
+{
+    return calib.factor;
+}
+
+float FuelModel::getIdleGallonsPerHour()
+{
+    return calib.idleGph;
+}
+
+bool FuelModel::isCalibrated()
+{
+    return calibrated;
+}
+
+uint32_t FuelModel::getFillUps()
+{
+    return calib.fillUps;
+}
+
+int FuelModel::getRuns()
+{
+    return runs;
+}
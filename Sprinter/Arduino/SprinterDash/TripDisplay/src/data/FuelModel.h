@@ -0,0 +1,142 @@
+#ifndef FuelModel_h
+#define FuelModel_h
+
+#include <stdint.h>
+
+//
+// Engine fuel flow from OBD, integrated at the full PID rate and calibrated
+// against the tank gauge.
+//
+// Flow:
+//   The uncalibrated flow is the same MAF x load figure the dash always used
+//   for instant MPG.  It is integrated every time MAF, load or speed arrives
+//   (a few times a second), so trip fuel no longer waits for the tank gauge
+//   to move a whole percent.  Each step is also booked to a segment (idle,
+//   cruise or climb) with the miles driven in it.
+//
+// Calibration:
+//   Calibrated flow = uncalibrated flow x factor + idleGph while fuelling.
+//   MAF x load under-reads light load (a diesel runs leaner there), and
+//   idleGph picks up what it misses.  Both come from a least-squares fit of
+//   tank gallons against uncalibrated gallons and engine hours over every
+//   fuel level reading.  Each engine run (and each tank between fill-ups)
+//   gets its own intercept, so heater use while parked, parking on a slope
+//   and fill-ups don't bias it; only how fast the tank drops while the
+//   engine runs counts.  The fit keeps about the last FUEL_CALIB_MEMORY_GAL
+//   gallons, and its sums are persisted so it keeps improving tank after
+//   tank.
+//
+
+#define FUEL_TANK_SIZE 24.5            // in gallons
+#define FUEL_ADDITIVE_RATIO .4         // oz per gallons
+
+#define FUEL_FLOW_DIVISOR 1006.777948  // MAF (g/s) x load (%) / this = uncalibrated gal/h
+#define FUEL_DEFAULT_FACTOR 0.56       // until the tank says otherwise (1/1.78, the old instMPGFactor)
+#define FUEL_FACTOR_MIN 0.2
+#define FUEL_FACTOR_MAX 3.0
+#define FUEL_IDLE_GPH_MAX 1.0          // a 3L diesel idles on ~0.3 gal/h
+#define FUEL_IDLE_PRIOR 5.0            // holds idleGph near 0 until runs vary enough to fit it (hours^2)
+
+#define FUEL_MAX_STEP_MS 5000          // hold a reading at most this long
+#define FUEL_RUN_GAP_MS 60000          // no PIDs for this long: the engine was off
+#define FUEL_SMOOTH_SECONDS 3.0        // time constant of the instant flow shown
+#define FUEL_FILLUP_PERC 10            // level jump that counts as a fill-up
+#define FUEL_CALIB_MIN_GAL 3.0         // driving behind the fit before it moves the factor
+#define FUEL_CALIB_MEMORY_GAL 100.0    // ~4 tanks
+#define FUEL_RUN_MIN_LEVELS 3          // level readings for a run to count
+
+#define FUEL_IDLE_MPH 2.0              // slower than this is idling
+#define FUEL_CLIMB_GRADE 0.02          // steeper than 2% is climbing
+
+//Where fuel is booked
+#define FUEL_SEGMENT_IDLE 0
+#define FUEL_SEGMENT_CRUISE 1
+#define FUEL_SEGMENT_CLIMB 2
+#define FUEL_SEGMENTS 3
+
+//Least-squares sums of tank gallons (y) against uncalibrated gallons (x1)
+//and engine hours (x2)
+struct FuelFitSums
+{
+    double n, s1, s2, sy, s11, s12, s22, s1y, s2y;
+};
+
+//What's persisted (PropBag, journal key JOURNAL_KEY_FUEL)
+struct FuelCalibration
+{
+    float factor;             //tank gallons per uncalibrated gallon
+    float idleGph;            //plus this per hour while fuelling
+    float spanGallons;        //uncalibrated gallons of driving behind the sums
+    uint32_t fillUps;
+    double c11, c12, c22, c1y, c2y;   //centred sums of the closed runs
+};
+
+class FuelModel
+{
+  public:
+    FuelModel();
+    void reset();
+
+    //Persistence.  setCalibration() rejects a blank or corrupt record.
+    bool setCalibration(const FuelCalibration &calibration);
+    void getCalibration(FuelCalibration &calibration);
+
+    //Inputs, as the PIDs arrive
+    void addMaf(unsigned long ms, float gramsPerSecond);
+    void addLoad(unsigned long ms, float percent);
+    void addSpeed(unsigned long ms, float mph);
+    void addFuelLevel(unsigned long ms, int percent);
+    void setClimbRate(float feetPerMinute);   //fused, for the climb segment
+
+    //Outputs.  Gallons and miles are totals since boot, calibrated as they
+    //were integrated; callers keep their own trip deltas.
+    bool   isOnline();                 //MAF and load both seen
+    double getGallons(int segment);
+    double getMiles(int segment);
+    double getTotalGallons();
+    double getRawGallons();            //uncalibrated, since boot
+    float  getGallonsPerHour();        //calibrated, smoothed
+    int    getSegment();               //what we're doing now
+
+    float  getFactor();
+    float  getIdleGallonsPerHour();
+    bool   isCalibrated();             //factor fitted from the tank, not the default
+    uint32_t getFillUps();
+    int    getRuns();                  //engine runs since boot
+
+  private:
+    //Latest PID values
+    float maf=0;
+    float load=0;
+    float speed=0;
+    float climbRate=0;
+    bool mafSeen=false;
+    bool loadSeen=false;
+
+    unsigned long lastMs=0;
+    bool running=false;
+    float gallonsPerHour=0;
+
+    double gallons[FUEL_SEGMENTS];
+    double miles[FUEL_SEGMENTS];
+    double rawGallons=0;
+
+    //Current run
+    double runRaw=0;
+    double runHours=0;
+    FuelFitSums runSums;
+    int lastLevel=-1;
+    int runs=0;
+
+    FuelCalibration calib;
+    bool calibrated=false;
+
+    void integrate(unsigned long ms);
+    void startRun(unsigned long ms);
+    void closeRun();
+    void fitFactor();
+    void addRunSums(FuelCalibration &calibration);
+    int  classify();
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include <string.h>
+#include "Journal.h"
+
+#define JOURNAL_MAGIC_0 'J'   //first byte written, never 0xFF, so a started record is never blank
+#define JOURNAL_MAGIC_1 'R'
+
+//Worst case live set must fit in a sector with room to spare, or a
+//rollover could be asked to copy forward more than it can hold
+static_assert(JOURNAL_MAX_KEYS*(JOURNAL_HEADER_SIZE+JOURNAL_MAX_PAYLOAD)*3 <= JOURNAL_SECTOR_SIZE,
+              "journal live set too big for a sector");
+
+bool Journal::begin(JournalStorage *_storage)
+{
+    storage=_storage;
+    ready=false;
+    sectors=storage->getSize()/JOURNAL_SECTOR_SIZE;
+    if(sectors<2)
+        return false;
+
+    memset(latest,0,sizeof(latest));
+    sequence=0;
+    erases=0;
+    torn=0;
+    activeSector=0;
+    writeOffset=0;
+
+    //Newest record overall marks the active sector
+    uint32_t activeTail=0;
+    for(uint32_t sector=0;sector<sectors;sector++)
+    {
+        uint32_t before=sequence;
+        uint32_t tail;
+        scanSector(sector,tail);
+        if(sequence!=before || (sector==0 && sequence==0))
+        {
+            activeSector=sector;
+            activeTail=tail;
+        }
+    }
+    writeOffset=activeTail;
+    ready=true;
+
+    //Power may have failed part way through a rollover, leaving newest
+    //records in the sector that's next to be erased
+    if(!evacuate((activeSector+1)%sectors))
+        ready=false;
+    return ready;
+}
+
+bool Journal::isReady()
+{
+    return ready;
+}
+
+bool Journal::save(uint8_t key, const void *data, uint8_t length)
+{
+    if(!ready || key>=JOURNAL_MAX_KEYS || length>JOURNAL_MAX_PAYLOAD)
+        return false;
+
+    //Unchanged?  Save the flash.
+    if(latest[key].valid && latest[key].length==length)
+    {
+        uint8_t current[JOURNAL_MAX_PAYLOAD];
+        if(storage->read(latest[key].address,current,length) && memcmp(current,data,length)==0)
+            return true;
+    }
+
+    //A failed write leaves a torn record behind it; one retry goes past it
+    if(append(key,data,length))
+        return true;
+    return append(key,data,length);
+}
+
+int Journal::load(uint8_t key, void *data, uint8_t maxLength)
+{
+    if(!ready || key>=JOURNAL_MAX_KEYS || !latest[key].valid)
+        return -1;
+
+    uint8_t length=latest[key].length<maxLength ? latest[key].length : maxLength;
+    if(!storage->read(latest[key].address,data,length))
+        return -1;
+    return length;
+}
+
+int Journal::loadOrMigrate(uint8_t key, void *data, uint8_t length, LegacyStorage *legacy, int legacyOffset)
+{
+    int loaded=load(key,data,length);
+    if(loaded>=0)
+        return loaded;
+
+    legacy->read(legacyOffset,data,length);
+    if(ready)
+        save(key,data,length);
+    return -1;
+}
+
+int Journal::getStoredLength(uint8_t key)
+{
+    if(!ready || key>=JOURNAL_MAX_KEYS || !latest[key].valid)
+        return -1;
+    return latest[key].length;
+}
+
+uint32_t Journal::getSequence()
+{
+    return sequence;
+}
+
+uint32_t Journal::getSectorCount()
+{
+    return sectors;
+}
+
+uint32_t Journal::getActiveSector()
+{
+    return activeSector;
+}
+
+uint32_t Journal::getEraseCount()
+{
+    return erases;
+}
+
+uint32_t Journal::getTornCount()
+{
+    return torn;
+}
+
+// Read every valid record in a sector into latest[], and find its tail:
+// the offset past both the last programmed byte and the last valid record,
+// where appending is safe.
+void Journal::scanSector(uint32_t sector, uint32_t &tail)
+{
+    uint32_t base=sector*JOURNAL_SECTOR_SIZE;
+
+    //Last programmed byte, searching back from the end
+    tail=0;
+    uint8_t chunk[256];
+    for(uint32_t end=JOURNAL_SECTOR_SIZE;end>0 && tail==0;end-=sizeof(chunk))
+    {
+        if(!storage->read(base+end-sizeof(chunk),chunk,sizeof(chunk)))
+            break;
+        for(int i=sizeof(chunk)-1;i>=0;i--)
+        {
+            if(chunk[i]!=0xFF)
+            {
+                tail=end-sizeof(chunk)+i+1;
+                break;
+            }
+        }
+    }
+    tail=(tail+3)&~3u;
+
+    //Walk the records.  After a bad one (torn write, interrupted erase),
+    //resync on the next 4 byte boundary.
+    uint32_t offset=0;
+    bool inBadRun=false;
+    while(offset<tail)
+    {
+        uint8_t key, length;
+        uint32_t recordSequence;
+        if(!readRecord(base+offset,base+JOURNAL_SECTOR_SIZE,key,length,recordSequence))
+        {
+            if(!inBadRun)
+                torn++;
+            inBadRun=true;
+            offset+=4;
+            continue;
+        }
+        inBadRun=false;
+
+        if(!latest[key].valid || recordSequence>latest[key].sequence)
+        {
+            latest[key].valid=true;
+            latest[key].sequence=recordSequence;
+            latest[key].address=base+offset+JOURNAL_HEADER_SIZE;
+            latest[key].length=length;
+        }
+        if(recordSequence>sequence)
+            sequence=recordSequence;
+
+        offset+=recordSize(length);
+        if(offset>tail)
+            tail=offset;   //payload ended in 0xFF bytes
+    }
+}
+
+bool Journal::readRecord(uint32_t address, uint32_t limit, uint8_t &key, uint8_t &length, uint32_t &recordSequence)
+{
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    if(address+JOURNAL_HEADER_SIZE>limit || !storage->read(address,header,sizeof(header)))
+        return false;
+    if(header[0]!=JOURNAL_MAGIC_0 || header[1]!=JOURNAL_MAGIC_1)
+        return false;
+
+    key=header[2];
+    length=header[3];
+    if(key>=JOURNAL_MAX_KEYS || length>JOURNAL_MAX_PAYLOAD || address+recordSize(length)>limit)
+        return false;
+
+    uint8_t payload[JOURNAL_MAX_PAYLOAD];
+    if(!storage->read(address+JOURNAL_HEADER_SIZE,payload,length))
+        return false;
+
+    uint32_t storedCrc;
+    memcpy(&recordSequence,header+4,4);
+    memcpy(&storedCrc,header+8,4);
+    uint32_t crc=crc32(0,header+2,6);
+    crc=crc32(crc,payload,length);
+    return crc==storedCrc;
+}
+
+bool Journal::append(uint8_t key, const void *data, uint8_t length)
+{
+    uint32_t size=recordSize(length);
+    uint32_t address=activeSector*JOURNAL_SECTOR_SIZE+writeOffset;
+    if(writeOffset+size>JOURNAL_SECTOR_SIZE || !isBlank(address,size))
+    {
+        if(!advance())
+            return false;
+        address=activeSector*JOURNAL_SECTOR_SIZE+writeOffset;
+        if(!isBlank(address,size))
+            return false;
+    }
+
+    //Whole record in one write: header first, so a cut leaves it non-blank
+    uint8_t record[JOURNAL_HEADER_SIZE+JOURNAL_MAX_PAYLOAD+3];
+    uint32_t recordSequence=sequence+1;
+    memset(record,0xFF,size);
+    record[0]=JOURNAL_MAGIC_0;
+    record[1]=JOURNAL_MAGIC_1;
+    record[2]=key;
+    record[3]=length;
+    memcpy(record+4,&recordSequence,4);
+    memcpy(record+JOURNAL_HEADER_SIZE,data,length);
+    uint32_t crc=crc32(0,record+2,6);
+    crc=crc32(crc,data,length);
+    memcpy(record+8,&crc,4);
+
+    //Whatever happens, don't write over this spot again
+    writeOffset+=size;
+    if(!storage->write(address,record,size))
+        return false;
+
+    //Read back: catches a sector that only looked erased
+    uint8_t check[sizeof(record)];
+    if(!storage->read(address,check,size) || memcmp(check,record,size)!=0)
+        return false;
+
+    sequence=recordSequence;
+    latest[key].valid=true;
+    latest[key].sequence=recordSequence;
+    latest[key].address=address+JOURNAL_HEADER_SIZE;
+    latest[key].length=length;
+    return true;
+}
+
+bool Journal::isBlank(uint32_t address, uint32_t length)
+{
+    uint8_t buffer[JOURNAL_HEADER_SIZE+JOURNAL_MAX_PAYLOAD+3];
+    if(length>sizeof(buffer) || !storage->read(address,buffer,length))
+        return false;
+    for(uint32_t i=0;i<length;i++)
+        if(buffer[i]!=0xFF)
+            return false;
+    return true;
+}
+
+// Move on to the next sector.  By the invariant it holds no newest
+// records, so erasing it loses nothing.
+bool Journal::advance()
+{
+    uint32_t next=(activeSector+1)%sectors;
+    if(!storage->eraseSector(next*JOURNAL_SECTOR_SIZE))
+        return false;
+    erases++;
+    activeSector=next;
+    writeOffset=0;
+
+    return evacuate((activeSector+1)%sectors);
+}
+
+// Copy any newest records out of a sector so it can be erased later
+bool Journal::evacuate(uint32_t sector)
+{
+    if(sector==activeSector)
+        return true;
+
+    for(uint8_t key=0;key<JOURNAL_MAX_KEYS;key++)
+    {
+        if(!latest[key].valid || latest[key].address/JOURNAL_SECTOR_SIZE!=sector)
+            continue;
+
+        uint8_t payload[JOURNAL_MAX_PAYLOAD];
+        uint8_t length=latest[key].length;
+        if(!storage->read(latest[key].address,payload,length))
+            return false;
+        if(!append(key,payload,length))
+            return false;
+    }
+    return true;
+}
+
+uint32_t Journal::recordSize(uint8_t length)
+{
+    return (JOURNAL_HEADER_SIZE+length+3)&~3u;
+}
+
+//CRC-32 (IEEE 802.3), bitwise: records are small and saves are rare
+uint32_t Journal::crc32(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *bytes=(const uint8_t *)data;
+    crc=~crc;
+    for(size_t i=0;i<length;i++)
+    {
+        crc^=bytes[i];
+        for(int bit=0;bit<8;bit++)
+            crc=(crc>>1)^(0xEDB88320u&(0u-(crc&1)));
+    }
+    return ~crc;
+}
@@ -0,0 +1,119 @@
+#ifndef Journal_h
+#define Journal_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// Append-only record journal for the things we persist (PropBag, trip
+// buckets, last GPS position).  Replaces rewriting one EEPROM page in place.
+//
+// The flash region is split into 4 KB sectors used round-robin.  Every save
+// appends a record:
+//
+//   magic(2) key(1) length(1) sequence(4) crc32(4) payload(length) pad to 4
+//
+// and load returns the newest record for a key whose CRC checks out.  A
+// power cut mid-save leaves a torn record that fails its CRC, so the
+// previous copy is still the newest valid one.  Nothing is overwritten in
+// place, so flash wear is spread over every sector.
+//
+// One invariant keeps it safe: the sector after the active one never holds
+// the newest copy of any key.  When the active sector fills we erase that
+// next sector, move into it, and copy forward any newest records still
+// living in the sector after it (the next one to be erased).  begin()
+// re-establishes the invariant if power failed part way through.
+//
+
+#define JOURNAL_SECTOR_SIZE 4096
+#define JOURNAL_MAX_KEYS 8
+#define JOURNAL_MAX_PAYLOAD 128
+#define JOURNAL_HEADER_SIZE 12
+
+//Keys for what we store
+#define JOURNAL_KEY_PROPBAG 0
+#define JOURNAL_KEY_GPS 1
+#define JOURNAL_KEY_TRIP 2    //+ trip index
+#define JOURNAL_KEY_TRIP_FUEL 5   //+ trip index (SAVED_TRIPS of them)
+#define JOURNAL_KEY_FUEL 7    //last, leaving room for more trips
+
+//Where the journal lives: a flash region that reads back erased as 0xFF and
+//where writes can only clear bits (NOR flash)
+class JournalStorage
+{
+  public:
+    virtual ~JournalStorage() {}
+    virtual uint32_t getSize()=0;
+    virtual bool read(uint32_t address, void *buffer, size_t length)=0;
+    virtual bool write(uint32_t address, const void *buffer, size_t length)=0;
+    virtual bool eraseSector(uint32_t address)=0;
+};
+
+//Where records lived before the journal (EEPROM on the dash)
+class LegacyStorage
+{
+  public:
+    virtual ~LegacyStorage() {}
+    virtual void read(int offset, void *buffer, int length)=0;
+};
+
+class Journal
+{
+  public:
+    //Scan the region, find the newest record per key and where to append
+    bool begin(JournalStorage *_storage);
+    bool isReady();
+
+    //Append a new copy (skipped if identical to the newest one)
+    bool save(uint8_t key, const void *data, uint8_t length);
+
+    //Copy the newest record for key into data.  Returns the bytes copied (at
+    //most maxLength), or -1 if there is no valid record.
+    int load(uint8_t key, void *data, uint8_t maxLength);
+    int getStoredLength(uint8_t key);   //-1 if none
+
+    //load(), falling back to where the record lived before the journal: read
+    //from legacy at legacyOffset and saved, so the journal has it from now
+    //on (just read if the journal isn't ready).  Returns the bytes the
+    //journal held, or -1 if the record came from legacy.
+    int loadOrMigrate(uint8_t key, void *data, uint8_t length, LegacyStorage *legacy, int legacyOffset);
+
+    uint32_t getSequence();       //sequence number of the newest record
+    uint32_t getSectorCount();
+    uint32_t getActiveSector();
+    uint32_t getEraseCount();     //sectors erased since begin()
+    uint32_t getTornCount();      //corrupt or torn records skipped by begin()
+
+    //CRC-32 (IEEE 802.3); start with crc=0, chain calls to extend
+    static uint32_t crc32(uint32_t crc, const void *data, size_t length);
+
+  private:
+    struct Latest
+    {
+        bool valid;
+        uint32_t sequence;
+        uint32_t address;   //of the payload
+        uint8_t length;
+    };
+
+    JournalStorage *storage=NULL;
+    bool ready=false;
+    uint32_t sectors=0;
+    uint32_t activeSector=0;
+    uint32_t writeOffset=0;        //within activeSector
+    uint32_t sequence=0;
+    uint32_t erases=0;
+    uint32_t torn=0;
+    Latest latest[JOURNAL_MAX_KEYS];
+
+    void scanSector(uint32_t sector, uint32_t &tail);
+    bool readRecord(uint32_t address, uint32_t limit, uint8_t &key, uint8_t &length, uint32_t &recordSequence);
+    bool append(uint8_t key, const void *data, uint8_t length);
+    bool isBlank(uint32_t address, uint32_t length);
+    bool advance();
+    bool evacuate(uint32_t sector);
+
+    static uint32_t recordSize(uint8_t length);
+};
+
+#endif
@@ -0,0 +1,29 @@
+#include <Arduino.h>
+#include "PartitionStorage.h"
+
+bool PartitionStorage::begin()
+{
+    partition=esp_partition_find_first((esp_partition_type_t)JOURNAL_PARTITION_TYPE,
+                                       ESP_PARTITION_SUBTYPE_ANY,JOURNAL_PARTITION_LABEL);
+    return partition!=NULL;
+}
+
+uint32_t PartitionStorage::getSize()
+{
+    return partition ? partition->size : 0;
+}
+
+bool PartitionStorage::read(uint32_t address, void *buffer, size_t length)
+{
+    return partition && esp_partition_read(partition,address,buffer,length)==ESP_OK;
+}
+
+bool PartitionStorage::write(uint32_t address, const void *buffer, size_t length)
+{
+    return partition && esp_partition_write(partition,address,buffer,length)==ESP_OK;
+}
+
+bool PartitionStorage::eraseSector(uint32_t address)
+{
+    return partition && esp_partition_erase_range(partition,address,JOURNAL_SECTOR_SIZE)==ESP_OK;
+}
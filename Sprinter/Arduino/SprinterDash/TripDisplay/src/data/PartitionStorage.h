@@ -0,0 +1,26 @@
+#ifndef PartitionStorage_h
+#define PartitionStorage_h
+
+#include <esp_partition.h>
+#include "Journal.h"
+
+//Custom partition type/label the journal lives in (see partitions.csv)
+#define JOURNAL_PARTITION_TYPE 0x40
+#define JOURNAL_PARTITION_LABEL "journal"
+
+//Journal storage on a raw flash partition
+class PartitionStorage : public JournalStorage
+{
+  public:
+    bool begin();   //false if the partition table has no journal partition
+
+    uint32_t getSize();
+    bool read(uint32_t address, void *buffer, size_t length);
+    bool write(uint32_t address, const void *buffer, size_t length);
+    bool eraseSector(uint32_t address);
+
+  private:
+    const esp_partition_t *partition=NULL;
+};
+
+#endif
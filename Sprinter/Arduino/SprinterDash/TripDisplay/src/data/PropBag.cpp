@@ -3,6 +3,36 @@
 #include "../Globals.h"
 #include "../net/VanWifi.h"
 
+//Where PropBag and the trips were saved before the journal
+class EepromStorage : public LegacyStorage
+{
+  public:
+    void read(int offset, void *buffer, int length)
+    {
+      EEPROM.begin(512);
+      for(int i=0;i<length;i++)
+        ((uint8_t*)buffer)[i]=EEPROM.read(offset+i);
+      EEPROM.end();
+    }
+};
+
+void PropBag::init()
+{
+  if(!storage.begin())
+  {
+    logger.log(WARNING,"No '%s' partition (flashed without partitions.csv?).  Saving to EEPROM.",JOURNAL_PARTITION_LABEL);
+    return;
+  }
+
+  if(!journal.begin(&storage))
+  {
+    logger.log(ERROR,"Journal failed to start.  Saving to EEPROM.");
+    return;
+  }
+  logger.log(INFO,"Journal: %lu sectors, active %lu, sequence %lu, %lu torn records skipped",
+    journal.getSectorCount(),journal.getActiveSector(),journal.getSequence(),journal.getTornCount());
+}
+
 void PropBag::resetPropBag()
 {
     logger.log(INFO,"Resetting Prop Bag");
@@ -16,26 +46,22 @@ int PropBag::getPropDataSize()
     return sizeof(data);
 }
 
-//Save data to EEPROM
+//Save data to the journal
 void PropBag::savePropBag()
 {
-  logger.log(INFO,"Saving Prop Bag to EEPROM");
+  logger.log(INFO,"Saving Prop Bag");
 
-  EEPROM.begin(512);
-  EEPROM.put(0, data); 
-  logger.log(VERBOSE,"EEPROM Ret: %d",EEPROM.commit());
+  saveRecord(JOURNAL_KEY_PROPBAG, &data, sizeof(data), 0);
 
   dumpPropBag();
 }
 
-//Load data to EEPROM
+//Load data from the journal
 void PropBag::loadPropBag()
 {
-  logger.log(INFO,"Loading Prop Bag from EEPROM");
+  logger.log(INFO,"Loading Prop Bag");
 
-  EEPROM.begin(512);
-  EEPROM.get(0, data);
-  EEPROM.end();
+  loadRecord(JOURNAL_KEY_PROPBAG, &data, sizeof(data), 0);
 
   dumpPropBag();
 }
@@ -48,20 +74,60 @@ void PropBag::dumpPropBag()
     logger.log(INFO,"   Elevation Offset: %d",data.elevationOffset);
     logger.log(INFO,"   Traccar trip active: %d  leftHome: %d",data.traccarTripActive,data.leftHomeAfterTripStart);
     logger.log(INFO,"   Last GPS: %f,%f",(double)lastLat,(double)lastLon);
+    logger.log(INFO,"   Fuel Calib: x%f + %f gal/h over %f gal, %lu fill-ups",fuelCalibration.factor,fuelCalibration.idleGph,
+      fuelCalibration.spanGallons,(unsigned long)fuelCalibration.fillUps);
 }
 
 void PropBag::saveGpsPosition()
 {
-  EEPROM.begin(512);
-  EEPROM.put(GPS_EEPROM_OFFSET, lastLat);
-  EEPROM.put(GPS_EEPROM_OFFSET + sizeof(float), lastLon);
-  EEPROM.commit();
+  float position[2]={lastLat,lastLon};
+  saveRecord(JOURNAL_KEY_GPS, position, sizeof(position), GPS_EEPROM_OFFSET);
 }
 
 void PropBag::loadGpsPosition()
 {
+  float position[2]={0,0};
+  loadRecord(JOURNAL_KEY_GPS, position, sizeof(position), GPS_EEPROM_OFFSET);
+  lastLat=position[0];
+  lastLon=position[1];
+}
+
+void PropBag::saveFuelCalibration()
+{
+  saveRecord(JOURNAL_KEY_FUEL, &fuelCalibration, sizeof(fuelCalibration), FUEL_EEPROM_OFFSET);
+}
+
+void PropBag::loadFuelCalibration()
+{
+  loadRecord(JOURNAL_KEY_FUEL, &fuelCalibration, sizeof(fuelCalibration), FUEL_EEPROM_OFFSET);
+}
+
+bool PropBag::saveRecord(uint8_t key, const void *record, int length, int eepromOffset)
+{
+  if(journal.isReady())
+  {
+    bool ok=journal.save(key, record, length);
+    if(ok)
+      logger.log(VERBOSE,"Journal key %d saved, sequence %lu, sector %lu",key,journal.getSequence(),journal.getActiveSector());
+    else
+      logger.log(ERROR,"Journal save failed for key %d",key);
+    return ok;
+  }
+
   EEPROM.begin(512);
-  EEPROM.get(GPS_EEPROM_OFFSET, lastLat);
-  EEPROM.get(GPS_EEPROM_OFFSET + sizeof(float), lastLon);
-  EEPROM.end();
+  for(int i=0;i<length;i++)
+    EEPROM.write(eepromOffset+i,((const uint8_t*)record)[i]);
+  bool ok=EEPROM.commit();
+  logger.log(VERBOSE,"EEPROM Ret: %d",ok);
+  return ok;
+}
+
+void PropBag::loadRecord(uint8_t key, void *record, int length, int eepromOffset)
+{
+  EepromStorage eeprom;
+  int loaded=journal.loadOrMigrate(key, record, length, &eeprom, eepromOffset);
+  if(loaded>=0 && loaded!=length)
+    logger.log(WARNING,"Journal key %d holds %d bytes, expected %d.  Struct changed?",key,loaded,length);
+  else if(loaded<0 && journal.isReady())
+    logger.log(INFO,"Journal had no key %d yet.  Migrated it from EEPROM.",key);
 }
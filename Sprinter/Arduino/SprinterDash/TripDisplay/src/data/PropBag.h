@@ -2,16 +2,20 @@
 #define PropBag_h
 
 #include <EEPROM.h>
+#include "Journal.h"
+#include "PartitionStorage.h"
+#include "FuelModel.h"
 
 #define PITOT_CALIB 1.07
 #define INST_MPG_FACTOR 1.78
 #define GPS_EEPROM_OFFSET 400
+#define FUEL_EEPROM_OFFSET 420
 
 struct PropBagStruct
 {
     //Calibration
     double_t pitotCalibration=PITOT_CALIB;
-    double_t instMPGFactor=INST_MPG_FACTOR;
+    double_t instMPGFactor=INST_MPG_FACTOR;   //no longer learned; seeds FuelModel the first time
 
     //Auto-calibration offset for barometric altimeter (feet).
     int elevationOffset=0;
@@ -26,13 +30,22 @@ struct PropBagStruct
 class PropBag
 {
   public:
+    void init();           //Starts the journal (falls back to EEPROM without a journal partition)
     int getPropDataSize();
     void resetPropBag();   
-    void savePropBag();    //Saves data to EEPROM
+    void savePropBag();    //Saves data to the journal (or EEPROM)
     void loadPropBag();
     void dumpPropBag();
     void saveGpsPosition();
     void loadGpsPosition();
+    void saveFuelCalibration();
+    void loadFuelCalibration();
+
+    //Persist a record under a journal key.  eepromOffset is where it lived
+    //before the journal: used without a journal partition, and read once
+    //to migrate a key the journal doesn't have yet.
+    bool saveRecord(uint8_t key, const void *record, int length, int eepromOffset);
+    void loadRecord(uint8_t key, void *record, int length, int eepromOffset);
 
     PropBagStruct data;
 
@@ -40,7 +53,12 @@ class PropBag
     float lastLat=0;
     float lastLon=0;
 
+    //FuelModel's fit against the tank gauge
+    FuelCalibration fuelCalibration;
+
   private: 
+    PartitionStorage storage;
+    Journal journal;
 };
 
 #endif
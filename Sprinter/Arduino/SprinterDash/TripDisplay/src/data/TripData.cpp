@@ -40,6 +40,11 @@ void TripData::resetTripData()
     data.totalStoppedSeconds=0;
     data.numberOfStops=0;
     data.totalClimb=0;
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+    {
+        fuel.engineGallons[i]=0;
+        fuel.segmentMiles[i]=0;
+    }
 }
 
 void TripData::adjustForTimeSync(uint32_t oldTime, uint32_t newTime)
@@ -79,24 +84,23 @@ void TripData::updateStartValuesIfNeeded()
 
 void TripData::saveTripData(int offset)
 {
-  logger.log(INFO,"Saving Trip Data to EEPROM");
+  logger.log(INFO,"Saving Trip Data");
 
-  int dataSize=sizeof(data);
-  EEPROM.begin(512);
-  EEPROM.put((dataSize*tripIdx)+offset, data); 
-  logger.log(VERBOSE,"EEPROM Ret: %d",EEPROM.commit());
+  //offset is where trip data started in the old EEPROM layout
+  propBagPtr->saveRecord(JOURNAL_KEY_TRIP+tripIdx, &data, sizeof(data), tripEepromOffset(offset,tripIdx));
+  propBagPtr->saveRecord(JOURNAL_KEY_TRIP_FUEL+tripIdx, &fuel, sizeof(fuel), tripFuelEepromOffset(tripIdx));
 
   dumpTripData();
 }
 
 void TripData::loadTripData(int offset)
 {
-  logger.log(INFO,"Loading Trip Data from EEPROM");
+  logger.log(INFO,"Loading Trip Data");
 
-  int dataSize=sizeof(data);
-  EEPROM.begin(512);
-  EEPROM.get((dataSize*tripIdx)+offset, data);
-  EEPROM.end();
+  propBagPtr->loadRecord(JOURNAL_KEY_TRIP+tripIdx, &data, sizeof(data), tripEepromOffset(offset,tripIdx));
+  propBagPtr->loadRecord(JOURNAL_KEY_TRIP_FUEL+tripIdx, &fuel, sizeof(fuel), tripFuelEepromOffset(tripIdx));
+  if(!checkTripFuel(&fuel))
+    logger.log(WARNING,"Trip %d has no engine fuel saved (saved by an older build?).  Starting it at zero.",tripIdx);
 
   unsigned long currentTime=currentDataPtr->currentSeconds;
   if(currentTime < data.ignOffSeconds)
@@ -126,6 +130,10 @@ void TripData::dumpTripData()
     logger.log(INFO,"   Stopped fuel: %d",data.stoppedFuelPerc);
     logger.log(INFO,"   Prior Gallons: %f",data.priorTotalGallonsUsed);
     logger.log(INFO,"   Total Climb: %ld",data.totalClimb);
+    logger.log(INFO,"   Engine Gallons: %f  (idle %f, cruise %f, climb %f)",getEngineGallons(),
+        fuel.engineGallons[FUEL_SEGMENT_IDLE],fuel.engineGallons[FUEL_SEGMENT_CRUISE],fuel.engineGallons[FUEL_SEGMENT_CLIMB]);
+    logger.log(INFO,"   Segment Miles: idle %f, cruise %f, climb %f",
+        fuel.segmentMiles[FUEL_SEGMENT_IDLE],fuel.segmentMiles[FUEL_SEGMENT_CRUISE],fuel.segmentMiles[FUEL_SEGMENT_CLIMB]);
 }
 
 void TripData::ignitionOff()
@@ -166,6 +174,21 @@ void TripData::updateElevation()
     }
 }
 
+//Add what FuelModel has integrated since last time, per segment
+void TripData::updateEngineFuel()
+{
+    FuelModel &fuelModel=currentDataPtr->getFuelModel();
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+    {
+        double gallons=fuelModel.getGallons(i);
+        double miles=fuelModel.getMiles(i);
+        fuel.engineGallons[i]=fuel.engineGallons[i]+(gallons-lastModelGallons[i]);
+        fuel.segmentMiles[i]=fuel.segmentMiles[i]+(miles-lastModelMiles[i]);
+        lastModelGallons[i]=gallons;
+        lastModelMiles[i]=miles;
+    }
+}
+
 int TripData::getMilesTravelled()
 {
     long currentMiles=currentDataPtr->currentMiles;
@@ -246,8 +269,13 @@ void TripData::updateFuelGallonsUsed()
     }
 }
 
+//Engine fuel from FuelModel; the tank gauge for trips from before it
 double TripData::getFuelGallonsUsed()
 {
+    double engineGallons=getEngineGallons();
+    if(engineGallons>0)
+        return engineGallons;
+
     updateFuelGallonsUsed();
     return fuelGallonsUsed;
 }
@@ -273,27 +301,13 @@ double TripData::getGallonsExpected()
 
 double TripData::getInstantMPG()
 {
-    double galPerHour=((double)currentDataPtr->currentMAF*(double)currentDataPtr->currentLoad)/1006.777948;
-    double currentInstMPG=(double)(currentDataPtr->currentSpeed)/galPerHour;
-    instMPG = currentInstMPG;
-
-    if(instMPG>3.0 && instMPG<30.0)
-    {
-        instMPG = currentInstMPG*0.25 + instMPG*0.75;
-
-        sumInstMPG=sumInstMPG+(instMPG*10);
-        numInstMPGSamples++;
-        lastAvgInstMPG=(sumInstMPG/numInstMPGSamples)/10.0;
-    }
-
-    if(getFuelGallonsUsed()>=1.0 && getMilesTravelled()>=10 && (currentDataPtr->currentFuelPerc<75 || propBagPtr->data.instMPGFactor<0.01)) 
-    {
-        propBagPtr->data.instMPGFactor=getAvgMPG()/lastAvgInstMPG;
-    }
-
-    if(propBagPtr->data.instMPGFactor>0.01) 
-        instMPG=instMPG*propBagPtr->data.instMPGFactor;
+    double galPerHour=currentDataPtr->currentGallonsPerHour;
+    if(galPerHour<0.05)
+        return 0;
 
+    double instMPG=(double)currentDataPtr->currentSpeed/galPerHour;
+    if(instMPG>99.0)
+        instMPG=99.0;
     return instMPG;
 }
 
@@ -302,13 +316,40 @@ double TripData::getAvgMPG()
     double gallonsUsed=getFuelGallonsUsed();
     int milesTravelled=getMilesTravelled();
 
-    if(gallonsUsed<1.0 || milesTravelled<10)
+    //Engine fuel is good from the first tenth of a gallon; the gauge needs a whole one
+    bool fromEngine=getEngineGallons()>0;
+    if(gallonsUsed<(fromEngine ? 0.1 : 1.0) || milesTravelled<(fromEngine ? 5 : 10))
         return getInstantMPG();
 
     double mpg=(double)milesTravelled/gallonsUsed;
     return(mpg);    
 }
 
+double TripData::getEngineGallons()
+{
+    double gallons=0;
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+        gallons=gallons+fuel.engineGallons[i];
+    return gallons;
+}
+
+double TripData::getSegmentGallons(int segment)
+{
+    return fuel.engineGallons[segment];
+}
+
+double TripData::getSegmentMiles(int segment)
+{
+    return fuel.segmentMiles[segment];
+}
+
+double TripData::getSegmentMPG(int segment)
+{
+    if(fuel.engineGallons[segment]<0.05)
+        return 0;
+    return fuel.segmentMiles[segment]/fuel.engineGallons[segment];
+}
+
 double TripData::getAvgMovingSpeed()
 {
     double hours=getDrivingTime();
@@ -3,35 +3,13 @@
 
 #include <EEPROM.h>
 #include "CurrentData.h"
+#include "TripRecord.h"
 
 // Forward declaration — PropBag is in the same directory
 class PropBag;
 
-#define FUEL_TANK_SIZE 24.5   // in gallons
-#define FUEL_ADDITIVE_RATIO .4   // oz per gallons
-
-struct TripDataStruct{
-    //Distance
-    uint32_t startMiles;  
-    uint32_t lastMiles;
-    uint32_t priorTotalMiles;
-
-    //Timing
-    uint32_t startSeconds;
-    uint32_t ignOffSeconds;
-    uint32_t totalParkedSeconds;
-    uint32_t totalStoppedSeconds;
-    uint16_t numberOfStops;
-
-    //Consumption
-    uint16_t stoppedFuelPerc;
-    uint16_t startFuelPerc;
-    float priorTotalGallonsUsed;
-
-    //Elevation
-    uint32_t totalClimb;
-    uint32_t lastElevation;
-};
+// FUEL_TANK_SIZE and FUEL_ADDITIVE_RATIO are in FuelModel.h
+// TripDataStruct and TripFuelStruct (and where they are saved) are in TripRecord.h
 
 class TripData
 {
@@ -41,6 +19,7 @@ class TripData
     void ignitionOff(); 
     void ignitionOn();
     void updateElevation();
+    void updateEngineFuel();
     void updateFuelGallonsUsed();
     void resetTripData();
     void adjustForTimeSync(uint32_t oldTime, uint32_t newTime);
@@ -60,6 +39,10 @@ class TripData
     double getGallonsExpected();
     double getInstantMPG();
     double getAvgMPG();
+    double getEngineGallons();                 //from FuelModel; 0 until it has seen fuel flow
+    double getSegmentGallons(int segment);
+    double getSegmentMiles(int segment);
+    double getSegmentMPG(int segment);
     double getAvgMovingSpeed();
     int getMilesLeftInTank();
     int getCurrentElevation();
@@ -71,13 +54,13 @@ class TripData
     int tripIdx;
 
     TripDataStruct data;
+    TripFuelStruct fuel;
 
     double fuelGallonsUsed;
 
-    unsigned long sumInstMPG=0;
-    long numInstMPGSamples=0;
-    double instMPG=0;
-    double lastAvgInstMPG=0;
+    //FuelModel totals when we last looked, to add the difference
+    double lastModelGallons[FUEL_SEGMENTS]={0};
+    double lastModelMiles[FUEL_SEGMENTS]={0};
 
     bool startMilesNeedsUpdating=false;
     bool startFuelNeedsUpdating=false;
@@ -0,0 +1,92 @@
+#ifndef TripRecord_h
+#define TripRecord_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "FuelModel.h"
+
+//
+// What a trip bucket saves, and where.
+//
+// TripDataStruct is the record trips have always been saved as: 48 bytes
+// (LEGACY_TRIP_SIZE), one after the other after PropBag in EEPROM and under
+// JOURNAL_KEY_TRIP+idx in the journal.  It must not change size, or a unit
+// upgrading from an older build migrates its trips from the wrong offsets.
+//
+// FuelModel's per trip totals are a second record, TripFuelStruct, under
+// JOURNAL_KEY_TRIP_FUEL+idx (TRIP_FUEL_EEPROM_OFFSET without the journal).
+// A trip saved before there was one migrates it from EEPROM that was never
+// written (0xFF, or whatever was there), so it is checked on load and
+// zeroed if it isn't plausible.
+//
+
+#define LEGACY_TRIP_SIZE 48
+#define SAVED_TRIPS 2                  // current segment and full trip (since last stop isn't saved)
+#define TRIP_FUEL_EEPROM_OFFSET 300    // free between the trips (~120) and GPS_EEPROM_OFFSET
+#define TRIP_FUEL_MAX 100000.0         // gallons or miles; anything bigger is garbage
+
+struct TripDataStruct{
+    //Distance
+    uint32_t startMiles;
+    uint32_t lastMiles;
+    uint32_t priorTotalMiles;
+
+    //Timing
+    uint32_t startSeconds;
+    uint32_t ignOffSeconds;
+    uint32_t totalParkedSeconds;
+    uint32_t totalStoppedSeconds;
+    uint16_t numberOfStops;
+
+    //Consumption
+    uint16_t stoppedFuelPerc;
+    uint16_t startFuelPerc;
+    float priorTotalGallonsUsed;
+
+    //Elevation
+    uint32_t totalClimb;
+    uint32_t lastElevation;
+};
+
+static_assert(sizeof(TripDataStruct)==LEGACY_TRIP_SIZE, "TripDataStruct is saved at the legacy EEPROM offsets; add fields to TripFuelStruct or a record of their own");
+
+//Engine fuel and miles from FuelModel, by FUEL_SEGMENT_*
+struct TripFuelStruct{
+    float engineGallons[FUEL_SEGMENTS];
+    float segmentMiles[FUEL_SEGMENTS];
+};
+
+//propBagSize is where the trips start in EEPROM (PropBag::getPropDataSize())
+inline int tripEepromOffset(int propBagSize, int tripIdx)
+{
+    return propBagSize+LEGACY_TRIP_SIZE*tripIdx;
+}
+
+inline int tripFuelEepromOffset(int tripIdx)
+{
+    return TRIP_FUEL_EEPROM_OFFSET+(int)sizeof(TripFuelStruct)*tripIdx;
+}
+
+//Zeroes a fuel record that was never saved; false if it had to
+inline bool checkTripFuel(TripFuelStruct *fuel)
+{
+    bool ok=true;
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+    {
+        if(!(fuel->engineGallons[i]>=0 && fuel->engineGallons[i]<TRIP_FUEL_MAX) ||
+           !(fuel->segmentMiles[i]>=0 && fuel->segmentMiles[i]<TRIP_FUEL_MAX))
+            ok=false;
+    }
+    if(!ok)
+    {
+        for(int i=0;i<FUEL_SEGMENTS;i++)
+        {
+            fuel->engineGallons[i]=0;
+            fuel->segmentMiles[i]=0;
+        }
+    }
+    return ok;
+}
+
+#endif
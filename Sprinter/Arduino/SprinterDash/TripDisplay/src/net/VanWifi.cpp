@@ -97,7 +97,8 @@ void VanWifi::setupServerRouting() {
         "/tracks/download?file=FILENAME --> download a GPX file<br>"
         "/tracks/delete?file=FILENAME --> delete a GPX file<br>"
         "/tracks/storage --> show LittleFS usage<br>"
-        "/elevation --> altitude auto-calibration status &amp; force recalibrate");
+        "/elevation --> altitude auto-calibration status &amp; force recalibrate<br>"
+        "/fuel --> fuel flow model, calibration and idle/cruise/climb fuel per trip");
     });
 
     //GET
@@ -112,6 +113,9 @@ void VanWifi::setupServerRouting() {
 
     //GET - Elevation calibration status
     server.on("/elevation", HTTP_GET, handleElevationCalib);
+
+    //GET - Fuel model
+    server.on("/fuel", HTTP_GET, handleFuel);
 }
 
 void VanWifi::sendErrorResponse(const char*errorString)
@@ -27,6 +27,7 @@ extern void handleTrackDownload();
 extern void handleTrackDelete();
 extern void handleTrackStorage();
 extern void handleElevationCalib();
+extern void handleFuel();
 
 class VanWifi 
 {
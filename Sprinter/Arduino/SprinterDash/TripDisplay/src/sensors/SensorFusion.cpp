@@ -0,0 +1,376 @@
+#include <string.h>
+#include "SensorFusion.h"
+
+//
+// Noise figures.  Standard deviations in the units of each filter.
+//
+
+//Elevation (feet, seconds)
+#define ELEV_INITIAL_SIGMA 100.0f    // corrected baro vs truth before any GPS/DEM fix
+#define BIAS_INITIAL_SIGMA 100.0f    // weather drift since the last ElevationAPI offset
+#define CLIMB_INITIAL_SIGMA 10.0f    // ft/s
+#define CLIMB_ACCEL_SIGMA 1.0f       // how fast climb rate changes, ft/s per sqrt(s)
+#define BIAS_DRIFT_SIGMA 0.35f       // ~20 ft/hour of weather, ft per sqrt(s)
+#define BARO_SIGMA 4.0f              // MPL3115A2 with the static port in the engine bay
+#define GPS_ALT_SIGMA_GOOD 33.0f     // 10m with 8+ satellites
+#define GPS_ALT_SIGMA_POOR 66.0f     // 20m with 4-7
+#define GPS_MIN_SATELLITES 4
+#define DEM_SIGMA 20.0f              // 30m DEM at road level
+#define ELEV_CONFIDENCE_SCALE 30.0f  // sigma giving 0.5 confidence
+
+//Speed (mph, seconds)
+#define ACCEL_INITIAL_SIGMA 2.0f
+#define JERK_SIGMA 3.0f              // mph/s per sqrt(s)
+#define OBD_SPEED_SIGMA 1.0f         // 1 km/h steps plus CAN latency
+#define GPS_SPEED_SIGMA 1.5f
+#define GPS_SPEED_SIGMA_CRAWL 5.0f   // GPS speed wanders when nearly stopped
+#define GPS_CRAWL_MPH 5.0f
+#define SPEED_CONFIDENCE_SCALE 2.0f
+
+//Headwind (mph, seconds)
+#define WIND_INITIAL_SIGMA 15.0f
+#define WIND_DRIFT_SIGMA 0.5f        // mph per sqrt(s)
+#define PITOT_SIGMA 5.0f             // gusts, and the pitot's own noise
+#define PITOT_MIN_MPH 20.0f          // too little dynamic pressure below this
+#define WIND_CONFIDENCE_SCALE 4.0f
+
+#define MAX_PREDICT_SECONDS 600.0f
+
+//
+// KalmanFilter
+//
+
+template <int N>
+void KalmanFilter<N>::reset(const float *x0, const float *variances)
+{
+    memset(P, 0, sizeof(P));
+    for(int i=0;i<N;i++)
+    {
+        x[i]=x0[i];
+        P[i][i]=variances[i];
+    }
+    outliers=0;
+}
+
+template <int N>
+void KalmanFilter<N>::predict(const float F[N][N], const float Q[N][N])
+{
+    float fx[N];
+    float fp[N][N];
+    for(int i=0;i<N;i++)
+    {
+        fx[i]=0;
+        for(int k=0;k<N;k++)
+            fx[i]+=F[i][k]*x[k];
+    }
+    for(int i=0;i<N;i++)
+        for(int j=0;j<N;j++)
+        {
+            fp[i][j]=0;
+            for(int k=0;k<N;k++)
+                fp[i][j]+=F[i][k]*P[k][j];
+        }
+    //P = F.P.F' + Q
+    for(int i=0;i<N;i++)
+        for(int j=0;j<N;j++)
+        {
+            float sum=Q[i][j];
+            for(int k=0;k<N;k++)
+                sum+=fp[i][k]*F[j][k];
+            P[i][j]=sum;
+        }
+    memcpy(x,fx,sizeof(x));
+}
+
+template <int N>
+bool KalmanFilter<N>::update(const float H[N], float z, float r)
+{
+    //PH = P.H', s = H.P.H' + r
+    float ph[N];
+    float s=r;
+    float hx=0;
+    for(int i=0;i<N;i++)
+    {
+        ph[i]=0;
+        for(int k=0;k<N;k++)
+            ph[i]+=P[i][k]*H[k];
+        s+=H[i]*ph[i];
+        hx+=H[i]*x[i];
+    }
+    float innovation=z-hx;
+
+    //Gate outliers, but let a run of them through as a real step
+    if(innovation*innovation > FUSION_OUTLIER_SIGMA*FUSION_OUTLIER_SIGMA*s)
+    {
+        outliers++;
+        rejected++;
+        if(outliers<FUSION_OUTLIER_OVERRIDE)
+            return false;
+    }
+    outliers=0;
+
+    //x += K.innovation, P -= K.H.P  (K = PH/s)
+    for(int i=0;i<N;i++)
+        x[i]+=ph[i]/s*innovation;
+    for(int i=0;i<N;i++)
+        for(int j=0;j<N;j++)
+            P[i][j]-=ph[i]*ph[j]/s;
+    return true;
+}
+
+template class KalmanFilter<1>;
+template class KalmanFilter<2>;
+template class KalmanFilter<3>;
+
+//
+// SensorFusion
+//
+
+SensorFusion::SensorFusion()
+{
+    reset();
+}
+
+void SensorFusion::reset()
+{
+    elevationStarted=false;
+    elevationAnchored=false;
+    speedStarted=false;
+    windStarted=false;
+    elevation.rejected=0;
+    speed.rejected=0;
+    wind.rejected=0;
+}
+
+//Seconds since lastMs, which is moved up to ms.  Out-of-order readings get 0.
+float SensorFusion::elapsedSeconds(unsigned long &lastMs, unsigned long ms)
+{
+    long delta=(long)(ms-lastMs);
+    if(delta<=0)
+        return 0;
+    lastMs=ms;
+    float seconds=delta/1000.0f;
+    return seconds>MAX_PREDICT_SECONDS ? MAX_PREDICT_SECONDS : seconds;
+}
+
+float SensorFusion::confidence(float variance, float scale)
+{
+    return 1.0f/(1.0f+variance/(scale*scale));
+}
+
+void SensorFusion::predictElevation(unsigned long ms)
+{
+    float dt=elapsedSeconds(elevationMs,ms);
+    if(dt==0)
+        return;
+
+    const float F[3][3]={{1,dt,0},{0,1,0},{0,0,1}};
+    //Climb rate as a random walk (integrated into elevation), bias as another
+    float qa=CLIMB_ACCEL_SIGMA*CLIMB_ACCEL_SIGMA*dt;
+    const float Q[3][3]={
+        {qa*dt*dt/3,qa*dt/2,0},
+        {qa*dt/2,qa,0},
+        {0,0,BIAS_DRIFT_SIGMA*BIAS_DRIFT_SIGMA*dt}};
+    elevation.predict(F,Q);
+}
+
+void SensorFusion::addBaroElevation(unsigned long ms, float feet)
+{
+    if(!elevationStarted)
+    {
+        const float x0[3]={feet,0,0};
+        const float v0[3]={ELEV_INITIAL_SIGMA*ELEV_INITIAL_SIGMA,
+                           CLIMB_INITIAL_SIGMA*CLIMB_INITIAL_SIGMA,
+                           BIAS_INITIAL_SIGMA*BIAS_INITIAL_SIGMA};
+        elevation.reset(x0,v0);
+        elevationMs=ms;
+        elevationStarted=true;
+    }
+
+    predictElevation(ms);
+    const float H[3]={1,0,1};   //baro reads elevation + bias
+    elevation.update(H,feet,BARO_SIGMA*BARO_SIGMA);
+}
+
+void SensorFusion::addReferenceElevation(unsigned long ms, float feet)
+{
+    //Only meaningful once the baro has started the filter
+    if(!elevationStarted)
+        return;
+
+    predictElevation(ms);
+    const float H[3]={1,0,0};
+    if(elevation.update(H,feet,DEM_SIGMA*DEM_SIGMA))
+        elevationAnchored=true;
+}
+
+void SensorFusion::shiftBaroBias(float feet)
+{
+    if(elevationStarted)
+        elevation.x[2]+=feet;
+}
+
+void SensorFusion::addGpsFix(unsigned long ms, float altitudeMeters, float speedKnots, int satellites)
+{
+    if(satellites<GPS_MIN_SATELLITES)
+        return;
+
+    if(elevationStarted)
+    {
+        predictElevation(ms);
+        float sigma=satellites>=8 ? GPS_ALT_SIGMA_GOOD : GPS_ALT_SIGMA_POOR;
+        const float H[3]={1,0,0};
+        if(elevation.update(H,altitudeMeters*METERS_2_FEET,sigma*sigma))
+            elevationAnchored=true;
+    }
+
+    //GPS speed can start the speed filter too, e.g. before OBD is online
+    float mph=speedKnots*KNOTS_2_MPH;
+    float sigma=mph<GPS_CRAWL_MPH ? GPS_SPEED_SIGMA_CRAWL : GPS_SPEED_SIGMA;
+    if(!speedStarted)
+    {
+        const float x0[2]={mph,0};
+        const float v0[2]={sigma*sigma,ACCEL_INITIAL_SIGMA*ACCEL_INITIAL_SIGMA};
+        speed.reset(x0,v0);
+        speedMs=ms;
+        speedStarted=true;
+        return;
+    }
+    predictSpeed(ms);
+    const float H[2]={1,0};
+    speed.update(H,mph,sigma*sigma);
+}
+
+void SensorFusion::predictSpeed(unsigned long ms)
+{
+    float dt=elapsedSeconds(speedMs,ms);
+    if(dt==0)
+        return;
+
+    const float F[2][2]={{1,dt},{0,1}};
+    float qj=JERK_SIGMA*JERK_SIGMA*dt;
+    const float Q[2][2]={{qj*dt*dt/3,qj*dt/2},{qj*dt/2,qj}};
+    speed.predict(F,Q);
+}
+
+void SensorFusion::addObdSpeed(unsigned long ms, float mph)
+{
+    if(!speedStarted)
+    {
+        const float x0[2]={mph,0};
+        const float v0[2]={OBD_SPEED_SIGMA*OBD_SPEED_SIGMA,ACCEL_INITIAL_SIGMA*ACCEL_INITIAL_SIGMA};
+        speed.reset(x0,v0);
+        speedMs=ms;
+        speedStarted=true;
+        return;
+    }
+    predictSpeed(ms);
+    const float H[2]={1,0};
+    speed.update(H,mph,OBD_SPEED_SIGMA*OBD_SPEED_SIGMA);
+}
+
+void SensorFusion::predictWind(unsigned long ms)
+{
+    float dt=elapsedSeconds(windMs,ms);
+    if(dt==0)
+        return;
+
+    const float F[1][1]={{1}};
+    const float Q[1][1]={{WIND_DRIFT_SIGMA*WIND_DRIFT_SIGMA*dt}};
+    wind.predict(F,Q);
+}
+
+void SensorFusion::addPitotSpeed(unsigned long ms, float mph)
+{
+    //Headwind is relative to ground speed, and the pitot is only worth
+    //reading once there's real airflow over it
+    if(!speedStarted || speed.x[0]<PITOT_MIN_MPH || mph<=0)
+        return;
+
+    predictSpeed(ms);
+    float measured=mph-speed.x[0];
+    //Ground speed's own uncertainty carries into the difference
+    float r=PITOT_SIGMA*PITOT_SIGMA+speed.P[0][0];
+
+    if(!windStarted)
+    {
+        const float x0[1]={measured};
+        const float v0[1]={WIND_INITIAL_SIGMA*WIND_INITIAL_SIGMA};
+        wind.reset(x0,v0);
+        windMs=ms;
+        windStarted=true;
+    }
+    predictWind(ms);
+    const float H[1]={1};
+    wind.update(H,measured,r);
+}
+
+void SensorFusion::advance(unsigned long ms)
+{
+    if(elevationStarted)
+        predictElevation(ms);
+    if(speedStarted)
+        predictSpeed(ms);
+    if(windStarted)
+        predictWind(ms);
+}
+
+bool SensorFusion::hasElevation()
+{
+    return elevationStarted;
+}
+
+float SensorFusion::getElevation()
+{
+    return elevation.x[0];
+}
+
+float SensorFusion::getClimbRate()
+{
+    return elevation.x[1]*60.0f;
+}
+
+float SensorFusion::getElevationConfidence()
+{
+    return elevationStarted ? confidence(elevation.P[0][0],ELEV_CONFIDENCE_SCALE) : 0;
+}
+
+float SensorFusion::getBaroBias()
+{
+    return elevationAnchored ? elevation.x[2] : 0;
+}
+
+bool SensorFusion::hasSpeed()
+{
+    return speedStarted;
+}
+
+float SensorFusion::getSpeed()
+{
+    return speed.x[0]<0 ? 0 : speed.x[0];
+}
+
+float SensorFusion::getSpeedConfidence()
+{
+    return speedStarted ? confidence(speed.P[0][0],SPEED_CONFIDENCE_SCALE) : 0;
+}
+
+bool SensorFusion::hasHeadwind()
+{
+    return windStarted;
+}
+
+float SensorFusion::getHeadwind()
+{
+    return wind.x[0];
+}
+
+float SensorFusion::getHeadwindConfidence()
+{
+    return windStarted ? confidence(wind.P[0][0],WIND_CONFIDENCE_SCALE) : 0;
+}
+
+unsigned long SensorFusion::getRejectedCount()
+{
+    return elevation.rejected+speed.rejected+wind.rejected;
+}
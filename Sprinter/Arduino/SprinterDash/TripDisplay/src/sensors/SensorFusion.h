@@ -0,0 +1,107 @@
+#ifndef SensorFusion_h
+#define SensorFusion_h
+
+//
+// Combines the van's overlapping elevation and speed sources into one
+// smoothed estimate each, with a confidence value:
+//
+//   Elevation / climb rate   barometer (precise, drifts with weather)
+//                            GPS altitude (noisy, no drift)
+//                            ElevationAPI DEM lookups (rare, accurate)
+//   Ground speed             OBD speed (fast, 1 km/h steps)
+//                            GPS speed (1 Hz, useless when crawling)
+//   Headwind                 pitot airspeed minus fused ground speed
+//
+// Each is a small Kalman filter.  The elevation filter also tracks the
+// barometer's bias, so GPS and DEM fixes slowly pull out weather drift
+// between ElevationAPI calibrations instead of it showing up as climb.
+// Readings far outside what the filter expects are dropped as outliers,
+// unless several arrive in a row (a real step, e.g. a new baro offset).
+//
+// Every input takes its own timestamp in ms instead of reading millis(), so
+// test/FusionReplay can feed it recorded logs at whatever speed.
+//
+
+#define FUSION_OUTLIER_SIGMA 4.0f   // innovations beyond this many sigma are outliers
+#define FUSION_OUTLIER_OVERRIDE 3   // accept after this many outliers in a row
+
+#define KNOTS_2_MPH 1.15078f
+#define METERS_2_FEET 3.28084f
+
+//Scalar-measurement Kalman filter over N states
+template <int N>
+class KalmanFilter
+{
+  public:
+    float x[N];
+    float P[N][N];
+    int outliers=0;           //rejected in a row
+    unsigned long rejected=0; //rejected in total
+
+    void reset(const float *x0, const float *variances);
+    void predict(const float F[N][N], const float Q[N][N]);
+
+    //z = H.x + noise(r).  Returns false if gated out as an outlier.
+    bool update(const float H[N], float z, float r);
+};
+
+class SensorFusion
+{
+  public:
+    SensorFusion();
+    void reset();
+
+    //Inputs
+    void addBaroElevation(unsigned long ms, float feet);
+    void addGpsFix(unsigned long ms, float altitudeMeters, float speedKnots, int satellites);
+    void addObdSpeed(unsigned long ms, float mph);
+    void addPitotSpeed(unsigned long ms, float mph);
+    void addReferenceElevation(unsigned long ms, float feet);  //DEM lookup (ElevationAPI)
+    void shiftBaroBias(float feet);                            //barometer offset changed by this much
+
+    //Bring every estimate (and its confidence) forward to ms, so an input
+    //that stops arriving shows up as falling confidence
+    void advance(unsigned long ms);
+
+    //Outputs.  Confidences are 0 (unknown) .. 1 (tight estimate).
+    bool  hasElevation();
+    float getElevation();          //feet
+    float getClimbRate();          //feet per minute
+    float getElevationConfidence();
+    float getBaroBias();           //feet the barometer currently reads high
+
+    bool  hasSpeed();
+    float getSpeed();              //ground speed, mph
+    float getSpeedConfidence();
+
+    bool  hasHeadwind();
+    float getHeadwind();           //mph, positive into the wind
+    float getHeadwindConfidence();
+
+    unsigned long getRejectedCount();  //outliers dropped across all filters
+
+  private:
+    //[elevation ft, climb ft/s, baro bias ft]
+    KalmanFilter<3> elevation;
+    unsigned long elevationMs=0;
+    bool elevationStarted=false;
+    bool elevationAnchored=false;  //had a GPS or DEM fix, so bias is observable
+
+    //[speed mph, acceleration mph/s]
+    KalmanFilter<2> speed;
+    unsigned long speedMs=0;
+    bool speedStarted=false;
+
+    //[headwind mph]
+    KalmanFilter<1> wind;
+    unsigned long windMs=0;
+    bool windStarted=false;
+
+    void predictElevation(unsigned long ms);
+    void predictSpeed(unsigned long ms);
+    void predictWind(unsigned long ms);
+    static float elapsedSeconds(unsigned long &lastMs, unsigned long ms);
+    static float confidence(float variance, float scale);
+};
+
+#endif
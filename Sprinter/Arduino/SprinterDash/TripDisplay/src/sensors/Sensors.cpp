@@ -91,6 +91,7 @@ void Barometer::update()
       //Read altitude result
       int baroElevation = baro.getLastConversionResults(MPL3115A2_ALTITUDE) * 3.28084;
       rawElevation = baroElevation;  // store true raw value before any offset
+      readingCount++;
 
       if(!online && pressure!=0)
       {
@@ -145,6 +146,11 @@ int Barometer::getElevationOffset()
   return elevationOffset;
 }
 
+unsigned long Barometer::getReadingCount()
+{
+  return readingCount;
+}
+
 double Barometer::getPressure()
 {
   return pressure;
@@ -351,6 +357,7 @@ int Pitot::readSpeed(int obdMph)
 
   //Light EMA on top of slew-limited value
   _mph = _tempmph * emaNewWeight + _mph * (1.0f - emaNewWeight);
+  _readingCount++;
 
   return _mph;
 }
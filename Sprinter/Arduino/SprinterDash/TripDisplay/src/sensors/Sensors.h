@@ -27,6 +27,7 @@ class Barometer
     int getRawElevation();       // uncorrected baro reading (for calibration input)
     void setElevationOffset(int offset);  // set from ElevationAPI auto-calibration
     int getElevationOffset();    // current offset being applied
+    unsigned long getReadingCount();  // altitude readings so far, to spot a new one
     double getPressure();
     
   private: 
@@ -35,6 +36,7 @@ class Barometer
     bool online=false;
     int elevationOffset=0;
     int currentElevReadCount=0;
+    unsigned long readingCount=0;
 
     //Filter for outlier values
     Filter filter;
@@ -109,6 +111,7 @@ public:
   double   calibrate(int actualSpeed);
   void     setCalibrationFactor(double_t factor);
   int      readSpeed(int obdMph = -1);
+  unsigned long getReadingCount() { return _readingCount; };  // good reads so far
   int      state()        { return _state; };
 
 private:
@@ -127,6 +130,7 @@ private:
   unsigned long _lastLogTime = 0;   //for periodic diagnostic logging
   int _i2cErrors = 0;               //count errors between logs
   int _reads = 0;                   //count reads between logs
+  unsigned long _readingCount = 0;  //good reads since boot
 };
 
 class IgnState 
@@ -21,9 +21,13 @@
 //    5. Compute offset = (API elevation) - (raw baro elevation)
 //    6. Sanity-check the offset, then apply it
 //
-//  The offset is stored externally in PropBag (EEPROM) by the caller so it
+//  With a cached DEM tile for the position (ElevationTiles), step 2 reads
+//  the tile instead and needs no network.  While WiFi is up, update() also
+//  prefetches tiles ahead of us and along the recorded track.
+//
+//  The offset is stored externally in PropBag by the caller so it
 //  persists across reboots.  This module only computes the offset value;
-//  it doesn't write EEPROM itself.
+//  it doesn't save it itself.
 // ============================================================================
 
 
@@ -35,17 +39,43 @@ void ElevationAPI::init()
     lastCalibMillis = 0;
     nextCalibMillis = 0;  // calibrate ASAP on first call
     calibCount = 0;
+
+    // LittleFS is mounted by TrackLogger::init()
+    if (tileStore.begin() && tiles.begin(&tileStore))
+        logger.log(INFO, "ElevationAPI: tile cache %d/%d tiles", tiles.getTileCount(), tiles.getSlotCount());
+    else
+        logger.log(WARNING, "ElevationAPI: no tile cache, calibrating online only");
 }
 
 // ----------------------------------------------------------------------------
-//  update() — Call from loop() when WiFi + GPS are available
+//  update() — Call from loop() on every GPS fix
 // ----------------------------------------------------------------------------
-//  Self-throttled: only queries the API when nextCalibMillis has elapsed.
+//  Records the track for prefetch, prefetches a tile if online, then
+//  calibrates if it's time.
 //  rawBaroElevFeet is the UNCORRECTED barometer altitude (before offset).
 //
 //  Returns true if a new calibration offset was just computed.
 
-bool ElevationAPI::update(float lat, float lon, int rawBaroElevFeet)
+bool ElevationAPI::update(float lat, float lon, int rawBaroElevFeet, bool online, float courseDeg)
+{
+    if (!(lat == 0.0 && lon == 0.0))
+    {
+        tiles.addTrackPoint(lat, lon);
+        if (courseDeg >= 0)
+            tiles.setHeading(courseDeg);
+        if (online)
+            prefetch(lat, lon);
+    }
+
+    return calibrate(lat, lon, rawBaroElevFeet, online);
+}
+
+// ----------------------------------------------------------------------------
+//  calibrate() — Self-throttled: only runs when nextCalibMillis has elapsed.
+//  Uses a cached tile when there is one, otherwise the API if online.
+// ----------------------------------------------------------------------------
+
+bool ElevationAPI::calibrate(float lat, float lon, int rawBaroElevFeet, bool online)
 {
     // Not time yet?
     if (millis() < nextCalibMillis)
@@ -63,9 +93,19 @@ bool ElevationAPI::update(float lat, float lon, int rawBaroElevFeet)
         return false;
     }
 
-    // Query the API
+    // Cached tile first (free, works offline), then the API
     float apiElevMeters = 0;
-    if (!queryAPI(lat, lon, apiElevMeters))
+    bool fromTiles = tiles.isReady() && tiles.getElevation(lat, lon, apiElevMeters);
+    if (fromTiles)
+    {
+        nextCalibMillis = millis() + RECALIB_TILE_INTERVAL_MS;
+    }
+    else if (!online)
+    {
+        nextCalibMillis = millis() + TILE_RETRY_MS;
+        return false;
+    }
+    else if (!queryAPI(lat, lon, apiElevMeters))
     {
         logger.log(WARNING, "ElevationAPI: API query failed");
         return false;
@@ -90,37 +130,92 @@ bool ElevationAPI::update(float lat, float lon, int rawBaroElevFeet)
     // Apply the new offset
     elevationOffset = newOffset;
     calibrated = true;
+    calibFromTiles = fromTiles;
     lastCalibMillis = millis();
     calibCount++;
 
-    logger.log(INFO, "ElevationAPI: Calibrated! API=%f ft, Baro=%d ft, Offset=%d ft (count=%d)",
-               apiElevFeet, rawBaroElevFeet, elevationOffset, calibCount);
+    logger.log(INFO, "ElevationAPI: Calibrated from %s! DEM=%f ft, Baro=%d ft, Offset=%d ft (count=%d)",
+               fromTiles ? "tile" : "API", apiElevFeet, rawBaroElevFeet, elevationOffset, calibCount);
 
     return true;
 }
 
 // ----------------------------------------------------------------------------
-//  queryAPI() — HTTP GET to Open Topo Data, parse JSON response
+//  prefetch() — Fetch the next missing tile along the route, if it's time
+// ----------------------------------------------------------------------------
+//  One 100-point request at most every PREFETCH_INTERVAL_MS, and no more
+//  than PREFETCH_MAX_PER_DAY, to stay inside the free API limits.
+
+void ElevationAPI::prefetch(float lat, float lon)
+{
+    if (!tiles.isReady() || millis() < nextPrefetchMillis)
+        return;
+    nextPrefetchMillis = millis() + PREFETCH_INTERVAL_MS;
+
+    if (millis() - prefetchDayStart > 86400000UL)
+    {
+        prefetchDayStart = millis();
+        prefetchesToday = 0;
+    }
+    if (prefetchesToday >= PREFETCH_MAX_PER_DAY)
+        return;
+
+    int32_t latIdx, lonIdx;
+    if (!tiles.nextMissingTile(lat, lon, latIdx, lonIdx))
+        return;
+
+    prefetchesToday++;
+    if (!tiles.fetchTile(latIdx, lonIdx, &openTopo))
+    {
+        logger.log(WARNING, "ElevationAPI: Tile %ld,%ld fetch failed, backing off", (long)latIdx, (long)lonIdx);
+        nextPrefetchMillis = millis() + PREFETCH_BACKOFF_MS;
+        return;
+    }
+    logger.log(VERBOSE, "ElevationAPI: Tile %ld,%ld cached in %lu ms (%d tiles, %lu evicted)",
+               (long)latIdx, (long)lonIdx, openTopo.getLastRequestMs(), tiles.getTileCount(), tiles.getEvictions());
+}
+
+// ----------------------------------------------------------------------------
+//  queryAPI() — Single-point lookup for the current position
 // ----------------------------------------------------------------------------
-//  URL format: https://api.opentopodata.org/v1/ned10m?locations=47.65,-117.42
-//  Response:   {"results":[{"elevation":715.3,...}],"status":"OK"}
-//
 //  Returns true on success, writing the elevation (meters) to elevMeters.
 
 bool ElevationAPI::queryAPI(float lat, float lon, float &elevMeters)
 {
-    HTTPClient http;
+    logger.log(INFO, "ElevationAPI: lat=%f lon=%f", (double)lat, (double)lon);
 
-    // Build the API URL
-    char url[200];
-    snprintf(url, sizeof(url),
-             "https://%s/v1/%s?locations=%.6f,%.6f",
-             ELEVATION_API_HOST, ELEVATION_API_DATASET, lat, lon);
+    if (!openTopo.lookup(&lat, &lon, 1, &elevMeters))
+        return false;
 
-    logger.log(INFO, "ElevationAPI: GET %s", url);
-    logger.log(INFO, "ElevationAPI: lat=%f lon=%f", (double)lat, (double)lon);
+    // Null elevation happens when coordinates are outside dataset coverage
+    if (isnan(elevMeters))
+    {
+        logger.log(WARNING, "ElevationAPI: Null elevation (outside dataset coverage?)");
+        return false;
+    }
 
+    logger.log(VERBOSE, "ElevationAPI: API returned %f meters (%f feet)", elevMeters, elevMeters * 3.28084);
+    return true;
+}
 
+// ----------------------------------------------------------------------------
+//  OpenTopoSource — HTTP GET to Open Topo Data for up to 100 points
+// ----------------------------------------------------------------------------
+//  URL format: https://api.opentopodata.org/v1/aster30m?locations=47.65,-117.42|47.66,-117.41
+//  Response:   {"results":[{"elevation":715.3,...},...],"status":"OK"}
+
+bool OpenTopoSource::lookup(const float *lats, const float *lons, int count, float *elevMeters)
+{
+    char path[ELEV_QUERY_MAX];
+    if (ElevationTiles::buildQuery(path, sizeof(path), ELEVATION_API_DATASET, lats, lons, count) < 0)
+        return false;
+
+    String url = String("https://") + ELEVATION_API_HOST + path;
+    if (count == 1)
+        logger.log(INFO, "ElevationAPI: GET %s", url.c_str());
+
+    unsigned long start = millis();
+    HTTPClient http;
     http.begin(url);
     http.setTimeout(ELEVATION_API_TIMEOUT);
     int httpCode = http.GET();
@@ -132,47 +227,63 @@ bool ElevationAPI::queryAPI(float lat, float lon, float &elevMeters)
         return false;
     }
 
-    // Parse JSON response
-    // Example: {"results":[{"dataset":"ned10m","elevation":715.3,"location":{"lat":47.65,"lng":-117.42}}],"status":"OK"}
     String payload = http.getString();
     http.end();
+    lastRequestMs = millis() - start;
 
-    // Use ArduinoJson to parse
-    StaticJsonDocument<512> doc;
-    DeserializationError err = deserializeJson(doc, payload);
-    if (err)
+    if (!ElevationTiles::parseResponse(payload.c_str(), elevMeters, count))
     {
-        logger.log(WARNING, "ElevationAPI: JSON parse error: %s", err.c_str());
+        logger.log(WARNING, "ElevationAPI: Bad response (status not OK or too few results)");
         return false;
     }
+    return true;
+}
 
-    // Check status field
-    const char* status = doc["status"];
-    if (!status || strcmp(status, "OK") != 0)
-    {
-        logger.log(WARNING, "ElevationAPI: API status not OK");
-        return false;
-    }
+unsigned long OpenTopoSource::getLastRequestMs()
+{
+    return lastRequestMs;
+}
 
-    // Extract elevation from first result
-    JsonArray results = doc["results"];
-    if (results.size() == 0)
-    {
-        logger.log(WARNING, "ElevationAPI: No results in response");
-        return false;
-    }
+// ----------------------------------------------------------------------------
+//  LittleFSTileStore — fixed 220-byte slots in ELEVATION_TILE_FILE
+// ----------------------------------------------------------------------------
 
-    // Check for null elevation (happens when coordinates are outside dataset coverage)
-    if (results[0]["elevation"].isNull())
+bool LittleFSTileStore::begin()
+{
+    if (!LittleFS.exists(ELEVATION_TILE_DIR))
+        LittleFS.mkdir(ELEVATION_TILE_DIR);
+    if (!LittleFS.exists(ELEVATION_TILE_FILE))
     {
-        logger.log(WARNING, "ElevationAPI: Null elevation (outside NED coverage?)");
-        return false;
+        File created = LittleFS.open(ELEVATION_TILE_FILE, "w");
+        if (!created)
+            return false;
+        created.close();
     }
 
-    elevMeters = results[0]["elevation"].as<float>();
-    logger.log(VERBOSE, "ElevationAPI: API returned %f meters (%f feet)", elevMeters, elevMeters * 3.28084);
+    file = LittleFS.open(ELEVATION_TILE_FILE, "r+");
+    return (bool)file;
+}
 
-    return true;
+int LittleFSTileStore::getSlotCount()
+{
+    return ELEV_TILE_MAX_SLOTS;
+}
+
+bool LittleFSTileStore::readSlot(int slot, void *buffer, size_t length)
+{
+    // Slots past the end of the file haven't been written yet
+    if (!file || (size_t)(slot + 1) * length > file.size())
+        return false;
+    return file.seek(slot * length) && file.read((uint8_t *)buffer, length) == length;
+}
+
+bool LittleFSTileStore::writeSlot(int slot, const void *buffer, size_t length)
+{
+    if (!file || !file.seek(slot * length))
+        return false;
+    bool ok = file.write((const uint8_t *)buffer, length) == length;
+    file.flush();
+    return ok;
 }
 
 // ---- Accessors ----
@@ -206,3 +317,18 @@ int ElevationAPI::getCalibrationCount()
 {
     return calibCount;
 }
+
+bool ElevationAPI::lastCalibFromTiles()
+{
+    return calibFromTiles;
+}
+
+int ElevationAPI::getPrefetchesToday()
+{
+    return prefetchesToday;
+}
+
+unsigned long ElevationAPI::getLastFetchMs()
+{
+    return openTopo.getLastRequestMs();
+}
@@ -22,18 +22,26 @@
   Calibration strategy:
     - First calibration as soon as WiFi + GPS fix are both available
     - Re-calibrate every RECALIB_INTERVAL_MS (default 30 minutes)
-    - Offset is persisted in PropBag (EEPROM) so it survives reboots
+    - Offset is persisted in PropBag so it survives reboots
     - Uses a sanity check: ignores API results that differ from baro
       by more than MAX_REASONABLE_OFFSET_FT (default 2000 ft) to guard
       against bad GPS fixes or API errors
 
+  Offline calibration (ElevationTiles):
+    While WiFi is up, DEM tiles are prefetched along the heading and the
+    recorded track, one batched 100-point request at a time, into an LRU
+    cache on LittleFS.  With a tile for the current position, calibration
+    needs no network and runs every RECALIB_TILE_INTERVAL_MS, so the
+    offset keeps up over passes where there's no signal.
+
   Integration:
-    Called from the main loop() after GPS fix is confirmed. The module
+    Called from the main loop() on every GPS fix, online or not. The module
     manages its own timing and won't hit the API more than needed.
 */
 
 #include <HTTPClient.h>
-#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include "ElevationTiles.h"
 #include "../logging/logger.h"
 
 extern Logger logger;
@@ -55,17 +63,53 @@ extern Logger logger;
 // HTTP request timeout (ms)
 #define ELEVATION_API_TIMEOUT 8000
 
+// Tile cache and prefetch
+#define ELEVATION_TILE_DIR        "/dem"
+#define ELEVATION_TILE_FILE       "/dem/tiles.bin"
+#define RECALIB_TILE_INTERVAL_MS  300000UL   // from cached tiles: every 5 minutes
+#define TILE_RETRY_MS             60000UL    // offline and no tile here: look again in a minute
+#define PREFETCH_INTERVAL_MS      5000UL     // at most one tile request this often
+#define PREFETCH_BACKOFF_MS       60000UL    // after a failed request
+#define PREFETCH_MAX_PER_DAY      800        // leaves room under the 1000/day limit
+
+
+// Tile slots in one LittleFS file
+class LittleFSTileStore : public TileStore
+{
+  public:
+    bool begin();
+    int  getSlotCount();
+    bool readSlot(int slot, void *buffer, size_t length);
+    bool writeSlot(int slot, const void *buffer, size_t length);
+
+  private:
+    File file;
+};
+
+// Batched lookups against Open Topo Data
+class OpenTopoSource : public ElevationSource
+{
+  public:
+    bool lookup(const float *lats, const float *lons, int count, float *elevMeters);
+    unsigned long getLastRequestMs();   // how long the last request took
+
+  private:
+    unsigned long lastRequestMs = 0;
+};
+
 
 class ElevationAPI
 {
   public:
     void init();
 
-    // Call from loop() when WiFi is connected and GPS has fix.
+    // Call from loop() on every GPS fix.
     // Manages its own timing — safe to call every loop iteration.
     // rawBaroElevFeet = current barometer reading (feet) before offset
+    // online = WiFi is up (API calibration and tile prefetch)
+    // courseDeg = GPS course while moving, -1 if unknown
     // Returns true if a new calibration was just applied.
-    bool update(float lat, float lon, int rawBaroElevFeet);
+    bool update(float lat, float lon, int rawBaroElevFeet, bool online, float courseDeg = -1);
 
     // The computed offset (feet) to ADD to raw barometer readings.
     // Positive = baro reads too low, negative = baro reads too high.
@@ -81,10 +125,25 @@ class ElevationAPI
     float getLastAPIElevation();     // last elevation returned by API (feet)
     unsigned long getLastCalibTime(); // millis() of last successful calibration
     int   getCalibrationCount();     // number of successful calibrations this session
+    bool  lastCalibFromTiles();      // last calibration used the tile cache, not the API
+
+    // Tile cache status
+    ElevationTiles tiles;
+    int   getPrefetchesToday();
+    unsigned long getLastFetchMs();  // how long the last API request took
 
   private:
+    bool calibrate(float lat, float lon, int rawBaroElevFeet, bool online);
+    void prefetch(float lat, float lon);
     bool queryAPI(float lat, float lon, float &elevMeters);
 
+    LittleFSTileStore tileStore;
+    OpenTopoSource openTopo;
+    bool  calibFromTiles = false;
+    unsigned long nextPrefetchMillis = 0;
+    unsigned long prefetchDayStart = 0;
+    int   prefetchesToday = 0;
+
     int   elevationOffset = 0;       // feet, add to raw baro reading
     bool  calibrated = false;        // true after first successful calibration
     float lastAPIElevFeet = 0;       // for diagnostics
@@ -0,0 +1,385 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ElevationTiles.h"
+#include "../data/Journal.h"
+
+#define ELEV_TILE_MAGIC 0x4554   // "ET"
+#define DEG_2_RAD 0.01745329f
+#define EARTH_RADIUS_M 6371000.0f
+
+bool ElevationTiles::begin(TileStore *_store)
+{
+    store=_store;
+    ready=false;
+    currentSlot=-1;
+    useClock=0;
+    if(store==NULL)
+        return false;
+
+    slots=store->getSlotCount();
+    if(slots>ELEV_TILE_MAX_SLOTS)
+        slots=ELEV_TILE_MAX_SLOTS;
+
+    //Index every slot holding a good tile
+    for(int slot=0;slot<slots;slot++)
+    {
+        index[slot].used=false;
+        ElevationTile tile;
+        if(!store->readSlot(slot,&tile,sizeof(tile)))
+            continue;
+        if(tile.magic!=ELEV_TILE_MAGIC || tile.crc!=tileCrc(tile))
+            continue;
+        index[slot].used=true;
+        index[slot].latIdx=tile.latIdx;
+        index[slot].lonIdx=tile.lonIdx;
+        index[slot].stamp=tile.stamp;
+        if(tile.stamp>useClock)
+            useClock=tile.stamp;
+    }
+
+    ready=true;
+    return true;
+}
+
+bool ElevationTiles::isReady()
+{
+    return ready;
+}
+
+bool ElevationTiles::getElevation(float lat, float lon, float &meters)
+{
+    int32_t latIdx=tileIndex(lat);
+    int32_t lonIdx=tileIndex(lon);
+    int slot=ready ? findSlot(latIdx,lonIdx) : -1;
+    if(slot<0 || !loadSlot(slot))
+    {
+        misses++;
+        return false;
+    }
+    index[slot].stamp=++useClock;
+
+    //Position in sample units; samples sit at cell centres.  In the half
+    //sample round the tile edge, extend the outer pair rather than clamp.
+    float y=(float)((lat/ELEV_TILE_DEG-latIdx)*ELEV_TILE_SAMPLES)-0.5f;
+    float x=(float)((lon/ELEV_TILE_DEG-lonIdx)*ELEV_TILE_SAMPLES)-0.5f;
+    int y0=(int)floorf(y), x0=(int)floorf(x);
+    y0=y0<0 ? 0 : (y0>ELEV_TILE_SAMPLES-2 ? ELEV_TILE_SAMPLES-2 : y0);
+    x0=x0<0 ? 0 : (x0>ELEV_TILE_SAMPLES-2 ? ELEV_TILE_SAMPLES-2 : x0);
+    int y1=y0+1, x1=x0+1;
+    float fy=y-y0, fx=x-x0;
+
+    int16_t s00=current.elevation[y0*ELEV_TILE_SAMPLES+x0];
+    int16_t s01=current.elevation[y0*ELEV_TILE_SAMPLES+x1];
+    int16_t s10=current.elevation[y1*ELEV_TILE_SAMPLES+x0];
+    int16_t s11=current.elevation[y1*ELEV_TILE_SAMPLES+x1];
+    if(s00==ELEV_TILE_NODATA || s01==ELEV_TILE_NODATA || s10==ELEV_TILE_NODATA || s11==ELEV_TILE_NODATA)
+    {
+        //Coverage edge: nearest sample or nothing
+        int16_t nearest=current.elevation[(fy<0.5f ? y0 : y1)*ELEV_TILE_SAMPLES+(fx<0.5f ? x0 : x1)];
+        if(nearest==ELEV_TILE_NODATA)
+            return false;
+        meters=(float)nearest/ELEV_TILE_UNITS;
+        hits++;
+        return true;
+    }
+
+    float top=s00+(s01-s00)*fx;
+    float bottom=s10+(s11-s10)*fx;
+    meters=(top+(bottom-top)*fy)/ELEV_TILE_UNITS;
+    hits++;
+    return true;
+}
+
+bool ElevationTiles::hasTile(int32_t latIdx, int32_t lonIdx)
+{
+    return findSlot(latIdx,lonIdx)>=0;
+}
+
+bool ElevationTiles::fetchTile(int32_t latIdx, int32_t lonIdx, ElevationSource *source)
+{
+    if(!ready)
+        return false;
+
+    float lats[ELEV_TILE_POINTS];
+    float lons[ELEV_TILE_POINTS];
+    float elev[ELEV_TILE_POINTS];
+    for(int row=0;row<ELEV_TILE_SAMPLES;row++)
+    {
+        for(int col=0;col<ELEV_TILE_SAMPLES;col++)
+        {
+            lats[row*ELEV_TILE_SAMPLES+col]=(float)((latIdx+(row+0.5)/ELEV_TILE_SAMPLES)*ELEV_TILE_DEG);
+            lons[row*ELEV_TILE_SAMPLES+col]=(float)((lonIdx+(col+0.5)/ELEV_TILE_SAMPLES)*ELEV_TILE_DEG);
+        }
+    }
+    if(!source->lookup(lats,lons,ELEV_TILE_POINTS,elev))
+        return false;
+    fetches++;
+
+    ElevationTile tile;
+    memset(&tile,0,sizeof(tile));
+    tile.magic=ELEV_TILE_MAGIC;
+    tile.latIdx=latIdx;
+    tile.lonIdx=lonIdx;
+    tile.stamp=++useClock;
+    for(int i=0;i<ELEV_TILE_POINTS;i++)
+    {
+        float units=elev[i]*ELEV_TILE_UNITS;
+        if(isnan(units) || units<=ELEV_TILE_NODATA || units>32767)
+            tile.elevation[i]=ELEV_TILE_NODATA;
+        else
+            tile.elevation[i]=(int16_t)lroundf(units);
+    }
+    tile.crc=tileCrc(tile);
+
+    //Replace a copy we already have, else a free slot, else the LRU tile
+    int slot=findSlot(latIdx,lonIdx);
+    if(slot<0)
+        slot=chooseSlot();
+    if(slot==currentSlot)
+        currentSlot=-1;
+    if(!store->writeSlot(slot,&tile,sizeof(tile)))
+    {
+        index[slot].used=false;
+        return false;
+    }
+    index[slot].used=true;
+    index[slot].latIdx=latIdx;
+    index[slot].lonIdx=lonIdx;
+    index[slot].stamp=tile.stamp;
+    return true;
+}
+
+void ElevationTiles::addTrackPoint(float lat, float lon)
+{
+    int last=(trackHead+ELEV_TRACK_POINTS-1)%ELEV_TRACK_POINTS;
+    if(trackCount>0)
+    {
+        float moved=distanceMeters(trackLat[last],trackLon[last],lat,lon);
+        if(moved<ELEV_TRACK_SPACING_M)
+            return;
+
+        //Bearing from the last track point, used when GPS course isn't
+        float dLat=(lat-trackLat[last])*DEG_2_RAD;
+        float dLon=(lon-trackLon[last])*DEG_2_RAD*cosf(lat*DEG_2_RAD);
+        heading=atan2f(dLon,dLat)/DEG_2_RAD;
+        if(heading<0)
+            heading+=360;
+    }
+
+    trackLat[trackHead]=lat;
+    trackLon[trackHead]=lon;
+    trackHead=(trackHead+1)%ELEV_TRACK_POINTS;
+    if(trackCount<ELEV_TRACK_POINTS)
+        trackCount++;
+}
+
+void ElevationTiles::setHeading(float degrees)
+{
+    heading=degrees;
+}
+
+bool ElevationTiles::nextMissingTile(float lat, float lon, int32_t &latIdx, int32_t &lonIdx)
+{
+    if(!ready)
+        return false;
+
+    //Where we are
+    if(missingAt(lat,lon,latIdx,lonIdx))
+        return true;
+
+    //Straight ahead, in steps a bit under a tile so none are skipped
+    const float step=ELEV_TILE_DEG*111320.0f*0.7f;
+    if(heading>=0)
+    {
+        for(int i=1;i<=ELEV_AHEAD_TILES;i++)
+        {
+            float aheadLat, aheadLon;
+            offsetPosition(lat,lon,heading,step*i,aheadLat,aheadLon);
+            if(missingAt(aheadLat,aheadLon,latIdx,lonIdx))
+                return true;
+        }
+    }
+
+    //Around us
+    for(int dLat=-1;dLat<=1;dLat++)
+        for(int dLon=-1;dLon<=1;dLon++)
+            if(missingAt(lat+dLat*ELEV_TILE_DEG,lon+dLon*ELEV_TILE_DEG,latIdx,lonIdx))
+                return true;
+
+    //A lane either side of the road ahead, for bends
+    if(heading>=0)
+    {
+        for(int i=1;i<=ELEV_AHEAD_TILES;i++)
+        {
+            float aheadLat, aheadLon, sideLat, sideLon;
+            offsetPosition(lat,lon,heading,step*i,aheadLat,aheadLon);
+            offsetPosition(aheadLat,aheadLon,heading+90,step,sideLat,sideLon);
+            if(missingAt(sideLat,sideLon,latIdx,lonIdx))
+                return true;
+            offsetPosition(aheadLat,aheadLon,heading-90,step,sideLat,sideLon);
+            if(missingAt(sideLat,sideLon,latIdx,lonIdx))
+                return true;
+        }
+    }
+
+    //The recorded track, newest first: covers the drive back.  Midpoints
+    //too, for tiles the road only clips the corner of.
+    for(int i=1;i<=trackCount;i++)
+    {
+        int point=(trackHead+ELEV_TRACK_POINTS-i)%ELEV_TRACK_POINTS;
+        if(missingAt(trackLat[point],trackLon[point],latIdx,lonIdx))
+            return true;
+        if(i==trackCount)
+            break;
+        int older=(point+ELEV_TRACK_POINTS-1)%ELEV_TRACK_POINTS;
+        if(missingAt((trackLat[point]+trackLat[older])/2,(trackLon[point]+trackLon[older])/2,latIdx,lonIdx))
+            return true;
+    }
+    return false;
+}
+
+unsigned long ElevationTiles::getHits()
+{
+    return hits;
+}
+
+unsigned long ElevationTiles::getMisses()
+{
+    return misses;
+}
+
+unsigned long ElevationTiles::getFetches()
+{
+    return fetches;
+}
+
+unsigned long ElevationTiles::getEvictions()
+{
+    return evictions;
+}
+
+int ElevationTiles::getTileCount()
+{
+    int count=0;
+    for(int slot=0;slot<slots;slot++)
+        if(index[slot].used)
+            count++;
+    return count;
+}
+
+int ElevationTiles::getSlotCount()
+{
+    return slots;
+}
+
+int32_t ElevationTiles::tileIndex(float degrees)
+{
+    return (int32_t)floor((double)degrees/ELEV_TILE_DEG);
+}
+
+int ElevationTiles::buildQuery(char *buffer, size_t size, const char *dataset,
+                               const float *lats, const float *lons, int count)
+{
+    int length=snprintf(buffer,size,"/v1/%s?locations=",dataset);
+    for(int i=0;i<count && length<(int)size;i++)
+        length+=snprintf(buffer+length,size-length,"%s%.5f,%.5f",i ? "|" : "",(double)lats[i],(double)lons[i]);
+    return length<(int)size ? length : -1;
+}
+
+bool ElevationTiles::parseResponse(const char *json, float *elevMeters, int count)
+{
+    //{"results":[{"dataset":"aster30m","elevation":815.0,"location":{...}},...],"status":"OK"}
+    const char *status=strstr(json,"\"status\"");
+    if(status==NULL || strstr(status,"\"OK\"")==NULL)
+        return false;
+
+    const char *p=json;
+    for(int i=0;i<count;i++)
+    {
+        p=strstr(p,"\"elevation\"");
+        if(p==NULL)
+            return false;
+        p+=strlen("\"elevation\"");
+        while(*p==' ' || *p==':')
+            p++;
+
+        if(strncmp(p,"null",4)==0)
+        {
+            elevMeters[i]=NAN;
+            continue;
+        }
+        char *end;
+        elevMeters[i]=strtof(p,&end);
+        if(end==p)
+            return false;
+        p=end;
+    }
+    return true;
+}
+
+int ElevationTiles::findSlot(int32_t latIdx, int32_t lonIdx)
+{
+    for(int slot=0;slot<slots;slot++)
+        if(index[slot].used && index[slot].latIdx==latIdx && index[slot].lonIdx==lonIdx)
+            return slot;
+    return -1;
+}
+
+int ElevationTiles::chooseSlot()
+{
+    int oldest=0;
+    for(int slot=0;slot<slots;slot++)
+    {
+        if(!index[slot].used)
+            return slot;
+        if(index[slot].stamp<index[oldest].stamp)
+            oldest=slot;
+    }
+    evictions++;
+    return oldest;
+}
+
+bool ElevationTiles::loadSlot(int slot)
+{
+    if(slot==currentSlot)
+        return true;
+
+    currentSlot=-1;
+    if(!store->readSlot(slot,&current,sizeof(current)) ||
+       current.magic!=ELEV_TILE_MAGIC || current.crc!=tileCrc(current))
+    {
+        index[slot].used=false;   //gone bad on flash: fetch it again
+        return false;
+    }
+    currentSlot=slot;
+    return true;
+}
+
+bool ElevationTiles::missingAt(float lat, float lon, int32_t &latIdx, int32_t &lonIdx)
+{
+    latIdx=tileIndex(lat);
+    lonIdx=tileIndex(lon);
+    return findSlot(latIdx,lonIdx)<0;
+}
+
+uint32_t ElevationTiles::tileCrc(const ElevationTile &tile)
+{
+    return Journal::crc32(0,&tile,offsetof(ElevationTile,crc));
+}
+
+float ElevationTiles::distanceMeters(float lat1, float lon1, float lat2, float lon2)
+{
+    float dLat=(lat2-lat1)*DEG_2_RAD;
+    float dLon=(lon2-lon1)*DEG_2_RAD*cosf(lat1*DEG_2_RAD);
+    return sqrtf(dLat*dLat+dLon*dLon)*EARTH_RADIUS_M;
+}
+
+void ElevationTiles::offsetPosition(float lat, float lon, float bearing, float meters,
+                                    float &outLat, float &outLon)
+{
+    float b=bearing*DEG_2_RAD;
+    outLat=lat+meters*cosf(b)/EARTH_RADIUS_M/DEG_2_RAD;
+    outLon=lon+meters*sinf(b)/(EARTH_RADIUS_M*cosf(lat*DEG_2_RAD))/DEG_2_RAD;
+}
@@ -0,0 +1,155 @@
+#ifndef ElevationTiles_h
+#define ElevationTiles_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  ElevationTiles — On-flash cache of DEM elevation tiles
+  ======================================================
+  Lets ElevationAPI calibrate the barometer from a GPS fix with no network,
+  by looking the ground elevation up in tiles fetched earlier.
+
+  Tiles:
+    A tile is a 0.01 x 0.01 degree cell (~1.1 x 0.8 km) holding a 10 x 10
+    grid of elevations at the cell centres, i.e. 100 points: exactly one
+    batched Open Topo Data request.  Elevations are stored as int16 half
+    meters, so a tile is 220 bytes with its header and CRC.  Lookups
+    interpolate bilinearly between the four nearest samples.
+
+  Cache:
+    Tiles live in fixed slots in one file (TileStore), with an in-RAM index
+    of which tile is in which slot.  A full cache evicts the least recently
+    used tile.  Use stamps are written when a tile is stored and kept in
+    RAM on hits, so LRU order survives a reboot approximately.
+
+  Prefetch:
+    addTrackPoint() keeps a ring of the recorded track (a point every
+    500 m, ~64 km).  nextMissingTile() picks what to fetch next while
+    WiFi is up: the current tile, then tiles ahead along the heading, the
+    tiles around us, a lane either side of the road ahead, and finally the
+    recorded track (newest first) so the way back is covered.
+
+  The store and the elevation source are interfaces, so
+  test/ElevationCacheBench runs the cache, planner, request builder and
+  response parser against a local stub server.
+*/
+
+#define ELEV_TILE_DEG          0.01     // tile edge, degrees
+#define ELEV_TILE_SAMPLES      10       // samples per edge: 100 points per tile
+#define ELEV_TILE_POINTS       (ELEV_TILE_SAMPLES*ELEV_TILE_SAMPLES)
+#define ELEV_TILE_UNITS        2        // stored units per meter (half meters)
+#define ELEV_TILE_NODATA       -32768   // sample outside dataset coverage
+#define ELEV_TILE_MAX_SLOTS    512      // most tiles a store can hold (~110 KB)
+
+#define ELEV_TRACK_SPACING_M   500      // keep a track point every this far
+#define ELEV_TRACK_POINTS      128      // ~64 km of recorded track
+#define ELEV_AHEAD_TILES       15       // look this many tile-steps ahead (~15 km)
+
+#define ELEV_QUERY_MAX         2400     // request path for a full tile
+
+struct ElevationTile
+{
+    uint16_t magic;
+    uint16_t reserved;
+    int32_t  latIdx;          // floor(lat / ELEV_TILE_DEG)
+    int32_t  lonIdx;
+    uint32_t stamp;           // LRU use stamp when written
+    int16_t  elevation[ELEV_TILE_POINTS];   // [lat row][lon column], half meters
+    uint32_t crc;             // over everything above
+};
+
+// Fixed-size tile slots (a LittleFS file on the dash, a plain file on the host)
+class TileStore
+{
+  public:
+    virtual ~TileStore() {}
+    virtual int  getSlotCount()=0;
+    virtual bool readSlot(int slot, void *buffer, size_t length)=0;
+    virtual bool writeSlot(int slot, const void *buffer, size_t length)=0;
+};
+
+// Batched elevation lookup (Open Topo Data on the dash, a stub server on the host)
+class ElevationSource
+{
+  public:
+    virtual ~ElevationSource() {}
+    // elevMeters[i] for each point, NAN where the dataset has no data.
+    // Returns false if the request failed.
+    virtual bool lookup(const float *lats, const float *lons, int count, float *elevMeters)=0;
+};
+
+class ElevationTiles
+{
+  public:
+    bool begin(TileStore *_store);   // read the slot index; false without a store
+    bool isReady();
+
+    // Ground elevation from cached tiles only (meters).  False on a miss.
+    bool getElevation(float lat, float lon, float &meters);
+    bool hasTile(int32_t latIdx, int32_t lonIdx);
+
+    // Fetch one tile with a single batched request and cache it
+    bool fetchTile(int32_t latIdx, int32_t lonIdx, ElevationSource *source);
+
+    // Route-ahead prefetch planning
+    void addTrackPoint(float lat, float lon);
+    void setHeading(float degrees);  // GPS course when moving; otherwise taken from the track
+    bool nextMissingTile(float lat, float lon, int32_t &latIdx, int32_t &lonIdx);
+
+    // Stats
+    unsigned long getHits();
+    unsigned long getMisses();
+    unsigned long getFetches();
+    unsigned long getEvictions();
+    int getTileCount();
+    int getSlotCount();
+
+    static int32_t tileIndex(float degrees);
+
+    // Open Topo Data request path for a batch: /v1/<dataset>?locations=lat,lon|lat,lon...
+    static int  buildQuery(char *buffer, size_t size, const char *dataset,
+                           const float *lats, const float *lons, int count);
+    // Pull count elevations (meters, NAN for null) out of an Open Topo Data response
+    static bool parseResponse(const char *json, float *elevMeters, int count);
+
+  private:
+    struct Slot
+    {
+        bool     used;
+        int32_t  latIdx;
+        int32_t  lonIdx;
+        uint32_t stamp;
+    };
+
+    TileStore *store=NULL;
+    bool ready=false;
+    int slots=0;
+    Slot index[ELEV_TILE_MAX_SLOTS];
+    uint32_t useClock=0;
+
+    ElevationTile current;     // last tile read, so repeated lookups don't hit flash
+    int currentSlot=-1;
+
+    float trackLat[ELEV_TRACK_POINTS];
+    float trackLon[ELEV_TRACK_POINTS];
+    int trackCount=0;
+    int trackHead=0;           // where the next point goes
+    float heading=-1;          // degrees, -1 until known
+
+    unsigned long hits=0;
+    unsigned long misses=0;
+    unsigned long fetches=0;
+    unsigned long evictions=0;
+
+    int  findSlot(int32_t latIdx, int32_t lonIdx);
+    int  chooseSlot();
+    bool loadSlot(int slot);
+    bool missingAt(float lat, float lon, int32_t &latIdx, int32_t &lonIdx);
+
+    static uint32_t tileCrc(const ElevationTile &tile);
+    static float distanceMeters(float lat1, float lon1, float lat2, float lon2);
+    static void offsetPosition(float lat, float lon, float bearing, float meters, float &outLat, float &outLon);
+};
+
+#endif
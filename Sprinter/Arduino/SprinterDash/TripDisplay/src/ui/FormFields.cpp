@@ -0,0 +1,244 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "FormFields.h"
+#include "../data/FuelModel.h"
+
+/////////////////////////////////////////////
+// Formatters
+///////////////////////////////////////////
+
+static bool isFieldTooLong(long value,int fieldLen)
+{
+    return value<0 || value>(pow(10,fieldLen)-1);
+}
+
+void formatNumber(char *text,int len,double number)
+{
+    //Value in range?
+    if(isFieldTooLong(number,len))
+    {
+        snprintf(text,FORM_FIELD_TEXT,"%s","ERR");
+        return;
+    }
+
+    //Room to put a decimal or not?
+    if(number<=(pow(10,len-2)-1) && number>0 && len>2)
+        snprintf(text,FORM_FIELD_TEXT,"%*.1f",len,number);
+    else
+        snprintf(text,FORM_FIELD_TEXT,"%*d",len,(int)number);
+}
+
+//Converts hours to minutes, hours, etc
+// .5 hours --> 30m
+// 3.5 hours --> 3.5H
+// 36 hours --> 1.5D
+// 168 hours --> 1.0W
+// 720 hours --> 1.0M
+void formatHours(char *text,int len,double hours)
+{
+    //display minutes?  (one digit more than hours, which have a decimal)
+    if(hours<1.0)
+    {
+        int minutes=hours*60.0;
+        if(isFieldTooLong(minutes*10,len))
+            snprintf(text,FORM_FIELD_TEXT,"%s","ERR");
+        else
+            snprintf(text,FORM_FIELD_TEXT,"%dm",minutes);
+        return;
+    }
+
+    //Then the largest unit under its limit
+    const double hoursPer[]={1,24,168,720};
+    const double below[]={24,168,720,0};
+    const char units[]={'H','D','W','M'};
+    int unit=0;
+    while(below[unit]>0 && hours>=below[unit])
+        unit++;
+
+    double value=hours/hoursPer[unit];
+    if(isFieldTooLong(value*10.0,len))
+        snprintf(text,FORM_FIELD_TEXT,"%s","ERR");
+    else
+        snprintf(text,FORM_FIELD_TEXT,"%.1f%c",value,units[unit]);
+}
+
+static bool isTextTooLong(const char *text,int fieldLen)
+{
+    return (int)strlen(text)>fieldLen;
+}
+
+void formatElevation(char *text,int len,double feet)
+{
+    //Under 10K as is, then in K, without the decimal if that doesn't fit
+    int elevation=feet;
+    if(elevation<10000)
+        snprintf(text,FORM_FIELD_TEXT,"%d",elevation);
+    else
+    {
+        snprintf(text,FORM_FIELD_TEXT,"%.1fK",elevation/1000.0);
+        if(isTextTooLong(text,len))
+            snprintf(text,FORM_FIELD_TEXT,"%dK",elevation/1000);
+    }
+
+    if(isTextTooLong(text,len))
+        snprintf(text,FORM_FIELD_TEXT,"%s","ERR");
+}
+
+//Gallons to fill up and oz of additive for them, just the gallons if that doesn't fit
+void formatGallonsExpected(char *text,int len,double gallons)
+{
+    int gallExp=gallons;
+    int ozToAdd=gallons*FUEL_ADDITIVE_RATIO;
+    snprintf(text,FORM_FIELD_TEXT,"%d (%doz)",gallExp,ozToAdd);
+    if(isTextTooLong(text,len))
+        snprintf(text,FORM_FIELD_TEXT,"%d",gallExp);
+    if(isTextTooLong(text,len))
+        snprintf(text,FORM_FIELD_TEXT,"%s","ERR");
+}
+
+//If we have a valid avg mpg, show it
+void formatMPG(char *text,int len,double mpg)
+{
+    if(mpg>0 && mpg<30)
+        formatNumber(text,len,mpg);
+    else
+        snprintf(text,FORM_FIELD_TEXT,"%s","---");
+}
+
+
+/////////////////////////////////////////////
+// FieldForm
+///////////////////////////////////////////
+
+FieldForm::FieldForm(int _formID,const FormField *_fields,int _count,FieldSource *_source,const char *_title)
+{
+    formID=_formID;
+    fields=_fields;
+    count=_count<FORM_MAX_FIELDS ? _count : FORM_MAX_FIELDS;
+    source=_source;
+    title=_title ? _title : "";
+    invalidate();
+}
+
+int FieldForm::getFormId()
+{
+    return formID;
+}
+
+int FieldForm::getFieldCount()
+{
+    return count;
+}
+
+const char *FieldForm::getText(int index)
+{
+    return written[index] ? text[index] : "";
+}
+
+void FieldForm::invalidate()
+{
+    for(int i=0;i<count;i++)
+    {
+        written[i]=false;
+        nextMs[i]=0;
+    }
+}
+
+void FieldForm::render(int index,char *buffer)
+{
+    const FormField &field=fields[index];
+    if(field.format==NULL)
+        snprintf(buffer,FORM_FIELD_TEXT,"%s",title);
+    else
+        field.format(buffer,field.len,source->getValue(field.source));
+}
+
+//Render the field if it's due, and write it if it changed
+int FieldForm::refreshField(int index,unsigned long nowMs,FieldSink *sink)
+{
+    const FormField &field=fields[index];
+    if(written[index] && (field.refreshMs==FORM_REFRESH_ONCE || nowMs<nextMs[index]))
+        return FIELD_NOT_DUE;
+    nextMs[index]=nowMs+field.refreshMs;
+
+    char buffer[FORM_FIELD_TEXT];
+    render(index,buffer);
+    if(written[index] && strcmp(buffer,text[index])==0)
+        return FIELD_UNCHANGED;
+
+    sink->writeStr(field.objNum,buffer);
+    strcpy(text[index],buffer);
+    written[index]=true;
+    return FIELD_WRITTEN;
+}
+
+
+/////////////////////////////////////////////
+// FormScheduler
+///////////////////////////////////////////
+
+FormScheduler::FormScheduler(FieldSink *_sink,unsigned long (*_clockUs)())
+{
+    sink=_sink;
+    clockUs=_clockUs;
+}
+
+void FormScheduler::setForm(FieldForm *_form)
+{
+    if(_form==form)
+        return;
+
+    //Whatever's on the screen belongs to the last form (summaries share one)
+    form=_form;
+    cursor=0;
+    invalidate();
+}
+
+FieldForm *FormScheduler::getForm()
+{
+    return form;
+}
+
+void FormScheduler::invalidate()
+{
+    if(form)
+        form->invalidate();
+}
+
+//Go round the fields from where the last slice stopped.  Always writes at
+//least one, so a tight budget still gets there.
+int FormScheduler::update(unsigned long nowMs,unsigned long budgetUs)
+{
+    if(form==NULL)
+        return 0;
+
+    unsigned long startUs=clockUs();
+    int count=form->getFieldCount();
+    int written=0;
+    for(int i=0;i<count;i++)
+    {
+        if(written>0 && clockUs()-startUs>=budgetUs)
+            break;
+
+        int result=form->refreshField(cursor,nowMs,sink);
+        if(result==FIELD_WRITTEN)
+            written++;
+        if(result==FIELD_UNCHANGED)
+            skipped++;
+        cursor=(cursor+1)%count;
+    }
+
+    writes+=written;
+    return written;
+}
+
+unsigned long FormScheduler::getWrites()
+{
+    return writes;
+}
+
+unsigned long FormScheduler::getSkipped()
+{
+    return skipped;
+}
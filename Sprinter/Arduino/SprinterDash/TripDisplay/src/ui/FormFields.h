@@ -0,0 +1,113 @@
+#ifndef FormFields_h
+#define FormFields_h
+
+//
+// Table-driven text forms for the Genie display.
+//
+// A form is a table of FormFields: which Genie string object, where its
+// value comes from, how it's formatted and how often it's refreshed (see
+// FormTables.cpp).  One FormScheduler drives whichever form is showing.
+// It renders the fields that are due, writes only those whose text
+// changed, and stops once its time slice for the loop is used up, carrying
+// on from there next loop.
+//
+// Values come in through a FieldSource and text goes out through a
+// FieldSink, so test/FormSnapshot renders the same tables to text.
+//
+
+#include <stddef.h>
+
+#define FORM_MAX_FIELDS 16
+#define FORM_FIELD_TEXT 16        //buffer each field renders into, with the 0
+#define FORM_REFRESH_ONCE 0       //refreshMs for fields that only change on activation
+
+//What FieldForm::refreshField() did
+#define FIELD_NOT_DUE 0
+#define FIELD_UNCHANGED 1
+#define FIELD_WRITTEN 2
+
+//Writes value into text (FORM_FIELD_TEXT long), for a field with room for len characters
+typedef void (*FieldFormatter)(char *text,int len,double value);
+
+struct FormField
+{
+    int objNum;                   //Genie string object
+    int source;                   //what the FieldSource returns for it
+    FieldFormatter format;        //NULL writes the form's title instead
+    int len;                      //characters the field has room for
+    unsigned long refreshMs;      //how often to render it again
+};
+
+//Where field values come from
+class FieldSource
+{
+  public:
+    virtual double getValue(int source)=0;
+};
+
+//Where rendered text goes
+class FieldSink
+{
+  public:
+    virtual void writeStr(int objNum,const char *text)=0;
+};
+
+//Formatters.  Values that don't fit show "ERR".
+void formatNumber(char *text,int len,double value);         //"12.5" if there's room for a decimal, else "  12"
+void formatHours(char *text,int len,double hours);          //"30m", "3.5H", "1.5D", "1.0W", "1.0M"
+void formatElevation(char *text,int len,double feet);       //"9500", "12.3K", "123K"
+void formatGallonsExpected(char *text,int len,double gallons);  //"12 (4oz)" with the additive, "12" if that doesn't fit
+void formatMPG(char *text,int len,double mpg);              //"---" until there's a sensible average
+
+//One form: a table of fields and what's on the screen for each
+class FieldForm
+{
+  public:
+    FieldForm(int formID,const FormField *fields,int count,FieldSource *source,const char *title=NULL);
+
+    int getFormId();
+    int getFieldCount();
+    const char *getText(int index);     //last written, "" if not yet
+
+    void invalidate();                  //the screen was redrawn: write every field again
+    int refreshField(int index,unsigned long nowMs,FieldSink *sink);    //FIELD_*
+
+  private:
+    int formID;
+    const FormField *fields;
+    int count;
+    FieldSource *source;
+    const char *title;
+
+    char text[FORM_MAX_FIELDS][FORM_FIELD_TEXT];
+    bool written[FORM_MAX_FIELDS];
+    unsigned long nextMs[FORM_MAX_FIELDS];
+
+    void render(int index,char *buffer);
+};
+
+//Keeps the showing form up to date, a time slice at a time
+class FormScheduler
+{
+  public:
+    FormScheduler(FieldSink *sink,unsigned long (*clockUs)());
+
+    void setForm(FieldForm *form);      //NULL when a non-text form is showing
+    FieldForm *getForm();
+    void invalidate();                  //call when the display activates a form
+    int update(unsigned long nowMs,unsigned long budgetUs);   //returns fields written
+
+    unsigned long getWrites();          //since boot, for diagnostics
+    unsigned long getSkipped();         //rendered but unchanged, so not written
+
+  private:
+    FieldSink *sink;
+    unsigned long (*clockUs)();
+    FieldForm *form=NULL;
+    int cursor=0;
+
+    unsigned long writes=0;
+    unsigned long skipped=0;
+};
+
+#endif
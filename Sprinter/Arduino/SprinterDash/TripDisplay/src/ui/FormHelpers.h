@@ -2,14 +2,11 @@
 #define FormHelper_h
 
 #include <genieArduino.h>
+#include "FormFields.h"
 #include "../logging/logger.h"
 
 extern Logger logger;
 
-//Field masks for sprintfs  (used by StrField class)
-extern char dblFormat[];
-extern char decFormat[];
-
 //Form object numbers
 #define PRIMARY_FORM 0
 #define STOPPED_FORM 1
@@ -60,7 +57,7 @@ extern char decFormat[];
 class FormNavigator
 {
   public:
-    void init(Genie *geniePtr);
+    void init(Genie *geniePtr,FormScheduler *formSchedulerPtr);
     int determineAction(genieFrame *Event);
     void activateForm(int formObjNumber);
 
@@ -69,20 +66,10 @@ class FormNavigator
 
   private:
     Genie *geniePtr;
+    FormScheduler *formSchedulerPtr=NULL;
 
     int currentActiveForm=BOOT_FORM;
     int lastActiveForm=BOOT_FORM;
 };
 
-class StrField 
-{
-  public:
-    void updateHoursField(Genie *geniePtr,int objNum,char *title,double value,int fieldLen);
-    void updateElevationField(Genie *geniePtr,int objNum,char *title,long value,int fieldLen);
-    void updateNumberField(Genie *geniePtr,int objNum,char *title,double value,int fieldLen);
-
-  private: 
-    bool isFieldTooLong(long value,int fieldLen);
-};
-
 #endif
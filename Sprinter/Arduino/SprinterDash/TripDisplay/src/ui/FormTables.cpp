@@ -0,0 +1,63 @@
+#include "FormTables.h"
+
+//Genie string objects
+#define HEATER_FUEL_STRING 32
+#define MILES_DRIVEN_STRING 29
+#define TIME_ELAPSED_STRING 30
+
+#define MILES_SINCE_STOP_STRING 4
+#define HOURS_ELAPSED_STRING 5
+#define GALLONS_EXPECTED_STRING 9
+#define AVG_MPG_STRING_1 38
+
+#define TITLE_STRING 12
+#define DRIVING_TIME_STRING 17
+#define ELASPED_TIME_STRING 18
+#define TIME_STOPPED_STRING 19
+#define NUM_STOPS_STRING 27
+#define TIME_PARKED_STRING 3
+#define MILES_STRING 13
+#define GALLONS_STRING 21
+#define AVG_MPG_STRING 23
+#define AVG_MOV_SPEED_STRING 25
+#define ELEVATION_GAIN_STRING 10
+
+//Refresh periods.  Only changed text is written, so these bound how stale
+//a field can get, not how busy the serial line is.
+#define REFRESH_FAST 1000
+#define REFRESH_SLOW 5000   //fuel, which moves a percent at a time
+
+const FormField startingFields[]={
+    //obj num                source                   formatter              len  refresh
+    { HEATER_FUEL_STRING,    FIELD_HEATER_GALLONS,    formatNumber,          2,   REFRESH_SLOW },
+    { MILES_DRIVEN_STRING,   FIELD_MILES_TRAVELLED,   formatNumber,          4,   REFRESH_FAST },
+    { TIME_ELAPSED_STRING,   FIELD_PARKED_TIME,       formatHours,           4,   REFRESH_FAST },
+};
+const int startingFieldCount=sizeof(startingFields)/sizeof(startingFields[0]);
+
+const FormField stoppedFields[]={
+    { MILES_SINCE_STOP_STRING, FIELD_MILES_TRAVELLED, formatNumber,          4,   REFRESH_FAST },
+    { HOURS_ELAPSED_STRING,  FIELD_ELAPSED_TIME,      formatNumber,          4,   REFRESH_FAST },
+    { GALLONS_EXPECTED_STRING, FIELD_GALLONS_EXPECTED, formatGallonsExpected, 9,  REFRESH_SLOW },
+    { AVG_MPG_STRING_1,      FIELD_AVG_MPG,           formatMPG,             4,   REFRESH_SLOW },
+};
+const int stoppedFieldCount=sizeof(stoppedFields)/sizeof(stoppedFields[0]);
+
+const FormField summaryFields[]={
+    { TITLE_STRING,          FIELD_TITLE,             NULL,                  14,  FORM_REFRESH_ONCE },
+
+    //Time
+    { DRIVING_TIME_STRING,   FIELD_DRIVING_TIME,      formatHours,           4,   REFRESH_FAST },
+    { ELASPED_TIME_STRING,   FIELD_ELAPSED_TIME,      formatHours,           4,   REFRESH_FAST },
+    { TIME_STOPPED_STRING,   FIELD_STOPPED_TIME,      formatHours,           4,   REFRESH_FAST },
+    { NUM_STOPS_STRING,      FIELD_NUMBER_OF_STOPS,   formatNumber,          2,   REFRESH_FAST },
+    { TIME_PARKED_STRING,    FIELD_PARKED_TIME,       formatHours,           4,   REFRESH_FAST },
+
+    //Moving
+    { MILES_STRING,          FIELD_MILES_TRAVELLED,   formatNumber,          4,   REFRESH_FAST },
+    { GALLONS_STRING,        FIELD_GALLONS_USED,      formatNumber,          3,   REFRESH_FAST },
+    { AVG_MPG_STRING,        FIELD_AVG_MPG,           formatNumber,          4,   REFRESH_FAST },
+    { AVG_MOV_SPEED_STRING,  FIELD_AVG_MOVING_SPEED,  formatNumber,          4,   REFRESH_FAST },
+    { ELEVATION_GAIN_STRING, FIELD_TOTAL_CLIMB,       formatElevation,       5,   REFRESH_FAST },
+};
+const int summaryFieldCount=sizeof(summaryFields)/sizeof(summaryFields[0]);
@@ -0,0 +1,40 @@
+#ifndef FormTables_h
+#define FormTables_h
+
+#include "FormFields.h"
+
+//
+// The text forms, as FormField tables.  Adding a field (or a whole form
+// built from the same values) is a line in FormTables.cpp; the Genie string
+// object numbers come from the Workshop4 project.
+//
+
+//Field sources: which TripData value a field shows (see TripFieldSource)
+#define FIELD_TITLE 0               //the form's title, no value
+#define FIELD_MILES_TRAVELLED 1
+#define FIELD_DRIVING_TIME 2
+#define FIELD_ELAPSED_TIME 3
+#define FIELD_STOPPED_TIME 4
+#define FIELD_PARKED_TIME 5
+#define FIELD_NUMBER_OF_STOPS 6
+#define FIELD_GALLONS_USED 7
+#define FIELD_HEATER_GALLONS 8
+#define FIELD_GALLONS_EXPECTED 9
+#define FIELD_AVG_MPG 10
+#define FIELD_AVG_MOVING_SPEED 11
+#define FIELD_TOTAL_CLIMB 12
+#define FIELD_SOURCES 13
+
+//Starting form: heater fuel and time parked since the last trip
+extern const FormField startingFields[];
+extern const int startingFieldCount;
+
+//Stopped form: since the last stop, and what it'll take to fill up
+extern const FormField stoppedFields[];
+extern const int stoppedFieldCount;
+
+//Summary form: one of the trip buckets, with its title
+extern const FormField summaryFields[];
+extern const int summaryFieldCount;
+
+#endif
@@ -7,15 +7,6 @@
 #define STATUS_STATUS_STRING 36
 #define STATUS_STRING 34
 
-#define HEATER_FUEL_STRING 32
-#define MILES_DRIVEN_STRING 29
-#define TIME_ELAPSED_STRING 30
-
-#define MILES_SINCE_STOP_STRING 4
-#define HOURS_ELAPSED_STRING 5
-#define GALLONS_EXPECTED_STRING 9
-#define AVG_MPG_STRING_1 38
-
 #define BOOT_STRING 39
 
 //
@@ -44,84 +35,44 @@ void BootForm::updateDisplay(char *message,int activeForm)
 }
 
 //
-// Starting Form
+// Genie Field Sink
 //
-// first segment in a linked list  (each tripsegment has the next one)
-StartingForm::StartingForm(Genie* _geniePtr,int _formID,TripData *_tripSegDataPtr,int _refreshTicks)
+GenieFieldSink::GenieFieldSink(Genie* _geniePtr)
 {
-    //Save main genie pointer
     geniePtr=_geniePtr;
-
-    //Save context
-    formID=_formID;
-    tripSegDataPtr=_tripSegDataPtr;
-    refreshTicks=_refreshTicks;
-}
-
-int StartingForm::getFormId()
-{
-    return formID;
 }
 
-//Update display
-void StartingForm::updateDisplay()
+void GenieFieldSink::writeStr(int objNum,const char *text)
 {
-  //don't update if it's not time to
-  if(millis()<nextTickCount)
-      return;
-  nextTickCount=millis()+refreshTicks;
-
-  //Update time data fields
-  strField.updateNumberField(geniePtr,HEATER_FUEL_STRING, heaterFuel, tripSegDataPtr->getHeaterGallonsUsed(), sizeof(heaterFuel)-1);
-  strField.updateNumberField(geniePtr,MILES_DRIVEN_STRING, elapsedTime, tripSegDataPtr->getMilesTravelled(), sizeof(elapsedTime)-1);
-  strField.updateHoursField(geniePtr,TIME_ELAPSED_STRING, milesTravelled, tripSegDataPtr->getParkedTime(),sizeof(milesTravelled)-1);  
+    geniePtr->WriteStr(objNum,text);
 }
 
-
 //
-// Stopped Form
+// Trip Field Source
 //
-// first segment in a linked list  (each tripsegment has the next one)
-StoppedForm::StoppedForm(Genie* _geniePtr,int _formID,TripData *_tripSegDataPtr,int _refreshTicks)
+TripFieldSource::TripFieldSource(TripData *_tripSegDataPtr)
 {
-    //Save main genie pointer
-    geniePtr=_geniePtr;
-    formID=_formID;
-    refreshTicks=_refreshTicks;
-
     tripSegDataPtr=_tripSegDataPtr;
 }
 
-int StoppedForm::getFormId()
-{
-    return formID;
-}
-
-//Update display
-void StoppedForm::updateDisplay()
-{
-  //don't update if it's not time to
-  if(millis()<nextTickCount)
-      return;
-  nextTickCount=millis()+refreshTicks;
-
-  //Update time data fields
-  strField.updateNumberField(geniePtr,MILES_SINCE_STOP_STRING, milesTravelled, tripSegDataPtr->getMilesTravelled(),sizeof(milesTravelled)-1);
-  strField.updateNumberField(geniePtr,HOURS_ELAPSED_STRING, elapsedTime, tripSegDataPtr->getElapsedTime(),sizeof(elapsedTime)-1);
-
-  //Create gallons expected + oz of additive and update form
-  int gallExp=tripSegDataPtr->getGallonsExpected();
-  int ozToAdd=tripSegDataPtr->getGallonsExpected()*FUEL_ADDITIVE_RATIO;
-  sprintf(gallonsExpected, "%d (%doz)", gallExp, ozToAdd);
-  geniePtr->WriteStr(GALLONS_EXPECTED_STRING,gallonsExpected);
-  //strField.updateField(geniePtr,GALLONS_EXPECTED_STRING, gallonsExpected,tripSegDataPtr->getGallonsExpected(),sizeof(gallonsExpected)-1);
-
-  //If we have a valid avg mpg, show it
-  double avgMpgFlt=tripSegDataPtr->getAvgMPG();
-  if(avgMpgFlt>0 && avgMpgFlt<30)
-    strField.updateNumberField(geniePtr,AVG_MPG_STRING_1, avgMPG,avgMpgFlt,sizeof(avgMPG)-1);
-  else
-    geniePtr->WriteStr(AVG_MPG_STRING_1,"---");
+double TripFieldSource::getValue(int source)
+{
+  switch(source)
+  {
+    case FIELD_MILES_TRAVELLED:   return tripSegDataPtr->getMilesTravelled();
+    case FIELD_DRIVING_TIME:      return tripSegDataPtr->getDrivingTime();
+    case FIELD_ELAPSED_TIME:      return tripSegDataPtr->getElapsedTime();
+    case FIELD_STOPPED_TIME:      return tripSegDataPtr->getStoppedTime();
+    case FIELD_PARKED_TIME:       return tripSegDataPtr->getParkedTime();
+    case FIELD_NUMBER_OF_STOPS:   return tripSegDataPtr->getNumberOfStops();
+    case FIELD_GALLONS_USED:      return tripSegDataPtr->getFuelGallonsUsed();
+    case FIELD_HEATER_GALLONS:    return tripSegDataPtr->getHeaterGallonsUsed();
+    case FIELD_GALLONS_EXPECTED:  return tripSegDataPtr->getGallonsExpected();
+    case FIELD_AVG_MPG:           return tripSegDataPtr->getAvgMPG();
+    case FIELD_AVG_MOVING_SPEED:  return tripSegDataPtr->getAvgMovingSpeed();
+    case FIELD_TOTAL_CLIMB:       return tripSegDataPtr->getTotalClimb();
+  }
+  return 0;
 }
 
 //
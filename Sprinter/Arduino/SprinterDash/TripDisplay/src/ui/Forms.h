@@ -2,6 +2,8 @@
 #define Forms_h
 
 #include "FormHelpers.h"
+#include "FormFields.h"
+#include "FormTables.h"
 #include <genieArduino.h>
 
 #include "../data/TripData.h"
@@ -15,8 +17,6 @@ class BootForm
     void updateDisplay(char *message,int activeForm);  
 
   private: 
-    StrField strField;
-
     //State
     int formID;
 
@@ -24,58 +24,26 @@ class BootForm
     Genie *geniePtr;      
 };
 
-class StartingForm 
+//Writes form fields to the display
+class GenieFieldSink : public FieldSink
 {
   public:
-    StartingForm(Genie* geniePtr,int formID,TripData *tripSegDataPtr,int _refreshTicks);
-
-    int getFormId();
-    void updateDisplay();
-
-  private: 
-    StrField strField;
-
-    //State
-    int formID;
-    int refreshTicks;
-    unsigned long nextTickCount;      //when to update/refresh    
-
-    //Display
-    Genie *geniePtr;     
-    TripData *tripSegDataPtr;  
+    GenieFieldSink(Genie *geniePtr);
+    void writeStr(int objNum,const char *text);
 
-    //Fields
-    char heaterFuel[3];
-    char elapsedTime[5];
-    char milesTravelled[5];
+  private:
+    Genie *geniePtr;
 };
 
-class StoppedForm 
+//Field values (FIELD_* in FormTables.h) from one of the trip buckets
+class TripFieldSource : public FieldSource
 {
   public:
-    StoppedForm(Genie* geniePtr,int formID,TripData *tripSegDataPtr,int _refreshTicks);
-
-    int getFormId();
-    void updateDisplay();
+    TripFieldSource(TripData *tripSegDataPtr);
+    double getValue(int source);
 
-  private: 
-    StrField strField;
-
-    //State
-    int formID;
-    const char* label;
-    int refreshTicks;
-    unsigned long nextTickCount;      //when to update/refresh    
-
-    //Display
-    Genie *geniePtr;     
-    TripData *tripSegDataPtr;  
-
-    //Fields
-    char gallonsExpected[10];  //it's big because it also shows oz of additive
-    char elapsedTime[5];
-    char milesTravelled[5];
-    char avgMPG[5];
+  private:
+    TripData *tripSegDataPtr;
 };
 
 class StatusForm 
@@ -51,7 +51,7 @@ void PrimaryForm::updateData()
     transTempGauge.setValue(currentDataPtr->currentTransmissionTemp);
 
     //Split bar gauges
-    int headWind=currentDataPtr->currentPitotSpeed - currentDataPtr->currentSpeed;
+    int headWind=currentDataPtr->currentHeadwind;
     windSpeedGauge.setValue(headWind);
     instMPG.setValue(dataSinceLastStop->getInstantMPG());
 
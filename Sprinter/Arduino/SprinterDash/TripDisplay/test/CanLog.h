@@ -0,0 +1,91 @@
+//
+// Reads OBD responses out of CANCapture logs, for the host replays
+// (FusionReplay, FuelReplay).
+//
+// Understands every style in ../CANCapture: TorqueLog1.csv "7E8,3 41 D 1E",
+// candump "0x7E8,0x3,0x41,0xD,0x1E" and the serial monitor's dumptiming
+// "15:45:25.633 -> 0x7E8,...".  Logs without timestamps are taken to be
+// one frame every frameMs.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+//A mode 01 response (0x41): the PID and its data bytes A..D
+struct ObdResponse
+{
+    unsigned long ms;
+    int pid;
+    unsigned a, b, c, d;
+};
+
+static bool ReadObdResponses(const char *path, int frameMs, std::vector<ObdResponse> &responses, long &frames)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    frames = 0;
+    long firstStampMs = -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        char *p = line;
+        unsigned long ms = frames * frameMs;
+        frames++;
+
+        //Serial monitor timestamp: "15:45:25.633 -> "
+        int hh, mm, ss, msec;
+        char *arrow = strstr(line, "->");
+        if (arrow && sscanf(line, "%d:%d:%d.%d", &hh, &mm, &ss, &msec) == 4)
+        {
+            long stamp = ((hh * 60L + mm) * 60L + ss) * 1000L + msec;
+            if (firstStampMs < 0)
+                firstStampMs = stamp;
+            ms = stamp - firstStampMs;
+            p = arrow + 2;
+        }
+
+        //ID, then the payload bytes, separated by commas, spaces or tabs
+        unsigned bytes[16] = { 0 };
+        int count = 0;
+        char *token = strtok(p, ", \t\r\n");
+        while (token && count < 16)
+        {
+            bytes[count++] = (unsigned)strtoul(token, NULL, 16);
+            token = strtok(NULL, ", \t\r\n");
+        }
+
+        //ID, length, 0x41, PID, A...
+        if (count >= 5 && bytes[2] == 0x41)
+        {
+            ObdResponse r = { ms, (int)bytes[3], bytes[4], bytes[5], bytes[6], bytes[7] };
+            responses.push_back(r);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+//The value CANCapture sends the dash for a response: its formula for the
+//PID, truncated to an int on the way (see CANCapture.ino)
+static inline int CanCaptureValue(int pid, unsigned a, unsigned b)
+{
+    switch (pid)
+    {
+    case 0x04: return (int)(a / 2.55);              //load, %
+    case 0x0B: return (int)a;                       //manifold pressure, kPa
+    case 0x0D: return (int)a;                       //speed, km/h
+    case 0x10: return (int)((256 * a + b) / 100.0); //MAF, g/s
+    case 0x2F: return (int)((100 / 255.0) * a);     //fuel level, %
+    case 0x31: return (int)(256 * a + b);           //distance, km
+    default:   return (int)a;
+    }
+}
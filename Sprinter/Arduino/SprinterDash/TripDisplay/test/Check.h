@@ -0,0 +1,24 @@
+//
+// Pass/fail lines for every host test in test/: "ok  " or "FAIL" and what
+// was checked, then PASS or FAIL for the whole run.
+//
+
+#pragma once
+
+#include <stdio.h>
+
+static int checkFailures=0;
+
+static void check(bool ok,const char *what)
+{
+    printf("%s %s\n",ok ? "ok  " : "FAIL",what);
+    if(!ok)
+        checkFailures++;
+}
+
+//Prints the verdict; main() returns it
+static int checkResult()
+{
+    printf("%s\n",checkFailures ? "FAIL" : "PASS");
+    return checkFailures ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+//
+// Host benchmark for the elevation tile cache and route-ahead prefetch.
+//
+// Drives a simulated out-and-back trip through mountains with the same
+// ElevationTiles code the dash runs, fetching tiles over real HTTP from
+// test/dem_stub_server.py.  WiFi is only up for the first 10 minutes and
+// during a 10 minute stop at the far end; the rest is offline, as on a
+// mountain pass.  Every 10 s it looks up the ground elevation from the
+// cache, the way ElevationAPI calibrates offline, and reports:
+//   - cache hit rate, per leg and offline only
+//   - lookup time from the cache file, and request time to the server
+//   - tiles stored, evictions
+//   - interpolation error against exact server elevations
+//
+// Build and run (from TripDisplay/):
+//   g++ -std=c++11 -O2 -o ElevationCacheBench test/ElevationCacheBench.cpp src/tracking/ElevationTiles.cpp src/data/Journal.cpp
+//   python3 test/dem_stub_server.py --delay-ms 300 &
+//   ./ElevationCacheBench [-p 8765] [-slots 512] [-f cache.bin]
+//
+// Exits non-zero if, with the full cache, the offline drive back misses
+// more than 5% of lookups or interpolation error is over 10 ft RMS.
+//
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/tracking/ElevationTiles.h"
+#include "Check.h"
+
+#define METERS_2_FEET 3.28084
+#define DATASET "aster30m"
+
+typedef std::chrono::steady_clock Clock;
+
+static double MicrosSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+//Tile slots in a plain file, like the LittleFS file on the dash
+class FileTileStore : public TileStore
+{
+  public:
+    FILE *file=NULL;
+    int slots;
+
+    FileTileStore(const char *path, int _slots) : slots(_slots)
+    {
+        file=fopen(path,"w+b");
+    }
+    ~FileTileStore()
+    {
+        if(file)
+            fclose(file);
+    }
+
+    int getSlotCount() { return slots; }
+
+    bool readSlot(int slot, void *buffer, size_t length)
+    {
+        return fseek(file,(long)slot*length,SEEK_SET)==0 && fread(buffer,1,length,file)==length;
+    }
+
+    bool writeSlot(int slot, const void *buffer, size_t length)
+    {
+        return fseek(file,(long)slot*length,SEEK_SET)==0 && fwrite(buffer,1,length,file)==length &&
+               fflush(file)==0;
+    }
+};
+
+//Open Topo Data over plain HTTP to the local stub
+class StubSource : public ElevationSource
+{
+  public:
+    int port;
+    int requests=0;
+    double totalMs=0, maxMs=0;
+
+    StubSource(int _port) : port(_port) {}
+
+    bool lookup(const float *lats, const float *lons, int count, float *elevMeters)
+    {
+        char path[ELEV_QUERY_MAX];
+        if(ElevationTiles::buildQuery(path,sizeof(path),DATASET,lats,lons,count)<0)
+            return false;
+
+        Clock::time_point start=Clock::now();
+        std::string response;
+        if(!get(path,response))
+            return false;
+        double ms=MicrosSince(start)/1000;
+        requests++;
+        totalMs+=ms;
+        if(ms>maxMs)
+            maxMs=ms;
+
+        if(response.compare(0,12,"HTTP/1.0 200")!=0 && response.compare(0,12,"HTTP/1.1 200")!=0)
+        {
+            fprintf(stderr,"HTTP error: %.40s\n",response.c_str());
+            return false;
+        }
+        size_t body=response.find("\r\n\r\n");
+        return body!=std::string::npos && ElevationTiles::parseResponse(response.c_str()+body+4,elevMeters,count);
+    }
+
+  private:
+    bool get(const char *path, std::string &response)
+    {
+        int sock=socket(AF_INET,SOCK_STREAM,0);
+        sockaddr_in addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sin_family=AF_INET;
+        addr.sin_port=htons(port);
+        addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+        if(sock<0 || connect(sock,(sockaddr *)&addr,sizeof(addr))<0)
+        {
+            perror("connect to stub server");
+            if(sock>=0)
+                close(sock);
+            return false;
+        }
+
+        std::string request=std::string("GET ")+path+" HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+        if(send(sock,request.data(),request.size(),0)!=(ssize_t)request.size())
+        {
+            close(sock);
+            return false;
+        }
+        char buffer[4096];
+        ssize_t n;
+        while((n=recv(sock,buffer,sizeof(buffer),0))>0)
+            response.append(buffer,n);
+        close(sock);
+        return true;
+    }
+};
+
+struct Fix
+{
+    float lat, lon, course;
+    bool online;
+    int leg;   //0 out, 1 stop at the far end, 2 back
+};
+
+//Out 60 minutes at 50 mph on a winding road, 10 minute stop, then back
+static std::vector<Fix> MakeDrive()
+{
+    std::vector<Fix> drive;
+    float lat=39.70f, lon=-105.70f;
+    const float speed=22.35f;   //m/s
+    for(int t=0;t<3600;t++)
+    {
+        float course=70+50*sinf(t/300.0f);
+        Fix fix={lat,lon,course,t<600,0};
+        drive.push_back(fix);
+        float b=course*0.01745329f;
+        lat+=speed*cosf(b)/111320.0f;
+        lon+=speed*sinf(b)/(111320.0f*cosf(lat*0.01745329f));
+    }
+    for(int t=0;t<600;t++)
+    {
+        Fix fix={lat,lon,-1,true,1};
+        drive.push_back(fix);
+    }
+    for(int t=3599;t>=0;t--)
+    {
+        Fix fix=drive[t];
+        fix.course=fmodf(fix.course+180,360);
+        fix.online=false;
+        fix.leg=2;
+        drive.push_back(fix);
+    }
+    return drive;
+}
+
+struct LegStats
+{
+    int lookups=0, hits=0, offlineLookups=0, offlineHits=0;
+};
+
+int main(int argc, char **argv)
+{
+    int port=8765;
+    int slots=ELEV_TILE_MAX_SLOTS;
+    const char *path="ElevationCache.bin";
+    for(int i=1;i<argc;i++)
+    {
+        bool hasValue=i+1<argc;
+        if(strcmp(argv[i],"-p")==0 && hasValue) port=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-slots")==0 && hasValue) slots=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-f")==0 && hasValue) path=argv[++i];
+        else
+        {
+            fprintf(stderr,"usage: %s [-p port] [-slots n] [-f cachefile]\n",argv[0]);
+            return 2;
+        }
+    }
+
+    FileTileStore store(path,slots);
+    if(store.file==NULL)
+    {
+        perror(path);
+        return 2;
+    }
+    StubSource source(port);
+    ElevationTiles tiles;
+    tiles.begin(&store);
+
+    std::vector<Fix> drive=MakeDrive();
+    LegStats legs[3];
+    double hitMicros=0, maxHitMicros=0, missMicros=0;
+    int failedFetches=0;
+    std::vector<float> checkLat, checkLon, checkCached;
+
+    for(size_t t=0;t<drive.size();t++)
+    {
+        const Fix &fix=drive[t];
+        tiles.addTrackPoint(fix.lat,fix.lon);
+        if(fix.course>=0)
+            tiles.setHeading(fix.course);
+
+        //Prefetch one tile every 2 s while online (ElevationAPI's pace)
+        int32_t latIdx, lonIdx;
+        if(fix.online && t%2==0 && tiles.nextMissingTile(fix.lat,fix.lon,latIdx,lonIdx))
+            if(!tiles.fetchTile(latIdx,lonIdx,&source))
+                failedFetches++;
+
+        //Offline-style calibration lookup every 10 s
+        if(t%10!=0)
+            continue;
+        LegStats &leg=legs[fix.leg];
+        float meters;
+        Clock::time_point start=Clock::now();
+        bool hit=tiles.getElevation(fix.lat,fix.lon,meters);
+        double us=MicrosSince(start);
+        leg.lookups++;
+        leg.hits+=hit;
+        if(!fix.online)
+        {
+            leg.offlineLookups++;
+            leg.offlineHits+=hit;
+        }
+        if(hit)
+        {
+            hitMicros+=us;
+            if(us>maxHitMicros)
+                maxHitMicros=us;
+            if(t%30==0)
+            {
+                checkLat.push_back(fix.lat);
+                checkLon.push_back(fix.lon);
+                checkCached.push_back(meters);
+            }
+        }
+        else
+            missMicros+=us;
+    }
+
+    //Exact elevations for a sample of the cached lookups, straight from the server
+    double sumSq=0, maxErr=0;
+    for(size_t i=0;i<checkLat.size();i+=ELEV_TILE_POINTS)
+    {
+        int count=std::min((int)(checkLat.size()-i),ELEV_TILE_POINTS);
+        float exact[ELEV_TILE_POINTS];
+        if(!source.lookup(&checkLat[i],&checkLon[i],count,exact))
+        {
+            fprintf(stderr,"Exact lookup failed\n");
+            return 2;
+        }
+        source.requests--;   //not part of the drive
+        for(int j=0;j<count;j++)
+        {
+            double err=(checkCached[i+j]-exact[j])*METERS_2_FEET;
+            sumSq+=err*err;
+            if(fabs(err)>maxErr)
+                maxErr=fabs(err);
+        }
+    }
+    double rmsFt=checkLat.empty() ? NAN : sqrt(sumSq/checkLat.size());
+
+    int totalHits=tiles.getHits(), totalLookups=tiles.getHits()+tiles.getMisses();
+    printf("Drive: %zu fixes, %d cache slots (%s)\n",drive.size(),slots,path);
+    const char *names[]={"Out (online 10 min)","Stop (online)","Back (offline)"};
+    for(int i=0;i<3;i++)
+        printf("  %-20s %4d lookups, %5.1f%% hit, offline %5.1f%% of %d\n",names[i],legs[i].lookups,
+               legs[i].lookups ? 100.0*legs[i].hits/legs[i].lookups : 0.0,
+               legs[i].offlineLookups ? 100.0*legs[i].offlineHits/legs[i].offlineLookups : 0.0,
+               legs[i].offlineLookups);
+    printf("Cache: %d lookups, %.1f%% hit, hit %.1f us mean / %.1f us max, miss %.2f us mean\n",totalLookups,
+           totalLookups ? 100.0*totalHits/totalLookups : 0.0, totalHits ? hitMicros/totalHits : 0.0,
+           maxHitMicros, tiles.getMisses() ? missMicros/tiles.getMisses() : 0.0);
+    printf("Fetch: %d requests (100 points each), %.1f ms mean / %.1f ms max, %d failed\n",source.requests,
+           source.requests ? source.totalMs/source.requests : 0.0,source.maxMs,failedFetches);
+    printf("Store: %d tiles (%zu bytes each), %lu evictions\n",tiles.getTileCount(),sizeof(ElevationTile),
+           tiles.getEvictions());
+    printf("Accuracy: %.1f ft RMS, %.1f ft max over %zu cached lookups\n",rmsFt,maxErr,checkLat.size());
+
+    if(slots<ELEV_TILE_MAX_SLOTS)
+        return 0;
+    double backHit=legs[2].offlineLookups ? 100.0*legs[2].offlineHits/legs[2].offlineLookups : 0;
+    char what[100];
+    snprintf(what,sizeof(what),"offline on the way back: %.1f%% of lookups hit the cache (95 needed)",backHit);
+    check(backHit>=95,what);
+    snprintf(what,sizeof(what),"cached elevations within %.1f ft RMS of the server's (10 allowed)",rmsFt);
+    check(rmsFt<10,what);
+    snprintf(what,sizeof(what),"%d tile fetches failed",failedFetches);
+    check(failedFetches==0,what);
+    return checkResult();
+}
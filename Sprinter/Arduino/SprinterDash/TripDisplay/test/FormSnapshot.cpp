@@ -0,0 +1,252 @@
+//
+// Host snapshot test for the text forms (FormFields, FormTables).
+//
+// Renders the starting, stopped and summary forms for a few sets of trip
+// values into a text "screen" and compares it with test/snapshots/forms.txt,
+// so a formatter or table change shows up as a diff of what the driver
+// would see.  Then checks the scheduler: only changed text is written,
+// slow fields wait for their refresh period, a time slice writes what fits
+// and the rest follows on the next loops, and switching summaries (which
+// share one Genie form) writes everything again.
+//
+// Build and run (from TripDisplay/):
+//   g++ -std=c++11 -O2 -o FormSnapshot test/FormSnapshot.cpp src/ui/FormFields.cpp src/ui/FormTables.cpp
+//   ./FormSnapshot          # -u rewrites the snapshot after an intended change
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#include "../src/ui/FormFields.h"
+#include "../src/ui/FormTables.h"
+#include "Check.h"
+
+#define SNAPSHOT_PATH "test/snapshots/forms.txt"
+
+//Trip values by FIELD_*
+class FakeSource : public FieldSource
+{
+  public:
+    double values[FIELD_SOURCES];
+
+    FakeSource() { memset(values,0,sizeof(values)); }
+    double getValue(int source) { return values[source]; }
+};
+
+//The display: what each string object shows, and what writing it cost
+class TextSink : public FieldSink
+{
+  public:
+    std::map<int,std::string> screen;
+    int writes=0;
+
+    void writeStr(int objNum,const char *text);
+};
+
+//Fake microsecond clock; each write over the serial line takes writeUs
+static unsigned long nowUs=0;
+static unsigned long writeUs=0;
+static unsigned long fakeMicros() { return nowUs; }
+
+void TextSink::writeStr(int objNum,const char *text)
+{
+    screen[objNum]=text;
+    writes++;
+    nowUs+=writeUs;
+}
+
+struct Scenario
+{
+    const char *name;
+    double values[FIELD_SOURCES];
+};
+
+//                      title  miles  driving elapsed stopped parked stops gallons heater expected mpg  speed climb
+static const Scenario scenarios[]={
+    { "New trip",       { 0,    0,     0,      0,      0,      0,     0,    0,      0,     0,       0,   0,    0 } },
+    { "Morning drive",  { 0,    142,   2.6,    3.4,    .5,     10.2,  3,    8.3,    .4,    17.8,    17.1, 54.6, 4210 } },
+    { "Long trip",      { 0,    12345, 30,     200,    .25,    1500,  120,  123.4,  0,     24.5,    35,  61,   12345 } },
+    { "Bad values",     { 0,    -3,    .01,    5000,   0,      0,     0,    -1,     99,    0,       -1,  0,    -20 } },
+    { "Too wide",       { 0,    99999, 90,     2000,   1,      9000,  999,  456.7,  2,     123.4,   29.9, 99, 123456 } },
+};
+
+struct TestForm
+{
+    const char *name;
+    const FormField *fields;
+    int count;
+};
+
+static const TestForm forms[]={
+    { "Starting", startingFields, startingFieldCount },
+    { "Stopped", stoppedFields, stoppedFieldCount },
+    { "Summary", summaryFields, summaryFieldCount },
+};
+
+//Every form, every scenario, as the driver would see it
+static std::string renderSnapshot()
+{
+    std::string out;
+    char line[100];
+    for(const TestForm &form : forms)
+    {
+        for(const Scenario &scenario : scenarios)
+        {
+            FakeSource source;
+            memcpy(source.values,scenario.values,sizeof(source.values));
+            FieldForm fieldForm(0,form.fields,form.count,&source,"Full Trip");
+            TextSink sink;
+            FormScheduler scheduler(&sink,fakeMicros);
+            scheduler.setForm(&fieldForm);
+            scheduler.update(0,1000000);
+
+            snprintf(line,sizeof(line),"== %s: %s\n",form.name,scenario.name);
+            out+=line;
+            for(int i=0;i<form.count;i++)
+            {
+                snprintf(line,sizeof(line),"%3d [%s]\n",form.fields[i].objNum,fieldForm.getText(i));
+                out+=line;
+            }
+        }
+    }
+    return out;
+}
+
+static bool compareSnapshot(bool rewrite)
+{
+    std::string actual=renderSnapshot();
+    if(rewrite)
+    {
+        FILE *f=fopen(SNAPSHOT_PATH,"w");
+        if(f==NULL)
+        {
+            perror(SNAPSHOT_PATH);
+            return false;
+        }
+        fputs(actual.c_str(),f);
+        fclose(f);
+        printf("Wrote %s\n",SNAPSHOT_PATH);
+        return true;
+    }
+
+    std::string expected;
+    FILE *f=fopen(SNAPSHOT_PATH,"r");
+    if(f==NULL)
+    {
+        perror(SNAPSHOT_PATH);
+        return false;
+    }
+    char buffer[256];
+    while(fgets(buffer,sizeof(buffer),f))
+        expected+=buffer;
+    fclose(f);
+
+    if(actual==expected)
+        return true;
+
+    //Show the first line that differs
+    size_t a=0,e=0;
+    int lineNo=1;
+    while(a<actual.size() && e<expected.size())
+    {
+        size_t aEnd=actual.find('\n',a),eEnd=expected.find('\n',e);
+        std::string aLine=actual.substr(a,aEnd-a),eLine=expected.substr(e,eEnd-e);
+        if(aLine!=eLine)
+        {
+            printf("line %d\n  expected: %s\n  actual:   %s\n",lineNo,eLine.c_str(),aLine.c_str());
+            break;
+        }
+        a=aEnd+1;
+        e=eEnd+1;
+        lineNo++;
+    }
+    return false;
+}
+
+static void checkScheduler()
+{
+    FakeSource source;
+    memcpy(source.values,scenarios[1].values,sizeof(source.values));
+    TextSink sink;
+    writeUs=0;
+    nowUs=0;
+    FormScheduler scheduler(&sink,fakeMicros);
+
+    //Stopped form: everything once, then only what changes
+    FieldForm stopped(1,stoppedFields,stoppedFieldCount,&source);
+    scheduler.setForm(&stopped);
+    check(scheduler.update(0,1000000)==stoppedFieldCount,"activation writes every field");
+    check(scheduler.update(1000,1000000)==0,"nothing changed, nothing written");
+
+    source.values[FIELD_MILES_TRAVELLED]=143;
+    check(scheduler.update(2000,1000000)==1,"one value changed, one field written");
+
+    source.values[FIELD_MILES_TRAVELLED]=143.01;
+    check(scheduler.update(3000,1000000)==0,"value changed but its text didn't");
+
+    source.values[FIELD_GALLONS_EXPECTED]=18.9;
+    check(scheduler.update(4000,1000000)==0,"slow field waits for its refresh");
+    check(scheduler.update(5000,1000000)==1,"slow field written once due");
+    check(sink.screen[9]=="18 (7oz)","gallons expected shows on the screen");
+
+    //Navigating away and back redraws the form
+    scheduler.invalidate();
+    check(scheduler.update(6000,1000000)==stoppedFieldCount,"re-activation writes every field");
+
+    //Summary: 2.5 writes fit a slice, so 3 per loop (the one that runs over
+    //finishes), and every field gets there without any twice
+    FieldForm summary(2,summaryFields,summaryFieldCount,&source,"Full Trip");
+    scheduler.setForm(&summary);
+    writeUs=1000;
+    sink.screen.clear();
+    sink.writes=0;
+    int loops=0;
+    int perLoop=0;
+    while(sink.screen.size()<(size_t)summaryFieldCount && loops<20)
+    {
+        int written=scheduler.update(7000,2500);
+        if(loops==0)
+            perLoop=written;
+        loops++;
+    }
+    check(perLoop==3,"a slice writes what fits");
+    check(loops==(summaryFieldCount+2)/3,"the rest follows on the next loops");
+    check(sink.writes==summaryFieldCount,"no field written twice");
+    check(sink.screen[12]=="Full Trip","title written");
+
+    //Over budget from the start still makes progress
+    scheduler.invalidate();
+    check(scheduler.update(8000,0)==1,"a spent budget still writes one field");
+
+    //The title is written once per activation
+    scheduler.update(8000,1000000);
+    sink.writes=0;
+    scheduler.update(60000,1000000);
+    check(sink.screen.count(12)==1 && sink.writes==0,"title not rewritten");
+
+    //Another summary shares the Genie form: all of it goes again
+    FakeSource other;
+    FieldForm otherSummary(2,summaryFields,summaryFieldCount,&other,"Since Stopped");
+    scheduler.setForm(&otherSummary);
+    writeUs=0;
+    sink.writes=0;
+    scheduler.update(61000,1000000);
+    check(sink.writes==summaryFieldCount && sink.screen[12]=="Since Stopped","switching summaries writes every field");
+    check(scheduler.getSkipped()>0,"unchanged renders counted");
+
+    //No text form showing
+    scheduler.setForm(NULL);
+    check(scheduler.update(62000,1000000)==0,"no form, no writes");
+}
+
+int main(int argc,char **argv)
+{
+    bool rewrite=argc>1 && strcmp(argv[1],"-u")==0;
+
+    check(compareSnapshot(rewrite),"forms match " SNAPSHOT_PATH);
+    checkScheduler();
+
+    return checkResult();
+}
@@ -0,0 +1,537 @@
+//
+// Host replay for FuelModel.
+//
+// Feeds OBD readings through the same FuelModel the dash runs (with the
+// dash's outlier Filter on fuel level), and checks the fuel it integrates
+// against the tank gauge: per engine run, and per tank between fill-ups.
+// Alongside it shows what the old whole-percent tank deltas would have said.
+//
+//   FuelReplay -c canlog [-f frameMs] [-factor n]
+//   FuelReplay -synth [-seed n] [-days n]
+//
+// -c  CAN log in any of the CANCapture styles (see CanLog.h).  Load (0x04),
+//     speed (0x0D), MAF (0x10) and fuel level (0x2F) responses are decoded
+//     the way CANCapture sends them.  -factor starts from a known
+//     calibration instead of the default.
+// -synth  Simulate -days (default 14) of van life: town, highway and
+//     mountain drives, idling, overnight heater use, fill-ups, and a
+//     sloshing, tilting whole-percent fuel gauge, with true fuel burned
+//     known.  The true fuel isn't MAF x load (diesel runs leaner at light
+//     load), so the calibration has something real to fit.  Scores the
+//     model against truth and the old tank deltas, and exits non-zero if it
+//     doesn't beat them and stay inside the error limits.
+//
+// Build (from TripDisplay/):
+//   g++ -std=c++11 -O2 -Itest/stubs -o FuelReplay test/FuelReplay.cpp src/data/FuelModel.cpp src/sensors/Filter.cpp
+//   ./FuelReplay -synth
+//   ./FuelReplay -c ../CANCapture/candump3.csv
+//
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/data/FuelModel.h"
+#include "../src/sensors/Filter.h"
+#include "CanLog.h"
+#include "Check.h"
+
+#define KMH_2_MPH 0.621371f
+#define GRAMS_PER_GALLON 3180.0   // diesel
+
+enum Kind { OBD, CLIMB, TRUTH, ENGINE_OFF };
+
+struct Event
+{
+    unsigned long ms;
+    Kind kind;
+    int pid;       //OBD
+    float value;   //OBD value as the dash gets it, ft/min, or cumulative true gallons
+};
+
+//
+// Loading
+//
+
+static bool LoadCanLog(const char *path, int frameMs, std::vector<Event> &events)
+{
+    std::vector<ObdResponse> responses;
+    long frames = 0;
+    if (!ReadObdResponses(path, frameMs, responses, frames))
+        return false;
+
+    int used = 0;
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        const ObdResponse &r = responses[i];
+        if (r.pid != 0x04 && r.pid != 0x0D && r.pid != 0x10 && r.pid != 0x2F)
+            continue;
+        Event e = { r.ms, OBD, r.pid, (float)CanCaptureValue(r.pid, r.a, r.b) };
+        events.push_back(e);
+        used++;
+    }
+    printf("%s: %ld frames, %d load/speed/MAF/fuel readings\n", path, frames, used);
+    return true;
+}
+
+//
+// Synthetic van life
+//
+
+#define VAN_MASS_KG 4200.0
+#define VAN_CRR 0.011
+#define VAN_CDA 1.15
+#define AIR_DENSITY 1.1
+#define ENGINE_MAX_KW 140.0
+#define DRIVETRAIN_EFFICIENCY 0.88
+#define ACCESSORY_KW 3.0
+#define IDLE_FUEL_GPS 0.28        // g/s
+#define BSFC_G_PER_KWH 260.0
+#define LEVEL_SLOSH_PERC 0.7      // gauge noise while moving
+#define LEVEL_TILT_PERC 25.0      // gauge reads this many % high per unit grade
+
+struct Leg
+{
+    int type;          //0 town, 1 highway, 2 mountain pass
+    double meters;
+};
+
+class Van
+{
+  public:
+    std::mt19937 rng;
+    std::normal_distribution<double> unit;
+    std::uniform_real_distribution<double> uniform;
+
+    double ms = 8 * 3600000.0;   //day 0, 8am
+    double tank = FUEL_TANK_SIZE * 0.9;
+    double trueGallons = 0;
+    std::vector<Event> &events;
+    int fillUps = 0;
+
+    Van(unsigned seed, std::vector<Event> &_events) : rng(seed), unit(0, 1), uniform(0, 1), events(_events) {}
+
+    void Park(double seconds, double heaterGph)
+    {
+        tank -= heaterGph * seconds / 3600;
+        ms += seconds * 1000;
+    }
+
+    void FillUp()
+    {
+        tank = FUEL_TANK_SIZE - uniform(rng) * 0.5;
+        fillUps++;
+        Park(600, 0);
+    }
+
+    void Drive()
+    {
+        //Some warm-up idling, then town, highway and passes, then town
+        std::vector<Leg> legs;
+        legs.push_back(Leg{ 0, 1000 + uniform(rng) * 4000 });
+        int count = 1 + (int)(uniform(rng) * 4);
+        for (int i = 0; i < count; i++)
+        {
+            double pick = uniform(rng);
+            if (pick < 0.25)
+                legs.push_back(Leg{ 0, 2000 + uniform(rng) * 6000 });
+            else if (pick < 0.75)
+                legs.push_back(Leg{ 1, 20000 + uniform(rng) * 60000 });
+            else
+                legs.push_back(Leg{ 2, 15000 + uniform(rng) * 20000 });
+        }
+        legs.push_back(Leg{ 0, 1000 + uniform(rng) * 2000 });
+
+        Idle(30 + uniform(rng) * 270);
+        for (size_t i = 0; i < legs.size(); i++)
+            DriveLeg(legs[i]);
+        Idle(20 + uniform(rng) * 100);
+
+        Event off = { (unsigned long)ms, ENGINE_OFF, 0, 0 };
+        events.push_back(off);
+    }
+
+  private:
+    double speed = 0;   //m/s
+    double grade = 0;
+    double nextLoad = 0, nextMaf = 100, nextSpeed = 200, nextLevel = 5000, nextTruth = 0;
+    double slosh = 0;
+
+    void Idle(double seconds)
+    {
+        for (double t = 0; t < seconds; t += 0.1)
+            Step(0, 0.1);
+    }
+
+    void DriveLeg(const Leg &leg)
+    {
+        double target = leg.type == 0 ? 13.4 : leg.type == 1 ? 28 + uniform(rng) * 2.5 : 20;
+        double nextStop = 400 + uniform(rng) * 800;
+        double phase = uniform(rng) * 6.28;
+        for (double x = 0; x < leg.meters;)
+        {
+            //Town has traffic lights
+            if (leg.type == 0 && x > nextStop)
+            {
+                while (speed > 0)
+                    Step(-1.5, 0.1);
+                Idle(15 + uniform(rng) * 45);
+                nextStop = x + 400 + uniform(rng) * 800;
+            }
+
+            if (leg.type == 1)
+                grade = 0.015 * sin(x / 2500 + phase) + 0.01 * sin(x / 700 + phase);
+            else if (leg.type == 2)
+                grade = (x < leg.meters / 2 ? 0.055 : -0.055) + 0.01 * sin(x / 500 + phase);
+            else
+                grade = 0.005 * sin(x / 300 + phase);
+
+            double accel = std::max(-1.5, std::min(1.0, (target - speed) * 0.5));
+            Step(accel, 0.1);
+            x += speed * 0.1;
+        }
+        grade = 0;
+    }
+
+    //Advance 0.1 s: physics, true fuel, and the PIDs CANCapture would send
+    void Step(double accel, double dt)
+    {
+        speed = std::max(0.0, speed + accel * dt);
+
+        double force = VAN_MASS_KG * 9.81 * (VAN_CRR + grade) + 0.5 * AIR_DENSITY * VAN_CDA * speed * speed +
+                       VAN_MASS_KG * accel;
+        double wheelKw = force * speed / 1000;
+        double engineKw = std::max(0.0, wheelKw / DRIVETRAIN_EFFICIENCY) + ACCESSORY_KW;
+        bool overrun = wheelKw < -1 && speed > 4;
+
+        //Truth: fuel from power; the dash sees air from fuel via a load-dependent AFR
+        double fuelGps = overrun ? 0 : IDLE_FUEL_GPS + std::min(engineKw, ENGINE_MAX_KW) * BSFC_G_PER_KWH / 3600;
+        double load = overrun ? 0 : std::min(100.0, 18 + 82 * engineKw / ENGINE_MAX_KW);
+        double maf = overrun ? 30 : fuelGps / (0.012 + 0.00045 * load);
+
+        trueGallons += fuelGps * dt / GRAMS_PER_GALLON;
+        tank -= fuelGps * dt / GRAMS_PER_GALLON;
+        ms += dt * 1000;
+
+        slosh = slosh * 0.98 + unit(rng) * (speed > 1 ? LEVEL_SLOSH_PERC : 0.1) * 0.2;
+
+        if (ms >= nextLoad)
+        {
+            Emit(0x04, CanCaptureValue(0x04, (unsigned)lround(load * 2.55), 0));
+            nextLoad = ms + 200;
+        }
+        if (ms >= nextMaf)
+        {
+            unsigned raw = (unsigned)lround(maf * 100);
+            Emit(0x10, CanCaptureValue(0x10, raw >> 8, raw & 0xFF));
+            nextMaf = ms + 200;
+        }
+        if (ms >= nextSpeed)
+        {
+            Emit(0x0D, CanCaptureValue(0x0D, (unsigned)(speed * 3.6), 0));
+            nextSpeed = ms + 400;
+        }
+        if (ms >= nextLevel)
+        {
+            double level = 100 * tank / FUEL_TANK_SIZE + slosh + LEVEL_TILT_PERC * grade;
+            level = std::max(0.0, std::min(100.0, level));
+            Emit(0x2F, CanCaptureValue(0x2F, (unsigned)lround(level * 2.55), 0));
+            nextLevel = ms + 60000;
+        }
+        if (ms >= nextTruth)
+        {
+            //What fusion would report as climb rate, and truth for scoring
+            Event climb = { (unsigned long)ms, CLIMB, 0, (float)(grade * speed * 196.85) };
+            Event truth = { (unsigned long)ms, TRUTH, 0, (float)trueGallons };
+            events.push_back(climb);
+            events.push_back(truth);
+            nextTruth = ms + 1000;
+        }
+    }
+
+    void Emit(int pid, int value)
+    {
+        Event e = { (unsigned long)ms, OBD, pid, (float)value };
+        events.push_back(e);
+    }
+};
+
+static void Synthesize(unsigned seed, int days, std::vector<Event> &events)
+{
+    Van van(seed, events);
+    for (int day = 0; day < days; day++)
+    {
+        int drives = 1 + (int)(van.uniform(van.rng) * 3);
+        for (int i = 0; i < drives; i++)
+        {
+            if (van.tank < FUEL_TANK_SIZE * 0.25)
+                van.FillUp();
+            van.Drive();
+            if (i < drives - 1)
+                van.Park(1200 + van.uniform(van.rng) * 9000, 0);
+        }
+
+        //Overnight, heater on some nights
+        double nextMorning = (day + 1) * 86400000.0 + 8 * 3600000.0 + van.uniform(van.rng) * 3600000.0;
+        double heater = van.uniform(van.rng) < 0.5 ? 0.08 + van.uniform(van.rng) * 0.07 : 0;
+        van.Park(std::max(0.0, (nextMorning - van.ms) / 1000), heater);
+    }
+    printf("Synthesized %d days: %.1f true gallons, %d fill-ups\n", days, van.trueGallons, van.fillUps);
+}
+
+//
+// Replay
+//
+
+//One engine run, or one tank between fill-ups
+struct Span
+{
+    double model, truth, raw;
+    int firstLevel, lastLevel;
+    bool calibrated;   //model had fitted a factor when it started
+
+    double TankGallons() { return firstLevel < 0 ? 0 : FUEL_TANK_SIZE * (firstLevel - lastLevel) / 100.0; }
+};
+
+struct ErrorStats
+{
+    double sumAbs = 0, sumSq = 0;
+    int count = 0;
+
+    void Add(double percent)
+    {
+        sumAbs += fabs(percent);
+        sumSq += percent * percent;
+        count++;
+    }
+    double MeanAbs() { return count ? sumAbs / count : NAN; }
+};
+
+int main(int argc, char **argv)
+{
+    const char *canPath = NULL;
+    bool synth = false;
+    unsigned seed = 1;
+    int days = 14;
+    int frameMs = 10;
+    float startFactor = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-c") == 0 && hasValue) canPath = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && hasValue) frameMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-factor") == 0 && hasValue) startFactor = atof(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0 && hasValue) seed = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-days") == 0 && hasValue) days = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-synth") == 0) synth = true;
+        else
+        {
+            fprintf(stderr, "usage: %s -c canlog [-f frameMs] [-factor n]\n"
+                            "       %s -synth [-seed n] [-days n]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Event> events;
+    if (synth)
+        Synthesize(seed, days, events);
+    if (canPath && !LoadCanLog(canPath, frameMs, events))
+        return 2;
+    if (events.empty())
+    {
+        fprintf(stderr, "Nothing to replay\n");
+        return 2;
+    }
+
+    FuelModel model;
+    if (startFactor > 0)
+    {
+        FuelCalibration calibration = { startFactor, 0, 0, 0, 0, 0, 0, 0, 0 };
+        model.setCalibration(calibration);
+    }
+
+    //Same outlier filter CurrentData puts in front of fuel level
+    Filter fuelFilter;
+    fuelFilter.init(9, 6, 3);
+
+    std::vector<Span> runs, tanks;
+    Span run = { 0, 0, 0, -1, -1, false };
+    Span tank = run;
+    double lastModel = 0, lastTruth = 0, lastRaw = 0;
+    double segmentTruth[FUEL_SEGMENTS] = { 0 };
+    bool hasTruth = false;
+    int lastRuns = 0;
+    uint32_t lastFills = 0;
+    int level = -1;
+    unsigned long firstMs = events.front().ms, lastMs = firstMs;
+
+    auto closeSpan = [&](Span &span, std::vector<Span> &spans) {
+        if (span.firstLevel >= 0 || span.model > 0)
+            spans.push_back(span);
+        span = Span{ 0, 0, 0, -1, -1, model.isCalibrated() };
+    };
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event &e = events[i];
+        lastMs = e.ms;
+
+        switch (e.kind)
+        {
+        case OBD:
+            if (e.pid == 0x04) model.addLoad(e.ms, e.value);
+            else if (e.pid == 0x10) model.addMaf(e.ms, e.value);
+            else if (e.pid == 0x0D) model.addSpeed(e.ms, e.value * KMH_2_MPH);
+            else if (e.pid == 0x2F && e.value != 0 && fuelFilter.writeIfNotOutlier((int)e.value))
+            {
+                level = (int)e.value;
+                model.addFuelLevel(e.ms, level);
+            }
+            break;
+        case CLIMB:
+            model.setClimbRate(e.value);
+            break;
+        case TRUTH:
+            segmentTruth[model.getSegment()] += e.value - lastTruth;
+            run.truth += e.value - lastTruth;
+            tank.truth += e.value - lastTruth;
+            lastTruth = e.value;
+            hasTruth = true;
+            break;
+        case ENGINE_OFF:
+            break;
+        }
+
+        //Book the model's fuel since the last event to the current run and tank
+        double modelNow = model.getTotalGallons(), rawNow = model.getRawGallons();
+        if (model.getRuns() != lastRuns)
+        {
+            //The first PID of a new run: close the last one (its fuel is already booked)
+            closeSpan(run, runs);
+            lastRuns = model.getRuns();
+        }
+        if (model.getFillUps() != lastFills)
+        {
+            closeSpan(tank, tanks);
+            tank.firstLevel = tank.lastLevel = level;
+            lastFills = model.getFillUps();
+        }
+        run.model += modelNow - lastModel;
+        tank.model += modelNow - lastModel;
+        run.raw += rawNow - lastRaw;
+        tank.raw += rawNow - lastRaw;
+        lastModel = modelNow;
+        lastRaw = rawNow;
+        if (e.kind == OBD && e.pid == 0x2F && level >= 0)
+        {
+            if (run.firstLevel < 0) run.firstLevel = level;
+            if (tank.firstLevel < 0) tank.firstLevel = level;
+            run.lastLevel = level;
+            tank.lastLevel = level;
+        }
+    }
+    closeSpan(run, runs);
+    tanks.push_back(tank);   //still in use: not scored as a whole tank
+
+    printf("Replayed %zu events over %.2f h: %d engine runs, %u fill-ups\n", events.size(),
+           (lastMs - firstMs) / 3600000.0, model.getRuns(), model.getFillUps());
+    printf("Calibration: x%.3f + %.2f gal/h %s\n", model.getFactor(), model.getIdleGallonsPerHour(),
+           model.isCalibrated() ? "(fitted from the tank gauge)" : "(default, not enough driving to fit)");
+    printf("Fuel: %.2f gal calibrated, %.2f gal uncalibrated, now %.2f gal/h\n", model.getTotalGallons(),
+           model.getRawGallons(), model.getGallonsPerHour());
+
+    const char *names[FUEL_SEGMENTS] = { "idle", "cruise", "climb" };
+    printf("\n%-8s %8s %8s", "segment", "gallons", "miles");
+    if (hasTruth)
+        printf(" %8s %8s", "truth", "error");
+    printf("\n");
+    for (int s = 0; s < FUEL_SEGMENTS; s++)
+    {
+        printf("%-8s %8.2f %8.1f", names[s], model.getGallons(s), model.getMiles(s));
+        if (hasTruth)
+            printf(" %8.2f %+7.1f%%", segmentTruth[s],
+                   segmentTruth[s] > 0 ? 100 * (model.getGallons(s) / segmentTruth[s] - 1) : 0.0);
+        printf("\n");
+    }
+
+    //Per engine run: model against the gauge's whole-percent delta
+    printf("\nEngine runs (gauge delta is +/- %.2f gal from whole percents):\n", FUEL_TANK_SIZE / 100.0);
+    printf("%4s %8s %8s %8s", "run", "model", "gauge", "diff");
+    if (hasTruth)
+        printf(" %8s %9s %9s", "truth", "model err", "gauge err");
+    printf("\n");
+    ErrorStats modelRunErr, gaugeRunErr;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        Span &r = runs[i];
+        double gauge = std::max(0.0, r.TankGallons());
+        bool show = runs.size() <= 40 || i < 10 || i >= runs.size() - 5;
+        if (show)
+            printf("%4zu %8.2f %8.2f %+8.2f", i + 1, r.model, gauge, r.model - gauge);
+        if (hasTruth && r.truth > 0.5)
+        {
+            double me = 100 * (r.model / r.truth - 1), ge = 100 * (gauge / r.truth - 1);
+            if (show)
+                printf(" %8.2f %+8.1f%% %+8.1f%%", r.truth, me, ge);
+            if (r.calibrated)
+            {
+                modelRunErr.Add(me);
+                gaugeRunErr.Add(ge);
+            }
+        }
+        if (show)
+            printf("%s\n", r.calibrated ? "" : "  (uncalibrated)");
+        else if (i == 10)
+            printf("  ...\n");
+    }
+
+    //Per tank, fill-up to fill-up
+    ErrorStats modelTankErr, gaugeTankErr;
+    if (tanks.size() > 1)
+    {
+        printf("\nTanks, fill-up to fill-up:\n%4s %8s %8s", "tank", "model", "gauge");
+        if (hasTruth)
+            printf(" %8s %9s %9s", "truth", "model err", "gauge err");
+        printf("\n");
+        for (size_t i = 0; i + 1 < tanks.size(); i++)
+        {
+            Span &t = tanks[i];
+            double gauge = t.TankGallons();
+            printf("%4zu %8.2f %8.2f", i + 1, t.model, gauge);
+            if (hasTruth && t.truth > 0)
+            {
+                //Gauge counts heater fuel too; the model only sees the engine
+                double me = 100 * (t.model / t.truth - 1), ge = 100 * (gauge / t.truth - 1);
+                printf(" %8.2f %+8.1f%% %+8.1f%%", t.truth, me, ge);
+                if (t.calibrated)
+                {
+                    modelTankErr.Add(me);
+                    gaugeTankErr.Add(ge);
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    if (!hasTruth)
+        return 0;
+
+    double totalErr = 100 * (model.getTotalGallons() / lastTruth - 1);
+    printf("\nCalibrated runs over 0.5 gal: %d, mean |error| model %.1f%%, gauge delta %.1f%%\n",
+           modelRunErr.count, modelRunErr.MeanAbs(), gaugeRunErr.MeanAbs());
+    printf("Calibrated tanks: %d, mean |error| model %.1f%%, gauge delta %.1f%%\n", modelTankErr.count,
+           modelTankErr.MeanAbs(), gaugeTankErr.MeanAbs());
+    printf("Whole drive (incl. before calibration): model %+.1f%%\n", totalErr);
+
+    printf("\n");
+    check(model.isCalibrated(), "model calibrated from the fill-ups");
+    check(modelRunErr.count > 0 && modelRunErr.MeanAbs() < 5, "per-run model error under 5%");
+    check(modelRunErr.MeanAbs() < gaugeRunErr.MeanAbs() / 2, "per-run model error under half the gauge delta's");
+    check(modelTankErr.count == 0 || modelTankErr.MeanAbs() < 3, "per-tank model error under 3%");
+    return checkResult();
+}
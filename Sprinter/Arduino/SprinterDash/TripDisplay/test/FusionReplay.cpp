@@ -0,0 +1,529 @@
+//
+// Host replay for SensorFusion.
+//
+// Feeds logged (or synthesized) sensor readings through the same
+// SensorFusion the dash runs, and compares it with what the dash showed
+// before fusion: the offset-corrected baro through its outlier Filter, the
+// integer OBD speed, and pitot minus OBD speed for headwind.
+//
+//   FusionReplay [-c canlog] [-s sensors.csv] [-f frameMs] [-o out.csv]
+//   FusionReplay -synth [-seed n] [-w prefix] [-o out.csv]
+//
+// -c  CAN log in any of the CANCapture styles (TorqueLog1.csv "7E8,3 41 D 1E",
+//     candump "0x7E8,0x3,0x41,0xD,0x1E", dumptiming "15:45:25.633 -> 0x7E8,...").
+//     OBD speed (PID 0x0D) responses become OBD readings.  Logs without
+//     timestamps are taken to be one frame every -f ms (default 10).
+// -s  Sensor CSV, one reading per line, ms from the start of the CAN log:
+//       ms,baro,<raw ft>        ms,gps,<alt m>,<knots>,<sats>
+//       ms,pitot,<mph>          ms,dem,<ft>
+//       ms,truth,<elevation ft>,<speed mph>,<headwind mph>   (scoring only)
+// -synth  Generate a 40 minute drive over a pass with known truth, baro
+//     weather drift and spikes, a GPS outage and a wind shift, then score
+//     it.  Exits non-zero if fusion doesn't beat the old display and stay
+//     inside the error limits.  -w writes it out as prefix.can.txt and
+//     prefix.sensors.csv so it can be replayed with -c/-s.
+//
+// A CAN log without a sensor CSV has OBD speed and nothing else, so that's
+// all it can score: the log has to move, and the fused speed has to follow
+// OBD.  None of the CANCapture logs have baro, GPS or an elevation change;
+// elevation, climb and headwind are only scored on the synthetic drive.
+// TorqueLog1.csv and candump.txt sit at 0 mph the whole time and fail.
+//
+// Build (from TripDisplay/):
+//   g++ -std=c++11 -O2 -Itest/stubs -o FusionReplay test/FusionReplay.cpp src/sensors/SensorFusion.cpp src/sensors/Filter.cpp
+//   ./FusionReplay -synth
+//   ./FusionReplay -c ../CANCapture/dumptiming.csv
+//
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../src/sensors/Filter.h"
+#include "../src/sensors/SensorFusion.h"
+#include "CanLog.h"
+#include "Check.h"
+
+#define KMH_2_MPH 0.621371f
+
+enum Kind { OBD_SPEED, BARO, GPS, PITOT, DEM, TRUTH };
+
+struct Event
+{
+    unsigned long ms;
+    Kind kind;
+    float a, b, c;
+};
+
+static bool EventBefore(const Event &x, const Event &y)
+{
+    return x.ms < y.ms;
+}
+
+//
+// Loading
+//
+
+static bool LoadCanLog(const char *path, int frameMs, std::vector<Event> &events)
+{
+    std::vector<ObdResponse> responses;
+    long frames = 0;
+    if (!ReadObdResponses(path, frameMs, responses, frames))
+        return false;
+
+    //PID 0x0D: vehicle speed, km/h
+    int speedFrames = 0;
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        if (responses[i].pid != 0x0D)
+            continue;
+        Event e = { responses[i].ms, OBD_SPEED, responses[i].a * KMH_2_MPH, 0, 0 };
+        events.push_back(e);
+        speedFrames++;
+    }
+    printf("%s: %ld frames, %d OBD speed readings\n", path, frames, speedFrames);
+    return true;
+}
+
+static bool LoadSensors(const char *path, std::vector<Event> &events)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        lineNo++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        unsigned long ms;
+        char kind[16];
+        float a = 0, b = 0, c = 0;
+        int n = sscanf(line, "%lu,%15[^,],%f,%f,%f", &ms, kind, &a, &b, &c);
+        Event e = { ms, BARO, a, b, c };
+        if (n >= 3 && strcmp(kind, "baro") == 0)
+            e.kind = BARO;
+        else if (n >= 5 && strcmp(kind, "gps") == 0)
+            e.kind = GPS;
+        else if (n >= 3 && strcmp(kind, "pitot") == 0)
+            e.kind = PITOT;
+        else if (n >= 3 && strcmp(kind, "dem") == 0)
+            e.kind = DEM;
+        else if (n >= 5 && strcmp(kind, "truth") == 0)
+            e.kind = TRUTH;
+        else
+        {
+            fprintf(stderr, "%s:%d: can't parse '%s'\n", path, lineNo, line);
+            continue;
+        }
+        events.push_back(e);
+    }
+    fclose(f);
+    return true;
+}
+
+//
+// Synthetic drive
+//
+
+struct Truth
+{
+    float elevation;  //ft
+    float speed;      //mph
+    float headwind;   //mph
+};
+
+static float SpeedAt(float t)
+{
+    if (t < 30) return 0;
+    if (t < 60) return (t - 30) * 2;           //0-60 in 30 s
+    if (t < 600) return 60;
+    if (t < 620) return 60 - (t - 600);        //slow for the climb
+    if (t < 1500) return 40;
+    if (t < 1520) return 40 + (t - 1500);
+    if (t < 2300) return 60;
+    if (t < 2330) return 60 - (t - 2300) * 2;  //pull over
+    return 0;
+}
+
+static float GradeAt(float t)
+{
+    if (t >= 600 && t < 1500) return 0.06f;
+    if (t >= 1500 && t < 2100) return -0.05f;
+    return 0;
+}
+
+static float HeadwindAt(float t)
+{
+    if (t < 1200) return 10;
+    if (t < 1300) return 10 - (t - 1200) * 0.15f;  //swings round to a 5 mph tailwind
+    return -5;
+}
+
+static void Synthesize(unsigned seed, std::vector<Event> &events)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> unit(0, 1);
+    std::uniform_real_distribution<float> uniform(0, 1);
+
+    const float duration = 2400;
+    const float step = 0.1f;
+
+    //Truth, integrated at 10 Hz
+    std::vector<Truth> truth;
+    float elevation = 1500;
+    for (float t = 0; t <= duration; t += step)
+    {
+        Truth now = { elevation, SpeedAt(t), HeadwindAt(t) };
+        truth.push_back(now);
+        elevation += GradeAt(t) * SpeedAt(t) * 1.46667f * step;
+    }
+    auto at = [&](float t) -> const Truth & {
+        size_t i = (size_t)(t / step);
+        return truth[std::min(i, truth.size() - 1)];
+    };
+
+    //Truth once a second for scoring
+    for (float t = 0; t <= duration; t += 1)
+    {
+        Event e = { (unsigned long)(t * 1000), TRUTH, at(t).elevation, at(t).speed, at(t).headwind };
+        events.push_back(e);
+    }
+
+    //Barometer: a reading every ~10.6 s, reading 40 ft high and drifting
+    //another 30 ft with the weather, with the odd wild spike
+    for (float t = 5; t <= duration; t += 10.6f)
+    {
+        float bias = 40 + 30 * t / duration;
+        float raw = at(t).elevation + bias + unit(rng) * 2;
+        if (uniform(rng) < 0.03f)
+            raw += (uniform(rng) < 0.5f ? -1 : 1) * 200;
+        Event e = { (unsigned long)(t * 1000), BARO, (float)(int)raw, 0, 0 };
+        events.push_back(e);
+    }
+
+    //GPS at 1 Hz from 15 s: altitude error wanders slowly (~25 ft) plus
+    //white noise; a tunnel from 1700 to 1760 s
+    float wander = 0;
+    const float decay = expf(-1.0f / 60);
+    for (float t = 15; t <= duration; t += 1)
+    {
+        wander = wander * decay + unit(rng) * 25 * sqrtf(1 - decay * decay);
+        if (t >= 1700 && t < 1760)
+            continue;
+        float altM = (at(t).elevation + wander + unit(rng) * 10) / METERS_2_FEET;
+        float knots = std::max(0.0f, at(t).speed + unit(rng) * 0.4f) / KNOTS_2_MPH;
+        Event e = { (unsigned long)(t * 1000), GPS, altM, knots, 9 };
+        events.push_back(e);
+    }
+
+    //OBD speed every 0.8 s, whole km/h, 300 ms behind
+    for (float t = 1; t <= duration; t += 0.8f)
+    {
+        float kmh = floorf(at(t - 0.3f).speed / KMH_2_MPH);
+        Event e = { (unsigned long)(t * 1000), OBD_SPEED, kmh * KMH_2_MPH, 0, 0 };
+        events.push_back(e);
+    }
+
+    //Pitot every 0.5 s: airspeed with sensor noise and gusts
+    for (float t = 0.5f; t <= duration; t += 0.5f)
+    {
+        const Truth &now = at(t);
+        float air = now.speed > 0 ? now.speed + now.headwind : 0;
+        float reading = air + unit(rng) * 3;
+        if (reading < 10)
+            reading = 0;  //no usable dynamic pressure down here
+        Event e = { (unsigned long)(t * 1000), PITOT, (float)(int)reading, 0, 0 };
+        events.push_back(e);
+    }
+
+    //One ElevationAPI lookup on the home WiFi before leaving
+    Event dem = { 20000, DEM, at(20).elevation + unit(rng) * 15, 0, 0 };
+    events.push_back(dem);
+}
+
+static bool WriteSynthetic(const char *prefix, const std::vector<Event> &events)
+{
+    std::string canPath = std::string(prefix) + ".can.txt";
+    std::string sensorPath = std::string(prefix) + ".sensors.csv";
+    FILE *can = fopen(canPath.c_str(), "w");
+    FILE *sensors = fopen(sensorPath.c_str(), "w");
+    if (can == NULL || sensors == NULL)
+    {
+        perror(prefix);
+        return false;
+    }
+
+    fprintf(sensors, "# ms,kind,values... (see FusionReplay.cpp)\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event &e = events[i];
+        unsigned long ms = e.ms;
+        switch (e.kind)
+        {
+        case OBD_SPEED:
+            //Same layout as CANCapture's serial dumps (dumptiming.csv)
+            fprintf(can, "%02lu:%02lu:%02lu.%03lu -> 0x7DF,0x2,0x1,0xD,0x0,0x0,0x0,0x0,0x0,\n",
+                    ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+            fprintf(can, "%02lu:%02lu:%02lu.%03lu -> 0x7E8,0x3,0x41,0xD,0x%X,0x0,0x0,0x0,0x0,\n",
+                    ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000,
+                    (unsigned)lroundf(e.a / KMH_2_MPH));
+            break;
+        case BARO:  fprintf(sensors, "%lu,baro,%.0f\n", ms, e.a); break;
+        case GPS:   fprintf(sensors, "%lu,gps,%.2f,%.2f,%.0f\n", ms, e.a, e.b, e.c); break;
+        case PITOT: fprintf(sensors, "%lu,pitot,%.0f\n", ms, e.a); break;
+        case DEM:   fprintf(sensors, "%lu,dem,%.1f\n", ms, e.a); break;
+        case TRUTH: fprintf(sensors, "%lu,truth,%.1f,%.1f,%.1f\n", ms, e.a, e.b, e.c); break;
+        }
+    }
+    fclose(can);
+    fclose(sensors);
+    printf("Wrote %s and %s\n", canPath.c_str(), sensorPath.c_str());
+    return true;
+}
+
+//
+// Replay
+//
+
+struct Score
+{
+    const char *name;
+    double dashSq, fusedSq, confidence;
+    int dashCount, fusedCount;
+
+    void Add(bool hasDash, float dash, bool hasFused, float fused, float conf, float truth)
+    {
+        if (hasDash)
+        {
+            dashSq += (dash - truth) * (dash - truth);
+            dashCount++;
+        }
+        if (hasFused)
+        {
+            fusedSq += (fused - truth) * (fused - truth);
+            confidence += conf;
+            fusedCount++;
+        }
+    }
+    double DashRms() { return dashCount ? sqrt(dashSq / dashCount) : NAN; }
+    double FusedRms() { return fusedCount ? sqrt(fusedSq / fusedCount) : NAN; }
+    double MeanConfidence() { return fusedCount ? confidence / fusedCount : NAN; }
+};
+
+int main(int argc, char **argv)
+{
+    const char *canPath = NULL;
+    const char *sensorPath = NULL;
+    const char *outPath = NULL;
+    const char *writePrefix = NULL;
+    bool synth = false;
+    unsigned seed = 1;
+    int frameMs = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-c") == 0 && hasValue) canPath = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && hasValue) sensorPath = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && hasValue) outPath = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && hasValue) writePrefix = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && hasValue) frameMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0 && hasValue) seed = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-synth") == 0) synth = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-c canlog] [-s sensors.csv] [-f frameMs] [-o out.csv]\n"
+                            "       %s -synth [-seed n] [-w prefix] [-o out.csv]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Event> events;
+    if (synth)
+        Synthesize(seed, events);
+    if (canPath && !LoadCanLog(canPath, frameMs, events))
+        return 2;
+    if (sensorPath && !LoadSensors(sensorPath, events))
+        return 2;
+    if (events.empty())
+    {
+        fprintf(stderr, "Nothing to replay\n");
+        return 2;
+    }
+    std::stable_sort(events.begin(), events.end(), EventBefore);
+    if (writePrefix && !WriteSynthetic(writePrefix, events))
+        return 2;
+
+    FILE *out = outPath ? fopen(outPath, "w") : NULL;
+    if (out)
+        fprintf(out, "ms,elevation,elevConf,climbFpm,speed,speedConf,headwind,windConf,"
+                     "dashElevation,dashSpeed,dashHeadwind,trueElevation,trueSpeed,trueHeadwind\n");
+
+    SensorFusion fusion;
+
+    //The pre-fusion dash, as TripDisplay computes it
+    Filter dashFilter;
+    dashFilter.init(9, 50, 3);
+    int offset = 0;
+    int lastRaw = 0;
+    bool hasBaro = false;
+    int dashElevation = 0;
+    int dashSpeed = 0;
+    int dashPitot = 0;
+    bool hasObd = false;
+    float obdSpeed = 0;
+
+    Score elevation = { "elevation ft", 0, 0, 0, 0, 0 }, climb = { "climb ft/min", 0, 0, 0, 0, 0 },
+          speed = { "speed mph", 0, 0, 0, 0, 0 }, headwind = { "headwind mph", 0, 0, 0, 0, 0 };
+    float lastTrueElevation = 0;
+    bool hasTruth = false;
+    double speedSum = 0;
+    float speedMax = 0;
+    int samples = 0;
+    double trackSq = 0;
+    float obdMax = 0;
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event &e = events[i];
+        switch (e.kind)
+        {
+        case OBD_SPEED:
+            fusion.addObdSpeed(e.ms, e.a);
+            dashSpeed = (int)e.a;
+            obdSpeed = e.a;
+            hasObd = true;
+            break;
+        case BARO:
+            lastRaw = (int)e.a;
+            hasBaro = true;
+            fusion.addBaroElevation(e.ms, lastRaw + offset);
+            if (dashFilter.writeIfNotOutlier(lastRaw))
+                dashElevation = lastRaw + offset;
+            break;
+        case GPS:
+            fusion.addGpsFix(e.ms, e.a, e.b, (int)e.c);
+            break;
+        case PITOT:
+            fusion.addPitotSpeed(e.ms, e.a);
+            dashPitot = (int)e.a;
+            break;
+        case DEM:
+            //What TripDisplay does with an ElevationAPI result
+            if (hasBaro)
+            {
+                int newOffset = (int)e.a - lastRaw;
+                fusion.shiftBaroBias(newOffset - offset);
+                fusion.addReferenceElevation(e.ms, e.a);
+                offset = newOffset;
+                dashFilter.reset();
+                dashElevation = lastRaw + offset;
+            }
+            break;
+        case TRUTH:
+        {
+            fusion.advance(e.ms);
+            float trueClimb = hasTruth ? (e.a - lastTrueElevation) * 60 : 0;
+            lastTrueElevation = e.a;
+            hasTruth = true;
+
+            elevation.Add(hasBaro, dashElevation, fusion.hasElevation(), fusion.getElevation(),
+                          fusion.getElevationConfidence(), e.a);
+            climb.Add(false, 0, fusion.hasElevation(), fusion.getClimbRate(), fusion.getElevationConfidence(),
+                      trueClimb);
+            speed.Add(hasObd, dashSpeed, fusion.hasSpeed(), fusion.getSpeed(), fusion.getSpeedConfidence(), e.b);
+            //Headwind only means anything on the move
+            if (e.b >= 30)
+                headwind.Add(hasObd, dashPitot - dashSpeed, fusion.hasHeadwind(), fusion.getHeadwind(),
+                             fusion.getHeadwindConfidence(), e.c);
+            break;
+        }
+        }
+
+        //Untruthed logs: sample once a second from the event stream
+        bool second = i + 1 == events.size() || events[i + 1].ms / 1000 != e.ms / 1000;
+        if (second)
+        {
+            fusion.advance(e.ms);
+            if (fusion.hasSpeed() && hasObd)
+            {
+                speedSum += fusion.getSpeed();
+                speedMax = std::max(speedMax, fusion.getSpeed());
+                trackSq += (fusion.getSpeed() - obdSpeed) * (fusion.getSpeed() - obdSpeed);
+                obdMax = std::max(obdMax, obdSpeed);
+                samples++;
+            }
+            if (out)
+            {
+                fprintf(out, "%lu,%.1f,%.2f,%.0f,%.2f,%.2f,%.2f,%.2f,%d,%d,%d", e.ms, fusion.getElevation(),
+                        fusion.getElevationConfidence(), fusion.getClimbRate(), fusion.getSpeed(),
+                        fusion.getSpeedConfidence(), fusion.getHeadwind(), fusion.getHeadwindConfidence(),
+                        dashElevation, dashSpeed, dashPitot - dashSpeed);
+                if (e.kind == TRUTH)
+                    fprintf(out, ",%.1f,%.1f,%.1f", e.a, e.b, e.c);
+                fprintf(out, "\n");
+            }
+        }
+    }
+    if (out)
+        fclose(out);
+
+    printf("Replayed %zu readings over %.0f s, %lu rejected as outliers\n", events.size(),
+           events.back().ms / 1000.0, fusion.getRejectedCount());
+    printf("Fused speed: mean %.1f mph, max %.1f mph, confidence %.2f at the end\n",
+           samples ? speedSum / samples : 0.0, speedMax, fusion.getSpeedConfidence());
+    if (fusion.hasElevation())
+        printf("Fused elevation: %.0f ft (confidence %.2f), baro bias %.0f ft\n", fusion.getElevation(),
+               fusion.getElevationConfidence(), fusion.getBaroBias());
+    char what[128];
+    if (!hasTruth)
+    {
+        if (synth || sensorPath)
+            return 0;
+
+        //OBD speed is all a CAN log has: it has to move, and fusion has to keep up with it
+        double trackRms = samples ? sqrt(trackSq / samples) : NAN;
+        printf("\n");
+        snprintf(what, sizeof(what), "log moves: OBD speed up to %.1f mph (10 needed)", obdMax);
+        check(obdMax >= 10, what);
+        snprintf(what, sizeof(what), "fused speed follows OBD: %.2f mph RMS once a second (under 2)", trackRms);
+        check(samples > 0 && trackRms < 2, what);
+        return checkResult();
+    }
+
+    printf("\n%-14s %10s %10s %10s\n", "RMS error", "dash", "fused", "confidence");
+    Score *scores[] = { &elevation, &climb, &speed, &headwind };
+    for (size_t i = 0; i < sizeof(scores) / sizeof(scores[0]); i++)
+        printf("%-14s %10.2f %10.2f %10.2f\n", scores[i]->name, scores[i]->DashRms(), scores[i]->FusedRms(),
+               scores[i]->MeanConfidence());
+
+    if (!synth)
+        return 0;
+
+    //Limits for the synthetic drive
+    printf("\n");
+    snprintf(what, sizeof(what), "elevation: fused %.1f ft RMS, under 30 and the dash's %.1f", elevation.FusedRms(),
+             elevation.DashRms());
+    check(elevation.FusedRms() < 30 && elevation.FusedRms() < elevation.DashRms(), what);
+    snprintf(what, sizeof(what), "climb: fused %.0f ft/min RMS, under 150", climb.FusedRms());
+    check(climb.FusedRms() < 150, what);
+    snprintf(what, sizeof(what), "speed: fused %.2f mph RMS, under 1.5 and the dash's %.2f", speed.FusedRms(),
+             speed.DashRms());
+    check(speed.FusedRms() < 1.5 && speed.FusedRms() < speed.DashRms(), what);
+    snprintf(what, sizeof(what), "headwind: fused %.2f mph RMS, under 4 and the dash's %.2f", headwind.FusedRms(),
+             headwind.DashRms());
+    check(headwind.FusedRms() < 4 && headwind.FusedRms() < headwind.DashRms(), what);
+    return checkResult();
+}
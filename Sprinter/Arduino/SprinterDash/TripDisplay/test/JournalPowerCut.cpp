@@ -0,0 +1,280 @@
+//
+// Host power-cut test for Journal.
+//
+// Runs a run of saves (PropBag, GPS and trip records, enough to roll
+// round the sectors a few times) against a RAM flash model that behaves
+// like NOR flash: erase sets bytes to 0xFF, writes can only clear bits.
+// Then repeats it once for every byte the run programs, cutting power
+// just after that byte (the byte itself only half programmed), and once
+// for each erase (the sector left half erased).  After every cut it
+// "reboots" - a new Journal over the same flash - and checks that each
+// key loads as either its last completed save or the one in flight, never
+// garbage or anything older.  It then saves again after recovery and
+// reboots once more to check the journal is still usable.
+//
+// Build and run (from TripDisplay/):
+//   g++ -std=c++11 -O2 -o JournalPowerCut test/JournalPowerCut.cpp src/data/Journal.cpp
+//   ./JournalPowerCut
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/data/Journal.h"
+#include "Check.h"
+
+#define SECTORS 3          //small region so the run rolls over often
+#define SAVES 600
+
+//Thrown when the power budget runs out, abandoning the run
+struct PowerCut {};
+
+class RamFlash : public JournalStorage
+{
+  public:
+    std::vector<uint8_t> bytes;
+    long budget=-1;        //bytes (or erases) left before the cut, -1 for no cut
+    long programmed=0;     //bytes written + erases so far
+
+    RamFlash() : bytes(SECTORS*JOURNAL_SECTOR_SIZE,0xFF) {}
+
+    uint32_t getSize() { return bytes.size(); }
+
+    bool read(uint32_t address, void *buffer, size_t length)
+    {
+        if(address+length>bytes.size())
+            return false;
+        memcpy(buffer,&bytes[address],length);
+        return true;
+    }
+
+    bool write(uint32_t address, const void *buffer, size_t length)
+    {
+        if(address+length>bytes.size())
+            return false;
+        const uint8_t *data=(const uint8_t *)buffer;
+        for(size_t i=0;i<length;i++)
+        {
+            if(budget==0)
+            {
+                //The byte being programmed when the power went: some bits only
+                bytes[address+i]&=data[i]|0x0F;
+                throw PowerCut();
+            }
+            bytes[address+i]&=data[i];
+            programmed++;
+            if(budget>0)
+                budget--;
+        }
+        return true;
+    }
+
+    bool eraseSector(uint32_t address)
+    {
+        if(address%JOURNAL_SECTOR_SIZE!=0 || address>=bytes.size())
+            return false;
+        if(budget==0)
+        {
+            //Half erased, the rest still holding old records
+            memset(&bytes[address],0xFF,JOURNAL_SECTOR_SIZE/2);
+            throw PowerCut();
+        }
+        memset(&bytes[address],0xFF,JOURNAL_SECTOR_SIZE);
+        programmed++;
+        if(budget>0)
+            budget--;
+        return true;
+    }
+};
+
+//What the firmware persists, roughly
+struct Record
+{
+    uint8_t key;
+    uint8_t length;
+    uint8_t data[JOURNAL_MAX_PAYLOAD];
+};
+
+static Record MakeSave(int i)
+{
+    //PropBag most often, then the two saved trips.  GPS only now and then
+    //and the full trip just once, so rollovers have to carry them forward.
+    static const uint8_t keys[]={JOURNAL_KEY_PROPBAG,JOURNAL_KEY_TRIP,JOURNAL_KEY_PROPBAG,JOURNAL_KEY_PROPBAG,JOURNAL_KEY_GPS};
+    static const uint8_t lengths[]={24,48,24,24,8};
+    Record r;
+    int slot=i%5;
+    if(slot==4 && i%150!=4)
+        slot=0;
+    r.key=keys[slot];
+    r.length=lengths[slot];
+    if(i==2)
+    {
+        r.key=JOURNAL_KEY_TRIP+1;
+        r.length=48;
+    }
+    for(int b=0;b<r.length;b++)
+        r.data[b]=(uint8_t)(i*31+b*7+(b==r.length-1 ? 0xFF : 0));  //some payloads end in 0xFF
+    if(i%7==0)
+        memset(r.data+r.length-4,0xFF,4);
+    return r;
+}
+
+struct Expected
+{
+    bool known;
+    Record last;       //last completed save
+    bool inFlight;
+    Record pending;    //save interrupted by the cut
+};
+
+static bool Matches(const Record &r, const uint8_t *data, int length)
+{
+    return length==r.length && memcmp(data,r.data,length)==0;
+}
+
+//Check every key loads as its last completed save or the one in flight
+static bool Verify(Journal &journal, Expected *expected, const char *when, long cut)
+{
+    for(int key=0;key<JOURNAL_MAX_KEYS;key++)
+    {
+        uint8_t data[JOURNAL_MAX_PAYLOAD];
+        int length=journal.load(key,data,sizeof(data));
+        Expected &e=expected[key];
+        bool ok;
+        if(length<0)
+            ok=!e.known;   //nothing completed yet (an in-flight first save may or may not land)
+        else
+            ok=(e.known && Matches(e.last,data,length)) || (e.inFlight && Matches(e.pending,data,length));
+        if(!ok)
+        {
+            printf("FAIL cut %ld (%s): key %d loaded %d bytes, expected %s\n",cut,when,key,length,
+                   e.known ? "last completed save" : "nothing");
+            return false;
+        }
+    }
+    return true;
+}
+
+//One run: saves until the cut (if any), reboot, verify, save again, reboot, verify
+static bool RunWithCut(long cut, long &programmed)
+{
+    RamFlash flash;
+    Expected expected[JOURNAL_MAX_KEYS];
+    memset(expected,0,sizeof(expected));
+
+    Journal journal;
+    flash.budget=cut;
+    try
+    {
+        if(!journal.begin(&flash))
+        {
+            printf("FAIL cut %ld: begin on blank flash\n",cut);
+            return false;
+        }
+        for(int i=0;i<SAVES;i++)
+        {
+            Record r=MakeSave(i);
+            Expected &e=expected[r.key];
+            e.inFlight=true;
+            e.pending=r;
+            if(!journal.save(r.key,r.data,r.length))
+            {
+                printf("FAIL cut %ld: save %d failed without a power cut\n",cut,i);
+                return false;
+            }
+            e.inFlight=false;
+            e.known=true;
+            e.last=r;
+        }
+    }
+    catch(PowerCut &)
+    {
+    }
+    programmed=flash.programmed;
+    flash.budget=-1;
+
+    //Reboot
+    Journal rebooted;
+    if(!rebooted.begin(&flash))
+    {
+        printf("FAIL cut %ld: begin after the cut\n",cut);
+        return false;
+    }
+    if(!Verify(rebooted,expected,"after cut",cut))
+        return false;
+
+    //Whatever it recovered is now what's stored
+    for(int key=0;key<JOURNAL_MAX_KEYS;key++)
+    {
+        Expected &e=expected[key];
+        uint8_t data[JOURNAL_MAX_PAYLOAD];
+        int length=rebooted.load(key,data,sizeof(data));
+        e.inFlight=false;
+        e.known=length>=0;
+        if(e.known)
+        {
+            e.last.key=key;
+            e.last.length=length;
+            memcpy(e.last.data,data,length);
+        }
+    }
+
+    //Keep going: enough saves to roll over again
+    for(int i=SAVES;i<SAVES+120;i++)
+    {
+        Record r=MakeSave(i);
+        if(!rebooted.save(r.key,r.data,r.length))
+        {
+            printf("FAIL cut %ld: save %d after recovery\n",cut,i);
+            return false;
+        }
+        expected[r.key].known=true;
+        expected[r.key].last=r;
+    }
+
+    Journal again;
+    if(!again.begin(&flash))
+    {
+        printf("FAIL cut %ld: second reboot\n",cut);
+        return false;
+    }
+    return Verify(again,expected,"after recovery",cut);
+}
+
+int main()
+{
+    //Uncut run: how much flash work there is to cut into
+    long total;
+    bool uncut=RunWithCut(-1,total);
+    check(uncut,"saves, reboot and recovery without a power cut");
+    if(!uncut)
+        return checkResult();
+
+    RamFlash probe;
+    Journal journal;
+    journal.begin(&probe);
+    for(int i=0;i<SAVES;i++)
+    {
+        Record r=MakeSave(i);
+        journal.save(r.key,r.data,r.length);
+    }
+    printf("%d saves: %ld bytes programmed, %u erases, sequence %u, over %u sectors\n",SAVES,total,
+           journal.getEraseCount(),journal.getSequence(),journal.getSectorCount());
+
+    int failures=0;
+    for(long cut=0;cut<total;cut++)
+    {
+        long programmed;
+        if(!RunWithCut(cut,programmed))
+            failures++;
+        if(failures>10)
+            break;
+    }
+
+    char what[100];
+    snprintf(what,sizeof(what),"%ld power cuts, every key its last save or the one in flight%s",total,
+             failures>10 ? " (stopped after 10 failures)" : "");
+    check(failures==0,what);
+    return checkResult();
+}
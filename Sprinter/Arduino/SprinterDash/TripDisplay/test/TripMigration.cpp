@@ -0,0 +1,216 @@
+//
+// Host check that trips saved by older builds load unchanged.
+//
+// A 512 byte EEPROM image is laid out the way builds before the journal
+// left it: PropBag, then the two saved trips 48 bytes apart, then the GPS
+// position.  It is loaded through Journal::loadOrMigrate(), as
+// PropBag::loadRecord() does, from the offsets in TripRecord.h:
+//  - without a journal partition (straight from EEPROM)
+//  - migrating into an empty journal, then again after a reboot
+//  - from a journal the first journal build wrote (48 byte trip records)
+// Every trip field must come back as it was.  The engine fuel record, which
+// older builds never wrote, must come back as zero whatever was in EEPROM
+// there (erased, zeroed or stale bytes), and its EEPROM spot must not
+// overlap anything else.
+//
+// Build and run (from TripDisplay/):
+//   g++ -std=c++11 -O2 -o TripMigration test/TripMigration.cpp src/data/Journal.cpp
+//   ./TripMigration
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/data/Journal.h"
+#include "../src/data/TripRecord.h"
+#include "Check.h"
+
+#define EEPROM_SIZE 512
+#define PROPBAG_SIZE 24            // sizeof(PropBagStruct) on the ESP32
+#define GPS_EEPROM_OFFSET 400      // PropBag.h
+#define FUEL_EEPROM_OFFSET 420
+#define FUEL_CALIBRATION_SIZE 56   // sizeof(FuelCalibration)
+
+class RamFlash : public JournalStorage
+{
+  public:
+    std::vector<uint8_t> bytes;
+
+    RamFlash() : bytes(4*JOURNAL_SECTOR_SIZE,0xFF) {}
+
+    uint32_t getSize() { return bytes.size(); }
+
+    bool read(uint32_t address, void *buffer, size_t length)
+    {
+        if(address+length>bytes.size())
+            return false;
+        memcpy(buffer,&bytes[address],length);
+        return true;
+    }
+
+    bool write(uint32_t address, const void *buffer, size_t length)
+    {
+        if(address+length>bytes.size())
+            return false;
+        for(size_t i=0;i<length;i++)
+            bytes[address+i]&=((const uint8_t *)buffer)[i];
+        return true;
+    }
+
+    bool eraseSector(uint32_t address)
+    {
+        if(address%JOURNAL_SECTOR_SIZE!=0 || address>=bytes.size())
+            return false;
+        memset(&bytes[address],0xFF,JOURNAL_SECTOR_SIZE);
+        return true;
+    }
+};
+
+//The EEPROM image, as Journal::loadOrMigrate() sees it
+class RamEeprom : public LegacyStorage
+{
+  public:
+    const uint8_t *bytes;
+
+    RamEeprom(const uint8_t *_bytes) : bytes(_bytes) {}
+
+    void read(int offset, void *buffer, int length)
+    {
+        memcpy(buffer,bytes+offset,length);
+    }
+};
+
+static TripDataStruct MakeTrip(int idx)
+{
+    TripDataStruct trip;
+    memset(&trip,0,sizeof(trip));
+    trip.startMiles=101234+idx*1000;
+    trip.lastMiles=101456+idx*1000;
+    trip.priorTotalMiles=12+idx;
+    trip.startSeconds=800000000+idx*86400;
+    trip.ignOffSeconds=800003600+idx*86400;
+    trip.totalParkedSeconds=7200+idx;
+    trip.totalStoppedSeconds=900+idx;
+    trip.numberOfStops=3+idx;
+    trip.stoppedFuelPerc=61-idx;
+    trip.startFuelPerc=88-idx;
+    trip.priorTotalGallonsUsed=4.25f+idx;
+    trip.totalClimb=5432+idx;
+    trip.lastElevation=6100+idx;
+    return trip;
+}
+
+static bool FuelIsZero(const TripFuelStruct &fuel)
+{
+    for(int i=0;i<FUEL_SEGMENTS;i++)
+        if(fuel.engineGallons[i]!=0 || fuel.segmentMiles[i]!=0)
+            return false;
+    return true;
+}
+
+//Load both trips and their fuel; true if the trips match and fuel is zero
+static bool LoadTrips(Journal &journal, const uint8_t *eeprom, bool *lengthsOk)
+{
+    RamEeprom legacy(eeprom);
+    bool ok=true;
+    *lengthsOk=true;
+    for(int idx=0;idx<SAVED_TRIPS;idx++)
+    {
+        TripDataStruct trip;
+        TripFuelStruct fuel;
+        int loaded=journal.loadOrMigrate(JOURNAL_KEY_TRIP+idx,&trip,sizeof(trip),&legacy,tripEepromOffset(PROPBAG_SIZE,idx));
+        journal.loadOrMigrate(JOURNAL_KEY_TRIP_FUEL+idx,&fuel,sizeof(fuel),&legacy,tripFuelEepromOffset(idx));
+        checkTripFuel(&fuel);
+
+        TripDataStruct expected=MakeTrip(idx);
+        if(memcmp(&trip,&expected,sizeof(trip))!=0 || !FuelIsZero(fuel))
+            ok=false;
+        if(loaded>=0 && loaded!=(int)sizeof(trip))
+            *lengthsOk=false;      //"Struct changed?" on the device
+    }
+    return ok;
+}
+
+int main()
+{
+    char what[128];
+
+    //Layout
+    check(sizeof(TripDataStruct)==LEGACY_TRIP_SIZE,"trip record is the legacy 48 bytes");
+    int tripsEnd=tripEepromOffset(PROPBAG_SIZE,SAVED_TRIPS+1);   //room for since last stop too
+    int fuelEnd=tripFuelEepromOffset(SAVED_TRIPS);
+    snprintf(what,sizeof(what),"fuel records at %d..%d clear of trips (..%d) and GPS (%d)",
+             TRIP_FUEL_EEPROM_OFFSET,fuelEnd,tripsEnd,GPS_EEPROM_OFFSET);
+    check(TRIP_FUEL_EEPROM_OFFSET>=tripsEnd && fuelEnd<=GPS_EEPROM_OFFSET,what);
+    check(FUEL_EEPROM_OFFSET+FUEL_CALIBRATION_SIZE<=EEPROM_SIZE,"fuel calibration fits in EEPROM");
+    check(JOURNAL_KEY_TRIP+SAVED_TRIPS+1<=JOURNAL_KEY_TRIP_FUEL && JOURNAL_KEY_TRIP_FUEL+SAVED_TRIPS<=JOURNAL_KEY_FUEL,
+          "journal keys don't overlap");
+
+    //What the fuel spot can hold on a unit that never wrote it
+    const char *fills[]={"erased (0xFF)","zeroed","stale bytes"};
+    for(int fill=0;fill<3;fill++)
+    {
+        uint8_t eeprom[EEPROM_SIZE];
+        memset(eeprom,fill==0 ? 0xFF : 0,sizeof(eeprom));
+        if(fill==2)
+            for(int i=0;i<EEPROM_SIZE;i++)
+                eeprom[i]=(uint8_t)(i*37+11);
+        for(int idx=0;idx<SAVED_TRIPS;idx++)
+        {
+            TripDataStruct trip=MakeTrip(idx);
+            memcpy(eeprom+PROPBAG_SIZE+48*idx,&trip,48);     //the old sizeof(data)*tripIdx+offset
+        }
+
+        bool lengthsOk;
+        snprintf(what,sizeof(what),"EEPROM only, fuel spot %s: trips load, fuel zero",fills[fill]);
+        Journal none;                                 //no partition: never begun
+        check(LoadTrips(none,eeprom,&lengthsOk),what);
+
+        RamFlash flash;
+        Journal journal;
+        journal.begin(&flash);
+        snprintf(what,sizeof(what),"migrated into the journal, fuel spot %s",fills[fill]);
+        check(LoadTrips(journal,eeprom,&lengthsOk),what);
+
+        Journal rebooted;
+        rebooted.begin(&flash);
+        uint8_t blank[EEPROM_SIZE];
+        memset(blank,0xFF,sizeof(blank));         //must come from the journal now
+        snprintf(what,sizeof(what),"after a reboot, from the journal, fuel spot %s",fills[fill]);
+        check(LoadTrips(rebooted,blank,&lengthsOk) && lengthsOk,what);
+    }
+
+    //A journal the first journal build wrote: trips only, 48 bytes each
+    {
+        RamFlash flash;
+        Journal journal;
+        journal.begin(&flash);
+        for(int idx=0;idx<SAVED_TRIPS;idx++)
+        {
+            TripDataStruct trip=MakeTrip(idx);
+            journal.save(JOURNAL_KEY_TRIP+idx,&trip,48);
+        }
+        uint8_t eeprom[EEPROM_SIZE];
+        memset(eeprom,0xFF,sizeof(eeprom));
+        bool lengthsOk;
+        bool ok=LoadTrips(journal,eeprom,&lengthsOk);
+        check(ok && lengthsOk,"journal from the first journal build loads without a length mismatch");
+    }
+
+    //Saved and loaded by this build
+    {
+        RamFlash flash;
+        Journal journal;
+        journal.begin(&flash);
+        TripFuelStruct fuel={{0.4f,12.5f,3.25f},{1.5f,410.0f,38.0f}};
+        journal.save(JOURNAL_KEY_TRIP_FUEL+1,&fuel,sizeof(fuel));
+        TripFuelStruct back;
+        memset(&back,0,sizeof(back));
+        int loaded=journal.load(JOURNAL_KEY_TRIP_FUEL+1,&back,sizeof(back));
+        bool kept=checkTripFuel(&back);
+        check(loaded==(int)sizeof(fuel) && kept && memcmp(&back,&fuel,sizeof(fuel))==0,"fuel saved by this build is kept");
+    }
+
+    return checkResult();
+}
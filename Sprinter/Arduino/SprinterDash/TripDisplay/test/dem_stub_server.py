@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# Stand-in for the Open Topo Data API, for test/ElevationCacheBench.
+#
+# Answers GET /v1/<dataset>?locations=lat,lon|lat,lon|... like the real
+# service (up to 100 locations, same JSON shape, null over the sea) from a
+# smooth synthetic mountain range, with an optional delay to look like a
+# phone hotspot.
+#
+#   python3 test/dem_stub_server.py [--port 8765] [--delay-ms 300]
+#
+
+import argparse
+import json
+import math
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+MAX_LOCATIONS = 100
+
+
+def terrain_meters(lat, lon):
+    """Rolling mountains: ridges a few km apart, 2000-3300 m."""
+    if lon > -100.0:
+        return None  # "sea", to exercise null handling
+    return (2600.0
+            + 400.0 * math.sin(lat * 60.0)
+            + 300.0 * math.cos(lon * 45.0)
+            + 150.0 * math.sin((lat + lon) * 170.0))
+
+
+class Handler(BaseHTTPRequestHandler):
+    delay = 0.0
+    requests = 0
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        parts = url.path.strip('/').split('/')
+        locations = parse_qs(url.query).get('locations', [''])[0]
+        points = [p for p in locations.split('|') if p]
+        if len(parts) != 2 or parts[0] != 'v1' or not points:
+            return self.reply(400, {'error': 'Invalid request', 'status': 'INVALID_REQUEST'})
+        if len(points) > MAX_LOCATIONS:
+            return self.reply(400, {'error': 'Too many locations provided (%d), the limit is %d.'
+                                    % (len(points), MAX_LOCATIONS), 'status': 'INVALID_REQUEST'})
+
+        results = []
+        for point in points:
+            lat, lon = (float(v) for v in point.split(','))
+            elevation = terrain_meters(lat, lon)
+            results.append({'dataset': parts[1],
+                            'elevation': None if elevation is None else round(elevation, 1),
+                            'location': {'lat': lat, 'lng': lon}})
+
+        Handler.requests += 1
+        time.sleep(self.delay)
+        self.reply(200, {'results': results, 'status': 'OK'})
+
+    def reply(self, code, body):
+        data = json.dumps(body).encode()
+        self.send_response(code)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(data)))
+        self.send_header('Connection', 'close')
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--port', type=int, default=8765)
+    parser.add_argument('--delay-ms', type=int, default=0)
+    args = parser.parse_args()
+
+    Handler.delay = args.delay_ms / 1000.0
+    server = ThreadingHTTPServer(('127.0.0.1', args.port), Handler)
+    print('DEM stub on http://127.0.0.1:%d (delay %d ms)' % (args.port, args.delay_ms), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
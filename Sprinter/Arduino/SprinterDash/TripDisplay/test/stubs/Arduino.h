@@ -0,0 +1,3 @@
+// Empty stand-in so host builds can compile sketch sources that only
+// include Arduino.h for the basics (see FusionReplay.cpp)
+#pragma once
@@ -0,0 +1,89 @@
+/*
+ * RMT-based RF transmitter implementation
+ */
+
+#include "RFTransmitter.h"
+#include "esp32-hal-rmt.h"
+
+static_assert(sizeof(RfSymbol) == sizeof(rmt_data_t), "RfSymbol must match rmt_data_t");
+
+RFTransmitter::RFTransmitter(int pin) {
+  _pin = pin;
+  _queue = nullptr;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+bool RFTransmitter::begin() {
+  // 1 MHz tick = 1 us per duration unit, same as the raw capture values
+  if (!rmtInit(_pin, RMT_TX_MODE, RMT_MEM_NUM_BLOCKS_1, 1000000)) {
+    Serial.println("Error: RMT init failed");
+    return false;
+  }
+  rmtSetEOT(_pin, LOW);
+
+  _queue = xQueueCreate(QUEUE_DEPTH, sizeof(Job));
+  if (_queue == nullptr) {
+    Serial.println("Error: RF queue allocation failed");
+    return false;
+  }
+  if (xTaskCreate(taskEntry, "rf_tx", 4096, this, 2, nullptr) != pdPASS) {
+    Serial.println("Error: RF task creation failed");
+    return false;
+  }
+  return true;
+}
+
+bool RFTransmitter::send(uint16_t channel_mask, uint8_t command, const char* label) {
+  Job job;
+  job.channel_mask = channel_mask;
+  job.command = command;
+  strlcpy(job.label, label, sizeof(job.label));
+
+  if (_queue == nullptr || xQueueSend(_queue, &job, 0) != pdTRUE) {
+    _stats.dropped++;
+    return false;
+  }
+  _stats.queued++;
+  return true;
+}
+
+void RFTransmitter::taskEntry(void* arg) {
+  static_cast<RFTransmitter*>(arg)->run();
+}
+
+void RFTransmitter::run() {
+  Job job;
+  for (;;) {
+    if (xQueueReceive(_queue, &job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    transmit(job);
+    // Let the receivers settle before the next (possibly different) channel
+    if (uxQueueMessagesWaiting(_queue) > 0) {
+      vTaskDelay(pdMS_TO_TICKS(COMMAND_GAP_MS));
+    }
+  }
+}
+
+void RFTransmitter::transmit(const Job& job) {
+  size_t count = rfEncodeAokFrame(job.channel_mask, job.command, _symbols, AOK_FRAME_SYMBOLS);
+  if (count == 0) {
+    Serial.println("Error: RF encode failed for " + String(job.label));
+    _stats.failed++;
+    return;
+  }
+
+  uint32_t start = millis();
+  for (int i = 0; i < FRAME_REPEATS; i++) {
+    // Blocks this task only; the RMT plays the frame and its trailing gap
+    if (!rmtWrite(_pin, reinterpret_cast<rmt_data_t*>(_symbols), count, RMT_WAIT_FOR_EVER)) {
+      Serial.println("Error: RMT write failed for " + String(job.label));
+      _stats.failed++;
+      return;
+    }
+  }
+  _stats.last_tx_ms = millis() - start;
+  _stats.sent++;
+  Serial.printf("Sent %s (mask 0x%04X) x%d, %lu ms\n", job.label, job.channel_mask,
+                FRAME_REPEATS, (unsigned long)_stats.last_tx_ms);
+}
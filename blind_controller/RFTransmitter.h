@@ -0,0 +1,58 @@
+/*
+ * RMT-based RF transmitter for A-OK blinds
+ *
+ * Commands are queued as (channel mask, command) and a dedicated FreeRTOS
+ * task encodes the A-OK frame and plays it through the ESP32 RMT
+ * peripheral, so pulse timing is exact regardless of WiFi/MQTT interrupts
+ * and the caller (the MQTT callback) returns immediately.
+ *
+ * Requires the arduino-esp32 3.x core (rmtInit/rmtWrite by pin).
+ */
+
+#ifndef RF_TRANSMITTER_H
+#define RF_TRANSMITTER_H
+
+#include <Arduino.h>
+#include "rf_encoder.h"
+
+class RFTransmitter {
+public:
+  static const int QUEUE_DEPTH = 8;
+  static const int FRAME_REPEATS = 18;         // ~1.5 s; the captured replay sent 9 x 2 clean frames
+  static const uint32_t COMMAND_GAP_MS = 500;  // Idle between queued commands
+
+  struct Stats {
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t dropped;        // Queue full
+    uint32_t failed;         // Encode or RMT write error
+    uint32_t last_tx_ms;     // Duration of the last command, all repeats
+  };
+
+  RFTransmitter(int pin);
+  bool begin();
+
+  // Queue an A-OK command (AOK_CMD_UP/DOWN) for every blind in
+  // channel_mask (bit N-1 = blind N). Returns false if the queue is full.
+  bool send(uint16_t channel_mask, uint8_t command, const char* label);
+
+  Stats getStats() const { return _stats; }
+
+private:
+  struct Job {
+    uint16_t channel_mask;
+    uint8_t command;
+    char label[32];
+  };
+
+  int _pin;
+  QueueHandle_t _queue;
+  Stats _stats;
+  RfSymbol _symbols[AOK_FRAME_SYMBOLS];  // Only touched by the TX task
+
+  static void taskEntry(void* arg);
+  void run();
+  void transmit(const Job& job);
+};
+
+#endif
@@ -3,7 +3,8 @@
  * 
  * Controls A-OK blinds via RF transmission based on MQTT messages
  * Uses PubSubClient library for MQTT communication
- * Uses A-OK library for RF transmission
+ * RF frames are played by the ESP32 RMT peripheral from a transmit queue
+ * (RFTransmitter), so the MQTT callback never blocks on the radio
  * 
  * A-OK RF Protocol Reference:
  * https://github.com/akirjavainen/A-OK/blob/master/A-OK.ino
@@ -16,47 +17,38 @@
  * Individual blind control:
  * Payload: {"blind": 1, "action": "up"} or {"blind": 1, "action": "down"}
  * 
- * Group blind control:
- * End blinds (1, 2, 6): {"group": "endblinds", "action": "up"} or {"group": "endblinds", "action": "down"}
- * Side blinds (3-5): {"group": "sideblinds", "action": "up"} or {"group": "sideblinds", "action": "down"}
+ * Group blind control (one RF frame addresses every blind in the group):
+ * Named group: {"group": "endblinds", "action": "up"}   (see blind_groups.h, plus user groups)
+ * Ad hoc list: {"blinds": [1, 3, 5], "action": "down"}
+ *
+ * User-defined groups:
+ * Topic: "blinds/groups"
+ * Define/replace: {"group": "bedroom", "blinds": [1, 2]}
+ * Delete:         {"group": "bedroom", "blinds": []}
  */
 
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
-#include "AOK.h"
+#include <Preferences.h>
+#include "RFTransmitter.h"
+#include "blind_groups.h"
 #include "credentials.h"  // Contains WiFi and MQTT credentials
-#include "blind_data.h"   // Contains all RF timing data for blinds 1-6
 const char* mqtt_topic = "blinds/control";
+const char* mqtt_groups_topic = "blinds/groups";
 
 // RF transmission pin 
 const int RF_TX_PIN = 14; 
 
-// A-OK remote configuration
-// You'll need to capture (or generate using .py scripts) these codes from your actual remote
-// Each blind should have unique codes for up and down
-struct BlindCodes {
-  unsigned long up_code;
-  unsigned long down_code;
-};
-
-// Raw RF timing data arrays are now included from blind_data.h
-
-// Configure your blind codes here (capture from original remote)
-BlindCodes blinds[] = {
-  {0x123456, 0x654321},  // Blind 1: up_code, down_code
-  {0x789ABC, 0xCBA987},  // Blind 2: up_code, down_code
-  {0xDEF012, 0x210FED},  // Blind 3: up_code, down_code
-  {0x345678, 0x876543},  // Blind 4: up_code, down_code
-  {0x9ABCDE, 0xEDCBA9},  // Blind 5: up_code, down_code
-  {0x000000, 0x000000}   // Blind 6: derived (uses raw data, see blind_data.h)
-};
-
-const int MAX_BLINDS = sizeof(blinds) / sizeof(blinds[0]);
+// Blinds are A-OK channels 1-16; frames are built on the fly from the
+// channel number (see rf_encoder.h), so any channel can be used without a
+// capture from the remote.
+const int MAX_BLINDS = AOK_MAX_CHANNELS;
 
 WiFiClient espClient;
 PubSubClient client(espClient);
-AOK aok(RF_TX_PIN);
+RFTransmitter rf(RF_TX_PIN);
+Preferences userGroups;  // NVS: group name -> channel mask
 
 void setup() {
   Serial.begin(115200);
@@ -64,8 +56,12 @@ void setup() {
   
   Serial.println("Starting RF Blind Controller");
   
-  // Initialize A-OK transmitter
-  aok.begin();
+  // Initialize RMT transmitter and its TX task
+  if (!rf.begin()) {
+    Serial.println("RF transmitter unavailable");
+  }
+  
+  userGroups.begin("blindgroups", false);
   
   // Connect to WiFi
   setup_wifi();
@@ -109,7 +105,7 @@ void callback(char* topic, byte* payload, unsigned int length) {
   Serial.println(message);
   
   // Parse JSON message
-  StaticJsonDocument<200> doc;
+  StaticJsonDocument<384> doc;
   DeserializationError error = deserializeJson(doc, message);
   
   if (error) {
@@ -118,6 +114,11 @@ void callback(char* topic, byte* payload, unsigned int length) {
     return;
   }
   
+  if (strcmp(topic, mqtt_groups_topic) == 0) {
+    define_group(doc);
+    return;
+  }
+  
   // Extract action
   String action = doc["action"];
   
@@ -130,26 +131,20 @@ void callback(char* topic, byte* payload, unsigned int length) {
   // Check if it's a group command or individual blind
   if (doc.containsKey("group")) {
     String group = doc["group"];
-    if (group == "endblinds") {
-      // Control blinds 1, 2 and 6 (end blinds)
-      Serial.println("Controlling end blinds (1, 2, 6) - Action: " + action);
-      control_blind(1, action);
-      delay(500);  // Small delay between commands
-      control_blind(2, action);
-      delay(500);
-      control_blind(6, action);
-    } else if (group == "sideblinds") {
-      // Control blinds 3-5 (side blinds)
-      Serial.println("Controlling side blinds (3-5) - Action: " + action);
-      control_blind(3, action);
-      delay(500);  // Small delay between commands
-      control_blind(4, action);
-      delay(500);
-      control_blind(5, action);
-    } else {
-      Serial.println("Error: Invalid group. Use 'endblinds' or 'sideblinds'");
+    uint16_t mask = find_group(group);
+    if (mask == 0) {
+      Serial.println("Error: Unknown group '" + group + "'");
+      return;
+    }
+    control_blinds(mask, action, "Group " + group);
+  } else if (doc.containsKey("blinds")) {
+    // Ad hoc group: any set of blinds in one frame
+    uint16_t mask;
+    if (!mask_from_list(doc["blinds"], &mask) || mask == 0) {
+      Serial.println("Error: 'blinds' must be a list of blind numbers 1-" + String(MAX_BLINDS));
       return;
     }
+    control_blinds(mask, action, "Blinds 0x" + String(mask, HEX));
   } else if (doc.containsKey("blind")) {
     // Individual blind control
     int blind_number = doc["blind"];
@@ -163,82 +158,88 @@ void callback(char* topic, byte* payload, unsigned int length) {
     // Control the individual blind
     control_blind(blind_number, action);
   } else {
-    Serial.println("Error: Missing 'blind' or 'group' parameter");
+    Serial.println("Error: Missing 'blind', 'blinds' or 'group' parameter");
     return;
   }
 }
 
-void sendRawData(unsigned int rawData[], int length) {
-  // Send raw RF data using timing values in microseconds
-  for (int i = 0; i < length; i++) {
-    if (i % 2 == 0) {
-      // Even index = HIGH pulse
-      digitalWrite(RF_TX_PIN, HIGH);
-    } else {
-      // Odd index = LOW pulse
-      digitalWrite(RF_TX_PIN, LOW);
-    }
-    delayMicroseconds(rawData[i]);
+void control_blind(int blind_number, String action) {
+  // Validate blind number
+  uint16_t channelMask;
+  if (!aokChannelMask(blind_number, &channelMask)) {
+    Serial.println("Error: Invalid blind number. Must be 1-" + String(MAX_BLINDS));
+    return;
   }
-  // Ensure we end in LOW state
-  digitalWrite(RF_TX_PIN, LOW);
+  
+  control_blinds(channelMask, action, "Blind " + String(blind_number));
 }
 
-void control_blind(int blind_number, String action) {
-  Serial.print("Controlling blind ");
-  Serial.print(blind_number);
-  Serial.print(" - Action: ");
-  Serial.println(action);
+void control_blinds(uint16_t channelMask, String action, String label) {
+  String blindAction = label + " " + action;
+  Serial.println("Controlling " + blindAction + " (mask 0x" + String(channelMask, HEX) + ")");
   
-  // Validate blind number
-  if (blind_number < 1 || blind_number > 6) {
-    Serial.println("Error: Invalid blind number. Must be 1-6");
+  uint8_t command = (action == "down") ? AOK_CMD_DOWN : AOK_CMD_UP;
+  if (rf.send(channelMask, command, blindAction.c_str())) {
+    Serial.println("Queued RF transmission for " + blindAction);
+  } else {
+    Serial.println("Error: RF transmit queue full, dropped " + blindAction);
+  }
+}
+
+// Channel mask for a named group (built-in first, then user groups), or 0
+uint16_t find_group(const String& name) {
+  for (int i = 0; i < BUILTIN_GROUP_COUNT; i++) {
+    if (name == builtin_groups[i].name) {
+      return builtin_groups[i].mask;
+    }
+  }
+  if (name.length() == 0 || name.length() > USER_GROUP_NAME_MAX) {
+    return 0;
+  }
+  return userGroups.getUShort(name.c_str(), 0);
+}
+
+bool mask_from_list(JsonVariant list, uint16_t* mask) {
+  if (!list.is<JsonArray>()) {
+    return false;
+  }
+  *mask = 0;
+  for (JsonVariant v : list.as<JsonArray>()) {
+    uint16_t bit;
+    if (!v.is<int>() || !aokChannelMask(v.as<int>(), &bit)) {
+      return false;
+    }
+    *mask |= bit;
+  }
+  return true;
+}
+
+void define_group(JsonDocument& doc) {
+  String name = doc["group"] | "";
+  if (name.length() == 0 || name.length() > USER_GROUP_NAME_MAX) {
+    Serial.println("Error: Group name must be 1-" + String(USER_GROUP_NAME_MAX) + " characters");
     return;
   }
+  for (int i = 0; i < BUILTIN_GROUP_COUNT; i++) {
+    if (name == builtin_groups[i].name) {
+      Serial.println("Error: '" + name + "' is a built-in group (edit blind_groups.h)");
+      return;
+    }
+  }
   
-  // Use raw RF data for all blinds
-  unsigned int* rawData = nullptr;
-  String blindAction = "Blind " + String(blind_number) + " " + action;
-  
-  // Select the appropriate raw data array based on blind number and action
-  if (blind_number == 1 && action == "down") {
-    rawData = blind1_down;
-  } else if (blind_number == 1 && action == "up") {
-    rawData = blind1_up;
-  } else if (blind_number == 2 && action == "down") {
-    rawData = blind2_down;
-  } else if (blind_number == 2 && action == "up") {
-    rawData = blind2_up;
-  } else if (blind_number == 3 && action == "down") {
-    rawData = blind3_down;
-  } else if (blind_number == 3 && action == "up") {
-    rawData = blind3_up;
-  } else if (blind_number == 4 && action == "down") {
-    rawData = blind4_down;
-  } else if (blind_number == 4 && action == "up") {
-    rawData = blind4_up;
-  } else if (blind_number == 5 && action == "down") {
-    rawData = blind5_down;
-  } else if (blind_number == 5 && action == "up") {
-    rawData = blind5_up;
-  } else if (blind_number == 6 && action == "down") {
-    rawData = blind6_down;
-  } else if (blind_number == 6 && action == "up") {
-    rawData = blind6_up;
+  uint16_t mask;
+  if (!mask_from_list(doc["blinds"], &mask)) {
+    Serial.println("Error: 'blinds' must be a list of blind numbers 1-" + String(MAX_BLINDS));
+    return;
   }
   
-  if (rawData != nullptr) {
-    Serial.println("Using raw RF data for " + blindAction);
-    for (int i = 0; i < 9; i++) {  // Send 3 times for reliability
-      sendRawData(rawData, 511);
-      Serial.print("Sending transmission ");
-      Serial.print(i + 1);
-      Serial.println("/9");
-      delay(10);  // delay between repeats
-    }
-    Serial.println("Completed raw RF transmission for " + blindAction);
+  if (mask == 0) {
+    userGroups.remove(name.c_str());
+    Serial.println("Deleted group " + name);
+  } else if (userGroups.putUShort(name.c_str(), mask) == sizeof(uint16_t)) {
+    Serial.println("Saved group " + name + " (mask 0x" + String(mask, HEX) + ")");
   } else {
-    Serial.println("Error: No raw data available for " + blindAction);
+    Serial.println("Error: Could not save group " + name);
   }
 }
 
@@ -263,8 +264,11 @@ void reconnect() {
       Serial.println("connected");
       // Subscribe to the control topic
       client.subscribe(mqtt_topic);
+      client.subscribe(mqtt_groups_topic);
       Serial.print("Subscribed to: ");
-      Serial.println(mqtt_topic);
+      Serial.print(mqtt_topic);
+      Serial.print(", ");
+      Serial.println(mqtt_groups_topic);
     } else {
       Serial.print("failed, rc=");
       Serial.print(client.state());
@@ -284,7 +288,11 @@ void loop() {
   static unsigned long lastHeartbeat = 0;
   if (millis() - lastHeartbeat > 60000) {  // Every 60 seconds
     if (client.connected()) {
-      String status = "{\"status\":\"online\",\"ip\":\"" + WiFi.localIP().toString() + "\"}";
+      RFTransmitter::Stats rfStats = rf.getStats();
+      String status = "{\"status\":\"online\",\"ip\":\"" + WiFi.localIP().toString() +
+                      "\",\"rf_sent\":" + String(rfStats.sent) +
+                      ",\"rf_dropped\":" + String(rfStats.dropped) +
+                      ",\"rf_failed\":" + String(rfStats.failed) + "}";
       client.publish("blinds/status", status.c_str());
     }
     lastHeartbeat = millis();
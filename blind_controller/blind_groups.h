@@ -0,0 +1,36 @@
+/*
+ * Blind Group Configuration
+ *
+ * A group is a 16-bit A-OK channel mask (bit N-1 = blind N). The whole
+ * group is addressed by a single RF frame, so every blind in it starts
+ * moving at the same time.
+ *
+ * More groups can be defined at runtime over MQTT (topic "blinds/groups");
+ * those are stored in flash and survive reboots. Names here take priority.
+ */
+
+#ifndef BLIND_GROUPS_H
+#define BLIND_GROUPS_H
+
+#include <stdint.h>
+
+#define BLIND_MASK(n) ((uint16_t)(1u << ((n) - 1)))
+
+struct BlindGroup {
+  const char* name;
+  uint16_t mask;
+};
+
+const BlindGroup builtin_groups[] = {
+  {"endblinds",  BLIND_MASK(1) | BLIND_MASK(2) | BLIND_MASK(6)},
+  {"sideblinds", BLIND_MASK(3) | BLIND_MASK(4) | BLIND_MASK(5)},
+  {"all",        BLIND_MASK(1) | BLIND_MASK(2) | BLIND_MASK(3) |
+                 BLIND_MASK(4) | BLIND_MASK(5) | BLIND_MASK(6)},
+};
+
+const int BUILTIN_GROUP_COUNT = sizeof(builtin_groups) / sizeof(builtin_groups[0]);
+
+// User group names are NVS keys, so at most 15 characters
+const int USER_GROUP_NAME_MAX = 15;
+
+#endif
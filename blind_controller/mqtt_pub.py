@@ -3,12 +3,16 @@ import sys
 import paho.mqtt.publish as publish
 
 # Usage: python mqtt_pub.py [group] [action]
-#   group: endblinds | sideblinds   (default: endblinds)
-#   action: up | down               (default: down)
+#   group: endblinds | sideblinds | all | <user group>,
+#          or a blind list like 1,3,5   (default: endblinds)
+#   action: up | down                   (default: down)
 group = sys.argv[1] if len(sys.argv) > 1 else "endblinds"
 action = sys.argv[2] if len(sys.argv) > 2 else "down"
 
-payload = json.dumps({"group": group, "action": action})
+if all(part.isdigit() for part in group.split(",")):
+    payload = json.dumps({"blinds": [int(n) for n in group.split(",")], "action": action})
+else:
+    payload = json.dumps({"group": group, "action": action})
 publish.single(
     "blinds/control",
     payload,
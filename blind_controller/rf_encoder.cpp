@@ -0,0 +1,101 @@
+/*
+ * RF pulse-train encoder implementation
+ */
+
+#include "rf_encoder.h"
+
+RfSymbolWriter::RfSymbolWriter(RfSymbol* buf, size_t capacity) {
+  _buf = buf;
+  _capacity = capacity;
+  _halves = 0;
+  _pending_level = false;
+  _pending_us = 0;
+  _overflow = false;
+}
+
+void RfSymbolWriter::emitHalf(bool level, uint32_t us) {
+  size_t index = _halves / 2;
+  if (index >= _capacity) {
+    _overflow = true;
+    return;
+  }
+  if (_halves % 2 == 0) {
+    _buf[index].duration0 = us;
+    _buf[index].level0 = level;
+  } else {
+    _buf[index].duration1 = us;
+    _buf[index].level1 = level;
+  }
+  _halves++;
+}
+
+void RfSymbolWriter::flush() {
+  uint32_t remaining = _pending_us;
+  while (remaining > 0) {
+    uint32_t chunk = remaining > RF_MAX_HALF_US ? RF_MAX_HALF_US : remaining;
+    emitHalf(_pending_level, chunk);
+    remaining -= chunk;
+  }
+  _pending_us = 0;
+}
+
+void RfSymbolWriter::pulse(bool level, uint32_t us) {
+  if (us == 0) {
+    return;  // A zero duration would end the transmission early
+  }
+  if (_pending_us > 0 && level != _pending_level) {
+    flush();
+  }
+  _pending_level = level;
+  _pending_us += us;
+}
+
+size_t RfSymbolWriter::finish() {
+  flush();
+  // End marker: a zero-duration LOW half, padding the last symbol or
+  // taking a symbol of its own.
+  emitHalf(false, 0);
+  if (_halves % 2 != 0) {
+    emitHalf(false, 0);
+  }
+  return _overflow ? 0 : _halves / 2;
+}
+
+void aokBuildFrame(uint16_t channel_mask, uint8_t command, uint8_t out[AOK_FRAME_BYTES]) {
+  out[0] = 0x03;
+  out[1] = 0xC0;
+  out[2] = 0xC1;
+  out[3] = (channel_mask >> 8) & 0xFF;
+  out[4] = channel_mask & 0xFF;
+  out[5] = 0x01;
+  out[6] = 0x00;
+  out[7] = command;
+  uint8_t sum = 0;
+  for (int i = 0; i < AOK_FRAME_BYTES - 1; i++) {
+    sum += out[i];
+  }
+  out[8] = sum;
+}
+
+size_t rfEncodeAokFrame(uint16_t channel_mask, uint8_t command,
+                        RfSymbol* out, size_t out_capacity) {
+  if (channel_mask == 0) {
+    return 0;
+  }
+  uint8_t frame[AOK_FRAME_BYTES];
+  aokBuildFrame(channel_mask, command, frame);
+
+  RfSymbolWriter writer(out, out_capacity);
+  writer.pulse(true, AOK_SYNC_HIGH_US);
+  writer.pulse(false, AOK_SYNC_LOW_US);
+  for (int i = 0; i < AOK_FRAME_BYTES; i++) {
+    for (int bit = 7; bit >= 0; bit--) {
+      bool one = (frame[i] >> bit) & 1;
+      writer.pulse(true, one ? AOK_LONG_US : AOK_SHORT_US);
+      writer.pulse(false, one ? AOK_SHORT_US : AOK_LONG_US);
+    }
+  }
+  writer.pulse(true, AOK_TRAILER_HIGH_US);
+  writer.pulse(false, AOK_FRAME_GAP_US);
+  return writer.finish();
+}
@@ -0,0 +1,87 @@
+/*
+ * RF pulse-train encoder for the ESP32 RMT peripheral
+ *
+ * Builds A-OK frames on the fly from (channel mask, command) and turns
+ * them into RMT symbols. Each symbol holds two (level, duration) halves;
+ * durations longer than the 15-bit RMT field are split across halves of
+ * the same level, and the buffer ends with a zero-duration half (the RMT
+ * end marker).
+ */
+
+#ifndef RF_ENCODER_H
+#define RF_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Same bit layout as the ESP32 core's rmt_data_t, so an encoded buffer can
+// be handed to rmtWrite() as-is (RFTransmitter.cpp asserts the size).
+struct RfSymbol {
+  uint32_t duration0 : 15;
+  uint32_t level0 : 1;
+  uint32_t duration1 : 15;
+  uint32_t level1 : 1;
+};
+
+const uint32_t RF_MAX_HALF_US = 0x7FFF;  // Longest duration one half can hold (1us ticks)
+
+// Appends pulses to a symbol buffer, merging consecutive pulses of the same
+// level and splitting anything longer than RF_MAX_HALF_US.
+class RfSymbolWriter {
+private:
+  RfSymbol* _buf;
+  size_t _capacity;
+  size_t _halves;
+  bool _pending_level;
+  uint32_t _pending_us;
+  bool _overflow;
+
+  void emitHalf(bool level, uint32_t us);
+  void flush();
+
+public:
+  RfSymbolWriter(RfSymbol* buf, size_t capacity);
+  void pulse(bool level, uint32_t us);
+  // Terminates the buffer; returns the symbol count, or 0 if it didn't fit.
+  size_t finish();
+};
+
+// A-OK frame: 9 bytes, sent MSB first after a sync pulse
+//   [03][C0][C1][mask hi][mask lo][01][00][command][checksum]
+// The 16-bit channel mask has bit N-1 set for blind N; setting several bits
+// addresses several blinds in one frame. checksum = sum(bytes 0..7) & 0xFF.
+const int AOK_FRAME_BYTES = 9;
+const int AOK_MAX_CHANNELS = 16;
+const uint8_t AOK_CMD_UP = 0x01;
+const uint8_t AOK_CMD_DOWN = 0x02;
+
+// Timings (us), taken from the blind2 captures of the original remote.
+// A bit is a HIGH/LOW pair: 1 = long HIGH + short LOW, 0 = short + long.
+const uint32_t AOK_SYNC_HIGH_US = 5030;
+const uint32_t AOK_SYNC_LOW_US = 610;
+const uint32_t AOK_SHORT_US = 310;
+const uint32_t AOK_LONG_US = 600;
+const uint32_t AOK_TRAILER_HIGH_US = 620;
+const uint32_t AOK_FRAME_GAP_US = 8880;   // LOW after each frame, before the next sync
+
+// Sync + 72 bits + trailer/gap, plus the end marker
+const size_t AOK_FRAME_SYMBOLS = 1 + AOK_FRAME_BYTES * 8 + 1 + 1;
+
+inline bool aokChannelMask(int blind_number, uint16_t* mask) {
+  if (blind_number < 1 || blind_number > AOK_MAX_CHANNELS) {
+    return false;
+  }
+  *mask = (uint16_t)(1u << (blind_number - 1));
+  return true;
+}
+
+// Fill out[AOK_FRAME_BYTES] with the frame for channel_mask/command.
+void aokBuildFrame(uint16_t channel_mask, uint8_t command, uint8_t out[AOK_FRAME_BYTES]);
+
+// Encode one frame (ending with its inter-frame gap) into RMT symbols.
+// Returns the symbol count, or 0 if channel_mask is empty or out_capacity
+// is too small.
+size_t rfEncodeAokFrame(uint16_t channel_mask, uint8_t command,
+                        RfSymbol* out, size_t out_capacity);
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef BLIND_DATA_H
 #define BLIND_DATA_H
 
+// Raw captures of the original A-OK remote (even index = HIGH, us), kept as
+// reference data for test_rf_encoder. Not built into the sketch; the
+// controller generates frames with rf_encoder.cpp.
+
 // Blind 1 Down
 unsigned int blind1_down[511] = {
   440,  196,  708,  3508,  2424,  6988,  668,  1016,
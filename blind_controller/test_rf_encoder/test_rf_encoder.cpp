@@ -0,0 +1,239 @@
+/*
+ * test_rf_encoder — host test for rf_encoder.cpp
+ *
+ * Checks the on-device A-OK frame encoder against the remote captures in
+ * blind_data.h (blinds 1-5 captured, 6 derived; no longer built into the
+ * sketch). For every capture, the encoded frame for that channel and
+ * command must decode to the same 72 bits as the captured frames, with
+ * every pulse in the same short/long/sync class. Also covers all 16
+ * channels, multi-channel masks, and the RMT symbol limits.
+ *
+ * From blind_controller/:
+ *   g++ -std=c++11 -Wall -I. -o /tmp/test_rf_encoder
+ *       test_rf_encoder/test_rf_encoder.cpp rf_encoder.cpp
+ *   /tmp/test_rf_encoder
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "rf_encoder.h"
+#include "blind_data.h"
+
+static int g_failures = 0;
+
+#define CHECK(cond, ...)                  \
+  do {                                    \
+    if (!(cond)) {                        \
+      printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                \
+      printf("\n");                       \
+      g_failures++;                       \
+    }                                     \
+  } while (0)
+
+struct Pulse {
+  bool level;
+  uint32_t us;
+};
+
+// Play symbols the way the RMT does: halves in order, stop at a zero
+// duration. Adjacent halves of the same level merge into one pulse.
+static std::vector<Pulse> play(const RfSymbol* symbols, size_t count, bool* saw_end) {
+  std::vector<Pulse> out;
+  *saw_end = false;
+  for (size_t i = 0; i < count && !*saw_end; i++) {
+    const uint32_t durations[2] = { symbols[i].duration0, symbols[i].duration1 };
+    const bool levels[2] = { symbols[i].level0 != 0, symbols[i].level1 != 0 };
+    for (int h = 0; h < 2; h++) {
+      if (durations[h] == 0) {
+        *saw_end = true;
+        break;
+      }
+      if (!out.empty() && out.back().level == levels[h]) {
+        out.back().us += durations[h];
+      } else {
+        out.push_back({ levels[h], durations[h] });
+      }
+    }
+  }
+  return out;
+}
+
+// A frame is a ~5 ms HIGH sync followed by short/long pulses (which skips
+// the noise ahead of the first frame in a capture), then 72 bit pairs
+// where a bit is 1 when HIGH > LOW.
+static bool is_frame_start(const std::vector<Pulse>& pulses, size_t i) {
+  if (!pulses[i].level || pulses[i].us < 4500 || pulses[i].us > 5500) {
+    return false;
+  }
+  for (size_t k = i + 2; k < i + 2 + 40; k++) {
+    if (pulses[k].us <= 100 || pulses[k].us >= 1000) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decode the frame whose sync pulse is at index i; returns the index of
+// its first bit.
+static size_t decode_at(const std::vector<Pulse>& pulses, size_t i, uint8_t bytes[9]) {
+  size_t st = i + 2;
+  for (int b = 0; b < 9; b++) {
+    bytes[b] = 0;
+  }
+  for (int k = 0; k < 72; k++) {
+    const Pulse& hi = pulses[st + 2 * k];
+    const Pulse& lo = pulses[st + 2 * k + 1];
+    CHECK(hi.level && !lo.level, "frame at pulse %zu: bit %d not HIGH/LOW", st, k);
+    if (hi.us > lo.us) {
+      bytes[k / 8] |= 0x80 >> (k % 8);
+    }
+  }
+  return st;
+}
+
+static std::vector<size_t> find_frames(const std::vector<Pulse>& pulses) {
+  std::vector<size_t> starts;
+  for (size_t i = 0; i + 2 + 144 < pulses.size(); i++) {
+    if (is_frame_start(pulses, i)) {
+      starts.push_back(i);
+    }
+  }
+  return starts;
+}
+
+static std::vector<Pulse> from_capture(const unsigned int* raw, size_t length) {
+  std::vector<Pulse> out;
+  for (size_t i = 0; i < length; i++) {
+    out.push_back({ i % 2 == 0, raw[i] });
+  }
+  return out;
+}
+
+static std::vector<Pulse> encode(uint16_t mask, uint8_t command, size_t* count) {
+  RfSymbol symbols[AOK_FRAME_SYMBOLS];
+  *count = rfEncodeAokFrame(mask, command, symbols, AOK_FRAME_SYMBOLS);
+  bool saw_end = false;
+  std::vector<Pulse> pulses = play(symbols, *count, &saw_end);
+  CHECK(*count == 0 || saw_end, "mask %04X: no end marker", mask);
+  for (size_t i = 0; i < *count; i++) {
+    CHECK(symbols[i].duration0 <= RF_MAX_HALF_US && symbols[i].duration1 <= RF_MAX_HALF_US,
+          "mask %04X: symbol %zu exceeds 15 bits", mask, i);
+  }
+  return pulses;
+}
+
+static int pulse_class(uint32_t us) {
+  if (us >= 4500) {
+    return 2;  // sync / gap
+  }
+  return us >= 460 ? 1 : 0;  // long : short (captured shorts top out at 444, longs start at 476)
+}
+
+static void test_capture(int blind, const char* direction, const unsigned int* raw, uint8_t command) {
+  printf("blind%d_%s\n", blind, direction);
+  std::vector<Pulse> captured = from_capture(raw, 511);
+  std::vector<size_t> frames = find_frames(captured);
+  CHECK(!frames.empty(), "no frames in capture");
+
+  size_t count = 0;
+  std::vector<Pulse> encoded = encode(1u << (blind - 1), command, &count);
+  CHECK(count == AOK_FRAME_SYMBOLS, "symbol count %zu", count);
+  CHECK(encoded.size() == 148, "encoded %zu pulses", encoded.size());
+  if (encoded.size() != 148) {
+    return;
+  }
+  CHECK(is_frame_start(encoded, 0), "encoded frame has no sync");
+
+  uint8_t want[9];
+  decode_at(encoded, 0, want);
+  for (size_t f = 0; f < frames.size(); f++) {
+    uint8_t got[9];
+    size_t st = decode_at(captured, frames[f], got);
+    for (int b = 0; b < 9; b++) {
+      CHECK(got[b] == want[b], "frame %zu byte %d: capture %02X, encoder %02X", f, b, got[b], want[b]);
+    }
+    // Sync, 72 bit pairs and trailer, pulse for pulse
+    for (size_t k = 0; k < 147; k++) {
+      const Pulse& c = captured[st - 2 + k];
+      const Pulse& e = encoded[k];
+      CHECK(c.level == e.level && pulse_class(c.us) == pulse_class(e.us),
+            "frame %zu pulse %zu: capture %d/%u, encoder %d/%u", f, k, c.level, c.us, e.level, e.us);
+    }
+  }
+  printf("  %zu frames match\n", frames.size());
+}
+
+static void test_all_channels() {
+  printf("channels 1-16\n");
+  for (int n = 1; n <= AOK_MAX_CHANNELS; n++) {
+    uint16_t mask = 0;
+    CHECK(aokChannelMask(n, &mask) && mask == (1u << (n - 1)), "channel %d mask %04X", n, mask);
+    for (uint8_t command = AOK_CMD_UP; command <= AOK_CMD_DOWN; command++) {
+      const uint8_t expected[9] = { 0x03, 0xC0, 0xC1, (uint8_t)(mask >> 8), (uint8_t)mask, 0x01, 0x00,
+                                    command, (uint8_t)(0x03 + 0xC0 + 0xC1 + (mask >> 8) + (mask & 0xFF) + 0x01 + command) };
+      size_t count = 0;
+      std::vector<Pulse> pulses = encode(mask, command, &count);
+      uint8_t got[9];
+      decode_at(pulses, 0, got);
+      CHECK(memcmp(got, expected, 9) == 0, "channel %d command %u decodes wrong", n, command);
+    }
+  }
+  uint16_t mask = 0;
+  CHECK(!aokChannelMask(0, &mask) && !aokChannelMask(17, &mask), "out-of-range channel accepted");
+}
+
+static void test_group_mask() {
+  printf("group masks\n");
+  // Blinds 1, 2 and 6 in one frame
+  size_t count = 0;
+  std::vector<Pulse> pulses = encode(0x0023, AOK_CMD_DOWN, &count);
+  uint8_t got[9];
+  decode_at(pulses, 0, got);
+  const uint8_t expected[9] = { 0x03, 0xC0, 0xC1, 0x00, 0x23, 0x01, 0x00, 0x02, 0xAA };
+  CHECK(memcmp(got, expected, 9) == 0, "0x0023 decodes wrong");
+
+  pulses = encode(0xFFFF, AOK_CMD_UP, &count);
+  decode_at(pulses, 0, got);
+  CHECK(got[3] == 0xFF && got[4] == 0xFF && got[8] == 0x84, "0xFFFF decodes wrong");
+
+  RfSymbol symbols[AOK_FRAME_SYMBOLS];
+  CHECK(rfEncodeAokFrame(0, AOK_CMD_UP, symbols, AOK_FRAME_SYMBOLS) == 0, "empty mask accepted");
+  CHECK(rfEncodeAokFrame(1, AOK_CMD_UP, symbols, AOK_FRAME_SYMBOLS - 1) == 0, "overflow not reported");
+}
+
+static void test_long_durations() {
+  printf("long durations\n");
+  RfSymbol symbols[8];
+  RfSymbolWriter writer(symbols, 8);
+  writer.pulse(true, 70000);
+  writer.pulse(false, 300);
+  writer.pulse(true, 40000);
+  writer.pulse(false, 5);
+  size_t count = writer.finish();
+  CHECK(count > 0, "overflow");
+  for (size_t i = 0; i < count; i++) {
+    CHECK(symbols[i].duration0 <= RF_MAX_HALF_US && symbols[i].duration1 <= RF_MAX_HALF_US,
+          "symbol %zu exceeds 15 bits", i);
+  }
+  bool saw_end = false;
+  std::vector<Pulse> pulses = play(symbols, count, &saw_end);
+  CHECK(pulses.size() == 4 && pulses[0].us == 70000 && pulses[1].us == 300 &&
+        pulses[2].us == 40000 && pulses[3].us == 5, "split pulses do not add up");
+}
+
+int main() {
+  const unsigned int* downs[6] = { blind1_down, blind2_down, blind3_down, blind4_down, blind5_down, blind6_down };
+  const unsigned int* ups[6] = { blind1_up, blind2_up, blind3_up, blind4_up, blind5_up, blind6_up };
+  for (int n = 1; n <= 6; n++) {
+    test_capture(n, "down", downs[n - 1], AOK_CMD_DOWN);
+    test_capture(n, "up", ups[n - 1], AOK_CMD_UP);
+  }
+  test_all_channels();
+  test_group_mask();
+  test_long_durations();
+
+  printf(g_failures ? "%d failure(s)\n" : "all passed\n", g_failures);
+  return g_failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+//
+// Link adaptation - transmit power and retry tail from ack history
+//
+// Every node used to send at RF24_PA_MAX with the longest hardware retry
+// tail (15 x 4ms), and wait RETRYDELAY awake between software retries.
+// Nodes close to the hub don't need any of that.
+//
+// Power:
+//  - After LINK_PROBE_AFTER acks in a row, try one PA level lower
+//  - A failed write goes up a level straight away (the software retry is
+//    sent louder)
+//  - A failure soon after stepping down means that level doesn't hold, so
+//    the next probe waits twice as long (up to LINK_PROBE_MAX).  So does an
+//    ack that needed hardware retries: each one costs more than a lower
+//    level saves on the whole write
+// Retries:
+//  - While most writes are acked first time, the hardware tail is short
+//    (LINK_ARD_GOOD/LINK_ARC_GOOD): a miss is more likely a collision than
+//    a weak link, and the software retry comes sooner at a higher level
+//  - Software retries back off from LINK_RETRY_MIN, doubling up to RETRYDELAY
+//
+// Link quality goes to the hub in the context packets (see
+// buildContextPayload).  test/LinkSim.cpp weighs it against the old fixed
+// settings on a simulated channel.
+//
+// Also the defaults for state batching (STATE_BATCH), which the unit
+// config can override - this is included after it.
+//
+#ifndef linkadapt_h
+#define linkadapt_h
+
+#include <stdint.h>
+
+#define LINK_LEVELS 4            // RF24_PA_MIN, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX
+#define LINK_PROBE_AFTER 8       // acks in a row before trying a level lower
+#define LINK_PROBE_MAX 1024      // ...doubling after a failed try, up to this
+#define LINK_GOOD_RATE 90        // % acked first time for the short retry tail
+#define LINK_ARD_GOOD 5          // 1500us between hardware retries (least for ack payloads at 250kbps)
+#define LINK_ARC_GOOD 5          // hardware retries
+#define LINK_ARD_POOR 15         // 4000us
+#define LINK_ARC_POOR 15
+#define LINK_RETRY_MIN 10        // ms before the first software retry
+#define LINK_CONTEXT_MARKER 'L'  // after the description's 0 in a context packet, then...
+#define LINK_CONTEXT_VERSION 1   // ...the layout of the link quality that follows
+
+//
+// State batching: readings are kept for STATE_BATCH state cycles and sent in
+// one 'B' packet (see buildBatchPayload).  Sent early with an event, or when
+// presence changes.  1 sends each reading as a 'S' packet, as always.
+//
+#ifndef STATE_BATCH
+#define STATE_BATCH 1
+#endif
+#define STATE_BATCH_MAX 3        // readings that fit in a 30 byte payload
+
+class LinkAdapt
+{
+  public:
+    LinkAdapt()
+    {
+      level=LINK_LEVELS-1;
+      streak=0;
+      sinceStep=0xFFFF;
+      probeAfter=LINK_PROBE_AFTER;
+      ackRate=100<<4;
+      sends=0;
+      retries=0;
+    }
+
+    uint8_t getLevel() { return level; }
+    uint8_t getRetryDelay() { return isGood() ? LINK_ARD_GOOD : LINK_ARD_POOR; }
+    uint8_t getRetryCount() { return isGood() ? LINK_ARC_GOOD : LINK_ARC_POOR; }
+    uint8_t getAckRate() { return (ackRate+8)>>4; }    // % acked on the first write, recent
+    bool isGood() { return getAckRate() >= LINK_GOOD_RATE; }
+
+    //ms to wait before software retry number 'retry' (1 = first)
+    unsigned int getBackoff(int retry, unsigned int maxDelay)
+    {
+      unsigned long wait=LINK_RETRY_MIN;
+      for(int i=1;i<retry && wait<maxDelay;i++)
+        wait*=2;
+      return wait<maxDelay ? wait : maxDelay;
+    }
+
+    //Hardware retries a radio.write() of len bytes took, from how long it was
+    //busy (the RF24 library doesn't say).  A retry is the packet - 130us
+    //settling and its airtime at 250kbps - and the ARD wait; the first try
+    //with its ack fits in one of those.  Call before sent() changes the ARD
+    uint8_t hwRetries(unsigned long writeUs, uint8_t len)
+    {
+      unsigned long retryUs=130+((1+5+len+2)*8+9)*4UL+(getRetryDelay()+1)*250UL;
+      unsigned long count=writeUs/retryUs;
+      return count<255 ? count : 255;
+    }
+
+    //Result of one write (first try or software retry), and how many of
+    //its hardware retries it took to get the ack
+    void sent(bool acked, bool retry, uint8_t hwRetries)
+    {
+      if(!retry)
+      {
+        ackRate += ((acked ? 100<<4 : 0) - ackRate) >> 4;   //EWMA, 1/16
+        if(sends<255) sends++;
+      }
+      else if(retries<255) retries++;
+
+      //An ack that took hardware retries just after stepping down is the
+      //level not holding: the retries cost more than the lower power saves
+      if(acked && hwRetries > 0 && sinceStep < probeAfter)
+        acked=false;
+
+      if(acked)
+      {
+        if(sinceStep<0xFFFF) sinceStep++;
+        if(++streak >= probeAfter && level > 0)
+        {
+          level--;
+          streak=0;
+          sinceStep=0;
+        }
+        return;
+      }
+
+      //Didn't hold: up a level, and if we only just came down, wait longer next time
+      if(sinceStep < probeAfter && probeAfter < LINK_PROBE_MAX)
+        probeAfter*=2;
+      streak=0;
+      sinceStep=0xFFFF;
+      if(level < LINK_LEVELS-1)
+        level++;
+    }
+
+    //For the context packet: counts since the last one
+    uint8_t getSends() { return sends; }
+    uint8_t getRetries() { return retries; }
+    void clearCounts() { sends=0; retries=0; }
+
+  private:
+    uint8_t level;               // 0 (RF24_PA_MIN) .. 3 (RF24_PA_MAX)
+    uint16_t streak;             // acks in a row at this level
+    uint16_t sinceStep;          // acks since the last step down
+    uint16_t probeAfter;
+    int ackRate;                 // %, 4 fraction bits
+    uint8_t sends;
+    uint8_t retries;
+};
+
+#endif
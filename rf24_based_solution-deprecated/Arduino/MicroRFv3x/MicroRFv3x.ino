@@ -25,7 +25,17 @@
 // 8-Garage
 // 9-Driveway
 #include "unit9.h"
+#include "LinkAdapt.h"
 
+#if defined(WEATHER_INSTALLED) && STATE_BATCH > 1
+#error "State batching doesn't carry weather readings"
+#endif
+#if STATE_BATCH > STATE_BATCH_MAX
+#error "STATE_BATCH is more than fits in a payload"
+#endif
+#if defined(DELAYTIME) && STATE_BATCH > 1
+#error "State batching is for sleeping units (ages are in watchdog wakes)"
+#endif
 
 //
 // Flags and counters
@@ -38,11 +48,13 @@ int lastRetryCount=0; //Number of retry times on last transmit
 int lastGoodTransCount=0; //Number of times we tried to transmit since last success (does not count retry times - that's "one" transmit)
 int contextSendCount=0; //Current number for sending context
 volatile int interruptCount=0; //interrupt count
+unsigned long wakeCount=0; //Watchdog (or delay) wakes since boot - ages the batched readings
 
 //
 // Definitions
 //
 RF24 radio(9,10);  // Hardware configuration: Set up nRF24L01 radio on SPI bus plus pins 9 & 10 
+LinkAdapt linkAdapt;  // Power level and retries from ack history
 typedef enum { wdt_16ms = 0, wdt_32ms, wdt_64ms, wdt_128ms, wdt_250ms, wdt_500ms, wdt_1s, wdt_2s, wdt_4s, wdt_8s } wdt_prescalar_e; //sleep decrarations
 
 //Set things up
@@ -69,12 +81,14 @@ void setup()
     
     //Setup radio
     radio.begin();
-    radio.setPALevel(RF24_PA_MAX);          // Higher power level
+    radio.setPALevel((rf24_pa_dbm_e)linkAdapt.getLevel());  // Starts at RF24_PA_MAX, comes down as acks come back (see radioSend)
     radio.setDataRate(RF24_250KBPS);        // Slower datarate for more distance
     radio.setAutoAck(1);                    // Ensure autoACK is enabled
     radio.enableAckPayload();               // Allow optional ack payloads
     radio.enableDynamicPayloads();          // Needed for ACK payload
-    radio.setRetries(15,15);                // Smallest time between retries (max is 15 increments of 250us, or 4000us), max no. of retries (15 max)
+    radio.setRetries(linkAdapt.getRetryDelay(),linkAdapt.getRetryCount());  // Time between retries (increments of 250us), no. of retries (15 max)
+    
+    randomSeed(UNITNUM);                    // Retry jitter (see radioSend) differs from unit to unit
     
     #if defined(ERROR) || defined(VERBOSE)
     radio.printDetails();                   // Dump the configuration of the rf unit for debugging
@@ -266,13 +280,18 @@ void handleState(byte* payloadData)
     digitalWrite(LED_PIN, HIGH);
     #endif
   
+    #if STATE_BATCH > 1
+    boolean sent=batchState(payloadData,vcc,temperature,adcValue,presence); //keep it, send if it's time
+    #else
     VERBOSE_PRINTLN("Sending State");   
     payloadLen=buildStatePayload(payloadData,vcc,temperature,interruptPinState,adcValue,presence); //build state payload
     radioSend(payloadData,payloadLen); //Send state payload
+    boolean sent=true;
+    #endif
      
-    //Send context for PI to use upon reset or startup
+    //Send context for PI to use upon reset or startup (only along with state, so it never wakes the radio on its own)
     contextSendCount++;
-    if(contextSendCount > CONTEXT_SEND_FREQ)
+    if(contextSendCount > CONTEXT_SEND_FREQ && sent)
     {
       contextSendCount=0;
       VERBOSE_PRINTLN("Sending Context"); 
@@ -338,6 +357,96 @@ int buildStatePayload(byte *payloadData,float vcc,float temp,byte interruptPinSt
   return payloadLen;
 }
 
+#if STATE_BATCH > 1
+//
+// State readings waiting to be sent, oldest first
+//
+struct BatchReading
+{
+  unsigned long wake;  //wakeCount when read
+  uint16_t vcc;        //mV
+  int16_t temp;        //tenths
+  char presence;
+  int16_t adcValue;
+};
+BatchReading batch[STATE_BATCH];
+byte batchCount=0;
+
+//Keep a reading.  The batch goes when it's full, with an event (the state
+//that goes with it shouldn't wait), or when presence changes.  True if sent
+boolean batchState(byte *payloadData,float vcc,float temp,int adcValue,char presence)
+{
+  boolean urgent = interruptType!=0 || (batchCount>0 && batch[batchCount-1].presence!=presence);
+
+  BatchReading &reading=batch[batchCount++];
+  reading.wake=wakeCount;
+  reading.vcc=(uint16_t)(vcc*1000.0+0.5);
+  reading.temp=(int16_t)(temp*10.0+(temp<0 ? -0.5 : 0.5));
+  reading.presence=presence;
+  reading.adcValue=adcValue;
+
+  if(batchCount<STATE_BATCH && !urgent)
+  {
+    VERBOSE_PRINT("State kept: ");
+    VERBOSE_PRINTLN(batchCount);
+    return false;
+  }
+
+  VERBOSE_PRINT("Sending State batch: ");
+  VERBOSE_PRINTLN(batchCount);
+  int payloadLen=buildBatchPayload(payloadData);
+  radioSend(payloadData,payloadLen); //Send state payload
+  batchCount=0; //gone either way - same as a lost 'S' packet
+  return true;
+}
+
+//Send batched state
+int buildBatchPayload(byte *payloadData)
+{
+  //
+  // Over-the-air packet definition/spec
+  //
+  // 1:1 byte:  unit number (uint8)
+  // 1:2 byte:  Payload type (B=batched state)
+  // 1:3 byte:  Number of retries on last send (uint8, stops at 255)
+  // 1:4 byte:  Number of send attempts since last successful send (uint8, stops at 255)
+  // 1:5 byte:  Number of readings (n, up to STATE_BATCH_MAX)
+  // 1:6 byte:  Data Type  (a=ADC, -=none)
+  // then n readings of 8 bytes, oldest first:
+  //   1 byte:  Age in watchdog wakes (8 sec each, stops at 255)
+  //   2 bytes: VCC (mV, uint16)
+  //   2 bytes: Temperature (tenths, int16)
+  //   1 byte:  Presence  ('P' = present, and 'A' = absent)
+  //   2 bytes: ADC value (int)
+  //
+  
+  payloadData[0]=(uint8_t)UNITNUM; //unit number
+  payloadData[1]='B';
+  payloadData[2]=(uint8_t)min(lastRetryCount,255);
+  payloadData[3]=(uint8_t)min(lastGoodTransCount,255);
+  payloadData[4]=batchCount;
+  #ifdef ADC_PIN
+  payloadData[5]='a';
+  #else
+  payloadData[5]='-';
+  #endif
+  
+  int payloadLen=6;
+  for(int i=0;i<batchCount;i++)
+  {
+    unsigned long age=wakeCount-batch[i].wake;
+    payloadData[payloadLen]=(uint8_t)min(age,255UL);
+    memcpy(&payloadData[payloadLen+1],&batch[i].vcc,2);
+    memcpy(&payloadData[payloadLen+3],&batch[i].temp,2);
+    payloadData[payloadLen+5]=batch[i].presence;
+    memcpy(&payloadData[payloadLen+6],&batch[i].adcValue,2);
+    payloadLen+=8;
+  }
+
+  return payloadLen;
+}
+#endif
+
 byte getPresence()
 {
   char presence = '-';
@@ -406,6 +515,15 @@ int buildContextPayload(byte *payloadData,char tag)
   // 1:2 byte:  Payload type (S=state, C=context, E=event  
   // 1:3 byte:  B-boot, or H-heartbeat
   // var byte:  Description
+  // then, if it fits (link quality since the last context):
+  // 1 byte:    0 (end of description)
+  // 1 byte:    LINK_CONTEXT_MARKER ('L'), so the hub can tell this from a zero padded description
+  // 1 byte:    LINK_CONTEXT_VERSION (1)
+  // 1 byte:    PA level (0=min .. 3=max)
+  // 1 byte:    % acked on the first write (recent)
+  // 1 byte:    Sends (uint8, stops at 255)
+  // 1 byte:    Software retries (uint8, stops at 255)
+  // 1 byte:    Readings per state packet (STATE_BATCH)
   //
   
   //Create context package
@@ -414,9 +532,23 @@ int buildContextPayload(byte *payloadData,char tag)
   payloadData[2]=tag; 
   payloadData[3]='-';
   memcpy(&payloadData[4],UNITDESC,strlen(UNITDESC));
+  int payloadLen=strlen(UNITDESC)+4;
+
+  if(payloadLen+8 <= MAX_PAYLOADSIZE)
+  {
+    payloadData[payloadLen++]=0;
+    payloadData[payloadLen++]=LINK_CONTEXT_MARKER;
+    payloadData[payloadLen++]=LINK_CONTEXT_VERSION;
+    payloadData[payloadLen++]=linkAdapt.getLevel();
+    payloadData[payloadLen++]=linkAdapt.getAckRate();
+    payloadData[payloadLen++]=linkAdapt.getSends();
+    payloadData[payloadLen++]=linkAdapt.getRetries();
+    payloadData[payloadLen++]=STATE_BATCH;
+    linkAdapt.clearCounts();
+  }
   
   //return length
-  return strlen(UNITDESC)+4;
+  return payloadLen;
 }
 
 //Read voltage to see battery level by using internal 1.1V ref
@@ -530,7 +662,7 @@ void radioSend(byte *payload,int payloadLen)
   {
     radio.openWritingPipe(CONTEXT_PIPE);  
   }
-  if((byte)payload[1]=='S' || (byte)payload[1]=='W')  //state OR weather
+  if((byte)payload[1]=='S' || (byte)payload[1]=='W' || (byte)payload[1]=='B')  //state, weather OR batched state
   {
     radio.openWritingPipe(STATE_PIPE);  
   }
@@ -553,8 +685,15 @@ void radioSend(byte *payload,int payloadLen)
   lastGoodTransCount++; //increment by one in case we're not successful.  Note this is set to zero upon successful send
   while(retryFlag)
   {
-    //Write payload out  
-    if(radio.write((const void *)payload,radio.getPayloadSize()))
+    //Power level and hardware retries as the link has earned (a failed write goes up a level)
+    radio.setPALevel((rf24_pa_dbm_e)linkAdapt.getLevel());
+    radio.setRetries(linkAdapt.getRetryDelay(),linkAdapt.getRetryCount());
+
+    //Write payload out, timed so the link knows how many hardware retries it took
+    unsigned long writeStart=micros();
+    boolean acked=radio.write((const void *)payload,radio.getPayloadSize());
+    linkAdapt.sent(acked,lastRetryCount>0,linkAdapt.hwRetries(micros()-writeStart,radio.getPayloadSize()));
+    if(acked)
     {
       retryFlag=false; //exit loop because we succeeded
       lastGoodTransCount=0; //since we succeeded, reset this counter to zero
@@ -587,7 +726,7 @@ void radioSend(byte *payload,int payloadLen)
         lastRetryCount++;
         VERBOSE_PRINT("Send failed, retry # ");        
         VERBOSE_PRINTLN(lastRetryCount);        
-        delay(RETRYDELAY);
+        delay(linkAdapt.getBackoff(lastRetryCount,RETRYDELAY)+random(LINK_RETRY_MIN));  //back off, jittered so two units don't keep colliding
       }
     }
   }
@@ -663,6 +802,7 @@ void startInnerLoop()
 
      //We woke up, so decrement sleep cycles
      --sleep_cycles_remaining;
+     wakeCount++;
      
      VERBOSE_PRINT("Woke Up - Sleep/Delay Cycles Remaining: ");
      VERBOSE_PRINTLN(sleep_cycles_remaining);
@@ -34,6 +34,7 @@
 #define RETRYDELAY 100  //Milliseconds to wait between retries
 #define SLEEPCYCLES 5  //75  //Sleep cycles wanted  (900 is 15 min assuming a 1 sec timer)
 //#define DELAYTIME 1000  //If defined, loop will delay for these ms and NOT SLEEP - useful for powered situations when doing extra work
+#define STATE_BATCH 3  //State readings sent together (1-3) - fewer radio wakes, readings up to 2 cycles late (see LinkAdapt.h)
 
 //
 // Interrupt config
@@ -0,0 +1,319 @@
+//
+// Host simulation for LinkAdapt.h: radio energy per delivered state reading
+// for a sleeping node, the old way against link adaptation and batching.
+//
+// The node emulates radioSend(): 50ms settle after powerUp and powerDown,
+// radio.write() with the hardware retries (ARD/ARC), up to MAXRRETRIES
+// software retries.  LinkAdapt gets the hardware retries from how long the
+// write took, as in the sketch.  Policies:
+//  - fixed: RF24_PA_MAX, setRetries(15,15), RETRYDELAY 100ms, a packet a reading
+//  - link:  LinkAdapt power and retries, a packet a reading
+//  - batch: LinkAdapt, STATE_BATCH 3
+// Context packets go every CONTEXT_SEND_FREQ readings, as in the sketch.
+//
+// Loss model, per hardware attempt:
+//  - margin = TX dBm - path loss - sensitivity (-94dBm at 250kbps), with
+//    Gaussian fading (sigma dB): received if the faded margin is above 0
+//  - Gilbert-Elliott bursts: per send, good->bad with pEnter, bad->good with
+//    pExit; bad takes burstDb off the margin
+//  - collisions: another transmitter on the channel, independent of power
+//  - the ack comes back from the hub at RF24_PA_MAX through the same path
+// Energy (charge, uC) from the nRF24L01+ and ATmega328 datasheets: TX
+// 7.0/7.5/9.0/11.3mA (MIN..MAX) for 130us settling + airtime, RX 12.6mA
+// waiting for the ack, the MCU 4mA whenever it's awake for the radio.  The
+// sensor reads cost the same either way and aren't counted.
+//
+// Most of a send is the MCU awake for the two 50ms settle delays, so power
+// level alone moves little; fewer sends is where the energy is.  Every policy
+// runs from the same random seed, so they see the same channel.  Checked per
+// scenario, against fixed:
+//  - link: less energy per delivered reading where it has collisions to
+//    dodge (busy); elsewhere no more than fixed
+//  - batch: at least 40% less
+//  - delivery no more than half a point worse
+//
+// Build and run (from MicroRFv3x/):
+//   g++ -std=c++11 -O2 -Wall -o LinkSim test/LinkSim.cpp && ./LinkSim
+// Options for one scenario of your own instead:
+//   -l <path loss dB> -f <fading sigma dB> -c <collision probability>
+//   -e <burst enter> -x <burst exit> -d <burst dB> -n <readings>
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../LinkAdapt.h"
+
+#define MAXRRETRIES 10
+#define RETRYDELAY 100
+#define CONTEXT_SEND_FREQ 10
+#define SETTLE_MS 50
+#define SENSITIVITY_DBM -94.0
+#define STATE_LEN 15             // 'S' without ADC (Unit9)
+#define CONTEXT_LEN 20           // "Driveway", the link marker and version, and the link quality
+#define ACK_LEN 1
+#define SEED 0x2545F4914F6CDD1DULL
+
+static const double txDbm[LINK_LEVELS] = { -18, -12, -6, 0 };
+static const double txMa[LINK_LEVELS] = { 7.0, 7.5, 9.0, 11.3 };
+static const double RX_MA = 12.6;
+static const double MCU_MA = 4.0;
+
+static uint64_t rngState = SEED;
+
+static double uniform()
+{
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (rngState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian()
+{
+  double u1 = uniform(), u2 = uniform();
+  if(u1 < 1e-12) u1 = 1e-12;
+  return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
+
+//
+// The channel
+//
+struct Scenario
+{
+  const char *name;
+  double pathLoss;        // dB
+  double fading;          // sigma, dB
+  double collide;         // per attempt
+  double burstEnter;      // per send
+  double burstExit;
+  double burstDb;
+  bool linkSaves;         // link has to beat fixed, not just match it
+};
+
+struct Channel
+{
+  Scenario sc;
+  bool bad;
+
+  void nextSend()
+  {
+    bad = bad ? uniform() >= sc.burstExit : uniform() < sc.burstEnter;
+  }
+
+  bool arrives(double dbm)
+  {
+    double margin = dbm - sc.pathLoss - SENSITIVITY_DBM - (bad ? sc.burstDb : 0);
+    return margin + sc.fading*gaussian() > 0 && uniform() >= sc.collide;
+  }
+};
+
+//
+// The node
+//
+struct Policy
+{
+  const char *name;
+  bool adapt;
+  int batch;
+};
+
+struct Result
+{
+  long readings;
+  long delivered;
+  double uC;
+  double settleUC;
+  double levelSum;
+  long writes;
+};
+
+static double airtimeMs(int len)
+{
+  // preamble 1, address 5, control 9 bits, CRC 2 at 250kbps
+  return ((1 + 5 + len + 2)*8 + 9)/250.0;
+}
+
+//One radio.write(): true if acked, *heard if the hub got it at all, *ms how
+//long it was busy
+static bool write(Channel &ch, int level, int ard, int arc, int len, double *uC, bool *heard, double *ms)
+{
+  double ackWaitMs = (ard + 1)*0.25;
+  for(int attempt=0; attempt<=arc; attempt++)
+  {
+    double txMs = 0.13 + airtimeMs(len);
+    *uC += txMa[level]*txMs + MCU_MA*txMs;
+    *ms += txMs;
+    if(ch.arrives(txDbm[level]))
+    {
+      *heard = true;
+      double ackMs = 0.13 + airtimeMs(ACK_LEN);
+      if(ch.arrives(txDbm[LINK_LEVELS-1]))
+      {
+        *uC += (RX_MA + MCU_MA)*ackMs;
+        *ms += ackMs;
+        return true;
+      }
+    }
+    *uC += (RX_MA + MCU_MA)*ackWaitMs;
+    *ms += ackWaitMs;
+  }
+  return false;
+}
+
+//radioSend(): true if the hub got it
+static bool radioSend(Channel &ch, const Policy &p, LinkAdapt &link, int len, Result &r)
+{
+  ch.nextSend();
+  r.uC += MCU_MA*SETTLE_MS*2;
+  r.settleUC += MCU_MA*SETTLE_MS*2;
+  bool heard = false;
+  for(int retry=0; retry<=MAXRRETRIES; retry++)
+  {
+    int level = p.adapt ? link.getLevel() : LINK_LEVELS-1;
+    int ard = p.adapt ? link.getRetryDelay() : 15;
+    int arc = p.adapt ? link.getRetryCount() : 15;
+    r.levelSum += level;
+    r.writes++;
+    double ms = 0;
+    bool acked = write(ch, level, ard, arc, len, &r.uC, &heard, &ms);
+    if(p.adapt) link.sent(acked, retry > 0, link.hwRetries(ms*1000, len));
+    if(acked || retry == MAXRRETRIES) break;
+
+    double waitMs = p.adapt ? link.getBackoff(retry+1, RETRYDELAY) + floor(uniform()*LINK_RETRY_MIN) : RETRYDELAY;
+    r.uC += MCU_MA*waitMs;
+  }
+  return heard;
+}
+
+static Result run(const Scenario &sc, const Policy &p, long readings)
+{
+  rngState = SEED;
+  Channel ch = { sc, false };
+  LinkAdapt link;
+  Result r = { 0, 0, 0, 0, 0, 0 };
+  int batched = 0;
+  int contextCount = 0;
+  for(long i=0; i<readings; i++)
+  {
+    r.readings++;
+    batched++;
+    bool sent = false;
+    if(batched >= p.batch)
+    {
+      if(radioSend(ch, p, link, p.batch > 1 ? 6 + 8*batched : STATE_LEN, r))
+        r.delivered += batched;
+      batched = 0;
+      sent = true;
+    }
+    if(++contextCount > CONTEXT_SEND_FREQ && sent)
+    {
+      contextCount = 0;
+      radioSend(ch, p, link, CONTEXT_LEN, r);
+    }
+  }
+  return r;
+}
+
+//1 if it failed, so main() can add them up
+static int check(bool ok, const char *what)
+{
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+  int failures = 0;
+  Scenario scenarios[] = {
+    //                           loss  fade  collide enter  exit  dB  link saves
+    { "near (same room)",        60.0, 4.0, 0.01,   0.00,  1.0,  0,  false },
+    { "mid (through a wall)",    76.0, 4.0, 0.01,   0.00,  1.0,  0,  false },
+    { "edge (garage)",           88.0, 4.0, 0.01,   0.00,  1.0,  0,  false },
+    { "bursty (car parked)",     72.0, 4.0, 0.01,   0.02,  0.2,  20, false },
+    { "busy (wifi next door)",   65.0, 4.0, 0.20,   0.00,  1.0,  0,  true },
+  };
+  int count = sizeof(scenarios)/sizeof(scenarios[0]);
+  long readings = 20000;
+
+  Scenario custom = { "custom", 70.0, 4.0, 0.01, 0.0, 1.0, 0, false };
+  bool own = false;
+  int opt;
+  while((opt = getopt(argc, argv, "l:f:c:e:x:d:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'l': custom.pathLoss = atof(optarg); own = true; break;
+      case 'f': custom.fading = atof(optarg); own = true; break;
+      case 'c': custom.collide = atof(optarg); own = true; break;
+      case 'e': custom.burstEnter = atof(optarg); own = true; break;
+      case 'x': custom.burstExit = atof(optarg); own = true; break;
+      case 'd': custom.burstDb = atof(optarg); own = true; break;
+      case 'n': readings = atol(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-l loss] [-f fading] [-c collide] [-e enter] [-x exit] [-d burstDb] [-n readings]\n", argv[0]);
+        return 2;
+    }
+  }
+  if(own)
+  {
+    scenarios[0] = custom;
+    count = 1;
+  }
+
+  const Policy policies[] = {
+    { "fixed", false, 1 },
+    { "link",  true,  1 },
+    { "batch", true,  STATE_BATCH_MAX },
+  };
+
+  char what[128];
+  for(int s=0; s<count; s++)
+  {
+    const Scenario &sc = scenarios[s];
+    printf("%s: path loss %.0fdB, fading %.0fdB, collisions %.0f%%, bursts %.0fdB\n",
+           sc.name, sc.pathLoss, sc.fading, sc.collide*100, sc.burstEnter > 0 ? sc.burstDb : 0.0);
+
+    Result r[3];
+    for(int p=0; p<3; p++)
+    {
+      r[p] = run(sc, policies[p], readings);
+      printf("  %-6s delivered %6.2f%%  %6.1f uC/reading (%2.0f%% settling)  mean PA %.2f  writes/reading %.2f\n",
+             policies[p].name, 100.0*r[p].delivered/r[p].readings, r[p].uC/r[p].delivered,
+             100*r[p].settleUC/r[p].uC, r[p].levelSum/r[p].writes, (double)r[p].writes/r[p].readings);
+    }
+
+    double base = r[0].uC/r[0].delivered;
+    double baseDelivery = 100.0*r[0].delivered/r[0].readings;
+    for(int p=1; p<3; p++)
+    {
+      double perReading = r[p].uC/r[p].delivered;
+      double delivery = 100.0*r[p].delivered/r[p].readings;
+      if(p == 2)
+      {
+        snprintf(what, sizeof(what), "%s, batch: %.1f%% less energy per delivered reading (40%% needed)",
+                 sc.name, 100*(1 - perReading/base));
+        failures += check(perReading < base*0.60, what);
+      }
+      else if(sc.linkSaves)
+      {
+        snprintf(what, sizeof(what), "%s, link: %.1f%% less energy per delivered reading",
+                 sc.name, 100*(1 - perReading/base));
+        failures += check(perReading < base, what);
+      }
+      else
+      {
+        snprintf(what, sizeof(what), "%s, link: %.1f uC per delivered reading, no more than fixed (%.1f)",
+                 sc.name, perReading, base);
+        failures += check(perReading <= base, what);
+      }
+      snprintf(what, sizeof(what), "%s, %s: delivery %.2f%% against %.2f%%",
+               sc.name, policies[p].name, delivery, baseDelivery);
+      failures += check(delivery >= baseDelivery - 0.5, what);
+    }
+  }
+
+  printf(failures ? "FAIL\n" : "PASS\n");
+  return failures ? 1 : 0;
+}
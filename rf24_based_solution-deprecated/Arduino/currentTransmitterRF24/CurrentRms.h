@@ -0,0 +1,197 @@
+//
+// CurrentRms - continuous RMS, peak and energy for all the CT channels
+//
+// A timer interrupt round-robins the ADC over the channels (SAMPLE_HZ in
+// total, so SAMPLE_HZ/CHANNELS each) and hands every conversion to
+// RmsSampler::sample().  That part is integer only, quick enough for the ISR:
+//  - DC offset: each channel's bias point (~512) is tracked by a slow EWMA
+//    (2^OFFSET_SHIFT samples, about a second) and taken off.  Same job as
+//    the 0.996 high pass filter from EmonLib, without the floats.
+//  - squares summed over WINDOW_SAMPLES (3 line cycles) and handed over
+//
+// loop() takes the finished windows (takeWindow(), with interrupts off) and
+// CurrentMeter turns them into, per send interval:
+//  - RMS amps
+//  - peak hold: the highest window RMS, so a 50ms spike on any circuit shows
+//  - energy, counted from samples so a slow loop() doesn't lose any
+//
+#ifndef CURRENTRMS_H
+#define CURRENTRMS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define CHANNELS 6
+#define SAMPLE_HZ 6000           // conversions per second, all channels (1000 per channel)
+#define WINDOW_SAMPLES 50        // per channel: 50ms, 3 cycles at 60Hz
+#define OFFSET_SHIFT 10          // DC offset EWMA, 1024 samples
+#define FRAC_BITS 2              // fraction bits kept on offset-free samples
+#define SETTLE_WINDOWS 40        // windows dropped at start while the offset settles (2s)
+
+//Packet: one per interval, all channels
+#define PACKET_TYPE 'A'
+#define PACKET_SIZE (2+CHANNELS*4+4)
+//  [0]     PACKET_TYPE
+//  [1]     sequence
+//  [2..]   RMS amps per channel, uint16 centiamps
+//  [14..]  peak amps per channel, uint16 centiamps
+//  [26..]  total Wh of channel (sequence % CHANNELS), uint32 - one channel a
+//          packet so it fits in 32 bytes; a lost packet loses no energy
+
+//
+// ISR side
+//
+class RmsSampler
+{
+  public:
+    void begin(int midpoint)
+    {
+      for(int ch=0;ch<CHANNELS;ch++)
+      {
+        offset[ch]=(int32_t)midpoint<<16;
+        sumSq[ch]=0;
+        n[ch]=0;
+        readySumSq[ch]=0;
+        readyCount[ch]=0;
+        settle[ch]=SETTLE_WINDOWS;
+      }
+      overruns=0;
+    }
+
+    //One conversion of one channel
+    void sample(uint8_t ch, int16_t raw)
+    {
+      offset[ch] += (((int32_t)raw<<16) - offset[ch]) >> OFFSET_SHIFT;
+      int16_t centred = (int16_t)(((int32_t)raw<<FRAC_BITS) - (offset[ch]>>(16-FRAC_BITS)));
+      sumSq[ch] += (int32_t)centred*centred;
+      if(++n[ch] < WINDOW_SAMPLES) return;
+
+      //Window done: hand it over, unless loop() is so far behind it won't fit
+      if(settle[ch]) settle[ch]--;
+      else if(readySumSq[ch] <= 0xFFFFFFFFUL - sumSq[ch])
+      {
+        readySumSq[ch] += sumSq[ch];
+        readyCount[ch] += n[ch];
+      }
+      else overruns++;
+      sumSq[ch]=0;
+      n[ch]=0;
+    }
+
+    //Windows finished since the last call (call with interrupts off)
+    bool takeWindow(uint8_t ch, uint32_t *windowSumSq, uint16_t *count)
+    {
+      if(readyCount[ch]==0) return false;
+      *windowSumSq=readySumSq[ch];
+      *count=readyCount[ch];
+      readySumSq[ch]=0;
+      readyCount[ch]=0;
+      return true;
+    }
+
+    uint16_t getOverruns() { return overruns; }
+
+  private:
+    int32_t offset[CHANNELS];          // bias, 16 fraction bits
+    uint32_t sumSq[CHANNELS];          // window in progress
+    uint8_t n[CHANNELS];
+    volatile uint32_t readySumSq[CHANNELS];
+    volatile uint16_t readyCount[CHANNELS];
+    uint8_t settle[CHANNELS];
+    volatile uint16_t overruns;
+};
+
+//
+// loop() side
+//
+class CurrentMeter
+{
+  public:
+    void begin(float channelHz)
+    {
+      this->channelHz=channelHz;
+      for(int ch=0;ch<CHANNELS;ch++)
+      {
+        ampsPerUnit[ch]=0;
+        volts[ch]=0;
+        totalWh[ch]=0;
+        carryWh[ch]=0;
+      }
+      endInterval();
+    }
+
+    //Amps per ADC count (see readAmps() in the sketch) and the circuit's volts
+    void setScale(uint8_t ch, float ampsPerCount, float circuitVolts)
+    {
+      ampsPerUnit[ch]=ampsPerCount/(1<<FRAC_BITS);
+      volts[ch]=circuitVolts;
+    }
+
+    void addWindow(uint8_t ch, uint32_t windowSumSq, uint16_t count)
+    {
+      float amps = sqrt((float)windowSumSq/count)*ampsPerUnit[ch];
+      if(amps > peak[ch]) peak[ch]=amps;
+      intervalSumSq[ch] += (float)windowSumSq*ampsPerUnit[ch]*ampsPerUnit[ch];
+      intervalCount[ch] += count;
+      intervalWh[ch] += amps*volts[ch]*count/channelHz/3600.0;
+    }
+
+    float getRms(uint8_t ch) { return intervalCount[ch] ? sqrt(intervalSumSq[ch]/intervalCount[ch]) : 0; }
+    float getPeak(uint8_t ch) { return peak[ch]; }
+    float getKwh(uint8_t ch) { return (totalWh[ch]+carryWh[ch]+intervalWh[ch])/1000.0; }
+
+    //Interval sent: energy into the totals (whole Wh, so a float never has to
+    //add a small number to a big one), the rest starts over
+    void endInterval()
+    {
+      for(int ch=0;ch<CHANNELS;ch++)
+      {
+        carryWh[ch] += intervalWh[ch];
+        uint32_t whole=(uint32_t)carryWh[ch];
+        totalWh[ch] += whole;
+        carryWh[ch] -= whole;
+        intervalSumSq[ch]=0;
+        intervalCount[ch]=0;
+        intervalWh[ch]=0;
+        peak[ch]=0;
+      }
+    }
+
+    //Call before endInterval()
+    int buildPacket(uint8_t *packet, uint8_t sequence)
+    {
+      packet[0]=PACKET_TYPE;
+      packet[1]=sequence;
+      for(int ch=0;ch<CHANNELS;ch++)
+      {
+        uint16_t rms=centiamps(getRms(ch));
+        uint16_t pk=centiamps(peak[ch]);
+        memcpy(&packet[2+ch*2],&rms,2);
+        memcpy(&packet[2+CHANNELS*2+ch*2],&pk,2);
+      }
+      uint8_t energyCh=sequence%CHANNELS;
+      uint32_t wh=totalWh[energyCh]+(uint32_t)(carryWh[energyCh]+intervalWh[energyCh]);
+      memcpy(&packet[2+CHANNELS*4],&wh,4);
+      return PACKET_SIZE;
+    }
+
+  private:
+    float channelHz;
+    float ampsPerUnit[CHANNELS];
+    float volts[CHANNELS];
+    float intervalSumSq[CHANNELS];     // amps^2 x samples
+    uint32_t intervalCount[CHANNELS];
+    float intervalWh[CHANNELS];
+    float peak[CHANNELS];
+    uint32_t totalWh[CHANNELS];
+    float carryWh[CHANNELS];
+
+    static uint16_t centiamps(float amps)
+    {
+      float c=amps*100.0+0.5;
+      return c > 65535.0 ? 65535 : (uint16_t)c;
+    }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "nRF24L01.h"
 #include "RF24.h"
 #include "printf.h"
+#include "CurrentRms.h"
 
 /*
  Get amps from ADC assuming a 1.1v reference:  =(((ADC/1023)*1.1)/62)*1800
@@ -25,10 +26,10 @@ code: https://github.com/openenergymonitor/EmonLib/blob/master/EmonLib.cpp
 // Hardware configuration: Set up nRF24L01 radio on SPI bus plus pins 9 & 10 
 RF24 radio(9,10);
 //byte addresses[][8] = {"Node2","Master"};              // Radio pipe addresses for the 2 nodes to communicate.
-byte data[5];  //data buffer to send
+byte data[PACKET_SIZE];  //data buffer to send
  
 //Define pins
-#define LED_PIN 8     // LED pin (turns on when reading/transmitting)
+#define LED_PIN 8     // LED pin (turns on when transmitting)
 #define CPIN0   0     // adc pin for 100A ct sensor
 #define CPIN1   1     // adc pin for 100A ct sensor
 #define CPIN2   2     // adc pin for 30A ct sensor
@@ -36,23 +37,34 @@ byte data[5];  //data buffer to send
 #define CPIN4   4     // adc pin for 100A ct sensor
 #define CPIN5   5     // adc pin for 100A ct sensor
 
-//Protocol constants
-const byte ADDR0 = B00000000;    //Address byte for amps message
-const byte ADDR1 = B00000001;    //Address byte for amps message
-const byte ADDR2 = B00000010;    //Address byte for amps message
-const byte ADDR3 = B00000011;    //Address byte for amps message
-const byte ADDR4 = B00000100;    //Address byte for amps message
-const byte ADDR5 = B00000101;    //Address byte for amps message
-
 //Constants for calculations
 const int ICAL_30A = 30;             //see comment above for explanation  (30 for 30A CT, and 58 for 100A CT)
 const int ICAL_100A = 58;
 const double ADCRES = 1024.0;        //10bit adc
 const double VOLTS = 120.4;          //approx household voltage
-const int CROSSINGS = 20;            // how many times we sample (20 is 10 full waveforms)
-const int TIMEOUT = 5000;            //timeout for sampling
-const int READ_INTERVAL = 2000;      //Interval between sensor reads
-const int TRANS_INTERVAL = 30000;    //Interval for sending out data via transmitter  (end of all sensor reads)
+const int TRANS_INTERVAL = 30000;    //Interval for sending out data via transmitter (all channels in one packet)
+
+//Sampler timing (see startSampler())
+#define TIMER_TOP (F_CPU/SAMPLE_HZ)
+
+#if F_CPU > 8000000L
+  #define ADC_PRESCALE (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))   //128: 125kHz at 16MHz
+#else
+  #define ADC_PRESCALE (_BV(ADPS2) | _BV(ADPS1))                //64: 125kHz at 8MHz
+#endif
+
+
+//Per channel, in ADC mux order (channel 2 has always been read with the 100A value)
+const byte channelPins[CHANNELS] = {CPIN0,CPIN1,CPIN2,CPIN3,CPIN4,CPIN5};
+const int channelICal[CHANNELS] = {ICAL_100A,ICAL_100A,ICAL_100A,ICAL_100A,ICAL_100A,ICAL_100A};
+const double channelVolts[CHANNELS] = {VOLTS,VOLTS,VOLTS,VOLTS,VOLTS,VOLTS};  //2*VOLTS for a 240v circuit
+
+//Sampler (ISR) and meter (loop)
+RmsSampler sampler;
+CurrentMeter meter;
+volatile byte adcChannel = 0;        //channel being converted
+byte sequence = 0;
+unsigned long lastSendTime = 0;
  
 //Set things up
 void setup()
@@ -74,89 +86,79 @@ void setup()
   //radio.setAutoAck(1);                    // Ensure autoACK is enabled
   //radio.enableAckPayload();               // Allow optional ack payloads
   //radio.setRetries(0,5);                 // Smallest time between retries, max no. of retries
-  radio.setPayloadSize(5);                // Here we are sending 5-byte payloads 
+  radio.setPayloadSize(PACKET_SIZE);      // All channels in one payload
   radio.openWritingPipe(0xF0F0F0F0E1LL);        // Write to "Power" pipe
   //radio.openReadingPipe(1,0xF0F0F0F0D2LL);      // Open a reading pipe on address 0, pipe 1  -- no need to read, ACK is fine
   radio.startListening();                 // Start listening
   radio.powerUp();
   radio.printDetails();                   // Dump the configuration of the rf unit for debugging
+
+  //Start sampling all channels
+  sampler.begin(ADCRES/2);
+  meter.begin((double)F_CPU/TIMER_TOP/CHANNELS);
+  setScales();
+  startSampler();
+  lastSendTime = millis();
 }
  
-//Get ADC readings and send them out via transmitter 
+//Take the sampler's finished windows, and send every TRANS_INTERVAL.  Nothing here waits.
 void loop()
 {
-   //Read adc, calculate amps, then send for each sensor
-   readSendAmps(CPIN0,ICAL_100A,ADDR0);
-   delay(READ_INTERVAL);
-   readSendAmps(CPIN1,ICAL_100A,ADDR1);
-   delay(READ_INTERVAL);
-   readSendAmps(CPIN2,ICAL_100A,ADDR2);
-   delay(READ_INTERVAL);
-   readSendAmps(CPIN3,ICAL_100A,ADDR3);
-   delay(READ_INTERVAL);
-   readSendAmps(CPIN4,ICAL_100A,ADDR4);
-   delay(READ_INTERVAL);
-   readSendAmps(CPIN5,ICAL_100A,ADDR5);
-   delay(READ_INTERVAL);   
-    
-   //Wait before looping
-   delay(TRANS_INTERVAL);
-}
+   uint32_t sumSq;
+   uint16_t count;
+   for(byte ch=0;ch<CHANNELS;ch++)
+   {
+     noInterrupts();
+     bool got = sampler.takeWindow(ch,&sumSq,&count);
+     interrupts();
+     if(got) meter.addWindow(ch,sumSq,count);
+   }
 
-//Read and send w/ blinky LED
-void readSendAmps(int pin,int iCal,byte addr)
-{
-  //turn on LED
-  digitalWrite(LED_PIN, HIGH);
+   if(millis()-lastSendTime >= TRANS_INTERVAL)
+   {
+     lastSendTime += TRANS_INTERVAL;
+     sendAll();
 
-  //Read, then send amps
-  double amps = readAmps(pin,iCal);  //pin to read, calibration value
-  //Serial.println(amps);
-  sendAmps(amps,addr);              //amps to transmit
-  
-  //turn off LED
-  digitalWrite(LED_PIN, LOW);
+     //Vcc moves with load and temperature; readVcc() needs the ADC to itself
+     stopSampler();
+     setScales();
+     startSampler();
+   }
 }
 
-//Read Amps
-double readAmps(int samplePin,int iCal)
+//Amps per ADC count for each channel, from the measured reference
+void setScales()
 {
-   //Get adcRMSVal
-   double adcRMSVal=getAdcRMSVal(samplePin);
-
-   //Let calc the values now
    double aRef = readVcc();
-   double ratio = iCal *(aRef / ADCRES);
-   double amps = ratio*adcRMSVal; 
-   
-   //double sensv = (adcRMSVal/ADCRES)*aRef;
-   //double kW = ((amps*VOLTS)*2.0)/1000.0;  // doubled due to 220v
-   
-   return amps;
+   for(byte ch=0;ch<CHANNELS;ch++)
+     meter.setScale(ch, channelICal[ch]*(aRef/ADCRES), channelVolts[ch]);
 }
 
-//Send Amps
-void sendAmps(double amps,byte addr)
+//Send all channels w/ blinky LED
+void sendAll()
 {
-  Serial.println(amps);
-  printf("Sending addr: %d  amps: %f\n",addr,amps);
-    
-  //Fill data buffer
-  data[0]=addr;
-  float famps=(float)amps;
-  memcpy(&data[1],&famps,4);
-    
-  //printf("Sending bytes: ");
-  //for(int i=0;i<5;i++) {
-  //  printf("%c ",data[i]); }
-  //printf("\n"); 
+  //turn on LED
+  digitalWrite(LED_PIN, HIGH);
+
+  int len = meter.buildPacket(data,sequence);
+  for(byte ch=0;ch<CHANNELS;ch++)
+  {
+    printf("Channel %d  amps: ",ch);
+    Serial.print(meter.getRms(ch));
+    Serial.print("  peak: ");
+    Serial.print(meter.getPeak(ch));
+    Serial.print("  kWh: ");
+    Serial.println(meter.getKwh(ch),3);
+  }
+  if(sampler.getOverruns()) printf("Sampler overruns: %d\n",sampler.getOverruns());
+  meter.endInterval();
+  sequence++;
 
   //Send it
-  radioSend(data,5);
-  
-   //Send amps and addr
-   //radioSend(&addr,1);
-   //radioSend(&amps,4);
+  radioSend(data,len);
+
+  //turn off LED
+  digitalWrite(LED_PIN, LOW);
 }
 
 void radioSend(const void *payload,int len)
@@ -188,69 +190,43 @@ void radioSend(const void *payload,int len)
     printf("Sending failed\n");
   }
 }
- 
-//Read the ADC and return the voltage 
-double getAdcRMSVal(int samplePin)
+
+//-------------------------------------------------------------------------------------------------------------------------
+// Sampler: Timer1 at SAMPLE_HZ.  Each tick reads the conversion started last tick, points the mux at the next
+// channel and starts it, so the ADC is never waited on.  A conversion is 13 ADC clocks: 104us at 125kHz, inside
+// the 166us tick.  AVR only, like readVcc().
+//-------------------------------------------------------------------------------------------------------------------------
+void startSampler()
 {
-    double adcRMSVal=0;
-    
-    int crossCount = 0;                             //Used to measure number of times threshold is crossed.
-    int numberOfSamples = 0;                        //This is now incremented  
-    double sumI = 0; //reset sum
-    long startSample;
-    int lastADCSample;
-    boolean lastVCross, checkVCross;
-    double lastFiltered, filtered = 0;
+  noInterrupts();
+  adcChannel = 0;
+  ADMUX = _BV(REFS0) | channelPins[0];        //AVcc reference, as analogRead() used
+  ADCSRA = _BV(ADEN) | ADC_PRESCALE;
+  ADCSRA |= _BV(ADSC);
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // 1) Waits for the waveform to be close to 'zero' (500 adc) part in sin curve.
-    //-------------------------------------------------------------------------------------------------------------------------
-    boolean st=false;                                  //an indicator to exit the while loop
-    unsigned long start = millis();    //millis()-start makes sure it doesnt get stuck in the loop if there is an error.
- 
-    while(st==false)                                   //the while loop...
-    {
-       startSample = analogRead(samplePin);                    //using the voltage waveform
-       if ((startSample < 550) && (startSample > 440)) st=true;  //check its within range
-       if ((millis()-start)>TIMEOUT) st = true;
-    }
-    int ADCSample = startSample; //seed
-      
-    //-------------------------------------------------------------------------------------------------------------------------
-    // 2) Main measurment loop
-    //------------------------------------------------------------------------------------------------------------------------- 
-    start = millis(); 
-    while ((crossCount < CROSSINGS) && ((millis()-start)<TIMEOUT)) 
-     {
-      numberOfSamples++;                            //Count number of times looped.
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS10);            //CTC, no prescale
+  OCR1A = TIMER_TOP - 1;
+  TCNT1 = 0;
+  TIMSK1 = _BV(OCIE1A);
+  interrupts();
+}
 
-      lastADCSample = ADCSample;
-      ADCSample = analogRead(samplePin); //read pin
-      
-      lastFiltered = filtered;
-      filtered = 0.996*(lastFiltered+ADCSample-lastADCSample);  //get rid of the bias
+void stopSampler()
+{
+  TIMSK1 = 0;
+  while (bit_is_set(ADCSRA,ADSC));            //let the last conversion finish
+}
 
-      //Add up sums of squares because we're going to sqrt the average at the end
-      sumI += (filtered * filtered);
-      
-      //-----------------------------------------------------------------------------
-      // G) Find the number of times the voltage has crossed the initial voltage
-      //    - every 2 crosses we will have sampled 1 wavelength 
-      //    - so this method allows us to sample an integer number of half wavelengths which increases accuracy
-      //-----------------------------------------------------------------------------       
-      lastVCross = checkVCross;                     
-      if (ADCSample > startSample) checkVCross = true; 
-                       else checkVCross = false;
-      if (numberOfSamples==1) lastVCross = checkVCross;                  
-                       
-      if (lastVCross != checkVCross) crossCount++;
-    }
-    
-    //Root-mean-square ADC readings
-    adcRMSVal=sqrt(sumI / numberOfSamples);
-    
-    return adcRMSVal;
-}  
+ISR(TIMER1_COMPA_vect)
+{
+  int raw = ADC;
+  byte ch = adcChannel;
+  adcChannel = (ch+1 == CHANNELS) ? 0 : ch+1;
+  ADMUX = _BV(REFS0) | channelPins[adcChannel];
+  ADCSRA |= _BV(ADSC);
+  sampler.sample(ch,raw);
+}
  
 //Find out the actual voltage at the chip for good ADC calibration 
 double readVcc() 
@@ -0,0 +1,216 @@
+//
+// Host test for CurrentRms.h: synthetic 60Hz currents through the sampler
+// and meter, the way the sketch drives them.
+//
+// Six channels are sampled round-robin at the Timer1 rate of a 16MHz board
+// (each channel a sixth of a tick later than the one before).  The ADC is
+// 10 bits with a bias point near 512 that isn't exactly 512 and drifts, plus
+// noise.  loop() is emulated taking windows every few ms, stalling for the
+// radio when it sends.  Checked per 30s interval against the true current:
+//  - RMS: pure sine, 3rd harmonic, off-frequency with a drifting bias, small
+//    and noisy, and nothing at all (within 1%, or the ADC noise floor)
+//  - peak hold catches a 150ms inrush on a channel that's otherwise steady
+//  - energy (kWh) of the steady channels
+//  - no windows dropped, and the packet decodes back to the same numbers
+//
+// Build and run (from currentTransmitterRF24/):
+//   g++ -std=c++11 -O2 -Wall -o RmsTest test/RmsTest.cpp && ./RmsTest
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../CurrentRms.h"
+
+#define F_CPU_HZ 16000000.0
+#define TIMER_TOP ((int)(F_CPU_HZ/SAMPLE_HZ))
+#define INTERVAL_S 30
+#define INTERVALS 5
+#define AMPS_PER_COUNT (58*(5.0/1024.0))     // ICAL_100A at a 5V reference
+#define VOLTS 120.4
+
+static uint64_t rngState = 0x2545F4914F6CDD1DULL;
+
+static double uniform()
+{
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return (rngState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian()
+{
+  double u1 = uniform(), u2 = uniform();
+  if(u1 < 1e-12) u1 = 1e-12;
+  return sqrt(-2*log(u1))*cos(2*M_PI*u2);
+}
+
+//
+// The circuits
+//
+struct Circuit
+{
+  const char *name;
+  double amps;            // RMS of the fundamental
+  double hz;
+  double third;           // 3rd harmonic, fraction of the fundamental
+  double noiseCounts;     // ADC noise, sigma
+  double bias;            // ADC counts at 0A
+  double biasDrift;       // counts per second
+  double spikeAmps;       // inrush RMS...
+  double spikeStart;      // ...from this second
+  double spikeLength;
+  double tolerance;       // RMS error allowed, amps (ADC noise and quantizing add in quadrature)
+};
+
+static const Circuit circuits[CHANNELS] = {
+  { "15A sine",          15.0, 60.00, 0.0, 0.5, 511.6,  0.0,  0,    0,    0,    0.15 },
+  { "4A + 30% 3rd",       4.0, 60.00, 0.3, 0.5, 513.2,  0.0,  0,    0,    0,    0.04 },
+  { "nothing",            0.0, 60.00, 0.0, 0.5, 510.9,  0.0,  0,    0,    0,    0.25 },
+  { "8A, 60A inrush",     8.0, 60.00, 0.0, 0.5, 512.4,  0.0, 60.0, 72.3, 0.15, 0.09 },
+  { "25A 59.9Hz, drift", 25.0, 59.90, 0.0, 0.5, 505.0,  0.1,  0,    0,    0,    0.25 },
+  { "2A noisy",           2.0, 60.05, 0.0, 1.5, 512.0,  0.0,  0,    0,    0,    0.06 },
+};
+
+static double trueAmps(const Circuit &c, double t)
+{
+  double rms = (t >= c.spikeStart && t < c.spikeStart + c.spikeLength) ? c.spikeAmps : c.amps;
+  double w = 2*M_PI*c.hz*t;
+  return rms*sqrt(2.0)*(sin(w) + c.third*sin(3*w + 0.7));
+}
+
+static int adc(const Circuit &c, double t)
+{
+  double counts = c.bias + c.biasDrift*t + trueAmps(c, t)/AMPS_PER_COUNT + c.noiseCounts*gaussian();
+  int raw = (int)floor(counts + 0.5);
+  return raw < 0 ? 0 : raw > 1023 ? 1023 : raw;
+}
+
+//1 if it failed, so main() can add them up
+static int check(bool ok, const char *what)
+{
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  int failures = 0;
+  RmsSampler sampler;
+  CurrentMeter meter;
+  double tickHz = F_CPU_HZ/TIMER_TOP;
+  sampler.begin(512);
+  meter.begin(tickHz/CHANNELS);
+  for(int ch=0;ch<CHANNELS;ch++) meter.setScale(ch, AMPS_PER_COUNT, VOLTS);
+
+  // Truth per interval: mean square of the current at the sample times
+  double trueSumSq[CHANNELS] = {0};
+  long trueCount[CHANNELS] = {0};
+  double trueWh[CHANNELS] = {0};
+  double worstRms[CHANNELS] = {0};
+  double worstPeak[CHANNELS] = {0};
+
+  long ticks = (long)(tickHz*(INTERVAL_S*INTERVALS + 1));
+  long nextPoll = 0;
+  long pollTicks = (long)(tickHz*0.007);        // loop() comes round every 7ms...
+  long stallTicks = (long)(tickHz*0.120);       // ...but a radio send with retries takes 120ms
+  double nextSend = INTERVAL_S;
+  double settled = (double)SETTLE_WINDOWS*WINDOW_SAMPLES*CHANNELS/tickHz;
+  uint8_t sequence = 0;
+  uint32_t sentWh[CHANNELS] = {0};
+  bool packetOk = true;
+
+  // The conversion read at each tick was started one tick before
+  int channel = 0;
+  for(long tick=0; tick<ticks; tick++)
+  {
+    double t = tick/tickHz;
+    const Circuit &c = circuits[channel];
+    sampler.sample(channel, adc(c, t - 1/tickHz));
+    if(t >= settled)
+    {
+      double a = trueAmps(c, t - 1/tickHz);
+      trueSumSq[channel] += a*a;
+      trueCount[channel]++;
+    }
+    channel = (channel+1) % CHANNELS;
+
+    if(tick < nextPoll) continue;
+    nextPoll = tick + pollTicks;
+    uint32_t sumSq;
+    uint16_t count;
+    for(int ch=0;ch<CHANNELS;ch++)
+    {
+      if(sampler.takeWindow(ch, &sumSq, &count)) meter.addWindow(ch, sumSq, count);
+    }
+
+    if(t < nextSend) continue;
+    nextSend += INTERVAL_S;
+    nextPoll = tick + stallTicks;
+
+    // Send, and compare
+    uint8_t packet[PACKET_SIZE];
+    int len = meter.buildPacket(packet, sequence);
+    if(len != PACKET_SIZE || len > 32 || packet[0] != PACKET_TYPE || packet[1] != sequence) packetOk = false;
+    printf("interval %d\n", sequence);
+    for(int ch=0;ch<CHANNELS;ch++)
+    {
+      const Circuit &cc = circuits[ch];
+      double truth = sqrt(trueSumSq[ch]/trueCount[ch]);
+      double rms = meter.getRms(ch);
+      bool spiked = cc.spikeLength > 0 && cc.spikeStart < t && cc.spikeStart >= t - INTERVAL_S;
+      double truePeak = spiked ? cc.spikeAmps*sqrt(1 + cc.third*cc.third) : cc.amps*sqrt(1 + cc.third*cc.third);
+      trueWh[ch] += truth*VOLTS*trueCount[ch]/(tickHz/CHANNELS)/3600;
+
+      printf("  %-18s rms %7.3f (true %7.3f)  peak %7.3f (true %7.3f)  %.4f kWh\n",
+             cc.name, rms, truth, meter.getPeak(ch), truePeak, meter.getKwh(ch));
+      double rmsErr = fabs(rms - truth);
+      double peakErr = fabs(meter.getPeak(ch) - truePeak)/fmax(truePeak, 1.0);
+      if(rmsErr > worstRms[ch]) worstRms[ch] = rmsErr;
+      if(peakErr > worstPeak[ch]) worstPeak[ch] = peakErr;
+
+      // Decode it as the hub would
+      uint16_t centiRms, centiPeak;
+      memcpy(&centiRms, &packet[2+ch*2], 2);
+      memcpy(&centiPeak, &packet[2+CHANNELS*2+ch*2], 2);
+      if(fabs(centiRms/100.0 - rms) > 0.006 || fabs(centiPeak/100.0 - meter.getPeak(ch)) > 0.006) packetOk = false;
+
+      trueSumSq[ch] = 0;
+      trueCount[ch] = 0;
+    }
+    memcpy(&sentWh[sequence % CHANNELS], &packet[2+CHANNELS*4], 4);
+    meter.endInterval();
+    if(++sequence == INTERVALS) break;
+  }
+
+  // Energy as the hub would have it: packet 4 carried channel 4, and so on
+  double steadyErr = 0;
+  const int steady[] = {0, 4};
+  for(int ch : steady)
+  {
+    double kwh = meter.getKwh(ch);
+    double err = fabs(kwh - trueWh[ch]/1000)/(trueWh[ch]/1000);
+    printf("%-18s %.4f kWh (true %.4f)\n", circuits[ch].name, kwh, trueWh[ch]/1000);
+    if(err > steadyErr) steadyErr = err;
+  }
+  bool sentOk = fabs(sentWh[4] - meter.getKwh(4)*1000) < 1.01;   // within a Wh
+
+  char what[96];
+  for(int ch=0;ch<CHANNELS;ch++)
+  {
+    snprintf(what, sizeof(what), "%s: RMS within %.2fA, worst %.3fA", circuits[ch].name, circuits[ch].tolerance, worstRms[ch]);
+    failures += check(worstRms[ch] < circuits[ch].tolerance, what);
+  }
+  snprintf(what, sizeof(what), "inrush held as peak within 3%%, worst %.2f%%", worstPeak[3]*100);
+  failures += check(worstPeak[3] < 0.03, what);
+  snprintf(what, sizeof(what), "energy of steady circuits within 1%%, worst %.2f%%", steadyErr*100);
+  failures += check(steadyErr < 0.01, what);
+  failures += check(sampler.getOverruns() == 0, "no windows dropped with a 120ms loop() stall");
+  failures += check(packetOk, "packet is 30 bytes and decodes to what was measured");
+  failures += check(sentOk, "energy total in the packet matches the meter");
+
+  printf(failures ? "FAIL\n" : "PASS\n");
+  return failures ? 1 : 0;
+}
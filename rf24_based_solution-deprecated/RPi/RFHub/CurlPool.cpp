@@ -0,0 +1,75 @@
+#include <stdexcept>
+
+#include "CurlPool.h"
+
+//Idle handles kept beyond this are cleaned up (only reached if many
+//threads call at once)
+#define MAX_IDLE_HANDLES 4
+
+CurlPool &CurlPool::Instance()
+{
+    static CurlPool pool;
+    return pool;
+}
+
+CurlPool::CurlPool()
+{
+    curl_global_init(CURL_GLOBAL_ALL);
+    created=0;
+    reused=0;
+}
+
+CurlPool::~CurlPool()
+{
+    for (size_t i = 0; i < idle.size(); i++)
+        curl_easy_cleanup(idle[i]);
+}
+
+CURL *CurlPool::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!idle.empty())
+        {
+            CURL *curl = idle.back();
+            idle.pop_back();
+            reused++;
+            //Clears options only; live connections and DNS cache are kept
+            curl_easy_reset(curl);
+            return curl;
+        }
+        created++;
+    }
+
+    CURL *curl = curl_easy_init();
+    if ( curl == NULL )
+        throw std::runtime_error("Unable to initialize curl handler");
+    return curl;
+}
+
+void CurlPool::Release(CURL *curl)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (idle.size() < MAX_IDLE_HANDLES)
+        idle.push_back(curl);
+    else
+        curl_easy_cleanup(curl);
+}
+
+std::shared_ptr<struct curl_slist> CurlPool::Headers(const std::string &token)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (headers && headerToken == token)
+        return headers;
+
+    struct curl_slist *chunk = NULL;
+    chunk = curl_slist_append(chunk, "Accept:");
+    chunk = curl_slist_append(chunk, "Content-Type: application/json;type=entry;charset=utf-8");
+    if(token.length()>2)
+        chunk = curl_slist_append(chunk, ("Authorization: Bearer " + token).c_str());
+
+    //Replacing it drops the pool's reference to the old list
+    headerToken = token;
+    headers.reset(chunk, curl_slist_free_all);
+    return headers;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <curl/curl.h>
+
+//
+// Process-wide pool of curl easy handles for the synchronous WebAPI calls.
+//
+// An easy handle keeps its connection cache between transfers, so handing
+// the same handles out again (rather than curl_easy_init/cleanup per call)
+// keeps HTTP keep-alive connections to the Azure and Weather Underground
+// hosts open. The request header list is built once per token; the old
+// one is freed when the token changes and the last transfer using it ends.
+//
+class CurlPool
+{
+public:
+    static CurlPool &Instance();
+
+    //! Idle handle (reset, connections kept) or a new one; never NULL
+    CURL *Acquire();
+    //! Give a handle back for the next call
+    void Release(CURL *curl);
+
+    //! Shared "Accept:/Content-Type/Authorization" header list for token;
+    //! hold on to it until the transfer it's set on has finished
+    std::shared_ptr<struct curl_slist> Headers(const std::string &token);
+
+    long Created() const { return created; }
+    long Reused() const { return reused; }
+
+private:
+    CurlPool();
+    ~CurlPool();
+    CurlPool(const CurlPool &);
+
+    std::mutex lock;
+    std::vector<CURL *> idle;
+    long created;
+    long reused;
+
+    //The current token's list.  A transfer on another thread may still be
+    //using the previous one, so each transfer holds a reference of its own
+    std::string headerToken;
+    std::shared_ptr<struct curl_slist> headers;
+};
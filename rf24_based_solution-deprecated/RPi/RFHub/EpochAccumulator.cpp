@@ -1,57 +1,63 @@
 #include "EpochAccumulator.h"
 
 
+EpochAccumulator::EpochAccumulator(long _bucketSeconds)
+{
+   bucketSeconds=_bucketSeconds>0 ? _bucketSeconds : 1;
+   sum=0;
+}
+
 float EpochAccumulator::Sum()
 {
-   float sum=accumulate(valueList.begin(),valueList.end(),0.0);
    //cout << "Sum: " << sum << '\n';
-   return sum;
+   return (float)sum;
 }
 
 void EpochAccumulator::DumpEpochValues()
 {
-   list<long>::iterator epochIterator;
-   list<float>::iterator valueIterator;
+   deque<Bucket>::iterator bucketIterator;
 
-   valueIterator=valueList.begin();
-   epochIterator=epochList.begin();
-   while(epochIterator != epochList.end()) 
-   {
-      //cout << "Epoch: " << *epochIterator << " Count: " << *valueIterator << '\n';
-
-      epochIterator++;
-      valueIterator++; //keep in sync
-   }
+   for(bucketIterator=buckets.begin(); bucketIterator!=buckets.end(); bucketIterator++)
+      cout << "Epoch: " << bucketIterator->newest << " Count: " << bucketIterator->value << '\n';
+   cout << "Sum: " << sum << '\n';
 }
 
 void EpochAccumulator::AddEpochValue(long epoch,float value)
 {
    if(value<=0)
       return;
-   
-   epochList.push_back(epoch);
-   valueList.push_back(value);
+
+   //Merge into the newest bucket if it's the same slot (or the clock
+   //stepped back), otherwise start a new one
+   long slot=epoch/bucketSeconds;
+   if(!buckets.empty() && slot<=buckets.back().slot)
+   {
+      Bucket &last=buckets.back();
+      last.value+=value;
+      if(epoch>last.newest)
+         last.newest=epoch;
+   }
+   else
+   {
+      Bucket bucket;
+      bucket.slot=slot;
+      bucket.newest=epoch;
+      bucket.value=value;
+      buckets.push_back(bucket);
+   }
+   sum+=value;
 }
 
 void EpochAccumulator::RemoveOldEpochs(long epochThreshold)
 {
-   list<long>::iterator epochIterator;
-   list<float>::iterator valueIterator;
-
-   valueIterator=valueList.begin();
-   epochIterator=epochList.begin();
-   while(epochIterator != epochList.end()) 
+   while(!buckets.empty() && buckets.front().newest <= epochThreshold)
    {
-      if(*epochIterator <= epochThreshold)
-      {
-         //cout << "Removing Epoch: " << *epochIterator << " Count: " << *valueIterator << '\n';
-         epochList.erase(epochIterator++);
-         valueList.erase(valueIterator++);
-      }
-      else
-      {
-         epochIterator++;
-         valueIterator++; //keep in sync
-      }
+      //cout << "Removing Epoch: " << buckets.front().newest << " Count: " << buckets.front().value << '\n';
+      sum-=buckets.front().value;
+      buckets.pop_front();
    }
-}
\ No newline at end of file
+
+   //Don't let rounding in the running total outlive the samples
+   if(buckets.empty())
+      sum=0;
+}
@@ -1,19 +1,40 @@
+#pragma once
+
 #include <iostream>
-#include <list>
-#include <numeric>      // std::accumulate
+#include <deque>
 using namespace std;
 
-
+//
+// Sliding-window sum of (epoch, value) samples.
+//
+// Samples are kept oldest first in a deque with a running total, so adding,
+// trimming and Sum() are O(1) amortised.  Samples that fall in the same
+// bucketSeconds-wide slot are merged; a long window (e.g. since midnight)
+// then holds at most window/bucketSeconds entries.  A bucket is only
+// removed once its newest sample is old enough, so the window edge is
+// accurate to one bucket, never cutting off values still inside it.
+//
 class EpochAccumulator
 {
 public:
+    EpochAccumulator(long bucketSeconds = 1);
 
     void DumpEpochValues();
     void AddEpochValue(long epoch,float value);
     float Sum();
     void RemoveOldEpochs(long epochThreshold);
 
+    size_t Buckets() const { return buckets.size(); }
+
 private:
-    list<long> epochList;
-    list<float> valueList;
-};
\ No newline at end of file
+    struct Bucket
+    {
+        long slot;      //epoch / bucketSeconds
+        long newest;    //latest epoch merged in
+        double value;
+    };
+
+    long bucketSeconds;
+    deque<Bucket> buckets;
+    double sum;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+//
+// Stand-in for the RF24 library so the radio loop builds and runs on any
+// Linux box (see RadioBench.cpp). Only the calls HubMaster makes exist.
+//
+// Behaves like the nRF24L01+ receive side: a 3-deep RX FIFO (payloads are
+// lost when it is full), and an active-low IRQ that falls when RX_DR goes
+// from clear to set and is cleared by read(). The IRQ line is an eventfd
+// that a GpioEdge can Attach() to.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <deque>
+#include <mutex>
+
+#define RPI_V2_GPIO_P1_15 22
+#define RPI_V2_GPIO_P1_24 8
+#define BCM2835_SPI_SPEED_8MHZ 32
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+
+inline void delay(unsigned ms) { usleep(ms * 1000); }
+
+class RF24
+{
+public:
+    static const size_t FIFO_DEPTH = 3;
+
+    RF24(uint8_t, uint8_t, uint32_t) : irqFd(eventfd(0, EFD_NONBLOCK)), rxReady(false), rxMasked(false), lost(0) {}
+    ~RF24() { close(irqFd); }
+
+    bool begin() { return true; }
+    void setPALevel(uint8_t) {}
+    bool setDataRate(rf24_datarate_e) { return true; }
+    void setAutoAck(bool) {}
+    void enableAckPayload() {}
+    void setRetries(uint8_t, uint8_t) {}
+    void enableDynamicPayloads() {}
+    void printDetails() {}
+    void openWritingPipe(uint64_t) {}
+    void openReadingPipe(uint8_t, uint64_t) {}
+    void startListening() {}
+    void maskIRQ(bool, bool, bool rx_ready) { rxMasked = rx_ready; }
+    bool testCarrier() { return false; }
+    uint8_t flush_tx() { return 0; }
+    void writeAckPayload(uint8_t, const void *, uint8_t) {}
+
+    bool available() { return available(NULL); }
+    bool available(uint8_t *pipe)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (fifo.empty())
+            return false;
+        if (pipe)
+            *pipe = fifo.front().pipe;
+        return true;
+    }
+
+    uint8_t getDynamicPayloadSize()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return fifo.empty() ? 0 : fifo.front().len;
+    }
+
+    void read(void *buf, uint8_t len)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (fifo.empty())
+            return;
+        memcpy(buf, fifo.front().data, len < fifo.front().len ? len : fifo.front().len);
+        fifo.pop_front();
+        rxReady = false;  //RF24::read clears RX_DR
+    }
+
+    //
+    // Test side
+    //
+
+    //! A payload arrives over the air; false if the FIFO was full
+    bool Inject(uint8_t pipe, const void *data, uint8_t len)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (fifo.size() >= FIFO_DEPTH)
+        {
+            lost++;
+            return false;
+        }
+        Payload p;
+        p.pipe = pipe;
+        p.len = len > 32 ? 32 : len;
+        memcpy(p.data, data, p.len);
+        fifo.push_back(p);
+        if (!rxReady)
+        {
+            rxReady = true;
+            if (!rxMasked)
+            {
+                uint64_t one = 1;
+                ssize_t n = write(irqFd, &one, sizeof(one));
+                (void)n;
+            }
+        }
+        return true;
+    }
+
+    int IrqFd() const { return irqFd; }
+    long Lost() const { return lost; }
+
+private:
+    struct Payload
+    {
+        uint8_t pipe;
+        uint8_t len;
+        uint8_t data[32];
+    };
+
+    std::mutex lock;
+    std::deque<Payload> fifo;
+    int irqFd;
+    bool rxReady;
+    bool rxMasked;
+    long lost;
+};
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Logger.h"
+#include "GpioEdge.h"
+
+static bool WriteSysfs(const char *path, const char *value)
+{
+    int f = open(path, O_WRONLY);
+    if (f < 0)
+        return false;
+    bool ok = write(f, value, strlen(value)) == (ssize_t)strlen(value);
+    close(f);
+    return ok;
+}
+
+GpioEdge::GpioEdge()
+{
+    fd = -1;
+    events = 0;
+    owned = false;
+}
+
+GpioEdge::~GpioEdge()
+{
+    if (owned && fd >= 0)
+        close(fd);
+}
+
+bool GpioEdge::Open(int gpio)
+{
+    if (gpio < 0)
+        return false;
+
+    char path[64], number[12];
+    snprintf(number, sizeof(number), "%d", gpio);
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/edge", gpio);
+
+    //Already exported is fine (EBUSY); udev may take a moment to fix
+    //permissions on the new files, so retry for up to a second
+    WriteSysfs("/sys/class/gpio/export", number);
+    bool configured = false;
+    for (int i = 0; i < 10 && !configured; i++)
+    {
+        char direction[64];
+        snprintf(direction, sizeof(direction), "/sys/class/gpio/gpio%d/direction", gpio);
+        configured = WriteSysfs(direction, "in") && WriteSysfs(path, "falling");
+        if (!configured)
+            usleep(100000);
+    }
+    if (!configured)
+    {
+        LogErrorLine() << "GPIO " << gpio << ": unable to configure edge detection";
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", gpio);
+    int valueFd = open(path, O_RDONLY | O_NONBLOCK);
+    if (valueFd < 0)
+    {
+        LogErrorLine() << "GPIO " << gpio << ": unable to open " << path;
+        return false;
+    }
+
+    Attach(valueFd, POLLPRI | POLLERR);
+    owned = true;
+
+    //Discard the level read at open so only new edges wake us
+    Wait(0);
+    return true;
+}
+
+void GpioEdge::Attach(int _fd, short _events)
+{
+    fd = _fd;
+    events = _events;
+    owned = false;
+}
+
+bool GpioEdge::Wait(int timeoutMs)
+{
+    if (fd < 0)
+    {
+        usleep(timeoutMs * 1000);
+        return false;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeoutMs) <= 0 || (pfd.revents & events) == 0)
+        return false;
+
+    //sysfs needs a rewind and read to re-arm; an eventfd just needs the
+    //read (lseek fails with ESPIPE there, which is harmless)
+    char buffer[16];
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    (void)n;
+    return true;
+}
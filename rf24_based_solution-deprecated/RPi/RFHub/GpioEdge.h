@@ -0,0 +1,33 @@
+#pragma once
+
+//
+// Wait on a GPIO edge without spinning.
+//
+// Uses the sysfs GPIO interface: the pin is exported, set to input with
+// edge detection, and poll() on its value file sleeps until the kernel
+// sees the edge. The edge is latched by the kernel, so one that arrives
+// while we are busy is reported by the next Wait().
+//
+class GpioEdge
+{
+public:
+    GpioEdge();
+    ~GpioEdge();
+
+    //! Export gpio (BCM numbering) for falling edges. False if unavailable.
+    bool Open(int gpio);
+    //! Wait on an already open fd instead (test builds: an eventfd)
+    void Attach(int fd, short events);
+    bool IsOpen() const { return fd >= 0; }
+
+    //! Sleep until an edge or timeoutMs. True if an edge arrived; it is
+    //! cleared before returning.
+    bool Wait(int timeoutMs);
+
+private:
+    GpioEdge(const GpioEdge &);
+
+    int fd;
+    short events;
+    bool owned;
+};
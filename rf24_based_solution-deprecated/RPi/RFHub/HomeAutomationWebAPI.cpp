@@ -14,9 +14,17 @@ HomeAutomationWebAPI::HomeAutomationWebAPI()
 {
     authenticatedFlag=false;
     token="";
+    uploader=NULL;
+    authInFlight=false;
     baseURL="http://wilkiehomeautomation.azurewebsites.net";
 }
 
+HomeAutomationWebAPI::~HomeAutomationWebAPI()
+{
+    if(authThread.joinable())
+        authThread.join();
+}
+
 bool HomeAutomationWebAPI::Authenticate(const std::string &PAT)
 {
     pat=PAT;
@@ -29,11 +37,14 @@ bool HomeAutomationWebAPI::Authenticate()
     {
         WebAPI webAPI(baseURL);
         std::string webResponse=webAPI.PlainPOST("/api/token","","{\"pat\":\""+pat+"\"}");
-        token=ParseToken(webResponse);
+        std::string newToken=ParseToken(webResponse);
 
-        if(token.length()>2)
+        if(newToken.length()>2)
             authenticatedFlag=true;
 
+        std::lock_guard<std::mutex> guard(tokenLock);
+        token=newToken;
+
         LogLine()  << "AuthenticatedFlag: " << authenticatedFlag;
     }
     catch(WebAPIException& e)
@@ -49,7 +60,7 @@ void HomeAutomationWebAPI::GetTokens()
     try
     {
         WebAPI webAPI(baseURL);
-        webAPI.AuthenticatedGET("/api/token","",token);
+        webAPI.AuthenticatedGET("/api/token","",Token());
     }
     catch(WebAPIException& e)
     {
@@ -69,7 +80,7 @@ void HomeAutomationWebAPI::AddDevice(int UnitNum,const std::string &description,
 		"\",\"DeviceDate\":\"" << (long)seconds_past_epoch <<
 		"\"}";
 
-	AuthenticatedPOST("/api/devices","",urlString.str(),token);
+	AuthenticatedPOST("/api/devices","",urlString.str(),Token());
 }
 
 void HomeAutomationWebAPI::AddEvent(int UnitNum,char eventCodeType,char eventCode,long seconds_past_epoch)
@@ -81,7 +92,7 @@ void HomeAutomationWebAPI::AddEvent(int UnitNum,char eventCodeType,char eventCod
     	"\",\"DeviceDate\":\"" << (long)seconds_past_epoch << 
     	"\"}";
 
-    AuthenticatedPOST("/api/events","",urlString.str(),token);
+    AuthenticatedPOST("/api/events","",urlString.str(),Token());
 }
 
 void HomeAutomationWebAPI::AddState(int UnitNum,float vcc,float temperature,char presence,long seconds_past_epoch)
@@ -94,7 +105,7 @@ void HomeAutomationWebAPI::AddState(int UnitNum,float vcc,float temperature,char
     	"\",\"DeviceDate\":\"" << (long)seconds_past_epoch << 
     	"\"}";
 
-    AuthenticatedPOST("/api/states","",urlString.str(),token);
+    AuthenticatedPOST("/api/states","",urlString.str(),Token());
 }
 
 void HomeAutomationWebAPI::AddWeather(int unitNum,float temperature,float humidity,int windSpeed,int windDirection,long seconds_past_epoch)
@@ -108,7 +119,7 @@ void HomeAutomationWebAPI::AddWeather(int unitNum,float temperature,float humidi
     	"\",\"ReadingDate\":\"" << (long)seconds_past_epoch << 
     	"\"}";
 
-    AuthenticatedPOST("/api/weather","",urlString.str(),token);
+    AuthenticatedPOST("/api/weather","",urlString.str(),Token());
 }
 
 void HomeAutomationWebAPI::SendAlarm(int UnitNum, char alarmType, char alarmCode)
@@ -119,7 +130,7 @@ void HomeAutomationWebAPI::SendAlarm(int UnitNum, char alarmType, char alarmCode
 		"\",\"AlarmCode\":\"" << alarmCode <<
 		"\"}";
 
-	AuthenticatedPOST("/api/alarms", "", urlString.str(), token);
+	AuthenticatedPOST("/api/alarms", "", urlString.str(), Token());
 }
 
 //
@@ -128,6 +139,12 @@ void HomeAutomationWebAPI::SendAlarm(int UnitNum, char alarmType, char alarmCode
 
 void HomeAutomationWebAPI::AuthenticatedPOST(const std::string &controller,const std::string &api,const std::string &postdata,const std::string &token)
 {
+    if(uploader != NULL)
+    {
+        QueuePOST(controller+api,postdata,0);
+        return;
+    }
+
 	try
     {
         WebAPI webAPI(baseURL);
@@ -145,9 +162,9 @@ void HomeAutomationWebAPI::AuthenticatedPOST(const std::string &controller,const
 
             try
             {
-                //Try our request again
+                //Try our request again, with the new token
                 WebAPI webAPI(baseURL);
-                webAPI.AuthenticatedPOST(controller,api,postdata,token);
+                webAPI.AuthenticatedPOST(controller,api,postdata,Token());
             }
             catch(WebAPIException& e)
             {
@@ -162,6 +179,95 @@ void HomeAutomationWebAPI::AuthenticatedPOST(const std::string &controller,const
     }
 }
 
+void HomeAutomationWebAPI::SetUploadWorker(UploadWorker *worker)
+{
+    if(authThread.joinable())
+        authThread.join();
+    uploader=worker;
+}
+
+std::string HomeAutomationWebAPI::Token()
+{
+    std::lock_guard<std::mutex> guard(tokenLock);
+    return token;
+}
+
+//
+// Async version of AuthenticatedPOST: same single re-authenticate and retry
+// on 401 or timeout.  The completion callback runs on the upload worker, so
+// it only hands the POST over; one re-authentication at a time runs on
+// authThread and requeues everything that failed while it was out.
+//
+
+void HomeAutomationWebAPI::QueuePOST(const std::string &controller,const std::string &postdata,int attempt)
+{
+    UploadRequest request;
+    request.url=baseURL+controller;
+    request.postData=postdata;
+    request.isPost=true;
+    request.token=Token();
+    request.attempt=attempt;
+    request.label=controller;
+    request.onDone=[this,controller](const UploadRequest &req,const UploadResult &result)
+    {
+        OnQueuedPOSTDone(controller,req,result);
+    };
+    uploader->Enqueue(request);
+}
+
+void HomeAutomationWebAPI::OnQueuedPOSTDone(const std::string &controller,const UploadRequest &request,const UploadResult &result)
+{
+    if(result.ok)
+        return;
+
+    //if http error code 401 and type is http (1) or timeout
+    if(request.attempt==0 && ((result.type == 1 && result.errCode==401) || (result.type==0 && result.errCode==CURLE_OPERATION_TIMEDOUT)))
+    {
+        std::unique_lock<std::mutex> guard(tokenLock);
+        if(!authInFlight && request.token!=token)
+        {
+            //Someone already re-authenticated since this was sent
+            guard.unlock();
+            QueuePOST(controller,request.postData,1);
+            return;
+        }
+
+        AwaitingPOST post;
+        post.controller=controller;
+        post.postdata=request.postData;
+        awaitingToken.push_back(post);
+        if(authInFlight)
+            return;
+
+        LogErrorLine()  << "ERROR: " << result.errCode << " About to authenticate again\n";
+        authInFlight=true;
+        guard.unlock();
+
+        //The last one is done (authInFlight was clear), so this won't wait long
+        if(authThread.joinable())
+            authThread.join();
+        authThread=std::thread(&HomeAutomationWebAPI::ReauthenticateQueued,this);
+    }
+    else
+    {
+        LogErrorLine()  << "Upload to " << controller << " failed - ERROR: " << result.errCode;
+    }
+}
+
+void HomeAutomationWebAPI::ReauthenticateQueued()
+{
+    Authenticate();
+
+    std::vector<AwaitingPOST> posts;
+    {
+        std::lock_guard<std::mutex> guard(tokenLock);
+        posts.swap(awaitingToken);
+        authInFlight=false;
+    }
+    for(size_t i=0;i<posts.size();i++)
+        QueuePOST(posts[i].controller,posts[i].postdata,1);
+}
+
 std::string HomeAutomationWebAPI::ParseToken(const std::string &webResponse)
 {
     if(webResponse.length()<5)
@@ -1,9 +1,16 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "WebAPI.h"
+#include "UploadWorker.h"
 
 class HomeAutomationWebAPI 
 {
 public:
     HomeAutomationWebAPI();
+    ~HomeAutomationWebAPI();
     bool Authenticate(const std::string &pat); 
     void GetTokens(); 
     void AddDevice(int UnitNum,const std::string &description,long seconds_past_epoch);
@@ -12,10 +19,19 @@ public:
     void AddWeather(int unitNum,float temperature,float humidity,int windSpeed,int windDirection,long seconds_past_epoch);
     void SendAlarm(int UnitNum,char alarmType,char alarmCode);
 
+    //! Send Add*/SendAlarm posts through this worker instead of blocking the caller.
+    //! NULL (once the worker is stopped) goes back to blocking posts, after
+    //! any re-authentication in flight has finished.
+    void SetUploadWorker(UploadWorker *worker);
+
 private:
     std::string ParseToken(const std::string &webResponse);
     bool Authenticate();
     void AuthenticatedPOST(const std::string &controller,const std::string &api,const std::string &postdata,const std::string &token);
+    void QueuePOST(const std::string &controller,const std::string &postdata,int attempt);
+    void OnQueuedPOSTDone(const std::string &controller,const UploadRequest &request,const UploadResult &result);
+    void ReauthenticateQueued();
+    std::string Token();
 
     //State
     bool authenticatedFlag;  //this will be set after getting a token
@@ -24,4 +40,18 @@ private:
     std::string token;     //access token - used for authorization 
     std::string baseURL;
     std::string pat;
+
+    //Async uploads.  A 401 on the worker starts one re-authentication on
+    //authThread; POSTs that fail meanwhile wait in awaitingToken and are
+    //requeued with the new token.  tokenLock guards token and those.
+    struct AwaitingPOST
+    {
+        std::string controller;
+        std::string postdata;
+    };
+    UploadWorker *uploader;
+    std::mutex tokenLock;
+    bool authInFlight;
+    std::vector<AwaitingPOST> awaitingToken;
+    std::thread authThread;
 };
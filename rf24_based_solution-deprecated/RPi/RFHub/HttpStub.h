@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+//
+// Minimal HTTP/1.1 keep-alive stub: one thread per connection, answers every
+// request with 200 after delayMs
+//
+class HttpStub
+{
+public:
+    std::atomic<long> connections;
+    std::atomic<long> requests;
+    int delayMs;
+    int port;
+
+    HttpStub(int _delayMs) : connections(0), requests(0), delayMs(_delayMs)
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0)
+        {
+            perror("stub bind/listen");
+            exit(1);
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, (sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+        std::thread(&HttpStub::Accept, this).detach();
+    }
+
+private:
+    int listenFd;
+
+    void Accept()
+    {
+        while (true)
+        {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0)
+                continue;
+            connections++;
+            std::thread(&HttpStub::Serve, this, fd).detach();
+        }
+    }
+
+    void Serve(int fd)
+    {
+        std::string buffer;
+        char chunk[4096];
+        while (true)
+        {
+            size_t headerEnd;
+            while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                ssize_t n = read(fd, chunk, sizeof(chunk));
+                if (n <= 0)
+                {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+            size_t bodyLen = 0;
+            size_t cl = buffer.find("Content-Length: ");
+            if (cl != std::string::npos && cl < headerEnd)
+                bodyLen = strtoul(buffer.c_str() + cl + 16, NULL, 10);
+            while (buffer.size() < headerEnd + 4 + bodyLen)
+            {
+                ssize_t n = read(fd, chunk, sizeof(chunk));
+                if (n <= 0)
+                {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+            buffer.erase(0, headerEnd + 4 + bodyLen);
+
+            requests++;
+            if (delayMs > 0)
+                usleep(delayMs * 1000);
+            const char *reply = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nOK";
+            if (write(fd, reply, strlen(reply)) < 0)
+            {
+                close(fd);
+                return;
+            }
+        }
+    }
+};
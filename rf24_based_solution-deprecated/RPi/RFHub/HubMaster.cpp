@@ -14,13 +14,21 @@
 #include "EpochAccumulator.h"
 #include "Logger.h"
 #include "HomeAutomationWebAPI.h"
+#include "UploadWorker.h"
+#include "GpioEdge.h"
+#include "RadioReceiver.h"
+#include "LogWriter.h"
+#include "PacketCapture.h"
 
 void SigHandler(int s);
-void ReadDeviceData();
+void StopHandler(int s);
+void HandlePacket(uint8_t pipe, const uint8_t *payload, int len);
+void LogCarrier();
 void BuildAndSendPower();
 void BuildAndSendEvent();
 void BuildAndSendAlarm();
 void BuildAndSendState();
+void BuildAndSendBatch();
 void BuildAndSendWeather();
 void BuildAndSendContext();
 void TimeStamp(FILE *file);
@@ -31,6 +39,10 @@ void FlushFileHandles();
 // Setup for GPIO 15 CE and CE0 CSN with SPI Speed @ 8Mhz
 RF24 radio(RPI_V2_GPIO_P1_15, RPI_V2_GPIO_P1_24, BCM2835_SPI_SPEED_8MHZ);
 
+// nRF24 IRQ on GPIO 24 (BCM numbering, header pin 18).  -1 = not wired, poll instead
+#define RADIO_IRQ_GPIO 24
+GpioEdge radioIrq;
+
 // First pipe is for writing, 2nd, 3rd, 4th, 5th & 6th is for reading...
 const uint64_t pipes[6] = { 0xF0F0F0F0D2LL, 0xF0F0F0F0E1LL, 
                             0xF0F0F0F0E2LL, 0xF0F0F0F0E3LL, 
@@ -42,12 +54,27 @@ const uint64_t pipes[6] = { 0xF0F0F0F0D2LL, 0xF0F0F0F0E1LL,
 // Payload size - 32 is the default.  Must be the same on transmitter
 const uint8_t MAX_PAYLOAD_SIZE = 64;  
 const uint8_t MAX_POSTDATA_SIZE = 128+1; 
+// Link quality in MicroRFv3x context packets (LinkAdapt.h)
+const uint8_t LINK_CONTEXT_MARKER = 'L';
+const uint8_t LINK_CONTEXT_VERSION = 1;
 uint8_t pipeNo;
 int lastPayloadLen;
 uint8_t bytesRecv[MAX_PAYLOAD_SIZE+1];
 
 FILE *logFile;
 FILE *rfFile;
+
+//Logs are buffered in memory and written, rotated and gzipped by a
+//background thread (1MB or a day per file, 7 kept)
+LogWriter hubLog("/home/pi/code/rfHub/HubMasterLog.txt");
+LogWriter rfLog("/home/pi/code/rfHub/RFLog.txt");
+LogWriter stderrLog("/home/pi/code/rfHub/HubMasterStderr.txt");
+LogWriter stdoutLog("/home/pi/code/rfHub/HubMasterStdout.txt");
+
+//Optional record of every payload (-c file), for replaying in RadioBench
+PacketCapture *capture = NULL;
+
+volatile sig_atomic_t stopRequested = 0;
 time_t rawtime;
 struct tm * timeinfo;
 struct rusage memInfo;
@@ -55,22 +82,36 @@ struct rusage memInfo;
 //Automation API
 HomeAutomationWebAPI api;
 
-//Accumulators
+//Uploads run here, off the radio loop (64 queued, 4 in flight)
+UploadWorker uploader(64, 4);
+
+//Accumulators: per-sample for the hour, minute buckets for the day
 EpochAccumulator lastHourRain;
-EpochAccumulator todayRain;
+EpochAccumulator todayRain(60);
 
-int main()
+int main(int argc, char **argv)
 {
     //Ignore sig pipe errors.  There's a bug in curl...
     signal(SIGPIPE, SigHandler);
 
-    //Instanciate accumulators
-    lastHourRain=EpochAccumulator();
-    todayRain=EpochAccumulator();
+    //Stop cleanly so buffered logs reach the disk
+    signal(SIGTERM, StopHandler);
+    signal(SIGINT, StopHandler);
 
-    //Instanciate API object
+    int opt;
+    while((opt = getopt(argc, argv, "c:")) != -1)
+    {
+        if(opt == 'c')
+            capture = new PacketCapture(optarg);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-c capture-file]\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    //API object is a global (it owns a mutex, so it isn't reassigned)
     LogLine() << "Starting Instance";
-    api=HomeAutomationWebAPI();
 
     bool authenticatedFlag=false;
     int failCounter=0;
@@ -95,11 +136,15 @@ int main()
         }
     }
 
-    //open file for logging
-    logFile = fopen("/home/pi/code/rfHub/HubMasterLog.txt", "w");
-    rfFile = fopen("/home/pi/code/rfHub/RFLog.txt", "w");
-    freopen ("/home/pi/code/rfHub/HubMasterStderr.txt","w",stderr);
-    freopen ("/home/pi/code/rfHub/HubMasterStdout.txt","w",stdout);
+    //From here on, posts are queued to the worker thread
+    uploader.Start();
+    api.SetUploadWorker(&uploader);
+
+    //open file for logging; stdout/stderr (LogLine, curl) are piped to the log thread
+    logFile = hubLog.Stream();
+    rfFile = rfLog.Stream();
+    stderrLog.Capture(STDERR_FILENO);
+    stdoutLog.Capture(STDOUT_FILENO);
 
     //tag log files
     time(&rawtime);
@@ -116,6 +161,7 @@ int main()
     radio.enableAckPayload();               // Allow optional ack payloads
     radio.setRetries(15,15);                // Smallest time between retries, max no. of retries
     radio.enableDynamicPayloads();          // Read size off chip
+    radio.maskIRQ(1,1,0);                   // IRQ on received payloads only, not on sent ack payloads
     radio.printDetails();                   // Dump the configuration of the rf unit for debugging
 
     // Open 6 pipes for readings ( 5 plus pipe0, also can be used for reading )
@@ -132,55 +178,26 @@ int main()
     //Flush logs
     FlushFileHandles();
 
-    //Loop, checking for radio packets
-    while(1)
+    //Wake on the IRQ line; fall back to polling if it can't be set up
+    if(!radioIrq.Open(RADIO_IRQ_GPIO))
+        LogErrorLine() << "Radio IRQ unavailable, polling every " << RadioReceiver::POLL_MS << "ms";
+    RadioReceiver receiver(radio, radioIrq, HandlePacket, LogCarrier);
+
+    //Loop, draining radio packets as they arrive
+    while(!stopRequested)
     {
-      //Check if something's on the radio
-      if(radio.available(&pipeNo))
-      {  
-        //read data from the pipe
-        ReadDeviceData();
-
-        //Based on pipe, build and post data
-        switch(pipeNo)
-        { 
-        case 1: //Power
-            //buildPowerAPICall();
-            //callSecureWebAPI(url, authHeader);
-            break;
-        case 2: //Motion
-            BuildAndSendEvent();
-            break;
-        case 3: //Alarm
-            BuildAndSendAlarm();
-            break;
-        case 4: //state protocol
-            if(bytesRecv[1]=='S')
-                BuildAndSendState();
-            if(bytesRecv[1]=='W')
-	        BuildAndSendWeather();
-            break;
-        case 5: //context protocol
-            BuildAndSendContext();
-            break;
-        default: //Unexpected??
-            TimeStamp(stderr);
-            fprintf(stderr, "ERROR: Unexpected pipe number: %d\n",pipeNo);
-        }        
-
-        //Flush logs
-        FlushFileHandles();
-      }
-
-      //check for carrier
-      delay(150);
-      if (radio.testCarrier())
-      {
-        fprintf(logFile,"^");
-        FlushFileHandles();
-      }
-      delay(350);
+        if(receiver.Service() > 0)
+        {
+            //Flush logs
+            FlushFileHandles();
+        }
     }
+
+    LogLine() << "Stopping";
+    uploader.Stop(false);
+    api.SetUploadWorker(NULL);
+    FlushFileHandles();
+    LogWriter::FlushAll();
     return 0;
 }
 
@@ -191,6 +208,11 @@ void SigHandler(int s)
     fflush(stderr);
 }
 
+void StopHandler(int s)
+{
+    stopRequested = 1;
+}
+
 void TimeStamp(FILE *file)
 {
     //Dump header
@@ -234,7 +256,11 @@ void FlushFileHandles()
     if(++newLineCounter > 80)
     {
        TimeStamp(logFile);
-       fprintf(logFile,"\n");
+       UploadWorker::Stats upload = uploader.GetStats();
+       fprintf(logFile,"Uploads Q:%lu D:%lu OK:%ld F:%ld Drop:%ld Max:%.1fs\n",
+               (unsigned long)upload.depth, (unsigned long)upload.inFlight, upload.completed,
+               upload.failed, upload.dropped, upload.maxSeconds);
+       fprintf(logFile,"Log dropped bytes: %ld\n", hubLog.GetStats().droppedBytes + rfLog.GetStats().droppedBytes);
 
        //timeStamp(rfFile);
        //fprintf(rfFile, "\n");
@@ -247,21 +273,49 @@ void FlushFileHandles()
     fflush(stdout); 
 }
 
-void ReadDeviceData()
+void HandlePacket(uint8_t pipe, const uint8_t *payload, int len)
 {
-   // Clear any unused ACK payloads      
-   radio.flush_tx();                                
-                  
-   //Read now
-   lastPayloadLen = radio.getDynamicPayloadSize();
-   radio.read(bytesRecv,lastPayloadLen);
-
-   //LogLine() << "receive len: " << lastPayloadLen;
-
+    if(capture)
+        capture->Append(pipe, payload, len);
+
+    pipeNo = pipe;
+    lastPayloadLen = len;
+    memcpy(bytesRecv, payload, len);
+
+    //Based on pipe, build and post data
+    switch(pipeNo)
+    { 
+    case 1: //Power
+        //buildPowerAPICall();
+        //callSecureWebAPI(url, authHeader);
+        break;
+    case 2: //Motion
+        BuildAndSendEvent();
+        break;
+    case 3: //Alarm
+        BuildAndSendAlarm();
+        break;
+    case 4: //state protocol
+        if(bytesRecv[1]=='S')
+            BuildAndSendState();
+        if(bytesRecv[1]=='W')
+            BuildAndSendWeather();
+        if(bytesRecv[1]=='B')
+            BuildAndSendBatch();
+        break;
+    case 5: //context protocol
+        BuildAndSendContext();
+        break;
+    default: //Unexpected??
+        TimeStamp(stderr);
+        fprintf(stderr, "ERROR: Unexpected pipe number: %d\n",pipeNo);
+    }        
+}
 
-   // Since this is a call-response. Respond directly with an ack payload.
-   // Ack payloads are much more efficient than switching to transmit mode to respond to a call
-   radio.writeAckPayload(pipeNo,&pipeNo,1);
+void LogCarrier()
+{
+    fprintf(logFile,"^");
+    FlushFileHandles();
 }
 
 /*
@@ -269,16 +323,29 @@ void ReadDeviceData()
 //
 //Power sensor pipe
 //
+// One packet has all 6 channels (see currentTransmitterRF24/CurrentRms.h):
+// 'A', sequence, RMS and peak centiamps per channel, then the total Wh of
+// channel (sequence % 6)
+//
 void buildPowerAPICall()
 {
     time_t seconds_past_epoch = getLocalEpoch();
-    uint8_t addr;
-    float reading;
-
-    addr = bytesRecv[0];
-    memcpy(&reading, &bytesRecv[1], 4);
-    sprintf(postData, "{'DeviceName':'Power%d','DeviceDate':'%ld','DeviceData1':'%f'}", addr, seconds_past_epoch, reading);
-    //fprintf(logFile,"Addr: %d  Reading: %f\n",addr,reading);
+    uint8_t sequence;
+    uint16_t rms, peak;
+    uint32_t wh;
+
+    if(bytesRecv[0] != 'A' || lastPayloadLen < 30)
+        return;
+    sequence = bytesRecv[1];
+    memcpy(&wh, &bytesRecv[26], 4);
+    for(int addr=0; addr<6; addr++)
+    {
+        memcpy(&rms, &bytesRecv[2+addr*2], 2);
+        memcpy(&peak, &bytesRecv[14+addr*2], 2);
+        sprintf(postData, "{'DeviceName':'Power%d','DeviceDate':'%ld','DeviceData1':'%f','DeviceData2':'%f'}", addr, seconds_past_epoch, rms/100.0, peak/100.0);
+        //callSecureWebAPI(url, authHeader);
+    }
+    //fprintf(logFile,"Channel %d: %u Wh\n",sequence%6,wh);
 
     fprintf(logFile, ".");  //Small indication for log file
     fflush(logFile);
@@ -429,6 +496,73 @@ void BuildAndSendState()
     fflush(logFile);
 }
 
+//Build post message for pipe 4
+//
+//Batched state: a sleeping node's readings from several cycles in one packet
+//(see STATE_BATCH in MicroRFv3x/LinkAdapt.h)
+//
+void BuildAndSendBatch()
+{
+    //
+    // Over-the-air packet definition/spec
+    //
+  // 1:1 byte:  unit number (uint8)
+  // 1:2 byte:  Payload type (B=batched state)
+  // 1:3 byte:  Number of retries on last send (uint8)
+  // 1:4 byte:  Number of send attempts since last successful send (uint8)
+  // 1:5 byte:  Number of readings (n)
+  // 1:6 byte:  Data Type  (a=ADC, -=none)
+  // then n readings of 8 bytes, oldest first:
+  //   1 byte:  Age in watchdog wakes (8 sec each)
+  //   2 bytes: VCC (mV, uint16)
+  //   2 bytes: Temperature (tenths, int16)
+  //   1 byte:  Presence  ('P' = present, and 'A' = absent)
+  //   2 bytes: ADC value (int16)
+    //
+    const int WAKE_SECONDS = 8;
+
+    time_t now = GetLocalEpoch();
+    int unitNum=(uint8_t)bytesRecv[0];
+    int lastRetryCount=(uint8_t)bytesRecv[2];
+    int lastGoodTransCount=(uint8_t)bytesRecv[3];
+    int count=(uint8_t)bytesRecv[4];
+    bool hasAdc=bytesRecv[5]=='a';
+
+    if(lastPayloadLen < 6 + count*8)
+    {
+        LogErrorLine() << "Short state batch from unit " << unitNum << ": " << lastPayloadLen << " bytes for " << count << " readings";
+        return;
+    }
+
+    //Record number of retries if exist
+    if(lastRetryCount > 0 || lastGoodTransCount>0)
+    {
+        TimeStamp(rfFile);
+        fprintf(rfFile, "STATE: U: %d - R: %d, A: %d\n", unitNum, lastRetryCount, lastGoodTransCount);  //Small indication for log file
+        fflush(rfFile);
+    }
+
+    for(int i=0;i<count;i++)
+    {
+        const uint8_t *reading=&bytesRecv[6+i*8];
+        uint16_t mv;
+        int16_t tenths, adcValue;
+        memcpy(&mv, &reading[1], 2);
+        memcpy(&tenths, &reading[3], 2);
+        memcpy(&adcValue, &reading[6], 2);
+
+        char presence=reading[5];
+        if(presence != 'P' && presence != 'A') 
+           presence='-';
+        if(hasAdc)
+           LogLine() << " --ADC: " << adcValue; 
+
+        api.AddState(unitNum,mv/1000.0f,tenths/10.0f,presence,now-(time_t)reading[0]*WAKE_SECONDS);
+        fprintf(logFile, "#");  //Small indication for log file
+    }
+    fflush(logFile);
+}
+
 //Build post message for pipe 4
 //
 //Weather on state pipe
@@ -497,15 +631,11 @@ void BuildAndSendWeather()
         << "&rainin=" << lastHourRain.Sum()
         << "&dailyrainin=" << todayRain.Sum();
 
-    try
-    {
-        WebAPI webAPI("http://weatherstation.wunderground.com/");
-        std::string webResponse=webAPI.PlainGET("weatherstation/updateweatherstation.php",getString.str());
-    }
-    catch(const std::exception& e)
-    {
-        LogErrorLine() << "Error uploading to Weather Underground " << e.what();
-    }    
+    //Queued; the worker logs failures
+    UploadRequest request;
+    request.url = "http://weatherstation.wunderground.com/weatherstation/updateweatherstation.php" + getString.str();
+    request.label = "wunderground";
+    uploader.Enqueue(request);
 }
 
 //Build post message for pipe 5
@@ -520,6 +650,16 @@ void BuildAndSendContext()
     // 1 byte:  unit number (uint8)
     // 1 byte:  Payload type (S=state, C=context, E=event  
     // n bytes:  description (char [])
+    // MicroRFv3x nodes end the description with a 0 and add their link quality:
+    // 1 byte:  'L' (LINK_CONTEXT_MARKER in LinkAdapt.h)
+    // 1 byte:  1 (LINK_CONTEXT_VERSION)
+    // 1 byte:  PA level (0=min .. 3=max)
+    // 1 byte:  % acked on the first write
+    // 1 byte:  sends since the last context
+    // 1 byte:  software retries since the last context
+    // 1 byte:  readings per state packet
+    // Older nodes send the description in a fixed size payload padded with
+    // 0s, so the link fields are only read after the marker and version.
     //
 
 	time_t seconds_past_epoch = GetLocalEpoch();
@@ -533,6 +673,21 @@ void BuildAndSendContext()
 		{
 				size_t len=(size_t)(lastPayloadLen-2);
 				char *buffer=(char *)(bytesRecv+2);
+				const char *end=(const char *)memchr(buffer,0,len);
+				if(end)
+				{
+					size_t descLen=(size_t)(end-buffer);
+					const uint8_t *link=(const uint8_t *)end+1;
+					if(len >= descLen+8 && link[0]==LINK_CONTEXT_MARKER && link[1]==LINK_CONTEXT_VERSION)
+					{
+						link+=2;
+						TimeStamp(rfFile);
+						fprintf(rfFile, "LINK: U: %d - PA: %d, Ack: %d%%, S: %d, R: %d, B: %d\n",
+						        (int)unitNum, link[0], link[1], link[2], link[3], link[4]);
+						fflush(rfFile);
+					}
+					len=descLen;
+				}
 				std::string description(buffer,len);
 				//LogLine() << "Adding Device: " << (int)unitNum << " - " << description;
 
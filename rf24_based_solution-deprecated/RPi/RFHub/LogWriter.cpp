@@ -0,0 +1,464 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#include "LogWriter.h"
+
+const int LogWriter::FLUSH_INTERVAL_MS;
+const size_t LogWriter::FLUSH_BYTES;
+const size_t LogWriter::MAX_BUFFERED;
+
+static long NowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+//
+// The log threads: one drains Capture() pipes into the buffers and does no
+// disk I/O, so a slow card or a gzip never backs the pipes up into
+// printf/LogLine; the other flushes every writer's buffer when it is due
+// and rotates
+//
+class LogThread
+{
+public:
+    //Never destroyed, so writers that are globals can still unregister at exit
+    static LogThread &Instance()
+    {
+        static LogThread *instance = new LogThread();
+        return *instance;
+    }
+
+    void Add(LogWriter *writer)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        writers.push_back(writer);
+        if (!running && !stopped)
+        {
+            running = true;
+            drainThread = std::thread(&LogThread::Drain, this);
+            flushThread = std::thread(&LogThread::Run, this);
+        }
+    }
+
+    void Remove(LogWriter *writer)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t i = 0; i < writers.size(); i++)
+            {
+                if (writers[i] == writer)
+                {
+                    writers.erase(writers.begin() + i);
+                    break;
+                }
+            }
+        }
+        //Wait out a drain or flush that may still have it
+        std::lock_guard<std::mutex> draining(drainLock);
+        std::lock_guard<std::mutex> flushing(flushLock);
+    }
+
+    //Flush thread: a buffer is over FLUSH_BYTES
+    void Wake()
+    {
+        Signal(wakeFd);
+    }
+
+    //Drain thread: a new pipe to poll
+    void WakeDrain()
+    {
+        Signal(drainWakeFd);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            running = false;
+            stopped = true;
+        }
+        WakeDrain();
+        Wake();
+        if (drainThread.joinable())
+            drainThread.join();
+        if (flushThread.joinable())
+            flushThread.join();
+
+        //Anything written after the threads stopped
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < writers.size(); i++)
+            writers[i]->FlushToDisk(true);
+    }
+
+private:
+    LogThread() : wakeFd(eventfd(0, EFD_NONBLOCK)), drainWakeFd(eventfd(0, EFD_NONBLOCK)), running(false), stopped(false) {}
+
+    static void Signal(int fd)
+    {
+        uint64_t one = 1;
+        ssize_t n = write(fd, &one, sizeof(one));
+        (void)n;
+    }
+
+    static void Clear(struct pollfd &p)
+    {
+        if (p.revents & POLLIN)
+        {
+            uint64_t count;
+            ssize_t n = read(p.fd, &count, sizeof(count));
+            (void)n;
+        }
+    }
+
+    void Drain()
+    {
+        std::vector<struct pollfd> fds;
+        std::vector<LogWriter *> owners;
+        std::string data;
+        char chunk[4096];
+
+        while (true)
+        {
+            fds.clear();
+            owners.clear();
+            struct pollfd wake = { drainWakeFd, POLLIN, 0 };
+            fds.push_back(wake);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (!running)
+                    break;
+                for (size_t i = 0; i < writers.size(); i++)
+                {
+                    if (writers[i]->captureFd >= 0)
+                    {
+                        struct pollfd p = { writers[i]->captureFd, POLLIN, 0 };
+                        fds.push_back(p);
+                        owners.push_back(writers[i]);
+                    }
+                }
+            }
+
+            poll(&fds[0], fds.size(), -1);
+            Clear(fds[0]);
+
+            //Skip writers removed while we polled; one removed after this
+            //waits for drainLock in Remove()
+            std::lock_guard<std::mutex> draining(drainLock);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                for (size_t i = 0; i < owners.size(); i++)
+                {
+                    if (std::find(writers.begin(), writers.end(), owners[i]) == writers.end())
+                        fds[i + 1].revents = 0;
+                }
+            }
+
+            //Empty the pipes so writers never block on them, reading with
+            //no lock held.  Write() only takes the writer's lock to append
+            //(or drop and count when it's full).  A flooded pipe gives up
+            //DRAIN_BYTES a pass so it can't starve the others; poll() comes
+            //straight back for the rest.
+            for (size_t i = 1; i < fds.size(); i++)
+            {
+                if (fds[i].revents & POLLIN)
+                {
+                    data.clear();
+                    ssize_t n;
+                    while (data.size() < DRAIN_BYTES && (n = read(fds[i].fd, chunk, sizeof(chunk))) > 0)
+                        data.append(chunk, n);
+                    if (!data.empty())
+                        owners[i - 1]->Write(data.data(), data.size());
+                }
+            }
+        }
+    }
+
+    void Run()
+    {
+        std::vector<LogWriter *> snapshot;
+        while (true)
+        {
+            //Wake at least once a second to check the flush interval
+            struct pollfd wake = { wakeFd, POLLIN, 0 };
+            poll(&wake, 1, 1000);
+            Clear(wake);
+
+            bool stopping;
+            std::lock_guard<std::mutex> flushing(flushLock);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                snapshot = writers;
+                stopping = !running;
+            }
+            for (size_t i = 0; i < snapshot.size(); i++)
+                snapshot[i]->FlushToDisk(stopping);
+            if (stopping)
+                break;
+        }
+    }
+
+    static const size_t DRAIN_BYTES = 64 * 1024;
+
+    std::mutex lock;        //guards writers, running; never held over disk or pipe I/O
+    std::mutex drainLock;   //held by the drain thread while it reads into writers
+    std::mutex flushLock;   //held by the flush thread while it flushes
+    std::vector<LogWriter *> writers;
+    int wakeFd;
+    int drainWakeFd;
+    bool running;
+    bool stopped;
+    std::thread drainThread;
+    std::thread flushThread;
+};
+
+static ssize_t CookieWrite(void *cookie, const char *buf, size_t size)
+{
+    static_cast<LogWriter *>(cookie)->Write(buf, size);
+    return size;
+}
+
+static bool GzipFile(const std::string &from, const std::string &to)
+{
+    FILE *in = fopen(from.c_str(), "rb");
+    if (in == NULL)
+        return false;
+    gzFile out = gzopen(to.c_str(), "wb6");
+    if (out == NULL)
+    {
+        fclose(in);
+        return false;
+    }
+
+    char chunk[16384];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+        ok = gzwrite(out, chunk, n) == (int)n;
+    fclose(in);
+    return gzclose(out) == Z_OK && ok;
+}
+
+LogWriter::LogWriter(const std::string &_path, size_t _maxBytes, long _maxAgeSeconds, int _keep, bool _binary)
+{
+    path = _path;
+    maxBytes = _maxBytes;
+    maxAgeSeconds = _maxAgeSeconds;
+    keep = _keep;
+    binary = _binary;
+    droppedSinceFlush = 0;
+    stats = Stats();
+    fd = -1;
+    fileBytes = 0;
+    openedAt = 0;
+    lastFlushMs = NowMs();
+    stream = NULL;
+    captureFd = -1;
+
+    LogThread::Instance().Add(this);
+}
+
+LogWriter::~LogWriter()
+{
+    if (stream)
+        fclose(stream);
+    LogThread::Instance().Remove(this);
+    FlushToDisk(true);
+    if (fd >= 0)
+        close(fd);
+    if (captureFd >= 0)
+        close(captureFd);
+}
+
+void LogWriter::SetHeader(const std::string &_header)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    header = _header;
+}
+
+void LogWriter::Write(const void *data, size_t len)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (buffer.size() + len > MAX_BUFFERED)
+        {
+            droppedSinceFlush += len;
+            stats.droppedBytes += len;
+        }
+        else
+        {
+            //Only the write that crosses the threshold wakes the thread
+            wake = buffer.size() < FLUSH_BYTES && buffer.size() + len >= FLUSH_BYTES;
+            buffer.append(static_cast<const char *>(data), len);
+        }
+    }
+    if (wake)
+        LogThread::Instance().Wake();
+}
+
+FILE *LogWriter::Stream()
+{
+    if (stream == NULL)
+    {
+        cookie_io_functions_t functions;
+        memset(&functions, 0, sizeof(functions));
+        functions.write = CookieWrite;
+        stream = fopencookie(this, "w", functions);
+    }
+    return stream;
+}
+
+bool LogWriter::Capture(int target)
+{
+    int ends[2];
+    if (pipe(ends) != 0)
+        return false;
+    if (dup2(ends[1], target) < 0)
+    {
+        close(ends[0]);
+        close(ends[1]);
+        return false;
+    }
+    close(ends[1]);
+    fcntl(ends[0], F_SETFL, O_NONBLOCK);
+    fcntl(ends[0], F_SETFD, FD_CLOEXEC);
+    captureFd = ends[0];
+
+    //Have the drain thread start polling the new pipe
+    LogThread::Instance().WakeDrain();
+    return true;
+}
+
+LogWriter::Stats LogWriter::GetStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Stats copy = stats;
+    copy.buffered = buffer.size();
+    return copy;
+}
+
+void LogWriter::FlushAll()
+{
+    LogThread::Instance().Stop();
+}
+
+void LogWriter::FlushToDisk(bool force)
+{
+    long now = NowMs();
+    std::string out;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!force && buffer.size() < FLUSH_BYTES && now - lastFlushMs < FLUSH_INTERVAL_MS)
+            return;
+        lastFlushMs = now;
+        if (buffer.empty() && droppedSinceFlush == 0)
+            return;
+
+        if (droppedSinceFlush > 0 && !binary)
+        {
+            char note[80];
+            snprintf(note, sizeof(note), "\n[log buffer full, %lu bytes dropped]\n", (unsigned long)droppedSinceFlush);
+            buffer.append(note);
+        }
+        droppedSinceFlush = 0;
+        out.swap(buffer);
+        stats.flushes++;
+    }
+
+    if (fd < 0 && !OpenFile())
+    {
+        //Nowhere to put it; count it like a full buffer
+        Dropped(out.size());
+        return;
+    }
+
+    const char *p = out.data();
+    size_t left = out.size();
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        p += n;
+        left -= n;
+        fileBytes += n;
+    }
+    if (left > 0)
+        Dropped(left);
+
+    if (fileBytes >= maxBytes || time(NULL) - openedAt >= maxAgeSeconds)
+        Rotate();
+}
+
+void LogWriter::Dropped(size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    droppedSinceFlush += bytes;
+    stats.droppedBytes += bytes;
+}
+
+bool LogWriter::OpenFile()
+{
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    fileBytes = fstat(fd, &st) == 0 ? st.st_size : 0;
+    openedAt = time(NULL);
+
+    std::string top;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        top = header;
+    }
+    if (fileBytes == 0 && !top.empty() && write(fd, top.data(), top.size()) == (ssize_t)top.size())
+        fileBytes += top.size();
+    return true;
+}
+
+void LogWriter::Rotate()
+{
+    close(fd);
+    fd = -1;
+
+    if (keep <= 0)
+    {
+        unlink(path.c_str());
+    }
+    else
+    {
+        //path.N-1.gz -> path.N.gz ... path.1.gz -> path.2.gz, oldest falls off
+        char from[16], to[16];
+        for (int i = keep - 1; i >= 1; i--)
+        {
+            snprintf(from, sizeof(from), ".%d.gz", i);
+            snprintf(to, sizeof(to), ".%d.gz", i + 1);
+            rename((path + from).c_str(), (path + to).c_str());
+        }
+
+        std::string rotated = path + ".1";
+        rename(path.c_str(), rotated.c_str());
+        if (GzipFile(rotated, rotated + ".gz"))
+            unlink(rotated.c_str());
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    stats.rotations++;
+}
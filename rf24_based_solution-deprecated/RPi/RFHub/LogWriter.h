@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <mutex>
+
+//
+// Buffered, rotating log file written from a background thread.
+//
+// Writers only append to an in-memory buffer; one shared log thread moves
+// every buffer to disk every FLUSH_INTERVAL_MS, or sooner once
+// FLUSH_BYTES are waiting, so the SD card sees a few large writes instead
+// of one per packet.  Capture() pipes are drained by a second thread that
+// does no disk I/O, so stdout/stderr never fill up behind a rotation. A file is rotated once it reaches maxBytes or is
+// maxAgeSeconds old: it becomes path.1.gz (gzip) and older ones shift up,
+// keeping `keep` of them.
+//
+// The buffer is bounded (MAX_BUFFERED); if the disk stalls, new data is
+// dropped and counted rather than blocking the radio loop.  So is a flush
+// that can't open or finish writing the file.
+//
+class LogWriter
+{
+public:
+    static const int FLUSH_INTERVAL_MS = 5000;
+    static const size_t FLUSH_BYTES = 16 * 1024;
+    static const size_t MAX_BUFFERED = 256 * 1024;
+
+    //! binary: no "bytes dropped" markers are written into the file
+    LogWriter(const std::string &path, size_t maxBytes = 1024 * 1024, long maxAgeSeconds = 86400,
+              int keep = 7, bool binary = false);
+    ~LogWriter();
+
+    //! Written at the start of every new file (e.g. a capture file magic)
+    void SetHeader(const std::string &header);
+
+    void Write(const void *data, size_t len);
+
+    //! stdio handle that writes into this log; fflush() on it is cheap
+    FILE *Stream();
+
+    //! Send everything written to fd (1=stdout, 2=stderr) into this log
+    bool Capture(int fd);
+
+    struct Stats
+    {
+        long flushes;
+        long rotations;
+        long droppedBytes;
+        size_t buffered;
+    };
+    Stats GetStats();
+
+    //! Write every log's buffer to disk now and stop the log thread
+    static void FlushAll();
+
+private:
+    LogWriter(const LogWriter &);
+    friend class LogThread;
+
+    //Log thread only
+    void FlushToDisk(bool force);
+    bool OpenFile();
+    void Rotate();
+    void Dropped(size_t bytes);
+
+    std::string path;
+    size_t maxBytes;
+    long maxAgeSeconds;
+    int keep;
+    bool binary;
+    std::string header;
+
+    std::mutex lock;        //guards buffer, dropped, stats
+    std::string buffer;
+    size_t droppedSinceFlush;
+    Stats stats;
+
+    int fd;
+    size_t fileBytes;
+    time_t openedAt;
+    long lastFlushMs;
+    FILE *stream;
+    int captureFd;          //read end of a Capture() pipe, -1 if none
+};
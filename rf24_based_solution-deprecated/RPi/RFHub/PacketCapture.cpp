@@ -0,0 +1,85 @@
+#include <string.h>
+#include <sys/time.h>
+
+#include "PacketCapture.h"
+
+static void PutU32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t GetU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+//Captures are small; rotate at 4MB and keep the last 10
+PacketCapture::PacketCapture(const std::string &path)
+    : writer(path, 4 * 1024 * 1024, 7 * 86400, 10, true)
+{
+    writer.SetHeader(CAPTURE_MAGIC);
+}
+
+void PacketCapture::Append(uint8_t pipe, const uint8_t *payload, int len)
+{
+    if (len < 0)
+        len = 0;
+    if (len > 32)
+        len = 32;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    //One Write per record, so a flush or rotation never splits one
+    uint8_t record[10 + 32];
+    PutU32(&record[0], (uint32_t)now.tv_sec);
+    PutU32(&record[4], (uint32_t)now.tv_usec);
+    record[8] = pipe;
+    record[9] = (uint8_t)len;
+    memcpy(&record[10], payload, len);
+    writer.Write(record, 10 + len);
+}
+
+CaptureReader::CaptureReader()
+{
+    file = NULL;
+}
+
+CaptureReader::~CaptureReader()
+{
+    if (file)
+        gzclose(file);
+}
+
+bool CaptureReader::Open(const std::string &path)
+{
+    file = gzopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[sizeof(CAPTURE_MAGIC) - 1];
+    if (gzread(file, magic, sizeof(magic)) != (int)sizeof(magic) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+    {
+        gzclose(file);
+        file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool CaptureReader::Next(CaptureRecord &record)
+{
+    if (file == NULL)
+        return false;
+
+    uint8_t head[10];
+    if (gzread(file, head, sizeof(head)) != (int)sizeof(head))
+        return false;
+    record.at = GetU32(&head[0]) + GetU32(&head[4]) / 1e6;
+    record.pipe = head[8];
+    record.len = head[9] > 32 ? 32 : head[9];
+    return gzread(file, record.payload, record.len) == (int)record.len;
+}
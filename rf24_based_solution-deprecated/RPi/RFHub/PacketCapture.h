@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <zlib.h>
+
+#include "LogWriter.h"
+
+//
+// Binary record of every radio payload the hub handles, for replaying
+// real traffic through RadioBench.
+//
+// Each file starts with CAPTURE_MAGIC, then one record per payload, all
+// little-endian:
+//   uint32 seconds, uint32 microseconds (wall clock), uint8 pipe,
+//   uint8 length, length bytes of payload
+// Files go through a LogWriter, so they are buffered, rotated and gzipped
+// like the text logs; the reader takes plain or .gz files.
+//
+#define CAPTURE_MAGIC "RFCAP1\n"
+
+struct CaptureRecord
+{
+    double at;          //seconds since the epoch
+    uint8_t pipe;
+    uint8_t len;
+    uint8_t payload[32];
+};
+
+class PacketCapture
+{
+public:
+    PacketCapture(const std::string &path);
+    void Append(uint8_t pipe, const uint8_t *payload, int len);
+    LogWriter::Stats GetStats() { return writer.GetStats(); }
+
+private:
+    LogWriter writer;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    //! False if the file is missing or not a capture
+    bool Open(const std::string &path);
+    //! False at end of file or on a truncated record
+    bool Next(CaptureRecord &record);
+
+private:
+    CaptureReader(const CaptureReader &);
+
+    gzFile file;
+};
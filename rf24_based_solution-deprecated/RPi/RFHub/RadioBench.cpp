@@ -0,0 +1,341 @@
+//
+// Radio loop benchmark against a fake RF24 (runs on any Linux box).
+//
+// A traffic thread plays sensors: bursts of 1-3 event packets at random
+// times, each retried like the real nodes (setRetries(15,15): 15 more tries
+// 4ms apart) while the hub's 3-deep RX FIFO is full. The hub side runs one
+// of three receive loops and queues every packet to a local HTTP stub
+// through UploadWorker, as HubMaster does:
+//
+//   legacy  - available(), delay(150), testCarrier(), delay(350)
+//   poll    - RadioReceiver without an IRQ line (FIFO polled every 5ms)
+//   irq     - RadioReceiver sleeping on the IRQ line (an eventfd here)
+//
+// Build and run:
+//   make -f Makefile.test RadioBench CCFLAGS="-O2 -std=c++11"
+//   ./RadioBench [seconds] [bursts-per-second] [server-delay-ms]
+//   ./RadioBench -r capture-file [server-delay-ms]
+//
+// With -r the traffic is a HubMaster capture (-c) replayed with its own
+// timing and pipes; idle gaps longer than MAX_REPLAY_GAP are shortened.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+#include "GpioEdge.h"
+#include "RadioReceiver.h"
+#include "UploadWorker.h"
+#include "HttpStub.h"
+#include "PacketCapture.h"
+
+#define MAX_REPLAY_GAP 2.0
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double ThreadCpu()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Traffic
+{
+    std::vector<double> burstAt;    //seconds from start
+    std::vector<int> burstSize;
+    std::vector<uint8_t> pipe;                  //per packet
+    std::vector<std::vector<uint8_t> > payload; //per packet, empty = synthetic
+    int packets;
+};
+
+//Same schedule for every mode: Poisson bursts of 1-3 packets
+static Traffic MakeTraffic(double seconds, double rate)
+{
+    Traffic t;
+    t.packets = 0;
+    srand(1);
+    double at = 0;
+    while (true)
+    {
+        at += -log(1.0 - rand() / (RAND_MAX + 1.0)) / rate;
+        if (at >= seconds)
+            break;
+        t.burstAt.push_back(at);
+        t.burstSize.push_back(1 + rand() % 3);
+        for (int p = 0; p < t.burstSize.back(); p++)
+        {
+            t.pipe.push_back(2);
+            t.payload.push_back(std::vector<uint8_t>());
+        }
+        t.packets += t.burstSize.back();
+    }
+    return t;
+}
+
+//Captured packets, each its own burst
+static bool LoadTraffic(const char *path, Traffic &t)
+{
+    CaptureReader reader;
+    if (!reader.Open(path))
+        return false;
+
+    t.packets = 0;
+    CaptureRecord record;
+    double last = 0, at = 0;
+    while (reader.Next(record))
+    {
+        if (t.packets == 0)
+            last = record.at;
+        double gap = record.at - last;
+        at += gap > MAX_REPLAY_GAP ? MAX_REPLAY_GAP : (gap < 0 ? 0 : gap);
+        last = record.at;
+
+        t.burstAt.push_back(at);
+        t.burstSize.push_back(1);
+        t.pipe.push_back(record.pipe);
+        t.payload.push_back(std::vector<uint8_t>(record.payload, record.payload + record.len));
+        t.packets++;
+    }
+    return t.packets > 0;
+}
+
+struct RunResult
+{
+    int handled;
+    long lost;
+    double meanReadMs, p95ReadMs, maxReadMs;
+    double meanPostMs, maxPostMs;
+    double loopCpuMs;
+};
+
+static double Percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static double Mean(const std::vector<double> &v)
+{
+    double sum = 0;
+    for (size_t i = 0; i < v.size(); i++)
+        sum += v[i];
+    return v.empty() ? 0 : sum / v.size();
+}
+
+// mode: 0 legacy, 1 poll, 2 irq
+static RunResult Run(int mode, const Traffic &traffic, HttpStub &stub)
+{
+    RF24 radio(RPI_V2_GPIO_P1_15, RPI_V2_GPIO_P1_24, BCM2835_SPI_SPEED_8MHZ);
+    radio.maskIRQ(1, 1, 0);
+    radio.startListening();
+
+    GpioEdge irq;
+    if (mode == 2)
+        irq.Attach(radio.IrqFd(), POLLIN);
+
+    UploadWorker worker(64, 4);
+    worker.Start();
+    std::ostringstream url;
+    url << "http://127.0.0.1:" << stub.port << "/api/events";
+
+    std::mutex resultLock;
+    std::condition_variable doneCv;
+    std::vector<double> sentAt(traffic.packets, 0);
+    std::vector<double> readMs, postMs;
+    int posted = 0;
+    long lost = 0;
+    bool trafficDone = false;
+
+    //Sensors
+    double start = Now();
+    std::thread sensors([&]
+    {
+        int seq = 0;
+        for (size_t b = 0; b < traffic.burstAt.size(); b++)
+        {
+            double wait = start + traffic.burstAt[b] - Now();
+            if (wait > 0)
+                usleep((useconds_t)(wait * 1e6));
+            for (int p = 0; p < traffic.burstSize[b]; p++, seq++)
+            {
+                // unit, 'E', retries, attempts, eventCodeType, eventCode, seq
+                uint8_t payload[32] = { (uint8_t)(seq % 12), 'E', 0, 0, 0, 0, 'O', 'D' };
+                uint8_t len = 12;
+                if (!traffic.payload[seq].empty())
+                {
+                    len = traffic.payload[seq].size() < 12 ? 12 : traffic.payload[seq].size();
+                    memcpy(payload, &traffic.payload[seq][0], traffic.payload[seq].size());
+                }
+                //Bytes 8-11 carry the sequence number for the latency figures
+                memcpy(&payload[8], &seq, 4);
+                {
+                    std::lock_guard<std::mutex> guard(resultLock);
+                    sentAt[seq] = Now();
+                }
+                bool sent = false;
+                for (int attempt = 0; attempt < 16 && !sent; attempt++)
+                {
+                    sent = radio.Inject(traffic.pipe[seq], payload, len);
+                    if (!sent)
+                        usleep(4000);
+                }
+                if (!sent)
+                {
+                    std::lock_guard<std::mutex> guard(resultLock);
+                    lost++;
+                    doneCv.notify_all();
+                }
+            }
+        }
+        std::lock_guard<std::mutex> guard(resultLock);
+        trafficDone = true;
+    });
+
+    //Hub
+    int handled = 0;
+    RadioReceiver::PacketHandler handle = [&](uint8_t, const uint8_t *payload, int)
+    {
+        int seq;
+        memcpy(&seq, &payload[8], 4);
+        double readAt = Now();
+        double sent;
+        {
+            std::lock_guard<std::mutex> guard(resultLock);
+            sent = sentAt[seq];
+            readMs.push_back((readAt - sent) * 1000);
+        }
+        handled++;
+
+        UploadRequest request;
+        request.url = url.str();
+        request.isPost = true;
+        request.postData = "{\"UnitNum\":" + std::to_string(payload[0]) + ",\"EventCodeType\":\"O\",\"EventCode\":\"D\"}";
+        request.label = "bench";
+        request.onDone = [&, sent](const UploadRequest &, const UploadResult &)
+        {
+            std::lock_guard<std::mutex> guard(resultLock);
+            postMs.push_back((Now() - sent) * 1000);
+            posted++;
+            doneCv.notify_all();
+        };
+        worker.Enqueue(request);
+    };
+
+    RadioReceiver receiver(radio, irq, handle, NULL);
+    double cpuStart = ThreadCpu();
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> guard(resultLock);
+            if (trafficDone && handled + lost == traffic.packets)
+                break;
+        }
+
+        if (mode == 0)
+        {
+            uint8_t pipeNo;
+            if (radio.available(&pipeNo))
+            {
+                uint8_t payload[33];
+                radio.flush_tx();
+                int len = radio.getDynamicPayloadSize();
+                radio.read(payload, len);
+                radio.writeAckPayload(pipeNo, &pipeNo, 1);
+                handle(pipeNo, payload, len);
+            }
+            delay(150);
+            radio.testCarrier();
+            delay(350);
+        }
+        else
+        {
+            receiver.Service();
+        }
+    }
+    double cpu = ThreadCpu() - cpuStart;
+    sensors.join();
+
+    {
+        std::unique_lock<std::mutex> guard(resultLock);
+        doneCv.wait(guard, [&] { return posted == handled; });
+    }
+    worker.Stop(true);
+
+    RunResult r;
+    r.handled = handled;
+    r.lost = lost;
+    r.meanReadMs = Mean(readMs);
+    r.p95ReadMs = Percentile(readMs, 0.95);
+    r.maxReadMs = Percentile(readMs, 1.0);
+    r.meanPostMs = Mean(postMs);
+    r.maxPostMs = Percentile(postMs, 1.0);
+    r.loopCpuMs = cpu * 1000;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    Traffic traffic;
+    double seconds;
+    int delayMs;
+    if (argc > 2 && std::string(argv[1]) == "-r")
+    {
+        if (!LoadTraffic(argv[2], traffic))
+        {
+            fprintf(stderr, "%s: not a capture file, or empty\n", argv[2]);
+            return 1;
+        }
+        seconds = traffic.burstAt.back();
+        delayMs = argc > 3 ? atoi(argv[3]) : 20;
+    }
+    else
+    {
+        seconds = argc > 1 ? atof(argv[1]) : 10;
+        double rate = argc > 2 ? atof(argv[2]) : 2;
+        delayMs = argc > 3 ? atoi(argv[3]) : 20;
+        traffic = MakeTraffic(seconds, rate);
+    }
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    HttpStub stub(delayMs);
+
+    //Keep worker log lines out of the report
+    std::stringstream sink;
+    std::streambuf *saved = std::cerr.rdbuf(sink.rdbuf());
+
+    const char *names[3] = { "legacy", "poll", "irq" };
+    RunResult results[3];
+    for (int mode = 0; mode < 3; mode++)
+        results[mode] = Run(mode, traffic, stub);
+
+    std::cerr.rdbuf(saved);
+    printf("%.0f s, %zu bursts, %d packets, server delay %d ms\n", seconds, traffic.burstAt.size(), traffic.packets, delayMs);
+    printf("%-7s %8s %6s %13s %12s %12s %14s %13s %12s\n", "loop", "handled", "lost", "pkt->read ms",
+           "p95 read ms", "max read ms", "pkt->posted ms", "max posted ms", "loop cpu ms");
+    for (int mode = 0; mode < 3; mode++)
+    {
+        RunResult &r = results[mode];
+        printf("%-7s %8d %6ld %13.1f %12.1f %12.1f %14.1f %13.1f %12.1f\n", names[mode], r.handled, r.lost,
+               r.meanReadMs, r.p95ReadMs, r.maxReadMs, r.meanPostMs, r.maxPostMs, r.loopCpuMs);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <time.h>
+
+#include "RadioReceiver.h"
+
+//Payloads are at most 32 bytes on air; keep HubMaster's buffer size
+#define MAX_PAYLOAD_SIZE 64
+
+const int RadioReceiver::POLL_MS;
+const int RadioReceiver::CARRIER_INTERVAL_MS;
+const int RadioReceiver::IRQ_TIMEOUT_MS;
+
+RadioReceiver::RadioReceiver(RF24 &_radio, GpioEdge &_irq, PacketHandler _onPacket, std::function<void()> _onCarrier)
+    : radio(_radio), irq(_irq), onPacket(_onPacket), onCarrier(_onCarrier)
+{
+    nextCarrierMs = NowMs() + CARRIER_INTERVAL_MS;
+    stats = Stats();
+}
+
+long RadioReceiver::NowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+int RadioReceiver::Service()
+{
+    long untilCarrier = nextCarrierMs - NowMs();
+    if (untilCarrier < 0)
+        untilCarrier = 0;
+
+    int timeout = irq.IsOpen() ? IRQ_TIMEOUT_MS : POLL_MS;
+    if (untilCarrier < timeout)
+        timeout = (int)untilCarrier;
+
+    bool edge = irq.Wait(timeout);
+    int handled = Drain();
+    if (edge)
+    {
+        stats.wakeups++;
+        if (handled == 0)
+            stats.emptyWakeups++;
+    }
+
+    if (NowMs() >= nextCarrierMs)
+    {
+        if (radio.testCarrier() && onCarrier)
+            onCarrier();
+        nextCarrierMs = NowMs() + CARRIER_INTERVAL_MS;
+    }
+    return handled;
+}
+
+int RadioReceiver::Drain()
+{
+    uint8_t pipeNo;
+    uint8_t payload[MAX_PAYLOAD_SIZE + 1];
+    int handled = 0;
+
+    //The IRQ only falls when RX_DR goes from clear to set, so keep reading
+    //until the FIFO (3 deep) is empty or a payload could be lost
+    while (radio.available(&pipeNo))
+    {
+        // Clear any unused ACK payloads
+        radio.flush_tx();
+
+        int len = radio.getDynamicPayloadSize();
+        if (len > MAX_PAYLOAD_SIZE)
+            len = MAX_PAYLOAD_SIZE;
+        radio.read(payload, len);
+
+        // Since this is a call-response. Respond directly with an ack payload.
+        radio.writeAckPayload(pipeNo, &pipeNo, 1);
+
+        handled++;
+        if (onPacket)
+            onPacket(pipeNo, payload, len);
+    }
+
+    stats.packets += handled;
+    if (handled > stats.maxDrain)
+        stats.maxDrain = handled;
+    return handled;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <RF24/RF24.h>
+
+#include "GpioEdge.h"
+
+//
+// Receive side of the hub's radio loop.
+//
+// Sleeps on the nRF24 IRQ line (RX_DR only; TX interrupts are masked) and,
+// when it fires, drains every payload in the RX FIFO before sleeping again.
+// The carrier check runs on its own slow timer, folded into the same wait
+// so the SPI bus is only ever touched from one thread. Without an IRQ line
+// the FIFO is polled every POLL_MS instead.
+//
+class RadioReceiver
+{
+public:
+    static const int POLL_MS = 5;
+    static const int CARRIER_INTERVAL_MS = 500;
+    //Re-check the FIFO this often even with an IRQ line, in case an edge
+    //is ever missed
+    static const int IRQ_TIMEOUT_MS = 100;
+
+    //! Called for each payload, after the ack payload has been queued
+    typedef std::function<void(uint8_t pipeNo, const uint8_t *payload, int len)> PacketHandler;
+
+    RadioReceiver(RF24 &radio, GpioEdge &irq, PacketHandler onPacket, std::function<void()> onCarrier);
+
+    //! One pass: wait for the IRQ or the next timer, drain the RX FIFO,
+    //! sample the carrier if due. Returns the number of payloads handled.
+    int Service();
+
+    struct Stats
+    {
+        long packets;
+        long wakeups;       //IRQ edges
+        long emptyWakeups;  //edges with nothing in the FIFO
+        int maxDrain;       //most payloads handled in one pass
+    };
+    Stats GetStats() const { return stats; }
+
+private:
+    int Drain();
+    static long NowMs();
+
+    RF24 &radio;
+    GpioEdge &irq;
+    PacketHandler onPacket;
+    std::function<void()> onCarrier;
+    long nextCarrierMs;
+    Stats stats;
+};
@@ -2,18 +2,33 @@
 #include <string>         // std::string
 #include <sys/resource.h>
 #include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <list>
+#include <numeric>
 
 #include "Logger.h"
 #include "Exception.h"
 #include "HomeAutomationWebAPI.h"
+#include "EpochAccumulator.h"
 
 void loop(HomeAutomationWebAPI &api);
+int TestEpochAccumulator();
+void BenchEpochAccumulator();
 struct rusage memInfo;
 
-int main ()
+int main (int argc, char **argv)
 {
+    //Offline tests: ./Test accum
+    if(argc > 1 && std::string(argv[1]) == "accum")
+    {
+        int failures = TestEpochAccumulator();
+        BenchEpochAccumulator();
+        return failures ? 1 : 0;
+    }
+
     LogLine() << "Starting....";
-    HomeAutomationWebAPI api=HomeAutomationWebAPI();
+    HomeAutomationWebAPI api;
 
     bool authenticatedFlag=false;
 
@@ -29,7 +44,7 @@ int main ()
         }
 
 
-        api.AddDevice(99,"test");
+        api.AddDevice(99,"test",time(NULL));
     }
     catch(WebAPIException& e)
     {
@@ -56,3 +71,156 @@ void loop(HomeAutomationWebAPI &api)
             std::cout << "    Mem: " << memInfo.ru_maxrss << '\n';
     }
 }
+
+//
+// EpochAccumulator
+//
+
+//The list-based accumulator HubMaster used before, for comparison
+class ListAccumulator
+{
+public:
+    void AddEpochValue(long epoch,float value)
+    {
+        if(value<=0)
+            return;
+        epochList.push_back(epoch);
+        valueList.push_back(value);
+    }
+    float Sum() { return accumulate(valueList.begin(),valueList.end(),0.0); }
+    void RemoveOldEpochs(long epochThreshold)
+    {
+        list<long>::iterator e=epochList.begin();
+        list<float>::iterator v=valueList.begin();
+        while(e != epochList.end())
+        {
+            if(*e <= epochThreshold)
+            {
+                epochList.erase(e++);
+                valueList.erase(v++);
+            }
+            else
+            {
+                e++;
+                v++;
+            }
+        }
+    }
+private:
+    list<long> epochList;
+    list<float> valueList;
+};
+
+static int Check(bool ok, const char *what)
+{
+    std::cout << (ok ? "  ok    " : "  FAIL  ") << what << '\n';
+    return ok ? 0 : 1;
+}
+
+static bool Near(float a, float b)
+{
+    return fabs(a - b) < 1e-4;
+}
+
+int TestEpochAccumulator()
+{
+    int failures = 0;
+    std::cout << "EpochAccumulator\n";
+
+    EpochAccumulator hour;
+    failures += Check(hour.Sum() == 0, "empty sum is 0");
+    hour.AddEpochValue(1000, 0.01f);
+    hour.AddEpochValue(1001, 0);            //dry samples are ignored
+    hour.AddEpochValue(1002, -1);
+    hour.AddEpochValue(1500, 0.02f);
+    hour.AddEpochValue(2000, 0.03f);
+    failures += Check(Near(hour.Sum(), 0.06f), "sum of samples");
+    failures += Check(hour.Buckets() == 3, "zero/negative values not stored");
+    hour.RemoveOldEpochs(1000);
+    failures += Check(Near(hour.Sum(), 0.05f), "threshold is inclusive");
+    hour.RemoveOldEpochs(1499);
+    failures += Check(Near(hour.Sum(), 0.05f), "newer samples kept");
+    hour.RemoveOldEpochs(5000);
+    failures += Check(hour.Sum() == 0 && hour.Buckets() == 0, "everything expires");
+    hour.AddEpochValue(6000, 0.5f);
+    failures += Check(Near(hour.Sum(), 0.5f), "usable after emptying");
+
+    //Minute buckets: samples in one minute merge, edge is never early
+    EpochAccumulator day(60);
+    for(long t = 0; t < 3600; t += 5)
+        day.AddEpochValue(86400 + t, 0.01f);
+    failures += Check(day.Buckets() == 60, "one bucket per minute");
+    failures += Check(Near(day.Sum(), 7.2f), "bucketed sum");
+    day.RemoveOldEpochs(86400 + 30);
+    failures += Check(Near(day.Sum(), 7.2f), "partly expired bucket kept");
+    day.RemoveOldEpochs(86400 + 59);
+    failures += Check(day.Buckets() == 59 && Near(day.Sum(), 7.2f - 0.12f), "bucket dropped once all samples expire");
+
+    //Clock stepping back merges into the newest bucket
+    EpochAccumulator back(60);
+    back.AddEpochValue(1200, 1);
+    back.AddEpochValue(1100, 1);
+    failures += Check(back.Buckets() == 1 && Near(back.Sum(), 2), "out of order sample merged");
+    back.RemoveOldEpochs(1199);
+    failures += Check(Near(back.Sum(), 2), "merged bucket kept by newest epoch");
+
+    //Matches the list version over a long random run (unbucketed)
+    EpochAccumulator fast;
+    ListAccumulator slow;
+    bool same = true;
+    srand(7);
+    for(long t = 0; t < 200000; t += 1 + rand() % 20)
+    {
+        float rain = (rand() % 4) * 0.01f;
+        fast.AddEpochValue(t, rain);
+        slow.AddEpochValue(t, rain);
+        fast.RemoveOldEpochs(t - 3600);
+        slow.RemoveOldEpochs(t - 3600);
+        if(fabs(fast.Sum() - slow.Sum()) > 1e-3)
+            same = false;
+    }
+    failures += Check(same, "same sums as the list accumulator");
+
+    std::cout << (failures ? "FAILED: " : "passed, failures: ") << failures << '\n';
+    return failures;
+}
+
+//A full rainy day of weather packets: both windows updated per packet,
+//as BuildAndSendWeather does
+template <class Hour, class Day>
+static double TimeDay(Hour &hour, Day &day, int packetSeconds)
+{
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    double sink = 0;
+    for(long t = 0; t < 86400; t += packetSeconds)
+    {
+        hour.AddEpochValue(t, 0.01f);
+        hour.RemoveOldEpochs(t - 3600);
+        day.AddEpochValue(t, 0.01f);
+        day.RemoveOldEpochs(-1);        //midnight
+        sink += hour.Sum() + day.Sum();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(sink < 0)
+        std::cout << sink;
+    return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+void BenchEpochAccumulator()
+{
+    const int packetSeconds = 5;
+    const int packets = 86400 / packetSeconds;
+
+    ListAccumulator listHour, listDay;
+    double listMs = TimeDay(listHour, listDay, packetSeconds);
+
+    EpochAccumulator hour, day(60);
+    double dequeMs = TimeDay(hour, day, packetSeconds);
+
+    std::cout << "One rainy day, packet every " << packetSeconds << "s (" << packets << " packets)\n";
+    std::cout << "  list:  " << listMs << " ms total, " << listMs * 1000 / packets << " us/packet, "
+              << packets << " day samples stored\n";
+    std::cout << "  deque: " << dequeMs << " ms total, " << dequeMs * 1000 / packets << " us/packet, "
+              << day.Buckets() << " day buckets stored\n";
+}
@@ -0,0 +1,201 @@
+//
+// Upload path benchmark against a local HTTP stub (runs on any Linux box).
+//
+// Replays bursty packet traffic (bursts of back-to-back packets, as when
+// several sensors report at once) through three upload paths and reports
+// how long the radio loop is held up per packet, how long until every
+// upload has landed, and how many TCP connections the stub had to accept:
+//
+//   legacy  - curl_easy_init/headers/perform/cleanup per packet, inline
+//             (the pre-pool WebAPI::CallWebAPI)
+//   pooled  - WebAPI with the shared keep-alive handle pool, inline
+//   queued  - UploadWorker: radio loop only enqueues, curl_multi uploads
+//
+// Build and run (x86 host; the Pi flags in Makefile.test are overridden):
+//   make -f Makefile.test UploadBench CCFLAGS="-O2 -std=c++11"
+//   ./UploadBench [bursts] [packets-per-burst] [server-delay-ms]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+#include "Exception.h"
+#include "WebAPI.h"
+#include "UploadWorker.h"
+#include "HttpStub.h"
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t Discard(void *, size_t size, size_t nmemb, void *)
+{
+    return size * nmemb;
+}
+
+// The pre-pool CallWebAPI, minus logging
+static void LegacyPost(const std::string &url, const std::string &postData, const std::string &token)
+{
+    CURL *curl = curl_easy_init();
+    struct curl_slist *chunk = NULL;
+    chunk = curl_slist_append(chunk, "Accept:");
+    chunk = curl_slist_append(chunk, "Content-Type: application/json;type=entry;charset=utf-8");
+    chunk = curl_slist_append(chunk, ("Authorization: Bearer " + token).c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Discard);
+    curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(chunk);
+}
+
+struct RunResult
+{
+    double maxBlockMs;
+    double meanBlockMs;
+    double totalSeconds;
+    double maxLatencyMs;
+    long connections;
+    long dropped;
+};
+
+static std::string Packet(int i)
+{
+    std::ostringstream json;
+    json << "{\"UnitNum\":" << (i % 12) << ",\"EventCodeType\":\"O\",\"EventCode\":\"O\",\"DeviceDate\":\"" << 1700000000 + i << "\"}";
+    return json.str();
+}
+
+// mode: 0 legacy, 1 pooled, 2 queued
+static RunResult Run(int mode, HttpStub &stub, int bursts, int perBurst, int gapMs)
+{
+    std::ostringstream base;
+    base << "http://127.0.0.1:" << stub.port;
+    const std::string token = "0123456789abcdef0123456789abcdef";
+
+    UploadWorker worker(64, 4);
+    std::mutex doneLock;
+    std::condition_variable doneCv;
+    int done = 0;
+    double maxLatency = 0;
+    double lastDone = 0;
+    if (mode == 2)
+        worker.Start();
+
+    long connectionsBefore = stub.connections;
+    double maxBlock = 0, sumBlock = 0;
+    double start = Now();
+    for (int b = 0; b < bursts; b++)
+    {
+        for (int p = 0; p < perBurst; p++)
+        {
+            std::string body = Packet(b * perBurst + p);
+            double t0 = Now();
+            if (mode == 0)
+            {
+                LegacyPost(base.str() + "/api/events", body, token);
+            }
+            else if (mode == 1)
+            {
+                WebAPI webAPI(base.str());
+                webAPI.AuthenticatedPOST("/api/events", "", body, token);
+            }
+            else
+            {
+                UploadRequest request;
+                request.url = base.str() + "/api/events";
+                request.postData = body;
+                request.isPost = true;
+                request.token = token;
+                request.label = "bench";
+                request.onDone = [&](const UploadRequest &, const UploadResult &result)
+                {
+                    std::lock_guard<std::mutex> guard(doneLock);
+                    done++;
+                    lastDone = Now();
+                    if (result.seconds > maxLatency)
+                        maxLatency = result.seconds;
+                    doneCv.notify_all();
+                };
+                worker.Enqueue(request);
+            }
+            double blocked = Now() - t0;
+            sumBlock += blocked;
+            if (blocked > maxBlock)
+                maxBlock = blocked;
+        }
+        usleep(gapMs * 1000);
+    }
+
+    double end = Now() - gapMs / 1000.0;
+    long dropped = 0;
+    if (mode == 2)
+    {
+        //Dropped requests never complete, so count them in
+        std::unique_lock<std::mutex> guard(doneLock);
+        while (!doneCv.wait_for(guard, std::chrono::milliseconds(100), [&]
+               { return done + worker.GetStats().dropped == bursts * perBurst; }))
+            ;
+        dropped = worker.GetStats().dropped;
+        end = lastDone;
+    }
+
+    RunResult r;
+    r.totalSeconds = end - start - (bursts - 1) * gapMs / 1000.0;  //exclude idle gaps between bursts
+    r.maxBlockMs = maxBlock * 1000;
+    r.meanBlockMs = sumBlock * 1000 / (bursts * perBurst);
+    r.maxLatencyMs = maxLatency * 1000;
+    r.connections = stub.connections - connectionsBefore;
+    r.dropped = dropped;
+    if (mode == 2)
+        worker.Stop(true);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int bursts = argc > 1 ? atoi(argv[1]) : 10;
+    int perBurst = argc > 2 ? atoi(argv[2]) : 20;
+    int delayMs = argc > 3 ? atoi(argv[3]) : 20;
+    const int gapMs = 200;
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    HttpStub stub(delayMs);
+
+    //WebAPI logs every post to stdout; keep the report readable
+    std::stringstream sink;
+    std::streambuf *saved = std::cout.rdbuf(sink.rdbuf());
+
+    const char *names[3] = { "legacy", "pooled", "queued" };
+    RunResult results[3];
+    for (int mode = 0; mode < 3; mode++)
+        results[mode] = Run(mode, stub, bursts, perBurst, gapMs);
+
+    std::cout.rdbuf(saved);
+    printf("%d bursts x %d packets, server delay %d ms\n", bursts, perBurst, delayMs);
+    printf("%-8s %13s %12s %8s %17s %12s %8s\n", "path", "loop mean ms", "loop max ms", "busy s",
+           "pkt->posted max ms", "connections", "dropped");
+    for (int mode = 0; mode < 3; mode++)
+    {
+        printf("%-8s %13.3f %12.3f %8.2f %17.1f %12ld %8ld\n", names[mode], results[mode].meanBlockMs,
+               results[mode].maxBlockMs, results[mode].totalSeconds,
+               mode == 2 ? results[mode].maxLatencyMs : results[mode].maxBlockMs, results[mode].connections,
+               results[mode].dropped);
+    }
+    printf("stub requests: %ld\n", (long)stub.requests);
+    return 0;
+}
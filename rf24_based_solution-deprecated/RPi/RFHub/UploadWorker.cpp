@@ -0,0 +1,248 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "Logger.h"
+#include "WebAPI.h"
+#include "UploadWorker.h"
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+UploadWorker::UploadWorker(size_t _maxQueued, int _maxInFlight)
+{
+    maxQueued = _maxQueued;
+    maxInFlight = _maxInFlight;
+    stats = Stats();
+    running = false;
+    draining = false;
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    multi = curl_multi_init();
+    if ( multi == NULL )
+        throw std::runtime_error("Unable to initialize curl multi handler");
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxInFlight);
+}
+
+UploadWorker::~UploadWorker()
+{
+    Stop(false);
+    for (size_t i = 0; i < idleHandles.size(); i++)
+        curl_easy_cleanup(idleHandles[i]);
+    curl_multi_cleanup(multi);
+}
+
+void UploadWorker::Start()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (running)
+        return;
+    running = true;
+    draining = false;
+    worker = std::thread(&UploadWorker::Run, this);
+}
+
+void UploadWorker::Stop(bool drain)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+        draining = drain;
+    }
+    curl_multi_wakeup(multi);
+    if (worker.joinable())
+        worker.join();
+}
+
+bool UploadWorker::Enqueue(const UploadRequest &request)
+{
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (pending.size() >= maxQueued)
+        {
+            LogErrorLine() << "Upload queue full, dropping " << pending.front().request.label;
+            pending.pop_front();
+            stats.dropped++;
+            dropped = true;
+        }
+        Pending entry;
+        entry.request = request;
+        entry.enqueuedAt = Now();
+        pending.push_back(entry);
+        stats.queued++;
+    }
+    curl_multi_wakeup(multi);
+    return !dropped;
+}
+
+UploadWorker::Stats UploadWorker::GetStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Stats copy = stats;
+    copy.depth = pending.size();
+    return copy;
+}
+
+void UploadWorker::Run()
+{
+    while (true)
+    {
+        StartTransfers();
+
+        int stillRunning = 0;
+        curl_multi_perform(multi, &stillRunning);
+        FinishTransfers();
+
+        //Refill the slots that just freed up; otherwise queued requests
+        //would wait for the next socket event or the poll timeout
+        StartTransfers();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stats.inFlight = active.size();
+            if (!running && (!draining || (pending.empty() && active.empty())))
+                break;
+        }
+
+        //Sleeps until a socket is ready, a timeout is due or Enqueue() wakes us
+        curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    }
+
+    //Abandon anything still in flight (Stop without drain)
+    for (size_t i = 0; i < active.size(); i++)
+    {
+        curl_multi_remove_handle(multi, active[i]->curl);
+        idleHandles.push_back(active[i]->curl);
+        delete active[i];
+    }
+    active.clear();
+}
+
+void UploadWorker::StartTransfers()
+{
+    while ((int)active.size() < maxInFlight)
+    {
+        Pending next;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (pending.empty())
+                return;
+            next = pending.front();
+            pending.pop_front();
+        }
+
+        CURL *curl;
+        if (!idleHandles.empty())
+        {
+            curl = idleHandles.back();
+            idleHandles.pop_back();
+            curl_easy_reset(curl);
+        }
+        else
+        {
+            curl = curl_easy_init();
+            if (curl == NULL)
+            {
+                //Leave it at the front of the queue for the next pass
+                LogErrorLine() << "Unable to initialize curl for " << next.request.label << ", leaving it queued";
+                std::lock_guard<std::mutex> guard(lock);
+                pending.push_front(next);
+                return;
+            }
+        }
+
+        Transfer *t = new Transfer();
+        t->request = next.request;
+        t->enqueuedAt = next.enqueuedAt;
+        t->errbuf[0] = 0;
+        t->curl = curl;
+
+        t->headers = WebAPI::ConfigureRequest(t->curl, t->request.url, t->request.token, t->request.postData, t->request.isPost);
+        curl_easy_setopt(t->curl, CURLOPT_ERRORBUFFER, t->errbuf);
+        curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, WriteTransfer);
+        curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, t);
+        curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
+        curl_multi_add_handle(multi, t->curl);
+        active.push_back(t);
+    }
+}
+
+void UploadWorker::FinishTransfers()
+{
+    CURLMsg *msg;
+    int queuedMessages;
+    while ((msg = curl_multi_info_read(multi, &queuedMessages)) != NULL)
+    {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        Transfer *t = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+
+        UploadResult result;
+        result.response = t->response;
+        result.seconds = Now() - t->enqueuedAt;
+        if (msg->data.result != CURLE_OK)
+        {
+            result.type = 0;
+            result.errCode = (int)msg->data.result;
+            result.ok = false;
+            LogErrorLine() << "Upload " << t->request.label << " Curl ERROR: " << result.errCode
+                           << " " << curl_easy_strerror(msg->data.result) << " " << t->errbuf;
+        }
+        else
+        {
+            long retCode = 0;
+            curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &retCode);
+            result.type = 1;
+            result.errCode = (int)retCode;
+            result.ok = retCode >= 200 && retCode <= 300;  //same range as WebAPI::isHTTPError
+            if (!result.ok)
+                LogErrorLine() << "Upload " << t->request.label << " Http Error Code: " << retCode;
+        }
+
+        curl_multi_remove_handle(multi, t->curl);
+        idleHandles.push_back(t->curl);
+        for (size_t i = 0; i < active.size(); i++)
+        {
+            if (active[i] == t)
+            {
+                active.erase(active.begin() + i);
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (result.ok)
+                stats.completed++;
+            else
+                stats.failed++;
+            if (result.seconds > stats.maxSeconds)
+                stats.maxSeconds = result.seconds;
+        }
+
+        if (t->request.onDone)
+        {
+            try
+            {
+                t->request.onDone(t->request, result);
+            }
+            catch(const std::exception& e)
+            {
+                LogErrorLine() << "Upload " << t->request.label << " completion threw: " << e.what();
+            }
+        }
+        delete t;
+    }
+}
+
+size_t UploadWorker::WriteTransfer(void *ptr, size_t size, size_t nmemb, void *pTransfer)
+{
+    Transfer *t = static_cast<Transfer *>(pTransfer);
+    size_t bytes = size * nmemb;
+    t->response.append(static_cast<char *>(ptr), bytes);
+    return bytes;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <curl/curl.h>
+
+//
+// Background uploader fed by the radio loop.
+//
+// Enqueue() copies the request into a bounded queue and returns at once, so
+// a slow or stalled server never holds up radio.available(). One worker
+// thread drives every transfer through a curl multi handle: several
+// uploads are in flight together and the multi handle's connection cache
+// keeps connections to each host alive between them.
+//
+
+struct UploadResult
+{
+    int type;               //0=CURL, 1=http (same as WebAPIException)
+    int errCode;            //CURLcode or HTTP status
+    bool ok;
+    std::string response;
+    double seconds;         //queued -> completed
+};
+
+struct UploadRequest
+{
+    std::string url;        //full URL, query string included for GETs
+    std::string postData;
+    bool isPost;
+    std::string token;      //bearer token, "" for none
+    int attempt;            //0 on first send; callers bump it when they retry
+    std::string label;      //for log lines
+
+    //Called on the worker thread when the transfer finishes (may be empty)
+    std::function<void(const UploadRequest &, const UploadResult &)> onDone;
+
+    UploadRequest() : isPost(false), attempt(0) {}
+};
+
+class UploadWorker
+{
+public:
+    UploadWorker(size_t maxQueued = 64, int maxInFlight = 4);
+    ~UploadWorker();
+
+    void Start();
+    //! Stop the worker; with drain=true, first finish what is queued
+    void Stop(bool drain);
+
+    //! Never blocks on the network. When the queue is full the oldest
+    //! queued request is dropped to make room. Returns false if one was.
+    bool Enqueue(const UploadRequest &request);
+
+    struct Stats
+    {
+        long queued;
+        long completed;
+        long failed;
+        long dropped;
+        size_t depth;       //currently waiting
+        size_t inFlight;
+        double maxSeconds;  //worst queued -> completed time
+    };
+    Stats GetStats();
+
+private:
+    UploadWorker(const UploadWorker &);
+
+    struct Transfer
+    {
+        UploadRequest request;
+        std::string response;
+        char errbuf[CURL_ERROR_SIZE];
+        CURL *curl;
+        std::shared_ptr<struct curl_slist> headers;   // set on curl, kept until it's done
+        double enqueuedAt;
+    };
+
+    struct Pending
+    {
+        UploadRequest request;
+        double enqueuedAt;
+    };
+
+    void Run();
+    void StartTransfers();
+    void FinishTransfers();
+    static size_t WriteTransfer(void *ptr, size_t size, size_t nmemb, void *pTransfer);
+
+    size_t maxQueued;
+    int maxInFlight;
+
+    std::mutex lock;            //guards pending, stats, running
+    std::deque<Pending> pending;
+    Stats stats;
+    bool running;
+    bool draining;
+
+    CURLM *multi;
+    std::vector<CURL *> idleHandles;   //worker thread only
+    std::vector<Transfer *> active;    //worker thread only
+    std::thread worker;
+};
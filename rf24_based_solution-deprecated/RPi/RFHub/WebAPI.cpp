@@ -7,6 +7,7 @@
 #include "Logger.h"
 #include "Exception.h"
 #include "WebAPI.h"
+#include "CurlPool.h"
 
 extern "C" {
     size_t WriteFunc(void *ptr, size_t size, size_t nmemb, void* pInstance);
@@ -56,37 +57,40 @@ std::string WebAPI::AuthenticatedGET(const std::string &controller,const std::st
     return CallWebAPI(controller, api, token, "", GET);
 }
 
+std::shared_ptr<struct curl_slist> WebAPI::ConfigureRequest(CURL *curl, const std::string &url, const std::string &token, const std::string &postData, bool isPost)
+{
+    //set headers (built once per token and shared)
+    std::shared_ptr<struct curl_slist> headers = CurlPool::Instance().Headers(token);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.get());
+
+    //Set options
+    //curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30);  //set timeout for 30 seconds
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  //timeouts without SIGALRM, needed off the main thread
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);  //keep idle pooled connections alive
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str()); //set URL
+    if (isPost)
+    {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)postData.length());
+        curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, postData.c_str());
+    }
+    return headers;
+}
+
 std::string WebAPI::CallWebAPI(const std::string &controller,const std::string &api, const std::string &token,const std::string &postData, int type)
 {
-    //Init
-    CURL *curl = curl_easy_init();
-    if ( curl == NULL )
-        throw std::runtime_error("Unable to initialize curl handler");
+    //Init - pooled handle, so the previous call's connection is reused
+    CURL *curl = CurlPool::Instance().Acquire();
     CURLcode res;
     char errbuf[CURL_ERROR_SIZE];
     errbuf[0]=0;
+    webResponse.clear();
 
     std::string url = baseURL + controller + api;
     //LogLine() << "URL: " << url;
-    std::string tokenString = "Authorization: Bearer " + token;
-
-    //set headers
-    struct curl_slist *chunk = NULL;
-    chunk = curl_slist_append(chunk, "Accept:");
-    chunk = curl_slist_append(chunk, "Content-Type: application/json;type=entry;charset=utf-8");
-    if(token.length()>2)
-        chunk = curl_slist_append(chunk, tokenString.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
 
-    //Set options
-    //curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+    std::shared_ptr<struct curl_slist> headers = ConfigureRequest(curl, url, token, postData, type == POST);
     curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30);  //set timeout for 30 seconds
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str()); //set URL
-    if (type == POST)
-    {
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-    }
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFunc);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
 
@@ -99,9 +103,9 @@ std::string WebAPI::CallWebAPI(const std::string &controller,const std::string &
         LogErrorLine() << "Curl ERROR: " << (int)res << " " << curl_easy_strerror(res);
 		LogErrorLine() << "Long(er) Error: " << errbuf;
 
-        //Cleanup
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(chunk);
+        //Back to the pool (errbuf is on our stack, so unhook it first)
+        curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, NULL);
+        CurlPool::Instance().Release(curl);
 
         throw WebAPIException(0,(int)res,errbuf);  //CURL exception type
     }
@@ -111,9 +115,9 @@ std::string WebAPI::CallWebAPI(const std::string &controller,const std::string &
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &retCode);
     httpReturnCode=retCode;  //because of C calling
 
-    //Cleanup
-    curl_easy_cleanup(curl);
-    curl_slist_free_all(chunk);
+    //Back to the pool
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, NULL);
+    CurlPool::Instance().Release(curl);
 
     if(isHTTPError())
     {
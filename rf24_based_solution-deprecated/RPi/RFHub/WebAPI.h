@@ -1,3 +1,7 @@
+#pragma once
+
+#include <string>
+#include <memory>
 #include <curl/curl.h>
 
 class WebAPI
@@ -18,6 +22,11 @@ public:
     //! append received data into internal buffer by write_data_callback
     size_t append_data(void* ptr, size_t size, size_t nmemb);
 
+    //! Set the common options (URL, headers, timeout, keep-alive, body) on an
+    //! easy handle; shared with UploadWorker so both paths send identical requests.
+    //! Returns the header list, which has to be kept until the transfer is done
+    static std::shared_ptr<struct curl_slist> ConfigureRequest(CURL *curl, const std::string &url, const std::string &token, const std::string &postData, bool isPost);
+
 private:
     //! no compiler-generated copy constructor
     WebAPI(const WebAPI &);